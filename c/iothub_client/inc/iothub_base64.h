@@ -0,0 +1,57 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_base64.h
+*	@brief	 Base64 encoder and decoder shared by the HTTP transport, the
+*			 blob upload and the serializer.
+*
+*	@details The codec writes into memory provided by the caller and never
+*			 allocates. It has a scalar implementation that runs everywhere
+*			 and vector implementations for SSSE3 and AVX2 (x86 and x64,
+*			 selected at runtime from what the CPU supports) and for NEON
+*			 (AArch64). All the implementations produce the same output.
+*			 Defining IOTHUB_BASE64_NO_SIMD at compile time leaves only the
+*			 scalar implementation.
+*/
+
+#ifndef IOTHUB_BASE64_H
+#define IOTHUB_BASE64_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+/*IOTHUB_BASE64_ALPHABET_STANDARD uses '+' and '/' for the values 62 and 63 (RFC 4648 section 4), IOTHUB_BASE64_ALPHABET_URL uses '-' and '_' (RFC 4648 section 5)*/
+#define IOTHUB_BASE64_ALPHABET_VALUES \
+    IOTHUB_BASE64_ALPHABET_STANDARD, \
+    IOTHUB_BASE64_ALPHABET_URL
+
+DEFINE_ENUM(IOTHUB_BASE64_ALPHABET, IOTHUB_BASE64_ALPHABET_VALUES);
+
+#define IOTHUB_BASE64_IMPLEMENTATION_VALUES \
+    IOTHUB_BASE64_IMPLEMENTATION_SCALAR, \
+    IOTHUB_BASE64_IMPLEMENTATION_SSSE3, \
+    IOTHUB_BASE64_IMPLEMENTATION_AVX2, \
+    IOTHUB_BASE64_IMPLEMENTATION_NEON
+
+DEFINE_ENUM(IOTHUB_BASE64_IMPLEMENTATION, IOTHUB_BASE64_IMPLEMENTATION_VALUES);
+
+    /*the number of characters IoTHubBase64_Encode writes for size bytes, padding included*/
+    MOCKABLE_FUNCTION(, size_t, IoTHubBase64_EncodedLength, size_t, size);
+    /*writes the padded encoding of source at destination and returns the position after its last character. Nothing is NUL terminated.*/
+    MOCKABLE_FUNCTION(, char*, IoTHubBase64_Encode, IOTHUB_BASE64_ALPHABET, alphabet, const unsigned char*, source, size_t, size, char*, destination);
+    /*decodes the longest prefix of source made of complete groups of 4 characters of the alphabet, writes 3 bytes per group at destination and returns the number of characters decoded. Padding is not part of a complete group.*/
+    MOCKABLE_FUNCTION(, size_t, IoTHubBase64_DecodeGroups, IOTHUB_BASE64_ALPHABET, alphabet, const char*, source, size_t, length, unsigned char*, destination);
+    MOCKABLE_FUNCTION(, IOTHUB_BASE64_IMPLEMENTATION, IoTHubBase64_GetImplementation);
+    MOCKABLE_FUNCTION(, int, IoTHubBase64_SetImplementation, IOTHUB_BASE64_IMPLEMENTATION, implementation);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_BASE64_H */
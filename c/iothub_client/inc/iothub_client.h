@@ -79,6 +79,22 @@ extern "C"
 	*/
 	extern IOTHUB_CLIENT_HANDLE IoTHubClient_CreateWithTransport(TRANSPORT_HANDLE transportHandle, const IOTHUB_CLIENT_CONFIG* config);
 
+	/**
+	* @brief	Creates a IoT Hub client for communication with an existing IoT
+	* 			Hub using one of the transports of a transport pool.
+	*
+	* @param	poolHandle	TRANSPORT_POOL_HANDLE created by IoTHubTransport_CreatePool.
+	* @param	config	Pointer to an @c IOTHUB_CLIENT_CONFIG structure
+	*
+	*			The transport is picked from the device id, so a device always
+	*			uses the same transport of the pool and the devices are spread
+	*			over the worker threads of the pool. This is a blocking call.
+	*
+	* @return	A non-NULL @c IOTHUB_CLIENT_HANDLE value that is used when
+	* 			invoking other functions for IoT Hub client and @c NULL on failure.
+	*/
+	extern IOTHUB_CLIENT_HANDLE IoTHubClient_CreateWithTransportPool(TRANSPORT_POOL_HANDLE poolHandle, const IOTHUB_CLIENT_CONFIG* config);
+
 	/**
 	* @brief	Disposes of resources allocated by the IoT Hub client. This is a
 	* 			blocking call.
@@ -109,6 +125,70 @@ extern "C"
 	*/
 	extern IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback);
 
+	/**
+	* @brief	Asynchronous call to send the message specified by @p eventMessageHandle
+	* 			without making a copy of it.
+	*
+	*			Unlike ::IoTHubClient_SendEventAsync, the message is not cloned.
+	*			When the function returns IOTHUB_CLIENT_OK the IoT Hub client takes
+	*			ownership of @p eventMessageHandle and will destroy it once the
+	*			message has been confirmed, has timed out or the client is destroyed.
+	*			The caller shall not use or destroy the handle after that. On any
+	*			other return value the caller keeps ownership of the handle.
+	*
+	* @param	iotHubClientHandle		   	The handle created by a call to the create function.
+	* @param	eventMessageHandle		   	The handle to an IoT Hub message.
+	* @param	eventConfirmationCallback  	The callback specified by the device for receiving
+	* 										confirmation of the delivery of the IoT Hub message.
+	* 										The user can specify a @c NULL value here to
+	* 										indicate that no callback is required.
+	* @param	userContextCallback			User specified context that will be provided to the
+	* 										callback. This can be @c NULL.
+	*
+	*			@b NOTE: The application behavior is undefined if the user calls
+	*			the ::IoTHubClient_Destroy function from within any callback.
+	*
+	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync_TakeOwnership(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback);
+
+	/**
+	* @brief	Asynchronous call to send the @p eventMessageCount messages of
+	* 			@p eventMessageHandles as one group.
+	*
+	*			The whole batch is queued under a single acquisition of the client
+	*			lock: either all the messages are queued or, on any error, none of
+	*			them is. See ::IoTHubClient_LL_SendEventBatchAsync.
+	*
+	* @param	iotHubClientHandle		   	The handle created by a call to the create function.
+	* @param	eventMessageHandles		   	An array of @p eventMessageCount IoT Hub message handles.
+	* @param	eventMessageCount		   	The number of messages in the batch, at least 1.
+	* @param	batchConfirmation		   	Whether @p eventConfirmationCallback is invoked for
+	* 										every message or once for the whole batch.
+	* @param	eventConfirmationCallback  	The callback specified by the device for receiving
+	* 										confirmation of the delivery of the messages.
+	* 										The user can specify a @c NULL value here to
+	* 										indicate that no callback is required.
+	* @param	userContextCallback			User specified context that will be provided to the
+	* 										callback. This can be @c NULL.
+	*
+	*			@b NOTE: The application behavior is undefined if the user calls
+	*			the ::IoTHubClient_Destroy function from within any callback.
+	*
+	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubClient_SendEventBatchAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback);
+
+	/**
+	* @brief	Same as ::IoTHubClient_SendEventBatchAsync but the messages are
+	* 			not cloned. When the function returns IOTHUB_CLIENT_OK the IoT Hub
+	* 			client takes ownership of all the handles in @p eventMessageHandles,
+	* 			on any other return value the caller keeps all of them.
+	*
+	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubClient_SendEventBatchAsync_TakeOwnership(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback);
+
 	/**
 	* @brief	This function returns the current sending status for IoTHubClient.
 	*
@@ -136,10 +216,34 @@ extern "C"
 	*			@b NOTE: The application behavior is undefined if the user calls
 	*			the ::IoTHubClient_Destroy function from within any callback.
 	*
+	*			@b NOTE: @p messageCallback is always called by the worker thread
+	*			while it holds the lock of the client, also when the
+	*			"callbackDispatchThread" option is on: the transport needs the
+	*			disposition it returns before it is done receiving the message.
+	*			A slow @p messageCallback delays the sending of the events and, with
+	*			a shared transport, the other devices.
+	*
 	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
 	*/
 	extern IOTHUB_CLIENT_RESULT IoTHubClient_SetMessageCallback(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback);
 
+	/**
+	* @brief	Sets up the callback to be invoked when the number of messages waiting
+	* 			to be sent crosses the watermarks set by the "sendQueueHighWatermark"
+	* 			and "sendQueueLowWatermark" options.
+	*
+	* @param	iotHubClientHandle		   	The handle created by a call to the create function.
+	* @param	sendQueueCallback	  	   	The callback, @c NULL stops the notifications.
+	* @param	userContextCallback			User specified context that will be provided to the
+	* 										callback. This can be @c NULL.
+	*
+	*			@b NOTE: The application behavior is undefined if the user calls
+	*			the ::IoTHubClient_Destroy function from within any callback.
+	*
+	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubClient_SetSendQueueCallback(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_SEND_QUEUE_CALLBACK sendQueueCallback, void* userContextCallback);
+
 	/**
 	* @brief	This function returns in the out parameter @p lastMessageReceiveTime
 	* 			what was the value of the @c time function when the last message was
@@ -153,6 +257,34 @@ extern "C"
 	*/
 	extern IOTHUB_CLIENT_RESULT IoTHubClient_GetLastMessageReceiveTime(IOTHUB_CLIENT_HANDLE iotHubClientHandle, time_t* lastMessageReceiveTime);
 
+	/**
+	* @brief	This function returns in the out parameter @p poolStatistics the
+	* 			counters of the pool that recycles the records the client keeps
+	* 			for every message waiting to be sent.
+	*
+	* @param	iotHubClientHandle		The handle created by a call to the create function.
+	* @param	poolStatistics			Out parameter receiving the counters. When the
+	* 									"messagePoolSize" option has not been set all
+	* 									the counters are 0.
+	*
+	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubClient_GetPoolStatistics(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_POOL_STATISTICS* poolStatistics);
+
+	/**
+	* @brief	This function returns in the out parameter @p statistics the
+	* 			depths of the send queue and the counters of the messages
+	* 			sent by the client since it was created. Events handed off
+	* 			with the "sendEventHandoff" option are only counted once
+	* 			the worker thread has queued them.
+	*
+	* @param	iotHubClientHandle		The handle created by a call to the create function.
+	* @param	statistics				Out parameter receiving the counters.
+	*
+	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubClient_GetStatistics(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATISTICS* statistics);
+
 	/**
 	* @brief	This API sets a runtime option identified by parameter @p optionName
 	* 			to a value pointed to by @p value. @p optionName and the data type
@@ -190,6 +322,40 @@ extern "C"
 	*				- @b messageTimeout - the maximum time in milliseconds until a message
 	*                 is timeouted. The time starts at IoTHubClient_SendEventAsync. By default,
 	*                 messages do not expire. @p is a pointer to a uint64_t
+	*				- @b sendQueueMaxMessages, @b sendQueueMaxBytes - the maximum number of
+	*				  messages and of payload bytes that can wait to be sent. 0 (the default)
+	*				  means no limit. @p value is a pointer to a size_t.
+	*				- @b sendQueueFullPolicy - what IoTHubClient_SendEventAsync does when the
+	*				  send queue is full: @c IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT (the default)
+	*				  fails the call, @c IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST drops the
+	*				  oldest messages that are not being sent yet and
+	*				  @c IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK waits until there is room.
+	*				  @p value is a pointer to an IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY.
+	*				- @b sendQueueHighWatermark, @b sendQueueLowWatermark - the number of
+	*				  queued messages at which the callback set by
+	*				  IoTHubClient_SetSendQueueCallback is invoked. @p value is a pointer to a size_t.
+	*				- @b journalPath - the path prefix of the files of a disk journal of the
+	*				  messages waiting to be sent. The messages a previous instance left in the
+	*				  journal are sent again. @p value is a pointer to a null terminated string.
+	*				- @b journalSegmentSize - the size in bytes of a journal file, 1 MB by
+	*				  default. @p value is a pointer to a size_t.
+	*				- @b journalSyncInterval - the time in milliseconds between two flushes of
+	*				  the journal to the disk, 1000 by default. @p value is a pointer to an unsigned int.
+	*				- @b sendStatistics - when true, IoTHubClient_GetStatistics also reports the
+	*				  payload bytes and the latency of the events queued after it is set. Off
+	*				  by default. @p value is a pointer to a bool.
+	*				- @b sendEventHandoff - when true, IoTHubClient_SendEventAsync and
+	*				  IoTHubClient_SendEventAsync_TakeOwnership do not take the lock of the
+	*				  client: the messages are handed over to the worker thread, which passes
+	*				  them to IoTHubClient_LL. It cannot be turned off once enabled.
+	*				  @p value is a pointer to a bool.
+	*				- @b callbackDispatchThread - when true, the event confirmation callbacks,
+	*				  and only them, are called by a thread of the client that does not hold
+	*				  its lock, in the order they happen. The message callback and the send
+	*				  queue callback are still called under the lock, the message callback by
+	*				  the worker thread (see ::IoTHubClient_SetMessageCallback). It cannot be
+	*				  turned off once enabled.
+	*				  @p value is a pointer to a bool.
 	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
 	*/
 	extern IOTHUB_CLIENT_RESULT IoTHubClient_SetOption(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const char* optionName, const void* value);
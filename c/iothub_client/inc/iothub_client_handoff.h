@@ -0,0 +1,48 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_handoff.h
+*	@brief	 Multi-producer, single-consumer handoff of items between the
+*			 application threads and the worker thread of IoTHubClient.
+*
+*	@details Any number of threads can push items concurrently without taking
+*			 a lock: a push is a compare-and-swap on the head of a singly
+*			 linked list. The single consumer takes all the items at once with
+*			 an atomic exchange and receives them in the order they were
+*			 pushed. Items are intrusive: the structure handed over starts with
+*			 an IOTHUB_CLIENT_HANDOFF_ITEM. On a compiler without atomic
+*			 operations the list is protected by a lock of its own, which is
+*			 only held for a few pointer assignments.
+*/
+
+#ifndef IOTHUB_CLIENT_HANDOFF_H
+#define IOTHUB_CLIENT_HANDOFF_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+typedef struct IOTHUB_CLIENT_HANDOFF_DATA_TAG* IOTHUB_CLIENT_HANDOFF_HANDLE;
+
+/*the first member of every item handed over*/
+typedef struct IOTHUB_CLIENT_HANDOFF_ITEM_TAG
+{
+    struct IOTHUB_CLIENT_HANDOFF_ITEM_TAG* next;
+} IOTHUB_CLIENT_HANDOFF_ITEM;
+
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_HANDOFF_HANDLE, IoTHubClient_Handoff_Create);
+    MOCKABLE_FUNCTION(, bool, IoTHubClient_Handoff_Push, IOTHUB_CLIENT_HANDOFF_HANDLE, handle, IOTHUB_CLIENT_HANDOFF_ITEM*, item);
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_HANDOFF_ITEM*, IoTHubClient_Handoff_TakeAll, IOTHUB_CLIENT_HANDOFF_HANDLE, handle);
+    MOCKABLE_FUNCTION(, bool, IoTHubClient_Handoff_IsEmpty, IOTHUB_CLIENT_HANDOFF_HANDLE, handle);
+    MOCKABLE_FUNCTION(, void, IoTHubClient_Handoff_Destroy, IOTHUB_CLIENT_HANDOFF_HANDLE, handle);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_HANDOFF_H */
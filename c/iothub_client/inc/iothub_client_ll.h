@@ -66,7 +66,8 @@ extern "C"
     IOTHUB_CLIENT_CONFIRMATION_OK,                   \
     IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY,      \
     IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT,      \
-    IOTHUB_CLIENT_CONFIRMATION_ERROR                 \
+    IOTHUB_CLIENT_CONFIRMATION_ERROR,                \
+    IOTHUB_CLIENT_CONFIRMATION_DROPPED               \
 
 	/** @brief Enumeration passed in by the IoT Hub when the event confirmation
 	*		   callback is invoked to indicate status of the event processing in
@@ -74,6 +75,35 @@ extern "C"
 	*/
 	DEFINE_ENUM(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_RESULT_VALUES);
 
+#define IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY_VALUES  \
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT,            \
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST,       \
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK              \
+
+	/** @brief Enumeration used with the "sendQueueFullPolicy" option to select
+	*		   what happens to a new message when the send queue has no room for it.
+	*/
+	DEFINE_ENUM(IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY, IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY_VALUES);
+
+#define IOTHUB_CLIENT_BATCH_CONFIRMATION_VALUES      \
+    IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE,    \
+    IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE       \
+
+	/** @brief Enumeration passed to the _SendEventBatchAsync functions to select
+	*		   whether the confirmation callback is invoked for every message of the
+	*		   batch or once for the whole batch.
+	*/
+	DEFINE_ENUM(IOTHUB_CLIENT_BATCH_CONFIRMATION, IOTHUB_CLIENT_BATCH_CONFIRMATION_VALUES);
+
+#define IOTHUB_CLIENT_SEND_QUEUE_WATERMARK_VALUES    \
+    IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK,         \
+    IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK           \
+
+	/** @brief Enumeration passed to the send queue callback to indicate which
+	*		   watermark the number of queued messages has just crossed.
+	*/
+	DEFINE_ENUM(IOTHUB_CLIENT_SEND_QUEUE_WATERMARK, IOTHUB_CLIENT_SEND_QUEUE_WATERMARK_VALUES);
+
 #define TRANSPORT_TYPE_VALUES \
     TRANSPORT_LL, /*LL comes from "LowLevel" */ \
     TRANSPORT_THREADED
@@ -94,6 +124,55 @@ extern "C"
 	typedef void(*IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK)(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback);
 	typedef IOTHUBMESSAGE_DISPOSITION_RESULT (*IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC)(IOTHUB_MESSAGE_HANDLE message, void* userContextCallback);
 	typedef const TRANSPORT_PROVIDER*(*IOTHUB_CLIENT_TRANSPORT_PROVIDER)(void);
+	typedef void(*IOTHUB_CLIENT_SEND_QUEUE_CALLBACK)(IOTHUB_CLIENT_SEND_QUEUE_WATERMARK watermark, void* userContextCallback);
+
+	/** @brief	This struct is filled by ::IoTHubClient_LL_GetPoolStatistics with
+	*			the counters of the pool set up by the "messagePoolSize" option.
+	*/
+	typedef struct IOTHUB_CLIENT_POOL_STATISTICS_TAG
+	{
+		size_t capacity;    /**< number of records owned by the pool */
+		size_t inUse;       /**< records of the pool currently in use */
+		size_t peakInUse;   /**< highest value @c inUse has reached */
+		uint64_t hits;      /**< records served by the pool */
+		uint64_t misses;    /**< records that had to be allocated because the pool was empty */
+	} IOTHUB_CLIENT_POOL_STATISTICS;
+
+/*the latency histogram is log-linear: the latencies under IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT ms have one bucket per ms,
+then every range [2^k, 2^(k+1)) ms is split in IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT buckets of 2^(k-IOTHUB_CLIENT_LATENCY_SUB_BUCKET_BITS) ms,
+so no bucket is wider than 1/IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT of the latencies it counts. Bucket b >= IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT
+starts at 2^k + (b % IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT) * 2^(k-IOTHUB_CLIENT_LATENCY_SUB_BUCKET_BITS) ms, with
+k = b / IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT + IOTHUB_CLIENT_LATENCY_SUB_BUCKET_BITS - 1. The last bucket also counts all the latencies of 2^IOTHUB_CLIENT_LATENCY_RANGE_BITS ms and more*/
+#define IOTHUB_CLIENT_LATENCY_SUB_BUCKET_BITS 3
+#define IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT (1 << IOTHUB_CLIENT_LATENCY_SUB_BUCKET_BITS)
+#define IOTHUB_CLIENT_LATENCY_RANGE_BITS 24
+#define IOTHUB_CLIENT_LATENCY_BUCKET_COUNT ((IOTHUB_CLIENT_LATENCY_RANGE_BITS - IOTHUB_CLIENT_LATENCY_SUB_BUCKET_BITS + 1) * IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT)
+
+	/** @brief	This struct is filled by ::IoTHubClient_LL_GetStatistics with
+	*			the counters of the messages sent by the client. The bytes and
+	*			latency fields are only recorded while the "sendStatistics"
+	*			option is on.
+	*/
+	typedef struct IOTHUB_CLIENT_STATISTICS_TAG
+	{
+		size_t waitingToSend;   /**< queued messages the transport has not picked up yet */
+		size_t inTransport;     /**< messages the transport took and has not completed yet: the MQTT messages waiting for their PUBACK or the AMQP events waiting for their disposition.
+		                             The HTTP transport completes the events it takes before IoTHubClient_LL_DoWork returns, so with HTTP this is always 0 */
+		uint64_t enqueued;      /**< messages accepted by the send functions */
+		uint64_t enqueuedBytes; /**< payload bytes of the messages accepted while "sendStatistics" is on */
+		uint64_t refused;       /**< messages refused because the send queue was full */
+		uint64_t sent;          /**< messages the transport took to send them, each counted once */
+		uint64_t retries;       /**< messages the transport sent again, and connections or requests it attempted again after waiting for its retry policy */
+		uint64_t confirmed;     /**< messages completed with IOTHUB_CLIENT_CONFIRMATION_OK */
+		uint64_t failed;        /**< messages completed with an error, or because the client or transport was destroyed */
+		uint64_t timedOut;      /**< messages completed with IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT */
+		uint64_t dropped;       /**< messages dropped by the IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST policy */
+		uint64_t latencyCount;  /**< confirmed messages whose latency, from queueing to confirmation, is recorded */
+		uint64_t latencyMinMs;
+		uint64_t latencyMaxMs;
+		uint64_t latencyTotalMs;
+		uint64_t latencyHistogram[IOTHUB_CLIENT_LATENCY_BUCKET_COUNT]; /**< log-linear, see IOTHUB_CLIENT_LATENCY_SUB_BUCKET_BITS */
+	} IOTHUB_CLIENT_STATISTICS;
 
 	/** @brief	This struct captures IoTHub client configuration. */
 	typedef struct IOTHUB_CLIENT_CONFIG_TAG
@@ -231,6 +310,79 @@ extern "C"
 	*/
 	extern IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback);
 
+	/**
+	* @brief	Asynchronous call to send the message specified by @p eventMessageHandle
+	* 			without making a copy of it.
+	*
+	*			Unlike ::IoTHubClient_LL_SendEventAsync, the message is not cloned.
+	*			When the function returns IOTHUB_CLIENT_OK the IoT Hub client takes
+	*			ownership of @p eventMessageHandle and will destroy it once the
+	*			message has been confirmed, has timed out or the client is destroyed.
+	*			The caller shall not use or destroy the handle after that. On any
+	*			other return value the caller keeps ownership of the handle.
+	*
+	* @param	iotHubClientHandle		   	The handle created by a call to the create function.
+	* @param	eventMessageHandle		   	The handle to an IoT Hub message.
+	* @param	eventConfirmationCallback  	The callback specified by the device for receiving
+	* 										confirmation of the delivery of the IoT Hub message.
+	* 										The user can specify a @c NULL value here to
+	* 										indicate that no callback is required.
+	* @param	userContextCallback			User specified context that will be provided to the
+	* 										callback. This can be @c NULL.
+	*
+	*			@b NOTE: The application behavior is undefined if the user calls
+	*			the ::IoTHubClient_LL_Destroy function from within any callback.
+	*
+	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync_TakeOwnership(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback);
+
+	/**
+	* @brief	Asynchronous call to send the @p eventMessageCount messages of
+	* 			@p eventMessageHandles as one group.
+	*
+	*			The messages are cloned and queued in order, all at once: either
+	*			all of them are queued or, on any error, none of them is. The send
+	*			queue limits and the "sendQueueFullPolicy" option apply to the batch
+	*			as a whole.
+	*
+	* @param	iotHubClientHandle		   	The handle created by a call to the create function.
+	* @param	eventMessageHandles		   	An array of @p eventMessageCount IoT Hub message handles.
+	* @param	eventMessageCount		   	The number of messages in the batch, at least 1.
+	* @param	batchConfirmation		   	@c IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE invokes
+	* 										@p eventConfirmationCallback for every message.
+	* 										@c IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE invokes it
+	* 										once, when all the messages are confirmed, with
+	* 										@c IOTHUB_CLIENT_CONFIRMATION_OK if all of them were
+	* 										delivered and with the result of the first message
+	* 										that was not otherwise.
+	* @param	eventConfirmationCallback  	The callback specified by the device for receiving
+	* 										confirmation of the delivery of the messages.
+	* 										The user can specify a @c NULL value here to
+	* 										indicate that no callback is required.
+	* @param	userContextCallback			User specified context that will be provided to the
+	* 										callback. This can be @c NULL.
+	*
+	*			@b NOTE: The application behavior is undefined if the user calls
+	*			the ::IoTHubClient_LL_Destroy function from within any callback.
+	*
+	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventBatchAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback);
+
+	/**
+	* @brief	Same as ::IoTHubClient_LL_SendEventBatchAsync but the messages are
+	* 			not cloned.
+	*
+	*			When the function returns IOTHUB_CLIENT_OK the IoT Hub client takes
+	*			ownership of all the handles in @p eventMessageHandles (not of the
+	*			array itself). On any other return value the caller keeps ownership
+	*			of all of them.
+	*
+	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventBatchAsync_TakeOwnership(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback);
+
 	/**
 	* @brief	This function returns the current sending status for IoTHubClient.
 	*
@@ -262,6 +414,28 @@ extern "C"
 	*/
 	extern IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback);
 
+	/**
+	* @brief	Sets up the callback to be invoked when the number of messages waiting
+	* 			to be sent crosses the watermarks set by the "sendQueueHighWatermark"
+	* 			and "sendQueueLowWatermark" options.
+	*
+	*			The callback is invoked with @c IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK
+	*			when the number of queued messages reaches the high watermark and
+	*			with @c IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK when it goes back down
+	*			to the low watermark.
+	*
+	* @param	iotHubClientHandle		   	The handle created by a call to the create function.
+	* @param	sendQueueCallback	  	   	The callback, @c NULL stops the notifications.
+	* @param	userContextCallback			User specified context that will be provided to the
+	* 										callback. This can be @c NULL.
+	*
+	*			@b NOTE: The application behavior is undefined if the user calls
+	*			the ::IoTHubClient_LL_Destroy function from within any callback.
+	*
+	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetSendQueueCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_SEND_QUEUE_CALLBACK sendQueueCallback, void* userContextCallback);
+
 	/**
 	* @brief	This function returns in the out parameter @p lastMessageReceiveTime
 	* 			what was the value of the @c time function when the last message was
@@ -275,6 +449,32 @@ extern "C"
 	*/
 	extern IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetLastMessageReceiveTime(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, time_t* lastMessageReceiveTime);
 
+	/**
+	* @brief	This function returns in the out parameter @p poolStatistics the
+	* 			counters of the pool that recycles the records the client keeps
+	* 			for every message waiting to be sent.
+	*
+	* @param	iotHubClientHandle		The handle created by a call to the create function.
+	* @param	poolStatistics			Out parameter receiving the counters. When the
+	* 									"messagePoolSize" option has not been set all
+	* 									the counters are 0.
+	*
+	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetPoolStatistics(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_POOL_STATISTICS* poolStatistics);
+
+	/**
+	* @brief	This function returns in the out parameter @p statistics the
+	* 			depths of the send queue and the counters of the messages
+	* 			sent by the client since it was created.
+	*
+	* @param	iotHubClientHandle		The handle created by a call to the create function.
+	* @param	statistics				Out parameter receiving the counters.
+	*
+	* @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetStatistics(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATISTICS* statistics);
+
 	/**
 	* @brief	This function is meant to be called by the user when work
 	* 			(sending/receiving) can be done by the IoTHubClient.
@@ -0,0 +1,53 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_ll_journal.h
+*	@brief	 Disk journal of the events waiting to be sent by IoTHubClient_LL.
+*
+*	@details The journal is a sequence of segment files named <path>.0, <path>.1, ...
+*			 Every event accepted by IoTHubClient_LL is appended to the last segment
+*			 and every event that is completed appends a record that retires it.
+*			 Records are framed with their length and a CRC32, so a record torn by a
+*			 crash is detected and ignored. Segments that only hold retired events are
+*			 deleted; <path>.head remembers the first segment still in use. When the
+*			 journal is created the events that were not retired are handed back so
+*			 that they can be sent again.
+*/
+
+#ifndef DONT_USE_JOURNAL
+
+#ifndef IOTHUB_CLIENT_LL_JOURNAL_H
+#define IOTHUB_CLIENT_LL_JOURNAL_H
+
+#include "iothub_message.h"
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+typedef struct IOTHUB_CLIENT_LL_JOURNAL_DATA_TAG* IOTHUB_CLIENT_LL_JOURNAL_HANDLE;
+
+/*called for every event found in the journal that was not retired. Returns 0 when it took ownership of message, any other value leaves the event in the journal*/
+typedef int(*IOTHUB_CLIENT_LL_JOURNAL_REPLAY_CALLBACK)(IOTHUB_MESSAGE_HANDLE message, uint64_t recordId, void* context);
+
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, IoTHubClient_LL_Journal_Create, const char*, path, size_t, maxSegmentSize, IOTHUB_CLIENT_LL_JOURNAL_REPLAY_CALLBACK, replayCallback, void*, context);
+    MOCKABLE_FUNCTION(, int, IoTHubClient_LL_Journal_Append, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, handle, IOTHUB_MESSAGE_HANDLE, message, uint64_t*, recordId);
+    MOCKABLE_FUNCTION(, int, IoTHubClient_LL_Journal_Retire, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, handle, uint64_t, recordId);
+    MOCKABLE_FUNCTION(, int, IoTHubClient_LL_Journal_Sync, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, handle);
+    MOCKABLE_FUNCTION(, void, IoTHubClient_LL_Journal_Destroy, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, handle);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_LL_JOURNAL_H */
+
+#else
+#error "trying to #include iothub_client_ll_journal.h in the presence of #define DONT_USE_JOURNAL"
+#endif /*DONT_USE_JOURNAL*/
@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_ll_pool.h
+*	@brief	 Fixed-size object pool used by IoTHubClient_LL and the transports
+*			 for the control blocks they allocate for every event.
+*
+*	@details The pool owns one block of memory holding objectCount objects of
+*			 objectSize bytes. Free objects are kept in a list threaded through
+*			 the objects themselves, so taking and returning an object does not
+*			 call the allocator. When all the objects are in use the pool falls
+*			 back to malloc; such objects are given back to free when they are
+*			 returned. The pool counts how many requests it could serve (hits)
+*			 and how many it could not (misses). The pool does not lock.
+*/
+
+#ifndef IOTHUB_CLIENT_LL_POOL_H
+#define IOTHUB_CLIENT_LL_POOL_H
+
+#include "iothub_client_ll.h"
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+typedef struct IOTHUB_CLIENT_LL_POOL_DATA_TAG* IOTHUB_CLIENT_LL_POOL_HANDLE;
+
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_LL_POOL_HANDLE, IoTHubClient_LL_Pool_Create, size_t, objectSize, size_t, objectCount);
+    MOCKABLE_FUNCTION(, void*, IoTHubClient_LL_Pool_Alloc, IOTHUB_CLIENT_LL_POOL_HANDLE, handle);
+    MOCKABLE_FUNCTION(, void, IoTHubClient_LL_Pool_Free, IOTHUB_CLIENT_LL_POOL_HANDLE, handle, void*, object);
+    MOCKABLE_FUNCTION(, int, IoTHubClient_LL_Pool_GetStatistics, IOTHUB_CLIENT_LL_POOL_HANDLE, handle, IOTHUB_CLIENT_POOL_STATISTICS*, statistics);
+    MOCKABLE_FUNCTION(, void, IoTHubClient_LL_Pool_Destroy, IOTHUB_CLIENT_LL_POOL_HANDLE, handle);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_LL_POOL_H */
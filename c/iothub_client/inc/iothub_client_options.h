@@ -16,10 +16,21 @@ extern "C"
         const char* password;
     } IOTHUB_PROXY_OPTIONS;
 
+    typedef struct IOTHUB_ADAPTIVE_POLLING_OPTIONS_TAG
+    {
+        unsigned int maximumPollingTime; /*seconds, the longest the back off can grow to. 0 turns adaptive polling off*/
+        unsigned int requestBudget; /*GET requests per minute for all the devices of the transport. 0 means no budget*/
+    } IOTHUB_ADAPTIVE_POLLING_OPTIONS;
+
     static const char* OPTION_LOG_TRACE = "logtrace";
+    static const char* OPTION_RETRY_INITIAL_DELAY = "retryInitialDelay";
+    static const char* OPTION_RETRY_MAX_DELAY = "retryMaxDelay";
     static const char* OPTION_X509_CERT = "x509certificate";
     static const char* OPTION_X509_PRIVATE_KEY = "x509privatekey";
     static const char* OPTION_KEEP_ALIVE = "keepalive";
+    static const char* OPTION_MQTT_MESSAGE_POOL_SIZE = "mqttMessagePoolSize";
+    static const char* OPTION_MQTT_MAX_IN_FLIGHT = "mqttMaxInFlight";
+    static const char* OPTION_MQTT_TELEMETRY_QOS0 = "mqttTelemetryQos0";
 
     static const char* OPTION_PROXY_HOST = "proxy_address";
     static const char* OPTION_PROXY_USERNAME = "proxy_username";
@@ -28,9 +39,16 @@ extern "C"
     static const char* OPTION_SAS_TOKEN_LIFETIME = "sas_token_lifetime";
     static const char* OPTION_SAS_TOKEN_REFRESH_TIME = "sas_token_refresh_time";
     static const char* OPTION_CBS_REQUEST_TIMEOUT = "cbs_request_timeout";
+    static const char* OPTION_AMQP_INCOMING_WINDOW = "amqp_incoming_window";
+    static const char* OPTION_AMQP_OUTGOING_WINDOW = "amqp_outgoing_window";
+    static const char* OPTION_AMQP_RECEIVER_MAX_MESSAGE_SIZE = "amqp_receiver_max_message_size";
+    static const char* OPTION_AMQP_RECEIVER_LINK_CREDIT = "amqp_receiver_link_credit";
+    static const char* OPTION_AMQP_ADAPTIVE_WINDOWS = "amqp_adaptive_windows";
 
     static const char* OPTION_MIN_POLLING_TIME = "MinimumPollingTime";
     static const char* OPTION_BATCHING = "Batching";
+    static const char* OPTION_CONCURRENT_CONNECTIONS = "ConcurrentConnections";
+    static const char* OPTION_ADAPTIVE_POLLING = "AdaptivePolling";
 
 #ifdef __cplusplus
 }
@@ -41,8 +41,44 @@ typedef struct IOTHUB_MESSAGE_LIST_TAG
     void* context; 
     DLIST_ENTRY entry;
     uint64_t ms_timesOutAfter; /* a value of "0" means "no timeout", if the IOTHUBCLIENT_LL's handle tickcounter > msTimesOutAfer then the message shall timeout*/
+    IOTHUB_CLIENT_LL_HANDLE clientHandle; /*the IoTHubClient_LL that created this record and tracks its timeout*/
+    size_t timeoutHeapIndex; /*position of this record in clientHandle's timeout heap, TIMEOUT_HEAP_INDEX_NONE if the record is not tracked, TIMEOUT_HEAP_INDEX_SUSPENDED while the transport holds it*/
+    size_t queuedSize; /*payload bytes this record takes from clientHandle's send queue budget*/
+    uint64_t journalRecordId; /*record of this message in clientHandle's journal, 0 if the message is not journaled*/
+    uint64_t ms_enqueuedAt; /*clientHandle's tickcounter when the message was queued, ENQUEUED_AT_NONE when its latency is not recorded*/
+    bool isHeldByTransport; /*the transport took the record out of waitingToSend with IoTHubClient_LL_SuspendMessageTimeout and has not given it back yet*/
+    bool isCountedSent; /*the record is already counted in the sent statistics of clientHandle*/
 }IOTHUB_MESSAGE_LIST;
 
+#define TIMEOUT_HEAP_INDEX_NONE ((size_t)-1)
+#define ENQUEUED_AT_NONE ((uint64_t)-1)
+
+/*shall be called by a transport that disposes of an IOTHUB_MESSAGE_LIST without going through IoTHubClient_LL_SendComplete*/
+extern void IoTHubClient_LL_UntrackMessage(IOTHUB_MESSAGE_LIST* messageList);
+
+/*same as IoTHubClient_LL_UntrackMessage for a transport that calls the confirmation callback itself, result is counted in the statistics*/
+extern void IoTHubClient_LL_UntrackCompletedMessage(IOTHUB_MESSAGE_LIST* messageList, IOTHUB_CLIENT_CONFIRMATION_RESULT result);
+
+/*shall be called by a transport that keeps messageList out of waitingToSend after its DoWork returns, the message cannot time out until IoTHubClient_LL_ResumeMessageTimeout.
+The message is counted as sent and in transport, or as a retry when the transport had given it back before*/
+extern void IoTHubClient_LL_SuspendMessageTimeout(IOTHUB_MESSAGE_LIST* messageList);
+
+/*shall be called by a transport right after it puts back in waitingToSend a message whose timeout it suspended*/
+extern void IoTHubClient_LL_ResumeMessageTimeout(IOTHUB_MESSAGE_LIST* messageList);
+
+/*shall be called instead of free by a transport that disposes of an IOTHUB_MESSAGE_LIST without going through IoTHubClient_LL_SendComplete, the record can belong to a message pool*/
+extern void IoTHubClient_LL_ReleaseMessageList(IOTHUB_MESSAGE_LIST* messageList);
+
+/*returns true when the last IoTHubClient_LL_SendEventAsync(_TakeOwnership) was refused only because the send queue had no room for the message*/
+extern bool IoTHubClient_LL_WasSendQueueFull(IOTHUB_CLIENT_LL_HANDLE handle);
+
+/*shall be called by a transport every time it publishes again a message it keeps, or attempts again a connection or a request the retry policy made it wait for*/
+extern void IoTHubClient_LL_CountRetry(IOTHUB_CLIENT_LL_HANDLE handle);
+
+/*callback is called every time a message gives back its room in the send queue, on the thread that completes the message*/
+typedef void(*IOTHUB_CLIENT_LL_SEND_QUEUE_ROOM_CALLBACK)(void* context);
+extern void IoTHubClient_LL_SetSendQueueRoomCallback(IOTHUB_CLIENT_LL_HANDLE handle, IOTHUB_CLIENT_LL_SEND_QUEUE_ROOM_CALLBACK callback, void* context);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,65 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_retry_policy.h
+*	@brief	 Exponential backoff with full jitter used by the transports to
+*			 pace the attempts to reach IoT Hub after a failure.
+*
+*	@details A transport keeps one IOTHUB_CLIENT_RETRY_POLICY in its state for
+*			 every connection it retries. After the n-th failure in a row the
+*			 transport waits a random delay between 0 and
+*			 min(initialDelayInMs * 2^(n-1), maxDelayInMs) milliseconds before
+*			 the next attempt, so the devices that lost IoT Hub at the same time
+*			 do not come back in lockstep. A success resets the policy. The wait
+*			 starts the first time the transport asks whether it can attempt
+*			 again, so reporting a failure does not need to read a clock.
+*			 A maxDelayInMs of 0 retries at once. The policy does not lock.
+*
+*			 Every policy draws its delays from its own xorshift64 generator,
+*			 seeded from the address of the policy, the text passed to
+*			 IoTHubClient_RetryPolicy_Seed (the transports pass the device id)
+*			 and the time at which every wait starts.
+*/
+
+#ifndef IOTHUB_CLIENT_RETRY_POLICY_H
+#define IOTHUB_CLIENT_RETRY_POLICY_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+#define IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_INITIAL_DELAY 1000 /*milliseconds*/
+#define IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_MAX_DELAY 30000 /*milliseconds*/
+
+typedef struct IOTHUB_CLIENT_RETRY_POLICY_TAG
+{
+    size_t initialDelayInMs; /*"retryInitialDelay", the longest wait after the first failure*/
+    size_t maxDelayInMs; /*"retryMaxDelay", the longest wait after any failure*/
+    size_t failureCount; /*failures since the last success*/
+    size_t delayInMs; /*the wait drawn for the last failure*/
+    bool isWaiting;
+    bool isWaitStarted;
+    uint64_t waitStartInMs;
+    uint64_t randomState; /*xorshift64 state of this policy, never 0*/
+} IOTHUB_CLIENT_RETRY_POLICY;
+
+    MOCKABLE_FUNCTION(, void, IoTHubClient_RetryPolicy_Init, IOTHUB_CLIENT_RETRY_POLICY*, policy);
+    MOCKABLE_FUNCTION(, void, IoTHubClient_RetryPolicy_Seed, IOTHUB_CLIENT_RETRY_POLICY*, policy, const char*, seed);
+    MOCKABLE_FUNCTION(, bool, IoTHubClient_RetryPolicy_SetOption, IOTHUB_CLIENT_RETRY_POLICY*, policy, const char*, optionName, const void*, value);
+    MOCKABLE_FUNCTION(, void, IoTHubClient_RetryPolicy_OnFailure, IOTHUB_CLIENT_RETRY_POLICY*, policy);
+    MOCKABLE_FUNCTION(, void, IoTHubClient_RetryPolicy_OnSuccess, IOTHUB_CLIENT_RETRY_POLICY*, policy);
+    MOCKABLE_FUNCTION(, bool, IoTHubClient_RetryPolicy_IsWaiting, const IOTHUB_CLIENT_RETRY_POLICY*, policy);
+    MOCKABLE_FUNCTION(, bool, IoTHubClient_RetryPolicy_CanAttempt, IOTHUB_CLIENT_RETRY_POLICY*, policy, uint64_t, currentTimeInMs);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_RETRY_POLICY_H */
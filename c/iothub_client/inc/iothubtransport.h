@@ -5,6 +5,7 @@
 #define IOTHUB_TRANSPORT_H
 
 typedef struct TRANSPORT_HANDLE_DATA_TAG* TRANSPORT_HANDLE;
+typedef struct TRANSPORT_POOL_DATA_TAG* TRANSPORT_POOL_HANDLE;
 
 #include "azure_c_shared_utility/lock.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
@@ -24,6 +25,17 @@ extern TRANSPORT_LL_HANDLE	IoTHubTransport_GetLLTransport(TRANSPORT_HANDLE trans
 extern IOTHUB_CLIENT_RESULT IoTHubTransport_StartWorkerThread(TRANSPORT_HANDLE transportHandle, IOTHUB_CLIENT_HANDLE clientHandle);
 extern bool					IoTHubTransport_SignalEndWorkerThread(TRANSPORT_HANDLE transportHandle, IOTHUB_CLIENT_HANDLE clientHandle);
 extern void					IoTHubTransport_JoinWorkerThread(TRANSPORT_HANDLE transportHandle, IOTHUB_CLIENT_HANDLE clientHandle);
+extern IOTHUB_CLIENT_RESULT IoTHubTransport_SetWorkerIdleWaitTime(TRANSPORT_HANDLE transportHandle, unsigned int idleWaitTime);
+extern void					IoTHubTransport_SignalWorkerThread(TRANSPORT_HANDLE transportHandle);
+
+/*a pool of transports, each with its own lower layer transport, lock and worker thread; devices are spread over them by device id*/
+extern TRANSPORT_POOL_HANDLE	IoTHubTransport_CreatePool(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix, size_t transportCount);
+extern void					IoTHubTransport_DestroyPool(TRANSPORT_POOL_HANDLE poolHandle);
+extern TRANSPORT_HANDLE		IoTHubTransport_GetPoolTransport(TRANSPORT_POOL_HANDLE poolHandle, const char* deviceId);
+
+/*implemented by IoTHubClient, used by the worker thread which already holds the lock shared with the IoTHubClient*/
+extern IOTHUB_CLIENT_RESULT IoTHubClient_GetSendStatus_NoLock(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus);
+extern void IoTHubClient_DrainSendHandoff_NoLock(IOTHUB_CLIENT_HANDLE iotHubClientHandle);
 
 #ifdef __cplusplus
 }
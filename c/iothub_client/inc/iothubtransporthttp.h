@@ -11,8 +11,29 @@ extern "C"
 {
 #endif
 
+	/** @brief	This struct is filled by ::IoTHubTransportHttp_GetPollingStatistics
+	*			with the counters of the GET requests of all the devices of the
+	*			transport. The counters only move while the "AdaptivePolling"
+	*			option is on.
+	*/
+	typedef struct IOTHUB_HTTP_POLLING_STATISTICS_TAG
+	{
+		uint64_t polls;             /**< GET requests sent */
+		uint64_t messages;          /**< GET requests answered with a message */
+		uint64_t emptyPolls;        /**< GET requests answered without a message */
+		uint64_t deferredByBudget;  /**< devices whose GET request was put off because the request budget of the minute was spent, once per device and minute */
+		uint64_t fixedPolicyPolls;  /**< estimate of the GET requests "MinimumPollingTime" alone would have sent in the same time */
+		uint64_t requestsSaved;     /**< fixedPolicyPolls - polls, or 0 when the adaptive policy sent more */
+	} IOTHUB_HTTP_POLLING_STATISTICS;
+
 	extern const TRANSPORT_PROVIDER* HTTP_Protocol(void);
 
+	/** @brief	Fills @p statistics with the polling counters of the HTTP transport
+	*			@p handle, as returned by ::IoTHubTransport_GetLLTransport for a
+	*			shared transport.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetPollingStatistics(TRANSPORT_LL_HANDLE handle, IOTHUB_HTTP_POLLING_STATISTICS* statistics);
+
 #ifdef __cplusplus
 }
 #endif
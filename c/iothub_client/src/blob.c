@@ -11,7 +11,8 @@
 
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/xlogging.h"
-#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/strings.h"
+#include "iothub_base64.h"
 
 /*a block has 4MB*/
 #define BLOCK_SIZE (4*1024*1024)
@@ -178,99 +179,91 @@ BLOB_RESULT Blob_UploadFromSasUri(const char* SASURI, const unsigned char* sourc
                                         }
                                         else
                                         {
-                                            STRING_HANDLE blockIdString = Base64_Encode_Bytes((const unsigned char*)temp, 6);
-                                            if (blockIdString == NULL)
+                                            /*6 bytes are 8 base64 characters, without padding*/
+                                            char blockIdString[9];
+                                            *IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET_STANDARD, (const unsigned char*)temp, 6, blockIdString) = '\0';
+
+                                            /*add the blockId base64 encoded to the XML*/
+                                            if (!(
+                                                (STRING_concat(xml, "<Latest>")==0) &&
+                                                (STRING_concat(xml, blockIdString)==0) &&
+                                                (STRING_concat(xml, "</Latest>") == 0)
+                                                ))
                                             {
                                                 /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                LogError("unable to Base64_Encode_Bytes");
+                                                LogError("unable to STRING_concat");
                                                 result = BLOB_ERROR;
                                                 isError = 1;
                                             }
                                             else
                                             {
-                                                /*add the blockId base64 encoded to the XML*/
-                                                if (!(
-                                                    (STRING_concat(xml, "<Latest>")==0) &&
-                                                    (STRING_concat_with_STRING(xml, blockIdString)==0) &&
-                                                    (STRING_concat(xml, "</Latest>") == 0)
-                                                    ))
+                                                /*Codes_SRS_BLOB_02_022: [ Blob_UploadFromSasUri shall construct a new relativePath from following string: base relativePath + "&comp=block&blockid=BASE64 encoded string of blockId" ]*/
+                                                STRING_HANDLE newRelativePath = STRING_construct(relativePath);
+                                                if (newRelativePath == NULL)
                                                 {
                                                     /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                    LogError("unable to STRING_concat");
+                                                    LogError("unable to STRING_construct");
                                                     result = BLOB_ERROR;
                                                     isError = 1;
                                                 }
                                                 else
                                                 {
-                                                    /*Codes_SRS_BLOB_02_022: [ Blob_UploadFromSasUri shall construct a new relativePath from following string: base relativePath + "&comp=block&blockid=BASE64 encoded string of blockId" ]*/
-                                                    STRING_HANDLE newRelativePath = STRING_construct(relativePath);
-                                                    if (newRelativePath == NULL)
+                                                    if (!(
+                                                        (STRING_concat(newRelativePath, "&comp=block&blockid=") == 0) &&
+                                                        (STRING_concat(newRelativePath, blockIdString) == 0)
+                                                        ))
                                                     {
                                                         /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                        LogError("unable to STRING_construct");
+                                                        LogError("unable to STRING concatenate");
                                                         result = BLOB_ERROR;
                                                         isError = 1;
                                                     }
                                                     else
                                                     {
-                                                        if (!(
-                                                            (STRING_concat(newRelativePath, "&comp=block&blockid=") == 0) &&
-                                                            (STRING_concat_with_STRING(newRelativePath, blockIdString) == 0)
-                                                            ))
+                                                        /*Codes_SRS_BLOB_02_023: [ Blob_UploadFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
+                                                        BUFFER_HANDLE requestContent = BUFFER_create(source + (size - toUpload), thisBlockSize);
+                                                        if (requestContent == NULL)
                                                         {
                                                             /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                            LogError("unable to STRING concatenate");
+                                                            LogError("unable to BUFFER_create");
                                                             result = BLOB_ERROR;
                                                             isError = 1;
                                                         }
                                                         else
                                                         {
-                                                            /*Codes_SRS_BLOB_02_023: [ Blob_UploadFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
-                                                            BUFFER_HANDLE requestContent = BUFFER_create(source + (size - toUpload), thisBlockSize);
-                                                            if (requestContent == NULL)
+                                                            /*Codes_SRS_BLOB_02_024: [ Blob_UploadFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing httpStatus and httpResponse. ]*/
+                                                            if (HTTPAPIEX_ExecuteRequest(
+                                                                httpApiExHandle,
+                                                                HTTPAPI_REQUEST_PUT,
+                                                                STRING_c_str(newRelativePath),
+                                                                NULL,
+                                                                requestContent,
+                                                                httpStatus,
+                                                                NULL,
+                                                                httpResponse) != HTTPAPIEX_OK
+                                                                )
+                                                            {
+                                                                /*Codes_SRS_BLOB_02_025: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
+                                                                LogError("unable to HTTPAPIEX_ExecuteRequest");
+                                                                result = BLOB_HTTP_ERROR;
+                                                                isError = 1;
+                                                            }
+                                                            else if (*httpStatus >= 300)
                                                             {
-                                                                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                                LogError("unable to BUFFER_create");
-                                                                result = BLOB_ERROR;
+                                                                /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadFromSasUri shall succeed and return BLOB_OK. ]*/
+                                                                LogError("HTTP status from storage does not indicate success (%d)", (int)*httpStatus);
+                                                                result = BLOB_OK;
                                                                 isError = 1;
                                                             }
                                                             else
                                                             {
-                                                                /*Codes_SRS_BLOB_02_024: [ Blob_UploadFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing httpStatus and httpResponse. ]*/
-                                                                if (HTTPAPIEX_ExecuteRequest(
-                                                                    httpApiExHandle,
-                                                                    HTTPAPI_REQUEST_PUT,
-                                                                    STRING_c_str(newRelativePath),
-                                                                    NULL,
-                                                                    requestContent,
-                                                                    httpStatus,
-                                                                    NULL,
-                                                                    httpResponse) != HTTPAPIEX_OK
-                                                                    )
-                                                                {
-                                                                    /*Codes_SRS_BLOB_02_025: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
-                                                                    LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                                                    result = BLOB_HTTP_ERROR;
-                                                                    isError = 1;
-                                                                }
-                                                                else if (*httpStatus >= 300)
-                                                                {
-                                                                    /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadFromSasUri shall succeed and return BLOB_OK. ]*/
-                                                                    LogError("HTTP status from storage does not indicate success (%d)", (int)*httpStatus);
-                                                                    result = BLOB_OK;
-                                                                    isError = 1;
-                                                                }
-                                                                else
-                                                                {
-                                                                    /*Codes_SRS_BLOB_02_027: [ Otherwise Blob_UploadFromSasUri shall continue execution. ]*/
-                                                                }
-                                                                BUFFER_delete(requestContent);
+                                                                /*Codes_SRS_BLOB_02_027: [ Otherwise Blob_UploadFromSasUri shall continue execution. ]*/
                                                             }
+                                                            BUFFER_delete(requestContent);
                                                         }
-                                                        STRING_delete(newRelativePath);
                                                     }
+                                                    STRING_delete(newRelativePath);
                                                 }
-                                                STRING_delete(blockIdString);
                                             }
                                         }
 
@@ -0,0 +1,569 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include <string.h>
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "iothub_base64.h"
+
+/*the vector implementations are compiled where the compiler can generate them without a command line flag for the whole file*/
+#if !defined(IOTHUB_BASE64_NO_SIMD)
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define BASE64_USE_X86
+#include <immintrin.h>
+#define BASE64_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define BASE64_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define BASE64_USE_X86
+#include <intrin.h>
+#include <immintrin.h>
+#define BASE64_TARGET_SSSE3
+#define BASE64_TARGET_AVX2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+/*Advanced SIMD is part of every AArch64 CPU*/
+#define BASE64_USE_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+typedef struct BASE64_ALPHABET_TAG
+{
+    const char* characters; /*the 64 characters, in the order of their values*/
+    char character62;
+    char character63;
+} BASE64_ALPHABET;
+
+static const BASE64_ALPHABET standardAlphabet = { "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/", '+', '/' };
+static const BASE64_ALPHABET urlAlphabet = { "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_", '-', '_' };
+
+typedef char* (*BASE64_ENCODE)(const BASE64_ALPHABET* alphabet, const unsigned char* source, size_t size, char* destination);
+typedef size_t (*BASE64_DECODE_GROUPS)(const BASE64_ALPHABET* alphabet, const char* source, size_t length, unsigned char* destination);
+
+static char* encodeScalar(const BASE64_ALPHABET* alphabet, const unsigned char* source, size_t size, char* destination)
+{
+    const char* characters = alphabet->characters;
+    size_t i;
+    for (i = 0; i + 2 < size; i += 3)
+    {
+        *destination++ = characters[source[i] >> 2];
+        *destination++ = characters[((source[i] & 0x03) << 4) | (source[i + 1] >> 4)];
+        *destination++ = characters[((source[i + 1] & 0x0F) << 2) | (source[i + 2] >> 6)];
+        *destination++ = characters[source[i + 2] & 0x3F];
+    }
+    if (i + 1 == size)
+    {
+        *destination++ = characters[source[i] >> 2];
+        *destination++ = characters[(source[i] & 0x03) << 4];
+        *destination++ = '=';
+        *destination++ = '=';
+    }
+    else if (i + 2 == size)
+    {
+        *destination++ = characters[source[i] >> 2];
+        *destination++ = characters[((source[i] & 0x03) << 4) | (source[i + 1] >> 4)];
+        *destination++ = characters[(source[i + 1] & 0x0F) << 2];
+        *destination++ = '=';
+    }
+    return destination;
+}
+
+/*returns the value of c, or 64 when c is not in the alphabet*/
+static unsigned int valueOf(const BASE64_ALPHABET* alphabet, char c)
+{
+    unsigned int result;
+    if (('A' <= c) && (c <= 'Z'))
+    {
+        result = (unsigned int)(c - 'A');
+    }
+    else if (('a' <= c) && (c <= 'z'))
+    {
+        result = (unsigned int)(c - 'a') + 26;
+    }
+    else if (('0' <= c) && (c <= '9'))
+    {
+        result = (unsigned int)(c - '0') + 52;
+    }
+    else if (c == alphabet->character62)
+    {
+        result = 62;
+    }
+    else if (c == alphabet->character63)
+    {
+        result = 63;
+    }
+    else
+    {
+        result = 64;
+    }
+    return result;
+}
+
+static size_t decodeGroupsScalar(const BASE64_ALPHABET* alphabet, const char* source, size_t length, unsigned char* destination)
+{
+    size_t consumed = 0;
+    while (length - consumed >= 4)
+    {
+        unsigned int v0 = valueOf(alphabet, source[consumed]);
+        unsigned int v1 = valueOf(alphabet, source[consumed + 1]);
+        unsigned int v2 = valueOf(alphabet, source[consumed + 2]);
+        unsigned int v3 = valueOf(alphabet, source[consumed + 3]);
+        if ((v0 | v1 | v2 | v3) > 63)
+        {
+            break;
+        }
+        *destination++ = (unsigned char)((v0 << 2) | (v1 >> 4));
+        *destination++ = (unsigned char)((v1 << 4) | (v2 >> 2));
+        *destination++ = (unsigned char)((v2 << 6) | v3);
+        consumed += 4;
+    }
+    return consumed;
+}
+
+#ifdef BASE64_USE_X86
+/*the vector code follows W. Mula and D. Lemire, "Faster Base64 Encoding and Decoding Using AVX2 Instructions"*/
+
+/*maps the 6 bit values in indices to their characters: 0..25 get 'A', 26..51 get 'a' - 26, 52..61 get '0' - 52, 62 and 63 get their own offsets*/
+BASE64_TARGET_SSSE3 static __m128i shiftTableSSSE3(const BASE64_ALPHABET* alphabet)
+{
+    return _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        (char)(alphabet->character62 - 62), (char)(alphabet->character63 - 63), 'A', 0, 0);
+}
+
+BASE64_TARGET_SSSE3 static __m128i encode12SSSE3(__m128i input, __m128i shiftTable)
+{
+    /*every 3 bytes are spread over 4 bytes, each of them receives its 6 bits*/
+    __m128i spread = _mm_shuffle_epi8(input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(spread, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i t1 = _mm_mullo_epi16(_mm_and_si128(spread, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    __m128i indices = _mm_or_si128(t0, t1);
+
+    __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i isUpper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    reduced = _mm_or_si128(reduced, _mm_and_si128(isUpper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(indices, _mm_shuffle_epi8(shiftTable, reduced));
+}
+
+BASE64_TARGET_SSSE3 static char* encodeSSSE3(const BASE64_ALPHABET* alphabet, const unsigned char* source, size_t size, char* destination)
+{
+    __m128i shiftTable = shiftTableSSSE3(alphabet);
+    /*12 bytes are encoded at a time, but 16 are loaded*/
+    while (size >= 16)
+    {
+        _mm_storeu_si128((__m128i*)destination, encode12SSSE3(_mm_loadu_si128((const __m128i*)source), shiftTable));
+        source += 12;
+        size -= 12;
+        destination += 16;
+    }
+    return encodeScalar(alphabet, source, size, destination);
+}
+
+/*returns the 6 bit values of the characters in input, and sets *isValid to 0 if one of them is not in the alphabet*/
+BASE64_TARGET_SSSE3 static __m128i valuesSSSE3(const BASE64_ALPHABET* alphabet, __m128i input, int* isValid)
+{
+    __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi8(input, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), input));
+    __m128i isLower = _mm_and_si128(_mm_cmpgt_epi8(input, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), input));
+    __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(input, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), input));
+    __m128i is62 = _mm_cmpeq_epi8(input, _mm_set1_epi8(alphabet->character62));
+    __m128i is63 = _mm_cmpeq_epi8(input, _mm_set1_epi8(alphabet->character63));
+    __m128i shift = _mm_or_si128(
+        _mm_or_si128(_mm_and_si128(isUpper, _mm_set1_epi8(-'A')), _mm_and_si128(isLower, _mm_set1_epi8(26 - 'a'))),
+        _mm_or_si128(_mm_and_si128(isDigit, _mm_set1_epi8(52 - '0')),
+            _mm_or_si128(_mm_and_si128(is62, _mm_set1_epi8((char)(62 - alphabet->character62))), _mm_and_si128(is63, _mm_set1_epi8((char)(63 - alphabet->character63))))));
+    __m128i valid = _mm_or_si128(_mm_or_si128(isUpper, isLower), _mm_or_si128(isDigit, _mm_or_si128(is62, is63)));
+    *isValid = (_mm_movemask_epi8(valid) == 0xFFFF);
+    return _mm_add_epi8(input, shift);
+}
+
+/*packs the 4 values of 6 bits of every 32 bit lane in 3 bytes, the 12 bytes are at the start of the result*/
+BASE64_TARGET_SSSE3 static __m128i packSSSE3(__m128i values)
+{
+    __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+BASE64_TARGET_SSSE3 static void store12SSSE3(unsigned char* destination, __m128i packed)
+{
+    int last = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+    _mm_storel_epi64((__m128i*)destination, packed);
+    (void)memcpy(destination + 8, &last, 4);
+}
+
+BASE64_TARGET_SSSE3 static size_t decodeGroupsSSSE3(const BASE64_ALPHABET* alphabet, const char* source, size_t length, unsigned char* destination)
+{
+    size_t consumed = 0;
+    while (length - consumed >= 16)
+    {
+        int isValid;
+        __m128i values = valuesSSSE3(alphabet, _mm_loadu_si128((const __m128i*)(source + consumed)), &isValid);
+        if (!isValid)
+        {
+            /*the scalar code finds which group stops the decoding*/
+            break;
+        }
+        store12SSSE3(destination, packSSSE3(values));
+        consumed += 16;
+        destination += 12;
+    }
+    return consumed + decodeGroupsScalar(alphabet, source + consumed, length - consumed, destination);
+}
+
+BASE64_TARGET_AVX2 static char* encodeAVX2(const BASE64_ALPHABET* alphabet, const unsigned char* source, size_t size, char* destination)
+{
+    __m128i shiftTable128 = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        (char)(alphabet->character62 - 62), (char)(alphabet->character63 - 63), 'A', 0, 0);
+    __m128i spread128 = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    __m256i shiftTable = _mm256_inserti128_si256(_mm256_castsi128_si256(shiftTable128), shiftTable128, 1);
+    __m256i spreadTable = _mm256_inserti128_si256(_mm256_castsi128_si256(spread128), spread128, 1);
+    /*24 bytes are encoded at a time, 12 in every 128 bit lane, and the load of the second lane reads 4 bytes past them*/
+    while (size >= 28)
+    {
+        __m256i input = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)source)), _mm_loadu_si128((const __m128i*)(source + 12)), 1);
+        __m256i spread = _mm256_shuffle_epi8(input, spreadTable);
+        __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(spread, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(spread, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t0, t1);
+        __m256i reduced = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i isUpper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        reduced = _mm256_or_si256(reduced, _mm256_and_si256(isUpper, _mm256_set1_epi8(13)));
+        _mm256_storeu_si256((__m256i*)destination, _mm256_add_epi8(indices, _mm256_shuffle_epi8(shiftTable, reduced)));
+        source += 24;
+        size -= 24;
+        destination += 32;
+    }
+    return encodeSSSE3(alphabet, source, size, destination);
+}
+
+BASE64_TARGET_AVX2 static size_t decodeGroupsAVX2(const BASE64_ALPHABET* alphabet, const char* source, size_t length, unsigned char* destination)
+{
+    size_t consumed = 0;
+    while (length - consumed >= 32)
+    {
+        __m256i input = _mm256_loadu_si256((const __m256i*)(source + consumed));
+        __m256i isUpper = _mm256_and_si256(_mm256_cmpgt_epi8(input, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), input));
+        __m256i isLower = _mm256_and_si256(_mm256_cmpgt_epi8(input, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), input));
+        __m256i isDigit = _mm256_and_si256(_mm256_cmpgt_epi8(input, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), input));
+        __m256i is62 = _mm256_cmpeq_epi8(input, _mm256_set1_epi8(alphabet->character62));
+        __m256i is63 = _mm256_cmpeq_epi8(input, _mm256_set1_epi8(alphabet->character63));
+        __m256i valid = _mm256_or_si256(_mm256_or_si256(isUpper, isLower), _mm256_or_si256(isDigit, _mm256_or_si256(is62, is63)));
+        if ((unsigned int)_mm256_movemask_epi8(valid) != 0xFFFFFFFFu)
+        {
+            break;
+        }
+        else
+        {
+            __m256i shift = _mm256_or_si256(
+                _mm256_or_si256(_mm256_and_si256(isUpper, _mm256_set1_epi8(-'A')), _mm256_and_si256(isLower, _mm256_set1_epi8(26 - 'a'))),
+                _mm256_or_si256(_mm256_and_si256(isDigit, _mm256_set1_epi8(52 - '0')),
+                    _mm256_or_si256(_mm256_and_si256(is62, _mm256_set1_epi8((char)(62 - alphabet->character62))), _mm256_and_si256(is63, _mm256_set1_epi8((char)(63 - alphabet->character63))))));
+            __m256i merged = _mm256_maddubs_epi16(_mm256_add_epi8(input, shift), _mm256_set1_epi32(0x01400140));
+            merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+            __m128i order = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+            __m256i packed = _mm256_shuffle_epi8(merged, _mm256_inserti128_si256(_mm256_castsi128_si256(order), order, 1));
+            store12SSSE3(destination, _mm256_castsi256_si128(packed));
+            store12SSSE3(destination + 12, _mm256_extracti128_si256(packed, 1));
+            consumed += 32;
+            destination += 24;
+        }
+    }
+    return consumed + decodeGroupsSSSE3(alphabet, source + consumed, length - consumed, destination);
+}
+
+static int cpuHasSSSE3 = -1;
+static int cpuHasAVX2 = -1;
+
+static void detectCPU(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 1)
+    {
+        cpuHasSSSE3 = 0;
+        cpuHasAVX2 = 0;
+    }
+    else
+    {
+        int maximumLeaf = info[0];
+        __cpuid(info, 1);
+        cpuHasSSSE3 = (info[2] & (1 << 9)) != 0;
+        /*AVX2 also needs the OS to save the YMM registers (OSXSAVE, then XCR0 bits 1 and 2)*/
+        if ((maximumLeaf >= 7) && ((info[2] & (1 << 27)) != 0) && ((info[2] & (1 << 28)) != 0) && ((_xgetbv(0) & 6) == 6))
+        {
+            __cpuidex(info, 7, 0);
+            cpuHasAVX2 = (info[1] & (1 << 5)) != 0;
+        }
+        else
+        {
+            cpuHasAVX2 = 0;
+        }
+    }
+#else
+    /*__builtin_cpu_supports checks the OS support of the YMM registers too*/
+    __builtin_cpu_init();
+    cpuHasSSSE3 = __builtin_cpu_supports("ssse3") ? 1 : 0;
+    cpuHasAVX2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+}
+#endif
+
+#ifdef BASE64_USE_NEON
+static uint8x16x4_t characterTableNEON(const BASE64_ALPHABET* alphabet)
+{
+    uint8x16x4_t result;
+    result.val[0] = vld1q_u8((const uint8_t*)alphabet->characters);
+    result.val[1] = vld1q_u8((const uint8_t*)alphabet->characters + 16);
+    result.val[2] = vld1q_u8((const uint8_t*)alphabet->characters + 32);
+    result.val[3] = vld1q_u8((const uint8_t*)alphabet->characters + 48);
+    return result;
+}
+
+static char* encodeNEON(const BASE64_ALPHABET* alphabet, const unsigned char* source, size_t size, char* destination)
+{
+    uint8x16x4_t characters = characterTableNEON(alphabet);
+    uint8x16_t mask = vdupq_n_u8(0x3F);
+    /*48 bytes are encoded at a time, the loads and the stores interleave them*/
+    while (size >= 48)
+    {
+        uint8x16x3_t input = vld3q_u8(source);
+        uint8x16x4_t output;
+        output.val[0] = vqtbl4q_u8(characters, vshrq_n_u8(input.val[0], 2));
+        output.val[1] = vqtbl4q_u8(characters, vandq_u8(vorrq_u8(vshlq_n_u8(input.val[0], 4), vshrq_n_u8(input.val[1], 4)), mask));
+        output.val[2] = vqtbl4q_u8(characters, vandq_u8(vorrq_u8(vshlq_n_u8(input.val[1], 2), vshrq_n_u8(input.val[2], 6)), mask));
+        output.val[3] = vqtbl4q_u8(characters, vandq_u8(input.val[2], mask));
+        vst4q_u8((uint8_t*)destination, output);
+        source += 48;
+        size -= 48;
+        destination += 64;
+    }
+    return encodeScalar(alphabet, source, size, destination);
+}
+
+/*returns the 6 bit values of the characters in input, and clears the bytes of *valid for the characters that are not in the alphabet*/
+static uint8x16_t valuesNEON(const BASE64_ALPHABET* alphabet, uint8x16_t input, uint8x16_t* valid)
+{
+    uint8x16_t isUpper = vandq_u8(vcgeq_u8(input, vdupq_n_u8('A')), vcleq_u8(input, vdupq_n_u8('Z')));
+    uint8x16_t isLower = vandq_u8(vcgeq_u8(input, vdupq_n_u8('a')), vcleq_u8(input, vdupq_n_u8('z')));
+    uint8x16_t isDigit = vandq_u8(vcgeq_u8(input, vdupq_n_u8('0')), vcleq_u8(input, vdupq_n_u8('9')));
+    uint8x16_t is62 = vceqq_u8(input, vdupq_n_u8((uint8_t)alphabet->character62));
+    uint8x16_t is63 = vceqq_u8(input, vdupq_n_u8((uint8_t)alphabet->character63));
+    uint8x16_t shift = vorrq_u8(
+        vorrq_u8(vandq_u8(isUpper, vdupq_n_u8((uint8_t)-'A')), vandq_u8(isLower, vdupq_n_u8((uint8_t)(26 - 'a')))),
+        vorrq_u8(vandq_u8(isDigit, vdupq_n_u8((uint8_t)(52 - '0'))),
+            vorrq_u8(vandq_u8(is62, vdupq_n_u8((uint8_t)(62 - alphabet->character62))), vandq_u8(is63, vdupq_n_u8((uint8_t)(63 - alphabet->character63))))));
+    *valid = vandq_u8(*valid, vorrq_u8(vorrq_u8(isUpper, isLower), vorrq_u8(isDigit, vorrq_u8(is62, is63))));
+    return vaddq_u8(input, shift);
+}
+
+static size_t decodeGroupsNEON(const BASE64_ALPHABET* alphabet, const char* source, size_t length, unsigned char* destination)
+{
+    size_t consumed = 0;
+    while (length - consumed >= 64)
+    {
+        uint8x16x4_t input = vld4q_u8((const uint8_t*)source + consumed);
+        uint8x16_t valid = vdupq_n_u8(0xFF);
+        uint8x16_t v0 = valuesNEON(alphabet, input.val[0], &valid);
+        uint8x16_t v1 = valuesNEON(alphabet, input.val[1], &valid);
+        uint8x16_t v2 = valuesNEON(alphabet, input.val[2], &valid);
+        uint8x16_t v3 = valuesNEON(alphabet, input.val[3], &valid);
+        if (vminvq_u8(valid) != 0xFF)
+        {
+            break;
+        }
+        else
+        {
+            uint8x16x3_t output;
+            output.val[0] = vorrq_u8(vshlq_n_u8(v0, 2), vshrq_n_u8(v1, 4));
+            output.val[1] = vorrq_u8(vshlq_n_u8(v1, 4), vshrq_n_u8(v2, 2));
+            output.val[2] = vorrq_u8(vshlq_n_u8(v2, 6), v3);
+            vst3q_u8(destination, output);
+            consumed += 64;
+            destination += 48;
+        }
+    }
+    return consumed + decodeGroupsScalar(alphabet, source + consumed, length - consumed, destination);
+}
+#endif
+
+static int isImplementationSupported(IOTHUB_BASE64_IMPLEMENTATION implementation)
+{
+    int result;
+    switch (implementation)
+    {
+    case IOTHUB_BASE64_IMPLEMENTATION_SCALAR:
+        result = 1;
+        break;
+#ifdef BASE64_USE_X86
+    case IOTHUB_BASE64_IMPLEMENTATION_SSSE3:
+        if (cpuHasSSSE3 == -1)
+        {
+            detectCPU();
+        }
+        result = cpuHasSSSE3;
+        break;
+    case IOTHUB_BASE64_IMPLEMENTATION_AVX2:
+        if (cpuHasAVX2 == -1)
+        {
+            detectCPU();
+        }
+        result = cpuHasAVX2;
+        break;
+#endif
+#ifdef BASE64_USE_NEON
+    case IOTHUB_BASE64_IMPLEMENTATION_NEON:
+        result = 1;
+        break;
+#endif
+    default:
+        result = 0;
+        break;
+    }
+    return result;
+}
+
+/*the implementation is chosen on the first call. Threads racing on that first call all compute and store the same values,
+and every function pointer is read once, so a thread sees either NULL or a usable function*/
+static IOTHUB_BASE64_IMPLEMENTATION selectedImplementation = IOTHUB_BASE64_IMPLEMENTATION_SCALAR;
+static BASE64_ENCODE selectedEncode = NULL;
+static BASE64_DECODE_GROUPS selectedDecodeGroups = NULL;
+
+static void selectImplementation(IOTHUB_BASE64_IMPLEMENTATION implementation)
+{
+    switch (implementation)
+    {
+#ifdef BASE64_USE_X86
+    case IOTHUB_BASE64_IMPLEMENTATION_SSSE3:
+        selectedEncode = encodeSSSE3;
+        selectedDecodeGroups = decodeGroupsSSSE3;
+        break;
+    case IOTHUB_BASE64_IMPLEMENTATION_AVX2:
+        selectedEncode = encodeAVX2;
+        selectedDecodeGroups = decodeGroupsAVX2;
+        break;
+#endif
+#ifdef BASE64_USE_NEON
+    case IOTHUB_BASE64_IMPLEMENTATION_NEON:
+        selectedEncode = encodeNEON;
+        selectedDecodeGroups = decodeGroupsNEON;
+        break;
+#endif
+    default:
+        selectedEncode = encodeScalar;
+        selectedDecodeGroups = decodeGroupsScalar;
+        break;
+    }
+    selectedImplementation = implementation;
+}
+
+static void selectFastest(void)
+{
+    if (isImplementationSupported(IOTHUB_BASE64_IMPLEMENTATION_AVX2))
+    {
+        selectImplementation(IOTHUB_BASE64_IMPLEMENTATION_AVX2);
+    }
+    else if (isImplementationSupported(IOTHUB_BASE64_IMPLEMENTATION_SSSE3))
+    {
+        selectImplementation(IOTHUB_BASE64_IMPLEMENTATION_SSSE3);
+    }
+    else if (isImplementationSupported(IOTHUB_BASE64_IMPLEMENTATION_NEON))
+    {
+        selectImplementation(IOTHUB_BASE64_IMPLEMENTATION_NEON);
+    }
+    else
+    {
+        selectImplementation(IOTHUB_BASE64_IMPLEMENTATION_SCALAR);
+    }
+}
+
+static const BASE64_ALPHABET* getAlphabet(IOTHUB_BASE64_ALPHABET alphabet)
+{
+    return (alphabet == IOTHUB_BASE64_ALPHABET_URL) ? &urlAlphabet : &standardAlphabet;
+}
+
+size_t IoTHubBase64_EncodedLength(size_t size)
+{
+    /*Codes_SRS_IOTHUB_BASE64_10_001: [IoTHubBase64_EncodedLength shall return 4 characters for every started group of 3 bytes.]*/
+    return ((size + 2) / 3) * 4;
+}
+
+char* IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET alphabet, const unsigned char* source, size_t size, char* destination)
+{
+    char* result;
+    /*Codes_SRS_IOTHUB_BASE64_10_002: [If destination is NULL, or source is NULL and size is not 0, then IoTHubBase64_Encode shall write nothing and return NULL.]*/
+    if ((destination == NULL) || ((source == NULL) && (size != 0)))
+    {
+        LogError("invalid arg const unsigned char* source=%p, size_t size=%lu, char* destination=%p", source, (unsigned long)size, destination);
+        result = NULL;
+    }
+    else
+    {
+        BASE64_ENCODE encode = selectedEncode;
+        if (encode == NULL)
+        {
+            /*Codes_SRS_IOTHUB_BASE64_10_009: [Until IoTHubBase64_SetImplementation is called the codec shall use the fastest implementation the CPU supports.]*/
+            selectFastest();
+            encode = selectedEncode;
+        }
+        /*Codes_SRS_IOTHUB_BASE64_10_003: [IoTHubBase64_Encode shall write the IoTHubBase64_EncodedLength(size) characters of the base64 encoding of source in alphabet, '=' padded, at destination and return destination + IoTHubBase64_EncodedLength(size).]*/
+        /*Codes_SRS_IOTHUB_BASE64_10_008: [All the implementations shall produce the same output for the same input.]*/
+        result = encode(getAlphabet(alphabet), source, size, destination);
+    }
+    return result;
+}
+
+size_t IoTHubBase64_DecodeGroups(IOTHUB_BASE64_ALPHABET alphabet, const char* source, size_t length, unsigned char* destination)
+{
+    size_t result;
+    /*Codes_SRS_IOTHUB_BASE64_10_004: [If source or destination is NULL then IoTHubBase64_DecodeGroups shall write nothing and return 0.]*/
+    if ((source == NULL) || (destination == NULL))
+    {
+        LogError("invalid arg const char* source=%p, unsigned char* destination=%p", source, destination);
+        result = 0;
+    }
+    else
+    {
+        BASE64_DECODE_GROUPS decodeGroups = selectedDecodeGroups;
+        if (decodeGroups == NULL)
+        {
+            /*Codes_SRS_IOTHUB_BASE64_10_009: [Until IoTHubBase64_SetImplementation is called the codec shall use the fastest implementation the CPU supports.]*/
+            selectFastest();
+            decodeGroups = selectedDecodeGroups;
+        }
+        /*Codes_SRS_IOTHUB_BASE64_10_005: [IoTHubBase64_DecodeGroups shall decode the groups of 4 characters of alphabet from the start of source until the first group that is incomplete or has a character outside of alphabet, write 3 bytes per group at destination and return the number of characters decoded.]*/
+        /*Codes_SRS_IOTHUB_BASE64_10_008: [All the implementations shall produce the same output for the same input.]*/
+        result = decodeGroups(getAlphabet(alphabet), source, length, destination);
+    }
+    return result;
+}
+
+IOTHUB_BASE64_IMPLEMENTATION IoTHubBase64_GetImplementation(void)
+{
+    if (selectedEncode == NULL)
+    {
+        selectFastest();
+    }
+    /*Codes_SRS_IOTHUB_BASE64_10_006: [IoTHubBase64_GetImplementation shall return the implementation used by IoTHubBase64_Encode and IoTHubBase64_DecodeGroups.]*/
+    return selectedImplementation;
+}
+
+int IoTHubBase64_SetImplementation(IOTHUB_BASE64_IMPLEMENTATION implementation)
+{
+    int result;
+    if (!isImplementationSupported(implementation))
+    {
+        /*Codes_SRS_IOTHUB_BASE64_10_007: [If implementation is not compiled in or not supported by the CPU then IoTHubBase64_SetImplementation shall fail and return a non-zero value.]*/
+        LogError("base64 implementation %d is not available", (int)implementation);
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_BASE64_10_010: [Otherwise IoTHubBase64_SetImplementation shall make IoTHubBase64_Encode and IoTHubBase64_DecodeGroups use implementation and return 0.]*/
+        selectImplementation(implementation);
+        result = 0;
+    }
+    return result;
+}
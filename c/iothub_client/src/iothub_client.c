@@ -14,11 +14,23 @@
 #include "iothub_client.h"
 #include "iothub_client_ll.h"
 #include "iothubtransport.h"
+#include "iothub_client_private.h"
+#include "iothub_client_handoff.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/list.h"
 
+/*an event confirmation waiting to be called by the dispatch thread*/
+typedef struct DISPATCHED_CALLBACK_TAG
+{
+    struct DISPATCHED_CALLBACK_TAG* next;
+    IOTHUB_CLIENT_CONFIRMATION_RESULT confirmationResult;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback;
+    void* userContextCallback;
+} DISPATCHED_CALLBACK;
+
 typedef struct IOTHUB_CLIENT_INSTANCE_TAG
 {
     IOTHUB_CLIENT_LL_HANDLE IoTHubClientLLHandle;
@@ -26,11 +38,42 @@ typedef struct IOTHUB_CLIENT_INSTANCE_TAG
     THREAD_HANDLE ThreadHandle;
     LOCK_HANDLE LockHandle;
     sig_atomic_t StopThread;
+    COND_HANDLE WorkerCondition; /*created by the "workerIdleWaitTime" option, signalled when there is new work for the worker thread*/
+    unsigned int WorkerIdleWaitTime; /*0 means the worker thread calls IoTHubClient_LL_DoWork every 1 ms*/
+    bool BlockWhenSendQueueFull; /*"sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK*/
+    COND_HANDLE SendQueueCondition; /*signalled every time a message gives back its room in the send queue*/
+    size_t SendQueueWaiters; /*threads waiting on SendQueueCondition*/
+    IOTHUB_CLIENT_HANDOFF_HANDLE SendHandoff; /*created by the "sendEventHandoff" option, events submitted by _SendEventAsync without taking the lock*/
+    IOTHUB_CLIENT_HANDOFF_ITEM* HandoffBacklog; /*events taken from SendHandoff that IoTHubClient_LL did not accept yet, oldest first*/
+    IOTHUB_CLIENT_HANDOFF_ITEM* HandoffBacklogTail; /*last event of HandoffBacklog, only meaningful while HandoffBacklog is not NULL*/
+    THREAD_HANDLE DispatchThreadHandle; /*started by the "callbackDispatchThread" option, calls the event confirmations without the lock*/
+    LOCK_HANDLE DispatchLock; /*protects DispatchHead, DispatchTail and StopDispatchThread*/
+    COND_HANDLE DispatchCondition; /*signalled when a callback is queued for the dispatch thread*/
+    DISPATCHED_CALLBACK* DispatchHead; /*callbacks waiting for the dispatch thread, oldest first*/
+    DISPATCHED_CALLBACK* DispatchTail;
+    sig_atomic_t StopDispatchThread;
 #ifndef DONT_USE_UPLOADTOBLOB
     LIST_HANDLE savedDataToBeCleaned; /*list containing UPLOADTOBLOB_SAVED_DATA*/
 #endif
 } IOTHUB_CLIENT_INSTANCE;
 
+typedef struct SEND_EVENT_HANDOFF_TAG
+{
+    IOTHUB_CLIENT_HANDOFF_ITEM item; /*must be the first member*/
+    IOTHUB_MESSAGE_HANDLE eventMessageHandle; /*owned by the record*/
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback;
+    void* userContextCallback;
+} SEND_EVENT_HANDOFF;
+
+/*replaces userContextCallback of an event when its confirmation is dispatched*/
+typedef struct DISPATCHED_CONFIRMATION_CONTEXT_TAG
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback;
+    void* userContextCallback;
+    size_t pendingConfirmations; /*how many more times IoTHubClient_LL calls back with this context*/
+} DISPATCHED_CONFIRMATION_CONTEXT;
+
 #ifndef DONT_USE_UPLOADTOBLOB
 typedef struct UPLOADTOBLOB_SAVED_DATA_TAG
 {
@@ -48,6 +91,7 @@ typedef struct UPLOADTOBLOB_SAVED_DATA_TAG
 
 /*used by unittests only*/
 const size_t IoTHubClient_ThreadTerminationOffset = offsetof(IOTHUB_CLIENT_INSTANCE, StopThread);
+const size_t IoTHubClient_DispatchTerminationOffset = offsetof(IOTHUB_CLIENT_INSTANCE, StopDispatchThread);
 
 #ifndef DONT_USE_UPLOADTOBLOB
 /*this function is called from _Destroy and from ScheduleWork_Thread to join finished blobUpload threads and free that memory*/
@@ -98,12 +142,89 @@ static void garbageCollectorImpl(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
 }
 #endif
 
+static bool HasHandedOffEvents(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    return (iotHubClientInstance->SendHandoff != NULL) &&
+        ((iotHubClientInstance->HandoffBacklog != NULL) || !IoTHubClient_Handoff_IsEmpty(iotHubClientInstance->SendHandoff));
+}
+
+/*must be called with the lock held*/
+static IOTHUB_CLIENT_RESULT GetSendStatus_Impl(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
+{
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(iotHubClientInstance->IoTHubClientLLHandle, iotHubClientStatus);
+    /*Codes_SRS_IOTHUBCLIENT_10_043: [ While events handed over with the "sendEventHandoff" option have not been passed to IoTHubClient_LL, IoTHubClient_GetSendStatus shall report IOTHUB_CLIENT_SEND_STATUS_BUSY and the worker thread shall not wait for work. ]*/
+    if ((result == IOTHUB_CLIENT_OK) && (*iotHubClientStatus == IOTHUB_CLIENT_SEND_STATUS_IDLE) && HasHandedOffEvents(iotHubClientInstance))
+    {
+        *iotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+    }
+    return result;
+}
+
+static bool IsSendIdle(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    IOTHUB_CLIENT_STATUS status;
+    return (GetSendStatus_Impl(iotHubClientInstance, &status) == IOTHUB_CLIENT_OK) &&
+        (status == IOTHUB_CLIENT_SEND_STATUS_IDLE);
+}
+
+/*moves the events handed over by _SendEventAsync to IoTHubClient_LL, must be called with the lock held*/
+static void DrainSendHandoff(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->SendHandoff != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_040: [ Before calling IoTHubClient_LL_DoWork the worker thread shall take all the events from the handoff by calling IoTHubClient_Handoff_TakeAll and pass them, after the events kept from a previous iteration and in the order they were submitted, to IoTHubClient_LL_SendEventAsync_TakeOwnership. ]*/
+        IOTHUB_CLIENT_HANDOFF_ITEM* taken = IoTHubClient_Handoff_TakeAll(iotHubClientInstance->SendHandoff);
+        if (taken != NULL)
+        {
+            if (iotHubClientInstance->HandoffBacklog == NULL)
+            {
+                iotHubClientInstance->HandoffBacklog = taken;
+            }
+            else
+            {
+                iotHubClientInstance->HandoffBacklogTail->next = taken;
+            }
+
+            /*only the events just taken are walked, the events kept in the backlog are not walked again*/
+            iotHubClientInstance->HandoffBacklogTail = taken;
+            while (iotHubClientInstance->HandoffBacklogTail->next != NULL)
+            {
+                iotHubClientInstance->HandoffBacklogTail = iotHubClientInstance->HandoffBacklogTail->next;
+            }
+        }
+
+        while (iotHubClientInstance->HandoffBacklog != NULL)
+        {
+            SEND_EVENT_HANDOFF* sendEvent = (SEND_EVENT_HANDOFF*)iotHubClientInstance->HandoffBacklog;
+            if (IoTHubClient_LL_SendEventAsync_TakeOwnership(iotHubClientInstance->IoTHubClientLLHandle, sendEvent->eventMessageHandle, sendEvent->eventConfirmationCallback, sendEvent->userContextCallback) != IOTHUB_CLIENT_OK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_10_041: [ If "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK and an event is refused because the send queue is full, the worker thread shall keep it and the events after it for its next iteration. ]*/
+                if (iotHubClientInstance->BlockWhenSendQueueFull && IoTHubClient_LL_WasSendQueueFull(iotHubClientInstance->IoTHubClientLLHandle))
+                {
+                    break;
+                }
+
+                /*Codes_SRS_IOTHUBCLIENT_10_042: [ Otherwise, if IoTHubClient_LL_SendEventAsync_TakeOwnership fails, the worker thread shall call the callback of the event with IOTHUB_CLIENT_CONFIRMATION_ERROR and destroy its message. ]*/
+                LogError("unable to pass a handed over event to IoTHubClient_LL");
+                if (sendEvent->eventConfirmationCallback != NULL)
+                {
+                    sendEvent->eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, sendEvent->userContextCallback);
+                }
+                IoTHubMessage_Destroy(sendEvent->eventMessageHandle);
+            }
+            iotHubClientInstance->HandoffBacklog = sendEvent->item.next;
+            free(sendEvent);
+        }
+    }
+}
+
 static int ScheduleWork_Thread(void* threadArgument)
 {
     IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)threadArgument;
 
     while (1)
     {
+        bool waitedForWork = false;
         if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
         {
             /*Codes_SRS_IOTHUBCLIENT_01_038: [ The thread shall exit when IoTHubClient_Destroy is called. ]*/
@@ -114,6 +235,8 @@ static int ScheduleWork_Thread(void* threadArgument)
             }
             else
             {
+                DrainSendHandoff(iotHubClientInstance);
+
                 /* Codes_SRS_IOTHUBCLIENT_01_037: [The thread created by IoTHubClient_SendEvent or IoTHubClient_SetMessageCallback shall call IoTHubClient_LL_DoWork every 1 ms.] */
                 /* Codes_SRS_IOTHUBCLIENT_01_039: [All calls to IoTHubClient_LL_DoWork shall be protected by the lock created in IotHubClient_Create.] */
                 IoTHubClient_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
@@ -121,6 +244,18 @@ static int ScheduleWork_Thread(void* threadArgument)
 #ifndef DONT_USE_UPLOADTOBLOB
                 garbageCollectorImpl(iotHubClientInstance);
 #endif
+                /*Codes_SRS_IOTHUBCLIENT_10_007: [ If the "workerIdleWaitTime" option is not 0 and IoTHubClient_LL_GetSendStatus reports IOTHUB_CLIENT_SEND_STATUS_IDLE, the thread shall wait on the worker condition for at most "workerIdleWaitTime" milliseconds instead of sleeping 1 ms. ]*/
+                if ((iotHubClientInstance->WorkerIdleWaitTime > 0) && IsSendIdle(iotHubClientInstance))
+                {
+                    if (Condition_Wait(iotHubClientInstance->WorkerCondition, iotHubClientInstance->LockHandle, (int)iotHubClientInstance->WorkerIdleWaitTime) == COND_ERROR)
+                    {
+                        LogError("Condition_Wait failed");
+                    }
+                    else
+                    {
+                        waitedForWork = true;
+                    }
+                }
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -129,12 +264,80 @@ static int ScheduleWork_Thread(void* threadArgument)
             /*Codes_SRS_IOTHUBCLIENT_01_040: [If acquiring the lock fails, IoTHubClient_LL_DoWork shall not be called.]*/
             /*no code, shall retry*/
         }
-        (void)ThreadAPI_Sleep(1);
+
+        if (!waitedForWork)
+        {
+            (void)ThreadAPI_Sleep(1);
+        }
     }
 
     return 0;
 }
 
+/*wakes up the worker thread when it waits for work, must be called with the lock held*/
+static void SignalWorkerThread(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->TransportHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_063: [ If the transport connection is shared, the worker thread shall be woken up by calling IoTHubTransport_SignalWorkerThread whatever the "workerIdleWaitTime" option of this client is. ]*/
+        /*the wait time is set on the transport by any of its clients, IoTHubTransport_SignalWorkerThread does nothing when the transport has no worker condition*/
+        IoTHubTransport_SignalWorkerThread(iotHubClientInstance->TransportHandle);
+    }
+    else if ((iotHubClientInstance->WorkerIdleWaitTime > 0) &&
+        (Condition_Post(iotHubClientInstance->WorkerCondition) != COND_OK))
+    {
+        LogError("unable to Condition_Post");
+    }
+}
+
+#define SEND_QUEUE_WAIT_TIME 100 /*ms, a waiting thread is woken up earlier by every message that gives back its room in the send queue*/
+
+/*called by IoTHubClient_LL, with the lock held, every time a message gives back its room in the send queue*/
+static void OnSendQueueRoom(void* context)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)context;
+    /*Codes_SRS_IOTHUBCLIENT_10_068: [ Every time IoTHubClient_LL calls the send queue room callback while a thread waits for room in the send queue, the send queue condition shall be signalled by calling Condition_Post. ]*/
+    if ((iotHubClientInstance->SendQueueWaiters > 0) &&
+        (Condition_Post(iotHubClientInstance->SendQueueCondition) != COND_OK))
+    {
+        LogError("unable to Condition_Post");
+    }
+}
+
+/*called with the lock held when the send queue is full and "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK: lets the worker thread make room. returns 0 when the lock is held again*/
+static int WaitForRoomInSendQueue(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    int result;
+    COND_RESULT waitResult;
+    SignalWorkerThread(iotHubClientInstance);
+
+    /*Codes_SRS_IOTHUBCLIENT_10_067: [ Waiting for room in the send queue shall be done by calling Condition_Wait on the send queue condition with the lock for at most SEND_QUEUE_WAIT_TIME milliseconds. If Condition_Wait fails, the lock shall be released for 1 ms instead. ]*/
+    iotHubClientInstance->SendQueueWaiters++;
+    waitResult = Condition_Wait(iotHubClientInstance->SendQueueCondition, iotHubClientInstance->LockHandle, SEND_QUEUE_WAIT_TIME);
+    iotHubClientInstance->SendQueueWaiters--;
+
+    if (waitResult != COND_ERROR)
+    {
+        result = 0;
+    }
+    else
+    {
+        LogError("Condition_Wait failed");
+        (void)Unlock(iotHubClientInstance->LockHandle);
+        ThreadAPI_Sleep(1);
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = __LINE__;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
 static IOTHUB_CLIENT_RESULT StartWorkerThreadIfNeeded(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -168,6 +371,261 @@ static IOTHUB_CLIENT_RESULT StartWorkerThreadIfNeeded(IOTHUB_CLIENT_INSTANCE* io
     return result;
 }
 
+#define DISPATCH_THREAD_WAIT_TIME 1000 /*ms, the dispatch thread is woken up earlier by every queued callback*/
+
+/*calls an event confirmation on the dispatch thread and frees its record*/
+static void InvokeDispatchedCallback(DISPATCHED_CALLBACK* dispatched)
+{
+    dispatched->eventConfirmationCallback(dispatched->confirmationResult, dispatched->userContextCallback);
+    free(dispatched);
+}
+
+static int Dispatch_Thread(void* threadArgument)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)threadArgument;
+    bool stop = false;
+
+    while (!stop)
+    {
+        if (Lock(iotHubClientInstance->DispatchLock) != LOCK_OK)
+        {
+            LogError("unable to Lock");
+            (void)ThreadAPI_Sleep(1);
+        }
+        else
+        {
+            DISPATCHED_CALLBACK* taken;
+            /*Codes_SRS_IOTHUBCLIENT_10_054: [ When no callback is queued, the dispatch thread shall wait on the dispatch condition. ]*/
+            if ((iotHubClientInstance->DispatchHead == NULL) && !iotHubClientInstance->StopDispatchThread)
+            {
+                if (Condition_Wait(iotHubClientInstance->DispatchCondition, iotHubClientInstance->DispatchLock, DISPATCH_THREAD_WAIT_TIME) == COND_ERROR)
+                {
+                    LogError("Condition_Wait failed");
+                }
+            }
+            taken = iotHubClientInstance->DispatchHead;
+            iotHubClientInstance->DispatchHead = NULL;
+            iotHubClientInstance->DispatchTail = NULL;
+            /*Codes_SRS_IOTHUBCLIENT_10_055: [ IoTHubClient_Destroy shall signal the dispatch thread to end and join it after releasing the lock. The dispatch thread shall call every queued callback before ending, including the ones IoTHubClient_LL_Destroy completes with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY. Then IoTHubClient_Destroy shall free the dispatch condition and the dispatch lock. ]*/
+            stop = (iotHubClientInstance->StopDispatchThread && (taken == NULL));
+            (void)Unlock(iotHubClientInstance->DispatchLock);
+
+            /*Codes_SRS_IOTHUBCLIENT_10_053: [ The dispatch thread shall call the queued event confirmations in the order they were queued without holding the lock created in IoTHubClient_Create. ]*/
+            while (taken != NULL)
+            {
+                DISPATCHED_CALLBACK* next = taken->next;
+                InvokeDispatchedCallback(taken);
+                taken = next;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*hands a callback to the dispatch thread, can be called with or without the lock*/
+static int QueueDispatchedCallback(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, DISPATCHED_CALLBACK* dispatched)
+{
+    int result;
+    if (Lock(iotHubClientInstance->DispatchLock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+        result = __LINE__;
+    }
+    else
+    {
+        dispatched->next = NULL;
+        if (iotHubClientInstance->DispatchTail == NULL)
+        {
+            iotHubClientInstance->DispatchHead = dispatched;
+            if (Condition_Post(iotHubClientInstance->DispatchCondition) != COND_OK)
+            {
+                LogError("unable to Condition_Post");
+            }
+        }
+        else
+        {
+            iotHubClientInstance->DispatchTail->next = dispatched;
+        }
+        iotHubClientInstance->DispatchTail = dispatched;
+        (void)Unlock(iotHubClientInstance->DispatchLock);
+        result = 0;
+    }
+    return result;
+}
+
+/*given to IoTHubClient_LL in place of the event confirmation callback of the user, called with the lock held*/
+static void DispatchEventConfirmation(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    DISPATCHED_CONFIRMATION_CONTEXT* context = (DISPATCHED_CONFIRMATION_CONTEXT*)userContextCallback;
+    /*Codes_SRS_IOTHUBCLIENT_10_050: [ When IoTHubClient_LL calls that callback, it shall queue the result, eventConfirmationCallback and userContextCallback for the dispatch thread and signal the dispatch condition instead of calling eventConfirmationCallback. If that fails, eventConfirmationCallback shall be called right away. ]*/
+    DISPATCHED_CALLBACK* dispatched = (DISPATCHED_CALLBACK*)malloc(sizeof(DISPATCHED_CALLBACK));
+    if (dispatched == NULL)
+    {
+        LogError("unable to malloc, calling the event confirmation callback on this thread");
+        context->eventConfirmationCallback(result, context->userContextCallback);
+    }
+    else
+    {
+        dispatched->confirmationResult = result;
+        dispatched->eventConfirmationCallback = context->eventConfirmationCallback;
+        dispatched->userContextCallback = context->userContextCallback;
+        if (QueueDispatchedCallback(context->iotHubClientInstance, dispatched) != 0)
+        {
+            LogError("unable to queue the event confirmation, calling it on this thread");
+            InvokeDispatchedCallback(dispatched);
+        }
+    }
+
+    if (--context->pendingConfirmations == 0)
+    {
+        free(context);
+    }
+}
+
+/*when the "callbackDispatchThread" option is enabled, replaces the confirmation callback and context of an event by the dispatching ones. pendingConfirmations is how many times IoTHubClient_LL calls them back*/
+static IOTHUB_CLIENT_RESULT WrapEventConfirmation(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK* eventConfirmationCallback, void** userContextCallback, size_t pendingConfirmations)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if ((iotHubClientInstance->DispatchThreadHandle == NULL) || (*eventConfirmationCallback == NULL) || (pendingConfirmations == 0))
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_049: [ When the "callbackDispatchThread" option is enabled and eventConfirmationCallback is not NULL, IoTHubClient_SendEventAsync, IoTHubClient_SendEventAsync_TakeOwnership, IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall pass a confirmation callback and context of their own instead of eventConfirmationCallback and userContextCallback. If allocating that context fails they shall return IOTHUB_CLIENT_ERROR. The context shall be freed when the events are refused. ]*/
+        DISPATCHED_CONFIRMATION_CONTEXT* context = (DISPATCHED_CONFIRMATION_CONTEXT*)malloc(sizeof(DISPATCHED_CONFIRMATION_CONTEXT));
+        if (context == NULL)
+        {
+            LogError("unable to malloc");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            context->iotHubClientInstance = iotHubClientInstance;
+            context->eventConfirmationCallback = *eventConfirmationCallback;
+            context->userContextCallback = *userContextCallback;
+            context->pendingConfirmations = pendingConfirmations;
+            *eventConfirmationCallback = DispatchEventConfirmation;
+            *userContextCallback = context;
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    return result;
+}
+
+/*undoes WrapEventConfirmation when the events were not accepted*/
+static void UnwrapEventConfirmation(IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    if (eventConfirmationCallback == DispatchEventConfirmation)
+    {
+        free(userContextCallback);
+    }
+}
+
+/*lets the dispatch thread call what is queued, joins it and frees what "callbackDispatchThread" created*/
+static void EndDispatchThread(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    int res;
+    DISPATCHED_CALLBACK* leftOver;
+
+    if (Lock(iotHubClientInstance->DispatchLock) != LOCK_OK)
+    {
+        LogError("unable to Lock - - will still proceed to try to end the dispatch thread without locking");
+    }
+    iotHubClientInstance->StopDispatchThread = 1;
+    (void)Condition_Post(iotHubClientInstance->DispatchCondition);
+    (void)Unlock(iotHubClientInstance->DispatchLock);
+
+    if (ThreadAPI_Join(iotHubClientInstance->DispatchThreadHandle, &res) != THREADAPI_OK)
+    {
+        LogError("ThreadAPI_Join failed");
+    }
+    iotHubClientInstance->DispatchThreadHandle = NULL;
+
+    /*only when the dispatch thread could not run to its end*/
+    leftOver = iotHubClientInstance->DispatchHead;
+    iotHubClientInstance->DispatchHead = NULL;
+    iotHubClientInstance->DispatchTail = NULL;
+    while (leftOver != NULL)
+    {
+        DISPATCHED_CALLBACK* next = leftOver->next;
+        InvokeDispatchedCallback(leftOver);
+        leftOver = next;
+    }
+
+    Condition_Deinit(iotHubClientInstance->DispatchCondition);
+    Lock_Deinit(iotHubClientInstance->DispatchLock);
+}
+
+/*calls the callbacks of the events still in the handoff or in the backlog, used by _Destroy*/
+static void CompleteHandedOffEvents(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    IOTHUB_CLIENT_HANDOFF_ITEM* taken = IoTHubClient_Handoff_TakeAll(iotHubClientInstance->SendHandoff);
+    IOTHUB_CLIENT_HANDOFF_ITEM* lists[2];
+    size_t i;
+    lists[0] = iotHubClientInstance->HandoffBacklog;
+    lists[1] = taken;
+    iotHubClientInstance->HandoffBacklog = NULL;
+    for (i = 0; i < 2; i++)
+    {
+        while (lists[i] != NULL)
+        {
+            SEND_EVENT_HANDOFF* sendEvent = (SEND_EVENT_HANDOFF*)lists[i];
+            lists[i] = sendEvent->item.next;
+            if (sendEvent->eventConfirmationCallback != NULL)
+            {
+                sendEvent->eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, sendEvent->userContextCallback);
+            }
+            IoTHubMessage_Destroy(sendEvent->eventMessageHandle);
+            free(sendEvent);
+        }
+    }
+}
+
+/*called without the lock: hands an event over to the worker thread. On failure eventMessageHandle stays with the caller*/
+static IOTHUB_CLIENT_RESULT HandOffSendEvent(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    SEND_EVENT_HANDOFF* sendEvent;
+    if (WrapEventConfirmation(iotHubClientInstance, &eventConfirmationCallback, &userContextCallback, 1) != IOTHUB_CLIENT_OK)
+    {
+        LogError("unable to dispatch the event confirmation");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((sendEvent = (SEND_EVENT_HANDOFF*)malloc(sizeof(SEND_EVENT_HANDOFF))) == NULL)
+    {
+        LogError("unable to malloc");
+        UnwrapEventConfirmation(eventConfirmationCallback, userContextCallback);
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        sendEvent->eventMessageHandle = eventMessageHandle;
+        sendEvent->eventConfirmationCallback = eventConfirmationCallback;
+        sendEvent->userContextCallback = userContextCallback;
+        if (IoTHubClient_Handoff_Push(iotHubClientInstance->SendHandoff, &sendEvent->item) &&
+            ((iotHubClientInstance->TransportHandle != NULL) || (iotHubClientInstance->WorkerIdleWaitTime > 0)))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_039: [ When IoTHubClient_Handoff_Push reports that the handoff was empty and the "workerIdleWaitTime" option is not 0, the worker thread shall be woken up with the lock held. ]*/
+            /*the worker thread checks the handoff and starts to wait without releasing the lock, so a post made with the lock held cannot fall between the two*/
+            if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+            {
+                /*the worker thread picks the event up after at most "workerIdleWaitTime" milliseconds if it misses this post*/
+                LogError("Could not acquire lock");
+                SignalWorkerThread(iotHubClientInstance);
+            }
+            else
+            {
+                SignalWorkerThread(iotHubClientInstance);
+                (void)Unlock(iotHubClientInstance->LockHandle);
+            }
+        }
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_HANDLE IoTHubClient_CreateFromConnectionString(const char* connectionString, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
 {
     IOTHUB_CLIENT_INSTANCE* result = NULL;
@@ -234,6 +692,15 @@ IOTHUB_CLIENT_HANDLE IoTHubClient_CreateFromConnectionString(const char* connect
                     {
                         result->ThreadHandle = NULL;
                         result->TransportHandle = NULL;
+                        result->WorkerCondition = NULL;
+                        result->WorkerIdleWaitTime = 0;
+                        result->BlockWhenSendQueueFull = false;
+                        result->SendQueueCondition = NULL;
+                        result->SendQueueWaiters = 0;
+                        result->SendHandoff = NULL;
+                        result->HandoffBacklog = NULL;
+                        result->HandoffBacklogTail = NULL;
+                        result->DispatchThreadHandle = NULL;
                     }
                 }
             }
@@ -292,6 +759,15 @@ IOTHUB_CLIENT_HANDLE IoTHubClient_Create(const IOTHUB_CLIENT_CONFIG* config)
                 {
                     result->TransportHandle = NULL;
                     result->ThreadHandle = NULL;
+                    result->WorkerCondition = NULL;
+                    result->WorkerIdleWaitTime = 0;
+                    result->BlockWhenSendQueueFull = false;
+                    result->SendQueueCondition = NULL;
+                    result->SendQueueWaiters = 0;
+                    result->SendHandoff = NULL;
+                    result->HandoffBacklog = NULL;
+                    result->HandoffBacklogTail = NULL;
+                    result->DispatchThreadHandle = NULL;
                 }
             }
         }
@@ -336,6 +812,15 @@ IOTHUB_CLIENT_HANDLE IoTHubClient_CreateWithTransport(TRANSPORT_HANDLE transport
             {
                 result->ThreadHandle = NULL;
                 result->TransportHandle = transportHandle;
+                result->WorkerCondition = NULL;
+                result->WorkerIdleWaitTime = 0;
+                result->BlockWhenSendQueueFull = false;
+                result->SendQueueCondition = NULL;
+                result->SendQueueWaiters = 0;
+                result->SendHandoff = NULL;
+                result->HandoffBacklog = NULL;
+                result->HandoffBacklogTail = NULL;
+                result->DispatchThreadHandle = NULL;
                 /*Codes_SRS_IOTHUBCLIENT_17_005: [ IoTHubClient_CreateWithTransport shall call IoTHubTransport_GetLock to get the transport lock to be used later for serializing IoTHubClient calls. ]*/
                 LOCK_HANDLE transportLock = IoTHubTransport_GetLock(transportHandle);
                 result->LockHandle = transportLock;
@@ -413,6 +898,34 @@ IOTHUB_CLIENT_HANDLE IoTHubClient_CreateWithTransport(TRANSPORT_HANDLE transport
     return result;
 }
 
+IOTHUB_CLIENT_HANDLE IoTHubClient_CreateWithTransportPool(TRANSPORT_POOL_HANDLE poolHandle, const IOTHUB_CLIENT_CONFIG* config)
+{
+    IOTHUB_CLIENT_HANDLE result;
+    /*Codes_SRS_IOTHUBCLIENT_10_056: [ If poolHandle or config is NULL, IoTHubClient_CreateWithTransportPool shall return NULL. ]*/
+    if (poolHandle == NULL || config == NULL)
+    {
+        LogError("invalid parameter TRANSPORT_POOL_HANDLE poolHandle=%p, const IOTHUB_CLIENT_CONFIG* config=%p", poolHandle, config);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_057: [ IoTHubClient_CreateWithTransportPool shall pick the transport of the device by calling IoTHubTransport_GetPoolTransport with config's deviceId. ]*/
+        TRANSPORT_HANDLE transportHandle = IoTHubTransport_GetPoolTransport(poolHandle, config->deviceId);
+        if (transportHandle == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_058: [ If IoTHubTransport_GetPoolTransport fails, IoTHubClient_CreateWithTransportPool shall return NULL. ]*/
+            LogError("unable to IoTHubTransport_GetPoolTransport");
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_059: [ IoTHubClient_CreateWithTransportPool shall return the result of IoTHubClient_CreateWithTransport called with that transport and config. ]*/
+            result = IoTHubClient_CreateWithTransport(transportHandle, config);
+        }
+    }
+    return result;
+}
+
 /* Codes_SRS_IOTHUBCLIENT_01_005: [IoTHubClient_Destroy shall free all resources associated with the iotHubClientHandle instance.] */
 void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
 {
@@ -440,6 +953,11 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
         if (iotHubClientInstance->ThreadHandle != NULL)
         {
             iotHubClientInstance->StopThread = 1;
+            /*Codes_SRS_IOTHUBCLIENT_10_008: [ If the worker thread might be waiting for work, IoTHubClient_Destroy shall wake it up by calling Condition_Post. ]*/
+            if (iotHubClientInstance->WorkerCondition != NULL)
+            {
+                (void)Condition_Post(iotHubClientInstance->WorkerCondition);
+            }
             okToJoin = true;
         }
         else
@@ -456,6 +974,13 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
         /* Codes_SRS_IOTHUBCLIENT_01_006: [That includes destroying the IoTHubClient_LL instance by calling IoTHubClient_LL_Destroy.] */
         IoTHubClient_LL_Destroy(iotHubClientInstance->IoTHubClientLLHandle);
 
+        if (iotHubClientInstance->SendHandoff != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_044: [ IoTHubClient_Destroy shall call the callbacks of the events that were handed over and not passed to IoTHubClient_LL with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, destroy their messages and destroy the handoff by calling IoTHubClient_Handoff_Destroy. ]*/
+            CompleteHandedOffEvents(iotHubClientInstance);
+            IoTHubClient_Handoff_Destroy(iotHubClientInstance->SendHandoff);
+        }
+
 #ifndef DONT_USE_UPLOADTOBLOB
         if (iotHubClientInstance->savedDataToBeCleaned != NULL)
         {
@@ -487,12 +1012,28 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
             }
         }
 
+        if (iotHubClientInstance->DispatchThreadHandle != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_055: [ IoTHubClient_Destroy shall signal the dispatch thread to end and join it after releasing the lock. The dispatch thread shall call every queued callback before ending, including the ones IoTHubClient_LL_Destroy completes with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY. Then IoTHubClient_Destroy shall free the dispatch condition and the dispatch lock. ]*/
+            EndDispatchThread(iotHubClientInstance);
+        }
+
         if (iotHubClientInstance->TransportHandle == NULL)
         {
             /* Codes_SRS_IOTHUBCLIENT_01_032: [If the lock was allocated in IoTHubClient_Create, it shall be also freed..] */
             Lock_Deinit(iotHubClientInstance->LockHandle);
         }
 
+        if (iotHubClientInstance->WorkerCondition != NULL)
+        {
+            Condition_Deinit(iotHubClientInstance->WorkerCondition);
+        }
+
+        if (iotHubClientInstance->SendQueueCondition != NULL)
+        {
+            Condition_Deinit(iotHubClientInstance->SendQueueCondition);
+        }
+
         free(iotHubClientInstance);
     }
 }
@@ -511,8 +1052,31 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
     {
         IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
 
+        if (iotHubClientInstance->SendHandoff != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_036: [ When the "sendEventHandoff" option is enabled, IoTHubClient_SendEventAsync and IoTHubClient_SendEventAsync_TakeOwnership shall not acquire the lock. They shall return IOTHUB_CLIENT_INVALID_ARG if eventMessageHandle is NULL, or if eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+            if ((eventMessageHandle == NULL) || ((eventConfirmationCallback == NULL) && (userContextCallback != NULL)))
+            {
+                result = IOTHUB_CLIENT_INVALID_ARG;
+                LogError("invalid arg IOTHUB_MESSAGE_HANDLE eventMessageHandle=%p, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback=%p, void* userContextCallback=%p", eventMessageHandle, eventConfirmationCallback, userContextCallback);
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_10_037: [ IoTHubClient_SendEventAsync shall clone eventMessageHandle by calling IoTHubMessage_Clone and push the clone, eventConfirmationCallback and userContextCallback to the handoff by calling IoTHubClient_Handoff_Push, then return IOTHUB_CLIENT_OK. If any of these fails IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_ERROR. ]*/
+                IOTHUB_MESSAGE_HANDLE clonedMessageHandle = IoTHubMessage_Clone(eventMessageHandle);
+                if (clonedMessageHandle == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("unable to IoTHubMessage_Clone");
+                }
+                else if ((result = HandOffSendEvent(iotHubClientInstance, clonedMessageHandle, eventConfirmationCallback, userContextCallback)) != IOTHUB_CLIENT_OK)
+                {
+                    IoTHubMessage_Destroy(clonedMessageHandle);
+                }
+            }
+        }
         /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
-        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
         {
             /* Codes_SRS_IOTHUBCLIENT_01_026: [If acquiring the lock fails, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_ERROR.] */
             result = IOTHUB_CLIENT_ERROR;
@@ -520,6 +1084,8 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
         }
         else
         {
+            bool isLocked = true;
+
             /* Codes_SRS_IOTHUBCLIENT_01_009: [IoTHubClient_SendEventAsync shall start the worker thread if it was not previously started.] */
             if ((result = StartWorkerThreadIfNeeded(iotHubClientInstance)) != IOTHUB_CLIENT_OK)
             {
@@ -527,19 +1093,226 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
                 result = IOTHUB_CLIENT_ERROR;
                 LogError("Could not start worker thread");
             }
+            else if ((result = WrapEventConfirmation(iotHubClientInstance, &eventConfirmationCallback, &userContextCallback, 1)) != IOTHUB_CLIENT_OK)
+            {
+                LogError("unable to dispatch the event confirmation");
+            }
             else
             {
                 /* Codes_SRS_IOTHUBCLIENT_01_012: [IoTHubClient_SendEventAsync shall call IoTHubClient_LL_SendEventAsync, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameters eventMessageHandle, eventConfirmationCallback and userContextCallback.] */
                 /* Codes_SRS_IOTHUBCLIENT_01_013: [When IoTHubClient_LL_SendEventAsync is called, IoTHubClient_SendEventAsync shall return the result of IoTHubClient_LL_SendEventAsync.] */
                 result = IoTHubClient_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
-            }
-
-            /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
-            (void)Unlock(iotHubClientInstance->LockHandle);
-        }
-    }
 
-    return result;
+                /*Codes_SRS_IOTHUBCLIENT_10_016: [ If "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK and IoTHubClient_LL_SendEventAsync fails because the send queue is full, IoTHubClient_SendEventAsync shall release the lock, wait for the worker thread to make room and call IoTHubClient_LL_SendEventAsync again. ]*/
+                while ((result == IOTHUB_CLIENT_ERROR) && iotHubClientInstance->BlockWhenSendQueueFull && IoTHubClient_LL_WasSendQueueFull(iotHubClientInstance->IoTHubClientLLHandle))
+                {
+                    if (WaitForRoomInSendQueue(iotHubClientInstance) != 0)
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_10_018: [ If acquiring the lock again fails, IoTHubClient_SendEventAsync and IoTHubClient_SendEventAsync_TakeOwnership shall return IOTHUB_CLIENT_ERROR. ]*/
+                        isLocked = false;
+                        break;
+                    }
+                    result = IoTHubClient_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+                }
+
+                /*Codes_SRS_IOTHUBCLIENT_10_009: [ When IoTHubClient_LL_SendEventAsync succeeds and the "workerIdleWaitTime" option is not 0, IoTHubClient_SendEventAsync shall wake up the worker thread. ]*/
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    SignalWorkerThread(iotHubClientInstance);
+                }
+                else
+                {
+                    UnwrapEventConfirmation(eventConfirmationCallback, userContextCallback);
+                }
+            }
+
+            /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
+            if (isLocked)
+            {
+                (void)Unlock(iotHubClientInstance->LockHandle);
+            }
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync_TakeOwnership(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /* Codes_SRS_IOTHUBCLIENT_10_001: [If iotHubClientHandle is NULL, IoTHubClient_SendEventAsync_TakeOwnership shall return IOTHUB_CLIENT_INVALID_ARG.] */
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        if (iotHubClientInstance->SendHandoff != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_036: [ When the "sendEventHandoff" option is enabled, IoTHubClient_SendEventAsync and IoTHubClient_SendEventAsync_TakeOwnership shall not acquire the lock. They shall return IOTHUB_CLIENT_INVALID_ARG if eventMessageHandle is NULL, or if eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+            if ((eventMessageHandle == NULL) || ((eventConfirmationCallback == NULL) && (userContextCallback != NULL)))
+            {
+                result = IOTHUB_CLIENT_INVALID_ARG;
+                LogError("invalid arg IOTHUB_MESSAGE_HANDLE eventMessageHandle=%p, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback=%p, void* userContextCallback=%p", eventMessageHandle, eventConfirmationCallback, userContextCallback);
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_10_038: [ IoTHubClient_SendEventAsync_TakeOwnership shall push eventMessageHandle, eventConfirmationCallback and userContextCallback to the handoff without cloning the message and return IOTHUB_CLIENT_OK. If that fails it shall return IOTHUB_CLIENT_ERROR and leave the ownership of eventMessageHandle with the caller. ]*/
+                result = HandOffSendEvent(iotHubClientInstance, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+            }
+        }
+        /* Codes_SRS_IOTHUBCLIENT_10_002: [IoTHubClient_SendEventAsync_TakeOwnership shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
+        else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_10_003: [If acquiring the lock fails, IoTHubClient_SendEventAsync_TakeOwnership shall return IOTHUB_CLIENT_ERROR.] */
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            bool isLocked = true;
+
+            /* Codes_SRS_IOTHUBCLIENT_10_004: [IoTHubClient_SendEventAsync_TakeOwnership shall start the worker thread if it was not previously started.] */
+            if ((result = StartWorkerThreadIfNeeded(iotHubClientInstance)) != IOTHUB_CLIENT_OK)
+            {
+                /* Codes_SRS_IOTHUBCLIENT_10_005: [If starting the thread fails, IoTHubClient_SendEventAsync_TakeOwnership shall return IOTHUB_CLIENT_ERROR.] */
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("Could not start worker thread");
+            }
+            else if ((result = WrapEventConfirmation(iotHubClientInstance, &eventConfirmationCallback, &userContextCallback, 1)) != IOTHUB_CLIENT_OK)
+            {
+                LogError("unable to dispatch the event confirmation");
+            }
+            else
+            {
+                /* Codes_SRS_IOTHUBCLIENT_10_006: [IoTHubClient_SendEventAsync_TakeOwnership shall call IoTHubClient_LL_SendEventAsync_TakeOwnership, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameters eventMessageHandle, eventConfirmationCallback and userContextCallback, and shall return its result.] */
+                result = IoTHubClient_LL_SendEventAsync_TakeOwnership(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+
+                /*Codes_SRS_IOTHUBCLIENT_10_017: [ If "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK and IoTHubClient_LL_SendEventAsync_TakeOwnership fails because the send queue is full, IoTHubClient_SendEventAsync_TakeOwnership shall release the lock, wait for the worker thread to make room and call IoTHubClient_LL_SendEventAsync_TakeOwnership again. ]*/
+                while ((result == IOTHUB_CLIENT_ERROR) && iotHubClientInstance->BlockWhenSendQueueFull && IoTHubClient_LL_WasSendQueueFull(iotHubClientInstance->IoTHubClientLLHandle))
+                {
+                    if (WaitForRoomInSendQueue(iotHubClientInstance) != 0)
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_10_018: [ If acquiring the lock again fails, IoTHubClient_SendEventAsync and IoTHubClient_SendEventAsync_TakeOwnership shall return IOTHUB_CLIENT_ERROR. ]*/
+                        isLocked = false;
+                        break;
+                    }
+                    result = IoTHubClient_LL_SendEventAsync_TakeOwnership(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+                }
+
+                /*Codes_SRS_IOTHUBCLIENT_10_010: [ When IoTHubClient_LL_SendEventAsync_TakeOwnership succeeds and the "workerIdleWaitTime" option is not 0, IoTHubClient_SendEventAsync_TakeOwnership shall wake up the worker thread. ]*/
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    SignalWorkerThread(iotHubClientInstance);
+                }
+                else
+                {
+                    UnwrapEventConfirmation(eventConfirmationCallback, userContextCallback);
+                }
+            }
+
+            /* Codes_SRS_IOTHUBCLIENT_10_002: [IoTHubClient_SendEventAsync_TakeOwnership shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
+            if (isLocked)
+            {
+                (void)Unlock(iotHubClientInstance->LockHandle);
+            }
+        }
+    }
+
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT SendEventBatchAsync_LL(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership)
+{
+    return takeOwnership ?
+        IoTHubClient_LL_SendEventBatchAsync_TakeOwnership(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandles, eventMessageCount, batchConfirmation, eventConfirmationCallback, userContextCallback) :
+        IoTHubClient_LL_SendEventBatchAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandles, eventMessageCount, batchConfirmation, eventConfirmationCallback, userContextCallback);
+}
+
+static IOTHUB_CLIENT_RESULT SendEventBatchAsync_Impl(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_024: [ If iotHubClientHandle is NULL, IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        /*Codes_SRS_IOTHUBCLIENT_10_025: [ IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall acquire the lock created in IoTHubClient_Create once for the whole batch. ]*/
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_026: [ If acquiring the lock fails, IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall return IOTHUB_CLIENT_ERROR. ]*/
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            bool isLocked = true;
+
+            /*Codes_SRS_IOTHUBCLIENT_10_027: [ IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall start the worker thread if it was not previously started. If that fails they shall return IOTHUB_CLIENT_ERROR. ]*/
+            if ((result = StartWorkerThreadIfNeeded(iotHubClientInstance)) != IOTHUB_CLIENT_OK)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("Could not start worker thread");
+            }
+            else if ((result = WrapEventConfirmation(iotHubClientInstance, &eventConfirmationCallback, &userContextCallback, ((batchConfirmation == IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE) ? eventMessageCount : 1))) != IOTHUB_CLIENT_OK)
+            {
+                LogError("unable to dispatch the event confirmation");
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_10_028: [ IoTHubClient_SendEventBatchAsync shall call IoTHubClient_LL_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall call IoTHubClient_LL_SendEventBatchAsync_TakeOwnership, passing all their parameters, and shall return its result. ]*/
+                result = SendEventBatchAsync_LL(iotHubClientInstance, eventMessageHandles, eventMessageCount, batchConfirmation, eventConfirmationCallback, userContextCallback, takeOwnership);
+
+                /*Codes_SRS_IOTHUBCLIENT_10_029: [ If "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK and the batch was refused because the send queue is full, the lock shall be released until the worker thread makes room and the batch shall be submitted again. ]*/
+                while ((result == IOTHUB_CLIENT_ERROR) && iotHubClientInstance->BlockWhenSendQueueFull && IoTHubClient_LL_WasSendQueueFull(iotHubClientInstance->IoTHubClientLLHandle))
+                {
+                    if (WaitForRoomInSendQueue(iotHubClientInstance) != 0)
+                    {
+                        isLocked = false;
+                        break;
+                    }
+                    result = SendEventBatchAsync_LL(iotHubClientInstance, eventMessageHandles, eventMessageCount, batchConfirmation, eventConfirmationCallback, userContextCallback, takeOwnership);
+                }
+
+                /*Codes_SRS_IOTHUBCLIENT_10_030: [ When the batch is queued and the "workerIdleWaitTime" option is not 0, the worker thread shall be woken up once. ]*/
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    SignalWorkerThread(iotHubClientInstance);
+                }
+                else
+                {
+                    UnwrapEventConfirmation(eventConfirmationCallback, userContextCallback);
+                }
+            }
+
+            if (isLocked)
+            {
+                (void)Unlock(iotHubClientInstance->LockHandle);
+            }
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_SendEventBatchAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return SendEventBatchAsync_Impl(iotHubClientHandle, eventMessageHandles, eventMessageCount, batchConfirmation, eventConfirmationCallback, userContextCallback, false);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_SendEventBatchAsync_TakeOwnership(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return SendEventBatchAsync_Impl(iotHubClientHandle, eventMessageHandles, eventMessageCount, batchConfirmation, eventConfirmationCallback, userContextCallback, true);
 }
 
 IOTHUB_CLIENT_RESULT IoTHubClient_GetSendStatus(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
@@ -567,7 +1340,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_GetSendStatus(IOTHUB_CLIENT_HANDLE iotHubClien
         {
             /* Codes_SRS_IOTHUBCLIENT_01_022: [IoTHubClient_GetSendStatus shall call IoTHubClient_LL_GetSendStatus, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameter iotHubClientStatus.] */
             /* Codes_SRS_IOTHUBCLIENT_01_024: [Otherwise, IoTHubClient_GetSendStatus shall return the result of IoTHubClient_LL_GetSendStatus.] */
-            result = IoTHubClient_LL_GetSendStatus(iotHubClientInstance->IoTHubClientLLHandle, iotHubClientStatus);
+            result = GetSendStatus_Impl(iotHubClientInstance, iotHubClientStatus);
 
             /* Codes_SRS_IOTHUBCLIENT_01_033: [IoTHubClient_GetSendStatus shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
             (void)Unlock(iotHubClientInstance->LockHandle);
@@ -610,7 +1383,14 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetMessageCallback(IOTHUB_CLIENT_HANDLE iotHub
             else
             {
                 /* Codes_SRS_IOTHUBCLIENT_01_017: [IoTHubClient_SetMessageCallback shall call IoTHubClient_LL_SetMessageCallback, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameters messageCallback and userContextCallback.] */
+                /*Codes_SRS_IOTHUBCLIENT_10_064: [ The message callback shall not be dispatched: whether the "callbackDispatchThread" option is enabled or not, IoTHubClient_SetMessageCallback shall pass messageCallback and userContextCallback to IoTHubClient_LL_SetMessageCallback, so that the disposition messageCallback returns is the one the transport gives to IoT Hub. ]*/
                 result = IoTHubClient_LL_SetMessageCallback(iotHubClientInstance->IoTHubClientLLHandle, messageCallback, userContextCallback);
+
+                /*Codes_SRS_IOTHUBCLIENT_10_011: [ When IoTHubClient_LL_SetMessageCallback succeeds and the "workerIdleWaitTime" option is not 0, IoTHubClient_SetMessageCallback shall wake up the worker thread. ]*/
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    SignalWorkerThread(iotHubClientInstance);
+                }
             }
 
             /* Codes_SRS_IOTHUBCLIENT_01_027: [IoTHubClient_SetMessageCallback shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
@@ -621,6 +1401,39 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetMessageCallback(IOTHUB_CLIENT_HANDLE iotHub
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_SetSendQueueCallback(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_SEND_QUEUE_CALLBACK sendQueueCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_020: [ If iotHubClientHandle is NULL, IoTHubClient_SetSendQueueCallback shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        /*Codes_SRS_IOTHUBCLIENT_10_021: [ IoTHubClient_SetSendQueueCallback shall be made thread-safe by using the lock created in IoTHubClient_Create. ]*/
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_022: [ If acquiring the lock fails, IoTHubClient_SetSendQueueCallback shall return IOTHUB_CLIENT_ERROR. ]*/
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_023: [ IoTHubClient_SetSendQueueCallback shall call IoTHubClient_LL_SetSendQueueCallback, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameters sendQueueCallback and userContextCallback, and shall return its result. ]*/
+            result = IoTHubClient_LL_SetSendQueueCallback(iotHubClientInstance->IoTHubClientLLHandle, sendQueueCallback, userContextCallback);
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_GetLastMessageReceiveTime(IOTHUB_CLIENT_HANDLE iotHubClientHandle, time_t* lastMessageReceiveTime)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -656,6 +1469,261 @@ IOTHUB_CLIENT_RESULT IoTHubClient_GetLastMessageReceiveTime(IOTHUB_CLIENT_HANDLE
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_GetPoolStatistics(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_POOL_STATISTICS* poolStatistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_031: [ If iotHubClientHandle is NULL, IoTHubClient_GetPoolStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        /*Codes_SRS_IOTHUBCLIENT_10_032: [ IoTHubClient_GetPoolStatistics shall be made thread-safe by using the lock created in IoTHubClient_Create. If acquiring the lock fails, IoTHubClient_GetPoolStatistics shall return IOTHUB_CLIENT_ERROR. ]*/
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_033: [ IoTHubClient_GetPoolStatistics shall call IoTHubClient_LL_GetPoolStatistics, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameter poolStatistics, and return what IoTHubClient_LL_GetPoolStatistics returns. ]*/
+            result = IoTHubClient_LL_GetPoolStatistics(iotHubClientInstance->IoTHubClientLLHandle, poolStatistics);
+
+            Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_GetStatistics(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_060: [ If iotHubClientHandle is NULL, IoTHubClient_GetStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        /*Codes_SRS_IOTHUBCLIENT_10_061: [ IoTHubClient_GetStatistics shall be made thread-safe by using the lock created in IoTHubClient_Create. If acquiring the lock fails, IoTHubClient_GetStatistics shall return IOTHUB_CLIENT_ERROR. ]*/
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_062: [ IoTHubClient_GetStatistics shall call IoTHubClient_LL_GetStatistics, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameter statistics, and return what IoTHubClient_LL_GetStatistics returns. ]*/
+            result = IoTHubClient_LL_GetStatistics(iotHubClientInstance->IoTHubClientLLHandle, statistics);
+
+            Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT SetWorkerIdleWaitTime(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, unsigned int idleWaitTime)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (iotHubClientInstance->TransportHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_012: [ If the transport connection is shared, IoTHubClient_SetOption shall call IoTHubTransport_SetWorkerIdleWaitTime and return what IoTHubTransport_SetWorkerIdleWaitTime returns. ]*/
+        result = IoTHubTransport_SetWorkerIdleWaitTime(iotHubClientInstance->TransportHandle, idleWaitTime);
+    }
+    /*Codes_SRS_IOTHUBCLIENT_10_013: [ Otherwise IoTHubClient_SetOption shall create the worker condition by calling Condition_Init if it was not created before and the value is not 0. ]*/
+    else if ((idleWaitTime > 0) && (iotHubClientInstance->WorkerCondition == NULL) &&
+        ((iotHubClientInstance->WorkerCondition = Condition_Init()) == NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_014: [ If Condition_Init fails, IoTHubClient_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("unable to Condition_Init");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    if (result == IOTHUB_CLIENT_OK)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_015: [ On success IoTHubClient_SetOption shall store the value, wake up the worker thread so that it picks up the new value and return IOTHUB_CLIENT_OK. ]*/
+        if ((iotHubClientInstance->TransportHandle == NULL) && (iotHubClientInstance->WorkerCondition != NULL))
+        {
+            (void)Condition_Post(iotHubClientInstance->WorkerCondition);
+        }
+        iotHubClientInstance->WorkerIdleWaitTime = idleWaitTime;
+    }
+    return result;
+}
+
+/*used by the shared transport worker thread, which already holds the lock*/
+IOTHUB_CLIENT_RESULT IoTHubClient_GetSendStatus_NoLock(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (iotHubClientHandle == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        result = GetSendStatus_Impl((IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle, iotHubClientStatus);
+    }
+    return result;
+}
+
+/*used by the shared transport worker thread, which already holds the lock*/
+void IoTHubClient_DrainSendHandoff_NoLock(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_10_045: [ If iotHubClientHandle is NULL, IoTHubClient_DrainSendHandoff_NoLock shall do nothing. Otherwise it shall pass the handed over events to IoTHubClient_LL like the worker thread of IoTHubClient does. ]*/
+    if (iotHubClientHandle == NULL)
+    {
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        DrainSendHandoff((IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle);
+    }
+}
+
+static IOTHUB_CLIENT_RESULT SetSendEventHandoff(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, bool enable)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (!enable)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_035: [ Once the handoff exists, setting "sendEventHandoff" to false shall fail and return IOTHUB_CLIENT_ERROR. Setting it to false before, or to true again, shall do nothing and return IOTHUB_CLIENT_OK. ]*/
+        if (iotHubClientInstance->SendHandoff != NULL)
+        {
+            LogError("\"sendEventHandoff\" cannot be disabled once enabled");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    else if (iotHubClientInstance->SendHandoff != NULL)
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_10_034: [ When "sendEventHandoff" is set to true, IoTHubClient_SetOption shall create the handoff by calling IoTHubClient_Handoff_Create and start the worker thread if it was not previously started. If any of these fails IoTHubClient_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+    else if ((iotHubClientInstance->SendHandoff = IoTHubClient_Handoff_Create()) == NULL)
+    {
+        LogError("unable to IoTHubClient_Handoff_Create");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if (StartWorkerThreadIfNeeded(iotHubClientInstance) != IOTHUB_CLIENT_OK)
+    {
+        LogError("Could not start worker thread");
+        IoTHubClient_Handoff_Destroy(iotHubClientInstance->SendHandoff);
+        iotHubClientInstance->SendHandoff = NULL;
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT SetCallbackDispatchThread(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, bool enable)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (!enable)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_047: [ Once the dispatch thread runs, setting "callbackDispatchThread" to false shall fail and return IOTHUB_CLIENT_ERROR. Setting it to false before, or to true again, shall do nothing and return IOTHUB_CLIENT_OK. ]*/
+        if (iotHubClientInstance->DispatchThreadHandle != NULL)
+        {
+            LogError("\"callbackDispatchThread\" cannot be disabled once enabled");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    else if (iotHubClientInstance->DispatchThreadHandle != NULL)
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_10_046: [ When "callbackDispatchThread" is set to true, IoTHubClient_SetOption shall create the dispatch lock by calling Lock_Init, the dispatch condition by calling Condition_Init and start the dispatch thread by calling ThreadAPI_Create. If any of these fails IoTHubClient_SetOption shall free what it created and return IOTHUB_CLIENT_ERROR. ]*/
+    else if ((iotHubClientInstance->DispatchLock = Lock_Init()) == NULL)
+    {
+        LogError("unable to Lock_Init");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((iotHubClientInstance->DispatchCondition = Condition_Init()) == NULL)
+    {
+        LogError("unable to Condition_Init");
+        Lock_Deinit(iotHubClientInstance->DispatchLock);
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        iotHubClientInstance->DispatchHead = NULL;
+        iotHubClientInstance->DispatchTail = NULL;
+        iotHubClientInstance->StopDispatchThread = 0;
+        if (ThreadAPI_Create(&iotHubClientInstance->DispatchThreadHandle, Dispatch_Thread, iotHubClientInstance) != THREADAPI_OK)
+        {
+            LogError("unable to ThreadAPI_Create");
+            iotHubClientInstance->DispatchThreadHandle = NULL;
+            Condition_Deinit(iotHubClientInstance->DispatchCondition);
+            Lock_Deinit(iotHubClientInstance->DispatchLock);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT SetSendQueueFullPolicy(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, const IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY* policy)
+{
+    IOTHUB_CLIENT_RESULT result;
+    bool block = (*policy == IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK);
+    if (block && (iotHubClientInstance->SendQueueCondition == NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_065: [ When "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK, IoTHubClient_SetOption shall create the send queue condition by calling Condition_Init if it was not created before and have it signalled by calling IoTHubClient_LL_SetSendQueueRoomCallback. ]*/
+        if ((iotHubClientInstance->SendQueueCondition = Condition_Init()) == NULL)
+        {
+            LogError("unable to Condition_Init");
+        }
+        else
+        {
+            IoTHubClient_LL_SetSendQueueRoomCallback(iotHubClientInstance->IoTHubClientLLHandle, OnSendQueueRoom, iotHubClientInstance);
+        }
+    }
+
+    if (block && (iotHubClientInstance->SendQueueCondition == NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_066: [ If Condition_Init fails, IoTHubClient_SetOption shall return IOTHUB_CLIENT_ERROR without calling IoTHubClient_LL_SetOption. ]*/
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
+    else if ((result = IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, "sendQueueFullPolicy", policy)) != IOTHUB_CLIENT_OK)
+    {
+        LogError("IoTHubClient_LL_SetOption failed");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_019: [ When IoTHubClient_LL_SetOption accepts "sendQueueFullPolicy", IoTHubClient_SetOption shall remember whether the policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK. ]*/
+        iotHubClientInstance->BlockWhenSendQueueFull = block;
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_SetOption(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const char* optionName, const void* value)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -684,11 +1752,30 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetOption(IOTHUB_CLIENT_HANDLE iotHubClientHan
         }
         else
         {
-            /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
-            result = IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, optionName, value);
-            if (result != IOTHUB_CLIENT_OK)
+            if (strcmp(optionName, "workerIdleWaitTime") == 0)
             {
-                LogError("IoTHubClient_LL_SetOption failed");
+                result = SetWorkerIdleWaitTime(iotHubClientInstance, *(const unsigned int*)value);
+            }
+            else if (strcmp(optionName, "sendEventHandoff") == 0)
+            {
+                result = SetSendEventHandoff(iotHubClientInstance, *(const bool*)value);
+            }
+            else if (strcmp(optionName, "callbackDispatchThread") == 0)
+            {
+                result = SetCallbackDispatchThread(iotHubClientInstance, *(const bool*)value);
+            }
+            else if (strcmp(optionName, "sendQueueFullPolicy") == 0)
+            {
+                result = SetSendQueueFullPolicy(iotHubClientInstance, (const IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY*)value);
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
+                result = IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, optionName, value);
+                if (result != IOTHUB_CLIENT_OK)
+                {
+                    LogError("IoTHubClient_LL_SetOption failed");
+                }
             }
 
             Unlock(iotHubClientInstance->LockHandle);
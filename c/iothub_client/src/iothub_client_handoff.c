@@ -0,0 +1,203 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "iothub_client_handoff.h"
+
+/*the compilers with atomic operations on pointers push and take without a lock, the others fall back to a lock*/
+#if defined(_MSC_VER)
+#include <windows.h>
+#elif defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+/*gcc 4.7+ and clang*/
+#else
+#define HANDOFF_USE_LOCK
+#include "azure_c_shared_utility/lock.h"
+#endif
+
+typedef struct IOTHUB_CLIENT_HANDOFF_DATA_TAG
+{
+    IOTHUB_CLIENT_HANDOFF_ITEM* volatile head; /*the last item pushed, items are chained from the newest to the oldest*/
+#ifdef HANDOFF_USE_LOCK
+    LOCK_HANDLE lock;
+#endif
+} IOTHUB_CLIENT_HANDOFF_DATA;
+
+#if defined(_MSC_VER)
+static IOTHUB_CLIENT_HANDOFF_ITEM* loadHead(IOTHUB_CLIENT_HANDOFF_DATA* handoff)
+{
+    return (IOTHUB_CLIENT_HANDOFF_ITEM*)InterlockedCompareExchangePointer((PVOID volatile*)&handoff->head, NULL, NULL);
+}
+
+static bool replaceHead(IOTHUB_CLIENT_HANDOFF_DATA* handoff, IOTHUB_CLIENT_HANDOFF_ITEM* expected, IOTHUB_CLIENT_HANDOFF_ITEM* desired)
+{
+    return InterlockedCompareExchangePointer((PVOID volatile*)&handoff->head, desired, expected) == expected;
+}
+
+static IOTHUB_CLIENT_HANDOFF_ITEM* exchangeHead(IOTHUB_CLIENT_HANDOFF_DATA* handoff, IOTHUB_CLIENT_HANDOFF_ITEM* desired)
+{
+    return (IOTHUB_CLIENT_HANDOFF_ITEM*)InterlockedExchangePointer((PVOID volatile*)&handoff->head, desired);
+}
+#elif !defined(HANDOFF_USE_LOCK)
+static IOTHUB_CLIENT_HANDOFF_ITEM* loadHead(IOTHUB_CLIENT_HANDOFF_DATA* handoff)
+{
+    return __atomic_load_n(&handoff->head, __ATOMIC_ACQUIRE);
+}
+
+static bool replaceHead(IOTHUB_CLIENT_HANDOFF_DATA* handoff, IOTHUB_CLIENT_HANDOFF_ITEM* expected, IOTHUB_CLIENT_HANDOFF_ITEM* desired)
+{
+    /*release: the consumer that takes desired sees everything the producer wrote in it*/
+    return __atomic_compare_exchange_n(&handoff->head, &expected, desired, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+static IOTHUB_CLIENT_HANDOFF_ITEM* exchangeHead(IOTHUB_CLIENT_HANDOFF_DATA* handoff, IOTHUB_CLIENT_HANDOFF_ITEM* desired)
+{
+    return __atomic_exchange_n(&handoff->head, desired, __ATOMIC_ACQUIRE);
+}
+#else
+static IOTHUB_CLIENT_HANDOFF_ITEM* loadHead(IOTHUB_CLIENT_HANDOFF_DATA* handoff)
+{
+    IOTHUB_CLIENT_HANDOFF_ITEM* result;
+    (void)Lock(handoff->lock);
+    result = handoff->head;
+    (void)Unlock(handoff->lock);
+    return result;
+}
+
+static bool replaceHead(IOTHUB_CLIENT_HANDOFF_DATA* handoff, IOTHUB_CLIENT_HANDOFF_ITEM* expected, IOTHUB_CLIENT_HANDOFF_ITEM* desired)
+{
+    bool result;
+    (void)Lock(handoff->lock);
+    result = (handoff->head == expected);
+    if (result)
+    {
+        handoff->head = desired;
+    }
+    (void)Unlock(handoff->lock);
+    return result;
+}
+
+static IOTHUB_CLIENT_HANDOFF_ITEM* exchangeHead(IOTHUB_CLIENT_HANDOFF_DATA* handoff, IOTHUB_CLIENT_HANDOFF_ITEM* desired)
+{
+    IOTHUB_CLIENT_HANDOFF_ITEM* result;
+    (void)Lock(handoff->lock);
+    result = handoff->head;
+    handoff->head = desired;
+    (void)Unlock(handoff->lock);
+    return result;
+}
+#endif
+
+IOTHUB_CLIENT_HANDOFF_HANDLE IoTHubClient_Handoff_Create(void)
+{
+    /*Codes_SRS_IOTHUBCLIENT_HANDOFF_10_001: [IoTHubClient_Handoff_Create shall allocate an empty handoff and return a non-NULL handle to it.]*/
+    IOTHUB_CLIENT_HANDOFF_DATA* result = (IOTHUB_CLIENT_HANDOFF_DATA*)malloc(sizeof(IOTHUB_CLIENT_HANDOFF_DATA));
+    if (result == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_HANDOFF_10_002: [If any operation fails then IoTHubClient_Handoff_Create shall fail and return NULL.]*/
+        LogError("unable to malloc");
+    }
+    else
+    {
+        result->head = NULL;
+#ifdef HANDOFF_USE_LOCK
+        if ((result->lock = Lock_Init()) == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_HANDOFF_10_002: [If any operation fails then IoTHubClient_Handoff_Create shall fail and return NULL.]*/
+            LogError("unable to Lock_Init");
+            free(result);
+            result = NULL;
+        }
+#endif
+    }
+    return result;
+}
+
+bool IoTHubClient_Handoff_Push(IOTHUB_CLIENT_HANDOFF_HANDLE handle, IOTHUB_CLIENT_HANDOFF_ITEM* item)
+{
+    bool result;
+    /*Codes_SRS_IOTHUBCLIENT_HANDOFF_10_003: [If handle or item is NULL then IoTHubClient_Handoff_Push shall do nothing and return false.]*/
+    if ((handle == NULL) || (item == NULL))
+    {
+        LogError("invalid arg IOTHUB_CLIENT_HANDOFF_HANDLE handle=%p, IOTHUB_CLIENT_HANDOFF_ITEM* item=%p", handle, item);
+        result = false;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_HANDOFF_10_004: [IoTHubClient_Handoff_Push shall add item to the handoff without blocking the other producers and the consumer, and shall be safe to call from any number of threads at once.]*/
+        IOTHUB_CLIENT_HANDOFF_ITEM* head;
+        do
+        {
+            head = loadHead(handle);
+            item->next = head;
+        } while (!replaceHead(handle, head, item));
+
+        /*Codes_SRS_IOTHUBCLIENT_HANDOFF_10_005: [IoTHubClient_Handoff_Push shall return true if the handoff was empty before item was added, false otherwise.]*/
+        result = (head == NULL);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_HANDOFF_ITEM* IoTHubClient_Handoff_TakeAll(IOTHUB_CLIENT_HANDOFF_HANDLE handle)
+{
+    IOTHUB_CLIENT_HANDOFF_ITEM* result;
+    /*Codes_SRS_IOTHUBCLIENT_HANDOFF_10_006: [If handle is NULL then IoTHubClient_Handoff_TakeAll shall return NULL.]*/
+    if (handle == NULL)
+    {
+        LogError("invalid arg IOTHUB_CLIENT_HANDOFF_HANDLE handle=%p", handle);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_HANDOFF_10_007: [IoTHubClient_Handoff_TakeAll shall empty the handoff and return its items chained through next, oldest first, or NULL when it was empty.]*/
+        IOTHUB_CLIENT_HANDOFF_ITEM* newestFirst = exchangeHead(handle, NULL);
+        result = NULL;
+        while (newestFirst != NULL)
+        {
+            IOTHUB_CLIENT_HANDOFF_ITEM* next = newestFirst->next;
+            newestFirst->next = result;
+            result = newestFirst;
+            newestFirst = next;
+        }
+    }
+    return result;
+}
+
+bool IoTHubClient_Handoff_IsEmpty(IOTHUB_CLIENT_HANDOFF_HANDLE handle)
+{
+    bool result;
+    /*Codes_SRS_IOTHUBCLIENT_HANDOFF_10_008: [If handle is NULL then IoTHubClient_Handoff_IsEmpty shall return true.]*/
+    if (handle == NULL)
+    {
+        LogError("invalid arg IOTHUB_CLIENT_HANDOFF_HANDLE handle=%p", handle);
+        result = true;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_HANDOFF_10_009: [Otherwise IoTHubClient_Handoff_IsEmpty shall return true if the handoff has no item, false otherwise.]*/
+        result = (loadHead(handle) == NULL);
+    }
+    return result;
+}
+
+void IoTHubClient_Handoff_Destroy(IOTHUB_CLIENT_HANDOFF_HANDLE handle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_HANDOFF_10_010: [If handle is NULL then IoTHubClient_Handoff_Destroy shall do nothing.]*/
+    if (handle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_HANDOFF_10_011: [IoTHubClient_Handoff_Destroy shall free the handoff. Items still in the handoff are not freed.]*/
+        if (loadHead(handle) != NULL)
+        {
+            LogError("destroying a handoff that is not empty");
+        }
+#ifdef HANDOFF_USE_LOCK
+        Lock_Deinit(handle->lock);
+#endif
+        free(handle);
+    }
+}
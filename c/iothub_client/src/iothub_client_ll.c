@@ -16,13 +16,20 @@
 #include "iothub_client_private.h"
 #include "iothub_client_version.h"
 #include "iothub_transport_ll.h"
+#include "iothub_client_ll_pool.h"
 
 #ifndef DONT_USE_UPLOADTOBLOB
 #include "iothub_client_ll_uploadtoblob.h"
 #endif
 
+#ifndef DONT_USE_JOURNAL
+#include "iothub_client_ll_journal.h"
+#endif
+
 #define LOG_ERROR_RESULT LogError("result = %s", ENUM_TO_STRING(IOTHUB_CLIENT_RESULT, result));
 #define INDEFINITE_TIME ((time_t)(-1))
+#define JOURNAL_DEFAULT_SEGMENT_SIZE (1024 * 1024)
+#define JOURNAL_DEFAULT_SYNC_INTERVAL_MS 1000
 
 DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
 DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_RESULT_VALUES);
@@ -39,12 +46,48 @@ typedef struct IOTHUB_CLIENT_LL_HANDLE_DATA_TAG
     time_t lastMessageReceiveTime;
     TICK_COUNTER_HANDLE tickCounter; /*shared tickcounter used to track message timeouts in waitingToSend list*/
     uint64_t currentMessageTimeout;
+    IOTHUB_MESSAGE_LIST** timeoutHeap; /*binary min-heap on ms_timesOutAfter of all the messages that have a timeout, are in waitingToSend and have not completed yet*/
+    size_t timeoutHeapCount;
+    size_t timeoutHeapCapacity;
+    size_t timeoutHeapSuspendedCount; /*messages whose timeout the transport suspended, each keeps its slot in the heap*/
+    size_t sendQueueCount; /*number of messages accepted by SendEventAsync that have not completed yet*/
+    size_t sendQueueHeldCount; /*number of those messages the transport holds out of waitingToSend*/
+    size_t sendQueueBytes; /*payload bytes of those messages, only counted while sendQueueMaxBytes is not 0*/
+    size_t sendQueueMaxMessages; /*"sendQueueMaxMessages" option, 0 means no limit*/
+    size_t sendQueueMaxBytes; /*"sendQueueMaxBytes" option, 0 means no limit*/
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY sendQueueFullPolicy;
+    bool sendQueueWasFull; /*the last SendEventAsync was refused because there was no room in the send queue*/
+    size_t sendQueueHighWatermark; /*"sendQueueHighWatermark" option, 0 means no watermark callbacks*/
+    size_t sendQueueLowWatermark;
+    bool sendQueueAboveHighWatermark;
+    IOTHUB_CLIENT_SEND_QUEUE_CALLBACK sendQueueCallback;
+    void* sendQueueUserContextCallback;
+    IOTHUB_CLIENT_LL_SEND_QUEUE_ROOM_CALLBACK sendQueueRoomCallback; /*set by IoTHubClient to wake up the threads waiting for room in the send queue*/
+    void* sendQueueRoomContext;
+    IOTHUB_CLIENT_LL_POOL_HANDLE messagePool; /*created by the "messagePoolSize" option, NULL when the IOTHUB_MESSAGE_LIST records are malloc'd one by one*/
+    IOTHUB_CLIENT_STATISTICS statistics; /*the queue depths are filled in by IoTHubClient_LL_GetStatistics from sendQueueCount and sendQueueHeldCount, only the counters are kept up to date here*/
+    bool sendStatistics; /*"sendStatistics" option, the payload bytes and the latency of every message are recorded*/
 #ifndef DONT_USE_UPLOADTOBLOB
     IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE uploadToBlobHandle;
 #endif
+#ifndef DONT_USE_JOURNAL
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE journalHandle; /*created by the "journalPath" option, NULL when the messages waiting to be sent are only kept in memory*/
+    size_t journalSegmentSize;
+    unsigned int journalSyncInterval;
+    uint64_t journalLastSync;
+#endif
 
 }IOTHUB_CLIENT_LL_HANDLE_DATA;
 
+/*shared by the messages of a batch sent with IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE*/
+typedef struct EVENT_BATCH_TAG
+{
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback;
+    void* userContextCallback;
+    size_t pendingCount; /*messages of the batch that have not been confirmed yet*/
+    IOTHUB_CLIENT_CONFIRMATION_RESULT result; /*IOTHUB_CLIENT_CONFIRMATION_OK until a message of the batch is confirmed with something else*/
+}EVENT_BATCH;
+
 static const char HOSTNAME_TOKEN[] = "HostName";
 static const char DEVICEID_TOKEN[] = "DeviceId";
 static const char X509_TOKEN[] = "x509";
@@ -291,6 +334,37 @@ IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_CreateFromConnectionString(const char* c
     return result;
 }
 
+static void initSendQueue(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_014: [ By default the send queue shall have no limits and its full policy shall be IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT. ]*/
+    handleData->sendQueueCount = 0;
+    handleData->sendQueueHeldCount = 0;
+    handleData->sendQueueBytes = 0;
+    handleData->sendQueueMaxMessages = 0;
+    handleData->sendQueueMaxBytes = 0;
+    handleData->sendQueueFullPolicy = IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT;
+    handleData->sendQueueWasFull = false;
+    handleData->sendQueueHighWatermark = 0;
+    handleData->sendQueueLowWatermark = 0;
+    handleData->sendQueueAboveHighWatermark = false;
+    handleData->sendQueueCallback = NULL;
+    handleData->sendQueueUserContextCallback = NULL;
+    handleData->sendQueueRoomCallback = NULL;
+    handleData->sendQueueRoomContext = NULL;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_055: [ By default there shall be no message pool and every IOTHUB_MESSAGE_LIST record shall be allocated with malloc. ]*/
+    handleData->messagePool = NULL;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_066: [ The statistics counters shall start at 0 and by default the payload bytes and the latency of the messages shall not be recorded. ]*/
+    (void)memset(&handleData->statistics, 0, sizeof(IOTHUB_CLIENT_STATISTICS));
+    handleData->sendStatistics = false;
+#ifndef DONT_USE_JOURNAL
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_031: [ By default there shall be no journal, its segment size shall be 1 MB and its sync interval 1000 ms. ]*/
+    handleData->journalHandle = NULL;
+    handleData->journalSegmentSize = JOURNAL_DEFAULT_SEGMENT_SIZE;
+    handleData->journalSyncInterval = JOURNAL_DEFAULT_SYNC_INTERVAL_MS;
+    handleData->journalLastSync = 0;
+#endif
+}
+
 static void setTransportProtocol(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, TRANSPORT_PROVIDER* protocol)
 {
     handleData->IoTHubTransport_GetHostname = protocol->IoTHubTransport_GetHostname;
@@ -404,6 +478,11 @@ IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_Create(const IOTHUB_CLIENT_CONFIG* confi
                             handleData->isSharedTransport = false;
                             /*Codes_SRS_IOTHUBCLIENT_LL_02_042: [ By default, messages shall not timeout. ]*/
                             handleData->currentMessageTimeout = 0;
+                            handleData->timeoutHeap = NULL;
+                            handleData->timeoutHeapCount = 0;
+                            handleData->timeoutHeapCapacity = 0;
+                            handleData->timeoutHeapSuspendedCount = 0;
+                            initSendQueue(handleData);
                             result = handleData;
                         }
                     }
@@ -540,6 +619,11 @@ IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_CreateWithTransport(const IOTHUB_CLIENT_
                                 handleData->isSharedTransport = true;
                                 /*Codes_SRS_IOTHUBCLIENT_LL_02_042: [ By default, messages shall not timeout. ]*/
                                 handleData->currentMessageTimeout = 0;
+                                handleData->timeoutHeap = NULL;
+                                handleData->timeoutHeapCount = 0;
+                                handleData->timeoutHeapCapacity = 0;
+                                handleData->timeoutHeapSuspendedCount = 0;
+                                initSendQueue(handleData);
                                 result = handleData;
                             }
                         }
@@ -555,6 +639,29 @@ IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_CreateWithTransport(const IOTHUB_CLIENT_
     return result;
 }
 
+static void timeoutHeap_remove(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList);
+static void sendQueue_release(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList);
+
+static IOTHUB_MESSAGE_LIST* messageList_alloc(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_059: [ When there is a message pool the IOTHUB_MESSAGE_LIST records shall be taken from it and given back to it; a record the pool cannot serve shall be allocated with malloc. ]*/
+    return (handleData->messagePool == NULL) ?
+        (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)) :
+        (IOTHUB_MESSAGE_LIST*)IoTHubClient_LL_Pool_Alloc(handleData->messagePool);
+}
+
+static void messageList_free(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList)
+{
+    if (handleData->messagePool == NULL)
+    {
+        free(messageList);
+    }
+    else
+    {
+        IoTHubClient_LL_Pool_Free(handleData->messagePool, messageList);
+    }
+}
+
 void IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
     /*Codes_SRS_IOTHUBCLIENT_LL_02_009: [IoTHubClient_LL_Destroy shall do nothing if parameter iotHubClientHandle is NULL.]*/
@@ -563,6 +670,14 @@ void IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
         PDLIST_ENTRY unsend;
         /*Codes_SRS_IOTHUBCLIENT_LL_17_010: [IoTHubClient_LL_Destroy  shall call the underlaying layer's _Unregister function] */
         IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+#ifndef DONT_USE_JOURNAL
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_039: [ IoTHubClient_LL_Destroy shall destroy the journal before anything else, so that the messages that are still waiting to be sent stay in the journal. ]*/
+        if (handleData->journalHandle != NULL)
+        {
+            IoTHubClient_LL_Journal_Destroy(handleData->journalHandle);
+            handleData->journalHandle = NULL;
+        }
+#endif
         handleData->IoTHubTransport_Unregister(handleData->deviceHandle);
         if (handleData->isSharedTransport == false)
         {
@@ -573,281 +688,1350 @@ void IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
         while ((unsend = DList_RemoveHeadList(&(handleData->waitingToSend))) != &(handleData->waitingToSend))
         {
             IOTHUB_MESSAGE_LIST* temp = containingRecord(unsend, IOTHUB_MESSAGE_LIST, entry);
+            /*the callback below can queue a message, which looks at the timeout heap and the send queue*/
+            timeoutHeap_remove(handleData, temp);
+            sendQueue_release(handleData, temp);
             /*Codes_SRS_IOTHUBCLIENT_LL_02_033: [Otherwise, IoTHubClient_LL_Destroy shall complete all the event message callbacks that are in the waitingToSend list with the result IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY.] */
             if (temp->callback != NULL)
             {
                 temp->callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, temp->context);
             }
             IoTHubMessage_Destroy(temp->messageHandle);
-            free(temp);
+            messageList_free(handleData, temp);
+        }
+        if (handleData->timeoutHeap != NULL)
+        {
+            free(handleData->timeoutHeap);
         }
         /*Codes_SRS_IOTHUBCLIENT_LL_17_011: [IoTHubClient_LL_Destroy  shall free the resources allocated by IoTHubClient (if any).] */
         tickcounter_destroy(handleData->tickCounter);
 #ifndef DONT_USE_UPLOADTOBLOB
         IoTHubClient_LL_UploadToBlob_Destroy(handleData->uploadToBlobHandle);
 #endif
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_060: [ IoTHubClient_LL_Destroy shall destroy the message pool, if any, after every record has been given back to it. ]*/
+        if (handleData->messagePool != NULL)
+        {
+            IoTHubClient_LL_Pool_Destroy(handleData->messagePool);
+        }
         free(handleData);
     }
 }
 
-/*Codes_SRS_IOTHUBCLIENT_LL_02_044: [ Messages already delivered to IoTHubClient_LL shall not have their timeouts modified by a new call to IoTHubClient_LL_SetOption. ]*/
-/*returns 0 on success, any other value is error*/
-static int attach_ms_timesOutAfter(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST *newEntry)
+/*the timeout heap keeps every message that has a timeout, from the moment it is queued until it completes, times out or is cancelled by the transport.
+DoTimeouts only looks at the top of the heap, so the cost of a DoWork no longer grows with the number of queued messages.
+A transport that keeps a message out of waitingToSend after its DoWork returns suspends its timeout with IoTHubClient_LL_SuspendMessageTimeout,
+which takes the message out of the heap but keeps its slot, and resumes it with IoTHubClient_LL_ResumeMessageTimeout when it gives the message back.
+So every message in the heap is in waitingToSend*/
+#define TIMEOUT_HEAP_INITIAL_CAPACITY 16
+#define TIMEOUT_HEAP_INDEX_EXPIRED ((size_t)-2)
+#define TIMEOUT_HEAP_INDEX_SUSPENDED ((size_t)-3)
+
+static void timeoutHeap_place(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t index, IOTHUB_MESSAGE_LIST* messageList)
+{
+    handleData->timeoutHeap[index] = messageList;
+    messageList->timeoutHeapIndex = index;
+}
+
+static void timeoutHeap_siftUp(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t index)
+{
+    IOTHUB_MESSAGE_LIST* messageList = handleData->timeoutHeap[index];
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / 2;
+        if (handleData->timeoutHeap[parent]->ms_timesOutAfter <= messageList->ms_timesOutAfter)
+        {
+            break;
+        }
+        timeoutHeap_place(handleData, index, handleData->timeoutHeap[parent]);
+        index = parent;
+    }
+    timeoutHeap_place(handleData, index, messageList);
+}
+
+static void timeoutHeap_siftDown(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t index)
+{
+    IOTHUB_MESSAGE_LIST* messageList = handleData->timeoutHeap[index];
+    for (;;)
+    {
+        size_t smallest = index;
+        uint64_t smallestKey = messageList->ms_timesOutAfter;
+        size_t child = 2 * index + 1;
+        if ((child < handleData->timeoutHeapCount) && (handleData->timeoutHeap[child]->ms_timesOutAfter < smallestKey))
+        {
+            smallest = child;
+            smallestKey = handleData->timeoutHeap[child]->ms_timesOutAfter;
+        }
+        child++;
+        if ((child < handleData->timeoutHeapCount) && (handleData->timeoutHeap[child]->ms_timesOutAfter < smallestKey))
+        {
+            smallest = child;
+        }
+        if (smallest == index)
+        {
+            break;
+        }
+        timeoutHeap_place(handleData, index, handleData->timeoutHeap[smallest]);
+        index = smallest;
+    }
+    timeoutHeap_place(handleData, index, messageList);
+}
+
+/*makes sure newCount more messages can be pushed in the heap, on top of the suspended messages. returns 0 on success, any other value is error*/
+static int timeoutHeap_reserve(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t newCount)
 {
     int result;
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClient_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
-    if (handleData->currentMessageTimeout == 0)
+    size_t usedCount = handleData->timeoutHeapCount + handleData->timeoutHeapSuspendedCount;
+    if (newCount <= handleData->timeoutHeapCapacity - usedCount)
     {
-        newEntry->ms_timesOutAfter = 0; /*do not timeout*/
         result = 0;
     }
     else
     {
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
-        if (tickcounter_get_current_ms(handleData->tickCounter, &newEntry->ms_timesOutAfter) != 0)
+        size_t newCapacity = (handleData->timeoutHeapCapacity == 0) ? TIMEOUT_HEAP_INITIAL_CAPACITY : (2 * handleData->timeoutHeapCapacity);
+        while (newCapacity - usedCount < newCount)
+        {
+            newCapacity *= 2;
+        }
+        IOTHUB_MESSAGE_LIST** newHeap = (IOTHUB_MESSAGE_LIST**)realloc(handleData->timeoutHeap, newCapacity * sizeof(IOTHUB_MESSAGE_LIST*));
+        if (newHeap == NULL)
         {
             result = __LINE__;
-            LogError("unable to get the current relative tickcount");
+            LogError("unable to grow the message timeout heap");
         }
         else
         {
-            newEntry->ms_timesOutAfter += handleData->currentMessageTimeout;
+            handleData->timeoutHeap = newHeap;
+            handleData->timeoutHeapCapacity = newCapacity;
             result = 0;
         }
     }
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+static void timeoutHeap_push(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList)
 {
-    IOTHUB_CLIENT_RESULT result;
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_011: [IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL.]*/
-    if (
-        (iotHubClientHandle == NULL) ||
-        (eventMessageHandle == NULL) ||
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_012: [IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL.] */
-        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL))
-        )
+    timeoutHeap_place(handleData, handleData->timeoutHeapCount, messageList);
+    handleData->timeoutHeapCount++;
+    timeoutHeap_siftUp(handleData, handleData->timeoutHeapCount - 1);
+}
+
+/*removes the element at index. The removed element is left in the slot right after the end of the heap*/
+static void timeoutHeap_removeAt(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t index)
+{
+    IOTHUB_MESSAGE_LIST* removed = handleData->timeoutHeap[index];
+    handleData->timeoutHeapCount--;
+    if (index < handleData->timeoutHeapCount)
     {
-        result = IOTHUB_CLIENT_INVALID_ARG;
-        LOG_ERROR_RESULT;
+        timeoutHeap_place(handleData, index, handleData->timeoutHeap[handleData->timeoutHeapCount]);
+        /*the moved element might belong above or below index, at most one of these does anything*/
+        timeoutHeap_siftDown(handleData, index);
+        timeoutHeap_siftUp(handleData, index);
+    }
+    timeoutHeap_place(handleData, handleData->timeoutHeapCount, removed);
+}
+
+/*removes messageList from the heap if it is tracked there or suspended, does nothing otherwise*/
+static void timeoutHeap_remove(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList)
+{
+    if (messageList->timeoutHeapIndex == TIMEOUT_HEAP_INDEX_SUSPENDED)
+    {
+        handleData->timeoutHeapSuspendedCount--;
+        messageList->timeoutHeapIndex = TIMEOUT_HEAP_INDEX_NONE;
+    }
+    else if ((handleData->timeoutHeapCount > 0) &&
+        (messageList->timeoutHeapIndex < handleData->timeoutHeapCount) &&
+        (handleData->timeoutHeap[messageList->timeoutHeapIndex] == messageList))
+    {
+        timeoutHeap_removeAt(handleData, messageList->timeoutHeapIndex);
+        messageList->timeoutHeapIndex = TIMEOUT_HEAP_INDEX_NONE;
+    }
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_02_044: [ Messages already delivered to IoTHubClient_LL shall not have their timeouts modified by a new call to IoTHubClient_LL_SetOption. ]*/
+/*returns 0 on success, any other value is error*/
+static int attach_ms_timesOutAfter(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST *newEntry)
+{
+    int result;
+    newEntry->timeoutHeapIndex = TIMEOUT_HEAP_INDEX_NONE;
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClient_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
+    if (handleData->currentMessageTimeout == 0)
+    {
+        newEntry->ms_timesOutAfter = 0; /*do not timeout*/
+        result = 0;
     }
     else
     {
-        IOTHUB_MESSAGE_LIST *newEntry = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST));
-        if (newEntry == NULL)
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
+        if (tickcounter_get_current_ms(handleData->tickCounter, &newEntry->ms_timesOutAfter) != 0)
         {
-            result = IOTHUB_CLIENT_ERROR;
-            LOG_ERROR_RESULT;
+            result = __LINE__;
+            LogError("unable to get the current relative tickcount");
         }
         else
         {
-            IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
-
-            if (attach_ms_timesOutAfter(handleData, newEntry) != 0)
+            newEntry->ms_timesOutAfter += handleData->currentMessageTimeout;
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_006: [ If the message has a timeout, IoTHubClient_LL_SendEventAsync shall make room for it in the message timeout heap. If that fails, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+            if (timeoutHeap_reserve(handleData, 1) != 0)
             {
-                result = IOTHUB_CLIENT_ERROR;
-                LOG_ERROR_RESULT;
-                free(newEntry);
+                result = __LINE__;
+                LogError("unable to track the message timeout");
             }
             else
             {
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
-                if ((newEntry->messageHandle = IoTHubMessage_Clone(eventMessageHandle)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information fails for any reason, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
-                    result = IOTHUB_CLIENT_ERROR;
-                    free(newEntry);
-                    LOG_ERROR_RESULT;
-                }
-                else
-                {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
-                    newEntry->callback = eventConfirmationCallback;
-                    newEntry->context = userContextCallback;
-                    DList_InsertTailList(&(iotHubClientHandle->waitingToSend), &(newEntry->entry));
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_015: [Otherwise IoTHubClient_LL_SendEventAsync shall succeed and return IOTHUB_CLIENT_OK.] */
-                    result = IOTHUB_CLIENT_OK;
-                }
+                result = 0;
             }
         }
     }
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
+/*the send queue accounts for every message from the moment SendEventAsync accepts it until it completes, times out, is dropped or is disposed of by the transport.
+The payload size of a message is only computed while the "sendQueueMaxBytes" option is set*/
+static bool sendQueue_fits(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t count, size_t bytes, size_t newCount, size_t newBytes)
 {
-    IOTHUB_CLIENT_RESULT result;
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_016: [IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.] */
-    if (iotHubClientHandle == NULL)
+    return ((handleData->sendQueueMaxMessages == 0) || ((count <= handleData->sendQueueMaxMessages) && (newCount <= handleData->sendQueueMaxMessages - count))) &&
+        ((handleData->sendQueueMaxBytes == 0) || ((bytes <= handleData->sendQueueMaxBytes) && (newBytes <= handleData->sendQueueMaxBytes - bytes)));
+}
+
+/*returns 0 on success, any other value is error*/
+static int sendQueue_getMessageSize(IOTHUB_MESSAGE_HANDLE messageHandle, size_t* size)
+{
+    int result;
+    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(messageHandle);
+    if (contentType == IOTHUBMESSAGE_BYTEARRAY)
     {
-        result = IOTHUB_CLIENT_INVALID_ARG;
-        LOG_ERROR_RESULT;
+        const unsigned char* buffer;
+        if (IoTHubMessage_GetByteArray(messageHandle, &buffer, size) != IOTHUB_MESSAGE_OK)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+        }
     }
-    else
+    else if (contentType == IOTHUBMESSAGE_STRING)
     {
-        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
-        if (messageCallback == NULL)
+        const char* source = IoTHubMessage_GetString(messageHandle);
+        if (source == NULL)
         {
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_019: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
-            handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
-            handleData->messageCallback = NULL;
-            handleData->messageUserContextCallback = NULL;
-            result = IOTHUB_CLIENT_OK;
+            result = __LINE__;
         }
         else
         {
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_017: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Subscribe function.]*/
-            if (handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) == 0)
-            {
-                handleData->messageCallback = messageCallback;
-                handleData->messageUserContextCallback = userContextCallback;
-                result = IOTHUB_CLIENT_OK;
-            }
-            else
-            {
-                handleData->messageCallback = NULL;
-                handleData->messageUserContextCallback = NULL;
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_018: [If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR. Otherwise IoTHubClient_LL_SetMessageCallback shall succeed and return IOTHUB_CLIENT_OK.]*/
-                result = IOTHUB_CLIENT_ERROR;
-            }
+            *size = strlen(source);
+            result = 0;
         }
     }
-
+    else
+    {
+        result = __LINE__;
+    }
     return result;
 }
 
-static void DoTimeouts(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+/*calls the send queue callback when the number of queued messages has crossed one of the watermarks*/
+static void sendQueue_notify(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
 {
-    uint64_t nowTick;
-    if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    if (handleData->sendQueueHighWatermark != 0)
     {
-        LogError("unable to get the current ms, timeouts will not be processed");
-    }
-    else
-    {
-        DLIST_ENTRY* currentItemInWaitingToSend = handleData->waitingToSend.Flink;
-        while (currentItemInWaitingToSend != &(handleData->waitingToSend)) /*while we are not at the end of the list*/
+        if ((!handleData->sendQueueAboveHighWatermark) && (handleData->sendQueueCount >= handleData->sendQueueHighWatermark))
         {
-            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-            if ((fullEntry->ms_timesOutAfter != 0) && (fullEntry->ms_timesOutAfter < nowTick))
+            handleData->sendQueueAboveHighWatermark = true;
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_024: [ When the number of queued messages reaches "sendQueueHighWatermark", the callback set by IoTHubClient_LL_SetSendQueueCallback shall be called once with IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK. ]*/
+            if (handleData->sendQueueCallback != NULL)
             {
-                PDLIST_ENTRY theNext = currentItemInWaitingToSend->Flink; /*need to save the next item, because the below operations are destructive*/
-                DList_RemoveEntryList(currentItemInWaitingToSend);
-                if (fullEntry->callback != NULL)
-                {
-                    fullEntry->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, fullEntry->context);
-                }
-                IoTHubMessage_Destroy(fullEntry->messageHandle); /*because it has been cloned*/
-                free(fullEntry);
-                currentItemInWaitingToSend = theNext;
+                handleData->sendQueueCallback(IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK, handleData->sendQueueUserContextCallback);
             }
-            else
+        }
+        else if ((handleData->sendQueueAboveHighWatermark) && (handleData->sendQueueCount <= handleData->sendQueueLowWatermark))
+        {
+            handleData->sendQueueAboveHighWatermark = false;
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_025: [ After that, when the number of queued messages goes down to "sendQueueLowWatermark", the callback shall be called once with IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK. ]*/
+            if (handleData->sendQueueCallback != NULL)
             {
-                currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
+                handleData->sendQueueCallback(IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK, handleData->sendQueueUserContextCallback);
             }
         }
     }
 }
 
-void IoTHubClient_LL_DoWork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+static void sendQueue_add(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList)
 {
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_020: [If parameter iotHubClientHandle is NULL then IoTHubClient_LL_DoWork shall not perform any action.] */
-    if (iotHubClientHandle != NULL)
-    {
-        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
-        DoTimeouts(handleData);
+    handleData->sendQueueCount++;
+    handleData->sendQueueBytes += messageList->queuedSize;
+    messageList->isHeldByTransport = false;
+    messageList->isCountedSent = false;
+}
 
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_021: [Otherwise, IoTHubClient_LL_DoWork shall invoke the underlaying layer's _DoWork function.]*/
-        handleData->IoTHubTransport_DoWork(handleData->transportHandle, iotHubClientHandle);
+/*the transport took messageList out of waitingToSend and keeps it after its DoWork returns*/
+static void sendQueue_hold(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList)
+{
+    if (!messageList->isHeldByTransport)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_084: [ A message whose timeout is suspended shall be counted in sent the first time, and in retries every other time, and shall be counted in inTransport until its timeout is resumed or it completes. ]*/
+        messageList->isHeldByTransport = true;
+        handleData->sendQueueHeldCount++;
+        if (messageList->isCountedSent)
+        {
+            handleData->statistics.retries++;
+        }
+        else
+        {
+            messageList->isCountedSent = true;
+            handleData->statistics.sent++;
+        }
     }
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetSendStatus(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
+/*the transport gave messageList back, or messageList completed*/
+static void sendQueue_unhold(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList)
 {
-    IOTHUB_CLIENT_RESULT result;
-
-    /* Codes_SRS_IOTHUBCLIENT_09_007: [IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter] */
-    if (iotHubClientHandle == NULL || iotHubClientStatus == NULL)
+    if (messageList->isHeldByTransport)
     {
-        result = IOTHUB_CLIENT_INVALID_ARG;
-        LOG_ERROR_RESULT;
+        messageList->isHeldByTransport = false;
+        handleData->sendQueueHeldCount--;
     }
-    else
-    {
-        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+}
 
-        /* Codes_SRS_IOTHUBCLIENT_09_008: [IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_IDLE if there is currently no items to be sent] */
-        /* Codes_SRS_IOTHUBCLIENT_09_009: [IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently items to be sent] */
-        result = handleData->IoTHubTransport_GetSendStatus(handleData->deviceHandle, iotHubClientStatus);
+/*gives back the room messageList took in the send queue, does nothing for records that were not created by SendEventAsync*/
+static void sendQueue_release(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList)
+{
+    if ((handleData->sendQueueCount > 0) && (messageList->clientHandle == handleData))
+    {
+        handleData->sendQueueCount--;
+        handleData->sendQueueBytes -= messageList->queuedSize;
+        sendQueue_unhold(handleData, messageList);
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_088: [ Every time a message gives back its room in the send queue, the callback set by IoTHubClient_LL_SetSendQueueRoomCallback shall be called with its context, if a callback is set. ]*/
+        if (handleData->sendQueueRoomCallback != NULL)
+        {
+            handleData->sendQueueRoomCallback(handleData->sendQueueRoomContext);
+        }
     }
-
-    return result;
 }
 
-void IoTHubClient_LL_SendComplete(IOTHUB_CLIENT_LL_HANDLE handle, PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+/*takes messageList out of the journal once it has reached its final outcome*/
+static void journal_retire(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList)
 {
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL, or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
-    if (
-        (handle == NULL) ||
-        (completed == NULL)
-        )
+#ifndef DONT_USE_JOURNAL
+    if ((handleData->journalHandle != NULL) &&
+        (messageList->clientHandle == handleData) &&
+        (messageList->journalRecordId != 0))
     {
-        /*"shall return"*/
-        LogError("invalid arg");
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_036: [ Messages that complete, time out, are dropped or are disposed of by the transport shall be retired from the journal by calling IoTHubClient_LL_Journal_Retire. ]*/
+        if (IoTHubClient_LL_Journal_Retire(handleData->journalHandle, messageList->journalRecordId) != 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_037: [ If IoTHubClient_LL_Journal_Retire fails the message shall still be completed, it will be sent again after a restart. ]*/
+            LogError("unable to retire the message from the journal, it will be sent again after a restart");
+        }
+        messageList->journalRecordId = 0;
     }
-    else
+#else
+    (void)handleData;
+    (void)messageList;
+#endif
+}
+
+/*the statistics only count the records created by SendEventAsync of this IoTHubClient_LL*/
+static void statistics_enqueued(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* newEntry)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_067: [ Every message accepted by IoTHubClient_LL_SendEventAsync, IoTHubClient_LL_SendEventAsync_TakeOwnership or a batch send shall be counted in enqueued. ]*/
+    handleData->statistics.enqueued++;
+    newEntry->ms_enqueuedAt = ENQUEUED_AT_NONE;
+    if (handleData->sendStatistics)
     {
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_027: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_ERROR then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_ERROR and the context set to the context passed originally in the SendEventAsync call.] */
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
-        PDLIST_ENTRY oldest;
-        while ((oldest = DList_RemoveHeadList(completed)) != completed)
+        size_t size;
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_068: [ When "sendStatistics" is on, the payload bytes of the message shall be counted in enqueuedBytes and the time it was queued shall be taken by calling tickcounter_get_current_ms. ]*/
+        if (sendQueue_getMessageSize(newEntry->messageHandle, &size) == 0)
         {
-            IOTHUB_MESSAGE_LIST* messageList = (IOTHUB_MESSAGE_LIST*)containingRecord(oldest, IOTHUB_MESSAGE_LIST, entry);
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.]*/
-            if (messageList->callback != NULL)
-            {
-                messageList->callback(result, messageList->context);
-            }
-            IoTHubMessage_Destroy(messageList->messageHandle);
-            free(messageList);
+            handleData->statistics.enqueuedBytes += size;
+        }
+        if (tickcounter_get_current_ms(handleData->tickCounter, &newEntry->ms_enqueuedAt) != 0)
+        {
+            LogError("unable to get the current ms, the latency of the message will not be recorded");
+            newEntry->ms_enqueuedAt = ENQUEUED_AT_NONE;
         }
     }
 }
 
-IOTHUBMESSAGE_DISPOSITION_RESULT IoTHubClient_LL_MessageCallback(IOTHUB_CLIENT_LL_HANDLE handle, IOTHUB_MESSAGE_HANDLE message)
+/*log-linear bucket of latency: the highest bit set picks the power of 2 range, the next IOTHUB_CLIENT_LATENCY_SUB_BUCKET_BITS bits the linear sub-bucket in it*/
+static size_t statistics_latencyBucket(uint64_t latency)
 {
-    int result;
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_029: [If parameter handle is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
-    if (handle == NULL)
+    size_t result;
+    if (latency < IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT)
     {
-        LogError("invalid argument");
-        result = IOTHUBMESSAGE_ABANDONED;
+        result = (size_t)latency;
     }
     else
     {
-        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)handle;
-
-        /* Codes_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime] */
-        handleData->lastMessageReceiveTime = get_time(NULL);
-
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_030: [IoTHubClient_LL_MessageCallback shall invoke the last callback function (the parameter messageCallback to IoTHubClient_LL_SetMessageCallback) passing the message and the passed userContextCallback.]*/
-        if (handleData->messageCallback != NULL)
+        size_t highestBit = IOTHUB_CLIENT_LATENCY_SUB_BUCKET_BITS;
+        while ((highestBit < IOTHUB_CLIENT_LATENCY_RANGE_BITS) && ((latency >> (highestBit + 1)) != 0))
         {
-            result = handleData->messageCallback(message, handleData->messageUserContextCallback);
+            highestBit++;
+        }
+        if (highestBit >= IOTHUB_CLIENT_LATENCY_RANGE_BITS)
+        {
+            result = IOTHUB_CLIENT_LATENCY_BUCKET_COUNT - 1;
         }
         else
         {
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_032: [If the last callback function was NULL, then IoTHubClient_LL_MessageCallback  shall return IOTHUBMESSAGE_ABANDONED.] */
-            LogError("user callback was NULL");
-            result = IOTHUBMESSAGE_ABANDONED;
+            result = (highestBit - IOTHUB_CLIENT_LATENCY_SUB_BUCKET_BITS + 1) * IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT +
+                (size_t)((latency >> (highestBit - IOTHUB_CLIENT_LATENCY_SUB_BUCKET_BITS)) - IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT);
+        }
+    }
+    return result;
+}
+
+static void statistics_recordLatency(IOTHUB_CLIENT_STATISTICS* statistics, uint64_t latency)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_085: [ The latency histogram shall be log-linear: one bucket per ms under IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT ms, then IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT buckets of equal width in every power of 2 range, the last bucket counting all the latencies of 2^IOTHUB_CLIENT_LATENCY_RANGE_BITS ms and more. ]*/
+    statistics->latencyHistogram[statistics_latencyBucket(latency)]++;
+    if ((statistics->latencyCount == 0) || (latency < statistics->latencyMinMs))
+    {
+        statistics->latencyMinMs = latency;
+    }
+    if (latency > statistics->latencyMaxMs)
+    {
+        statistics->latencyMaxMs = latency;
+    }
+    statistics->latencyTotalMs += latency;
+    statistics->latencyCount++;
+}
+
+static void statistics_completed(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    if (messageList->clientHandle == handleData)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_086: [ A message completed with IOTHUB_CLIENT_CONFIRMATION_OK or IOTHUB_CLIENT_CONFIRMATION_ERROR that was not counted in sent yet, because the transport sent it within IoTHubClient_LL_DoWork, shall be counted in sent. ]*/
+        if (((result == IOTHUB_CLIENT_CONFIRMATION_OK) || (result == IOTHUB_CLIENT_CONFIRMATION_ERROR)) &&
+            (!messageList->isCountedSent))
+        {
+            messageList->isCountedSent = true;
+            handleData->statistics.sent++;
+        }
+
+        if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
+        {
+            uint64_t nowTick;
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_069: [ A message completed with IOTHUB_CLIENT_CONFIRMATION_OK shall be counted in confirmed and, if its queueing time was taken, the ms between then and now shall be added to the latency histogram. ]*/
+            handleData->statistics.confirmed++;
+            if ((messageList->ms_enqueuedAt != ENQUEUED_AT_NONE) &&
+                (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) == 0))
+            {
+                statistics_recordLatency(&handleData->statistics, (nowTick > messageList->ms_enqueuedAt) ? (nowTick - messageList->ms_enqueuedAt) : 0);
+            }
+        }
+        else if (result == IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_070: [ Messages that time out shall be counted in timedOut, messages dropped to make room in the send queue in dropped and messages completed with any other result in failed. ]*/
+            handleData->statistics.timedOut++;
+        }
+        else if (result == IOTHUB_CLIENT_CONFIRMATION_DROPPED)
+        {
+            handleData->statistics.dropped++;
+        }
+        else
+        {
+            handleData->statistics.failed++;
+        }
+    }
+}
+
+/*drops the oldest messages that the transport has not picked up yet until newCount messages of newBytes bytes fit.
+Nothing is dropped if dropping all of them would still not make enough room. returns 0 on success, any other value is error*/
+static int sendQueue_dropOldest(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t newCount, size_t newBytes)
+{
+    int result;
+    size_t count = handleData->sendQueueCount;
+    size_t bytes = handleData->sendQueueBytes;
+    size_t nDrop = 0;
+    PDLIST_ENTRY current = handleData->waitingToSend.Flink;
+
+    while ((!sendQueue_fits(handleData, count, bytes, newCount, newBytes)) && (current != &(handleData->waitingToSend)))
+    {
+        IOTHUB_MESSAGE_LIST* oldest = containingRecord(current, IOTHUB_MESSAGE_LIST, entry);
+        count--;
+        bytes -= oldest->queuedSize;
+        nDrop++;
+        current = current->Flink;
+    }
+
+    if (!sendQueue_fits(handleData, count, bytes, newCount, newBytes))
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        while (nDrop > 0)
+        {
+            IOTHUB_MESSAGE_LIST* oldest = containingRecord(DList_RemoveHeadList(&(handleData->waitingToSend)), IOTHUB_MESSAGE_LIST, entry);
+            nDrop--;
+            timeoutHeap_remove(handleData, oldest);
+            sendQueue_release(handleData, oldest);
+            journal_retire(handleData, oldest);
+            statistics_completed(handleData, oldest, IOTHUB_CLIENT_CONFIRMATION_DROPPED);
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_020: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST, IoTHubClient_LL_SendEventAsync shall remove the oldest messages from waitingToSend until the new message fits, call their callbacks with IOTHUB_CLIENT_CONFIRMATION_DROPPED and destroy them. ]*/
+            if (oldest->callback != NULL)
+            {
+                oldest->callback(IOTHUB_CLIENT_CONFIRMATION_DROPPED, oldest->context);
+            }
+            IoTHubMessage_Destroy(oldest->messageHandle);
+            messageList_free(handleData, oldest);
+        }
+        /*the callbacks above could have queued messages*/
+        result = sendQueue_fits(handleData, handleData->sendQueueCount, handleData->sendQueueBytes, newCount, newBytes) ? 0 : __LINE__;
+    }
+    return result;
+}
+
+/*computes how much of the send queue budget eventMessageHandle takes. returns 0 on success, any other value is error*/
+static int sendQueue_measure(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle, size_t* queuedSize)
+{
+    int result;
+    *queuedSize = 0;
+    if ((handleData->sendQueueMaxBytes != 0) && (sendQueue_getMessageSize(eventMessageHandle, queuedSize) != 0))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_017: [ If "sendQueueMaxBytes" is not 0 and the size of the message payload cannot be obtained, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        result = __LINE__;
+        LogError("unable to get the size of the message");
+    }
+    else if ((handleData->sendQueueMaxBytes != 0) && (*queuedSize > handleData->sendQueueMaxBytes))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_018: [ A message whose payload is larger than "sendQueueMaxBytes" shall be refused with IOTHUB_CLIENT_ERROR whatever the policy. ]*/
+        result = __LINE__;
+        LogError("the message is larger than sendQueueMaxBytes");
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+/*makes sure there is room in the send queue for newCount messages of newBytes payload bytes. returns 0 on success, any other value is error*/
+static int sendQueue_reserve(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t newCount, size_t newBytes)
+{
+    int result;
+    if (sendQueue_fits(handleData, handleData->sendQueueCount, handleData->sendQueueBytes, newCount, newBytes))
+    {
+        result = 0;
+    }
+    else if (!sendQueue_fits(handleData, 0, 0, newCount, newBytes))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_048: [ If the batch has more messages than "sendQueueMaxMessages" or more payload bytes than "sendQueueMaxBytes", IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_ERROR whatever the policy. ]*/
+        result = __LINE__;
+        LogError("the batch is larger than the send queue");
+    }
+    else if ((handleData->sendQueueFullPolicy == IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST) && (sendQueue_dropOldest(handleData, newCount, newBytes) == 0))
+    {
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_019: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT or IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR when the send queue has no room for the message. ]*/
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_021: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST and dropping all the messages in waitingToSend would not make enough room, IoTHubClient_LL_SendEventAsync shall not drop any message, shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        handleData->sendQueueWasFull = true;
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_071: [ Messages refused because the send queue had no room for them shall be counted in refused. ]*/
+        handleData->statistics.refused += newCount;
+        result = __LINE__;
+        LogError("the send queue is full");
+    }
+    return result;
+}
+
+/*fills every field of newEntry but queuedSize and entry.*/
+/*takeOwnership == false: the message is cloned and the caller keeps eventMessageHandle*/
+/*takeOwnership == true: eventMessageHandle itself is stored*/
+/*journalRecordId == 0: the message is appended to the journal (if any), otherwise it is a message replayed from the journal under that record*/
+/*returns 0 on success, any other value is error and then newEntry holds nothing that needs to be released*/
+static int fillMessageList(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* newEntry, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership, uint64_t journalRecordId)
+{
+    int result;
+    if (attach_ms_timesOutAfter(handleData, newEntry) != 0)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        if (takeOwnership)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_003: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall add to the DLIST waitingToSend a new record that stores eventMessageHandle itself (without calling IoTHubMessage_Clone), eventConfirmationCallback and userContextCallback. ]*/
+            newEntry->messageHandle = eventMessageHandle;
+            result = 0;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
+        else if ((newEntry->messageHandle = IoTHubMessage_Clone(eventMessageHandle)) == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information fails for any reason, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+        }
+
+#ifndef DONT_USE_JOURNAL
+        if ((result == 0) &&
+            (journalRecordId == 0) &&
+            (handleData->journalHandle != NULL) &&
+            (IoTHubClient_LL_Journal_Append(handleData->journalHandle, newEntry->messageHandle, &journalRecordId) != 0))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_035: [ If IoTHubClient_LL_Journal_Append fails, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+            if (!takeOwnership)
+            {
+                IoTHubMessage_Destroy(newEntry->messageHandle);
+            }
+            result = __LINE__;
+        }
+#endif
+
+        if (result == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
+            newEntry->callback = eventConfirmationCallback;
+            newEntry->context = userContextCallback;
+            newEntry->clientHandle = handleData;
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_034: [ When there is a journal, IoTHubClient_LL_SendEventAsync shall append the message to it by calling IoTHubClient_LL_Journal_Append before adding the record to waitingToSend. ]*/
+            newEntry->journalRecordId = journalRecordId;
+        }
+    }
+    return result;
+}
+
+/*accounts for newEntry once it has been linked in waitingToSend*/
+static void sendQueue_track(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* newEntry)
+{
+    if (newEntry->ms_timesOutAfter != 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_007: [ IoTHubClient_LL_SendEventAsync shall add a message that has a timeout to the message timeout heap, ordered by the time the message times out. ]*/
+        timeoutHeap_push(handleData, newEntry);
+    }
+    sendQueue_add(handleData, newEntry);
+    statistics_enqueued(handleData, newEntry);
+}
+
+static IOTHUB_CLIENT_RESULT SendEventAsync_Impl(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership, uint64_t journalRecordId)
+{
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_MESSAGE_LIST *newEntry;
+    size_t queuedSize;
+    handleData->sendQueueWasFull = false;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_016: [ IoTHubClient_LL_SendEventAsync shall check that the send queue has room for the message before it is queued: the number of queued messages shall stay at most "sendQueueMaxMessages" and their payload bytes at most "sendQueueMaxBytes". ]*/
+    if ((sendQueue_measure(handleData, eventMessageHandle, &queuedSize) != 0) ||
+        (sendQueue_reserve(handleData, 1, queuedSize) != 0))
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else if ((newEntry = messageList_alloc(handleData)) == NULL)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else if (fillMessageList(handleData, newEntry, eventMessageHandle, eventConfirmationCallback, userContextCallback, takeOwnership, journalRecordId) != 0)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+        messageList_free(handleData, newEntry);
+    }
+    else
+    {
+        newEntry->queuedSize = queuedSize;
+        DList_InsertTailList(&(handleData->waitingToSend), &(newEntry->entry));
+        sendQueue_track(handleData, newEntry);
+        sendQueue_notify(handleData);
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_015: [Otherwise IoTHubClient_LL_SendEventAsync shall succeed and return IOTHUB_CLIENT_OK.] */
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_005: [ Otherwise IoTHubClient_LL_SendEventAsync_TakeOwnership shall succeed and return IOTHUB_CLIENT_OK. From then on the message handle is owned by IoTHubClient_LL and shall be destroyed by it once the message is completed, timed out or the handle is destroyed. ]*/
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+/*confirms the whole batch once the last of its messages is confirmed*/
+static void eventBatch_confirm(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    EVENT_BATCH* eventBatch = (EVENT_BATCH*)userContextCallback;
+    if (eventBatch->result == IOTHUB_CLIENT_CONFIRMATION_OK)
+    {
+        eventBatch->result = result;
+    }
+    eventBatch->pendingCount--;
+    if (eventBatch->pendingCount == 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_050: [ If batchConfirmation is IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE, eventConfirmationCallback shall be called once, after every message of the batch has been confirmed, with IOTHUB_CLIENT_CONFIRMATION_OK if all of them were confirmed with IOTHUB_CLIENT_CONFIRMATION_OK and with the result of the first one that was not otherwise. ]*/
+        eventBatch->eventConfirmationCallback(eventBatch->result, eventBatch->userContextCallback);
+        free(eventBatch);
+    }
+}
+
+/*releases the records of a batch that could not be queued. The first filledCount records were filled by fillMessageList*/
+static void eventBatch_discard(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, PDLIST_ENTRY batchList, size_t filledCount, bool takeOwnership)
+{
+    PDLIST_ENTRY current;
+    while ((current = DList_RemoveHeadList(batchList)) != batchList)
+    {
+        IOTHUB_MESSAGE_LIST* messageList = containingRecord(current, IOTHUB_MESSAGE_LIST, entry);
+        if (filledCount > 0)
+        {
+            filledCount--;
+            journal_retire(handleData, messageList);
+            if (!takeOwnership)
+            {
+                IoTHubMessage_Destroy(messageList->messageHandle);
+            }
+        }
+        messageList_free(handleData, messageList);
+    }
+}
+
+/*the records of the batch are built aside and linked in waitingToSend all at once, so either all the messages are queued or none is*/
+static IOTHUB_CLIENT_RESULT SendEventBatchAsync_Impl(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership)
+{
+    IOTHUB_CLIENT_RESULT result;
+    DLIST_ENTRY batchList;
+    PDLIST_ENTRY current;
+    EVENT_BATCH* eventBatch = NULL;
+    size_t batchBytes = 0;
+    size_t allocatedCount;
+    size_t filledCount = 0;
+    handleData->sendQueueWasFull = false;
+    DList_InitializeListHead(&batchList);
+
+    for (allocatedCount = 0; allocatedCount < eventMessageCount; allocatedCount++)
+    {
+        IOTHUB_MESSAGE_LIST* newEntry = messageList_alloc(handleData);
+        if (newEntry == NULL)
+        {
+            break;
+        }
+        DList_InsertTailList(&batchList, &(newEntry->entry));
+        if (sendQueue_measure(handleData, eventMessageHandles[allocatedCount], &(newEntry->queuedSize)) != 0)
+        {
+            break;
+        }
+        else if ((handleData->sendQueueMaxBytes != 0) && (newEntry->queuedSize > handleData->sendQueueMaxBytes - batchBytes))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_048: [ If the batch has more messages than "sendQueueMaxMessages" or more payload bytes than "sendQueueMaxBytes", IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_ERROR whatever the policy. ]*/
+            LogError("the batch is larger than sendQueueMaxBytes");
+            break;
+        }
+        else
+        {
+            batchBytes += newEntry->queuedSize;
+        }
+    }
+
+    if (allocatedCount < eventMessageCount)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_047: [ If any of the records cannot be created, IoTHubClient_LL_SendEventBatchAsync shall fail, return IOTHUB_CLIENT_ERROR and queue none of the messages. ]*/
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else if (!sendQueue_fits(handleData, 0, 0, eventMessageCount, batchBytes))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_048: [ If the batch has more messages than "sendQueueMaxMessages" or more payload bytes than "sendQueueMaxBytes", IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_ERROR whatever the policy. ]*/
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("the batch is larger than the send queue");
+    }
+    else if ((handleData->currentMessageTimeout != 0) && (timeoutHeap_reserve(handleData, eventMessageCount) != 0))
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else if ((batchConfirmation == IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE) &&
+        (eventConfirmationCallback != NULL) &&
+        ((eventBatch = (EVENT_BATCH*)malloc(sizeof(EVENT_BATCH))) == NULL))
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_051: [ If batchConfirmation is IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback shall be called once for every message of the batch with userContextCallback. ]*/
+        IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK entryCallback = (eventBatch == NULL) ? eventConfirmationCallback : eventBatch_confirm;
+        void* entryContext = (eventBatch == NULL) ? userContextCallback : eventBatch;
+        for (current = batchList.Flink; current != &batchList; current = current->Flink)
+        {
+            if (fillMessageList(handleData, containingRecord(current, IOTHUB_MESSAGE_LIST, entry), eventMessageHandles[filledCount], entryCallback, entryContext, takeOwnership, 0) != 0)
+            {
+                break;
+            }
+            filledCount++;
+        }
+
+        if (filledCount < eventMessageCount)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_047: [ If any of the records cannot be created, IoTHubClient_LL_SendEventBatchAsync shall fail, return IOTHUB_CLIENT_ERROR and queue none of the messages. ]*/
+            free(eventBatch);
+            result = IOTHUB_CLIENT_ERROR;
+            LOG_ERROR_RESULT;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_049: [ IoTHubClient_LL_SendEventBatchAsync shall only queue the batch if the send queue has room for all of its messages, and shall apply "sendQueueFullPolicy" to the batch as a whole. ]*/
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_081: [ IoTHubClient_LL_SendEventBatchAsync shall apply "sendQueueFullPolicy" only once every record of the batch has been created, so that no message is dropped for a batch that is then not queued. ]*/
+        else if (sendQueue_reserve(handleData, eventMessageCount, batchBytes) != 0)
+        {
+            free(eventBatch);
+            result = IOTHUB_CLIENT_ERROR;
+            LOG_ERROR_RESULT;
+        }
+        else
+        {
+            if (eventBatch != NULL)
+            {
+                eventBatch->eventConfirmationCallback = eventConfirmationCallback;
+                eventBatch->userContextCallback = userContextCallback;
+                eventBatch->pendingCount = eventMessageCount;
+                eventBatch->result = IOTHUB_CLIENT_CONFIRMATION_OK;
+            }
+            for (current = batchList.Flink; current != &batchList; current = current->Flink)
+            {
+                sendQueue_track(handleData, containingRecord(current, IOTHUB_MESSAGE_LIST, entry));
+            }
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_046: [ IoTHubClient_LL_SendEventBatchAsync shall create a record cloning every message of eventMessageHandles and, once all the records are created, append them in order to waitingToSend at once. ]*/
+            DList_AppendTailList(&(handleData->waitingToSend), &batchList);
+            DList_RemoveEntryList(&batchList);
+            sendQueue_notify(handleData);
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_052: [ Otherwise IoTHubClient_LL_SendEventBatchAsync shall succeed and return IOTHUB_CLIENT_OK. ]*/
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    if (result != IOTHUB_CLIENT_OK)
+    {
+        eventBatch_discard(handleData, &batchList, filledCount, takeOwnership);
+    }
+    return result;
+}
+
+#ifndef DONT_USE_JOURNAL
+static int journal_replay(IOTHUB_MESSAGE_HANDLE message, uint64_t recordId, void* context)
+{
+    int result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_033: [ Every message replayed from the journal shall be queued ahead of any new message, without a confirmation callback, as if by IoTHubClient_LL_SendEventAsync_TakeOwnership. A replayed message that is not accepted stays in the journal. ]*/
+    if (SendEventAsync_Impl((IOTHUB_CLIENT_LL_HANDLE_DATA*)context, message, NULL, NULL, true, recordId) != IOTHUB_CLIENT_OK)
+    {
+        LogError("unable to queue a message replayed from the journal");
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+#endif
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_011: [IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL.]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (eventMessageHandle == NULL) ||
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_012: [IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL.] */
+        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL))
+        )
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        result = SendEventAsync_Impl((IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, false, 0);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync_TakeOwnership(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_001: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (eventMessageHandle == NULL) ||
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_002: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL))
+        )
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_004: [ If adding the record fails for any reason, IoTHubClient_LL_SendEventAsync_TakeOwnership shall fail, return IOTHUB_CLIENT_ERROR and leave the ownership of eventMessageHandle with the caller. ]*/
+        result = SendEventAsync_Impl((IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, true, 0);
+    }
+    return result;
+}
+
+static bool isValidEventBatch(const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    bool result;
+    if ((eventMessageHandles == NULL) ||
+        (eventMessageCount == 0) ||
+        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL)) ||
+        ((batchConfirmation != IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE) && (batchConfirmation != IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE)))
+    {
+        result = false;
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; (i < eventMessageCount) && (eventMessageHandles[i] != NULL); i++)
+        {
+        }
+        result = (i == eventMessageCount);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventBatchAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_044: [ IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandles is NULL, if eventMessageCount is 0 or if any of the message handles is NULL. ]*/
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_045: [ IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL, or if batchConfirmation is not one of the IOTHUB_CLIENT_BATCH_CONFIRMATION values. ]*/
+    if ((iotHubClientHandle == NULL) ||
+        (!isValidEventBatch(eventMessageHandles, eventMessageCount, batchConfirmation, eventConfirmationCallback, userContextCallback)))
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        result = SendEventBatchAsync_Impl((IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle, eventMessageHandles, eventMessageCount, batchConfirmation, eventConfirmationCallback, userContextCallback, false);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventBatchAsync_TakeOwnership(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_053: [ IoTHubClient_LL_SendEventBatchAsync_TakeOwnership shall validate its parameters like IoTHubClient_LL_SendEventBatchAsync and return IOTHUB_CLIENT_INVALID_ARG when they are not valid. ]*/
+    if ((iotHubClientHandle == NULL) ||
+        (!isValidEventBatch(eventMessageHandles, eventMessageCount, batchConfirmation, eventConfirmationCallback, userContextCallback)))
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_054: [ IoTHubClient_LL_SendEventBatchAsync_TakeOwnership shall queue the messages like IoTHubClient_LL_SendEventBatchAsync but without cloning them. On success IoTHubClient_LL owns all the message handles, on failure the caller keeps all of them. ]*/
+        result = SendEventBatchAsync_Impl((IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle, eventMessageHandles, eventMessageCount, batchConfirmation, eventConfirmationCallback, userContextCallback, true);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_016: [IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.] */
+    if (iotHubClientHandle == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        if (messageCallback == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_019: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
+            handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
+            handleData->messageCallback = NULL;
+            handleData->messageUserContextCallback = NULL;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_017: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Subscribe function.]*/
+            if (handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) == 0)
+            {
+                handleData->messageCallback = messageCallback;
+                handleData->messageUserContextCallback = userContextCallback;
+                result = IOTHUB_CLIENT_OK;
+            }
+            else
+            {
+                handleData->messageCallback = NULL;
+                handleData->messageUserContextCallback = NULL;
+                /*Codes_SRS_IOTHUBCLIENT_LL_02_018: [If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR. Otherwise IoTHubClient_LL_SetMessageCallback shall succeed and return IOTHUB_CLIENT_OK.]*/
+                result = IOTHUB_CLIENT_ERROR;
+            }
+        }
+    }
+
+    return result;
+}
+
+static void DoTimeouts(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    uint64_t nowTick;
+    if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    {
+        LogError("unable to get the current ms, timeouts will not be processed");
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_008: [ IoTHubClient_LL_DoWork shall only consider the messages at the top of the message timeout heap that are due and shall not walk waitingToSend when no message is due. ]*/
+    else if ((handleData->timeoutHeapCount > 0) && (handleData->timeoutHeap[0]->ms_timesOutAfter < nowTick))
+    {
+        size_t dueBegin;
+        size_t dueEnd = handleData->timeoutHeapCount;
+        size_t nExpired = 0;
+        size_t i;
+        DLIST_ENTRY* currentItemInWaitingToSend;
+        PDLIST_ENTRY expiredHead;
+        PDLIST_ENTRY* expiredTail;
+
+        /*pop all the due messages, they end up in timeoutHeap[dueBegin..dueEnd)*/
+        while ((handleData->timeoutHeapCount > 0) && (handleData->timeoutHeap[0]->ms_timesOutAfter < nowTick))
+        {
+            timeoutHeap_removeAt(handleData, 0);
+        }
+        dueBegin = handleData->timeoutHeapCount;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_009: [ Every due message is in waitingToSend, because the transports suspend the timeout of the messages they keep. IoTHubClient_LL_DoWork shall look for the due messages from the head of waitingToSend and stop as soon as all of them are found. ]*/
+        /*the messages are queued in order, so the due ones are usually the first ones. Only mark them here, no callbacks are called until the heap is consistent again*/
+        currentItemInWaitingToSend = handleData->waitingToSend.Flink;
+        while ((nExpired < dueEnd - dueBegin) && (currentItemInWaitingToSend != &(handleData->waitingToSend)))
+        {
+            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
+            if ((fullEntry->timeoutHeapIndex >= dueBegin) &&
+                (fullEntry->timeoutHeapIndex < dueEnd) &&
+                (handleData->timeoutHeap[fullEntry->timeoutHeapIndex] == fullEntry))
+            {
+                handleData->timeoutHeap[fullEntry->timeoutHeapIndex] = NULL;
+                fullEntry->timeoutHeapIndex = TIMEOUT_HEAP_INDEX_EXPIRED;
+                nExpired++;
+            }
+            currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_010: [ A due message that is not found in waitingToSend (because a transport took it without calling IoTHubClient_LL_SuspendMessageTimeout) shall have its timeout suspended as if by IoTHubClient_LL_SuspendMessageTimeout. ]*/
+        for (i = dueBegin; i < dueEnd; i++)
+        {
+            IOTHUB_MESSAGE_LIST* inTransport = handleData->timeoutHeap[i];
+            if (inTransport != NULL)
+            {
+                inTransport->timeoutHeapIndex = TIMEOUT_HEAP_INDEX_SUSPENDED;
+                handleData->timeoutHeapSuspendedCount++;
+                sendQueue_hold(handleData, inTransport);
+            }
+        }
+
+        /*all the marked items are taken out of waitingToSend before any callback is called: a callback can queue a message,
+        which with the IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST policy removes items from waitingToSend.
+        An item that is not in any list anymore uses its Flink to chain the expired items*/
+        expiredHead = NULL;
+        expiredTail = &expiredHead;
+        currentItemInWaitingToSend = handleData->waitingToSend.Flink;
+        while ((nExpired > 0) && (currentItemInWaitingToSend != &(handleData->waitingToSend))) /*while there are marked items left and we are not at the end of the list*/
+        {
+            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
+            PDLIST_ENTRY theNext = currentItemInWaitingToSend->Flink; /*need to save the next item, because the below operations are destructive*/
+            if (fullEntry->timeoutHeapIndex == TIMEOUT_HEAP_INDEX_EXPIRED)
+            {
+                DList_RemoveEntryList(currentItemInWaitingToSend);
+                nExpired--;
+                currentItemInWaitingToSend->Flink = NULL;
+                *expiredTail = currentItemInWaitingToSend;
+                expiredTail = &(currentItemInWaitingToSend->Flink);
+            }
+            currentItemInWaitingToSend = theNext;
+        }
+
+        while (expiredHead != NULL)
+        {
+            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(expiredHead, IOTHUB_MESSAGE_LIST, entry);
+            expiredHead = expiredHead->Flink;
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_026: [ Messages that complete, time out or are disposed of by the transport shall give back their room in the send queue. ]*/
+            sendQueue_release(handleData, fullEntry);
+            journal_retire(handleData, fullEntry);
+            statistics_completed(handleData, fullEntry, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+            if (fullEntry->callback != NULL)
+            {
+                fullEntry->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, fullEntry->context);
+            }
+            IoTHubMessage_Destroy(fullEntry->messageHandle); /*because it has been cloned*/
+            messageList_free(handleData, fullEntry);
+        }
+        sendQueue_notify(handleData);
+    }
+}
+
+#ifndef DONT_USE_JOURNAL
+static void DoJournalSync(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    uint64_t nowTick;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_038: [ When there is a journal, IoTHubClient_LL_DoWork shall call IoTHubClient_LL_Journal_Sync once at least "journalSyncInterval" ms have passed since the previous sync. ]*/
+    if ((handleData->journalHandle != NULL) &&
+        (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) == 0) &&
+        (nowTick - handleData->journalLastSync >= handleData->journalSyncInterval))
+    {
+        if (IoTHubClient_LL_Journal_Sync(handleData->journalHandle) != 0)
+        {
+            LogError("unable to sync the journal");
+        }
+        handleData->journalLastSync = nowTick;
+    }
+}
+#endif
+
+void IoTHubClient_LL_DoWork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_020: [If parameter iotHubClientHandle is NULL then IoTHubClient_LL_DoWork shall not perform any action.] */
+    if (iotHubClientHandle != NULL)
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        DoTimeouts(handleData);
+#ifndef DONT_USE_JOURNAL
+        DoJournalSync(handleData);
+#endif
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_021: [Otherwise, IoTHubClient_LL_DoWork shall invoke the underlaying layer's _DoWork function.]*/
+        handleData->IoTHubTransport_DoWork(handleData->transportHandle, iotHubClientHandle);
+    }
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetSendStatus(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /* Codes_SRS_IOTHUBCLIENT_09_007: [IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter] */
+    if (iotHubClientHandle == NULL || iotHubClientStatus == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+
+        /* Codes_SRS_IOTHUBCLIENT_09_008: [IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_IDLE if there is currently no items to be sent] */
+        /* Codes_SRS_IOTHUBCLIENT_09_009: [IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently items to be sent] */
+        result = handleData->IoTHubTransport_GetSendStatus(handleData->deviceHandle, iotHubClientStatus);
+    }
+
+    return result;
+}
+
+void IoTHubClient_LL_SendComplete(IOTHUB_CLIENT_LL_HANDLE handle, PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL, or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
+    if (
+        (handle == NULL) ||
+        (completed == NULL)
+        )
+    {
+        /*"shall return"*/
+        LogError("invalid arg");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_027: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_ERROR then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_ERROR and the context set to the context passed originally in the SendEventAsync call.] */
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
+        PDLIST_ENTRY oldest;
+        while ((oldest = DList_RemoveHeadList(completed)) != completed)
+        {
+            IOTHUB_MESSAGE_LIST* messageList = (IOTHUB_MESSAGE_LIST*)containingRecord(oldest, IOTHUB_MESSAGE_LIST, entry);
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_011: [ IoTHubClient_LL_SendComplete shall remove every completed message from the message timeout heap. ]*/
+            timeoutHeap_remove((IOTHUB_CLIENT_LL_HANDLE_DATA*)handle, messageList);
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_026: [ Messages that complete, time out or are disposed of by the transport shall give back their room in the send queue. ]*/
+            sendQueue_release((IOTHUB_CLIENT_LL_HANDLE_DATA*)handle, messageList);
+            journal_retire((IOTHUB_CLIENT_LL_HANDLE_DATA*)handle, messageList);
+            statistics_completed((IOTHUB_CLIENT_LL_HANDLE_DATA*)handle, messageList, result);
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.]*/
+            if (messageList->callback != NULL)
+            {
+                messageList->callback(result, messageList->context);
+            }
+            IoTHubMessage_Destroy(messageList->messageHandle);
+            messageList_free((IOTHUB_CLIENT_LL_HANDLE_DATA*)handle, messageList);
+        }
+        sendQueue_notify((IOTHUB_CLIENT_LL_HANDLE_DATA*)handle);
+    }
+}
+
+void IoTHubClient_LL_UntrackMessage(IOTHUB_MESSAGE_LIST* messageList)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_012: [ If parameter messageList is NULL then IoTHubClient_LL_UntrackMessage shall return. ]*/
+    if (messageList == NULL)
+    {
+        LogError("invalid arg");
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)messageList->clientHandle;
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_013: [ Otherwise IoTHubClient_LL_UntrackMessage shall remove messageList from the message timeout heap of the IoTHubClient_LL that queued it. ]*/
+        if (messageList->timeoutHeapIndex != TIMEOUT_HEAP_INDEX_NONE)
+        {
+            timeoutHeap_remove(handleData, messageList);
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_027: [ IoTHubClient_LL_UntrackMessage shall give back the room messageList took in the send queue of the IoTHubClient_LL that queued it. ]*/
+        sendQueue_release(handleData, messageList);
+        journal_retire(handleData, messageList);
+        sendQueue_notify(handleData);
+    }
+}
+
+void IoTHubClient_LL_SuspendMessageTimeout(IOTHUB_MESSAGE_LIST* messageList)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_077: [ If parameter messageList is NULL then IoTHubClient_LL_SuspendMessageTimeout shall return. ]*/
+    if (messageList == NULL)
+    {
+        LogError("invalid arg");
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)messageList->clientHandle;
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_078: [ Otherwise, if messageList is in the message timeout heap, IoTHubClient_LL_SuspendMessageTimeout shall take it out of the heap while keeping room for it, so IoTHubClient_LL_DoWork does not look at it until its timeout is resumed. ]*/
+        if ((messageList->timeoutHeapIndex < handleData->timeoutHeapCount) &&
+            (handleData->timeoutHeap[messageList->timeoutHeapIndex] == messageList))
+        {
+            timeoutHeap_removeAt(handleData, messageList->timeoutHeapIndex);
+            messageList->timeoutHeapIndex = TIMEOUT_HEAP_INDEX_SUSPENDED;
+            handleData->timeoutHeapSuspendedCount++;
+        }
+        sendQueue_hold(handleData, messageList);
+    }
+}
+
+void IoTHubClient_LL_ResumeMessageTimeout(IOTHUB_MESSAGE_LIST* messageList)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_079: [ If parameter messageList is NULL then IoTHubClient_LL_ResumeMessageTimeout shall return. ]*/
+    if (messageList == NULL)
+    {
+        LogError("invalid arg");
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)messageList->clientHandle;
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_080: [ Otherwise, if the timeout of messageList is suspended, IoTHubClient_LL_ResumeMessageTimeout shall put messageList back in the message timeout heap. A message that is already due times out at the next IoTHubClient_LL_DoWork. ]*/
+        if (messageList->timeoutHeapIndex == TIMEOUT_HEAP_INDEX_SUSPENDED)
+        {
+            /*the slot was kept by IoTHubClient_LL_SuspendMessageTimeout, so this cannot fail*/
+            handleData->timeoutHeapSuspendedCount--;
+            timeoutHeap_push(handleData, messageList);
+        }
+        sendQueue_unhold(handleData, messageList);
+    }
+}
+
+void IoTHubClient_LL_UntrackCompletedMessage(IOTHUB_MESSAGE_LIST* messageList, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_072: [ If parameter messageList is NULL then IoTHubClient_LL_UntrackCompletedMessage shall return. ]*/
+    if (messageList == NULL)
+    {
+        LogError("invalid arg");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_073: [ Otherwise IoTHubClient_LL_UntrackCompletedMessage shall do what IoTHubClient_LL_UntrackMessage does and count the message in the statistics of the IoTHubClient_LL that queued it as completed with result. ]*/
+        statistics_completed((IOTHUB_CLIENT_LL_HANDLE_DATA*)messageList->clientHandle, messageList, result);
+        IoTHubClient_LL_UntrackMessage(messageList);
+    }
+}
+
+void IoTHubClient_LL_CountRetry(IOTHUB_CLIENT_LL_HANDLE handle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_082: [ If parameter handle is NULL then IoTHubClient_LL_CountRetry shall return. ]*/
+    if (handle == NULL)
+    {
+        LogError("invalid arg");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_083: [ Otherwise IoTHubClient_LL_CountRetry shall count one more retry in the statistics of handle. ]*/
+        ((IOTHUB_CLIENT_LL_HANDLE_DATA*)handle)->statistics.retries++;
+    }
+}
+
+void IoTHubClient_LL_ReleaseMessageList(IOTHUB_MESSAGE_LIST* messageList)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_064: [ If parameter messageList is NULL then IoTHubClient_LL_ReleaseMessageList shall return. ]*/
+    if (messageList == NULL)
+    {
+        LogError("invalid arg");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_065: [ Otherwise IoTHubClient_LL_ReleaseMessageList shall give messageList back to the message pool of the IoTHubClient_LL that queued it, or free it when that IoTHubClient_LL has no message pool. ]*/
+        messageList_free((IOTHUB_CLIENT_LL_HANDLE_DATA*)messageList->clientHandle, messageList);
+    }
+}
+
+void IoTHubClient_LL_SetSendQueueRoomCallback(IOTHUB_CLIENT_LL_HANDLE handle, IOTHUB_CLIENT_LL_SEND_QUEUE_ROOM_CALLBACK callback, void* context)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_087: [ If parameter handle is NULL then IoTHubClient_LL_SetSendQueueRoomCallback shall return. Otherwise it shall remember callback and context, a NULL callback removes the previous one. ]*/
+    if (handle == NULL)
+    {
+        LogError("invalid arg");
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)handle;
+        handleData->sendQueueRoomCallback = callback;
+        handleData->sendQueueRoomContext = context;
+    }
+}
+
+bool IoTHubClient_LL_WasSendQueueFull(IOTHUB_CLIENT_LL_HANDLE handle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_028: [ IoTHubClient_LL_WasSendQueueFull shall return true if the last IoTHubClient_LL_SendEventAsync or IoTHubClient_LL_SendEventAsync_TakeOwnership call failed only because the send queue had no room for the message, false otherwise (including when handle is NULL). ]*/
+    return (handle != NULL) && ((IOTHUB_CLIENT_LL_HANDLE_DATA*)handle)->sendQueueWasFull;
+}
+
+IOTHUBMESSAGE_DISPOSITION_RESULT IoTHubClient_LL_MessageCallback(IOTHUB_CLIENT_LL_HANDLE handle, IOTHUB_MESSAGE_HANDLE message)
+{
+    int result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_029: [If parameter handle is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
+    if (handle == NULL)
+    {
+        LogError("invalid argument");
+        result = IOTHUBMESSAGE_ABANDONED;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)handle;
+
+        /* Codes_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime] */
+        handleData->lastMessageReceiveTime = get_time(NULL);
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_030: [IoTHubClient_LL_MessageCallback shall invoke the last callback function (the parameter messageCallback to IoTHubClient_LL_SetMessageCallback) passing the message and the passed userContextCallback.]*/
+        if (handleData->messageCallback != NULL)
+        {
+            result = handleData->messageCallback(message, handleData->messageUserContextCallback);
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_032: [If the last callback function was NULL, then IoTHubClient_LL_MessageCallback  shall return IOTHUBMESSAGE_ABANDONED.] */
+            LogError("user callback was NULL");
+            result = IOTHUBMESSAGE_ABANDONED;
         }
     }
     /*Codes_SRS_IOTHUBCLIENT_LL_02_031: [Then IoTHubClient_LL_MessageCallback shall return what the user function returns.]*/
 	return (IOTHUBMESSAGE_DISPOSITION_RESULT) result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetSendQueueCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_SEND_QUEUE_CALLBACK sendQueueCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_029: [ If parameter iotHubClientHandle is NULL then IoTHubClient_LL_SetSendQueueCallback shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (iotHubClientHandle == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_030: [ Otherwise IoTHubClient_LL_SetSendQueueCallback shall store sendQueueCallback and userContextCallback and return IOTHUB_CLIENT_OK. A NULL sendQueueCallback stops the watermark notifications. ]*/
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        handleData->sendQueueCallback = sendQueueCallback;
+        handleData->sendQueueUserContextCallback = userContextCallback;
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetLastMessageReceiveTime(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, time_t* lastMessageReceiveTime)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -879,6 +2063,60 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetLastMessageReceiveTime(IOTHUB_CLIENT_LL_
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetPoolStatistics(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_POOL_STATISTICS* poolStatistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_061: [ If iotHubClientHandle or poolStatistics is NULL then IoTHubClient_LL_GetPoolStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((iotHubClientHandle == NULL) || (poolStatistics == NULL))
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        if (handleData->messagePool == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_062: [ If there is no message pool then IoTHubClient_LL_GetPoolStatistics shall set all the counters to 0 and return IOTHUB_CLIENT_OK. ]*/
+            (void)memset(poolStatistics, 0, sizeof(IOTHUB_CLIENT_POOL_STATISTICS));
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (IoTHubClient_LL_Pool_GetStatistics(handleData->messagePool, poolStatistics) != 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_063: [ Otherwise IoTHubClient_LL_GetPoolStatistics shall fill poolStatistics by calling IoTHubClient_LL_Pool_GetStatistics and return IOTHUB_CLIENT_OK, or IOTHUB_CLIENT_ERROR if IoTHubClient_LL_Pool_GetStatistics fails. ]*/
+            result = IOTHUB_CLIENT_ERROR;
+            LOG_ERROR_RESULT;
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetStatistics(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_074: [ If iotHubClientHandle or statistics is NULL then IoTHubClient_LL_GetStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((iotHubClientHandle == NULL) || (statistics == NULL))
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_075: [ IoTHubClient_LL_GetStatistics shall copy the counters to statistics, set inTransport to the number of messages whose timeout the transport suspended and has not resumed and waitingToSend to the number of the other messages that have not completed yet, without walking waitingToSend, and return IOTHUB_CLIENT_OK. ]*/
+        *statistics = handleData->statistics;
+        statistics->inTransport = handleData->sendQueueHeldCount;
+        statistics->waitingToSend = handleData->sendQueueCount - handleData->sendQueueHeldCount;
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetOption(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const char* optionName, const void* value)
 {
 
@@ -907,6 +2145,122 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetOption(IOTHUB_CLIENT_LL_HANDLE iotHubCli
             handleData->currentMessageTimeout = *(const uint64_t*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_015: [ "sendQueueMaxMessages", "sendQueueMaxBytes", "sendQueueHighWatermark" and "sendQueueLowWatermark" shall be handled by IoTHubClient_LL. Value is a pointer to a size_t, 0 means no limit (no callbacks for "sendQueueHighWatermark"). ]*/
+        else if (strcmp(optionName, "sendQueueMaxMessages") == 0)
+        {
+            handleData->sendQueueMaxMessages = *(const size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, "sendQueueMaxBytes") == 0)
+        {
+            handleData->sendQueueMaxBytes = *(const size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, "sendQueueHighWatermark") == 0)
+        {
+            handleData->sendQueueHighWatermark = *(const size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, "sendQueueLowWatermark") == 0)
+        {
+            handleData->sendQueueLowWatermark = *(const size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_022: [ "sendQueueFullPolicy" shall be handled by IoTHubClient_LL. Value is a pointer to an IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY. ]*/
+        else if (strcmp(optionName, "sendQueueFullPolicy") == 0)
+        {
+            IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = *(const IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY*)value;
+            if ((policy != IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT) &&
+                (policy != IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST) &&
+                (policy != IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_023: [ If the value of "sendQueueFullPolicy" is not one of the IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY values then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+                result = IOTHUB_CLIENT_INVALID_ARG;
+                LogError("invalid sendQueueFullPolicy");
+            }
+            else
+            {
+                handleData->sendQueueFullPolicy = policy;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_056: [ "messagePoolSize" shall be handled by IoTHubClient_LL. Value is a pointer to a size_t number of records. IoTHubClient_LL_SetOption shall replace the message pool by a pool of that many records created with IoTHubClient_LL_Pool_Create, a value of 0 shall only remove the message pool. ]*/
+        else if (strcmp(optionName, "messagePoolSize") == 0)
+        {
+            IOTHUB_CLIENT_POOL_STATISTICS poolStatistics;
+            IOTHUB_CLIENT_LL_POOL_HANDLE newPool = NULL;
+            size_t poolSize = *(const size_t*)value;
+            if ((handleData->messagePool != NULL) &&
+                ((IoTHubClient_LL_Pool_GetStatistics(handleData->messagePool, &poolStatistics) != 0) || (poolStatistics.inUse != 0)))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_057: [ If records of the current message pool are in use then IoTHubClient_LL_SetOption shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("messagePoolSize cannot be changed while messages from the pool are waiting to be sent");
+            }
+            else if ((poolSize != 0) && ((newPool = IoTHubClient_LL_Pool_Create(sizeof(IOTHUB_MESSAGE_LIST), poolSize)) == NULL))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_058: [ If IoTHubClient_LL_Pool_Create fails then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_ERROR and keep the current message pool. ]*/
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("unable to create a message pool of %zu records", poolSize);
+            }
+            else
+            {
+                if (handleData->messagePool != NULL)
+                {
+                    IoTHubClient_LL_Pool_Destroy(handleData->messagePool);
+                }
+                handleData->messagePool = newPool;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_076: [ "sendStatistics" shall be handled by IoTHubClient_LL. Value is a pointer to a bool, it only applies to the messages queued after it is set. ]*/
+        else if (strcmp(optionName, "sendStatistics") == 0)
+        {
+            handleData->sendStatistics = *(const bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+#ifndef DONT_USE_JOURNAL
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_032: [ "journalPath" shall be handled by IoTHubClient_LL. Value is a const char* path prefix for the journal files. IoTHubClient_LL_SetOption shall create the journal by calling IoTHubClient_LL_Journal_Create, which replays the messages that a previous instance did not complete. ]*/
+        else if (strcmp(optionName, "journalPath") == 0)
+        {
+            if (handleData->journalHandle != NULL)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_040: [ If the journal already exists then setting "journalPath" shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("journalPath can only be set once");
+            }
+            else if ((handleData->journalHandle = IoTHubClient_LL_Journal_Create((const char*)value, handleData->journalSegmentSize, journal_replay, handleData)) == NULL)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_041: [ If IoTHubClient_LL_Journal_Create fails then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("unable to create the journal");
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_042: [ "journalSegmentSize" shall be handled by IoTHubClient_LL. Value is a pointer to a size_t, it only applies to a journal created after it is set. A value of 0 shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        else if (strcmp(optionName, "journalSegmentSize") == 0)
+        {
+            if (*(const size_t*)value == 0)
+            {
+                result = IOTHUB_CLIENT_INVALID_ARG;
+                LogError("journalSegmentSize cannot be 0");
+            }
+            else
+            {
+                handleData->journalSegmentSize = *(const size_t*)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_043: [ "journalSyncInterval" shall be handled by IoTHubClient_LL. Value is a pointer to an unsigned int number of ms, 0 syncs the journal on every IoTHubClient_LL_DoWork. ]*/
+        else if (strcmp(optionName, "journalSyncInterval") == 0)
+        {
+            handleData->journalSyncInterval = *(const unsigned int*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+#endif
         else
         {
 
@@ -0,0 +1,967 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef DONT_USE_JOURNAL
+#error "trying to compile iothub_client_ll_journal.c while the symbol DONT_USE_JOURNAL is #define'd"
+#else
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/map.h"
+
+#include "iothub_message.h"
+#include "iothub_client_ll_journal.h"
+
+#if defined(_WIN32) && !defined(WINCE)
+#include <io.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+/*a record is: u32 payload length, u32 crc32 of (type, id, payload), u8 type, u64 id, payload. All integers are little endian*/
+#define RECORD_HEADER_SIZE 17
+#define RECORD_CRC_OFFSET 4
+#define RECORD_TYPE_OFFSET 8
+#define RECORD_TYPE_MESSAGE 1
+#define RECORD_TYPE_RETIRE 2
+#define MAX_RECORD_PAYLOAD_SIZE (16 * 1024 * 1024)
+
+/*enough room for ".head.tmp" and for the decimal digits of any segment sequence*/
+#define FILE_NAME_SUFFIX_SIZE 24
+
+typedef struct JOURNAL_SEGMENT_TAG
+{
+    unsigned long sequence;
+    uint64_t lastRecordId;
+    size_t liveRecords;
+} JOURNAL_SEGMENT;
+
+typedef struct JOURNAL_LIVE_RECORD_TAG
+{
+    uint64_t recordId;
+    size_t segmentIndex;
+    long offset;
+    bool isLive;
+} JOURNAL_LIVE_RECORD;
+
+typedef struct IOTHUB_CLIENT_LL_JOURNAL_DATA_TAG
+{
+    char* path;
+    char* fileName;
+    size_t maxSegmentSize;
+    JOURNAL_SEGMENT* segments; /*oldest first, the last one is the segment being appended to*/
+    size_t segmentCount;
+    FILE* activeFile;
+    size_t activeSize;
+    bool mustRollOver;
+    bool isDirty;
+    bool isReplaying;
+    uint64_t nextRecordId;
+} IOTHUB_CLIENT_LL_JOURNAL_DATA;
+
+static const uint32_t crcTable[16] =
+{
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static uint32_t crc32_update(uint32_t crc, const unsigned char* buffer, size_t size)
+{
+    size_t i;
+    crc = ~crc;
+    for (i = 0; i < size; i++)
+    {
+        crc = crcTable[(crc ^ buffer[i]) & 0x0F] ^ (crc >> 4);
+        crc = crcTable[(crc ^ (buffer[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+static void put_uint32(unsigned char* destination, uint32_t value)
+{
+    destination[0] = (unsigned char)(value & 0xFF);
+    destination[1] = (unsigned char)((value >> 8) & 0xFF);
+    destination[2] = (unsigned char)((value >> 16) & 0xFF);
+    destination[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+static uint32_t get_uint32(const unsigned char* source)
+{
+    return (uint32_t)source[0] | ((uint32_t)source[1] << 8) | ((uint32_t)source[2] << 16) | ((uint32_t)source[3] << 24);
+}
+
+static void put_uint64(unsigned char* destination, uint64_t value)
+{
+    put_uint32(destination, (uint32_t)(value & 0xFFFFFFFF));
+    put_uint32(destination + 4, (uint32_t)(value >> 32));
+}
+
+static uint64_t get_uint64(const unsigned char* source)
+{
+    return (uint64_t)get_uint32(source) | ((uint64_t)get_uint32(source + 4) << 32);
+}
+
+static int journal_fsync(FILE* file)
+{
+#if defined(_WIN32) && !defined(WINCE)
+    return _commit(_fileno(file));
+#elif defined(__unix__) || defined(__APPLE__)
+    return fsync(fileno(file));
+#else
+    (void)file;
+    return 0;
+#endif
+}
+
+static const char* segmentFileName(IOTHUB_CLIENT_LL_JOURNAL_DATA* journal, unsigned long sequence)
+{
+    (void)sprintf(journal->fileName, "%s.%lu", journal->path, sequence);
+    return journal->fileName;
+}
+
+static const char* headFileName(IOTHUB_CLIENT_LL_JOURNAL_DATA* journal, bool isTemporary)
+{
+    (void)sprintf(journal->fileName, "%s.head%s", journal->path, isTemporary ? ".tmp" : "");
+    return journal->fileName;
+}
+
+static int readHeadFile(const char* fileName, unsigned long* sequence)
+{
+    int result;
+    FILE* file = fopen(fileName, "rb");
+    if (file == NULL)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        unsigned char buffer[8];
+        if ((fread(buffer, 1, sizeof(buffer), file) != sizeof(buffer)) ||
+            (crc32_update(0, buffer, 4) != get_uint32(buffer + 4)))
+        {
+            LogError("journal head file %s is not valid", fileName);
+            result = __LINE__;
+        }
+        else
+        {
+            *sequence = (unsigned long)get_uint32(buffer);
+            result = 0;
+        }
+        (void)fclose(file);
+    }
+    return result;
+}
+
+/*the head is replaced through a temporary file, so that either the old or the new head survives a crash*/
+static int writeHead(IOTHUB_CLIENT_LL_JOURNAL_DATA* journal, unsigned long sequence)
+{
+    int result;
+    FILE* file = fopen(headFileName(journal, true), "wb");
+    if (file == NULL)
+    {
+        LogError("unable to create %s", journal->fileName);
+        result = __LINE__;
+    }
+    else
+    {
+        unsigned char buffer[8];
+        bool written;
+        put_uint32(buffer, (uint32_t)sequence);
+        put_uint32(buffer + 4, crc32_update(0, buffer, 4));
+        written = (fwrite(buffer, 1, sizeof(buffer), file) == sizeof(buffer)) &&
+            (fflush(file) == 0) &&
+            (journal_fsync(file) == 0);
+        if (fclose(file) != 0)
+        {
+            written = false;
+        }
+
+        if (!written)
+        {
+            LogError("unable to write %s", journal->fileName);
+            result = __LINE__;
+        }
+        else
+        {
+            char* temporaryName = (char*)malloc(strlen(journal->fileName) + 1);
+            if (temporaryName == NULL)
+            {
+                LogError("unable to malloc");
+                result = __LINE__;
+            }
+            else
+            {
+                (void)strcpy(temporaryName, journal->fileName);
+                (void)remove(headFileName(journal, false));
+                if (rename(temporaryName, journal->fileName) != 0)
+                {
+                    LogError("unable to rename %s to %s", temporaryName, journal->fileName);
+                    result = __LINE__;
+                }
+                else
+                {
+                    result = 0;
+                }
+                free(temporaryName);
+            }
+        }
+    }
+    return result;
+}
+
+static void compact(IOTHUB_CLIENT_LL_JOURNAL_DATA* journal)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_006: [IoTHubClient_LL_Journal_Create shall delete the segments at the head of the journal that have no live records, except the segment being appended to.]*/
+    /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_014: [IoTHubClient_LL_Journal_Retire shall delete the segments at the head of the journal that have no live records, except the segment being appended to. The head file shall be updated before a segment is deleted.]*/
+    while ((journal->segmentCount > 1) &&
+        (journal->segments[0].liveRecords == 0))
+    {
+        if (writeHead(journal, journal->segments[1].sequence) != 0)
+        {
+            LogError("unable to update the journal head, segment %lu is kept", journal->segments[0].sequence);
+            break;
+        }
+        else
+        {
+            (void)remove(segmentFileName(journal, journal->segments[0].sequence));
+            (void)memmove(&journal->segments[0], &journal->segments[1], (journal->segmentCount - 1) * sizeof(JOURNAL_SEGMENT));
+            journal->segmentCount--;
+        }
+    }
+}
+
+static int openNewSegment(IOTHUB_CLIENT_LL_JOURNAL_DATA* journal, unsigned long sequence)
+{
+    int result;
+    JOURNAL_SEGMENT* newSegments = (JOURNAL_SEGMENT*)realloc(journal->segments, (journal->segmentCount + 1) * sizeof(JOURNAL_SEGMENT));
+    if (newSegments == NULL)
+    {
+        LogError("unable to realloc");
+        result = __LINE__;
+    }
+    else
+    {
+        FILE* file;
+        journal->segments = newSegments;
+        if ((file = fopen(segmentFileName(journal, sequence), "wb")) == NULL)
+        {
+            LogError("unable to create journal segment %s", journal->fileName);
+            result = __LINE__;
+        }
+        else
+        {
+            if (journal->activeFile != NULL)
+            {
+                if (journal->isDirty)
+                {
+                    (void)fflush(journal->activeFile);
+                    (void)journal_fsync(journal->activeFile);
+                }
+                (void)fclose(journal->activeFile);
+            }
+            journal->activeFile = file;
+            journal->activeSize = 0;
+            journal->mustRollOver = false;
+            journal->isDirty = false;
+            journal->segments[journal->segmentCount].sequence = sequence;
+            journal->segments[journal->segmentCount].lastRecordId = journal->nextRecordId - 1;
+            journal->segments[journal->segmentCount].liveRecords = 0;
+            journal->segmentCount++;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static int writeRecord(IOTHUB_CLIENT_LL_JOURNAL_DATA* journal, unsigned char type, uint64_t recordId, const unsigned char* payload, size_t payloadSize)
+{
+    int result;
+    size_t recordSize = RECORD_HEADER_SIZE + payloadSize;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_010: [A new segment shall be started when the record would make the segment being appended to larger than maxSegmentSize (unless that segment is empty) or when a previous write to it failed.]*/
+    if (((journal->activeFile == NULL) ||
+        journal->mustRollOver ||
+        ((journal->activeSize > 0) && (journal->activeSize + recordSize > journal->maxSegmentSize))) &&
+        (openNewSegment(journal, journal->segments[journal->segmentCount - 1].sequence + 1) != 0))
+    {
+        journal->mustRollOver = true;
+        result = __LINE__;
+    }
+    else
+    {
+        unsigned char header[RECORD_HEADER_SIZE];
+        put_uint32(header, (uint32_t)payloadSize);
+        header[RECORD_TYPE_OFFSET] = type;
+        put_uint64(header + RECORD_TYPE_OFFSET + 1, recordId);
+        put_uint32(header + RECORD_CRC_OFFSET, crc32_update(crc32_update(0, header + RECORD_TYPE_OFFSET, RECORD_HEADER_SIZE - RECORD_TYPE_OFFSET), payload, payloadSize));
+        journal->isDirty = true;
+        if ((fwrite(header, 1, RECORD_HEADER_SIZE, journal->activeFile) != RECORD_HEADER_SIZE) ||
+            ((payloadSize > 0) && (fwrite(payload, 1, payloadSize, journal->activeFile) != payloadSize)) ||
+            (fflush(journal->activeFile) != 0))
+        {
+            /*whatever made it to the disk is a torn record, nothing can be appended after it*/
+            LogError("unable to write to journal segment %lu", journal->segments[journal->segmentCount - 1].sequence);
+            journal->mustRollOver = true;
+            result = __LINE__;
+        }
+        else
+        {
+            journal->activeSize += recordSize;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static size_t fieldSize(const char* value)
+{
+    return 4 + ((value == NULL) ? 0 : strlen(value) + 1);
+}
+
+static unsigned char* putField(unsigned char* destination, const unsigned char* value, size_t size)
+{
+    put_uint32(destination, (uint32_t)size);
+    if (size > 0)
+    {
+        (void)memcpy(destination + 4, value, size);
+    }
+    return destination + 4 + size;
+}
+
+static unsigned char* putStringField(unsigned char* destination, const char* value)
+{
+    return putField(destination, (const unsigned char*)value, (value == NULL) ? 0 : strlen(value) + 1);
+}
+
+/*payload of a message record: u8 content type, body, message id, correlation id, u32 property count, property names and values. Every field is a u32 length followed by that many bytes, strings keep their '\0' and a length of 0 is NULL*/
+static unsigned char* serializeMessage(IOTHUB_MESSAGE_HANDLE message, size_t* payloadSize)
+{
+    unsigned char* result;
+    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message);
+    const unsigned char* body = NULL;
+    size_t bodySize = 0;
+    bool hasBody;
+    const char* const* keys;
+    const char* const* values;
+    size_t propertyCount;
+
+    if (contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        hasBody = (IoTHubMessage_GetByteArray(message, &body, &bodySize) == IOTHUB_MESSAGE_OK);
+    }
+    else if (contentType == IOTHUBMESSAGE_STRING)
+    {
+        body = (const unsigned char*)IoTHubMessage_GetString(message);
+        hasBody = (body != NULL);
+        bodySize = hasBody ? strlen((const char*)body) + 1 : 0;
+    }
+    else
+    {
+        hasBody = false;
+    }
+
+    if (!hasBody)
+    {
+        LogError("unable to get the content of the message");
+        result = NULL;
+    }
+    else if (Map_GetInternals(IoTHubMessage_Properties(message), &keys, &values, &propertyCount) != MAP_OK)
+    {
+        LogError("unable to get the properties of the message");
+        result = NULL;
+    }
+    else
+    {
+        const char* messageId = IoTHubMessage_GetMessageId(message);
+        const char* correlationId = IoTHubMessage_GetCorrelationId(message);
+        size_t i;
+        size_t size = 1 + 4 + bodySize + fieldSize(messageId) + fieldSize(correlationId) + 4;
+        for (i = 0; i < propertyCount; i++)
+        {
+            size += fieldSize(keys[i]) + fieldSize(values[i]);
+        }
+
+        if (size > MAX_RECORD_PAYLOAD_SIZE)
+        {
+            LogError("message is too big to be journaled");
+            result = NULL;
+        }
+        else if ((result = (unsigned char*)malloc(size)) == NULL)
+        {
+            LogError("unable to malloc");
+        }
+        else
+        {
+            unsigned char* current = result;
+            *current++ = (unsigned char)contentType;
+            current = putField(current, body, bodySize);
+            current = putStringField(current, messageId);
+            current = putStringField(current, correlationId);
+            put_uint32(current, (uint32_t)propertyCount);
+            current += 4;
+            for (i = 0; i < propertyCount; i++)
+            {
+                current = putStringField(current, keys[i]);
+                current = putStringField(current, values[i]);
+            }
+            *payloadSize = size;
+        }
+    }
+    return result;
+}
+
+static int getField(const unsigned char** current, const unsigned char* end, const unsigned char** value, size_t* size)
+{
+    int result;
+    if (end - *current < 4)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        *size = get_uint32(*current);
+        *current += 4;
+        if ((size_t)(end - *current) < *size)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            *value = (*size == 0) ? NULL : *current;
+            *current += *size;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static int getStringField(const unsigned char** current, const unsigned char* end, const char** value)
+{
+    int result;
+    const unsigned char* field;
+    size_t size;
+    if (getField(current, end, &field, &size) != 0)
+    {
+        result = __LINE__;
+    }
+    else if ((size > 0) && (field[size - 1] != '\0'))
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        *value = (const char*)field;
+        result = 0;
+    }
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE deserializeMessage(const unsigned char* payload, size_t payloadSize)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    const unsigned char* current = payload;
+    const unsigned char* end = payload + payloadSize;
+    const unsigned char* body;
+    size_t bodySize;
+    const char* messageId;
+    const char* correlationId;
+    unsigned char contentType = (payloadSize < 1) ? 0 : *current++;
+
+    if ((payloadSize < 1) ||
+        (getField(&current, end, &body, &bodySize) != 0) ||
+        (getStringField(&current, end, &messageId) != 0) ||
+        (getStringField(&current, end, &correlationId) != 0) ||
+        (end - current < 4))
+    {
+        result = NULL;
+    }
+    else
+    {
+        size_t propertyCount = get_uint32(current);
+        current += 4;
+
+        if (contentType == IOTHUBMESSAGE_BYTEARRAY)
+        {
+            result = IoTHubMessage_CreateFromByteArray(body, bodySize);
+        }
+        else if ((contentType == IOTHUBMESSAGE_STRING) && (body != NULL) && (body[bodySize - 1] == '\0'))
+        {
+            result = IoTHubMessage_CreateFromString((const char*)body);
+        }
+        else
+        {
+            result = NULL;
+        }
+
+        if (result != NULL)
+        {
+            MAP_HANDLE properties = IoTHubMessage_Properties(result);
+            size_t i;
+            bool isValid = ((messageId == NULL) || (IoTHubMessage_SetMessageId(result, messageId) == IOTHUB_MESSAGE_OK)) &&
+                ((correlationId == NULL) || (IoTHubMessage_SetCorrelationId(result, correlationId) == IOTHUB_MESSAGE_OK)) &&
+                (properties != NULL);
+            for (i = 0; isValid && (i < propertyCount); i++)
+            {
+                const char* key;
+                const char* value;
+                isValid = (getStringField(&current, end, &key) == 0) &&
+                    (getStringField(&current, end, &value) == 0) &&
+                    (key != NULL) && (value != NULL) &&
+                    (Map_AddOrUpdate(properties, key, value) == MAP_OK);
+            }
+
+            if (!isValid)
+            {
+                IoTHubMessage_Destroy(result);
+                result = NULL;
+            }
+        }
+    }
+    return result;
+}
+
+/*reads the record at the current position of file. Returns 0 and a malloc'd payload (NULL when empty) if the record is complete and its crc matches*/
+static int readRecord(FILE* file, unsigned char* type, uint64_t* recordId, unsigned char** payload, size_t* payloadSize)
+{
+    int result;
+    unsigned char header[RECORD_HEADER_SIZE];
+    if (fread(header, 1, RECORD_HEADER_SIZE, file) != RECORD_HEADER_SIZE)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        *payloadSize = get_uint32(header);
+        *type = header[RECORD_TYPE_OFFSET];
+        *recordId = get_uint64(header + RECORD_TYPE_OFFSET + 1);
+        if ((*payloadSize > MAX_RECORD_PAYLOAD_SIZE) ||
+            ((*type != RECORD_TYPE_MESSAGE) && (*type != RECORD_TYPE_RETIRE)))
+        {
+            result = __LINE__;
+        }
+        else if (*payloadSize == 0)
+        {
+            *payload = NULL;
+            result = (crc32_update(0, header + RECORD_TYPE_OFFSET, RECORD_HEADER_SIZE - RECORD_TYPE_OFFSET) == get_uint32(header + RECORD_CRC_OFFSET)) ? 0 : __LINE__;
+        }
+        else if ((*payload = (unsigned char*)malloc(*payloadSize)) == NULL)
+        {
+            LogError("unable to malloc");
+            result = __LINE__;
+        }
+        else if ((fread(*payload, 1, *payloadSize, file) != *payloadSize) ||
+            (crc32_update(crc32_update(0, header + RECORD_TYPE_OFFSET, RECORD_HEADER_SIZE - RECORD_TYPE_OFFSET), *payload, *payloadSize) != get_uint32(header + RECORD_CRC_OFFSET)))
+        {
+            free(*payload);
+            *payload = NULL;
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static JOURNAL_LIVE_RECORD* findLiveRecord(JOURNAL_LIVE_RECORD* records, size_t count, uint64_t recordId)
+{
+    size_t low = 0;
+    size_t high = count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (records[middle].recordId < recordId)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return ((low < count) && (records[low].recordId == recordId)) ? &records[low] : NULL;
+}
+
+/*first pass over the segments: finds the message records that were not retired*/
+static int scanSegments(IOTHUB_CLIENT_LL_JOURNAL_DATA* journal, unsigned long firstSequence, JOURNAL_LIVE_RECORD** liveRecords, size_t* liveRecordCount)
+{
+    int result = 0;
+    unsigned long sequence;
+    FILE* file;
+
+    *liveRecords = NULL;
+    *liveRecordCount = 0;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_003: [IoTHubClient_LL_Journal_Create shall read the segments starting with the first one until a segment does not exist. A segment shall be read up to the first record that is incomplete or that fails the CRC check.]*/
+    for (sequence = firstSequence; (result == 0) && ((file = fopen(segmentFileName(journal, sequence), "rb")) != NULL); sequence++)
+    {
+        JOURNAL_SEGMENT* newSegments = (JOURNAL_SEGMENT*)realloc(journal->segments, (journal->segmentCount + 1) * sizeof(JOURNAL_SEGMENT));
+        if (newSegments == NULL)
+        {
+            LogError("unable to realloc");
+            result = __LINE__;
+        }
+        else
+        {
+            JOURNAL_SEGMENT* segment = &newSegments[journal->segmentCount];
+            long offset = 0;
+            unsigned char type;
+            uint64_t recordId;
+            unsigned char* payload;
+            size_t payloadSize;
+
+            journal->segments = newSegments;
+            segment->sequence = sequence;
+            segment->lastRecordId = journal->nextRecordId - 1;
+            segment->liveRecords = 0;
+
+            while ((result == 0) &&
+                (readRecord(file, &type, &recordId, &payload, &payloadSize) == 0))
+            {
+                free(payload);
+                if (recordId >= journal->nextRecordId)
+                {
+                    journal->nextRecordId = recordId + 1;
+                }
+
+                if (type == RECORD_TYPE_MESSAGE)
+                {
+                    if ((*liveRecordCount > 0) && ((*liveRecords)[*liveRecordCount - 1].recordId >= recordId))
+                    {
+                        LogError("journal record %lu is out of order, it is ignored", (unsigned long)recordId);
+                    }
+                    else
+                    {
+                        JOURNAL_LIVE_RECORD* newLiveRecords = (JOURNAL_LIVE_RECORD*)realloc(*liveRecords, (*liveRecordCount + 1) * sizeof(JOURNAL_LIVE_RECORD));
+                        if (newLiveRecords == NULL)
+                        {
+                            LogError("unable to realloc");
+                            result = __LINE__;
+                        }
+                        else
+                        {
+                            *liveRecords = newLiveRecords;
+                            newLiveRecords[*liveRecordCount].recordId = recordId;
+                            newLiveRecords[*liveRecordCount].segmentIndex = journal->segmentCount;
+                            newLiveRecords[*liveRecordCount].offset = offset;
+                            newLiveRecords[*liveRecordCount].isLive = true;
+                            (*liveRecordCount)++;
+                            segment->lastRecordId = recordId;
+                        }
+                    }
+                }
+                else
+                {
+                    JOURNAL_LIVE_RECORD* retired = findLiveRecord(*liveRecords, *liveRecordCount, recordId);
+                    if (retired != NULL)
+                    {
+                        retired->isLive = false;
+                    }
+                }
+                offset += (long)(RECORD_HEADER_SIZE + payloadSize);
+            }
+
+            journal->segmentCount++;
+        }
+        (void)fclose(file);
+    }
+
+    if (result == 0)
+    {
+        size_t i;
+        for (i = 0; i < *liveRecordCount; i++)
+        {
+            if ((*liveRecords)[i].isLive)
+            {
+                journal->segments[(*liveRecords)[i].segmentIndex].liveRecords++;
+            }
+        }
+    }
+    return result;
+}
+
+/*second pass: hands the live messages to the replay callback*/
+static void replayLiveRecords(IOTHUB_CLIENT_LL_JOURNAL_DATA* journal, JOURNAL_LIVE_RECORD* liveRecords, size_t liveRecordCount, IOTHUB_CLIENT_LL_JOURNAL_REPLAY_CALLBACK replayCallback, void* context)
+{
+    size_t i;
+    size_t openSegmentIndex = 0;
+    FILE* file = NULL;
+
+    for (i = 0; i < liveRecordCount; i++)
+    {
+        if (liveRecords[i].isLive)
+        {
+            unsigned char type;
+            uint64_t recordId;
+            unsigned char* payload = NULL;
+            size_t payloadSize;
+            IOTHUB_MESSAGE_HANDLE message;
+
+            if ((file == NULL) || (openSegmentIndex != liveRecords[i].segmentIndex))
+            {
+                if (file != NULL)
+                {
+                    (void)fclose(file);
+                }
+                openSegmentIndex = liveRecords[i].segmentIndex;
+                file = fopen(segmentFileName(journal, journal->segments[openSegmentIndex].sequence), "rb");
+            }
+
+            if ((file == NULL) ||
+                (fseek(file, liveRecords[i].offset, SEEK_SET) != 0) ||
+                (readRecord(file, &type, &recordId, &payload, &payloadSize) != 0) ||
+                ((message = deserializeMessage(payload, payloadSize)) == NULL))
+            {
+                /*a record that cannot be turned back into a message would otherwise pin its segment forever*/
+                LogError("journal record %lu cannot be replayed, it is dropped", (unsigned long)liveRecords[i].recordId);
+                journal->segments[liveRecords[i].segmentIndex].liveRecords--;
+            }
+            /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_005: [IoTHubClient_LL_Journal_Create shall call replayCallback, oldest first, with a new message for every message record that was not retired. When replayCallback does not return 0 the message shall be destroyed and the record shall stay live.]*/
+            else if (replayCallback(message, liveRecords[i].recordId, context) != 0)
+            {
+                LogError("journal record %lu was not accepted, it stays in the journal", (unsigned long)liveRecords[i].recordId);
+                IoTHubMessage_Destroy(message);
+            }
+            free(payload);
+        }
+    }
+
+    if (file != NULL)
+    {
+        (void)fclose(file);
+    }
+}
+
+static void destroyJournal(IOTHUB_CLIENT_LL_JOURNAL_DATA* journal)
+{
+    if (journal->activeFile != NULL)
+    {
+        (void)fclose(journal->activeFile);
+    }
+    free(journal->segments);
+    free(journal->fileName);
+    free(journal->path);
+    free(journal);
+}
+
+IOTHUB_CLIENT_LL_JOURNAL_HANDLE IoTHubClient_LL_Journal_Create(const char* path, size_t maxSegmentSize, IOTHUB_CLIENT_LL_JOURNAL_REPLAY_CALLBACK replayCallback, void* context)
+{
+    IOTHUB_CLIENT_LL_JOURNAL_DATA* result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_001: [If path is NULL, maxSegmentSize is 0 or replayCallback is NULL then IoTHubClient_LL_Journal_Create shall fail and return NULL.]*/
+    if ((path == NULL) ||
+        (maxSegmentSize == 0) ||
+        (replayCallback == NULL))
+    {
+        LogError("invalid argument path=%p maxSegmentSize=%lu replayCallback=%p", path, (unsigned long)maxSegmentSize, replayCallback);
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_CLIENT_LL_JOURNAL_DATA*)malloc(sizeof(IOTHUB_CLIENT_LL_JOURNAL_DATA))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_007: [If any of the above operations fails then IoTHubClient_LL_Journal_Create shall fail and return NULL.]*/
+        LogError("unable to malloc");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(IOTHUB_CLIENT_LL_JOURNAL_DATA));
+        result->maxSegmentSize = maxSegmentSize;
+        result->nextRecordId = 1;
+        result->isReplaying = true;
+
+        if (((result->path = (char*)malloc(strlen(path) + 1)) == NULL) ||
+            ((result->fileName = (char*)malloc(strlen(path) + FILE_NAME_SUFFIX_SIZE)) == NULL))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_007: [If any of the above operations fails then IoTHubClient_LL_Journal_Create shall fail and return NULL.]*/
+            LogError("unable to malloc");
+            destroyJournal(result);
+            result = NULL;
+        }
+        else
+        {
+            unsigned long firstSequence;
+            JOURNAL_LIVE_RECORD* liveRecords;
+            size_t liveRecordCount;
+
+            (void)strcpy(result->path, path);
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_002: [IoTHubClient_LL_Journal_Create shall read the sequence number of the first segment from <path>.head, then from <path>.head.tmp. If neither can be read the first segment shall be <path>.0.]*/
+            if ((readHeadFile(headFileName(result, false), &firstSequence) != 0) &&
+                (readHeadFile(headFileName(result, true), &firstSequence) != 0))
+            {
+                firstSequence = 0;
+            }
+            else if (firstSequence > 0)
+            {
+                /*a crash between updating the head and deleting the segment leaves that segment behind*/
+                (void)remove(segmentFileName(result, firstSequence - 1));
+            }
+
+            if (scanSegments(result, firstSequence, &liveRecords, &liveRecordCount) != 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_007: [If any of the above operations fails then IoTHubClient_LL_Journal_Create shall fail and return NULL.]*/
+                LogError("unable to read the journal %s", path);
+                free(liveRecords);
+                destroyJournal(result);
+                result = NULL;
+            }
+            /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_004: [IoTHubClient_LL_Journal_Create shall start a new segment, numbered after the last segment read, before replaying any record.]*/
+            else if (openNewSegment(result, (result->segmentCount == 0) ? firstSequence : result->segments[result->segmentCount - 1].sequence + 1) != 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_007: [If any of the above operations fails then IoTHubClient_LL_Journal_Create shall fail and return NULL.]*/
+                LogError("unable to start a new segment in the journal %s", path);
+                free(liveRecords);
+                destroyJournal(result);
+                result = NULL;
+            }
+            else
+            {
+                replayLiveRecords(result, liveRecords, liveRecordCount, replayCallback, context);
+                free(liveRecords);
+
+                result->isReplaying = false;
+                compact(result);
+            }
+        }
+    }
+    return result;
+}
+
+int IoTHubClient_LL_Journal_Append(IOTHUB_CLIENT_LL_JOURNAL_HANDLE handle, IOTHUB_MESSAGE_HANDLE message, uint64_t* recordId)
+{
+    int result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_008: [If handle, message or recordId is NULL then IoTHubClient_LL_Journal_Append shall fail and return a non-zero value.]*/
+    if ((handle == NULL) ||
+        (message == NULL) ||
+        (recordId == NULL))
+    {
+        LogError("invalid argument handle=%p message=%p recordId=%p", handle, message, recordId);
+        result = __LINE__;
+    }
+    else
+    {
+        size_t payloadSize;
+        /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_009: [IoTHubClient_LL_Journal_Append shall append to the journal a message record holding the content, message id, correlation id and properties of message, store its record id in *recordId and return 0.]*/
+        unsigned char* payload = serializeMessage(message, &payloadSize);
+        if (payload == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_011: [If any of the above operations fails then IoTHubClient_LL_Journal_Append shall fail and return a non-zero value.]*/
+            LogError("unable to serialize the message");
+            result = __LINE__;
+        }
+        else
+        {
+            if (writeRecord(handle, RECORD_TYPE_MESSAGE, handle->nextRecordId, payload, payloadSize) != 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_011: [If any of the above operations fails then IoTHubClient_LL_Journal_Append shall fail and return a non-zero value.]*/
+                LogError("unable to write the message to the journal");
+                result = __LINE__;
+            }
+            else
+            {
+                JOURNAL_SEGMENT* segment = &handle->segments[handle->segmentCount - 1];
+                *recordId = handle->nextRecordId++;
+                segment->lastRecordId = *recordId;
+                segment->liveRecords++;
+                result = 0;
+            }
+            free(payload);
+        }
+    }
+    return result;
+}
+
+int IoTHubClient_LL_Journal_Retire(IOTHUB_CLIENT_LL_JOURNAL_HANDLE handle, uint64_t recordId)
+{
+    int result;
+    if (handle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_012: [If handle is NULL, or recordId was not returned by IoTHubClient_LL_Journal_Append or IoTHubClient_LL_Journal_Create, or the segment holding recordId has no live records then IoTHubClient_LL_Journal_Retire shall fail and return a non-zero value.]*/
+        LogError("invalid argument handle=NULL");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; (i < handle->segmentCount) && (handle->segments[i].lastRecordId < recordId); i++)
+        {
+        }
+
+        if ((recordId == 0) ||
+            (recordId >= handle->nextRecordId) ||
+            (i == handle->segmentCount) ||
+            (handle->segments[i].liveRecords == 0))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_012: [If handle is NULL, or recordId was not returned by IoTHubClient_LL_Journal_Append or IoTHubClient_LL_Journal_Create, or the segment holding recordId has no live records then IoTHubClient_LL_Journal_Retire shall fail and return a non-zero value.]*/
+            LogError("journal record %lu is not live", (unsigned long)recordId);
+            result = __LINE__;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_013: [IoTHubClient_LL_Journal_Retire shall append a record retiring recordId. If that fails IoTHubClient_LL_Journal_Retire shall return a non-zero value and the message record shall stay live.]*/
+        else if (writeRecord(handle, RECORD_TYPE_RETIRE, recordId, NULL, 0) != 0)
+        {
+            LogError("unable to retire journal record %lu", (unsigned long)recordId);
+            result = __LINE__;
+        }
+        else
+        {
+            handle->segments[i].liveRecords--;
+            if (!handle->isReplaying)
+            {
+                compact(handle);
+            }
+            result = 0;
+        }
+    }
+    return result;
+}
+
+int IoTHubClient_LL_Journal_Sync(IOTHUB_CLIENT_LL_JOURNAL_HANDLE handle)
+{
+    int result;
+    if (handle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_015: [If handle is NULL then IoTHubClient_LL_Journal_Sync shall fail and return a non-zero value.]*/
+        LogError("invalid argument handle=NULL");
+        result = __LINE__;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_016: [IoTHubClient_LL_Journal_Sync shall flush the segment being appended to to the disk when it was written since the last sync and return 0 on success.]*/
+    else if (!handle->isDirty || (handle->activeFile == NULL))
+    {
+        result = 0;
+    }
+    else if ((fflush(handle->activeFile) != 0) ||
+        (journal_fsync(handle->activeFile) != 0))
+    {
+        LogError("unable to sync journal segment %lu", handle->segments[handle->segmentCount - 1].sequence);
+        result = __LINE__;
+    }
+    else
+    {
+        handle->isDirty = false;
+        result = 0;
+    }
+    return result;
+}
+
+void IoTHubClient_LL_Journal_Destroy(IOTHUB_CLIENT_LL_JOURNAL_HANDLE handle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_017: [If handle is NULL then IoTHubClient_LL_Journal_Destroy shall do nothing.]*/
+    if (handle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_JOURNAL_10_018: [IoTHubClient_LL_Journal_Destroy shall sync and close the journal and free all resources. The files shall stay on disk.]*/
+        (void)IoTHubClient_LL_Journal_Sync(handle);
+        destroyJournal(handle);
+    }
+}
+
+#endif /*DONT_USE_JOURNAL*/
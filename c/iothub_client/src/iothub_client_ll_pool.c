@@ -0,0 +1,215 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "iothub_client_ll_pool.h"
+
+/*every object of the slab starts at a multiple of the strictest alignment malloc guarantees for these types*/
+typedef union POOL_ALIGNMENT_TAG
+{
+    void* pointer;
+    long long integer;
+    double real;
+} POOL_ALIGNMENT;
+
+/*a free object holds the address of the next free object*/
+typedef struct POOL_FREE_OBJECT_TAG
+{
+    struct POOL_FREE_OBJECT_TAG* next;
+} POOL_FREE_OBJECT;
+
+typedef struct IOTHUB_CLIENT_LL_POOL_DATA_TAG
+{
+    unsigned char* slab;
+    size_t objectSize;
+    size_t stride;
+    size_t objectCount;
+    POOL_FREE_OBJECT* freeList;
+    size_t inUse;
+    size_t peakInUse;
+    uint64_t hits;
+    uint64_t misses;
+} IOTHUB_CLIENT_LL_POOL_DATA;
+
+/*the space taken in the slab by an object of objectSize bytes, 0 when it cannot be represented in a size_t*/
+static size_t getStride(size_t objectSize)
+{
+    size_t result;
+    if (objectSize < sizeof(POOL_FREE_OBJECT))
+    {
+        objectSize = sizeof(POOL_FREE_OBJECT);
+    }
+
+    if (objectSize > ((size_t)-1) - sizeof(POOL_ALIGNMENT))
+    {
+        result = 0;
+    }
+    else
+    {
+        result = ((objectSize + sizeof(POOL_ALIGNMENT) - 1) / sizeof(POOL_ALIGNMENT)) * sizeof(POOL_ALIGNMENT);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_LL_POOL_HANDLE IoTHubClient_LL_Pool_Create(size_t objectSize, size_t objectCount)
+{
+    IOTHUB_CLIENT_LL_POOL_DATA* result;
+    size_t stride;
+    /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_001: [If objectSize is 0 or objectCount is 0 then IoTHubClient_LL_Pool_Create shall fail and return NULL.]*/
+    if ((objectSize == 0) || (objectCount == 0))
+    {
+        LogError("invalid arg objectSize=%zu, objectCount=%zu", objectSize, objectCount);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_002: [IoTHubClient_LL_Pool_Create shall round objectSize up to a multiple of the alignment of pointers, long long and double. If the size of the block of memory cannot be represented in a size_t then IoTHubClient_LL_Pool_Create shall fail and return NULL.]*/
+    else if (((stride = getStride(objectSize)) == 0) || (objectCount > ((size_t)-1) / stride))
+    {
+        LogError("a pool of %zu objects of %zu bytes is too big", objectCount, objectSize);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_003: [IoTHubClient_LL_Pool_Create shall allocate the pool and one block of memory holding objectCount objects and shall chain all the objects in the list of free objects.]*/
+        result = (IOTHUB_CLIENT_LL_POOL_DATA*)malloc(sizeof(IOTHUB_CLIENT_LL_POOL_DATA));
+        if (result == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_004: [If any of the above operations fails then IoTHubClient_LL_Pool_Create shall fail and return NULL.]*/
+            LogError("unable to malloc");
+            /*return as is*/
+        }
+        else if ((result->slab = (unsigned char*)malloc(stride * objectCount)) == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_004: [If any of the above operations fails then IoTHubClient_LL_Pool_Create shall fail and return NULL.]*/
+            LogError("unable to malloc a slab of %zu bytes", stride * objectCount);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            size_t i = objectCount;
+            result->objectSize = objectSize;
+            result->stride = stride;
+            result->objectCount = objectCount;
+            result->freeList = NULL;
+            result->inUse = 0;
+            result->peakInUse = 0;
+            result->hits = 0;
+            result->misses = 0;
+            /*chained backwards so that the objects are handed out in address order*/
+            while (i > 0)
+            {
+                POOL_FREE_OBJECT* object;
+                i--;
+                object = (POOL_FREE_OBJECT*)(result->slab + i * stride);
+                object->next = result->freeList;
+                result->freeList = object;
+            }
+        }
+    }
+    return result;
+}
+
+void* IoTHubClient_LL_Pool_Alloc(IOTHUB_CLIENT_LL_POOL_HANDLE handle)
+{
+    void* result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_005: [If handle is NULL then IoTHubClient_LL_Pool_Alloc shall return NULL.]*/
+    if (handle == NULL)
+    {
+        LogError("invalid arg IOTHUB_CLIENT_LL_POOL_HANDLE handle=%p", handle);
+        result = NULL;
+    }
+    else if (handle->freeList != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_006: [If the list of free objects is not empty then IoTHubClient_LL_Pool_Alloc shall remove its first object, count a hit and return the object.]*/
+        POOL_FREE_OBJECT* object = handle->freeList;
+        handle->freeList = object->next;
+        handle->inUse++;
+        if (handle->inUse > handle->peakInUse)
+        {
+            handle->peakInUse = handle->inUse;
+        }
+        handle->hits++;
+        result = object;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_007: [Otherwise IoTHubClient_LL_Pool_Alloc shall count a miss and return the result of malloc for objectSize bytes.]*/
+        handle->misses++;
+        result = malloc(handle->objectSize);
+        if (result == NULL)
+        {
+            LogError("unable to malloc");
+        }
+    }
+    return result;
+}
+
+void IoTHubClient_LL_Pool_Free(IOTHUB_CLIENT_LL_POOL_HANDLE handle, void* object)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_008: [If handle is NULL or object is NULL then IoTHubClient_LL_Pool_Free shall do nothing.]*/
+    if ((handle == NULL) || (object == NULL))
+    {
+        LogError("invalid arg IOTHUB_CLIENT_LL_POOL_HANDLE handle=%p, void* object=%p", handle, object);
+    }
+    else
+    {
+        unsigned char* address = (unsigned char*)object;
+        if ((address >= handle->slab) && (address < handle->slab + handle->stride * handle->objectCount))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_009: [If object belongs to the block of memory of the pool then IoTHubClient_LL_Pool_Free shall insert it at the head of the list of free objects.]*/
+            POOL_FREE_OBJECT* freeObject = (POOL_FREE_OBJECT*)object;
+            freeObject->next = handle->freeList;
+            handle->freeList = freeObject;
+            handle->inUse--;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_010: [Otherwise IoTHubClient_LL_Pool_Free shall free object.]*/
+            free(object);
+        }
+    }
+}
+
+int IoTHubClient_LL_Pool_GetStatistics(IOTHUB_CLIENT_LL_POOL_HANDLE handle, IOTHUB_CLIENT_POOL_STATISTICS* statistics)
+{
+    int result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_011: [If handle is NULL or statistics is NULL then IoTHubClient_LL_Pool_GetStatistics shall fail and return a non-zero value.]*/
+    if ((handle == NULL) || (statistics == NULL))
+    {
+        LogError("invalid arg IOTHUB_CLIENT_LL_POOL_HANDLE handle=%p, IOTHUB_CLIENT_POOL_STATISTICS* statistics=%p", handle, statistics);
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_012: [IoTHubClient_LL_Pool_GetStatistics shall copy the capacity, the number of objects in use, the peak number of objects in use, the hits and the misses of the pool in *statistics and return 0.]*/
+        statistics->capacity = handle->objectCount;
+        statistics->inUse = handle->inUse;
+        statistics->peakInUse = handle->peakInUse;
+        statistics->hits = handle->hits;
+        statistics->misses = handle->misses;
+        result = 0;
+    }
+    return result;
+}
+
+void IoTHubClient_LL_Pool_Destroy(IOTHUB_CLIENT_LL_POOL_HANDLE handle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_013: [If handle is NULL then IoTHubClient_LL_Pool_Destroy shall do nothing.]*/
+    if (handle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_POOL_10_014: [IoTHubClient_LL_Pool_Destroy shall free the block of memory of the pool and the pool. Objects of the pool still in use become invalid.]*/
+        if (handle->inUse != 0)
+        {
+            LogError("destroying a pool with %zu objects in use", handle->inUse);
+        }
+        free(handle->slab);
+        free(handle);
+    }
+}
@@ -0,0 +1,213 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include <string.h>
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "iothub_client_options.h"
+#include "iothub_client_retry_policy.h"
+
+/*the longest wait allowed after the failure-th failure in a row*/
+static size_t getDelayCap(const IOTHUB_CLIENT_RETRY_POLICY* policy)
+{
+    size_t result = policy->initialDelayInMs;
+    size_t doublings = policy->failureCount - 1;
+    while ((doublings > 0) && (result > 0) && (result < policy->maxDelayInMs))
+    {
+        result = (result > policy->maxDelayInMs / 2) ? policy->maxDelayInMs : result * 2;
+        doublings--;
+    }
+    return (result > policy->maxDelayInMs) ? policy->maxDelayInMs : result;
+}
+
+/*folds value into the state of the generator with the splitmix64 finalizer, the result is never 0*/
+static void mixIntoRandomState(IOTHUB_CLIENT_RETRY_POLICY* policy, uint64_t value)
+{
+    uint64_t mixed = policy->randomState ^ value;
+    mixed += 0x9E3779B97F4A7C15ULL;
+    mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBULL;
+    mixed ^= mixed >> 31;
+    policy->randomState = (mixed == 0) ? 0x9E3779B97F4A7C15ULL : mixed;
+}
+
+/*xorshift64: every policy has its own sequence, so the transports running on different threads do not share the state of rand()*/
+static uint64_t getNextRandom(IOTHUB_CLIENT_RETRY_POLICY* policy)
+{
+    uint64_t x = policy->randomState;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    policy->randomState = x;
+    return x;
+}
+
+/*a delay between 0 and cap, both included*/
+static size_t getJitteredDelay(IOTHUB_CLIENT_RETRY_POLICY* policy, size_t cap)
+{
+    uint64_t random = getNextRandom(policy);
+    uint64_t range = (uint64_t)cap + 1;
+    return (size_t)((range == 0) ? random : random % range);
+}
+
+void IoTHubClient_RetryPolicy_Init(IOTHUB_CLIENT_RETRY_POLICY* policy)
+{
+    /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_001: [If policy is NULL then IoTHubClient_RetryPolicy_Init shall do nothing.]*/
+    if (policy == NULL)
+    {
+        LogError("invalid arg IOTHUB_CLIENT_RETRY_POLICY* policy=%p", policy);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_002: [IoTHubClient_RetryPolicy_Init shall set the initial delay to IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_INITIAL_DELAY and the maximum delay to IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_MAX_DELAY milliseconds, with no failure counted and no wait.]*/
+        policy->initialDelayInMs = IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_INITIAL_DELAY;
+        policy->maxDelayInMs = IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_MAX_DELAY;
+        policy->failureCount = 0;
+        policy->delayInMs = 0;
+        policy->isWaiting = false;
+        policy->isWaitStarted = false;
+        policy->waitStartInMs = 0;
+        /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_018: [IoTHubClient_RetryPolicy_Init shall seed the random generator of the policy from the address of the policy.]*/
+        policy->randomState = 0;
+        mixIntoRandomState(policy, (uint64_t)(uintptr_t)policy);
+    }
+}
+
+void IoTHubClient_RetryPolicy_Seed(IOTHUB_CLIENT_RETRY_POLICY* policy, const char* seed)
+{
+    /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_019: [If policy or seed is NULL then IoTHubClient_RetryPolicy_Seed shall do nothing.]*/
+    if ((policy == NULL) || (seed == NULL))
+    {
+        LogError("invalid arg IOTHUB_CLIENT_RETRY_POLICY* policy=%p, const char* seed=%p", policy, seed);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_020: [IoTHubClient_RetryPolicy_Seed shall mix the FNV-1a hash of seed into the random generator of the policy.]*/
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        const unsigned char* current;
+        for (current = (const unsigned char*)seed; *current != '\0'; current++)
+        {
+            hash = (hash ^ *current) * 0x100000001B3ULL;
+        }
+        mixIntoRandomState(policy, hash);
+    }
+}
+
+bool IoTHubClient_RetryPolicy_SetOption(IOTHUB_CLIENT_RETRY_POLICY* policy, const char* optionName, const void* value)
+{
+    bool result;
+    /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_003: [If policy, optionName or value is NULL then IoTHubClient_RetryPolicy_SetOption shall return false.]*/
+    if ((policy == NULL) || (optionName == NULL) || (value == NULL))
+    {
+        LogError("invalid arg IOTHUB_CLIENT_RETRY_POLICY* policy=%p, const char* optionName=%s, const void* value=%p", policy, optionName, value);
+        result = false;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_004: [If optionName is "retryInitialDelay" then IoTHubClient_RetryPolicy_SetOption shall set the initial delay to the size_t milliseconds pointed to by value and return true.]*/
+    else if (strcmp(OPTION_RETRY_INITIAL_DELAY, optionName) == 0)
+    {
+        policy->initialDelayInMs = *(const size_t*)value;
+        result = true;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_005: [If optionName is "retryMaxDelay" then IoTHubClient_RetryPolicy_SetOption shall set the maximum delay to the size_t milliseconds pointed to by value and return true.]*/
+    else if (strcmp(OPTION_RETRY_MAX_DELAY, optionName) == 0)
+    {
+        policy->maxDelayInMs = *(const size_t*)value;
+        result = true;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_006: [Otherwise IoTHubClient_RetryPolicy_SetOption shall return false.]*/
+        result = false;
+    }
+    return result;
+}
+
+void IoTHubClient_RetryPolicy_OnFailure(IOTHUB_CLIENT_RETRY_POLICY* policy)
+{
+    /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_007: [If policy is NULL then IoTHubClient_RetryPolicy_OnFailure shall do nothing.]*/
+    if (policy == NULL)
+    {
+        LogError("invalid arg IOTHUB_CLIENT_RETRY_POLICY* policy=%p", policy);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_008: [IoTHubClient_RetryPolicy_OnFailure shall count the failure and take as cap the initial delay doubled for every failure in a row after the first one, without going above the maximum delay.]*/
+        if (policy->failureCount < (size_t)-1)
+        {
+            policy->failureCount++;
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_009: [IoTHubClient_RetryPolicy_OnFailure shall draw the delay between 0 and cap, both included, from the xorshift64 generator of the policy. If the delay is not 0 then the policy shall wait, from the next call to IoTHubClient_RetryPolicy_CanAttempt, otherwise it shall not wait.]*/
+        policy->delayInMs = getJitteredDelay(policy, getDelayCap(policy));
+        policy->isWaiting = (policy->delayInMs > 0);
+        policy->isWaitStarted = false;
+    }
+}
+
+void IoTHubClient_RetryPolicy_OnSuccess(IOTHUB_CLIENT_RETRY_POLICY* policy)
+{
+    /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_010: [If policy is NULL then IoTHubClient_RetryPolicy_OnSuccess shall do nothing.]*/
+    if (policy == NULL)
+    {
+        LogError("invalid arg IOTHUB_CLIENT_RETRY_POLICY* policy=%p", policy);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_011: [IoTHubClient_RetryPolicy_OnSuccess shall forget the failures counted so far and stop waiting.]*/
+        policy->failureCount = 0;
+        policy->delayInMs = 0;
+        policy->isWaiting = false;
+        policy->isWaitStarted = false;
+    }
+}
+
+bool IoTHubClient_RetryPolicy_IsWaiting(const IOTHUB_CLIENT_RETRY_POLICY* policy)
+{
+    /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_012: [If policy is NULL then IoTHubClient_RetryPolicy_IsWaiting shall return false.]*/
+    /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_013: [Otherwise IoTHubClient_RetryPolicy_IsWaiting shall return true if the delay drawn for the last failure has not elapsed yet and false otherwise.]*/
+    return (policy != NULL) && policy->isWaiting;
+}
+
+bool IoTHubClient_RetryPolicy_CanAttempt(IOTHUB_CLIENT_RETRY_POLICY* policy, uint64_t currentTimeInMs)
+{
+    bool result;
+    /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_014: [If policy is NULL then IoTHubClient_RetryPolicy_CanAttempt shall return false.]*/
+    if (policy == NULL)
+    {
+        LogError("invalid arg IOTHUB_CLIENT_RETRY_POLICY* policy=%p", policy);
+        result = false;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_015: [If the policy is not waiting then IoTHubClient_RetryPolicy_CanAttempt shall return true.]*/
+    else if (!policy->isWaiting)
+    {
+        result = true;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_016: [The first call to IoTHubClient_RetryPolicy_CanAttempt after a failure shall start the wait at currentTimeInMs. If currentTimeInMs is before the start of the wait then the wait shall start again at currentTimeInMs.]*/
+        if (!policy->isWaitStarted || (currentTimeInMs < policy->waitStartInMs))
+        {
+            policy->isWaitStarted = true;
+            policy->waitStartInMs = currentTimeInMs;
+            /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_021: [When it starts a wait, IoTHubClient_RetryPolicy_CanAttempt shall mix currentTimeInMs into the random generator of the policy for the next delays.]*/
+            mixIntoRandomState(policy, currentTimeInMs);
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_RETRY_POLICY_10_017: [IoTHubClient_RetryPolicy_CanAttempt shall return true and stop waiting when the delay has elapsed since the start of the wait, and false otherwise.]*/
+        if (currentTimeInMs - policy->waitStartInMs >= policy->delayInMs)
+        {
+            policy->isWaiting = false;
+            policy->isWaitStarted = false;
+            result = true;
+        }
+        else
+        {
+            result = false;
+        }
+    }
+    return result;
+}
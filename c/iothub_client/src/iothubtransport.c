@@ -11,12 +11,14 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <stddef.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iothubtransport.h"
 #include "iothub_client.h"
 #include "iothub_client_private.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/vector.h"
 
@@ -26,10 +28,18 @@ typedef struct TRANSPORT_HANDLE_DATA_TAG
     THREAD_HANDLE workerThreadHandle;
     LOCK_HANDLE lockHandle;
     sig_atomic_t stopThread;
+    COND_HANDLE workerCondition; /*created by IoTHubTransport_SetWorkerIdleWaitTime, signalled when there is new work for the worker thread*/
+    unsigned int workerIdleWaitTime; /*0 means the worker thread calls DoWork every 1 ms*/
 	TRANSPORT_PROVIDER_FIELDS;
 	VECTOR_HANDLE clients;
 } TRANSPORT_HANDLE_DATA;
 
+typedef struct TRANSPORT_POOL_DATA_TAG
+{
+	size_t transportCount;
+	TRANSPORT_HANDLE* transports;
+} TRANSPORT_POOL_DATA;
+
 /* Used for Unit test */
 const size_t IoTHubTransport_ThreadTerminationOffset = offsetof(TRANSPORT_HANDLE_DATA, stopThread);
 
@@ -60,6 +70,7 @@ TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoc
 			IOTHUB_CLIENT_CONFIG upperConfig;
 			upperConfig.deviceId = NULL;
 			upperConfig.deviceKey = NULL;
+			upperConfig.deviceSasToken = NULL;
 			upperConfig.iotHubName = iotHubName;
 			upperConfig.iotHubSuffix = iotHubSuffix;
 			upperConfig.protocol = protocol;
@@ -109,6 +120,8 @@ TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoc
 						/*Codes_SRS_IOTHUBTRANSPORT_17_001: [ IoTHubTransport_Create shall return a non-NULL handle on success.]*/
 						result->stopThread = 1;
 						result->workerThreadHandle = NULL; /* create thread when work needs to be done */
+						result->workerCondition = NULL; /* only needed when the worker thread waits for work */
+						result->workerIdleWaitTime = 0;
                         result->IoTHubTransport_GetHostname = transportProtocol->IoTHubTransport_GetHostname;
 						result->IoTHubTransport_SetOption = transportProtocol->IoTHubTransport_SetOption;
 						result->IoTHubTransport_Create = transportProtocol->IoTHubTransport_Create;
@@ -128,12 +141,43 @@ TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoc
 	return result;
 }
 
+static bool all_clients_are_idle(TRANSPORT_HANDLE_DATA* transportData)
+{
+	bool result = true;
+	size_t clientCount = VECTOR_size(transportData->clients);
+	size_t i;
+	for (i = 0; i < clientCount; i++)
+	{
+		IOTHUB_CLIENT_HANDLE* clientHandle = (IOTHUB_CLIENT_HANDLE*)VECTOR_element(transportData->clients, i);
+		IOTHUB_CLIENT_STATUS status;
+		if ((IoTHubClient_GetSendStatus_NoLock(*clientHandle, &status) != IOTHUB_CLIENT_OK) ||
+			(status != IOTHUB_CLIENT_SEND_STATUS_IDLE))
+		{
+			result = false;
+			break;
+		}
+	}
+	return result;
+}
+
+static void drain_clients_send_handoff(TRANSPORT_HANDLE_DATA* transportData)
+{
+	size_t clientCount = VECTOR_size(transportData->clients);
+	size_t i;
+	for (i = 0; i < clientCount; i++)
+	{
+		IOTHUB_CLIENT_HANDLE* clientHandle = (IOTHUB_CLIENT_HANDLE*)VECTOR_element(transportData->clients, i);
+		IoTHubClient_DrainSendHandoff_NoLock(*clientHandle);
+	}
+}
+
 static int transport_worker_thread(void* threadArgument)
 {
 	TRANSPORT_HANDLE_DATA* transportData = (TRANSPORT_HANDLE_DATA*)threadArgument;
 
 	while (1)
 	{
+		bool waitedForWork = false;
 		/*Codes_SRS_IOTHUBTRANSPORT_17_030: [ All calls to lower layer transport DoWork shall be protected by the lock created in IoTHubTransport_Create. ]*/
 		if (Lock(transportData->lockHandle) == LOCK_OK)
 		{
@@ -146,12 +190,31 @@ static int transport_worker_thread(void* threadArgument)
 			}
 			else
 			{
+				/*Codes_SRS_IOTHUBTRANSPORT_10_009: [ Before calling lower layer transport DoWork the thread shall call IoTHubClient_DrainSendHandoff_NoLock for every IoTHubClient using the thread. ]*/
+				drain_clients_send_handoff(transportData);
+
 				(transportData->IoTHubTransport_DoWork)(transportData->transportLLHandle, NULL);
+
+				/*Codes_SRS_IOTHUBTRANSPORT_10_007: [ If the worker idle wait time is not 0 and every IoTHubClient using the thread reports IOTHUB_CLIENT_SEND_STATUS_IDLE, the thread shall wait on the worker condition for at most the worker idle wait time instead of sleeping 1 ms. ]*/
+				if ((transportData->workerIdleWaitTime > 0) && all_clients_are_idle(transportData))
+				{
+					if (Condition_Wait(transportData->workerCondition, transportData->lockHandle, (int)transportData->workerIdleWaitTime) == COND_ERROR)
+					{
+						LogError("Condition_Wait failed");
+					}
+					else
+					{
+						waitedForWork = true;
+					}
+				}
 				(void)Unlock(transportData->lockHandle);
 			}
 		}
-		/*Codes_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]*/
-		ThreadAPI_Sleep(1);
+		if (!waitedForWork)
+		{
+			/*Codes_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]*/
+			ThreadAPI_Sleep(1);
+		}
 	}
 
 	return 0;
@@ -210,6 +273,11 @@ static void stop_worker_thread(TRANSPORT_HANDLE_DATA * transportData)
 {
 	/*Codes_SRS_IOTHUBTRANSPORT_17_043: [** IoTHubTransport_SignalEndWorkerThread shall signal the worker thread to end.*/
 	transportData->stopThread = 1;
+	/*Codes_SRS_IOTHUBTRANSPORT_10_008: [ If the worker thread might be waiting on the worker condition, it shall be woken up by calling Condition_Post. ]*/
+	if (transportData->workerCondition != NULL)
+	{
+		(void)Condition_Post(transportData->workerCondition);
+	}
 }
 
 static void wait_worker_thread(TRANSPORT_HANDLE_DATA * transportData)
@@ -277,6 +345,10 @@ void IoTHubTransport_Destroy(TRANSPORT_HANDLE transportHandle)
 		}
 		wait_worker_thread(transportData);
 		/*Codes_SRS_IOTHUBTRANSPORT_17_010: [ IoTHubTransport_Destroy shall free all resources. ]*/
+		if (transportData->workerCondition != NULL)
+		{
+			Condition_Deinit(transportData->workerCondition);
+		}
 		Lock_Deinit(transportData->lockHandle);
 		(transportData->IoTHubTransport_Destroy)(transportData->transportLLHandle);
 		VECTOR_destroy(transportData->clients);
@@ -373,3 +445,171 @@ void IoTHubTransport_JoinWorkerThread(TRANSPORT_HANDLE transportHandle, IOTHUB_C
 		wait_worker_thread(transportData);
 	}
 }
+
+IOTHUB_CLIENT_RESULT IoTHubTransport_SetWorkerIdleWaitTime(TRANSPORT_HANDLE transportHandle, unsigned int idleWaitTime)
+{
+	IOTHUB_CLIENT_RESULT result;
+	if (transportHandle == NULL)
+	{
+		/*Codes_SRS_IOTHUBTRANSPORT_10_001: [ If transportHandle is NULL, IoTHubTransport_SetWorkerIdleWaitTime shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+		LogError("invalid arg TRANSPORT_HANDLE transportHandle=NULL");
+		result = IOTHUB_CLIENT_INVALID_ARG;
+	}
+	else
+	{
+		TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
+		/*Codes_SRS_IOTHUBTRANSPORT_10_002: [ IoTHubTransport_SetWorkerIdleWaitTime shall create the worker condition by calling Condition_Init if it was not created before and idleWaitTime is not 0. ]*/
+		if ((idleWaitTime > 0) && (transportData->workerCondition == NULL) &&
+			((transportData->workerCondition = Condition_Init()) == NULL))
+		{
+			/*Codes_SRS_IOTHUBTRANSPORT_10_003: [ If Condition_Init fails, IoTHubTransport_SetWorkerIdleWaitTime shall return IOTHUB_CLIENT_ERROR and leave the worker idle wait time unchanged. ]*/
+			LogError("unable to Condition_Init");
+			result = IOTHUB_CLIENT_ERROR;
+		}
+		else
+		{
+			/*Codes_SRS_IOTHUBTRANSPORT_10_004: [ IoTHubTransport_SetWorkerIdleWaitTime shall store idleWaitTime, wake up the worker thread so that it picks up the new value and return IOTHUB_CLIENT_OK. ]*/
+			transportData->workerIdleWaitTime = idleWaitTime;
+			IoTHubTransport_SignalWorkerThread(transportHandle);
+			result = IOTHUB_CLIENT_OK;
+		}
+	}
+	return result;
+}
+
+void IoTHubTransport_SignalWorkerThread(TRANSPORT_HANDLE transportHandle)
+{
+	/*Codes_SRS_IOTHUBTRANSPORT_10_005: [ If transportHandle is NULL, IoTHubTransport_SignalWorkerThread shall do nothing. ]*/
+	if (transportHandle != NULL)
+	{
+		TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
+		/*Codes_SRS_IOTHUBTRANSPORT_10_006: [ IoTHubTransport_SignalWorkerThread shall call Condition_Post on the worker condition, if it exists. ]*/
+		if ((transportData->workerCondition != NULL) &&
+			(Condition_Post(transportData->workerCondition) != COND_OK))
+		{
+			LogError("unable to Condition_Post");
+		}
+	}
+}
+
+TRANSPORT_POOL_HANDLE IoTHubTransport_CreatePool(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix, size_t transportCount)
+{
+	TRANSPORT_POOL_DATA* result;
+	/*Codes_SRS_IOTHUBTRANSPORT_10_010: [ If protocol, iotHubName or iotHubSuffix is NULL, or transportCount is 0, IoTHubTransport_CreatePool shall return NULL. ]*/
+	if (protocol == NULL || iotHubName == NULL || iotHubSuffix == NULL || transportCount == 0)
+	{
+		LogError("Invalid argument, protocol [%p], name [%p], suffix [%p], transportCount [%zu].", protocol, iotHubName, iotHubSuffix, transportCount);
+		result = NULL;
+	}
+	else
+	{
+		/*Codes_SRS_IOTHUBTRANSPORT_10_011: [ IoTHubTransport_CreatePool shall allocate memory for the pool and for transportCount transport handles. ]*/
+		result = (TRANSPORT_POOL_DATA*)malloc(sizeof(TRANSPORT_POOL_DATA));
+		if (result == NULL)
+		{
+			/*Codes_SRS_IOTHUBTRANSPORT_10_012: [ If memory allocation fails, IoTHubTransport_CreatePool shall return NULL. ]*/
+			LogError("Transport pool was not allocated.");
+		}
+		else if ((transportCount > SIZE_MAX / sizeof(TRANSPORT_HANDLE)) ||
+			((result->transports = (TRANSPORT_HANDLE*)malloc(transportCount * sizeof(TRANSPORT_HANDLE))) == NULL))
+		{
+			/*Codes_SRS_IOTHUBTRANSPORT_10_012: [ If memory allocation fails, IoTHubTransport_CreatePool shall return NULL. ]*/
+			LogError("Transport pool handles were not allocated.");
+			free(result);
+			result = NULL;
+		}
+		else
+		{
+			/*Codes_SRS_IOTHUBTRANSPORT_10_013: [ IoTHubTransport_CreatePool shall create transportCount transports by calling IoTHubTransport_Create, so that every transport has its own lower layer transport, lock and worker thread. ]*/
+			for (result->transportCount = 0; result->transportCount < transportCount; result->transportCount++)
+			{
+				if ((result->transports[result->transportCount] = IoTHubTransport_Create(protocol, iotHubName, iotHubSuffix)) == NULL)
+				{
+					break;
+				}
+			}
+
+			if (result->transportCount < transportCount)
+			{
+				/*Codes_SRS_IOTHUBTRANSPORT_10_014: [ If any IoTHubTransport_Create fails, IoTHubTransport_CreatePool shall destroy the transports it created, free the pool and return NULL. ]*/
+				LogError("transport %zu of %zu not created.", result->transportCount, transportCount);
+				IoTHubTransport_DestroyPool(result);
+				result = NULL;
+			}
+			else
+			{
+				/*Codes_SRS_IOTHUBTRANSPORT_10_015: [ IoTHubTransport_CreatePool shall return a non-NULL handle on success. ]*/
+			}
+		}
+	}
+	return result;
+}
+
+void IoTHubTransport_DestroyPool(TRANSPORT_POOL_HANDLE poolHandle)
+{
+	/*Codes_SRS_IOTHUBTRANSPORT_10_016: [ If poolHandle is NULL, IoTHubTransport_DestroyPool shall do nothing. ]*/
+	if (poolHandle != NULL)
+	{
+		size_t i;
+		/*Codes_SRS_IOTHUBTRANSPORT_10_017: [ IoTHubTransport_DestroyPool shall call IoTHubTransport_Destroy for every transport of the pool and free the pool. ]*/
+		for (i = 0; i < poolHandle->transportCount; i++)
+		{
+			IoTHubTransport_Destroy(poolHandle->transports[i]);
+		}
+		free(poolHandle->transports);
+		free(poolHandle);
+	}
+}
+
+static uint32_t hash_device_id(const char* deviceId)
+{
+	/*FNV-1a*/
+	uint32_t hash = 2166136261u;
+	while (*deviceId != '\0')
+	{
+		hash ^= (uint8_t)*deviceId++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static uint32_t pool_transport_weight(uint32_t deviceHash, size_t transportIndex)
+{
+	/*murmur3 finalizer over the device hash salted with the transport index*/
+	uint32_t weight = deviceHash ^ ((uint32_t)transportIndex * 0x9E3779B9u);
+	weight ^= weight >> 16;
+	weight *= 0x85EBCA6Bu;
+	weight ^= weight >> 13;
+	weight *= 0xC2B2AE35u;
+	weight ^= weight >> 16;
+	return weight;
+}
+
+TRANSPORT_HANDLE IoTHubTransport_GetPoolTransport(TRANSPORT_POOL_HANDLE poolHandle, const char* deviceId)
+{
+	TRANSPORT_HANDLE result;
+	/*Codes_SRS_IOTHUBTRANSPORT_10_018: [ If poolHandle or deviceId is NULL, IoTHubTransport_GetPoolTransport shall return NULL. ]*/
+	if (poolHandle == NULL || deviceId == NULL)
+	{
+		LogError("Invalid NULL argument, poolHandle [%p], deviceId [%p].", poolHandle, deviceId);
+		result = NULL;
+	}
+	else
+	{
+		/*Codes_SRS_IOTHUBTRANSPORT_10_019: [ IoTHubTransport_GetPoolTransport shall return the transport of the pool with the highest weight computed from deviceId and the transport index (rendezvous hashing), so that a device id always maps to the same transport of a pool and devices spread evenly over the transports. ]*/
+		uint32_t deviceHash = hash_device_id(deviceId);
+		uint32_t bestWeight = pool_transport_weight(deviceHash, 0);
+		size_t i;
+		result = poolHandle->transports[0];
+		for (i = 1; i < poolHandle->transportCount; i++)
+		{
+			uint32_t weight = pool_transport_weight(deviceHash, i);
+			if (weight > bestWeight)
+			{
+				bestWeight = weight;
+				result = poolHandle->transports[i];
+			}
+		}
+	}
+	return result;
+}
@@ -17,6 +17,7 @@
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/urlencode.h"
 #include "azure_c_shared_utility/tlsio.h"
+#include "azure_c_shared_utility/tickcounter.h"
 
 #include "azure_uamqp_c/cbs.h"
 #include "azure_uamqp_c/link.h"
@@ -32,6 +33,7 @@
 #include "iothub_client_ll.h"
 #include "iothub_client_options.h"
 #include "iothub_client_private.h"
+#include "iothub_client_retry_policy.h"
 #include "iothubtransportamqp.h"
 #include "iothub_client_version.h"
 
@@ -55,6 +57,12 @@
 #define MESSAGE_SENDER_LINK_NAME "sender-link"
 #define MESSAGE_SENDER_SOURCE_ADDRESS "ingress"
 #define MESSAGE_SENDER_MAX_LINK_SIZE UINT64_MAX
+#define AMQP_BATCHING_FORMAT_CODE 0x80013700
+#define AMQP_BATCHING_DEFAULT_MAX_SIZE (256 * 1024)
+#define AMQP_BATCHING_SECTION_OVERHEAD 8
+#define AMQP_BATCHING_RESERVED_SIZE 64
+#define AMQP_ADAPTIVE_REFERENCE_RTT_MS 100
+#define AMQP_ADAPTIVE_MAX_SCALE 64
 
 typedef XIO_HANDLE(*TLS_IO_TRANSPORT_PROVIDER)(const char* fqdn, int port);
 
@@ -122,6 +130,17 @@ typedef struct AMQP_TRANSPORT_STATE_CBS_TAG
     size_t current_sas_token_create_time;
 }AMQP_TRANSPORT_STATE_CBS;
 
+/*the message (event or batch) whose round-trip time is being measured, sent with on_rtt_probe_send_complete*/
+typedef struct AMQP_RTT_PROBE_TAG
+{
+    // Callback and context the message would have been sent with.
+    ON_MESSAGE_SEND_COMPLETE on_send_complete;
+    void* context;
+    // Time messagesender_send() was called, in milliseconds.
+    uint64_t send_time;
+    bool in_flight;
+}AMQP_RTT_PROBE;
+
 typedef struct AMQP_TRANSPORT_STATE_TAG
 {
     // FQDN of the IoT Hub.
@@ -155,6 +174,8 @@ typedef struct AMQP_TRANSPORT_STATE_TAG
     AMQP_MANAGEMENT_STATE connection_state;
     // Last time the AMQP connection establishment was initiated.
     size_t connection_establish_time;
+    // Paces the attempts to establish the connection again after it failed.
+    IOTHUB_CLIENT_RETRY_POLICY retry_policy;
     // AMQP session.
     SESSION_HANDLE session;
     // AMQP link used by the event sender.
@@ -179,6 +200,24 @@ typedef struct AMQP_TRANSPORT_STATE_TAG
     bool isRegistered;
     // Turns logging on and off
     bool is_trace_on;
+#ifndef DONT_USE_AMQP_BATCHING
+    // Packs the pending events into AMQP batch messages, each confirmed by a single disposition.
+    bool batching;
+#endif
+
+    // AMQP session windows, in transfer frames.
+    uint32_t incoming_window;
+    uint32_t outgoing_window;
+    // Max message size and credit (0 for the uAMQP default) of the message receiver link.
+    uint64_t receiver_max_message_size;
+    uint32_t receiver_link_credit;
+    // Scales the windows and the receiver credit with the measured round-trip time.
+    bool adaptive_windows;
+    // Only created when adaptive_windows is turned on.
+    TICK_COUNTER_HANDLE tick_counter;
+    AMQP_RTT_PROBE rtt_probe;
+    // Smoothed round-trip time of the events, in milliseconds; 0 until the first one is measured.
+    uint64_t smoothed_rtt;
 
     /*here are the options from the xio layer if any is saved*/
     OPTIONHANDLER_HANDLE xioOptions;
@@ -234,6 +273,8 @@ static void trackEventInProgress(IOTHUB_MESSAGE_LIST* message, AMQP_TRANSPORT_IN
 {
     DList_RemoveEntryList(&message->entry);
     DList_InsertTailList(&transport_state->inProgress, &message->entry);
+    // Codes_SRS_IOTHUBTRANSPORTAMQP_10_020: [IoTHubTransportAMQP_DoWork shall suspend the timeout of an event it moves to the in-progress list using IoTHubClient_LL_SuspendMessageTimeout(), and resume it using IoTHubClient_LL_ResumeMessageTimeout() when the event is rolled back to waitToSend.]
+    IoTHubClient_LL_SuspendMessageTimeout(message);
 }
 
 static IOTHUB_MESSAGE_LIST* getNextEventToSend(AMQP_TRANSPORT_INSTANCE* transport_state)
@@ -268,6 +309,7 @@ static void rollEventBackToWaitList(IOTHUB_MESSAGE_LIST* message, AMQP_TRANSPORT
 {
     removeEventFromInProgressList(message);
     DList_InsertTailList(transport_state->waitingToSend, &message->entry);
+    IoTHubClient_LL_ResumeMessageTimeout(message);
 }
 
 static void rollEventsBackToWaitList(AMQP_TRANSPORT_INSTANCE* transport_state)
@@ -286,7 +328,7 @@ static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_res
 {
     IOTHUB_MESSAGE_LIST* message = (IOTHUB_MESSAGE_LIST*)context;
 
-    IOTHUB_CLIENT_RESULT iot_hub_send_result;
+    IOTHUB_CLIENT_CONFIRMATION_RESULT iot_hub_send_result;
 
     // Codes_SRS_IOTHUBTRANSPORTAMQP_09_142: [The callback 'on_message_send_complete' shall pass to the upper layer callback an IOTHUB_CLIENT_CONFIRMATION_OK if the result received is MESSAGE_SEND_OK] 
     if (send_result == MESSAGE_SEND_OK)
@@ -314,8 +356,119 @@ static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_res
     // Codes_SRS_IOTHUBTRANSPORTAMQP_09_151: [The callback 'on_message_send_complete' shall destroy the message handle (IOTHUB_MESSAGE_HANDLE) using IoTHubMessage_Destroy()]
     IoTHubMessage_Destroy(message->messageHandle);
 
-    // Codes_SRS_IOTHUBTRANSPORTAMQP_09_152: [The callback 'on_message_send_complete' shall destroy the IOTHUB_MESSAGE_LIST instance]
-    free(message);
+    // Codes_SRS_IOTHUBTRANSPORTAMQP_10_001: [The callback 'on_message_send_complete' shall stop the message timeout and send queue tracking of the IOTHUB_MESSAGE_LIST instance and count its result in the statistics using IoTHubClient_LL_UntrackCompletedMessage()]
+    IoTHubClient_LL_UntrackCompletedMessage(message, iot_hub_send_result);
+
+    // Codes_SRS_IOTHUBTRANSPORTAMQP_09_152: [The callback 'on_message_send_complete' shall destroy the IOTHUB_MESSAGE_LIST instance using IoTHubClient_LL_ReleaseMessageList()]
+    IoTHubClient_LL_ReleaseMessageList(message);
+}
+
+/*how many times the configured windows are grown, 1 unless the adaptive mode measured a round-trip time above the reference one*/
+static uint64_t getWindowScale(AMQP_TRANSPORT_INSTANCE* transport_state)
+{
+    uint64_t result;
+
+    // Codes_SRS_IOTHUBTRANSPORTAMQP_10_018: [In adaptive mode, the session windows and the receiver link credit shall be the configured values scaled by the smoothed round-trip time over 100 milliseconds, rounded up, never scaled down and scaled up 64 times at most, and saturated at UINT32_MAX.]
+    if (!transport_state->adaptive_windows || (transport_state->smoothed_rtt <= AMQP_ADAPTIVE_REFERENCE_RTT_MS))
+    {
+        result = 1;
+    }
+    else
+    {
+        result = (transport_state->smoothed_rtt + AMQP_ADAPTIVE_REFERENCE_RTT_MS - 1) / AMQP_ADAPTIVE_REFERENCE_RTT_MS;
+        if (result > AMQP_ADAPTIVE_MAX_SCALE)
+        {
+            result = AMQP_ADAPTIVE_MAX_SCALE;
+        }
+    }
+
+    return result;
+}
+
+static uint32_t getAdaptedWindow(AMQP_TRANSPORT_INSTANCE* transport_state, uint32_t configured_window)
+{
+    uint64_t window = (uint64_t)configured_window * getWindowScale(transport_state);
+    return (window > UINT32_MAX) ? UINT32_MAX : (uint32_t)window;
+}
+
+/*applies the windows and the receiver credit to the current session and receiver link, if any*/
+static void applyWindows(AMQP_TRANSPORT_INSTANCE* transport_state)
+{
+    if (transport_state->session != NULL)
+    {
+        if (session_set_incoming_window(transport_state->session, getAdaptedWindow(transport_state, transport_state->incoming_window)) != 0)
+        {
+            LogError("Failed to set the AMQP incoming window size.");
+        }
+
+        if (session_set_outgoing_window(transport_state->session, getAdaptedWindow(transport_state, transport_state->outgoing_window)) != 0)
+        {
+            LogError("Failed to set the AMQP outgoing window size.");
+        }
+    }
+
+#ifndef DONT_USE_AMQP_LINK_CREDIT
+    if ((transport_state->receiver_link != NULL) && (transport_state->receiver_link_credit != 0))
+    {
+        if (link_set_max_link_credit(transport_state->receiver_link, getAdaptedWindow(transport_state, transport_state->receiver_link_credit)) != 0)
+        {
+            LogError("Failed to set the AMQP link credit of the message receiver.");
+        }
+    }
+#endif
+}
+
+static void on_rtt_probe_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+    AMQP_TRANSPORT_INSTANCE* transport_state = (AMQP_TRANSPORT_INSTANCE*)context;
+    ON_MESSAGE_SEND_COMPLETE on_send_complete = transport_state->rtt_probe.on_send_complete;
+    void* send_complete_context = transport_state->rtt_probe.context;
+    uint64_t current_time;
+
+    transport_state->rtt_probe.in_flight = false;
+
+    // Codes_SRS_IOTHUBTRANSPORTAMQP_10_017: [In adaptive mode, IoTHubTransportAMQP_DoWork shall time one event (or batch) at a time, from its messagesender_send() to its successful disposition, with tickcounter_get_current_ms(), and keep a smoothed round-trip time of 7/8 of the previous value plus 1/8 of the sample, starting at the first sample.]
+    if ((send_result == MESSAGE_SEND_OK) &&
+        (tickcounter_get_current_ms(transport_state->tick_counter, &current_time) == 0))
+    {
+        uint64_t sample = current_time - transport_state->rtt_probe.send_time;
+        uint64_t previous_rtt = transport_state->smoothed_rtt;
+        uint64_t previous_scale = getWindowScale(transport_state);
+
+        transport_state->smoothed_rtt = (previous_rtt == 0) ? sample : ((7 * previous_rtt) + sample) / 8;
+
+        if (getWindowScale(transport_state) != previous_scale)
+        {
+            applyWindows(transport_state);
+        }
+    }
+
+    on_send_complete(send_complete_context, send_result);
+}
+
+/*sends the message through the event sender, as the round-trip time probe if one is due*/
+static int sendAmqpMessage(AMQP_TRANSPORT_INSTANCE* transport_state, MESSAGE_HANDLE message, ON_MESSAGE_SEND_COMPLETE on_send_complete, void* context)
+{
+    int result;
+
+    if (transport_state->adaptive_windows && !transport_state->rtt_probe.in_flight &&
+        (tickcounter_get_current_ms(transport_state->tick_counter, &transport_state->rtt_probe.send_time) == 0))
+    {
+        transport_state->rtt_probe.on_send_complete = on_send_complete;
+        transport_state->rtt_probe.context = context;
+        transport_state->rtt_probe.in_flight = true;
+
+        if ((result = messagesender_send(transport_state->message_sender, message, on_rtt_probe_send_complete, transport_state)) != RESULT_OK)
+        {
+            transport_state->rtt_probe.in_flight = false;
+        }
+    }
+    else
+    {
+        result = messagesender_send(transport_state->message_sender, message, on_send_complete, context);
+    }
+
+    return result;
 }
 
 static void on_put_token_complete(void* context, CBS_OPERATION_RESULT operation_result, unsigned int status_code, const char* status_description)
@@ -537,16 +690,8 @@ static int establishConnection(AMQP_TRANSPORT_INSTANCE* transport_state)
                     else
                     {
                         // Codes_SRS_IOTHUBTRANSPORTAMQP_09_065: [IoTHubTransportAMQP_DoWork shall apply a default value of UINT_MAX for the parameter 'AMQP incoming window'] 
-                        if (session_set_incoming_window(transport_state->session, (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE) != 0)
-                        {
-                            LogError("Failed to set the AMQP incoming window size.");
-                        }
-
                         // Codes_SRS_IOTHUBTRANSPORTAMQP_09_115: [IoTHubTransportAMQP_DoWork shall apply a default value of 100 for the parameter 'AMQP outgoing window'] 
-                        if (session_set_outgoing_window(transport_state->session, DEFAULT_OUTGOING_WINDOW_SIZE) != 0)
-                        {
-                            LogError("Failed to set the AMQP outgoing window size.");
-                        }
+                        applyWindows(transport_state);
 
                         // Codes_SRS_IOTHUBTRANSPORTAMQP_09_066: [IoTHubTransportAMQP_DoWork shall establish the CBS connection using the cbs_create() AMQP API] 
                         if ((transport_state->cbs.cbs = cbs_create(transport_state->session, on_amqp_management_state_changed, NULL)) == NULL)
@@ -600,16 +745,8 @@ static int establishConnection(AMQP_TRANSPORT_INSTANCE* transport_state)
                     else
                     {
                         // Codes_SRS_IOTHUBTRANSPORTAMQP_09_065: [IoTHubTransportAMQP_DoWork shall apply a default value of UINT_MAX for the parameter 'AMQP incoming window'] 
-                        if (session_set_incoming_window(transport_state->session, (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE) != 0)
-                        {
-                            LogError("Failed to set the AMQP incoming window size.");
-                        }
-
                         // Codes_SRS_IOTHUBTRANSPORTAMQP_09_115: [IoTHubTransportAMQP_DoWork shall apply a default value of 100 for the parameter 'AMQP outgoing window'] 
-                        if (session_set_outgoing_window(transport_state->session, DEFAULT_OUTGOING_WINDOW_SIZE) != 0)
-                        {
-                            LogError("Failed to set the AMQP outgoing window size.");
-                        }
+                        applyWindows(transport_state);
 
 						if (getSecondsSinceEpoch(&transport_state->connection_establish_time) != RESULT_OK)
 						{
@@ -816,6 +953,8 @@ static void destroyEventSender(AMQP_TRANSPORT_INSTANCE* transport_state)
     {
         messagesender_destroy(transport_state->message_sender);
         transport_state->message_sender = NULL;
+        /*a probe still pending went with the sender, the next event sent can be timed*/
+        transport_state->rtt_probe.in_flight = false;
 
         link_destroy(transport_state->sender_link);
         transport_state->sender_link = NULL;
@@ -838,6 +977,11 @@ void on_event_sender_state_changed(void* context, MESSAGE_SENDER_STATE new_state
         {
             transport_state->connection_state = AMQP_MANAGEMENT_STATE_ERROR;
         }
+        // Codes_SRS_IOTHUBTRANSPORTAMQP_10_005: [When the message sender changes its state to MESSAGE_SENDER_STATE_OPEN the success shall be reported to the retry policy with IoTHubClient_RetryPolicy_OnSuccess.]
+        else if (new_state != previous_state && new_state == MESSAGE_SENDER_STATE_OPEN)
+        {
+            IoTHubClient_RetryPolicy_OnSuccess(&transport_state->retry_policy);
+        }
     }
 }
 
@@ -981,11 +1125,21 @@ static int createMessageReceiver(AMQP_TRANSPORT_INSTANCE* transport_state, IOTHU
         else
         {
             // Codes_SRS_IOTHUBTRANSPORTAMQP_09_119: [IoTHubTransportAMQP_DoWork shall apply a default value of 65536 for the parameter 'Link MAX message size']
-            if (link_set_max_message_size(transport_state->receiver_link, MESSAGE_RECEIVER_MAX_LINK_SIZE) != RESULT_OK)
+            // Codes_SRS_IOTHUBTRANSPORTAMQP_10_014: [IotHubTransportAMQP_SetOption shall save the value if the option name is "amqp_receiver_max_message_size" (size_t, above 0), returning IOTHUB_CLIENT_OK; the value shall be set with link_set_max_message_size() on the message receiver links created afterwards.]
+            if (link_set_max_message_size(transport_state->receiver_link, transport_state->receiver_max_message_size) != RESULT_OK)
             {
                 LogError("Failed setting AMQP link max message size for message receiver.");
             }
 
+            // Codes_SRS_IOTHUBTRANSPORTAMQP_10_015: [IotHubTransportAMQP_SetOption shall save the value if the option name is "amqp_receiver_link_credit" (size_t, up to UINT32_MAX), returning IOTHUB_CLIENT_OK, and set it with link_set_max_link_credit() on the current message receiver link, if any, and on the ones created afterwards; 0, the default, keeps the uAMQP link credit.]
+#ifndef DONT_USE_AMQP_LINK_CREDIT
+            if ((transport_state->receiver_link_credit != 0) &&
+                (link_set_max_link_credit(transport_state->receiver_link, getAdaptedWindow(transport_state, transport_state->receiver_link_credit)) != RESULT_OK))
+            {
+                LogError("Failed setting AMQP link credit for message receiver.");
+            }
+#endif
+
             attachDeviceClientTypeToLink(transport_state->receiver_link);
 
             // Codes_SRS_IOTHUBTRANSPORTAMQP_09_077: [IoTHubTransportAMQP_DoWork shall create the AMQP message receiver using messagereceiver_create() AMQP API] 
@@ -1043,7 +1197,7 @@ static int sendPendingEvents(AMQP_TRANSPORT_INSTANCE* transport_state)
 			is_message_error = true;
 		}
 		// Codes_SRS_IOTHUBTRANSPORTAMQP_09_097: [IoTHubTransportAMQP_DoWork shall pass the MESSAGE_HANDLE intance to uAMQP for sending (along with on_message_send_complete callback) using messagesender_send()] 
-		else if (messagesender_send(transport_state->message_sender, amqp_message, on_message_send_complete, message) != RESULT_OK)
+		else if (sendAmqpMessage(transport_state, amqp_message, on_message_send_complete, message) != RESULT_OK)
         {
             LogError("Failed sending the AMQP message.");
 			result = __LINE__;
@@ -1082,6 +1236,216 @@ static int sendPendingEvents(AMQP_TRANSPORT_INSTANCE* transport_state)
     return result;
 }
 
+#ifndef DONT_USE_AMQP_BATCHING
+/*the events of one AMQP batch message, completed together by its single disposition*/
+typedef struct AMQP_EVENT_BATCH_TAG
+{
+    IOTHUB_MESSAGE_LIST** events;
+    size_t count;
+    size_t capacity;
+} AMQP_EVENT_BATCH;
+
+static void freeEventBatch(AMQP_EVENT_BATCH* batch)
+{
+    free(batch->events);
+    free(batch);
+}
+
+static void on_event_batch_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+    AMQP_EVENT_BATCH* batch = (AMQP_EVENT_BATCH*)context;
+    size_t i;
+
+    // Codes_SRS_IOTHUBTRANSPORTAMQP_10_010: [The disposition of a batch message shall complete every event of the batch, in the order they were packed, as 'on_message_send_complete' does for a single event.]
+    for (i = 0; i < batch->count; i++)
+    {
+        on_message_send_complete(batch->events[i], send_result);
+    }
+    freeEventBatch(batch);
+}
+
+/*puts the events of the batch back at the head of waitToSend, in their order, and frees the batch*/
+static void rollEventBatchBackToWaitList(AMQP_EVENT_BATCH* batch, AMQP_TRANSPORT_INSTANCE* transport_state)
+{
+    size_t i;
+    for (i = batch->count; i > 0; i--)
+    {
+        removeEventFromInProgressList(batch->events[i - 1]);
+        DList_InsertHeadList(transport_state->waitingToSend, &batch->events[i - 1]->entry);
+        IoTHubClient_LL_ResumeMessageTimeout(batch->events[i - 1]);
+    }
+    freeEventBatch(batch);
+}
+
+static uint64_t getEventBatchMaxSize(AMQP_TRANSPORT_INSTANCE* transport_state)
+{
+    uint64_t result;
+    // Codes_SRS_IOTHUBTRANSPORTAMQP_10_009: [The encoded events of a batch, each in a data section, shall not add up to more than the max message size of the peer of the event sender link, obtained with link_get_peer_max_message_size(), or 256 KB if it cannot be obtained or is unlimited; a batch shall hold at least one event.]
+    if ((link_get_peer_max_message_size(transport_state->sender_link, &result) != 0) ||
+        (result == 0))
+    {
+        result = AMQP_BATCHING_DEFAULT_MAX_SIZE;
+    }
+    return result;
+}
+
+static int addEventToBatch(AMQP_EVENT_BATCH* batch, IOTHUB_MESSAGE_LIST* message)
+{
+    int result;
+    if (batch->count == batch->capacity)
+    {
+        size_t new_capacity = (batch->capacity == 0) ? 16 : batch->capacity * 2;
+        IOTHUB_MESSAGE_LIST** new_events = (IOTHUB_MESSAGE_LIST**)realloc(batch->events, new_capacity * sizeof(IOTHUB_MESSAGE_LIST*));
+        if (new_events == NULL)
+        {
+            LogError("Failed growing the event batch.");
+            result = __LINE__;
+        }
+        else
+        {
+            batch->events = new_events;
+            batch->capacity = new_capacity;
+            result = RESULT_OK;
+        }
+    }
+    else
+    {
+        result = RESULT_OK;
+    }
+
+    if (result == RESULT_OK)
+    {
+        batch->events[batch->count++] = message;
+    }
+    return result;
+}
+
+/*packs the events at the head of waitToSend into one AMQP batch message and sends it*/
+static int sendEventBatch(AMQP_TRANSPORT_INSTANCE* transport_state)
+{
+    int result;
+    AMQP_EVENT_BATCH* batch;
+    MESSAGE_HANDLE batch_message;
+
+    if ((batch = (AMQP_EVENT_BATCH*)malloc(sizeof(AMQP_EVENT_BATCH))) == NULL)
+    {
+        LogError("Failed allocating the event batch.");
+        result = __LINE__;
+    }
+    // Codes_SRS_IOTHUBTRANSPORTAMQP_10_008: [When "Batching" is on, IoTHubTransportAMQP_DoWork shall pack the pending events into uAMQP messages created with message_create() and set to the batch message format 0x80013700 with message_set_message_format(), adding every event as a data section (message_add_body_amqp_data()) holding its encoding from message_create_uamqp_encoding_from_iothub_message(), and send each batch message with messagesender_send().]
+    else if ((batch_message = message_create()) == NULL)
+    {
+        LogError("Failed creating the AMQP batch message.");
+        free(batch);
+        result = __LINE__;
+    }
+    else if (message_set_message_format(batch_message, AMQP_BATCHING_FORMAT_CODE) != 0)
+    {
+        LogError("Failed setting the format of the AMQP batch message.");
+        message_destroy(batch_message);
+        free(batch);
+        result = __LINE__;
+    }
+    else
+    {
+        uint64_t max_size = getEventBatchMaxSize(transport_state);
+        uint64_t size = AMQP_BATCHING_RESERVED_SIZE; /*the batch message itself, around its data sections*/
+        IOTHUB_MESSAGE_LIST* message;
+
+        batch->events = NULL;
+        batch->count = 0;
+        batch->capacity = 0;
+        result = RESULT_OK;
+
+        while ((result == RESULT_OK) && ((message = getNextEventToSend(transport_state)) != NULL))
+        {
+            BINARY_DATA encoded;
+
+            // Codes_SRS_IOTHUBTRANSPORTAMQP_10_011: [An event that message_create_uamqp_encoding_from_iothub_message() fails to encode shall be completed alone with IOTHUB_CLIENT_CONFIRMATION_ERROR and left out of the batch.]
+            if (message_create_uamqp_encoding_from_iothub_message(message->messageHandle, &encoded) != RESULT_OK)
+            {
+                LogError("Failed encoding an event of the AMQP batch message.");
+                trackEventInProgress(message, transport_state);
+                on_message_send_complete(message, MESSAGE_SEND_ERROR);
+            }
+            else
+            {
+                if ((batch->count > 0) && (size + encoded.length + AMQP_BATCHING_SECTION_OVERHEAD > max_size))
+                {
+                    /*the event is encoded again for the next batch*/
+                    free((void*)encoded.bytes);
+                    break;
+                }
+
+                if (message_add_body_amqp_data(batch_message, encoded) != RESULT_OK)
+                {
+                    LogError("Failed adding an event to the AMQP batch message.");
+                    result = __LINE__;
+                }
+                else if (addEventToBatch(batch, message) != RESULT_OK)
+                {
+                    result = __LINE__;
+                }
+                else
+                {
+                    // Codes_SRS_IOTHUBTRANSPORTAMQP_09_086: [IoTHubTransportAMQP_DoWork shall move queued events to an "in-progress" list right before processing them for sending]
+                    trackEventInProgress(message, transport_state);
+                    size += encoded.length + AMQP_BATCHING_SECTION_OVERHEAD;
+                }
+                free((void*)encoded.bytes);
+            }
+        }
+
+        if (result != RESULT_OK)
+        {
+            // Codes_SRS_IOTHUBTRANSPORTAMQP_10_012: [If message_add_body_amqp_data() or messagesender_send() fails, the events of the batch shall be rolled back to the head of waitToSend, in their order, and IoTHubTransportAMQP_DoWork shall return.]
+            rollEventBatchBackToWaitList(batch, transport_state);
+        }
+        else if (batch->count == 0)
+        {
+            freeEventBatch(batch);
+        }
+        else if (sendAmqpMessage(transport_state, batch_message, on_event_batch_send_complete, batch) != RESULT_OK)
+        {
+            LogError("Failed sending the AMQP batch message.");
+            rollEventBatchBackToWaitList(batch, transport_state);
+            result = __LINE__;
+        }
+
+        // It can be destroyed because AMQP keeps a clone of the message.
+        message_destroy(batch_message);
+    }
+
+    return result;
+}
+
+static int sendPendingEventsInBatches(AMQP_TRANSPORT_INSTANCE* transport_state)
+{
+    int result = RESULT_OK;
+    while ((result == RESULT_OK) && (getNextEventToSend(transport_state) != NULL))
+    {
+        result = sendEventBatch(transport_state);
+    }
+    return result;
+}
+#endif /*DONT_USE_AMQP_BATCHING*/
+
+static int sendWaitingEvents(AMQP_TRANSPORT_INSTANCE* transport_state)
+{
+    int result;
+#ifndef DONT_USE_AMQP_BATCHING
+    if (transport_state->batching)
+    {
+        result = sendPendingEventsInBatches(transport_state);
+    }
+    else
+#endif
+    {
+        result = sendPendingEvents(transport_state);
+    }
+    return result;
+}
+
 static bool isSasTokenRefreshRequired(AMQP_TRANSPORT_INSTANCE* transport_state)
 {
 	bool result;
@@ -1105,6 +1469,8 @@ static bool isSasTokenRefreshRequired(AMQP_TRANSPORT_INSTANCE* transport_state)
 
 static void prepareForConnectionRetry(AMQP_TRANSPORT_INSTANCE* transport_state)
 {
+    // Codes_SRS_IOTHUBTRANSPORTAMQP_10_004: [Every time the connection is flagged to be re-established, IoTHubTransportAMQP_DoWork shall report the failure to the retry policy with IoTHubClient_RetryPolicy_OnFailure.]
+    IoTHubClient_RetryPolicy_OnFailure(&transport_state->retry_policy);
     destroyMessageReceiver(transport_state);
     destroyEventSender(transport_state);
     destroyConnection(transport_state);
@@ -1112,6 +1478,41 @@ static void prepareForConnectionRetry(AMQP_TRANSPORT_INSTANCE* transport_state)
     rollEventsBackToWaitList(transport_state);
 }
 
+static bool isConnectionRetryDue(AMQP_TRANSPORT_INSTANCE* transport_state)
+{
+    bool result;
+    uint64_t currentTimeInMs;
+
+    if (!IoTHubClient_RetryPolicy_IsWaiting(&transport_state->retry_policy))
+    {
+        result = true;
+    }
+    // the tick counter is shared with the adaptive mode and created the first time either needs it
+    else if ((transport_state->tick_counter == NULL) &&
+        ((transport_state->tick_counter = tickcounter_create()) == NULL))
+    {
+        LogError("Failed creating the tick counter, the connection is re-established without waiting for the retry delay.");
+        result = true;
+    }
+    else if (tickcounter_get_current_ms(transport_state->tick_counter, &currentTimeInMs) != 0)
+    {
+        LogError("Failed getting the current time, the connection is re-established without waiting for the retry delay.");
+        result = true;
+    }
+    else
+    {
+        result = IoTHubClient_RetryPolicy_CanAttempt(&transport_state->retry_policy, currentTimeInMs);
+    }
+
+    if (result && IoTHubClient_RetryPolicy_IsWaiting(&transport_state->retry_policy))
+    {
+        // Codes_SRS_IOTHUBTRANSPORTAMQP_10_023: [Every time IoTHubTransportAMQP_DoWork re-establishes the connection while the retry policy is waiting, it shall count the retry by calling IoTHubClient_LL_CountRetry.]
+        IoTHubClient_LL_CountRetry(transport_state->iothub_client_handle);
+    }
+
+    return result;
+}
+
 
 static void credential_destroy(AMQP_TRANSPORT_INSTANCE* transport_state)
 {
@@ -1241,6 +1642,20 @@ static TRANSPORT_LL_HANDLE IoTHubTransportAMQP_Create(const IOTHUBTRANSPORT_CONF
             transport_state->tls_io_transport_provider = getTLSIOTransport;
             transport_state->isRegistered = false;
             transport_state->is_trace_on = false;
+#ifndef DONT_USE_AMQP_BATCHING
+            transport_state->batching = false;
+#endif
+            transport_state->incoming_window = (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE;
+            transport_state->outgoing_window = DEFAULT_OUTGOING_WINDOW_SIZE;
+            transport_state->receiver_max_message_size = MESSAGE_RECEIVER_MAX_LINK_SIZE;
+            transport_state->receiver_link_credit = 0;
+            transport_state->adaptive_windows = false;
+            transport_state->tick_counter = NULL;
+            transport_state->rtt_probe.in_flight = false;
+            transport_state->smoothed_rtt = 0;
+            // Codes_SRS_IOTHUBTRANSPORTAMQP_10_002: [IoTHubTransportAMQP_Create shall initialize the retry policy of the connection with IoTHubClient_RetryPolicy_Init and seed it with the device id by calling IoTHubClient_RetryPolicy_Seed.]
+            IoTHubClient_RetryPolicy_Init(&transport_state->retry_policy);
+            IoTHubClient_RetryPolicy_Seed(&transport_state->retry_policy, config->upperConfig->deviceId);
 
             transport_state->cbs.cbs = NULL;
             transport_state->cbs.sasTokenKeyName = NULL;
@@ -1423,6 +1838,12 @@ static void IoTHubTransportAMQP_Destroy(TRANSPORT_LL_HANDLE handle)
             OptionHandler_Destroy(transport_state->xioOptions);
         }
 
+        // Codes_SRS_IOTHUBTRANSPORTAMQP_10_019: [IoTHubTransportAMQP_Destroy shall destroy the tick counter of the adaptive mode, if any, with tickcounter_destroy().]
+        if (transport_state->tick_counter != NULL)
+        {
+            tickcounter_destroy(transport_state->tick_counter);
+        }
+
         // Codes_SRS_IOTHUBTRANSPORTAMQP_09_150: [IoTHubTransportAMQP_Destroy shall destroy the transport instance]
         free(transport_state);
     }
@@ -1443,6 +1864,7 @@ static void IoTHubTransportAMQP_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
     else
     {
         bool trigger_connection_retry = false;
+        bool is_waiting_to_retry = false;
         AMQP_TRANSPORT_INSTANCE* transport_state = (AMQP_TRANSPORT_INSTANCE*)handle;
 
         // Codes_SRS_IOTHUBTRANSPORTAMQP_09_147: [IoTHubTransportAMQP_DoWork shall save a reference to the client handle in transport_state->iothub_client_handle]
@@ -1454,6 +1876,12 @@ static void IoTHubTransportAMQP_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
             LogError("An error occured on AMQP connection. The connection will be restablished.");
             trigger_connection_retry = true;
         }
+        // Codes_SRS_IOTHUBTRANSPORTAMQP_10_003: [If the transport has a NULL connection and IoTHubClient_RetryPolicy_IsWaiting returns true, IoTHubTransportAMQP_DoWork shall establish the connection only if IoTHubClient_RetryPolicy_CanAttempt returns true for the current time in milliseconds from tickcounter_get_current_ms(), and otherwise return without doing anything else. The tick counter shall be created with tickcounter_create() if the transport has none yet. If the tick counter cannot be created or read the connection shall be established.]
+        else if (transport_state->connection == NULL &&
+            !isConnectionRetryDue(transport_state))
+        {
+            is_waiting_to_retry = true;
+        }
         // Codes_SRS_IOTHUBTRANSPORTAMQP_09_055: [If the transport handle has a NULL connection, IoTHubTransportAMQP_DoWork shall instantiate and initialize the AMQP components and establish the connection] 
         else if (transport_state->connection == NULL &&
             establishConnection(transport_state) != RESULT_OK)
@@ -1508,7 +1936,7 @@ static void IoTHubTransportAMQP_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
                             LogError("Failed creating AMQP transport event sender.");
                             trigger_connection_retry = true;
                         }
-                        else if (sendPendingEvents(transport_state) != RESULT_OK)
+                        else if (sendWaitingEvents(transport_state) != RESULT_OK)
                         {
                             LogError("AMQP transport failed sending events.");
                         }
@@ -1539,7 +1967,7 @@ static void IoTHubTransportAMQP_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
                         LogError("Failed creating AMQP transport event sender.");
                         trigger_connection_retry = true;
                     }
-                    else if (sendPendingEvents(transport_state) != RESULT_OK)
+                    else if (sendWaitingEvents(transport_state) != RESULT_OK)
                     {
                         LogError("AMQP transport failed sending events.");
                     }
@@ -1557,7 +1985,7 @@ static void IoTHubTransportAMQP_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
         {
             prepareForConnectionRetry(transport_state);
         }
-        else
+        else if (!is_waiting_to_retry)
         {
             // Codes_SRS_IOTHUBTRANSPORTAMQP_09_103: [IoTHubTransportAMQP_DoWork shall invoke connection_dowork() on AMQP for triggering sending and receiving messages] 
             connection_dowork(transport_state->connection);
@@ -1675,6 +2103,107 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportAMQP_SetOption(TRANSPORT_LL_HANDLE ha
             transport_state->cbs.cbs_request_timeout = *((size_t*)value);
             result = IOTHUB_CLIENT_OK;
         }
+        // Codes_SRS_IOTHUBTRANSPORTAMQP_10_006: [IotHubTransportAMQP_SetOption shall pass the value to IoTHubClient_RetryPolicy_SetOption if the option name is "retryInitialDelay" or "retryMaxDelay" (size_t, milliseconds), returning IOTHUB_CLIENT_OK]
+        else if (IoTHubClient_RetryPolicy_SetOption(&transport_state->retry_policy, option, value))
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORTAMQP_10_007: [IotHubTransportAMQP_SetOption shall save the value if the option name is "Batching" (bool), returning IOTHUB_CLIENT_OK; the events are sent one AMQP message each while it is false, which is the default.]
+        else if (strcmp(OPTION_BATCHING, option) == 0)
+        {
+#ifndef DONT_USE_AMQP_BATCHING
+            transport_state->batching = *((bool*)value);
+            result = IOTHUB_CLIENT_OK;
+#else
+            // Codes_SRS_IOTHUBTRANSPORTAMQP_10_021: [If the transport is built against a uAMQP that does not provide link_get_peer_max_message_size() (DONT_USE_AMQP_BATCHING), IotHubTransportAMQP_SetOption shall return IOTHUB_CLIENT_ERROR if the option name is "Batching" and the value is true, and IOTHUB_CLIENT_OK if it is false; the events are always sent one AMQP message each.]
+            if (*((bool*)value))
+            {
+                LogError("Option %s is not supported by the uAMQP library this transport is built against.", option);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+#endif
+        }
+        // Codes_SRS_IOTHUBTRANSPORTAMQP_10_013: [IotHubTransportAMQP_SetOption shall save the value if the option name is "amqp_incoming_window" or "amqp_outgoing_window" (size_t, 1 to UINT32_MAX, in transfer frames), returning IOTHUB_CLIENT_OK, and set it on the current AMQP session, if any, with session_set_incoming_window() or session_set_outgoing_window(); a value out of range shall make it return IOTHUB_CLIENT_INVALID_ARG.]
+        else if ((strcmp(OPTION_AMQP_INCOMING_WINDOW, option) == 0) || (strcmp(OPTION_AMQP_OUTGOING_WINDOW, option) == 0))
+        {
+            size_t window = *((size_t*)value);
+            if ((window == 0) || (window > UINT32_MAX))
+            {
+                LogError("Invalid value (%lu) for option %s", (unsigned long)window, option);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                if (strcmp(OPTION_AMQP_INCOMING_WINDOW, option) == 0)
+                {
+                    transport_state->incoming_window = (uint32_t)window;
+                }
+                else
+                {
+                    transport_state->outgoing_window = (uint32_t)window;
+                }
+                applyWindows(transport_state);
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_AMQP_RECEIVER_MAX_MESSAGE_SIZE, option) == 0)
+        {
+            size_t max_message_size = *((size_t*)value);
+            if (max_message_size == 0)
+            {
+                LogError("Invalid value (0) for option %s", option);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                transport_state->receiver_max_message_size = max_message_size;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_AMQP_RECEIVER_LINK_CREDIT, option) == 0)
+        {
+            size_t link_credit = *((size_t*)value);
+            if (link_credit > UINT32_MAX)
+            {
+                LogError("Invalid value (%lu) for option %s", (unsigned long)link_credit, option);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+#ifdef DONT_USE_AMQP_LINK_CREDIT
+            // Codes_SRS_IOTHUBTRANSPORTAMQP_10_022: [If the transport is built against a uAMQP that does not provide link_set_max_link_credit() (DONT_USE_AMQP_LINK_CREDIT), IotHubTransportAMQP_SetOption shall return IOTHUB_CLIENT_ERROR if the option name is "amqp_receiver_link_credit" and the value is not 0, and IOTHUB_CLIENT_OK if it is 0; the message receiver link always keeps the uAMQP link credit.]
+            else if (link_credit != 0)
+            {
+                LogError("Option %s is not supported by the uAMQP library this transport is built against.", option);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+#endif
+            else
+            {
+                transport_state->receiver_link_credit = (uint32_t)link_credit;
+                applyWindows(transport_state);
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        // Codes_SRS_IOTHUBTRANSPORTAMQP_10_016: [IotHubTransportAMQP_SetOption shall turn the adaptive mode on or off if the option name is "amqp_adaptive_windows" (bool), returning IOTHUB_CLIENT_OK, and apply the resulting windows and credit to the current session and receiver link; the first time it is turned on, a tick counter shall be created with tickcounter_create() if the transport has none yet, and if that fails IotHubTransportAMQP_SetOption shall return IOTHUB_CLIENT_ERROR.]
+        else if (strcmp(OPTION_AMQP_ADAPTIVE_WINDOWS, option) == 0)
+        {
+            bool adaptive_windows = *((bool*)value);
+            if (adaptive_windows && (transport_state->tick_counter == NULL) &&
+                ((transport_state->tick_counter = tickcounter_create()) == NULL))
+            {
+                LogError("Failed creating the tick counter of the adaptive mode.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                transport_state->adaptive_windows = adaptive_windows;
+                applyWindows(transport_state);
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else if (strcmp(OPTION_LOG_TRACE, option) == 0)
         {
             transport_state->is_trace_on = *((bool*)value);
@@ -11,8 +11,10 @@
 #include "iothub_client_options.h"
 #include "iothub_client_version.h"
 #include "iothub_client_private.h"
+#include "iothub_client_retry_policy.h"
 #include "iothub_transport_ll.h"
 #include "iothubtransporthttp.h"
+#include "iothub_base64.h"
 
 #include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/urlencode.h"
@@ -20,11 +22,14 @@
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/strings.h"
-#include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
 
 #define IOTHUB_APP_PREFIX "iothub-app-"
 const char* IOTHUB_MESSAGE_ID = "iothub-messageid";
@@ -42,8 +47,12 @@ const char* IOTHUB_CORRELATION_ID = "iothub-correlationid";
 #define MAXIMUM_PAYLOAD_OVERHEAD 384
 #define MAXIMUM_PROPERTY_OVERHEAD 16
 
-/*forward declaration*/
-static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count);
+/*MAXIMUM_CONCURRENT_CONNECTIONS is the highest value accepted for the option "ConcurrentConnections"*/
+#define MAXIMUM_CONCURRENT_CONNECTIONS 64
+/*CONNECTION_POOL_WAIT_TIME is the time in ms a thread of the connection pool waits on a condition before it looks at the pass again*/
+#define CONNECTION_POOL_WAIT_TIME 1000
+/*POLLING_BUDGET_WINDOW is the time in seconds the request budget of the option "AdaptivePolling" is counted over*/
+#define POLLING_BUDGET_WINDOW 60
 
 typedef struct HTTPTRANSPORT_HANDLE_DATA_TAG
 {
@@ -52,8 +61,43 @@ typedef struct HTTPTRANSPORT_HANDLE_DATA_TAG
     bool doBatchedTransfers;
     unsigned int getMinimumPollingTime;
     VECTOR_HANDLE perDeviceList;
+    bool wasHttpApiExOptionSet; /*an option was passed down to httpApiExHandle, connections created after that would not have it*/
+    struct HTTPTRANSPORT_CONNECTION_POOL_TAG* connectionPool; /*NULL unless the option "ConcurrentConnections" is above 1*/
+    bool isAdaptivePolling;
+    unsigned int maximumPollingTime;
+    unsigned int pollingRequestBudget;
+    bool isPollingBudgetWindowStarted;
+    time_t pollingBudgetWindowStart;
+    unsigned int pollingBudgetUsed; /*GET requests sent since pollingBudgetWindowStart*/
+    unsigned int pollingBudgetWindowId; /*incremented every time a budget window starts, never 0 once a window started*/
+    IOTHUB_HTTP_POLLING_STATISTICS pollingStatistics; /*the budget and the statistics are shared by the threads of the connection pool, they are only touched under its lock*/
+    IOTHUB_CLIENT_RETRY_POLICY retryPolicy; /*only holds the delays given to the devices registered later*/
+    TICK_COUNTER_HANDLE tickCounter; /*the clock of the retry delays, read under the lock of the connection pool like the polling budget*/
 }HTTPTRANSPORT_HANDLE_DATA;
 
+/*a thread of the connection pool and the keep-alive connection it sends its requests on*/
+typedef struct HTTPTRANSPORT_POOL_WORKER_TAG
+{
+    struct HTTPTRANSPORT_CONNECTION_POOL_TAG* pool;
+    HTTPAPIEX_HANDLE httpApiExHandle;
+    THREAD_HANDLE threadHandle;
+}HTTPTRANSPORT_POOL_WORKER;
+
+/*DoWork hands out the devices of a pass one at a time to the calling thread and to the threads of the pool, so the requests of a device are never sent on two connections at the same time*/
+typedef struct HTTPTRANSPORT_CONNECTION_POOL_TAG
+{
+    HTTPTRANSPORT_HANDLE_DATA* handleData;
+    LOCK_HANDLE lock;
+    COND_HANDLE workCondition; /*posted when a pass starts and when the threads have to end*/
+    COND_HANDLE doneCondition; /*posted when the last device of a pass has been served*/
+    size_t nextDevice; /*index in perDeviceList of the first device of the pass that nobody took yet*/
+    size_t deviceCount; /*number of devices of the pass*/
+    size_t busyWorkers; /*number of pool threads serving a device*/
+    bool stop;
+    size_t workerCount;
+    HTTPTRANSPORT_POOL_WORKER* workers;
+}HTTPTRANSPORT_CONNECTION_POOL;
+
 typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
 {
     HTTPTRANSPORT_HANDLE_DATA* transportHandle;
@@ -70,10 +114,20 @@ typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
     bool DoWork_PullMessage;
     time_t lastPollTime;
     bool isFirstPoll;
+    unsigned int pollingInterval; /*seconds to wait after lastPollTime when adaptive polling is on, 0 polls again at the next DoWork*/
+    unsigned int deferredInBudgetWindow; /*pollingBudgetWindowId of the window in which the device was last counted in deferredByBudget, 0 if never*/
+    IOTHUB_CLIENT_RETRY_POLICY retryPolicy; /*paces the requests of the device after the events failed to be sent*/
 
     IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle;
     PDLIST_ENTRY waitingToSend;
     DLIST_ENTRY eventConfirmations; /*holds items for event confirmations*/
+    bool deferCallbacks; /*true while a pass of the connection pool serves the device, its callbacks are then delivered on the calling thread after the pass*/
+    bool hasDeferredConfirmedEvents;
+    DLIST_ENTRY deferredConfirmedEvents; /*events sent during the pass, completed with IOTHUB_CLIENT_CONFIRMATION_OK after it*/
+    bool hasDeferredFailedEvents;
+    DLIST_ENTRY deferredFailedEvents; /*events that failed during the pass, completed with IOTHUB_CLIENT_CONFIRMATION_ERROR after it*/
+    IOTHUB_MESSAGE_HANDLE deferredMessage; /*message received during the pass, NULL if none*/
+    STRING_HANDLE deferredMessageETag;
 } HTTPTRANSPORT_PERDEVICE_DATA;
 
 static void destroy_eventHTTPrelativePath(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
@@ -573,9 +627,21 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_128: [ IoTHubTransportHttp_Register shall mark this device as unsubscribed. ]*/
                 result->DoWork_PullMessage = false;
                 result->isFirstPoll = true;
+                result->pollingInterval = 0;
+                result->deferredInBudgetWindow = 0;
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_025: [ IoTHubTransportHttp_Register shall initialize the retry policy of the device with IoTHubClient_RetryPolicy_Init, seed it with the device id by calling IoTHubClient_RetryPolicy_Seed and set the delays set on the transport by "retryInitialDelay" and "retryMaxDelay". ]*/
+                IoTHubClient_RetryPolicy_Init(&result->retryPolicy);
+                IoTHubClient_RetryPolicy_Seed(&result->retryPolicy, device->deviceId);
+                result->retryPolicy.initialDelayInMs = ((HTTPTRANSPORT_HANDLE_DATA*)handle)->retryPolicy.initialDelayInMs;
+                result->retryPolicy.maxDelayInMs = ((HTTPTRANSPORT_HANDLE_DATA*)handle)->retryPolicy.maxDelayInMs;
                 result->iotHubClientHandle = iotHubClientHandle;
                 result->waitingToSend = waitingToSend;
                 DList_InitializeListHead(&(result->eventConfirmations));
+                result->deferCallbacks = false;
+                result->hasDeferredConfirmedEvents = false;
+                result->hasDeferredFailedEvents = false;
+                result->deferredMessage = NULL;
+                result->deferredMessageETag = NULL;
                 result->transportHandle = (HTTPTRANSPORT_HANDLE_DATA *) handle;
             }
             else
@@ -751,6 +817,29 @@ static bool create_perDeviceList(HTTPTRANSPORT_HANDLE_DATA* handleData)
 }
 
 
+static void destroy_tickCounter(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    tickcounter_destroy(handleData->tickCounter);
+    handleData->tickCounter = NULL;
+}
+
+/*Codes_SRS_TRANSPORTMULTITHTTP_10_035: [ IoTHubTransportHttp_Create shall create the tick counter that times the retry delays by calling tickcounter_create. ]*/
+static bool create_tickCounter(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    bool result;
+    handleData->tickCounter = tickcounter_create();
+    if (handleData->tickCounter == NULL)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_036: [ If creating the tick counter fails, then IoTHubTransportHttp_Create shall fail and return NULL. ]*/
+        result = false;
+    }
+    else
+    {
+        result = true;
+    }
+    return result;
+}
+
 static TRANSPORT_LL_HANDLE IoTHubTransportHttp_Create(const IOTHUBTRANSPORT_CONFIG* config)
 {
     HTTPTRANSPORT_HANDLE_DATA* result;
@@ -798,16 +887,28 @@ static TRANSPORT_LL_HANDLE IoTHubTransportHttp_Create(const IOTHUBTRANSPORT_CONF
             bool was_hostName_ok = create_hostName(result, config);
             bool was_httpApiExHandle_ok = was_hostName_ok && create_httpApiExHandle(result, config);
             bool was_perDeviceList_ok = was_httpApiExHandle_ok && create_perDeviceList(result);
+            bool was_tickCounter_ok = was_perDeviceList_ok && create_tickCounter(result);
 
 
-            if (was_perDeviceList_ok)
+            if (was_tickCounter_ok)
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_011: [ Otherwise, IoTHubTransportHttp_Create shall succeed and return a non-NULL value. ]*/
                 result->doBatchedTransfers = false;
                 result->getMinimumPollingTime = DEFAULT_GETMINIMUMPOLLINGTIME;
+                result->wasHttpApiExOptionSet = false;
+                result->connectionPool = NULL;
+                result->isAdaptivePolling = false;
+                result->maximumPollingTime = 0;
+                result->pollingRequestBudget = 0;
+                result->isPollingBudgetWindowStarted = false;
+                result->pollingBudgetUsed = 0;
+                result->pollingBudgetWindowId = 0;
+                memset(&result->pollingStatistics, 0, sizeof(result->pollingStatistics));
+                IoTHubClient_RetryPolicy_Init(&result->retryPolicy);
             }
             else
             {
+                if (was_perDeviceList_ok) destroy_perDeviceList(result);
                 if (was_httpApiExHandle_ok) destroy_httpApiExHandle(result);
                 if (was_hostName_ok) destroy_hostName(result);
 
@@ -819,6 +920,8 @@ static TRANSPORT_LL_HANDLE IoTHubTransportHttp_Create(const IOTHUBTRANSPORT_CONF
     return result;
 }
 
+static void destroy_connectionPool(HTTPTRANSPORT_HANDLE_DATA* handleData);
+
 static void IoTHubTransportHttp_Destroy(TRANSPORT_LL_HANDLE handle)
 {
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_012: [ IoTHubTransportHttp_Destroy shall do nothing is handle is NULL. ]*/
@@ -827,6 +930,9 @@ static void IoTHubTransportHttp_Destroy(TRANSPORT_LL_HANDLE handle)
         HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
         IOTHUB_DEVICE_HANDLE* listItem;
 
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_014: [ IoTHubTransportHttp_Destroy shall end and join the threads of the connection pool and destroy their connections before it frees the devices. ]*/
+        destroy_connectionPool(handleData);
+
         size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
 
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_013: [ Otherwise, IoTHubTransportHttp_Destroy shall free all the resources currently in use. ]*/
@@ -841,6 +947,7 @@ static void IoTHubTransportHttp_Destroy(TRANSPORT_LL_HANDLE handle)
         destroy_hostName((HTTPTRANSPORT_HANDLE_DATA *) handle);
         destroy_httpApiExHandle((HTTPTRANSPORT_HANDLE_DATA *) handle);
         destroy_perDeviceList((HTTPTRANSPORT_HANDLE_DATA *)handle);
+        destroy_tickCounter((HTTPTRANSPORT_HANDLE_DATA *)handle);
         free(handle);
     }
 }
@@ -903,232 +1010,222 @@ static void IoTHubTransportHttp_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
     }
 }
 
-/*produces a representation of the properties, if they exist*/
-/*if they do not exist, produces ""*/
-static int concat_Properties(STRING_HANDLE existing, MAP_HANDLE map, size_t* propertiesMessageSizeContribution)
+static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
 {
-    int result;
+    /*this function takes a list, and inserts it in another list. When done in the context of this file, it reverses the effects of a not-able-to-send situation*/
+    DList_AppendTailList(destination->Flink, source);
+    DList_RemoveEntryList(source);
+    DList_InitializeListHead(source);
+}
+
+/*the batch is built in 2 passes over waitingToSend: the first one computes the exact size of every {"body":...} item,
+the second one writes them in a BUFFER allocated once, so the batch is not reallocated and copied as it grows*/
+typedef struct EVENT_JSON_ITEM_TAG
+{
+    IOTHUBMESSAGE_CONTENT_TYPE contentType;
+    const unsigned char* source; /*the bytes of the message, or its string*/
+    size_t size; /*the number of bytes of the message, or the length of its string*/
     const char*const* keys;
     const char*const* values;
     size_t count;
-    if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
-    {
-        result = __LINE__;
-        LogError("error while Map_GetInternals");
-    }
-    else
-    {
+} EVENT_JSON_ITEM;
 
-        if (count == 0)
+static const char hexDigits[] = "0123456789ABCDEF";
+
+#define BODY_BYTEARRAY_BEGIN "{\"body\":\""
+#define BODY_BYTEARRAY_END "\""
+#define BODY_STRING_BEGIN "{\"body\":"
+#define BODY_STRING_END ",\"base64Encoded\":false"
+#define PROPERTIES_BEGIN ",\"properties\":{"
+#define ITEM_END "}"
+#define LITERAL_LENGTH(literal) (sizeof(literal) - 1)
+
+/*computes the size of the quoted JSON string STRING_new_JSON makes out of source. Fails like STRING_new_JSON for characters outside [1..127]*/
+static int jsonStringSize(const unsigned char* source, size_t length, size_t* size)
+{
+    int result = 0;
+    size_t i;
+    *size = length + 2; /*the quotes*/
+    for (i = 0; i < length; i++)
+    {
+        if (source[i] >= 128)
         {
-            /*Codes_SRS_TRANSPORTMULTITHTTP_17_064: [If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload*/
-            /*no properties - do nothing with existing*/
-            result = 0;
-            *propertiesMessageSizeContribution = 0;
+            result = __LINE__;
+            break;
         }
-        else
+        else if (source[i] <= 0x1F)
         {
-            /*Codes_SRS_TRANSPORTMULTITHTTP_17_058: [If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2*/
-            if (STRING_concat(existing, ",\"properties\":") != 0)
-            {
-                /*go ahead and return it*/
-                result = __LINE__;
-                LogError("failed STRING_concat");
-            }
-            else if (appendMapToJSON(existing, keys, values, count) != 0)
-            {
-                result = __LINE__;
-                LogError("unable to append the properties");
-            }
-            else
-            {
-                /*all is fine*/
-                size_t i;
-                *propertiesMessageSizeContribution = 0;
-                for (i = 0;i < count;i++)
-                {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_063: [Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes.] */
-                    *propertiesMessageSizeContribution += (strlen(keys[i]) + strlen(values[i]) + MAXIMUM_PROPERTY_OVERHEAD);
-                }
-                result = 0;
-            }
+            *size += 5; /*\u00xx*/
+        }
+        else if ((source[i] == '"') || (source[i] == '\\') || (source[i] == '/'))
+        {
+            *size += 1;
         }
     }
     return result;
 }
 
-/*produces a JSON representation of the map : {"a": "value_of_a","b":"value_of_b"}*/
-static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count) /*under consideration: move to MAP module when it has more than 1 user*/
+static unsigned char* writeJSONString(unsigned char* destination, const unsigned char* source, size_t length)
 {
-    int result;
-    if (STRING_concat(existing, "{") != 0)
-    {
-        /*go on and return it*/
-        result = __LINE__;
-        LogError("STRING_construct failed");
-    }
-    else
+    size_t i;
+    *destination++ = '"';
+    for (i = 0; i < length; i++)
     {
-        size_t i;
-        for (i = 0; i < count; i++)
+        if (source[i] <= 0x1F)
         {
-            if (!(
-                (STRING_concat(existing, (i == 0) ? "\"" IOTHUB_APP_PREFIX : ",\"" IOTHUB_APP_PREFIX) == 0) &&
-                (STRING_concat(existing, keys[i]) == 0) &&
-                (STRING_concat(existing, "\":\"") == 0) &&
-                (STRING_concat(existing, values[i]) == 0) &&
-                (STRING_concat(existing, "\"") == 0)
-                ))
-            {
-                LogError("unable to STRING_concat");
-                break;
-            }
-        }
-
-        if (i < count)
-        {
-            result = __LINE__;
-            /*error, let it go through*/
-        }
-        else if (STRING_concat(existing, "}") != 0)
-        {
-            result = __LINE__;
-            LogError("unable to STRING_concat");
+            *destination++ = '\\';
+            *destination++ = 'u';
+            *destination++ = '0';
+            *destination++ = '0';
+            *destination++ = hexDigits[source[i] >> 4];
+            *destination++ = hexDigits[source[i] & 0x0F];
         }
         else
         {
-            /*all is fine*/
-            result = 0;
+            if ((source[i] == '"') || (source[i] == '\\') || (source[i] == '/'))
+            {
+                *destination++ = '\\';
+            }
+            *destination++ = source[i];
         }
     }
-    return result;
+    *destination++ = '"';
+    return destination;
+}
+
+static unsigned char* writeLiteral(unsigned char* destination, const char* literal, size_t length)
+{
+    (void)memcpy(destination, literal, length);
+    return destination + length;
 }
 
-/*makes the following string:{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
-/*return NULL if there was a failure, or a non-NULL STRING_HANDLE that contains the intended data*/
-static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeContribution)
+/*gets the content and the properties of the message in item and computes the exact size of its serialization
+{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]} and its contribution to the message size*/
+static int getEventJSONitem(PDLIST_ENTRY item, EVENT_JSON_ITEM* jsonItem, size_t* jsonSize, size_t* messageSizeContribution)
 {
-    STRING_HANDLE result; /*temp wants to contain :{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
+    int result;
     IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
-    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message->messageHandle);
+    jsonItem->contentType = IoTHubMessage_GetContentType(message->messageHandle);
 
-    switch (contentType)
+    switch (jsonItem->contentType)
     {
     case IOTHUBMESSAGE_BYTEARRAY:
     {
-        result = STRING_construct("{\"body\":\"");
-        if (result == NULL)
+        if (IoTHubMessage_GetByteArray(message->messageHandle, &jsonItem->source, &jsonItem->size) != IOTHUB_MESSAGE_OK)
         {
-            LogError("unable to STRING_construct");
+            LogError("unable to get the data for the message.");
+            result = __LINE__;
         }
         else
         {
-            const unsigned char* source;
-            size_t size;
-
-            if (IoTHubMessage_GetByteArray(message->messageHandle, &source, &size) != IOTHUB_MESSAGE_OK)
-            {
-                LogError("unable to get the data for the message.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            else
-            {
-                STRING_HANDLE encoded = Base64_Encode_Bytes(source, size);
-                if (encoded == NULL)
-                {
-                    LogError("unable to Base64_Encode_Bytes.");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                else
-                {
-                    size_t propertiesSize;
-                    if (!(
-                        (STRING_concat_with_STRING(result, encoded) == 0) &&
-                        (STRING_concat(result, "\"") == 0) && /*\" because closing value*/
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
-                        ))
-                    {
-                        STRING_delete(result);
-                        result = NULL;
-                        LogError("unable to STRING_concat_with_STRING.");
-                    }
-                    else
-                    {
-                        /*all is fine... */
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
-                        *messageSizeContribution = size + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
-                    }
-                    STRING_delete(encoded);
-                }
-            }
+            *jsonSize = LITERAL_LENGTH(BODY_BYTEARRAY_BEGIN) + IoTHubBase64_EncodedLength(jsonItem->size) + LITERAL_LENGTH(BODY_BYTEARRAY_END);
+            result = 0;
         }
         break;
     }
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_057: [If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false}] */
     case IOTHUBMESSAGE_STRING:
     {
-        result = STRING_construct("{\"body\":");
-        if (result == NULL)
+        const char* source = IoTHubMessage_GetString(message->messageHandle);
+        size_t bodySize;
+        if (source == NULL)
         {
-            LogError("unable to STRING_construct");
+            LogError("unable to IoTHubMessage_GetString");
+            result = __LINE__;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_005: [ A message of type IOTHUBMESSAGE_STRING that has characters outside [1..127] shall fail to serialize. ]*/
+        else if (jsonStringSize((const unsigned char*)source, (jsonItem->size = strlen(source)), &bodySize) != 0)
+        {
+            LogError("invalid character in the message string");
+            result = __LINE__;
         }
         else
         {
-            const char* source = IoTHubMessage_GetString(message->messageHandle);
-            if (source == NULL)
-            {
-                LogError("unable to IoTHubMessage_GetString");
-                STRING_delete(result);
-                result = NULL;
-            }
-            else
-            {
-                STRING_HANDLE asJson = STRING_new_JSON(source);
-                if (asJson == NULL)
-                {
-                    LogError("unable to STRING_new_JSON");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                else
-                {
-                    size_t propertiesSize;
-                    if (!(
-                        (STRING_concat_with_STRING(result, asJson) == 0) &&
-                        (STRING_concat(result, ",\"base64Encoded\":false") == 0) &&
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
-                        ))
-                    {
-                        LogError("unable to STRING_concat_with_STRING");
-                        STRING_delete(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        /*result has the intended content*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
-                        *messageSizeContribution = strlen(source) + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
-                    }
-                    STRING_delete(asJson);
-                }
-            }
+            jsonItem->source = (const unsigned char*)source;
+            *jsonSize = LITERAL_LENGTH(BODY_STRING_BEGIN) + bodySize + LITERAL_LENGTH(BODY_STRING_END);
+            result = 0;
         }
         break;
     }
     default:
     {
-        LogError("an unknown message type was encountered (%d)", contentType);
-        result = NULL; /*unknown message type*/
+        LogError("an unknown message type was encountered (%d)", jsonItem->contentType);
+        result = __LINE__; /*unknown message type*/
         break;
     }
     }
+
+    if (result == 0)
+    {
+        if (Map_GetInternals(IoTHubMessage_Properties(message->messageHandle), &jsonItem->keys, &jsonItem->values, &jsonItem->count) != MAP_OK)
+        {
+            LogError("error while Map_GetInternals");
+            result = __LINE__;
+        }
+        else
+        {
+            size_t propertiesSize = 0;
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_064: [If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload*/
+            if (jsonItem->count > 0)
+            {
+                size_t i;
+                *jsonSize += LITERAL_LENGTH(PROPERTIES_BEGIN) + LITERAL_LENGTH(ITEM_END) + (jsonItem->count - 1); /*the commas between the properties*/
+                for (i = 0; i < jsonItem->count; i++)
+                {
+                    size_t keyLength = strlen(jsonItem->keys[i]);
+                    size_t valueLength = strlen(jsonItem->values[i]);
+                    /*"iothub-app-key":"value"*/
+                    *jsonSize += 1 + LITERAL_LENGTH(IOTHUB_APP_PREFIX) + keyLength + 3 + valueLength + 1;
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_063: [Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes.] */
+                    propertiesSize += keyLength + valueLength + MAXIMUM_PROPERTY_OVERHEAD;
+                }
+            }
+            *jsonSize += LITERAL_LENGTH(ITEM_END);
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
+            *messageSizeContribution = jsonItem->size + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
+        }
+    }
     return result;
 }
 
+/*writes the item measured by getEventJSONitem, returns the first byte after it*/
+static unsigned char* writeEventJSONitem(unsigned char* destination, const EVENT_JSON_ITEM* jsonItem)
+{
+    if (jsonItem->contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        destination = writeLiteral(destination, BODY_BYTEARRAY_BEGIN, LITERAL_LENGTH(BODY_BYTEARRAY_BEGIN));
+        destination = (unsigned char*)IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET_STANDARD, jsonItem->source, jsonItem->size, (char*)destination);
+        destination = writeLiteral(destination, BODY_BYTEARRAY_END, LITERAL_LENGTH(BODY_BYTEARRAY_END));
+    }
+    else
+    {
+        destination = writeLiteral(destination, BODY_STRING_BEGIN, LITERAL_LENGTH(BODY_STRING_BEGIN));
+        destination = writeJSONString(destination, jsonItem->source, jsonItem->size);
+        destination = writeLiteral(destination, BODY_STRING_END, LITERAL_LENGTH(BODY_STRING_END));
+    }
+
+    if (jsonItem->count > 0)
+    {
+        size_t i;
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_058: [If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2*/
+        destination = writeLiteral(destination, PROPERTIES_BEGIN, LITERAL_LENGTH(PROPERTIES_BEGIN));
+        for (i = 0; i < jsonItem->count; i++)
+        {
+            if (i > 0)
+            {
+                *destination++ = ',';
+            }
+            destination = writeLiteral(destination, "\"" IOTHUB_APP_PREFIX, 1 + LITERAL_LENGTH(IOTHUB_APP_PREFIX));
+            destination = writeLiteral(destination, jsonItem->keys[i], strlen(jsonItem->keys[i]));
+            destination = writeLiteral(destination, "\":\"", 3);
+            destination = writeLiteral(destination, jsonItem->values[i], strlen(jsonItem->values[i]));
+            *destination++ = '"';
+        }
+        destination = writeLiteral(destination, ITEM_END, LITERAL_LENGTH(ITEM_END));
+    }
+    return writeLiteral(destination, ITEM_END, LITERAL_LENGTH(ITEM_END));
+}
+
 #define MAKE_PAYLOAD_RESULT_VALUES \
     MAKE_PAYLOAD_OK, /*returned when there is a payload to be later send by HTTP*/ \
     MAKE_PAYLOAD_NO_ITEMS, /*returned when there are no items to be send*/ \
@@ -1139,132 +1236,135 @@ DEFINE_ENUM(MAKE_PAYLOAD_RESULT, MAKE_PAYLOAD_RESULT_VALUES);
 
 /*this function assembles several {"body":"base64 encoding of the message content"," base64Encoded": true} into 1 payload*/
 /*Codes_SRS_TRANSPORTMULTITHTTP_17_056: [IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...]]*/
-static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, STRING_HANDLE* payload)
+static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, BUFFER_HANDLE* payload)
 {
-    MAKE_PAYLOAD_RESULT result;
+    MAKE_PAYLOAD_RESULT result = MAKE_PAYLOAD_NO_ITEMS;
     size_t allMessagesSize = 0;
-    *payload = STRING_construct("[");
-    if (*payload == NULL)
+    size_t payloadSize = 1; /*"["*/
+    size_t itemCount = 0;
+    EVENT_JSON_ITEM jsonItem;
+    PDLIST_ENTRY actual;
+
+    /*Codes_SRS_TRANSPORTMULTITHTTP_10_001: [ IoTHubTransportHttp_DoWork shall compute the exact size of the batch before building it. ]*/
+    for (actual = deviceData->waitingToSend->Flink; actual != deviceData->waitingToSend; actual = actual->Flink)
     {
-        LogError("unable to STRING_construct");
-        result = MAKE_PAYLOAD_ERROR;
+        size_t jsonSize;
+        size_t messageSize;
+        if (getEventJSONitem(actual, &jsonItem, &jsonSize, &messageSize) != 0)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
+            result = (itemCount == 0) ? MAKE_PAYLOAD_ERROR : MAKE_PAYLOAD_OK;
+            break;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
+        else if (allMessagesSize + messageSize > MAXIMUM_MESSAGE_SIZE)
+        {
+            if (itemCount == 0)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
+                PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
+            }
+            else
+            {
+                /*this item doesn't make it to the payload, but the payload is valid so far*/
+                result = MAKE_PAYLOAD_OK;
+            }
+            break;
+        }
+        else
+        {
+            allMessagesSize += messageSize;
+            payloadSize += jsonSize + 1; /*every item is followed by a "," and the last one by "]"*/
+            itemCount++;
+            result = MAKE_PAYLOAD_OK;
+        }
     }
-    else
+
+    if (result == MAKE_PAYLOAD_OK)
     {
-        bool isFirst = true;
-        PDLIST_ENTRY actual;
-        bool keepGoing = true; /*keepGoing gets sometimes to false from within the loop*/
-                               /*either all the items enter the list or only some*/
-        result = MAKE_PAYLOAD_OK; /*optimistically initializing it*/
-        while (keepGoing && ((actual = deviceData->waitingToSend->Flink) != deviceData->waitingToSend))
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_002: [ IoTHubTransportHttp_DoWork shall write the batch in a BUFFER created by BUFFER_new and sized once by BUFFER_pre_build. ]*/
+        if ((*payload = BUFFER_new()) == NULL)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_004: [ If BUFFER_new or BUFFER_pre_build fails then the messages shall stay in waitingToSend and IoTHubTransportHttp_DoWork shall advance to the next activity. ]*/
+            LogError("unable to BUFFER_new");
+            result = MAKE_PAYLOAD_ERROR;
+        }
+        else if (BUFFER_pre_build(*payload, payloadSize) != 0)
         {
-            size_t messageSize;
-            STRING_HANDLE temp = make1EventJSONitem(actual, &messageSize);
-            if (isFirst)
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_004: [ If BUFFER_new or BUFFER_pre_build fails then the messages shall stay in waitingToSend and IoTHubTransportHttp_DoWork shall advance to the next activity. ]*/
+            LogError("unable to BUFFER_pre_build");
+            BUFFER_delete(*payload);
+            *payload = NULL;
+            result = MAKE_PAYLOAD_ERROR;
+        }
+        else
+        {
+            unsigned char* begin = BUFFER_u_char(*payload);
+            unsigned char* destination = begin;
+            size_t i;
+            *destination++ = '[';
+            for (i = 0; i < itemCount; i++)
             {
-                isFirst = false;
-                /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                if (temp == NULL) /*first item failed to create, nothing to send*/
+                size_t jsonSize;
+                size_t messageSize;
+                /*the message is the same as in the first pass, so is its size*/
+                if ((getEventJSONitem(deviceData->waitingToSend->Flink, &jsonItem, &jsonSize, &messageSize) != 0) ||
+                    ((size_t)(destination - begin) + jsonSize + 1 > payloadSize))
                 {
-                    result = MAKE_PAYLOAD_ERROR;
-                    STRING_delete(*payload);
-                    *payload = NULL;
-                    keepGoing = false;
+                    break;
                 }
                 else
                 {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
-                    if (messageSize > MAXIMUM_MESSAGE_SIZE)
-                    {
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
-                        STRING_delete(*payload);
-                        *payload = NULL;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        if (STRING_concat_with_STRING(*payload, temp) != 0)
-                        {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            result = MAKE_PAYLOAD_ERROR;
-                            STRING_delete(*payload);
-                            *payload = NULL;
-                            keepGoing = false;
-                        }
-                        else
-                        {
-                            /*first item was put nicely in the payload*/
-                            PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                            DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                            allMessagesSize += messageSize;
-                        }
-                    }
-                    STRING_delete(temp);
+                    PDLIST_ENTRY head;
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_10_003: [ The base64 encoding of the messages, their JSON encoding and their properties shall be written in place in the BUFFER. ]*/
+                    destination = writeEventJSONitem(destination, &jsonItem);
+                    *destination++ = (i + 1 < itemCount) ? ',' : ']';
+                    head = DList_RemoveHeadList(deviceData->waitingToSend);
+                    DList_InsertTailList(&(deviceData->eventConfirmations), head);
                 }
             }
-            else
+
+            if (i < itemCount)
             {
-                /*there is at least 1 item already in the payload*/
-                if (temp == NULL)
-                {
-                    /*there are multiple payloads encoded, the last one had an internal error, just go with those - closing the payload happens "after the loop"*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                    result = MAKE_PAYLOAD_OK;
-                    keepGoing = false;
-                }
-                else
-                {
-                    if (allMessagesSize + messageSize > MAXIMUM_MESSAGE_SIZE)
-                    {
-                        /*this item doesn't make it to the payload, but the payload is valid so far*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else if (STRING_concat_with_STRING(*payload, temp) != 0)
-                    {
-                        /*should still send what there is so far...*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        /*cool, the payload made it there, let's continue... */
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        allMessagesSize += messageSize;
-                    }
-                    STRING_delete(temp);
-                }
+                LogError("a message changed while its batch was being built");
+                reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                BUFFER_delete(*payload);
+                *payload = NULL;
+                result = MAKE_PAYLOAD_ERROR;
             }
         }
+    }
+    return result;
+}
 
-        /*closing the payload*/
-        if (result == MAKE_PAYLOAD_OK)
+/*completes the events in eventConfirmations, or keeps them for the calling thread when a pass of the connection pool serves the device*/
+static void completeEvents(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    if (!deviceData->deferCallbacks)
+    {
+        IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), result); /*takes care of emptying the list too*/
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_032: [ When the connection pool exists, IoTHubTransportHttp_DoWork shall not call IoTHubClient_LL_SendComplete while it serves a device. It shall move the completed events of the device to a list kept per device and per result instead. ]*/
+        bool* hasDeferred = (result == IOTHUB_CLIENT_CONFIRMATION_OK) ? &(deviceData->hasDeferredConfirmedEvents) : &(deviceData->hasDeferredFailedEvents);
+        PDLIST_ENTRY deferred = (result == IOTHUB_CLIENT_CONFIRMATION_OK) ? &(deviceData->deferredConfirmedEvents) : &(deviceData->deferredFailedEvents);
+        if (!*hasDeferred)
         {
-            ((char*)STRING_c_str(*payload))[STRING_length(*payload) - 1] = ']'; /*TODO - do this in STRING_HANDLE*/
+            DList_InitializeListHead(deferred);
+            *hasDeferred = true;
         }
-        else
+        while (!DList_IsListEmpty(&(deviceData->eventConfirmations)))
         {
-            /*no need to close anything*/
+            DList_InsertTailList(deferred, DList_RemoveHeadList(&(deviceData->eventConfirmations)));
         }
     }
-    return result;
-}
-
-static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
-{
-    /*this function takes a list, and inserts it in another list. When done in the context of this file, it reverses the effects of a not-able-to-send situation*/
-    DList_AppendTailList(destination->Flink, source);
-    DList_RemoveEntryList(source);
-    DList_InitializeListHead(source);
 }
 
-static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPAPIEX_HANDLE httpApiExHandle, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
 
     if (DList_IsListEmpty(deviceData->waitingToSend))
@@ -1285,73 +1385,57 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
             else
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_059: [It shall inspect the "waitingToSend" DLIST passed in config structure.] */
-                STRING_HANDLE payload;
+                BUFFER_HANDLE payload;
                 switch (makePayload(deviceData, &payload))
                 {
                 case MAKE_PAYLOAD_OK:
                 {
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_068: [Once a final payload has been obtained, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters:] */
-                    BUFFER_HANDLE temp = BUFFER_new();
-                    if (temp == NULL)
+                    unsigned int statusCode;
+                    HTTPAPIEX_RESULT r;
+                    if ((r = HTTPAPIEX_SAS_ExecuteRequest(
+                        deviceData->sasObject,
+                        httpApiExHandle,
+                        HTTPAPI_REQUEST_POST,
+                        STRING_c_str(deviceData->eventHTTPrelativePath),
+                        deviceData->eventHTTPrequestHeaders,
+                        payload,
+                        &statusCode,
+                        NULL,
+                        NULL
+                        )) != HTTPAPIEX_OK)
                     {
-                        LogError("unable to BUFFER_new");
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
+                        LogError("unable to HTTPAPIEX_ExecuteRequest");
+                        //items go back to waitingToSend
+                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
                         reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                        /*Codes_SRS_TRANSPORTMULTITHTTP_10_027: [ If HTTPAPIEX_SAS_ExecuteRequest or HTTPAPIEX_ExecuteRequest fails to send the events or the http status code is >=300, IoTHubTransportHttp_DoWork shall report the failure by IoTHubClient_RetryPolicy_OnFailure. ]*/
+                        IoTHubClient_RetryPolicy_OnFailure(&deviceData->retryPolicy);
                     }
                     else
                     {
-                        if (BUFFER_build(temp, (const unsigned char*)STRING_c_str(payload), STRING_length(payload)) != 0)
+                        if (statusCode < 300)
                         {
-                            LogError("unable to BUFFER_build");
-                            //items go back to waitingToSend
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_10_028: [ If the http status code of the events request is <300, IoTHubTransportHttp_DoWork shall report the success by IoTHubClient_RetryPolicy_OnSuccess. ]*/
+                            IoTHubClient_RetryPolicy_OnSuccess(&deviceData->retryPolicy);
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_070: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend.] */
+                            completeEvents(iotHubClientHandle, deviceData, IOTHUB_CLIENT_CONFIRMATION_OK);
                         }
                         else
                         {
-                            unsigned int statusCode;
-                            HTTPAPIEX_RESULT r;
-                            if ((r = HTTPAPIEX_SAS_ExecuteRequest(
-                                deviceData->sasObject,
-                                handleData->httpApiExHandle,
-                                HTTPAPI_REQUEST_POST,
-                                STRING_c_str(deviceData->eventHTTPrelativePath),
-                                deviceData->eventHTTPrequestHeaders,
-                                temp,
-                                &statusCode,
-                                NULL,
-                                NULL
-                                )) != HTTPAPIEX_OK)
-                            {
-                                LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                //items go back to waitingToSend
-                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
-                            }
-                            else
-                            {
-                                if (statusCode < 300)
-                                {
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_070: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend.] */
-                                    IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK);
-                                }
-                                else
-                                {
-                                    //items go back to waitingToSend
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                    LogError("unexpected HTTP status code (%u)", statusCode);
-                                    reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
-                                }
-                            }
+                            //items go back to waitingToSend
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
+                            LogError("unexpected HTTP status code (%u)", statusCode);
+                            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                            IoTHubClient_RetryPolicy_OnFailure(&deviceData->retryPolicy);
                         }
-                        BUFFER_delete(temp);
                     }
-                    STRING_delete(payload);
+                    BUFFER_delete(payload);
                     break;
                 }
                 case MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT:
                 {
-                    IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR); /*takes care of emptying the list too*/
+                    completeEvents(iotHubClientHandle, deviceData, IOTHUB_CLIENT_CONFIRMATION_ERROR); /*takes care of emptying the list too*/
                     break;
                 }
                 case MAKE_PAYLOAD_ERROR:
@@ -1405,7 +1489,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                 {
                     PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
                     DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                    IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR); /*takes care of emptying the list too*/
+                    completeEvents(iotHubClientHandle, deviceData, IOTHUB_CLIENT_CONFIRMATION_ERROR); /*takes care of emptying the list too*/
                 }
                 else
                 {
@@ -1453,7 +1537,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_072: [The message size shall be limited to 255KB -1 bytes.] */
                                         PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
                                         DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                                        IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR); /*takes care of emptying the list too*/
+                                        completeEvents(iotHubClientHandle, deviceData, IOTHUB_CLIENT_CONFIRMATION_ERROR); /*takes care of emptying the list too*/
                                         goOn = false;
                                     }
                                     else
@@ -1541,7 +1625,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
 
                                                 /*Codes_SRS_TRANSPORTMULTITHTTP_03_003: [If a deviceSasToken exists, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_ExecuteRequest passing the following parameters] */
                                                 else if ((r = HTTPAPIEX_ExecuteRequest(
-                                                    handleData->httpApiExHandle,
+                                                    httpApiExHandle,
                                                     HTTPAPI_REQUEST_POST,
                                                     STRING_c_str(deviceData->eventHTTPrelativePath),
                                                     clonedEventHTTPrequestHeaders,
@@ -1552,6 +1636,8 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                                     )) != HTTPAPIEX_OK)
                                                 {
                                                     LogError("Unable to HTTPAPIEX_ExecuteRequest.");
+                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_10_027: [ If HTTPAPIEX_SAS_ExecuteRequest or HTTPAPIEX_ExecuteRequest fails to send the events or the http status code is >=300, IoTHubTransportHttp_DoWork shall report the failure by IoTHubClient_RetryPolicy_OnFailure. ]*/
+                                                    IoTHubClient_RetryPolicy_OnFailure(&deviceData->retryPolicy);
                                                 }
                                             }
                                             else
@@ -1559,7 +1645,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_080: [If a deviceSasToken does not exist, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters] */
                                                 if ((r = HTTPAPIEX_SAS_ExecuteRequest(
                                                     deviceData->sasObject,
-                                                    handleData->httpApiExHandle,
+                                                    httpApiExHandle,
                                                     HTTPAPI_REQUEST_POST,
                                                     STRING_c_str(deviceData->eventHTTPrelativePath),
                                                     clonedEventHTTPrequestHeaders,
@@ -1570,6 +1656,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                                     )) != HTTPAPIEX_OK)
                                                 {
                                                     LogError("unable to HTTPAPIEX_SAS_ExecuteRequest");
+                                                    IoTHubClient_RetryPolicy_OnFailure(&deviceData->retryPolicy);
                                                 }
                                             }
                                             if (r == HTTPAPIEX_OK)
@@ -1578,13 +1665,16 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                                 {
                                                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_082: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend.] */
                                                     PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_10_028: [ If the http status code of the events request is <300, IoTHubTransportHttp_DoWork shall report the success by IoTHubClient_RetryPolicy_OnSuccess. ]*/
+                                                    IoTHubClient_RetryPolicy_OnSuccess(&deviceData->retryPolicy);
                                                     DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
-                                                    IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK); /*takes care of emptying the list too*/
+                                                    completeEvents(iotHubClientHandle, deviceData, IOTHUB_CLIENT_CONFIRMATION_OK); /*takes care of emptying the list too*/
                                                 }
                                                 else
                                                 {
                                                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_081: [If HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
                                                     LogError("unexpected HTTP status code (%u)", statusCode);
+                                                    IoTHubClient_RetryPolicy_OnFailure(&deviceData->retryPolicy);
                                                 }
                                             }
                                         }
@@ -1607,7 +1697,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
     ACCEPT
 DEFINE_ENUM(ACTION, ACTION_VALUES);
 
-static void abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, const char* ETag, ACTION action)
+static void abandonOrAcceptMessage(HTTPAPIEX_HANDLE httpApiExHandle, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, const char* ETag, ACTION action)
 {
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_097: [_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest with the following parameters:
     -requestType: POST
@@ -1707,7 +1797,7 @@ static void abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                                 LogError("Unable to replace the old SAS Token.");
                             }
                             else if ((r = HTTPAPIEX_ExecuteRequest(
-                                handleData->httpApiExHandle,
+                                httpApiExHandle,
                                 (action == ABANDON) ? HTTPAPI_REQUEST_POST : HTTPAPI_REQUEST_DELETE,                               /*-requestType: POST                                                                                                       */
                                 STRING_c_str(fullAbandonRelativePath),              /*-relativePath: abandon relative path begin (as created by _Create) + value of ETag + "/abandon?api-version=2016-02-03"   */
                                 abandonRequestHttpHeaders,                          /*- requestHttpHeadersHandle: an HTTP headers instance containing the following                                            */
@@ -1725,7 +1815,7 @@ static void abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                         }
                         else if ((r = HTTPAPIEX_SAS_ExecuteRequest(
                             deviceData->sasObject,
-                            handleData->httpApiExHandle,
+                            httpApiExHandle,
                             (action == ABANDON) ? HTTPAPI_REQUEST_POST : HTTPAPI_REQUEST_DELETE,                               /*-requestType: POST                                                                                                       */
                             STRING_c_str(fullAbandonRelativePath),              /*-relativePath: abandon relative path begin (as created by _Create) + value of ETag + "/abandon?api-version=2016-02-03"   */
                             abandonRequestHttpHeaders,                          /*- requestHttpHeadersHandle: an HTTP headers instance containing the following                                            */
@@ -1767,21 +1857,152 @@ static void abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
     }
 }
 
-static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+/*calls the message callback of the device and settles the message with the service accordingly*/
+static void dispatchMessage(HTTPAPIEX_HANDLE httpApiExHandle, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE receivedMessage, const char* ETag)
 {
-    /*Codes_SRS_TRANSPORTMULTITHTTP_17_083: [ If device is not subscribed then _DoWork shall advance to the next action. ] */
-    if (deviceData->DoWork_PullMessage)
+    /*Codes_SRS_TRANSPORTMULTITHTTP_17_093: [Otherwise, _DoWork shall call IoTHubClient_LL_MessageCallback with parameters handle = iotHubClientHandle and message = newly created message.]*/
+    IOTHUBMESSAGE_DISPOSITION_RESULT messageResult = IoTHubClient_LL_MessageCallback(iotHubClientHandle, receivedMessage);
+    if (messageResult == IOTHUBMESSAGE_ACCEPTED)
     {
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_123: [After client creation, the first GET shall be allowed no matter what the value of GetMinimumPollingTime.] */
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_124: [If time is not available then all calls shall be treated as if they are the first one.] */
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_122: [A GET request that happens earlier than GetMinimumPollingTime shall be ignored.] */
-        time_t timeNow = get_time(NULL);
-        bool isPollingAllowed = deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > handleData->getMinimumPollingTime);
-        if (isPollingAllowed)
-        {
-            HTTP_HEADERS_HANDLE responseHTTPHeaders = HTTPHeaders_Alloc();
-            if (responseHTTPHeaders == NULL)
-            {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_094: [If IoTHubClient_LL_MessageCallback returns IOTHUBMESSAGE_ACCEPTED then _DoWork shall "accept" the message.]*/
+        abandonOrAcceptMessage(httpApiExHandle, deviceData, ETag, ACCEPT);
+    }
+    else if (messageResult == IOTHUBMESSAGE_REJECTED)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_095: [If IoTHubClient_LL_MessageCallback returns IOTHUBMESSAGE_REJECTED then _DoWork shall "reject" the message.]*/
+        abandonOrAcceptMessage(httpApiExHandle, deviceData, ETag, REJECT);
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_096: [If IoTHubClient_LL_MessageCallback returns IOTHUBMESSAGE_ABANDONED then _DoWork shall "abandon" the message.] */
+        abandonOrAcceptMessage(httpApiExHandle, deviceData, ETag, ABANDON);
+    }
+}
+
+static void lockPolling(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    if ((handleData->connectionPool != NULL) && (Lock(handleData->connectionPool->lock) != LOCK_OK))
+    {
+        LogError("unable to Lock");
+    }
+}
+
+static void unlockPolling(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    if (handleData->connectionPool != NULL)
+    {
+        (void)Unlock(handleData->connectionPool->lock);
+    }
+}
+
+/*decides if the device can send its GET now under the adaptive policy, and if so counts it against the budget*/
+static bool isAdaptivePollingAllowed(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, time_t timeNow)
+{
+    bool result;
+    /*Codes_SRS_TRANSPORTMULTITHTTP_10_018: [ When adaptive polling is on, a GET request shall be allowed if it is the first one of the device, if time is not available, if the polling interval of the device is 0 or if more seconds than the polling interval of the device have passed since its last GET request. ]*/
+    if (!(deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || (deviceData->pollingInterval == 0) || (get_difftime(timeNow, deviceData->lastPollTime) > deviceData->pollingInterval)))
+    {
+        result = false;
+    }
+    else
+    {
+        lockPolling(handleData);
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_021: [ If the request budget is not 0 and time is available, IoTHubTransportHttp_DoWork shall send at most requestBudget GET requests for all the devices of the transport in every 60 seconds. A GET request over the budget shall not be sent, it shall be counted in deferredByBudget and the device shall poll at a later call. ]*/
+        if ((handleData->pollingRequestBudget != 0) && (timeNow != (time_t)(-1)))
+        {
+            if (!handleData->isPollingBudgetWindowStarted || (get_difftime(timeNow, handleData->pollingBudgetWindowStart) >= POLLING_BUDGET_WINDOW))
+            {
+                handleData->isPollingBudgetWindowStarted = true;
+                handleData->pollingBudgetWindowStart = timeNow;
+                handleData->pollingBudgetUsed = 0;
+                /*starting a window clears the "deferred" mark of every device without walking them*/
+                handleData->pollingBudgetWindowId++;
+                if (handleData->pollingBudgetWindowId == 0)
+                {
+                    handleData->pollingBudgetWindowId = 1;
+                }
+            }
+        }
+
+        if ((handleData->pollingRequestBudget != 0) && (timeNow != (time_t)(-1)) && (handleData->pollingBudgetUsed >= handleData->pollingRequestBudget))
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_030: [ A device whose GET requests are put off by the request budget shall be counted in deferredByBudget once per budget window, however many calls to IoTHubTransportHttp_DoWork put it off. ]*/
+            if (deviceData->deferredInBudgetWindow != handleData->pollingBudgetWindowId)
+            {
+                deviceData->deferredInBudgetWindow = handleData->pollingBudgetWindowId;
+                handleData->pollingStatistics.deferredByBudget++;
+            }
+            result = false;
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_022: [ When adaptive polling is on, IoTHubTransportHttp_DoWork shall count in polls every GET request it sends and shall add to fixedPolicyPolls the number of GET requests "MinimumPollingTime" alone would have allowed since the previous GET request of the device, 1 for the first one. ]*/
+            handleData->pollingBudgetUsed++;
+            handleData->pollingStatistics.polls++;
+            if (deviceData->isFirstPoll || (timeNow == (time_t)(-1)))
+            {
+                handleData->pollingStatistics.fixedPolicyPolls++;
+            }
+            else
+            {
+                handleData->pollingStatistics.fixedPolicyPolls += (uint64_t)(get_difftime(timeNow, deviceData->lastPollTime) / ((double)handleData->getMinimumPollingTime + 1));
+            }
+            result = true;
+        }
+        unlockPolling(handleData);
+    }
+    return result;
+}
+
+/*polls again right away while messages come, and backs off from "MinimumPollingTime" to maximumPollingTime while they do not*/
+static void updatePollingInterval(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, unsigned int statusCode)
+{
+    lockPolling(handleData);
+    if (statusCode == 200)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_019: [ When adaptive polling is on and a GET request is answered with status code 200, IoTHubTransportHttp_DoWork shall set the polling interval of the device to 0 and count the request in messages. ]*/
+        deviceData->pollingInterval = 0;
+        handleData->pollingStatistics.messages++;
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_020: [ When adaptive polling is on and a GET request is answered with any other status code, IoTHubTransportHttp_DoWork shall set the polling interval of the device to "MinimumPollingTime" if it was below it, or else double it, without going over the largest of "MinimumPollingTime" and maximumPollingTime, and count the request in emptyPolls. ]*/
+        unsigned int minimum = (handleData->getMinimumPollingTime == 0) ? 1 : handleData->getMinimumPollingTime;
+        unsigned int maximum = (handleData->maximumPollingTime > minimum) ? handleData->maximumPollingTime : minimum;
+        if (deviceData->pollingInterval < minimum)
+        {
+            deviceData->pollingInterval = minimum;
+        }
+        else if (deviceData->pollingInterval > maximum / 2)
+        {
+            deviceData->pollingInterval = maximum;
+        }
+        else
+        {
+            deviceData->pollingInterval *= 2;
+        }
+        handleData->pollingStatistics.emptyPolls++;
+    }
+    unlockPolling(handleData);
+}
+
+static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPAPIEX_HANDLE httpApiExHandle, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    /*Codes_SRS_TRANSPORTMULTITHTTP_17_083: [ If device is not subscribed then _DoWork shall advance to the next action. ] */
+    if (deviceData->DoWork_PullMessage)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_123: [After client creation, the first GET shall be allowed no matter what the value of GetMinimumPollingTime.] */
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_124: [If time is not available then all calls shall be treated as if they are the first one.] */
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_122: [A GET request that happens earlier than GetMinimumPollingTime shall be ignored.] */
+        time_t timeNow = get_time(NULL);
+        bool isPollingAllowed = handleData->isAdaptivePolling ?
+            isAdaptivePollingAllowed(handleData, deviceData, timeNow) :
+            (deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > handleData->getMinimumPollingTime));
+        if (isPollingAllowed)
+        {
+            HTTP_HEADERS_HANDLE responseHTTPHeaders = HTTPHeaders_Alloc();
+            if (responseHTTPHeaders == NULL)
+            {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
                 LogError("unable to HTTPHeaders_Alloc");
             }
@@ -1807,7 +2028,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                             LogError("Unable to replace the old SAS Token.");
                         }
                         else if ((r = HTTPAPIEX_ExecuteRequest(
-                            handleData->httpApiExHandle,
+                            httpApiExHandle,
                             HTTPAPI_REQUEST_GET,                                            /*requestType: GET*/
                             STRING_c_str(deviceData->messageHTTPrelativePath),         /*relativePath: the message HTTP relative path*/
                             deviceData->messageHTTPrequestHeaders,                     /*requestHttpHeadersHandle: message HTTP request headers created by _Create*/
@@ -1833,7 +2054,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                     */
                     else if ((r = HTTPAPIEX_SAS_ExecuteRequest(
                         deviceData->sasObject,
-                        handleData->httpApiExHandle,
+                        httpApiExHandle,
                         HTTPAPI_REQUEST_GET,                                            /*requestType: GET*/
                         STRING_c_str(deviceData->messageHTTPrelativePath),         /*relativePath: the message HTTP relative path*/
                         deviceData->messageHTTPrequestHeaders,                     /*requestHttpHeadersHandle: message HTTP request headers created by _Create*/
@@ -1858,6 +2079,10 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                             deviceData->isFirstPoll = false;
                             deviceData->lastPollTime = timeNow;
                         }
+                        if (handleData->isAdaptivePolling)
+                        {
+                            updatePollingInterval(handleData, deviceData, statusCode);
+                        }
                         if (statusCode == 204)
                         {
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
@@ -1898,7 +2123,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                                     {
                                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_092: [If assembling the message fails in any way, then _DoWork shall "abandon" the message.]*/
                                         LogError("unable to IoTHubMessage_CreateFromByteArray, trying to abandon the message... ");
-                                        abandonOrAcceptMessage(handleData, deviceData, etagValue, ABANDON);
+                                        abandonOrAcceptMessage(httpApiExHandle, deviceData, etagValue, ABANDON);
                                     }
                                     else
                                     {
@@ -1908,7 +2133,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                                         if (HTTPHeaders_GetHeaderCount(responseHTTPHeaders, &nHeaders) != HTTP_HEADERS_OK)
                                         {
                                             LogError("unable to get the count of HTTP headers");
-                                            abandonOrAcceptMessage(handleData, deviceData, etagValue, ABANDON);
+                                            abandonOrAcceptMessage(httpApiExHandle, deviceData, etagValue, ABANDON);
                                         }
                                         else
                                         {
@@ -1970,30 +2195,32 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
 
                                             if (i < nHeaders)
                                             {
-                                                abandonOrAcceptMessage(handleData, deviceData, etagValue, ABANDON);
+                                                abandonOrAcceptMessage(httpApiExHandle, deviceData, etagValue, ABANDON);
                                             }
-                                            else
+                                            else if (deviceData->deferCallbacks)
                                             {
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_093: [Otherwise, _DoWork shall call IoTHubClient_LL_MessageCallback with parameters handle = iotHubClientHandle and message = newly created message.]*/
-                                                IOTHUBMESSAGE_DISPOSITION_RESULT messageResult = IoTHubClient_LL_MessageCallback(iotHubClientHandle, receivedMessage);
-                                                if (messageResult == IOTHUBMESSAGE_ACCEPTED)
-                                                {
-                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_094: [If IoTHubClient_LL_MessageCallback returns IOTHUBMESSAGE_ACCEPTED then _DoWork shall "accept" the message.]*/
-                                                    abandonOrAcceptMessage(handleData, deviceData, etagValue, ACCEPT);
-                                                }
-                                                else if (messageResult == IOTHUBMESSAGE_REJECTED)
+                                                /*Codes_SRS_TRANSPORTMULTITHTTP_10_033: [ When the connection pool exists, IoTHubTransportHttp_DoWork shall not call IoTHubClient_LL_MessageCallback while it serves a device. It shall keep the received message together with a copy of its ETag made by STRING_construct instead, and abandon the message if STRING_construct fails. ]*/
+                                                deviceData->deferredMessageETag = STRING_construct(etagValue);
+                                                if (deviceData->deferredMessageETag == NULL)
                                                 {
-                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_095: [If IoTHubClient_LL_MessageCallback returns IOTHUBMESSAGE_REJECTED then _DoWork shall "reject" the message.]*/
-                                                    abandonOrAcceptMessage(handleData, deviceData, etagValue, REJECT);
+                                                    LogError("unable to STRING_construct, trying to abandon the message... ");
+                                                    abandonOrAcceptMessage(httpApiExHandle, deviceData, etagValue, ABANDON);
                                                 }
                                                 else
                                                 {
-                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_096: [If IoTHubClient_LL_MessageCallback returns IOTHUBMESSAGE_ABANDONED then _DoWork shall "abandon" the message.] */
-                                                    abandonOrAcceptMessage(handleData, deviceData, etagValue, ABANDON);
+                                                    deviceData->deferredMessage = receivedMessage;
+                                                    receivedMessage = NULL;
                                                 }
                                             }
+                                            else
+                                            {
+                                                dispatchMessage(httpApiExHandle, deviceData, iotHubClientHandle, receivedMessage, etagValue);
+                                            }
+                                        }
+                                        if (receivedMessage != NULL)
+                                        {
+                                            IoTHubMessage_Destroy(receivedMessage);
                                         }
-                                        IoTHubMessage_Destroy(receivedMessage);
                                     }
                                 }
 
@@ -2013,6 +2240,302 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
     }
 }
 
+/*the device waits for the delay of its retry policy after its events failed to be sent, unless time is not available*/
+static bool isRetryDue(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    bool result;
+    uint64_t timeNowInMs;
+    int tickResult;
+
+    lockPolling(handleData);
+    tickResult = tickcounter_get_current_ms(handleData->tickCounter, &timeNowInMs);
+    unlockPolling(handleData);
+
+    if (tickResult != 0)
+    {
+        LogError("time is not available, the device does not wait for the retry delay");
+        result = true;
+    }
+    else
+    {
+        result = IoTHubClient_RetryPolicy_CanAttempt(&deviceData->retryPolicy, timeNowInMs);
+    }
+    if (result)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_031: [ Every time IoTHubTransportHttp_DoWork sends the requests of a device whose retry policy is waiting, it shall count the retry by calling IoTHubClient_LL_CountRetry. ]*/
+        IoTHubClient_LL_CountRetry(deviceData->iotHubClientHandle);
+    }
+    return result;
+}
+
+/*serves the device at index in perDeviceList on the connection httpApiExHandle, deferCallbacks keeps its callbacks for DeliverDeferredCallbacks*/
+static void DoDevice(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPAPIEX_HANDLE httpApiExHandle, size_t index, bool deferCallbacks)
+{
+    IOTHUB_DEVICE_HANDLE* listItem = (IOTHUB_DEVICE_HANDLE *)VECTOR_element(handleData->perDeviceList, index);
+    HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
+    perDeviceItem->deferCallbacks = deferCallbacks;
+    /*Codes_SRS_TRANSPORTMULTITHTTP_10_026: [ If IoTHubClient_RetryPolicy_IsWaiting returns true for a device, IoTHubTransportHttp_DoWork shall get the current time by tickcounter_get_current_ms and shall not send any request for the device unless the time is not available or IoTHubClient_RetryPolicy_CanAttempt returns true for it. ]*/
+    if (!IoTHubClient_RetryPolicy_IsWaiting(&perDeviceItem->retryPolicy) ||
+        isRetryDue(handleData, perDeviceItem))
+    {
+        DoEvent(handleData, httpApiExHandle, perDeviceItem, perDeviceItem->iotHubClientHandle);
+        DoMessages(handleData, httpApiExHandle, perDeviceItem, perDeviceItem->iotHubClientHandle);
+    }
+}
+
+/*delivers on the calling thread the callbacks kept while a pass of the connection pool served the device at index in perDeviceList*/
+static void DeliverDeferredCallbacks(HTTPTRANSPORT_HANDLE_DATA* handleData, size_t index)
+{
+    IOTHUB_DEVICE_HANDLE* listItem = (IOTHUB_DEVICE_HANDLE *)VECTOR_element(handleData->perDeviceList, index);
+    HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
+    perDeviceItem->deferCallbacks = false;
+    /*Codes_SRS_TRANSPORTMULTITHTTP_10_034: [ Once every device has been served, IoTHubTransportHttp_DoWork shall deliver the kept callbacks on the calling thread, device by device in the order of the device list: IoTHubClient_LL_SendComplete for the failed events with IOTHUB_CLIENT_CONFIRMATION_ERROR, then for the sent events with IOTHUB_CLIENT_CONFIRMATION_OK, then IoTHubClient_LL_MessageCallback for the kept message, which is then accepted, rejected or abandoned on the connection created by IoTHubTransportHttp_Create. ]*/
+    if (perDeviceItem->hasDeferredFailedEvents)
+    {
+        perDeviceItem->hasDeferredFailedEvents = false;
+        IoTHubClient_LL_SendComplete(perDeviceItem->iotHubClientHandle, &(perDeviceItem->deferredFailedEvents), IOTHUB_CLIENT_CONFIRMATION_ERROR);
+    }
+    if (perDeviceItem->hasDeferredConfirmedEvents)
+    {
+        perDeviceItem->hasDeferredConfirmedEvents = false;
+        IoTHubClient_LL_SendComplete(perDeviceItem->iotHubClientHandle, &(perDeviceItem->deferredConfirmedEvents), IOTHUB_CLIENT_CONFIRMATION_OK);
+    }
+    if (perDeviceItem->deferredMessage != NULL)
+    {
+        dispatchMessage(handleData->httpApiExHandle, perDeviceItem, perDeviceItem->iotHubClientHandle, perDeviceItem->deferredMessage, STRING_c_str(perDeviceItem->deferredMessageETag));
+        IoTHubMessage_Destroy(perDeviceItem->deferredMessage);
+        STRING_delete(perDeviceItem->deferredMessageETag);
+        perDeviceItem->deferredMessage = NULL;
+        perDeviceItem->deferredMessageETag = NULL;
+    }
+}
+
+static int ConnectionPool_Thread(void* threadArgument)
+{
+    HTTPTRANSPORT_POOL_WORKER* worker = (HTTPTRANSPORT_POOL_WORKER*)threadArgument;
+    HTTPTRANSPORT_CONNECTION_POOL* pool = worker->pool;
+    if (Lock(pool->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+    }
+    else
+    {
+        while (!pool->stop)
+        {
+            if (pool->nextDevice < pool->deviceCount)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_012: [ When the connection pool exists, IoTHubTransportHttp_DoWork shall hand out the devices one at a time to the calling thread and to the threads of the pool. Each thread shall serve a device as IoTHubTransportHttp_DoWork does without the pool, on its own connection, and a device shall be served by one thread only during a call. ]*/
+                size_t index = pool->nextDevice++;
+                pool->busyWorkers++;
+                (void)Unlock(pool->lock);
+
+                DoDevice(pool->handleData, worker->httpApiExHandle, index, true);
+
+                (void)Lock(pool->lock);
+                pool->busyWorkers--;
+                if ((pool->busyWorkers == 0) && (pool->nextDevice == pool->deviceCount))
+                {
+                    (void)Condition_Post(pool->doneCondition);
+                }
+            }
+            else if (Condition_Wait(pool->workCondition, pool->lock, CONNECTION_POOL_WAIT_TIME) == COND_ERROR)
+            {
+                LogError("Condition_Wait failed");
+            }
+        }
+        (void)Unlock(pool->lock);
+    }
+    return 0;
+}
+
+static void DoConnectionPoolPass(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_CONNECTION_POOL* pool)
+{
+    if (Lock(pool->lock) != LOCK_OK)
+    {
+        /*the threads of the pool are idle between calls, the calling thread can serve all the devices*/
+        size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+        LogError("unable to Lock, serving all the devices on the calling thread");
+        for (size_t i = 0; i < deviceListSize; i++)
+        {
+            DoDevice(handleData, handleData->httpApiExHandle, i, false);
+        }
+    }
+    else
+    {
+        size_t i;
+        size_t deviceCount;
+        pool->nextDevice = 0;
+        pool->deviceCount = VECTOR_size(handleData->perDeviceList);
+
+        /*the calling thread serves a device too, a pool thread is only woken up for the second device onwards*/
+        for (i = 1; (i < pool->deviceCount) && (i <= pool->workerCount); i++)
+        {
+            if (Condition_Post(pool->workCondition) != COND_OK)
+            {
+                LogError("unable to Condition_Post");
+            }
+        }
+
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_012: [ When the connection pool exists, IoTHubTransportHttp_DoWork shall hand out the devices one at a time to the calling thread and to the threads of the pool. Each thread shall serve a device as IoTHubTransportHttp_DoWork does without the pool, on its own connection, and a device shall be served by one thread only during a call. ]*/
+        while (pool->nextDevice < pool->deviceCount)
+        {
+            size_t index = pool->nextDevice++;
+            (void)Unlock(pool->lock);
+
+            DoDevice(handleData, handleData->httpApiExHandle, index, true);
+
+            (void)Lock(pool->lock);
+        }
+
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_013: [ IoTHubTransportHttp_DoWork shall return only after every device has been served. ]*/
+        while (pool->busyWorkers > 0)
+        {
+            if (Condition_Wait(pool->doneCondition, pool->lock, CONNECTION_POOL_WAIT_TIME) == COND_ERROR)
+            {
+                LogError("Condition_Wait failed");
+            }
+        }
+        deviceCount = pool->deviceCount;
+        (void)Unlock(pool->lock);
+
+        /*the callbacks run on the calling thread only, as they do without the pool*/
+        for (i = 0; i < deviceCount; i++)
+        {
+            DeliverDeferredCallbacks(handleData, i);
+        }
+    }
+}
+
+/*ends and joins the first count threads of the pool and destroys their connections*/
+static void stop_connectionPoolWorkers(HTTPTRANSPORT_CONNECTION_POOL* pool, size_t count)
+{
+    size_t i;
+    if (Lock(pool->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock, ending the threads of the connection pool without it");
+        pool->stop = true;
+    }
+    else
+    {
+        pool->stop = true;
+        for (i = 0; i < count; i++)
+        {
+            (void)Condition_Post(pool->workCondition);
+        }
+        (void)Unlock(pool->lock);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        int notUsed;
+        if (ThreadAPI_Join(pool->workers[i].threadHandle, &notUsed) != THREADAPI_OK)
+        {
+            LogError("unable to ThreadAPI_Join");
+        }
+        HTTPAPIEX_Destroy(pool->workers[i].httpApiExHandle);
+    }
+}
+
+static void free_connectionPool(HTTPTRANSPORT_CONNECTION_POOL* pool)
+{
+    Condition_Deinit(pool->doneCondition);
+    Condition_Deinit(pool->workCondition);
+    (void)Lock_Deinit(pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+/*Codes_SRS_TRANSPORTMULTITHTTP_10_009: [ Otherwise IoTHubTransportHttp_SetOption shall end and join the threads of the current connection pool and destroy their connections. If value is above 1, it shall then create a connection pool of value - 1 connections, each one created by HTTPAPIEX_Create with the hostname and served by a thread created by ThreadAPI_Create, and return IOTHUB_CLIENT_OK. ]*/
+static bool create_connectionPool(HTTPTRANSPORT_HANDLE_DATA* handleData, size_t workerCount)
+{
+    bool result;
+    HTTPTRANSPORT_CONNECTION_POOL* pool = (HTTPTRANSPORT_CONNECTION_POOL*)malloc(sizeof(HTTPTRANSPORT_CONNECTION_POOL));
+    if (pool == NULL)
+    {
+        LogError("unable to malloc");
+        result = false;
+    }
+    else if ((pool->workers = (HTTPTRANSPORT_POOL_WORKER*)malloc(workerCount * sizeof(HTTPTRANSPORT_POOL_WORKER))) == NULL)
+    {
+        LogError("unable to malloc");
+        free(pool);
+        result = false;
+    }
+    else if ((pool->lock = Lock_Init()) == NULL)
+    {
+        LogError("unable to Lock_Init");
+        free(pool->workers);
+        free(pool);
+        result = false;
+    }
+    else if ((pool->workCondition = Condition_Init()) == NULL)
+    {
+        LogError("unable to Condition_Init");
+        (void)Lock_Deinit(pool->lock);
+        free(pool->workers);
+        free(pool);
+        result = false;
+    }
+    else if ((pool->doneCondition = Condition_Init()) == NULL)
+    {
+        LogError("unable to Condition_Init");
+        Condition_Deinit(pool->workCondition);
+        (void)Lock_Deinit(pool->lock);
+        free(pool->workers);
+        free(pool);
+        result = false;
+    }
+    else
+    {
+        size_t i;
+        pool->handleData = handleData;
+        pool->nextDevice = 0;
+        pool->deviceCount = 0;
+        pool->busyWorkers = 0;
+        pool->stop = false;
+        pool->workerCount = workerCount;
+
+        for (i = 0; i < workerCount; i++)
+        {
+            pool->workers[i].pool = pool;
+            if ((pool->workers[i].httpApiExHandle = HTTPAPIEX_Create(STRING_c_str(handleData->hostName))) == NULL)
+            {
+                LogError("unable to HTTPAPIEX_Create");
+                break;
+            }
+            else if (ThreadAPI_Create(&pool->workers[i].threadHandle, ConnectionPool_Thread, &pool->workers[i]) != THREADAPI_OK)
+            {
+                LogError("unable to ThreadAPI_Create");
+                HTTPAPIEX_Destroy(pool->workers[i].httpApiExHandle);
+                break;
+            }
+        }
+
+        if (i < workerCount)
+        {
+            stop_connectionPoolWorkers(pool, i);
+            free_connectionPool(pool);
+            result = false;
+        }
+        else
+        {
+            handleData->connectionPool = pool;
+            result = true;
+        }
+    }
+    return result;
+}
+
+static void destroy_connectionPool(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    if (handleData->connectionPool != NULL)
+    {
+        stop_connectionPoolWorkers(handleData->connectionPool, handleData->connectionPool->workerCount);
+        free_connectionPool(handleData->connectionPool);
+        handleData->connectionPool = NULL;
+    }
+}
+
 static void IoTHubTransportHttp_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_049: [ If handle is NULL, then IoTHubTransportHttp_DoWork shall do nothing. ]*/
@@ -2022,18 +2545,20 @@ static void IoTHubTransportHttp_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
     if (handle != NULL)
     {
         HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
-        IOTHUB_DEVICE_HANDLE* listItem;
-        size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_052: [ IoTHubTransportHttp_DoWork shall perform a round-robin loop through every deviceHandle in the transport device list, using the iotHubClientHandle field saved in the IOTHUB_DEVICE_HANDLE. ]*/
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_050: [ IoTHubTransportHttp_DoWork shall call loop through the device list. ] */
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_051: [ IF the list is empty, then IoTHubTransportHttp_DoWork shall do nothing. ]*/
-        for (size_t i = 0; i < deviceListSize; i++)
+        if (handleData->connectionPool == NULL)
         {
-            listItem = (IOTHUB_DEVICE_HANDLE *) VECTOR_element(handleData->perDeviceList, i);
-            HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
-            DoEvent(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
-            DoMessages(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
-
+            size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_052: [ IoTHubTransportHttp_DoWork shall perform a round-robin loop through every deviceHandle in the transport device list, using the iotHubClientHandle field saved in the IOTHUB_DEVICE_HANDLE. ]*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_050: [ IoTHubTransportHttp_DoWork shall call loop through the device list. ] */
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_051: [ IF the list is empty, then IoTHubTransportHttp_DoWork shall do nothing. ]*/
+            for (size_t i = 0; i < deviceListSize; i++)
+            {
+                DoDevice(handleData, handleData->httpApiExHandle, i, false);
+            }
+        }
+        else
+        {
+            DoConnectionPoolPass(handleData, handleData->connectionPool);
         }
     }
     else
@@ -2118,6 +2643,74 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
             handleData->getMinimumPollingTime = *(unsigned int*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_015: [ "AdaptivePolling" ]*/
+        else if (strcmp(OPTION_ADAPTIVE_POLLING, option) == 0)
+        {
+            const IOTHUB_ADAPTIVE_POLLING_OPTIONS* pollingOptions = (const IOTHUB_ADAPTIVE_POLLING_OPTIONS*)value;
+            if (pollingOptions->maximumPollingTime == 0)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_016: [ If maximumPollingTime is 0 then IoTHubTransportHttp_SetOption shall turn adaptive polling off and return IOTHUB_CLIENT_OK. The GET requests are then only governed by "MinimumPollingTime". ]*/
+                handleData->isAdaptivePolling = false;
+            }
+            else
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_017: [ Otherwise IoTHubTransportHttp_SetOption shall turn adaptive polling on, store maximumPollingTime and requestBudget, set the polling interval of every device to "MinimumPollingTime", restart the budget count and return IOTHUB_CLIENT_OK. ]*/
+                size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+                for (size_t i = 0; i < deviceListSize; i++)
+                {
+                    HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)VECTOR_element(handleData->perDeviceList, i);
+                    perDeviceItem->pollingInterval = handleData->getMinimumPollingTime;
+                }
+                handleData->isAdaptivePolling = true;
+                handleData->maximumPollingTime = pollingOptions->maximumPollingTime;
+                handleData->pollingRequestBudget = pollingOptions->requestBudget;
+                handleData->isPollingBudgetWindowStarted = false;
+                handleData->pollingBudgetUsed = 0;
+            }
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_029: [ "retryInitialDelay", "retryMaxDelay" ]*/
+        else if (IoTHubClient_RetryPolicy_SetOption(&handleData->retryPolicy, option, value))
+        {
+            size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+            for (size_t i = 0; i < deviceListSize; i++)
+            {
+                HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)VECTOR_element(handleData->perDeviceList, i);
+                (void)IoTHubClient_RetryPolicy_SetOption(&perDeviceItem->retryPolicy, option, value);
+            }
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_006: [ "ConcurrentConnections" ]*/
+        else if (strcmp(OPTION_CONCURRENT_CONNECTIONS, option) == 0)
+        {
+            unsigned int connections = *(const unsigned int*)value;
+            if (connections > MAXIMUM_CONCURRENT_CONNECTIONS)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_007: [ If value is above 64 then IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+                result = IOTHUB_CLIENT_INVALID_ARG;
+                LogError("%s cannot be above %u", OPTION_CONCURRENT_CONNECTIONS, (unsigned int)MAXIMUM_CONCURRENT_CONNECTIONS);
+            }
+            else if ((connections > 1) && handleData->wasHttpApiExOptionSet)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_008: [ If value is above 1 and an option has already been passed down by HTTPAPIEX_SetOption then IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("%s has to be set before the options that are passed to the HTTP connection", OPTION_CONCURRENT_CONNECTIONS);
+            }
+            else
+            {
+                destroy_connectionPool(handleData);
+                if ((connections > 1) && !create_connectionPool(handleData, connections - 1))
+                {
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_10_010: [ If creating the connection pool fails, IoTHubTransportHttp_SetOption shall free what it created and return IOTHUB_CLIENT_ERROR. IoTHubTransportHttp_DoWork shall then use only the connection created by IoTHubTransportHttp_Create. ]*/
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("unable to create the connection pool");
+                }
+                else
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+        }
         else
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_126: [ "TrustedCerts"] */
@@ -2125,6 +2718,21 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_129: [ This option shall passed down to the lower layer by calling HTTPAPIEX_SetOption. ]*/
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_118: [Otherwise, IoTHubTransport_Http shall call HTTPAPIEX_SetOption with the same parameters and return the translated code.] */
             HTTPAPIEX_RESULT HTTPAPIEX_result = HTTPAPIEX_SetOption(handleData->httpApiExHandle, option, value);
+            if (HTTPAPIEX_result == HTTPAPIEX_OK)
+            {
+                handleData->wasHttpApiExOptionSet = true;
+                if (handleData->connectionPool != NULL)
+                {
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_10_011: [ IoTHubTransportHttp_SetOption shall call HTTPAPIEX_SetOption for every connection of the connection pool as well and return the translated code of the first call that fails. ]*/
+                    for (size_t i = 0; i < handleData->connectionPool->workerCount; i++)
+                    {
+                        if ((HTTPAPIEX_result = HTTPAPIEX_SetOption(handleData->connectionPool->workers[i].httpApiExHandle, option, value)) != HTTPAPIEX_OK)
+                        {
+                            break;
+                        }
+                    }
+                }
+            }
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_119: [The following table translates HTTPAPIEX return codes to IOTHUB_CLIENT_RESULT return codes:] */
             if (HTTPAPIEX_result == HTTPAPIEX_OK)
             {
@@ -2145,6 +2753,28 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetPollingStatistics(TRANSPORT_LL_HANDLE handle, IOTHUB_HTTP_POLLING_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_TRANSPORTMULTITHTTP_10_023: [ If handle or statistics is NULL then IoTHubTransportHttp_GetPollingStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((handle == NULL) || (statistics == NULL))
+    {
+        LogError("invalid parameter handle=%p, statistics=%p", handle, statistics);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_024: [ Otherwise IoTHubTransportHttp_GetPollingStatistics shall copy the polling counters to statistics, set requestsSaved to fixedPolicyPolls - polls or to 0 if polls is larger, and return IOTHUB_CLIENT_OK. ]*/
+        HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
+        lockPolling(handleData);
+        *statistics = handleData->pollingStatistics;
+        unlockPolling(handleData);
+        statistics->requestsSaved = (statistics->fixedPolicyPolls > statistics->polls) ? (statistics->fixedPolicyPolls - statistics->polls) : 0;
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
 static STRING_HANDLE IoTHubTransportHttp_GetHostname(TRANSPORT_LL_HANDLE handle)
 {
     STRING_HANDLE result;
@@ -15,6 +15,8 @@
 #include "iothub_client_ll.h"
 #include "iothub_client_options.h"
 #include "iothub_client_private.h"
+#include "iothub_client_ll_pool.h"
+#include "iothub_client_retry_policy.h"
 #include "iothubtransportmqtt.h"
 #include "azure_umqtt_c/mqtt_client.h"
 #include "azure_c_shared_utility/sastoken.h"
@@ -42,8 +44,11 @@
 #define SAS_TOKEN_DEFAULT_LEN       10
 #define RESEND_TIMEOUT_VALUE_MIN    1*60
 #define MAX_SEND_RECOUNT_LIMIT      2
-#define DEFAULT_CONNECTION_INTERVAL 30
-#define FAILED_CONN_BACKOFF_VALUE   5
+#define EVENT_TOPIC_PROPERTIES_LEN  256
+#define IN_FLIGHT_TABLE_INITIAL_LEN 32 /*a power of 2*/
+#define IN_FLIGHT_WINDOW_INITIAL    4
+#define LATE_ACK_LATENCY_FACTOR     2
+#define LATE_ACK_LATENCY_MIN_MS     1000
 
 static const char* DEVICE_MSG_TOPIC = "devices/%s/messages/devicebound/#";
 static const char* DEVICE_DEVICE_TOPIC = "devices/%s/messages/events/";
@@ -66,8 +71,6 @@ static SYSTEM_PROPERTY_INFO sysPropList[] = {
     { "iothub-ack", 10 }
 };
 
-static TICK_COUNTER_HANDLE g_msgTickCounter;
-
 typedef enum MQTT_TRANSPORT_CREDENTIAL_TYPE_TAG
 {
     CREDENTIAL_NOT_BUILD,
@@ -90,8 +93,12 @@ typedef struct MQTT_TRANSPORT_CREDENTIALS_TAG
     } CREDENTIAL_VALUE;
 } MQTT_TRANSPORT_CREDENTIALS;
 
+struct MQTTTRANSPORT_MULTIPLEXER_DATA_TAG;
+
 typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
 {
+    bool isMultiplexer; /*always false, see MQTTTRANSPORT_MULTIPLEXER_DATA*/
+    TICK_COUNTER_HANDLE msgTickCounter; /*owned by the transport created with a device, borrowed from the multiplexer by a registered device*/
     STRING_HANDLE device_id;
     STRING_HANDLE devicesPath;
 
@@ -115,17 +122,55 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     bool subscribed;
     bool receiveMessages;
     bool destroyCalled;
-    DLIST_ENTRY waitingForAck;
+    DLIST_ENTRY waitingForAck; /*in publish order, so the oldest message is always the first to time out*/
     PDLIST_ENTRY waitingToSend;
     IOTHUB_CLIENT_LL_HANDLE llClientHandle;
     CONTROL_PACKET_TYPE currPacketState;
     XIO_HANDLE xioTransport;
     uint16_t keepAliveValue;
     uint64_t mqtt_connect_time;
-    size_t connectFailCount;
-    uint64_t connectTick;
+    IOTHUB_CLIENT_RETRY_POLICY retryPolicy; /*paces the connection attempts after a failed connect or a dropped connection*/
+    IOTHUB_CLIENT_LL_POOL_HANDLE messageDetailsPool; /*created by the "mqttMessagePoolSize" option, NULL when the MQTT_MESSAGE_DETAILS_LIST records are malloc'd one by one*/
+    char* eventTopicBuffer; /*mqttEventTopic followed by the properties of the message being published, reused from one publish to the next*/
+    size_t eventTopicBufferSize;
+    size_t eventTopicLength;
+    /*the messages of waitingForAck indexed by packet id, in an open addressing table kept at most half full*/
+    struct MQTT_MESSAGE_DETAILS_LIST_TAG** inFlightTable;
+    size_t inFlightTableSize;
+    size_t inFlightCount;
+    struct MQTT_MESSAGE_DETAILS_LIST_TAG* inFlightInitialTable[IN_FLIGHT_TABLE_INITIAL_LEN];
+    size_t maxInFlight; /*set by the "mqttMaxInFlight" option, 0 when the messages waiting for an acknowledgement are not limited*/
+    size_t inFlightWindow;
+    size_t slowStartThreshold;
+    size_t windowAckCount;
+    uint64_t ackLatency; /*smoothed PUBACK latency in ms, 0 until the first PUBACK*/
+    uint64_t windowDecreaseTime;
+    bool telemetryQos0; /*set by the "mqttTelemetryQos0" option, the events are then published without waiting for a PUBACK*/
+    bool replayWaitingForAck; /*set by a CONNACK, waitingForAck is published again by the next DoWork that can publish*/
+    struct MQTTTRANSPORT_MULTIPLEXER_DATA_TAG* multiplexer; /*the transport the device was registered on, NULL when the device was given to IoTHubTransportMqtt_Create*/
+    DLIST_ENTRY multiplexerEntry;
 } MQTTTRANSPORT_HANDLE_DATA, *PMQTTTRANSPORT_HANDLE_DATA;
 
+/*a transport created without a device (that is, by IoTHubTransport_Create). Every device registered on it gets its own
+MQTTTRANSPORT_HANDLE_DATA and its own MQTT connection - IoT Hub authenticates one device per connection - and
+IoTHubTransportMqtt_DoWork drives all the connections in turn from the calling thread*/
+typedef struct MQTTTRANSPORT_MULTIPLEXER_DATA_TAG
+{
+    bool isMultiplexer; /*always true, shares its offset with MQTTTRANSPORT_HANDLE_DATA's so a TRANSPORT_LL_HANDLE tells which one it is*/
+    IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;
+    STRING_HANDLE iotHubName;
+    STRING_HANDLE iotHubSuffix;
+    STRING_HANDLE hostAddress;
+    uint16_t keepAliveValue;
+    bool logTrace;
+    size_t messagePoolSize;
+    size_t maxInFlight;
+    bool telemetryQos0;
+    TICK_COUNTER_HANDLE msgTickCounter; /*shared by the registered devices, they are all served by the DoWork of the multiplexer*/
+    IOTHUB_CLIENT_RETRY_POLICY retryPolicy; /*only holds the "retryInitialDelay" and "retryMaxDelay" values for the devices registered later*/
+    DLIST_ENTRY devices; /*the MQTTTRANSPORT_HANDLE_DATA of the registered devices, linked by multiplexerEntry*/
+} MQTTTRANSPORT_MULTIPLEXER_DATA;
+
 typedef struct MQTT_MESSAGE_DETAILS_LIST_TAG
 {
     uint64_t msgPublishTime;
@@ -136,6 +181,155 @@ typedef struct MQTT_MESSAGE_DETAILS_LIST_TAG
     DLIST_ENTRY entry;
 } MQTT_MESSAGE_DETAILS_LIST, *PMQTT_MESSAGE_DETAILS_LIST;
 
+static MQTT_MESSAGE_DETAILS_LIST* messageDetails_alloc(PMQTTTRANSPORT_HANDLE_DATA transportState)
+{
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_003: [When there is a message details pool the MQTT_MESSAGE_DETAILS_LIST records shall be taken from it and given back to it; a record the pool cannot serve shall be allocated with malloc.] */
+    return (transportState->messageDetailsPool == NULL) ?
+        (MQTT_MESSAGE_DETAILS_LIST*)malloc(sizeof(MQTT_MESSAGE_DETAILS_LIST)) :
+        (MQTT_MESSAGE_DETAILS_LIST*)IoTHubClient_LL_Pool_Alloc(transportState->messageDetailsPool);
+}
+
+static void messageDetails_free(PMQTTTRANSPORT_HANDLE_DATA transportState, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry)
+{
+    if (transportState->messageDetailsPool == NULL)
+    {
+        free(mqttMsgEntry);
+    }
+    else
+    {
+        IoTHubClient_LL_Pool_Free(transportState->messageDetailsPool, mqttMsgEntry);
+    }
+}
+
+static size_t inFlight_slot(const MQTTTRANSPORT_HANDLE_DATA* transportState, uint16_t packetId)
+{
+    size_t mask = transportState->inFlightTableSize - 1;
+    size_t slot = packetId & mask;
+    while ((transportState->inFlightTable[slot] != NULL) && (transportState->inFlightTable[slot]->msgPacketId != packetId))
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static int inFlight_add(PMQTTTRANSPORT_HANDLE_DATA transportState, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry)
+{
+    int result;
+    if ((transportState->inFlightCount + 1) * 2 <= transportState->inFlightTableSize)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t oldSize = transportState->inFlightTableSize;
+        MQTT_MESSAGE_DETAILS_LIST** oldTable = transportState->inFlightTable;
+        MQTT_MESSAGE_DETAILS_LIST** newTable = (MQTT_MESSAGE_DETAILS_LIST**)malloc(2 * oldSize * sizeof(MQTT_MESSAGE_DETAILS_LIST*));
+        if (newTable == NULL)
+        {
+            LogError("Failure allocating the in flight table.");
+            result = __LINE__;
+        }
+        else
+        {
+            size_t index;
+            (void)memset(newTable, 0, 2 * oldSize * sizeof(MQTT_MESSAGE_DETAILS_LIST*));
+            transportState->inFlightTable = newTable;
+            transportState->inFlightTableSize = 2 * oldSize;
+            for (index = 0; index < oldSize; index++)
+            {
+                if (oldTable[index] != NULL)
+                {
+                    newTable[inFlight_slot(transportState, oldTable[index]->msgPacketId)] = oldTable[index];
+                }
+            }
+            if (oldTable != transportState->inFlightInitialTable)
+            {
+                free(oldTable);
+            }
+            result = 0;
+        }
+    }
+
+    if (result == 0)
+    {
+        transportState->inFlightTable[inFlight_slot(transportState, mqttMsgEntry->msgPacketId)] = mqttMsgEntry;
+        transportState->inFlightCount++;
+    }
+    return result;
+}
+
+/*returns the message that was removed, NULL if no message has that packet id*/
+static MQTT_MESSAGE_DETAILS_LIST* inFlight_remove(PMQTTTRANSPORT_HANDLE_DATA transportState, uint16_t packetId)
+{
+    size_t mask = transportState->inFlightTableSize - 1;
+    size_t hole = inFlight_slot(transportState, packetId);
+    MQTT_MESSAGE_DETAILS_LIST* result = transportState->inFlightTable[hole];
+    if (result != NULL)
+    {
+        size_t slot = hole;
+        transportState->inFlightTable[hole] = NULL;
+        transportState->inFlightCount--;
+
+        /*moves back the next messages of the probe sequence that could not be found anymore past the hole*/
+        while (transportState->inFlightTable[slot = (slot + 1) & mask] != NULL)
+        {
+            size_t home = transportState->inFlightTable[slot]->msgPacketId & mask;
+            if (((slot - home) & mask) >= ((slot - hole) & mask))
+            {
+                transportState->inFlightTable[hole] = transportState->inFlightTable[slot];
+                transportState->inFlightTable[slot] = NULL;
+                hole = slot;
+            }
+        }
+    }
+    return result;
+}
+
+/*the in flight window grows like the congestion window of TCP: by one message per PUBACK up to slowStartThreshold, then by
+one message per window of PUBACKs. It is halved, at most once per PUBACK latency since a whole burst comes back late together,
+when a PUBACK comes back much later than usual or a message times out*/
+static void inFlightWindow_decrease(PMQTTTRANSPORT_HANDLE_DATA transportState, uint64_t current_ms)
+{
+    if ((current_ms < transportState->windowDecreaseTime) || (current_ms - transportState->windowDecreaseTime >= transportState->ackLatency))
+    {
+        transportState->slowStartThreshold = (transportState->inFlightWindow > 1) ? transportState->inFlightWindow / 2 : 1;
+        transportState->inFlightWindow = transportState->slowStartThreshold;
+        transportState->windowAckCount = 0;
+        transportState->windowDecreaseTime = current_ms;
+    }
+}
+
+static void inFlightWindow_onAck(PMQTTTRANSPORT_HANDLE_DATA transportState, const MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry)
+{
+    uint64_t current_ms;
+    uint64_t latency;
+    (void)tickcounter_get_current_ms(transportState->msgTickCounter, &current_ms);
+    latency = (current_ms > mqttMsgEntry->msgPublishTime) ? current_ms - mqttMsgEntry->msgPublishTime : 0;
+
+    if ((transportState->ackLatency != 0) &&
+        (latency > LATE_ACK_LATENCY_MIN_MS) &&
+        (latency > LATE_ACK_LATENCY_FACTOR * transportState->ackLatency))
+    {
+        /*Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_027: [A PUBACK that comes back more than 1 second and more than twice the smoothed PUBACK latency after its message was published, or messages that time out during a call to IoTHubTransportMqtt_DoWork, shall halve the window, at most once per smoothed PUBACK latency; the window shall not go below 1.]*/
+        inFlightWindow_decrease(transportState, current_ms);
+    }
+    else if (transportState->inFlightWindow < transportState->maxInFlight)
+    {
+        /*Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_026: [Every PUBACK that does not halve the window shall grow it by 1 while it is below the slow start threshold and by 1 for every window's worth of PUBACKs above it, up to the value of "mqttMaxInFlight".]*/
+        if (transportState->inFlightWindow < transportState->slowStartThreshold)
+        {
+            transportState->inFlightWindow++;
+        }
+        else if (++transportState->windowAckCount >= transportState->inFlightWindow)
+        {
+            transportState->inFlightWindow++;
+            transportState->windowAckCount = 0;
+        }
+    }
+
+    transportState->ackLatency = (transportState->ackLatency == 0) ? latency : (7 * transportState->ackLatency + latency) / 8;
+}
+
 static uint16_t get_next_packet_id(PMQTTTRANSPORT_HANDLE_DATA transportState)
 {
     if (transportState->packetId+1 >= USHRT_MAX)
@@ -157,48 +351,121 @@ static void sendMsgComplete(IOTHUB_MESSAGE_LIST* iothubMsgList, PMQTTTRANSPORT_H
     IoTHubClient_LL_SendComplete(transportState->llClientHandle, &messageCompleted, confirmResult);
 }
 
-static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, const char* eventTopic)
+static bool isUnreservedTopicChar(char c)
+{
+    return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9')) ||
+        (c == '-') || (c == '.') || (c == '_') || (c == '~');
+}
+
+/*appends source URL-encoded at position and returns the new position, the buffer has room for 3 chars per char of source*/
+static size_t appendUrlEncoded(char* buffer, size_t position, const char* source)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+    for (; *source != '\0'; source++)
+    {
+        if (isUnreservedTopicChar(*source))
+        {
+            buffer[position++] = *source;
+        }
+        else
+        {
+            buffer[position++] = '%';
+            buffer[position++] = hexDigits[((unsigned char)*source) >> 4];
+            buffer[position++] = hexDigits[((unsigned char)*source) & 0x0F];
+        }
+    }
+    return position;
+}
+
+/*makes room for propertiesLength chars after the event topic in eventTopicBuffer, copying mqttEventTopic at its start the first time*/
+static int reserveEventTopicBuffer(PMQTTTRANSPORT_HANDLE_DATA transportState, size_t propertiesLength)
 {
-    STRING_HANDLE result = STRING_construct(eventTopic);
-    const char* const* propertyKeys;
-    const char* const* propertyValues;
-    size_t propertyCount;
+    int result;
+    const char* eventTopic = NULL;
+    size_t size;
+    if (transportState->eventTopicBuffer == NULL)
+    {
+        eventTopic = STRING_c_str(transportState->mqttEventTopic);
+        transportState->eventTopicLength = strlen(eventTopic);
+        if (propertiesLength < EVENT_TOPIC_PROPERTIES_LEN + 1)
+        {
+            propertiesLength = EVENT_TOPIC_PROPERTIES_LEN + 1;
+        }
+    }
+
+    size = transportState->eventTopicLength + propertiesLength;
+    if (size <= transportState->eventTopicBufferSize)
+    {
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_020: [If the buffer cannot hold the topic, IoTHubTransportMqtt_DoWork shall grow it with realloc; if realloc fails the message shall not be published, it shall be completed with IOTHUB_CLIENT_CONFIRMATION_ERROR and the buffer shall be kept as it was.]*/
+        char* newBuffer = (char*)realloc(transportState->eventTopicBuffer, size);
+        if (newBuffer == NULL)
+        {
+            LogError("Failure allocating the event topic buffer.");
+            result = __LINE__;
+        }
+        else
+        {
+            if (eventTopic != NULL)
+            {
+                (void)memcpy(newBuffer, eventTopic, transportState->eventTopicLength);
+            }
+            transportState->eventTopicBuffer = newBuffer;
+            transportState->eventTopicBufferSize = size;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_018: [IoTHubTransportMqtt_DoWork shall build the topic of an event in a buffer owned by the transport that starts with the event topic of the device and is reused from one publish to the next, so that publishing does not allocate once the buffer is large enough.]*/
+static const char* buildEventTopic(PMQTTTRANSPORT_HANDLE_DATA transportState, IOTHUB_MESSAGE_HANDLE iothub_message_handle)
+{
+    const char* result;
+    const char* const* propertyKeys = NULL;
+    const char* const* propertyValues = NULL;
+    size_t propertyCount = 0;
 
     // Construct Properties
     MAP_HANDLE properties_map = IoTHubMessage_Properties(iothub_message_handle);
-    if (properties_map != NULL)
+    if ((properties_map != NULL) && (Map_GetInternals(properties_map, &propertyKeys, &propertyValues, &propertyCount) != MAP_OK))
+    {
+        LogError("Failed to get the internals of the property map.");
+        result = NULL;
+    }
+    else
     {
-        if (Map_GetInternals(properties_map, &propertyKeys, &propertyValues, &propertyCount) != MAP_OK)
+        size_t index;
+        size_t propertiesLength = 1;
+        for (index = 0; index < propertyCount; index++)
+        {
+            /*worst case: every char is encoded, plus '=' and '&'*/
+            propertiesLength += 3 * (strlen(propertyKeys[index]) + strlen(propertyValues[index])) + 2;
+        }
+
+        if (reserveEventTopicBuffer(transportState, propertiesLength) != 0)
         {
-            LogError("Failed to get the internals of the property map.");
-            STRING_delete(result);
             result = NULL;
         }
         else
         {
-            if (propertyCount != 0)
+            size_t position = transportState->eventTopicLength;
+            /*Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_019: [The properties of the message shall be appended to the event topic as key=value pairs separated by '&', the keys and the values URL-encoded: every char other than A-Z, a-z, 0-9, '-', '.', '_' and '~' shall be replaced by '%' followed by its 2 uppercase hexadecimal digits.]*/
+            for (index = 0; index < propertyCount; index++)
             {
-                for (size_t index = 0; index < propertyCount && result != NULL; index++)
+                if (index != 0)
                 {
-                    size_t len = strlen(propertyKeys[index]) + strlen(propertyValues[index]) + 2;
-                    char* propValues = malloc(len+1);
-                    if (propValues == NULL)
-                    {
-                        STRING_delete(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        sprintf(propValues, "%s=%s%s", propertyKeys[index], propertyValues[index], propertyCount - 1 == index ? "" : "&");
-                        if (STRING_concat(result, propValues) != 0)
-                        {
-                            STRING_delete(result);
-                            result = NULL;
-                        }
-                        free(propValues);
-                    }
+                    transportState->eventTopicBuffer[position++] = '&';
                 }
+                position = appendUrlEncoded(transportState->eventTopicBuffer, position, propertyKeys[index]);
+                transportState->eventTopicBuffer[position++] = '=';
+                position = appendUrlEncoded(transportState->eventTopicBuffer, position, propertyValues[index]);
             }
+            transportState->eventTopicBuffer[position] = '\0';
+            result = transportState->eventTopicBuffer;
         }
     }
     return result;
@@ -207,34 +474,72 @@ static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_me
 static int publishMqttMessage(PMQTTTRANSPORT_HANDLE_DATA transportState, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len)
 {
     int result;
-    mqttMsgEntry->msgPacketId = get_next_packet_id(transportState);
-    STRING_HANDLE msgTopic = addPropertiesTouMqttMessage(mqttMsgEntry->iotHubMessageEntry->messageHandle, STRING_c_str(transportState->mqttEventTopic));
-    if (msgTopic == NULL)
+    const char* msgTopic;
+    /*a packet id that wrapped around onto a message still waiting for its acknowledgement is skipped*/
+    do
+    {
+        mqttMsgEntry->msgPacketId = get_next_packet_id(transportState);
+    } while (transportState->inFlightTable[inFlight_slot(transportState, mqttMsgEntry->msgPacketId)] != NULL);
+
+    /*Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_021: [IoTHubTransportMqtt_DoWork shall index every message it publishes by its packet id; if the index cannot grow then the message shall not be published and shall be completed with IOTHUB_CLIENT_CONFIRMATION_ERROR.]*/
+    if (inFlight_add(transportState, mqttMsgEntry) != 0)
     {
         result = __LINE__;
     }
+    else if ((msgTopic = buildEventTopic(transportState, mqttMsgEntry->iotHubMessageEntry->messageHandle)) == NULL)
+    {
+        (void)inFlight_remove(transportState, mqttMsgEntry->msgPacketId);
+        result = __LINE__;
+    }
     else
     {
-        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create(mqttMsgEntry->msgPacketId, STRING_c_str(msgTopic), DELIVER_AT_LEAST_ONCE, payload, len);
+        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create(mqttMsgEntry->msgPacketId, msgTopic, DELIVER_AT_LEAST_ONCE, payload, len);
         if (mqttMsg == NULL)
         {
+            (void)inFlight_remove(transportState, mqttMsgEntry->msgPacketId);
             result = __LINE__;
         }
         else
         {
             if (mqtt_client_publish(transportState->mqttClient, mqttMsg) != 0)
             {
+                (void)inFlight_remove(transportState, mqttMsgEntry->msgPacketId);
                 result = __LINE__;
             }
             else
             {
                 mqttMsgEntry->retryCount++;
-                (void)tickcounter_get_current_ms(g_msgTickCounter, &mqttMsgEntry->msgPublishTime);
+                (void)tickcounter_get_current_ms(transportState->msgTickCounter, &mqttMsgEntry->msgPublishTime);
                 result = 0;
             }
             mqttmessage_destroy(mqttMsg);
         }
-        STRING_delete(msgTopic);
+    }
+    return result;
+}
+
+/*Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_029: [An event published at QoS 0 shall not get a message details record, a packet id or a place in the messages waiting for an acknowledgement; it shall be removed from "waitingToSend" and completed with IOTHUB_CLIENT_CONFIRMATION_OK as soon as mqtt_client_publish has written it to the connection, or with IOTHUB_CLIENT_CONFIRMATION_ERROR if the topic cannot be built or the message cannot be created or published.]*/
+static int publishMqttMessageQos0(PMQTTTRANSPORT_HANDLE_DATA transportState, IOTHUB_MESSAGE_HANDLE messageHandle, const unsigned char* payload, size_t len)
+{
+    int result;
+    const char* msgTopic = buildEventTopic(transportState, messageHandle);
+    if (msgTopic == NULL)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        /*a QoS 0 PUBLISH carries no packet id, there is nothing to match a PUBACK with*/
+        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create(0, msgTopic, DELIVER_AT_MOST_ONCE, payload, len);
+        if (mqttMsg == NULL)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            result = (mqtt_client_publish(transportState->mqttClient, mqttMsg) == 0) ? 0 : __LINE__;
+            mqttmessage_destroy(mqttMsg);
+        }
     }
     return result;
 }
@@ -384,20 +689,17 @@ static void MqttOpCompleteCallback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT_EVENT_
                 const PUBLISH_ACK* puback = (const PUBLISH_ACK*)msgInfo;
                 if (puback != NULL)
                 {
-                    PDLIST_ENTRY currentListEntry = transportData->waitingForAck.Flink;
-                    while (currentListEntry != &transportData->waitingForAck)
+                    /*Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_022: [When a PUBACK is received the message with its packet id shall be found through the index, removed from the messages waiting for an acknowledgement and completed with IOTHUB_CLIENT_CONFIRMATION_OK; a PUBACK for no such message shall be ignored.]*/
+                    MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = inFlight_remove(transportData, puback->packetId);
+                    if (mqttMsgEntry != NULL)
                     {
-                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-                        DLIST_ENTRY saveListEntry;
-                        saveListEntry.Flink = currentListEntry->Flink;
-
-                        if (puback->packetId == mqttMsgEntry->msgPacketId)
+                        if (transportData->maxInFlight != 0)
                         {
-                            (void)DList_RemoveEntryList(currentListEntry); //First remove the item from Waiting for Ack List.
-                            sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transportData, IOTHUB_CLIENT_CONFIRMATION_OK);
-                            free(mqttMsgEntry);
+                            inFlightWindow_onAck(transportData, mqttMsgEntry);
                         }
-                        currentListEntry = saveListEntry.Flink;
+                        (void)DList_RemoveEntryList(&(mqttMsgEntry->entry)); //First remove the item from Waiting for Ack List.
+                        sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transportData, IOTHUB_CLIENT_CONFIRMATION_OK);
+                        messageDetails_free(transportData, mqttMsgEntry);
                     }
                 }
                 break;
@@ -411,10 +713,16 @@ static void MqttOpCompleteCallback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT_EVENT_
                     {
                         // The connect packet has been acked
                         transportData->currPacketState = CONNACK_TYPE;
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_031: [After a CONNACK accepting a connection, the first call to IoTHubTransportMqtt_DoWork that can publish shall, before anything else, publish again every message waiting for an acknowledgement, in the order they were published, each with its own packet id and the DUP flag set by mqttmessage_setIsDuplicateMsg, without waiting for the resend timeout and without counting it as a resend.] */
+                        transportData->replayWaitingForAck = true;
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_035: [A CONNACK accepting the connection shall be reported to the retry policy with IoTHubClient_RetryPolicy_OnSuccess.] */
+                        IoTHubClient_RetryPolicy_OnSuccess(&transportData->retryPolicy);
                     }
                     else
                     {
                         LogError("Connection not accepted, return code: %d.", connack->returnCode);
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_034: [A failure of mqtt_client_connect, a CONNACK refusing the connection, MQTT_CLIENT_ON_ERROR and MQTT_CLIENT_NO_PING_RESPONSE shall be reported to the retry policy with IoTHubClient_RetryPolicy_OnFailure.] */
+                        IoTHubClient_RetryPolicy_OnFailure(&transportData->retryPolicy);
                         (void)mqtt_client_disconnect(transportData->mqttClient);
                         transportData->connected = false;
                         transportData->currPacketState = PACKET_TYPE_ERROR;
@@ -460,6 +768,8 @@ static void MqttOpCompleteCallback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT_EVENT_
                 LogError("Mqtt Ping Response was not encountered.  Reconnecting device...");
             case MQTT_CLIENT_ON_ERROR:
             {
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_034: [A failure of mqtt_client_connect, a CONNACK refusing the connection, MQTT_CLIENT_ON_ERROR and MQTT_CLIENT_NO_PING_RESPONSE shall be reported to the retry policy with IoTHubClient_RetryPolicy_OnFailure.] */
+                IoTHubClient_RetryPolicy_OnFailure(&transportData->retryPolicy);
                 xio_close(transportData->xioTransport, NULL, NULL);
                 transportData->connected = false;
                 transportData->subscribed = false;
@@ -554,6 +864,50 @@ static const unsigned char* RetrieveMessagePayload(IOTHUB_MESSAGE_HANDLE message
     return result;
 }
 
+static void replayWaitingForAck(PMQTTTRANSPORT_HANDLE_DATA transportState)
+{
+    PDLIST_ENTRY currentListEntry = transportState->waitingForAck.Flink;
+    if (currentListEntry != &transportState->waitingForAck)
+    {
+        uint64_t current_ms;
+        (void)tickcounter_get_current_ms(transportState->msgTickCounter, &current_ms);
+        while (currentListEntry != &transportState->waitingForAck)
+        {
+            MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
+            size_t messageLength;
+            const unsigned char* messagePayload = RetrieveMessagePayload(mqttMsgEntry->iotHubMessageEntry->messageHandle, &messageLength);
+            const char* msgTopic;
+            MQTT_MESSAGE_HANDLE mqttMsg;
+            if (messageLength == 0 || messagePayload == NULL)
+            {
+                LogError("Failure from creating Message IoTHubMessage_GetData");
+            }
+            else if ((msgTopic = buildEventTopic(transportState, mqttMsgEntry->iotHubMessageEntry->messageHandle)) == NULL)
+            {
+                LogError("Failure building the event topic, the message is left to the resend timeout");
+            }
+            else if ((mqttMsg = mqttmessage_create(mqttMsgEntry->msgPacketId, msgTopic, DELIVER_AT_LEAST_ONCE, messagePayload, messageLength)) == NULL)
+            {
+                LogError("Failure from mqttmessage_create, the message is left to the resend timeout");
+            }
+            else
+            {
+                if ((mqttmessage_setIsDuplicateMsg(mqttMsg, true) != 0) ||
+                    (mqtt_client_publish(transportState->mqttClient, mqttMsg) != 0))
+                {
+                    LogError("Failure publishing the message again, the message is left to the resend timeout");
+                }
+                mqttmessage_destroy(mqttMsg);
+            }
+
+            /*Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_032: [The resend timeout of every message waiting for an acknowledgement shall restart when it is published again after a CONNACK; a message that cannot be published again shall stay waiting for an acknowledgement and be resent when that timeout expires.]*/
+            /*every message gets the same time so that waitingForAck stays in the order of its timeouts*/
+            mqttMsgEntry->msgPublishTime = current_ms;
+            currentListEntry = currentListEntry->Flink;
+        }
+    }
+}
+
 static STRING_HANDLE ConstructSasToken(const char* iothubName, const char* iotHubSuffix, const char* deviceId)
 {
     STRING_HANDLE result;
@@ -684,6 +1038,7 @@ static int SendMqttConnectMsg(PMQTTTRANSPORT_HANDLE_DATA transportState)
             options.password = (char*)STRING_c_str(sasToken);
         }
         options.keepAliveInterval = transportState->keepAliveValue;
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_030: [IoTHubTransportMqtt_DoWork shall connect with useCleanSession set to false, so that IoT Hub keeps the session of the device across connections.] */
         options.useCleanSession = false;
         options.qualityOfServiceValue = DELIVER_AT_LEAST_ONCE;
 
@@ -696,7 +1051,7 @@ static int SendMqttConnectMsg(PMQTTTRANSPORT_HANDLE_DATA transportState)
             }
             else
             {
-                (void)tickcounter_get_current_ms(g_msgTickCounter, &transportState->mqtt_connect_time);
+                (void)tickcounter_get_current_ms(transportState->msgTickCounter, &transportState->mqtt_connect_time);
                 result = 0;
             }
         }
@@ -721,34 +1076,30 @@ static int InitializeConnection(PMQTTTRANSPORT_HANDLE_DATA transportState)
         // to back off the connecting to the server
         if (!transportState->connected)
         {
-            // Default makeConnection as true if something goes wrong we'll make the connection
-            bool makeConnection = true;
-            // If we've failed for FAILED_CONN_BACKOFF_VALUE straight times them let's slow down connection
-            // to the service
-            if (transportState->connectFailCount > FAILED_CONN_BACKOFF_VALUE)
+            uint64_t currentTick;
+            // If the tick counter fails we'll make the connection
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_036: [When it is not connected, IoTHubTransportMqtt_DoWork shall get the current time with tickcounter_get_current_ms and connect only if IoTHubClient_RetryPolicy_CanAttempt returns true for that time.] */
+            if ((tickcounter_get_current_ms(transportState->msgTickCounter, &currentTick) == 0) &&
+                !IoTHubClient_RetryPolicy_CanAttempt(&transportState->retryPolicy, currentTick))
+            {
+                result = __LINE__;
+            }
+            else
             {
-                uint64_t currentTick;
-                if (tickcounter_get_current_ms(g_msgTickCounter, &currentTick) == 0)
+                if (IoTHubClient_RetryPolicy_IsWaiting(&transportState->retryPolicy))
                 {
-                    if ( ((currentTick - transportState->connectTick)/1000) <= DEFAULT_CONNECTION_INTERVAL)
-                    {
-                        result = __LINE__;
-                        makeConnection = false;
-                    }
+                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_041: [IoTHubTransportMqtt_DoWork shall count with IoTHubClient_LL_CountRetry every connection it attempts while the retry policy is waiting and every message it publishes again because its PUBACK did not come in time.] */
+                    IoTHubClient_LL_CountRetry(transportState->llClientHandle);
                 }
-            }
 
-            if (makeConnection)
-            {
-                (void)tickcounter_get_current_ms(g_msgTickCounter, &transportState->connectTick);
                 if (SendMqttConnectMsg(transportState) != 0)
                 {
-                    transportState->connectFailCount++;
+                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_034: [A failure of mqtt_client_connect, a CONNACK refusing the connection, MQTT_CLIENT_ON_ERROR and MQTT_CLIENT_NO_PING_RESPONSE shall be reported to the retry policy with IoTHubClient_RetryPolicy_OnFailure.] */
+                    IoTHubClient_RetryPolicy_OnFailure(&transportState->retryPolicy);
                     result = __LINE__;
                 }
                 else
                 {
-                    transportState->connectFailCount = 0;
                     transportState->connected = true;
                     result = 0;
                 }
@@ -759,7 +1110,7 @@ static int InitializeConnection(PMQTTTRANSPORT_HANDLE_DATA transportState)
         {
             // We are connected and not being closed, so does SAS need to reconnect?
             uint64_t current_time;
-            (void)tickcounter_get_current_ms(g_msgTickCounter, &current_time);
+            (void)tickcounter_get_current_ms(transportState->msgTickCounter, &current_time);
             if ((current_time - transportState->mqtt_connect_time) / 1000 > (SAS_TOKEN_DEFAULT_LIFETIME*SAS_REFRESH_MULTIPLIER))
             {
                 (void)mqtt_client_disconnect(transportState->mqttClient);
@@ -969,8 +1320,28 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
                     state->waitingToSend = waitingToSend;
                     state->currPacketState = CONNECT_TYPE;
                     state->keepAliveValue = DEFAULT_MQTT_KEEPALIVE;
-                    state->connectFailCount = 0;
-                    state->connectTick = 0;
+                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_033: [IoTHubTransportMqtt_Create shall initialize the retry policy of the connection with IoTHubClient_RetryPolicy_Init and seed it with the device id by calling IoTHubClient_RetryPolicy_Seed.] */
+                    IoTHubClient_RetryPolicy_Init(&state->retryPolicy);
+                    IoTHubClient_RetryPolicy_Seed(&state->retryPolicy, upperConfig->deviceId);
+                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_001: [By default there shall be no message details pool and every MQTT_MESSAGE_DETAILS_LIST record shall be allocated with malloc.] */
+                    state->messageDetailsPool = NULL;
+                    state->eventTopicBuffer = NULL;
+                    state->eventTopicBufferSize = 0;
+                    state->eventTopicLength = 0;
+                    (void)memset(state->inFlightInitialTable, 0, sizeof(state->inFlightInitialTable));
+                    state->inFlightTable = state->inFlightInitialTable;
+                    state->inFlightTableSize = IN_FLIGHT_TABLE_INITIAL_LEN;
+                    state->inFlightCount = 0;
+                    state->maxInFlight = 0;
+                    state->inFlightWindow = 0;
+                    state->slowStartThreshold = 0;
+                    state->windowAckCount = 0;
+                    state->ackLatency = 0;
+                    state->windowDecreaseTime = 0;
+                    state->telemetryQos0 = false;
+                    state->replayWaitingForAck = false;
+                    state->isMultiplexer = false;
+                    state->multiplexer = NULL;
                 }
             }
         }
@@ -978,10 +1349,83 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
     return state;
 }
 
+static bool IsMultiplexer(TRANSPORT_LL_HANDLE handle)
+{
+    return ((const MQTTTRANSPORT_MULTIPLEXER_DATA*)handle)->isMultiplexer;
+}
+
+static MQTTTRANSPORT_MULTIPLEXER_DATA* CreateMultiplexer(const IOTHUB_CLIENT_CONFIG* upperConfig)
+{
+    MQTTTRANSPORT_MULTIPLEXER_DATA* result;
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_008: [If the upperConfig's variables protocol, iotHubName or iotHubSuffix are NULL, or iotHubName is an empty string, then IoTHubTransportMqtt_Create shall return NULL.] */
+    if (upperConfig->protocol == NULL ||
+        upperConfig->iotHubName == NULL ||
+        upperConfig->iotHubSuffix == NULL ||
+        strlen(upperConfig->iotHubName) == 0)
+    {
+        LogError("Invalid Argument: upperConfig structure contains an invalid parameter");
+        result = NULL;
+    }
+    else if ((result = (MQTTTRANSPORT_MULTIPLEXER_DATA*)malloc(sizeof(MQTTTRANSPORT_MULTIPLEXER_DATA))) == NULL)
+    {
+        LogError("Could not create MQTT transport state. Memory allocation failed.");
+    }
+    else if ((result->iotHubName = STRING_construct(upperConfig->iotHubName)) == NULL)
+    {
+        LogError("failure constructing iotHubName.");
+        free(result);
+        result = NULL;
+    }
+    else if ((result->iotHubSuffix = STRING_construct(upperConfig->iotHubSuffix)) == NULL)
+    {
+        LogError("failure constructing iotHubSuffix.");
+        STRING_delete(result->iotHubName);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        char tempAddress[DEFAULT_TEMP_STRING_LEN];
+        (void)snprintf(tempAddress, DEFAULT_TEMP_STRING_LEN, "%s.%s", upperConfig->iotHubName, upperConfig->iotHubSuffix);
+        if ((result->hostAddress = STRING_construct(tempAddress)) == NULL)
+        {
+            LogError("failure constructing host address.");
+            STRING_delete(result->iotHubSuffix);
+            STRING_delete(result->iotHubName);
+            free(result);
+            result = NULL;
+        }
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_038: [IoTHubTransportMqtt_Create shall create a tick counter for the transport with tickcounter_create, used by it only (for a transport created with no device, by every device registered on it).] */
+        else if ((result->msgTickCounter = tickcounter_create()) == NULL)
+        {
+            LogError("failure creating the tick counter.");
+            STRING_delete(result->hostAddress);
+            STRING_delete(result->iotHubSuffix);
+            STRING_delete(result->iotHubName);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->isMultiplexer = true;
+            result->protocol = upperConfig->protocol;
+            result->keepAliveValue = DEFAULT_MQTT_KEEPALIVE;
+            result->logTrace = false;
+            result->messagePoolSize = 0;
+            result->maxInFlight = 0;
+            result->telemetryQos0 = false;
+            IoTHubClient_RetryPolicy_Init(&result->retryPolicy);
+            DList_InitializeListHead(&(result->devices));
+        }
+    }
+    return result;
+}
+
 static TRANSPORT_LL_HANDLE IoTHubTransportMqtt_Create(const IOTHUBTRANSPORT_CONFIG* config)
 {
-    PMQTTTRANSPORT_HANDLE_DATA result;
+    TRANSPORT_LL_HANDLE result;
     size_t deviceIdSize;
+    TICK_COUNTER_HANDLE msgTickCounter;
 
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_001: [If parameter config is NULL then IoTHubTransportMqtt_Create shall return NULL.] */
     if (config == NULL)
@@ -989,6 +1433,13 @@ static TRANSPORT_LL_HANDLE IoTHubTransportMqtt_Create(const IOTHUBTRANSPORT_CONF
         LogError("Invalid Argument: Config Parameter is NULL.");
         result = NULL;
     }
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_007: [If the upperConfig's deviceId and the config's waitingToSend are both NULL then IoTHubTransportMqtt_Create shall create a transport with no device of its own, on which devices are added by IoTHubTransportMqtt_Register.] */
+    else if (config->upperConfig != NULL &&
+             config->upperConfig->deviceId == NULL &&
+             config->waitingToSend == NULL)
+    {
+        result = CreateMultiplexer(config->upperConfig);
+    }
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_002: [If the parameter config's variables upperConfig or waitingToSend are NULL then IoTHubTransportMqtt_Create shall return NULL.] */
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [If the upperConfig's variables deviceId, both deviceKey and deviceSasToken, iotHubName, protocol, or iotHubSuffix are NULL then IoTHubTransportMqtt_Create shall return NULL.] */
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_03_003: [If both deviceKey & deviceSasToken fields are NOT NULL then IoTHubTransportMqtt_Create shall return NULL.] */
@@ -1032,17 +1483,24 @@ static TRANSPORT_LL_HANDLE IoTHubTransportMqtt_Create(const IOTHUBTRANSPORT_CONF
         LogError("Invalid Argument: iotHubName is empty");
         result = NULL;
     }
-    else if ((g_msgTickCounter = tickcounter_create()) == NULL)
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_038: [IoTHubTransportMqtt_Create shall create a tick counter for the transport with tickcounter_create, used by it only (for a transport created with no device, by every device registered on it).] */
+    else if ((msgTickCounter = tickcounter_create()) == NULL)
     {
-        LogError("Invalid Argument: iotHubName is empty");
+        LogError("failure creating the tick counter.");
         result = NULL;
     }
     else
     {
-        result = InitializeTransportHandleData(config->upperConfig, config->waitingToSend);
-        if (result == NULL)
+        PMQTTTRANSPORT_HANDLE_DATA transportState = InitializeTransportHandleData(config->upperConfig, config->waitingToSend);
+        if (transportState == NULL)
+        {
+            tickcounter_destroy(msgTickCounter);
+            result = NULL;
+        }
+        else
         {
-            tickcounter_destroy(g_msgTickCounter);
+            transportState->msgTickCounter = msgTickCounter;
+            result = transportState;
         }
     }
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_009: [If any error is encountered then IoTHubTransportMqtt_Create shall return NULL.] */
@@ -1060,10 +1518,9 @@ static void DisconnectFromClient(PMQTTTRANSPORT_HANDLE_DATA transportState)
     transportState->currPacketState = DISCONNECT_TYPE;
 }
 
-static void IoTHubTransportMqtt_Destroy(TRANSPORT_LL_HANDLE handle)
+/*completes the messages waiting for an acknowledgement and frees the device state, the tick counter is left to its owner*/
+static void DestroyDeviceState(PMQTTTRANSPORT_HANDLE_DATA transportState)
 {
-    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_012: [IoTHubTransportMqtt_Destroy shall do nothing if parameter handle is NULL.] */
-    PMQTTTRANSPORT_HANDLE_DATA transportState = (PMQTTTRANSPORT_HANDLE_DATA)handle;
     if (transportState != NULL)
     {
         transportState->destroyCalled = true;
@@ -1076,7 +1533,11 @@ static void IoTHubTransportMqtt_Destroy(TRANSPORT_LL_HANDLE handle)
             PDLIST_ENTRY currentEntry = DList_RemoveHeadList(&transportState->waitingForAck);
             MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
             sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transportState, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
-            free(mqttMsgEntry);
+            messageDetails_free(transportState, mqttMsgEntry);
+        }
+        if (transportState->inFlightTable != transportState->inFlightInitialTable)
+        {
+            free(transportState->inFlightTable);
         }
 
         switch (transportState->transport_creds.credential_type)
@@ -1100,11 +1561,49 @@ static void IoTHubTransportMqtt_Destroy(TRANSPORT_LL_HANDLE handle)
         STRING_delete(transportState->device_id);
         STRING_delete(transportState->hostAddress);
         STRING_delete(transportState->configPassedThroughUsername);
-        tickcounter_destroy(g_msgTickCounter);
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_006: [IoTHubTransportMqtt_Destroy shall destroy the message details pool, if any, after the messages waiting for an acknowledgement have been completed.] */
+        if (transportState->messageDetailsPool != NULL)
+        {
+            IoTHubClient_LL_Pool_Destroy(transportState->messageDetailsPool);
+        }
+        if (transportState->eventTopicBuffer != NULL)
+        {
+            free(transportState->eventTopicBuffer);
+        }
         free(transportState);
     }
 }
 
+static void IoTHubTransportMqtt_Destroy(TRANSPORT_LL_HANDLE handle)
+{
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_012: [IoTHubTransportMqtt_Destroy shall do nothing if parameter handle is NULL.] */
+    if (handle != NULL)
+    {
+        if (IsMultiplexer(handle))
+        {
+            MQTTTRANSPORT_MULTIPLEXER_DATA* multiplexer = (MQTTTRANSPORT_MULTIPLEXER_DATA*)handle;
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_016: [IoTHubTransportMqtt_Destroy shall destroy every device still registered on a transport created with no device as IoTHubTransportMqtt_Unregister does, then free the transport.] */
+            while (!DList_IsListEmpty(&multiplexer->devices))
+            {
+                PDLIST_ENTRY currentEntry = DList_RemoveHeadList(&multiplexer->devices);
+                DestroyDeviceState(containingRecord(currentEntry, MQTTTRANSPORT_HANDLE_DATA, multiplexerEntry));
+            }
+            STRING_delete(multiplexer->hostAddress);
+            STRING_delete(multiplexer->iotHubSuffix);
+            STRING_delete(multiplexer->iotHubName);
+            tickcounter_destroy(multiplexer->msgTickCounter);
+            free(multiplexer);
+        }
+        else
+        {
+            TICK_COUNTER_HANDLE msgTickCounter = ((PMQTTTRANSPORT_HANDLE_DATA)handle)->msgTickCounter;
+            DestroyDeviceState((PMQTTTRANSPORT_HANDLE_DATA)handle);
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_039: [IoTHubTransportMqtt_Destroy shall destroy the tick counter of the transport with tickcounter_destroy after the device states.] */
+            tickcounter_destroy(msgTickCounter);
+        }
+    }
+}
+
 static int IoTHubTransportMqtt_Subscribe(IOTHUB_DEVICE_HANDLE handle)
 {
     int result;
@@ -1151,11 +1650,29 @@ static void IoTHubTransportMqtt_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
     }
 }
 
+static void IoTHubTransportMqtt_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle);
+
+static void DoMultiplexerWork(MQTTTRANSPORT_MULTIPLEXER_DATA* multiplexer)
+{
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_013: [On a transport created with no device, IoTHubTransportMqtt_DoWork shall do the work of every registered device in turn, each on its own MQTT connection and with the IOTHUB_CLIENT_LL_HANDLE given to IoTHubTransportMqtt_Register; iotHubClientHandle shall not be used and may be NULL.] */
+    PDLIST_ENTRY currentListEntry = multiplexer->devices.Flink;
+    while (currentListEntry != &multiplexer->devices)
+    {
+        PMQTTTRANSPORT_HANDLE_DATA transportState = containingRecord(currentListEntry, MQTTTRANSPORT_HANDLE_DATA, multiplexerEntry);
+        currentListEntry = currentListEntry->Flink;
+        IoTHubTransportMqtt_DoWork(transportState, transportState->llClientHandle);
+    }
+}
+
 static void IoTHubTransportMqtt_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_026: [IoTHubTransportMqtt_DoWork shall do nothing if parameter handle and/or iotHubClientHandle is NULL.] */
     PMQTTTRANSPORT_HANDLE_DATA transportState = (PMQTTTRANSPORT_HANDLE_DATA)handle;
-    if (transportState != NULL && iotHubClientHandle != NULL)
+    if (transportState != NULL && IsMultiplexer(transportState))
+    {
+        DoMultiplexerWork((MQTTTRANSPORT_MULTIPLEXER_DATA*)handle);
+    }
+    else if (transportState != NULL && iotHubClientHandle != NULL)
     {
         transportState->llClientHandle = iotHubClientHandle;
 
@@ -1176,24 +1693,41 @@ static void IoTHubTransportMqtt_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
             }
             else if (transportState->currPacketState == PUBLISH_TYPE)
             {
-                PDLIST_ENTRY currentListEntry = transportState->waitingForAck.Flink;
-                while (currentListEntry != &transportState->waitingForAck)
+                PDLIST_ENTRY currentListEntry;
+                if (transportState->replayWaitingForAck)
                 {
-                    MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-                    DLIST_ENTRY nextListEntry;
-                    nextListEntry.Flink = currentListEntry->Flink;
+                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_031: [After a CONNACK accepting a connection, the first call to IoTHubTransportMqtt_DoWork that can publish shall, before anything else, publish again every message waiting for an acknowledgement, in the order they were published, each with its own packet id and the DUP flag set by mqttmessage_setIsDuplicateMsg, without waiting for the resend timeout and without counting it as a resend.] */
+                    replayWaitingForAck(transportState);
+                    transportState->replayWaitingForAck = false;
+                }
 
+                currentListEntry = transportState->waitingForAck.Flink;
+                if (currentListEntry != &transportState->waitingForAck)
+                {
                     uint64_t current_ms;
-                    (void)tickcounter_get_current_ms(g_msgTickCounter, &current_ms);
-                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_033: [IoTHubTransportMqtt_DoWork shall iterate through the Waiting Acknowledge messages looking for any message that has been waiting longer than 2 min.]*/
-                    if (((current_ms - mqttMsgEntry->msgPublishTime) / 1000) > RESEND_TIMEOUT_VALUE_MIN)
+                    bool timedOut = false;
+                    (void)tickcounter_get_current_ms(transportState->msgTickCounter, &current_ms);
+                    while (currentListEntry != &transportState->waitingForAck)
                     {
+                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
+                        DLIST_ENTRY nextListEntry;
+                        nextListEntry.Flink = currentListEntry->Flink;
+
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_033: [IoTHubTransportMqtt_DoWork shall iterate through the Waiting Acknowledge messages looking for any message that has been waiting longer than 2 min.]*/
+                        if ((current_ms < mqttMsgEntry->msgPublishTime) || (((current_ms - mqttMsgEntry->msgPublishTime) / 1000) <= RESEND_TIMEOUT_VALUE_MIN))
+                        {
+                            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_023: [The messages waiting for an acknowledgement shall be kept in the order they were last published, a resent message going last, and IoTHubTransportMqtt_DoWork shall stop looking for timed out messages at the first one that has not timed out.]*/
+                            break;
+                        }
+                        timedOut = true;
+
                         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_034: [If IoTHubTransportMqtt_DoWork has resent the message two times then it shall fail the message] */
                         if (mqttMsgEntry->retryCount >= MAX_SEND_RECOUNT_LIMIT)
                         {
+                            (void)inFlight_remove(transportState, mqttMsgEntry->msgPacketId);
                             (void)DList_RemoveEntryList(currentListEntry);
                             sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transportState, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
-                            free(mqttMsgEntry);
+                            messageDetails_free(transportState, mqttMsgEntry);
                         }
                         else
                         {
@@ -1205,21 +1739,38 @@ static void IoTHubTransportMqtt_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
                             }
                             else
                             {
+                                /*the message is resent with a new packet id*/
+                                (void)inFlight_remove(transportState, mqttMsgEntry->msgPacketId);
                                 if (publishMqttMessage(transportState, mqttMsgEntry, messagePayload, messageLength) != 0)
                                 {
                                     (void)DList_RemoveEntryList(currentListEntry);
                                     sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transportState, IOTHUB_CLIENT_CONFIRMATION_ERROR);
-                                    free(mqttMsgEntry);
+                                    messageDetails_free(transportState, mqttMsgEntry);
+                                }
+                                else
+                                {
+                                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_041: [IoTHubTransportMqtt_DoWork shall count with IoTHubClient_LL_CountRetry every connection it attempts while the retry policy is waiting and every message it publishes again because its PUBACK did not come in time.] */
+                                    IoTHubClient_LL_CountRetry(transportState->llClientHandle);
+                                    (void)DList_RemoveEntryList(currentListEntry);
+                                    DList_InsertTailList(&(transportState->waitingForAck), currentListEntry);
                                 }
                             }
                         }
+                        currentListEntry = nextListEntry.Flink;
+                    }
+
+                    if (timedOut && (transportState->maxInFlight != 0))
+                    {
+                        /*Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_027: [A PUBACK that comes back more than 1 second and more than twice the smoothed PUBACK latency after its message was published, or messages that time out during a call to IoTHubTransportMqtt_DoWork, shall halve the window, at most once per smoothed PUBACK latency; the window shall not go below 1.]*/
+                        inFlightWindow_decrease(transportState, current_ms);
                     }
-                    currentListEntry = nextListEntry.Flink;
                 }
 
                 currentListEntry = transportState->waitingToSend->Flink;
                 /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_027: [IoTHubTransportMqtt_DoWork shall inspect the waitingToSend DLIST passed in config structure.] */
-                while (currentListEntry != transportState->waitingToSend)
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_025: [When "mqttMaxInFlight" is set, IoTHubTransportMqtt_DoWork shall only publish messages of "waitingToSend" while fewer messages than the window are waiting for an acknowledgement; the others shall stay in "waitingToSend" for a later call.] */
+                while ((currentListEntry != transportState->waitingToSend) &&
+                    ((transportState->maxInFlight == 0) || (transportState->inFlightCount < transportState->inFlightWindow)))
                 {
                     IOTHUB_MESSAGE_LIST* iothubMsgList = containingRecord(currentListEntry, IOTHUB_MESSAGE_LIST, entry);
                     DLIST_ENTRY savedFromCurrentListEntry;
@@ -1232,10 +1783,18 @@ static void IoTHubTransportMqtt_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
                     {
                         LogError("Failure result from IoTHubMessage_GetData");
                     }
+                    else if (transportState->telemetryQos0)
+                    {
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_029: [An event published at QoS 0 shall not get a message details record, a packet id or a place in the messages waiting for an acknowledgement; it shall be removed from "waitingToSend" and completed with IOTHUB_CLIENT_CONFIRMATION_OK as soon as mqtt_client_publish has written it to the connection, or with IOTHUB_CLIENT_CONFIRMATION_ERROR if the topic cannot be built or the message cannot be created or published.] */
+                        IOTHUB_CLIENT_CONFIRMATION_RESULT confirmResult = (publishMqttMessageQos0(transportState, iothubMsgList->messageHandle, messagePayload, messageLength) == 0) ?
+                            IOTHUB_CLIENT_CONFIRMATION_OK : IOTHUB_CLIENT_CONFIRMATION_ERROR;
+                        (void)(DList_RemoveEntryList(currentListEntry));
+                        sendMsgComplete(iothubMsgList, transportState, confirmResult);
+                    }
                     else
                     {
                         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_029: [IoTHubTransportMqtt_DoWork shall create a MQTT_MESSAGE_HANDLE and pass this to a call to mqtt_client_publish.] */
-                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)malloc(sizeof(MQTT_MESSAGE_DETAILS_LIST));
+                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = messageDetails_alloc(transportState);
                         if (mqttMsgEntry == NULL)
                         {
                             LogError("Allocation Error: Failure allocating MQTT Message Detail List.");
@@ -1248,12 +1807,14 @@ static void IoTHubTransportMqtt_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
                             {
                                 (void)(DList_RemoveEntryList(currentListEntry));
                                 sendMsgComplete(iothubMsgList, transportState, IOTHUB_CLIENT_CONFIRMATION_ERROR);
-                                free(mqttMsgEntry);
+                                messageDetails_free(transportState, mqttMsgEntry);
                             }
                             else
                             {
                                 (void)(DList_RemoveEntryList(currentListEntry));
                                 DList_InsertTailList(&(transportState->waitingForAck), &(mqttMsgEntry->entry));
+                                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_040: [IoTHubTransportMqtt_DoWork shall suspend the timeout of a message it published and moved to the waiting for acknowledge list using IoTHubClient_LL_SuspendMessageTimeout.] */
+                                IoTHubClient_LL_SuspendMessageTimeout(iothubMsgList);
                             }
                         }
                     }
@@ -1294,6 +1855,63 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_GetSendStatus(IOTHUB_DEVICE_HAND
     return result;
 }
 
+static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value);
+
+static IOTHUB_CLIENT_RESULT SetMultiplexerOption(MQTTTRANSPORT_MULTIPLEXER_DATA* multiplexer, const char* option, const void* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_014: [On a transport created with no device, IoTHubTransportMqtt_SetOption shall return IOTHUB_CLIENT_INVALID_ARG for the "x509certificate" and "x509privatekey" options.] */
+    if ((strcmp(OPTION_X509_CERT, option) == 0) || (strcmp(OPTION_X509_PRIVATE_KEY, option) == 0))
+    {
+        LogError("%s specified, but the devices of a shared transport do not use x509 authentication", option);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_015: [Otherwise IoTHubTransportMqtt_SetOption shall set the option on every registered device as it does on a transport created with a device and return the first failure, or IOTHUB_CLIENT_OK. A "logtrace", "keepalive", "mqttMessagePoolSize", "mqttMaxInFlight", "mqttTelemetryQos0", "retryInitialDelay" or "retryMaxDelay" value set with success shall also be applied to the devices registered later.] */
+        PDLIST_ENTRY currentListEntry = multiplexer->devices.Flink;
+        result = IOTHUB_CLIENT_OK;
+        while (currentListEntry != &multiplexer->devices)
+        {
+            IOTHUB_CLIENT_RESULT deviceResult = IoTHubTransportMqtt_SetOption(containingRecord(currentListEntry, MQTTTRANSPORT_HANDLE_DATA, multiplexerEntry), option, value);
+            if ((deviceResult != IOTHUB_CLIENT_OK) && (result == IOTHUB_CLIENT_OK))
+            {
+                result = deviceResult;
+            }
+            currentListEntry = currentListEntry->Flink;
+        }
+
+        if (result == IOTHUB_CLIENT_OK)
+        {
+            if (strcmp(OPTION_LOG_TRACE, option) == 0)
+            {
+                multiplexer->logTrace = *(const bool*)value;
+            }
+            else if (strcmp(OPTION_KEEP_ALIVE, option) == 0)
+            {
+                multiplexer->keepAliveValue = (uint16_t)(*(const int*)value);
+            }
+            else if (strcmp(OPTION_MQTT_MESSAGE_POOL_SIZE, option) == 0)
+            {
+                multiplexer->messagePoolSize = *(const size_t*)value;
+            }
+            else if (strcmp(OPTION_MQTT_MAX_IN_FLIGHT, option) == 0)
+            {
+                multiplexer->maxInFlight = *(const size_t*)value;
+            }
+            else if (strcmp(OPTION_MQTT_TELEMETRY_QOS0, option) == 0)
+            {
+                multiplexer->telemetryQos0 = *(const bool*)value;
+            }
+            else
+            {
+                (void)IoTHubClient_RetryPolicy_SetOption(&multiplexer->retryPolicy, option, value);
+            }
+        }
+    }
+    return result;
+}
+
 static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
 {
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_021: [If any parameter is NULL then IoTHubTransportMqtt_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
@@ -1307,6 +1925,10 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_SetOption(TRANSPORT_LL_HANDLE ha
         result = IOTHUB_CLIENT_INVALID_ARG;
         LogError("invalid parameter (NULL) passed to clientTransportAMQP_SetOption.");
     }
+    else if (IsMultiplexer(handle))
+    {
+        result = SetMultiplexerOption((MQTTTRANSPORT_MULTIPLEXER_DATA*)handle, option, value);
+    }
     else
     {
         MQTTTRANSPORT_HANDLE_DATA* transportState = (MQTTTRANSPORT_HANDLE_DATA*)handle;
@@ -1333,6 +1955,55 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_SetOption(TRANSPORT_LL_HANDLE ha
             }
             result = IOTHUB_CLIENT_OK;
         }
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_002: [If the option parameter is set to "mqttMessagePoolSize" then the value shall be a size_t_ptr. IoTHubTransportMqtt_SetOption shall replace the message details pool by a pool of that many records created with IoTHubClient_LL_Pool_Create, a value of 0 shall only remove the pool.] */
+        else if (strcmp(OPTION_MQTT_MESSAGE_POOL_SIZE, option) == 0)
+        {
+            IOTHUB_CLIENT_POOL_STATISTICS poolStatistics;
+            IOTHUB_CLIENT_LL_POOL_HANDLE newPool = NULL;
+            size_t poolSize = *(const size_t*)value;
+            if ((transportState->messageDetailsPool != NULL) &&
+                ((IoTHubClient_LL_Pool_GetStatistics(transportState->messageDetailsPool, &poolStatistics) != 0) || (poolStatistics.inUse != 0)))
+            {
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_004: [If records of the current message details pool are in use then IoTHubTransportMqtt_SetOption shall return IOTHUB_CLIENT_ERROR.] */
+                LogError("mqttMessagePoolSize cannot be changed while messages are waiting for an acknowledgement");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if ((poolSize != 0) && ((newPool = IoTHubClient_LL_Pool_Create(sizeof(MQTT_MESSAGE_DETAILS_LIST), poolSize)) == NULL))
+            {
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_005: [If IoTHubClient_LL_Pool_Create fails then IoTHubTransportMqtt_SetOption shall return IOTHUB_CLIENT_ERROR and keep the current message details pool.] */
+                LogError("unable to create a message details pool of %zu records", poolSize);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (transportState->messageDetailsPool != NULL)
+                {
+                    IoTHubClient_LL_Pool_Destroy(transportState->messageDetailsPool);
+                }
+                transportState->messageDetailsPool = newPool;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_024: [If the option parameter is set to "mqttMaxInFlight" then the value shall be a size_t_ptr, the most messages IoTHubTransportMqtt_DoWork keeps waiting for an acknowledgement. The window of messages in flight shall restart from 4, or from the value if it is smaller, and a value of 0 shall remove the limit.] */
+        else if (strcmp(OPTION_MQTT_MAX_IN_FLIGHT, option) == 0)
+        {
+            transportState->maxInFlight = *(const size_t*)value;
+            transportState->inFlightWindow = (transportState->maxInFlight < IN_FLIGHT_WINDOW_INITIAL) ? transportState->maxInFlight : IN_FLIGHT_WINDOW_INITIAL;
+            transportState->slowStartThreshold = transportState->maxInFlight;
+            transportState->windowAckCount = 0;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_028: [If the option parameter is set to "mqttTelemetryQos0" then the value shall be a bool_ptr; when it is true IoTHubTransportMqtt_DoWork shall publish the events that it takes from "waitingToSend" afterwards at QoS 0 (DELIVER_AT_MOST_ONCE) instead of QoS 1.] */
+        else if (strcmp(OPTION_MQTT_TELEMETRY_QOS0, option) == 0)
+        {
+            transportState->telemetryQos0 = *(const bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_037: [If the option parameter is set to "retryInitialDelay" or "retryMaxDelay" then the value shall be a size_t_ptr in milliseconds and IoTHubTransportMqtt_SetOption shall pass it to IoTHubClient_RetryPolicy_SetOption and return IOTHUB_CLIENT_OK.] */
+        else if (IoTHubClient_RetryPolicy_SetOption(&transportState->retryPolicy, option, value))
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_039: [If the option parameter is set to "x509certificate" then the value shall be a const char of the certificate to be used for x509.] */
         else if ((strcmp(OPTION_X509_CERT, option) == 0) && (transportState->transport_creds.credential_type != X509))
         {
@@ -1369,10 +2040,110 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_SetOption(TRANSPORT_LL_HANDLE ha
     return result;
 }
 
+static PMQTTTRANSPORT_HANDLE_DATA FindDevice(MQTTTRANSPORT_MULTIPLEXER_DATA* multiplexer, const char* deviceId)
+{
+    PMQTTTRANSPORT_HANDLE_DATA result = NULL;
+    PDLIST_ENTRY currentListEntry = multiplexer->devices.Flink;
+    while (currentListEntry != &multiplexer->devices)
+    {
+        PMQTTTRANSPORT_HANDLE_DATA transportState = containingRecord(currentListEntry, MQTTTRANSPORT_HANDLE_DATA, multiplexerEntry);
+        if (strcmp(STRING_c_str(transportState->device_id), deviceId) == 0)
+        {
+            result = transportState;
+            break;
+        }
+        currentListEntry = currentListEntry->Flink;
+    }
+    return result;
+}
+
+static IOTHUB_DEVICE_HANDLE RegisterOnMultiplexer(MQTTTRANSPORT_MULTIPLEXER_DATA* multiplexer, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
+{
+    IOTHUB_DEVICE_HANDLE result;
+    size_t deviceIdSize;
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_009: [On a transport created with no device, IoTHubTransportMqtt_Register shall return NULL if iotHubClientHandle is NULL, if deviceId is an empty string or longer than 128, if deviceKey or deviceSasToken is an empty string, if both deviceKey and deviceSasToken are NULL or if a device with the same deviceId is registered.] */
+    if (iotHubClientHandle == NULL)
+    {
+        LogError("IoTHubTransportMqtt_Register: iotHubClientHandle is NULL.");
+        result = NULL;
+    }
+    else if (((deviceIdSize = strlen(device->deviceId)) > 128U) || (deviceIdSize == 0))
+    {
+        LogError("IoTHubTransportMqtt_Register: deviceId is of an invalid size.");
+        result = NULL;
+    }
+    else if ((device->deviceKey == NULL) && (device->deviceSasToken == NULL))
+    {
+        LogError("IoTHubTransportMqtt_Register: x509 authentication is not supported on a shared transport.");
+        result = NULL;
+    }
+    else if (((device->deviceKey != NULL) && (strlen(device->deviceKey) == 0)) ||
+             ((device->deviceSasToken != NULL) && (strlen(device->deviceSasToken) == 0)))
+    {
+        LogError("IoTHubTransportMqtt_Register: deviceKey or deviceSasToken is empty.");
+        result = NULL;
+    }
+    else if (FindDevice(multiplexer, device->deviceId) != NULL)
+    {
+        LogError("Transport already has device registered by id: [%s]", device->deviceId);
+        result = NULL;
+    }
+    else
+    {
+        IOTHUB_CLIENT_CONFIG upperConfig;
+        PMQTTTRANSPORT_HANDLE_DATA transportState;
+        upperConfig.protocol = multiplexer->protocol;
+        upperConfig.deviceId = device->deviceId;
+        upperConfig.deviceKey = device->deviceKey;
+        upperConfig.deviceSasToken = device->deviceSasToken;
+        upperConfig.iotHubName = STRING_c_str(multiplexer->iotHubName);
+        upperConfig.iotHubSuffix = STRING_c_str(multiplexer->iotHubSuffix);
+        upperConfig.protocolGatewayHostName = NULL;
+
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_010: [IoTHubTransportMqtt_Register shall create the state of the device, with its own MQTT client, as IoTHubTransportMqtt_Create does for a transport created with a device, apply the "logtrace", "keepalive", "mqttMessagePoolSize", "mqttMaxInFlight", "mqttTelemetryQos0", "retryInitialDelay" and "retryMaxDelay" values set on the transport and return the state as the IOTHUB_DEVICE_HANDLE.] */
+        if ((transportState = InitializeTransportHandleData(&upperConfig, waitingToSend)) == NULL)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_011: [If any error is encountered then IoTHubTransportMqtt_Register shall return NULL.] */
+            result = NULL;
+        }
+        else
+        {
+            transportState->isRegistered = true;
+            transportState->llClientHandle = iotHubClientHandle;
+            transportState->keepAliveValue = multiplexer->keepAliveValue;
+            transportState->multiplexer = multiplexer;
+            transportState->msgTickCounter = multiplexer->msgTickCounter;
+            if ((multiplexer->messagePoolSize != 0) &&
+                (IoTHubTransportMqtt_SetOption(transportState, OPTION_MQTT_MESSAGE_POOL_SIZE, &multiplexer->messagePoolSize) != IOTHUB_CLIENT_OK))
+            {
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_011: [If any error is encountered then IoTHubTransportMqtt_Register shall return NULL.] */
+                DestroyDeviceState(transportState);
+                result = NULL;
+            }
+            else
+            {
+                if (multiplexer->logTrace)
+                {
+                    mqtt_client_set_trace(transportState->mqttClient, true, true);
+                }
+                if (multiplexer->maxInFlight != 0)
+                {
+                    (void)IoTHubTransportMqtt_SetOption(transportState, OPTION_MQTT_MAX_IN_FLIGHT, &multiplexer->maxInFlight);
+                }
+                transportState->telemetryQos0 = multiplexer->telemetryQos0;
+                transportState->retryPolicy.initialDelayInMs = multiplexer->retryPolicy.initialDelayInMs;
+                transportState->retryPolicy.maxDelayInMs = multiplexer->retryPolicy.maxDelayInMs;
+                DList_InsertTailList(&multiplexer->devices, &transportState->multiplexerEntry);
+                result = transportState;
+            }
+        }
+    }
+    return result;
+}
+
 static IOTHUB_DEVICE_HANDLE IoTHubTransportMqtt_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
 {
     IOTHUB_DEVICE_HANDLE result = NULL;
-    (void)iotHubClientHandle;
 
     // Codes_SRS_IOTHUB_MQTT_TRANSPORT_17_001: [ IoTHubTransportMqtt_Register shall return NULL if the TRANSPORT_LL_HANDLE is NULL.]
     // Codes_SRS_IOTHUB_MQTT_TRANSPORT_17_002: [ IoTHubTransportMqtt_Register shall return NULL if device or waitingToSend are NULL.]
@@ -1397,6 +2168,10 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportMqtt_Register(TRANSPORT_LL_HANDLE han
             LogError("IoTHubTransportMqtt_Register: Both deviceKey and deviceSasToken are defined. Only one can be used.");
             result = NULL;
         }
+        else if (IsMultiplexer(handle))
+        {
+            result = RegisterOnMultiplexer((MQTTTRANSPORT_MULTIPLEXER_DATA*)handle, device, iotHubClientHandle, waitingToSend);
+        }
         else
         {
             // Codes_SRS_IOTHUB_MQTT_TRANSPORT_17_003: [ IoTHubTransportMqtt_Register shall return NULL if deviceId or deviceKey do not match the deviceId and deviceKey passed in during IoTHubTransportMqtt_Create.]
@@ -1437,7 +2212,16 @@ static void IoTHubTransportMqtt_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
     {
         MQTTTRANSPORT_HANDLE_DATA* transportState = (MQTTTRANSPORT_HANDLE_DATA*)deviceHandle;
 
-        transportState->isRegistered = false;
+        if (transportState->multiplexer != NULL)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_012: [If the device was registered on a transport created with no device, IoTHubTransportMqtt_Unregister shall disconnect it, complete its messages waiting for an acknowledgement with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY and free its state.] */
+            (void)DList_RemoveEntryList(&transportState->multiplexerEntry);
+            DestroyDeviceState(transportState);
+        }
+        else
+        {
+            transportState->isRegistered = false;
+        }
     }
 }
 
@@ -1452,7 +2236,8 @@ static STRING_HANDLE IoTHubTransportMqtt_GetHostname(TRANSPORT_LL_HANDLE handle)
     else
     {
         /*Codes_SRS_IOTHUB_MQTT_TRANSPORT_02_002: [ Otherwise IoTHubTransportMqtt_GetHostname shall return a non-NULL STRING_HANDLE containg the hostname. ]*/
-        result = ((MQTTTRANSPORT_HANDLE_DATA*)handle)->hostAddress;
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_10_017: [On a transport created with no device, IoTHubTransportMqtt_GetHostname shall return the hostname constructed from iotHubName and iotHubSuffix.] */
+        result = IsMultiplexer(handle) ? ((MQTTTRANSPORT_MULTIPLEXER_DATA*)handle)->hostAddress : ((MQTTTRANSPORT_HANDLE_DATA*)handle)->hostAddress;
     }
     return result;
 }
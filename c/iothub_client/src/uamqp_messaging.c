@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 #include <stdlib.h>
+#include <string.h>
 #ifdef _CRTDBG_MAP_ALLOC
 #include <crtdbg.h>
 #endif
@@ -537,3 +538,135 @@ int message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, MES
 
 	return result;
 }
+
+static int encode_bytes_into_binary_data(void* context, const unsigned char* bytes, size_t length)
+{
+	BINARY_DATA* encoded = (BINARY_DATA*)context;
+	(void)memcpy((unsigned char*)encoded->bytes + encoded->length, bytes, length);
+	encoded->length += length;
+	return 0;
+}
+
+int message_create_uamqp_encoding_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, BINARY_DATA* body_binary_data)
+{
+	int result;
+	MESSAGE_HANDLE uamqp_message = NULL;
+	PROPERTIES_HANDLE uamqp_message_properties = NULL;
+	AMQP_VALUE uamqp_app_properties = NULL;
+	AMQP_VALUE sections[3] = { NULL, NULL, NULL };
+	size_t section_count = 0;
+	BINARY_DATA body_data;
+
+	// Codes_SRS_UAMQP_MESSAGING_10_001: [message_create_uamqp_encoding_from_iothub_message() shall build the uAMQP message of the event with message_create_from_iothub_message().]
+	if (message_create_from_iothub_message(iothub_message, &uamqp_message) != RESULT_OK)
+	{
+		// Codes_SRS_UAMQP_MESSAGING_10_002: [If any call fails, message_create_uamqp_encoding_from_iothub_message() shall free what it allocated and return a non-zero value.]
+		LogError("Failed creating the uAMQP message of the event.");
+		result = __LINE__;
+	}
+	// Codes_SRS_UAMQP_MESSAGING_10_003: [The properties, the application properties (when there are any) and the data of the uAMQP message shall be wrapped, in that order, in their AMQP sections with amqpvalue_create_properties(), amqpvalue_create_application_properties() and amqpvalue_create_data().]
+	else if ((message_get_properties(uamqp_message, &uamqp_message_properties) != 0) ||
+		(uamqp_message_properties == NULL) ||
+		((sections[section_count++] = amqpvalue_create_properties(uamqp_message_properties)) == NULL))
+	{
+		LogError("Failed creating the properties section of the event.");
+		result = __LINE__;
+	}
+	else if ((message_get_application_properties(uamqp_message, &uamqp_app_properties) != 0) ||
+		((uamqp_app_properties != NULL) && ((sections[section_count++] = amqpvalue_create_application_properties(uamqp_app_properties)) == NULL)))
+	{
+		LogError("Failed creating the application properties section of the event.");
+		result = __LINE__;
+	}
+	else if (message_get_body_amqp_data(uamqp_message, 0, &body_data) != 0)
+	{
+		LogError("Failed getting the body of the event.");
+		result = __LINE__;
+	}
+	else
+	{
+		data data_value;
+		data_value.bytes = body_data.bytes;
+		data_value.length = (uint32_t)body_data.length;
+
+		if ((sections[section_count++] = amqpvalue_create_data(data_value)) == NULL)
+		{
+			LogError("Failed creating the data section of the event.");
+			result = __LINE__;
+		}
+		else
+		{
+			size_t encoded_size = 0;
+			size_t i;
+			result = RESULT_OK;
+
+			// Codes_SRS_UAMQP_MESSAGING_10_004: [The sections shall be encoded one after the other with amqpvalue_encode() into a single buffer of the size computed with amqpvalue_get_encoded_size(), returned in body_binary_data; the caller frees it with free().]
+			for (i = 0; (result == RESULT_OK) && (i < section_count); i++)
+			{
+				size_t section_size;
+				if (amqpvalue_get_encoded_size(sections[i], &section_size) != 0)
+				{
+					LogError("Failed getting the encoded size of a section of the event.");
+					result = __LINE__;
+				}
+				else
+				{
+					encoded_size += section_size;
+				}
+			}
+
+			if (result == RESULT_OK)
+			{
+				BINARY_DATA encoded;
+				encoded.length = 0;
+				if ((encoded.bytes = (const unsigned char*)malloc(encoded_size)) == NULL)
+				{
+					LogError("Failed allocating the encoding of the event.");
+					result = __LINE__;
+				}
+				else
+				{
+					for (i = 0; (result == RESULT_OK) && (i < section_count); i++)
+					{
+						if (amqpvalue_encode(sections[i], encode_bytes_into_binary_data, &encoded) != 0)
+						{
+							LogError("Failed encoding a section of the event.");
+							result = __LINE__;
+						}
+					}
+
+					if (result == RESULT_OK)
+					{
+						*body_binary_data = encoded;
+					}
+					else
+					{
+						free((void*)encoded.bytes);
+					}
+				}
+			}
+		}
+	}
+
+	for (; section_count > 0; section_count--)
+	{
+		if (sections[section_count - 1] != NULL)
+		{
+			amqpvalue_destroy(sections[section_count - 1]);
+		}
+	}
+	if (uamqp_app_properties != NULL)
+	{
+		amqpvalue_destroy(uamqp_app_properties);
+	}
+	if (uamqp_message_properties != NULL)
+	{
+		properties_destroy(uamqp_message_properties);
+	}
+	if (uamqp_message != NULL)
+	{
+		message_destroy(uamqp_message);
+	}
+
+	return result;
+}
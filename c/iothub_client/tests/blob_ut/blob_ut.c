@@ -25,7 +25,6 @@ static void my_gballoc_free(void* s)
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/strings.h"
-#include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/gballoc.h"
 #undef ENABLE_MOCKS
@@ -95,11 +94,28 @@ static void my_STRING_delete(STRING_HANDLE h)
     my_gballoc_free((void*)h);
 }
 
-static STRING_HANDLE my_Base64_Encode_Bytes(const unsigned char* source, size_t size)
+/*base64 of the block IDs, which are sprintf("%6u", blockNumber)*/
+static const char* const TEST_BLOCK_IDS[] =
 {
-    (void)source, size;
-    return (STRING_HANDLE)my_gballoc_malloc(1);
-}
+    "ICAgICAw",
+    "ICAgICAx",
+    "ICAgICAy",
+    "ICAgICAz",
+    "ICAgICA0",
+    "ICAgICA1",
+    "ICAgICA2",
+    "ICAgICA3",
+    "ICAgICA4",
+    "ICAgICA5",
+    "ICAgIDEw",
+    "ICAgIDEx",
+    "ICAgIDEy",
+    "ICAgIDEz",
+    "ICAgIDE0",
+    "ICAgIDE1",
+    "ICAgIDE2",
+    "ICAgIDE3",
+};
 
 TEST_DEFINE_ENUM_TYPE(BLOB_RESULT, BLOB_RESULT_VALUES);
 
@@ -155,8 +171,6 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
 
     REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, my_STRING_construct);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_construct, NULL);
-    REGISTER_GLOBAL_MOCK_HOOK(Base64_Encode_Bytes, my_Base64_Encode_Bytes);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Base64_Encode_Bytes, NULL);
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat, __LINE__);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat_with_STRING, __LINE__);
@@ -620,23 +634,18 @@ TEST_FUNCTION(Blob_UploadFromSasUri_various_sizes_happy_path)
         for (size_t blockNumber = 0;blockNumber < (sizes[iSize] - 1) / (4 * 1024 * 1024) + 1;blockNumber++)
         {
             /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-            STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/
-                .IgnoreArgument_source();
-
             STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
                 .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-                .IgnoreArgument_s1()
-                .IgnoreArgument_s2();
+            STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, TEST_BLOCK_IDS[blockNumber])) /*this is building the XML*/
+                .IgnoreArgument_handle();
             STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
                 .IgnoreArgument_handle();
             STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relativePath*/
 
             STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
                 .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-                .IgnoreArgument_s1()
-                .IgnoreArgument_s2();
+            STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, TEST_BLOCK_IDS[blockNumber])) /*this is building the relativePath by adding the blockId (base64 encoded)*/
+                .IgnoreArgument_handle();
 
             STRICT_EXPECTED_CALL(BUFFER_create(content + blockNumber * 4 * 1024 * 1024,
                 (blockNumber != (sizes[iSize] - 1) / (4 * 1024 * 1024)) ? 4 * 1024 * 1024 : (sizes[iSize] - 1) % (4 * 1024 * 1024) + 1 /*condition to take care of "the size of the last block*/
@@ -654,8 +663,6 @@ TEST_FUNCTION(Blob_UploadFromSasUri_various_sizes_happy_path)
                 .IgnoreArgument_handle();
             STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/
                 .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/
-                .IgnoreArgument_handle();
         }
 
         /*this part is Put Block list*/
@@ -721,79 +728,63 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_unhappy_path)
 
     size_t calls_that_cannot_fail[] =
     {
-        13   ,/*BUFFER_delete*/
-        26   ,/*BUFFER_delete*/
-        39   ,/*BUFFER_delete*/
-        52   ,/*BUFFER_delete*/
-        65   ,/*BUFFER_delete*/
+        12   ,/*BUFFER_delete*/
+        23   ,/*BUFFER_delete*/
+        34   ,/*BUFFER_delete*/
+        45   ,/*BUFFER_delete*/
+        56   ,/*BUFFER_delete*/
+        67   ,/*BUFFER_delete*/
         78   ,/*BUFFER_delete*/
-        91   ,/*BUFFER_delete*/
-        104  ,/*BUFFER_delete*/
-        117  ,/*BUFFER_delete*/
-        130  ,/*BUFFER_delete*/
-        143  ,/*BUFFER_delete*/
-        156  ,/*BUFFER_delete*/
-        169  ,/*BUFFER_delete*/
-        182  ,/*BUFFER_delete*/
-        195  ,/*BUFFER_delete*/
-        208  ,/*BUFFER_delete*/
-        11   ,/*STRING_c_str*/
-        24   ,/*STRING_c_str*/
-        37   ,/*STRING_c_str*/
-        50   ,/*STRING_c_str*/
-        63   ,/*STRING_c_str*/
+        89   ,/*BUFFER_delete*/
+        100  ,/*BUFFER_delete*/
+        111  ,/*BUFFER_delete*/
+        122  ,/*BUFFER_delete*/
+        133  ,/*BUFFER_delete*/
+        144  ,/*BUFFER_delete*/
+        155  ,/*BUFFER_delete*/
+        166  ,/*BUFFER_delete*/
+        177  ,/*BUFFER_delete*/
+        10   ,/*STRING_c_str*/
+        21   ,/*STRING_c_str*/
+        32   ,/*STRING_c_str*/
+        43   ,/*STRING_c_str*/
+        54   ,/*STRING_c_str*/
+        65   ,/*STRING_c_str*/
         76   ,/*STRING_c_str*/
-        89   ,/*STRING_c_str*/
-        102  ,/*STRING_c_str*/
-        115  ,/*STRING_c_str*/
-        128  ,/*STRING_c_str*/
-        141  ,/*STRING_c_str*/
-        154  ,/*STRING_c_str*/
-        167  ,/*STRING_c_str*/
-        180  ,/*STRING_c_str*/
-        193  ,/*STRING_c_str*/
-        206  ,/*STRING_c_str*/
-        14   ,/*STRING_delete*/
-        27   ,/*STRING_delete*/
-        40   ,/*STRING_delete*/
-        53   ,/*STRING_delete*/
-        66   ,/*STRING_delete*/
+        87   ,/*STRING_c_str*/
+        98   ,/*STRING_c_str*/
+        109  ,/*STRING_c_str*/
+        120  ,/*STRING_c_str*/
+        131  ,/*STRING_c_str*/
+        142  ,/*STRING_c_str*/
+        153  ,/*STRING_c_str*/
+        164  ,/*STRING_c_str*/
+        175  ,/*STRING_c_str*/
+        13   ,/*STRING_delete*/
+        24   ,/*STRING_delete*/
+        35   ,/*STRING_delete*/
+        46   ,/*STRING_delete*/
+        57   ,/*STRING_delete*/
+        68   ,/*STRING_delete*/
         79   ,/*STRING_delete*/
-        92   ,/*STRING_delete*/
-        105  ,/*STRING_delete*/
-        118  ,/*STRING_delete*/
-        131  ,/*STRING_delete*/
-        144  ,/*STRING_delete*/
-        157  ,/*STRING_delete*/
-        170  ,/*STRING_delete*/
-        183  ,/*STRING_delete*/
-        196  ,/*STRING_delete*/
-        209  ,/*STRING_delete*/
-        15   ,/*STRING_delete*/
-        28   ,/*STRING_delete*/
-        41   ,/*STRING_delete*/
-        54   ,/*STRING_delete*/
-        67   ,/*STRING_delete*/
-        80   ,/*STRING_delete*/
-        93   ,/*STRING_delete*/
-        106  ,/*STRING_delete*/
-        119  ,/*STRING_delete*/
-        132  ,/*STRING_delete*/
+        90   ,/*STRING_delete*/
+        101  ,/*STRING_delete*/
+        112  ,/*STRING_delete*/
+        123  ,/*STRING_delete*/
+        134  ,/*STRING_delete*/
         145  ,/*STRING_delete*/
-        158  ,/*STRING_delete*/
-        171  ,/*STRING_delete*/
-        184  ,/*STRING_delete*/
-        197  ,/*STRING_delete*/
-        210  ,/*STRING_delete*/
-
-
-        214, /*STRING_c_str*/
-        216, /*STRING_c_str*/
-        218, /*BUFFER_delete*/
-        219, /*STRING_delete*/
-        220, /*STRING_delete*/
-        221, /*HTTPAPIEX_Destroy*/
-        222, /*gballoc_free*/
+        156  ,/*STRING_delete*/
+        167  ,/*STRING_delete*/
+        178  ,/*STRING_delete*/
+
+
+        182, /*STRING_c_str*/
+        184, /*STRING_c_str*/
+        186, /*BUFFER_delete*/
+        187, /*STRING_delete*/
+        188, /*STRING_delete*/
+        189, /*HTTPAPIEX_Destroy*/
+        190, /*gballoc_free*/
     };
 
     (void)umock_c_negative_tests_init();
@@ -820,29 +811,24 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_unhappy_path)
     for (size_t blockNumber = 0;blockNumber < (size - 1) / (4 * 1024 * 1024) + 1;blockNumber++)
     {
         /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/ /*3, 16, 29... (16 numbers)*/
-            .IgnoreArgument_source();
-
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-            .IgnoreArgument_s1()
-            .IgnoreArgument_s2();
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, TEST_BLOCK_IDS[blockNumber])) /*this is building the XML*/
+            .IgnoreArgument_handle();
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
         STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relativePath*/
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-            .IgnoreArgument_s1()
-            .IgnoreArgument_s2();
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, TEST_BLOCK_IDS[blockNumber])) /*this is building the relativePath by adding the blockId (base64 encoded)*/
+            .IgnoreArgument_handle();
 
         STRICT_EXPECTED_CALL(BUFFER_create(content + blockNumber * 4 * 1024 * 1024,
             (blockNumber != (size - 1) / (4 * 1024 * 1024)) ? 4 * 1024 * 1024 : (size - 1) % (4 * 1024 * 1024) + 1 /*condition to take care of "the size of the last block*/
         )); /*this is the content to be uploaded by this call*/
 
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */ /*11, 24, 27...*/
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */ /*10, 21, 32...*/
             .IgnoreArgument_handle();
 
         STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
@@ -852,16 +838,14 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_unhappy_path)
             .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
             ;
 
-        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/ /*13, 26, 39... (16 numbers)*/
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/ /*12, 23, 34... (16 numbers)*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/ /*14, 27, 40...*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/ /*15, 28, 41... 210*/
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/ /*13, 24, 35... 178*/
             .IgnoreArgument_handle();
     }
 
     /*this part is Put Block list*/
-    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/ /*211*/
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/ /*179*/
         .IgnoreArgument_handle();
     STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relative path for the Put BLock list*/
 
@@ -991,23 +975,18 @@ TEST_FUNCTION(Blob_UploadFromSasUri_when_http_code_is_404_it_immediately_succeed
     size_t blockNumber = 0;
     {
         /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/
-            .IgnoreArgument_source();
-
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-            .IgnoreArgument_s1()
-            .IgnoreArgument_s2();
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, TEST_BLOCK_IDS[blockNumber])) /*this is building the XML*/
+            .IgnoreArgument_handle();
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
         STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relativePath*/
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-            .IgnoreArgument_s1()
-            .IgnoreArgument_s2();
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, TEST_BLOCK_IDS[blockNumber])) /*this is building the relativePath by adding the blockId (base64 encoded)*/
+            .IgnoreArgument_handle();
 
         STRICT_EXPECTED_CALL(BUFFER_create(content + blockNumber * 4 * 1024 * 1024,
             (blockNumber != (size - 1) / (4 * 1024 * 1024)) ? 4 * 1024 * 1024 : (size - 1) % (4 * 1024 * 1024) + 1 /*condition to take care of "the size of the last block*/
@@ -1027,8 +1006,6 @@ TEST_FUNCTION(Blob_UploadFromSasUri_when_http_code_is_404_it_immediately_succeed
             .IgnoreArgument_handle();
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/
-            .IgnoreArgument_handle();
     }
 
     /*this part is Put Block list*/ /*notice: no op because it failed before with 404*/
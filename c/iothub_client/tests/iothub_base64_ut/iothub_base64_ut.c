@@ -0,0 +1,433 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+
+#include "testrunnerswitcher.h"
+#include "azure_c_shared_utility/macro_utils.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#include "iothub_base64.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+/*from the fastest to the slowest*/
+static const IOTHUB_BASE64_IMPLEMENTATION allImplementations[] =
+{
+    IOTHUB_BASE64_IMPLEMENTATION_AVX2,
+    IOTHUB_BASE64_IMPLEMENTATION_SSSE3,
+    IOTHUB_BASE64_IMPLEMENTATION_NEON,
+    IOTHUB_BASE64_IMPLEMENTATION_SCALAR
+};
+
+#define IMPLEMENTATION_COUNT (sizeof(allImplementations) / sizeof(allImplementations[0]))
+
+/*long enough to go through the widest vector loops several times and end in every tail length*/
+#define TEST_BUFFER_SIZE 300
+
+static IOTHUB_BASE64_IMPLEMENTATION defaultImplementation;
+static unsigned char testBytes[TEST_BUFFER_SIZE];
+static char referenceCharacters[(TEST_BUFFER_SIZE + 2) / 3 * 4];
+
+/*a plain encoder the implementations are compared against*/
+static void referenceEncode(const char* characters, const unsigned char* source, size_t size, char* destination)
+{
+    size_t i;
+    for (i = 0; i + 3 <= size; i += 3)
+    {
+        unsigned long group = ((unsigned long)source[i] << 16) | ((unsigned long)source[i + 1] << 8) | source[i + 2];
+        *destination++ = characters[(group >> 18) & 0x3F];
+        *destination++ = characters[(group >> 12) & 0x3F];
+        *destination++ = characters[(group >> 6) & 0x3F];
+        *destination++ = characters[group & 0x3F];
+    }
+    if (size - i == 1)
+    {
+        *destination++ = characters[source[i] >> 2];
+        *destination++ = characters[(source[i] & 0x03) << 4];
+        *destination++ = '=';
+        *destination++ = '=';
+    }
+    else if (size - i == 2)
+    {
+        *destination++ = characters[source[i] >> 2];
+        *destination++ = characters[((source[i] & 0x03) << 4) | (source[i + 1] >> 4)];
+        *destination++ = characters[(source[i + 1] & 0x0F) << 2];
+        *destination++ = '=';
+    }
+}
+
+static const char* const standardCharacters = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char* const urlCharacters = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+BEGIN_TEST_SUITE(iothub_base64_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    size_t i;
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    umocktypes_charptr_register_types();
+
+    /*before any test calls IoTHubBase64_SetImplementation*/
+    defaultImplementation = IoTHubBase64_GetImplementation();
+
+    /*every byte value, in an order that puts every value in every position of a group*/
+    for (i = 0; i < TEST_BUFFER_SIZE; i++)
+    {
+        testBytes[i] = (unsigned char)(i * 167 + 13);
+    }
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    (void)IoTHubBase64_SetImplementation(defaultImplementation);
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_001: [IoTHubBase64_EncodedLength shall return 4 characters for every started group of 3 bytes.]*/
+TEST_FUNCTION(IoTHubBase64_EncodedLength_returns_4_characters_per_started_group)
+{
+    ///arrange
+
+    ///act
+    size_t length0 = IoTHubBase64_EncodedLength(0);
+    size_t length1 = IoTHubBase64_EncodedLength(1);
+    size_t length3 = IoTHubBase64_EncodedLength(3);
+    size_t length4 = IoTHubBase64_EncodedLength(4);
+    size_t length6 = IoTHubBase64_EncodedLength(6);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, length0);
+    ASSERT_ARE_EQUAL(size_t, 4, length1);
+    ASSERT_ARE_EQUAL(size_t, 4, length3);
+    ASSERT_ARE_EQUAL(size_t, 8, length4);
+    ASSERT_ARE_EQUAL(size_t, 8, length6);
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_002: [If destination is NULL, or source is NULL and size is not 0, then IoTHubBase64_Encode shall write nothing and return NULL.]*/
+TEST_FUNCTION(IoTHubBase64_Encode_with_NULL_destination_fails)
+{
+    ///arrange
+
+    ///act
+    char* result = IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET_STANDARD, testBytes, 3, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_002: [If destination is NULL, or source is NULL and size is not 0, then IoTHubBase64_Encode shall write nothing and return NULL.]*/
+TEST_FUNCTION(IoTHubBase64_Encode_with_NULL_source_and_non_zero_size_fails)
+{
+    ///arrange
+    char destination[4] = { 'x', 'x', 'x', 'x' };
+
+    ///act
+    char* result = IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET_STANDARD, NULL, 3, destination);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination, "xxxx", 4));
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_003: [IoTHubBase64_Encode shall write the IoTHubBase64_EncodedLength(size) characters of the base64 encoding of source in alphabet, '=' padded, at destination and return destination + IoTHubBase64_EncodedLength(size).]*/
+TEST_FUNCTION(IoTHubBase64_Encode_with_NULL_source_and_zero_size_writes_nothing)
+{
+    ///arrange
+    char destination[1] = { 'x' };
+
+    ///act
+    char* result = IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET_STANDARD, NULL, 0, destination);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, destination, result);
+    ASSERT_ARE_EQUAL(char, 'x', destination[0]);
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_003: [IoTHubBase64_Encode shall write the IoTHubBase64_EncodedLength(size) characters of the base64 encoding of source in alphabet, '=' padded, at destination and return destination + IoTHubBase64_EncodedLength(size).]*/
+TEST_FUNCTION(IoTHubBase64_Encode_writes_the_RFC4648_test_vectors)
+{
+    static const char* const vectors[][2] =
+    {
+        { "f", "Zg==" },
+        { "fo", "Zm8=" },
+        { "foo", "Zm9v" },
+        { "foob", "Zm9vYg==" },
+        { "fooba", "Zm9vYmE=" },
+        { "foobar", "Zm9vYmFy" }
+    };
+    size_t i;
+    for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+    {
+        ///arrange
+        char destination[9];
+        size_t size = strlen(vectors[i][0]);
+        memset(destination, 'x', sizeof(destination));
+
+        ///act
+        char* result = IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET_STANDARD, (const unsigned char*)vectors[i][0], size, destination);
+
+        ///assert
+        ASSERT_ARE_EQUAL(void_ptr, destination + strlen(vectors[i][1]), result);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(destination, vectors[i][1], strlen(vectors[i][1])));
+        ASSERT_ARE_EQUAL(char, 'x', *result);
+    }
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_003: [IoTHubBase64_Encode shall write the IoTHubBase64_EncodedLength(size) characters of the base64 encoding of source in alphabet, '=' padded, at destination and return destination + IoTHubBase64_EncodedLength(size).]*/
+TEST_FUNCTION(IoTHubBase64_Encode_uses_the_characters_of_the_alphabet_for_62_and_63)
+{
+    ///arrange
+    static const unsigned char source[3] = { 0xFB, 0xEF, 0xFF }; /*values 62, 62, 63, 63*/
+    char standard[4];
+    char url[4];
+
+    ///act
+    (void)IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET_STANDARD, source, sizeof(source), standard);
+    (void)IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET_URL, source, sizeof(source), url);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, memcmp(standard, "++//", 4));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(url, "--__", 4));
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_004: [If source or destination is NULL then IoTHubBase64_DecodeGroups shall write nothing and return 0.]*/
+TEST_FUNCTION(IoTHubBase64_DecodeGroups_with_NULL_source_returns_0)
+{
+    ///arrange
+    unsigned char destination[3];
+
+    ///act
+    size_t result = IoTHubBase64_DecodeGroups(IOTHUB_BASE64_ALPHABET_STANDARD, NULL, 4, destination);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_004: [If source or destination is NULL then IoTHubBase64_DecodeGroups shall write nothing and return 0.]*/
+TEST_FUNCTION(IoTHubBase64_DecodeGroups_with_NULL_destination_returns_0)
+{
+    ///arrange
+
+    ///act
+    size_t result = IoTHubBase64_DecodeGroups(IOTHUB_BASE64_ALPHABET_STANDARD, "Zm9v", 4, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_005: [IoTHubBase64_DecodeGroups shall decode the groups of 4 characters of alphabet from the start of source until the first group that is incomplete or has a character outside of alphabet, write 3 bytes per group at destination and return the number of characters decoded.]*/
+TEST_FUNCTION(IoTHubBase64_DecodeGroups_stops_before_the_padded_group)
+{
+    ///arrange
+    unsigned char destination[6];
+
+    ///act
+    size_t result = IoTHubBase64_DecodeGroups(IOTHUB_BASE64_ALPHABET_STANDARD, "Zm9vYmE=", 8, destination);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 4, result);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination, "foo", 3));
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_005: [IoTHubBase64_DecodeGroups shall decode the groups of 4 characters of alphabet from the start of source until the first group that is incomplete or has a character outside of alphabet, write 3 bytes per group at destination and return the number of characters decoded.]*/
+TEST_FUNCTION(IoTHubBase64_DecodeGroups_stops_before_the_incomplete_group)
+{
+    ///arrange
+    unsigned char destination[6];
+
+    ///act
+    size_t result = IoTHubBase64_DecodeGroups(IOTHUB_BASE64_ALPHABET_STANDARD, "Zm9vYmE", 7, destination);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 4, result);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination, "foo", 3));
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_005: [IoTHubBase64_DecodeGroups shall decode the groups of 4 characters of alphabet from the start of source until the first group that is incomplete or has a character outside of alphabet, write 3 bytes per group at destination and return the number of characters decoded.]*/
+TEST_FUNCTION(IoTHubBase64_DecodeGroups_does_not_accept_the_characters_of_the_other_alphabet)
+{
+    ///arrange
+    unsigned char destination[6];
+
+    ///act
+    size_t standardResult = IoTHubBase64_DecodeGroups(IOTHUB_BASE64_ALPHABET_STANDARD, "++//--__", 8, destination);
+    size_t urlResult = IoTHubBase64_DecodeGroups(IOTHUB_BASE64_ALPHABET_URL, "--__++//", 8, destination);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 4, standardResult);
+    ASSERT_ARE_EQUAL(size_t, 4, urlResult);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination, "\xFB\xEF\xFF", 3));
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_008: [All the implementations shall produce the same output for the same input.]*/
+TEST_FUNCTION(IoTHubBase64_Encode_gives_the_same_characters_with_every_implementation)
+{
+    size_t i;
+    for (i = 0; i < IMPLEMENTATION_COUNT; i++)
+    {
+        if (IoTHubBase64_SetImplementation(allImplementations[i]) == 0)
+        {
+            size_t size;
+            for (size = 0; size <= TEST_BUFFER_SIZE; size++)
+            {
+                ///arrange
+                char destination[sizeof(referenceCharacters) + 1];
+                size_t length = IoTHubBase64_EncodedLength(size);
+                destination[length] = 'x';
+                referenceEncode(urlCharacters, testBytes, size, referenceCharacters);
+
+                ///act
+                char* result = IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET_URL, testBytes, size, destination);
+
+                ///assert
+                ASSERT_ARE_EQUAL(void_ptr, destination + length, result);
+                ASSERT_ARE_EQUAL(int, 0, memcmp(destination, referenceCharacters, length));
+                ASSERT_ARE_EQUAL(char, 'x', destination[length]);
+            }
+        }
+    }
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_008: [All the implementations shall produce the same output for the same input.]*/
+TEST_FUNCTION(IoTHubBase64_DecodeGroups_gives_the_same_bytes_with_every_implementation)
+{
+    size_t i;
+    referenceEncode(standardCharacters, testBytes, TEST_BUFFER_SIZE, referenceCharacters);
+    for (i = 0; i < IMPLEMENTATION_COUNT; i++)
+    {
+        if (IoTHubBase64_SetImplementation(allImplementations[i]) == 0)
+        {
+            size_t length;
+            for (length = 0; length <= sizeof(referenceCharacters); length++)
+            {
+                ///arrange
+                unsigned char destination[TEST_BUFFER_SIZE];
+
+                ///act
+                size_t result = IoTHubBase64_DecodeGroups(IOTHUB_BASE64_ALPHABET_STANDARD, referenceCharacters, length, destination);
+
+                ///assert
+                ASSERT_ARE_EQUAL(size_t, length / 4 * 4, result);
+                ASSERT_ARE_EQUAL(int, 0, memcmp(destination, testBytes, result / 4 * 3));
+            }
+        }
+    }
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_008: [All the implementations shall produce the same output for the same input.]*/
+TEST_FUNCTION(IoTHubBase64_DecodeGroups_stops_at_the_same_invalid_character_with_every_implementation)
+{
+    size_t i;
+    referenceEncode(standardCharacters, testBytes, TEST_BUFFER_SIZE, referenceCharacters);
+    for (i = 0; i < IMPLEMENTATION_COUNT; i++)
+    {
+        if (IoTHubBase64_SetImplementation(allImplementations[i]) == 0)
+        {
+            size_t position;
+            for (position = 0; position < sizeof(referenceCharacters); position++)
+            {
+                ///arrange
+                char source[sizeof(referenceCharacters)];
+                unsigned char destination[TEST_BUFFER_SIZE];
+                memcpy(source, referenceCharacters, sizeof(source));
+                source[position] = '-';
+
+                ///act
+                size_t result = IoTHubBase64_DecodeGroups(IOTHUB_BASE64_ALPHABET_STANDARD, source, sizeof(source), destination);
+
+                ///assert
+                ASSERT_ARE_EQUAL(size_t, position / 4 * 4, result);
+                ASSERT_ARE_EQUAL(int, 0, memcmp(destination, testBytes, result / 4 * 3));
+            }
+        }
+    }
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_006: [IoTHubBase64_GetImplementation shall return the implementation used by IoTHubBase64_Encode and IoTHubBase64_DecodeGroups.]*/
+/*Tests_SRS_IOTHUB_BASE64_10_009: [Until IoTHubBase64_SetImplementation is called the codec shall use the fastest implementation the CPU supports.]*/
+TEST_FUNCTION(IoTHubBase64_GetImplementation_returns_the_fastest_implementation_by_default)
+{
+    size_t i;
+
+    ///arrange
+
+    ///act
+    for (i = 0; allImplementations[i] != defaultImplementation; i++)
+    {
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, IoTHubBase64_SetImplementation(allImplementations[i]));
+    }
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, IoTHubBase64_SetImplementation(defaultImplementation));
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_007: [If implementation is not compiled in or not supported by the CPU then IoTHubBase64_SetImplementation shall fail and return a non-zero value.]*/
+TEST_FUNCTION(IoTHubBase64_SetImplementation_with_an_unknown_implementation_fails)
+{
+    ///arrange
+    IOTHUB_BASE64_IMPLEMENTATION before = IoTHubBase64_GetImplementation();
+
+    ///act
+    int result = IoTHubBase64_SetImplementation((IOTHUB_BASE64_IMPLEMENTATION)(IOTHUB_BASE64_IMPLEMENTATION_NEON + 1));
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, (int)before, (int)IoTHubBase64_GetImplementation());
+}
+
+/*Tests_SRS_IOTHUB_BASE64_10_010: [Otherwise IoTHubBase64_SetImplementation shall make IoTHubBase64_Encode and IoTHubBase64_DecodeGroups use implementation and return 0.]*/
+/*Tests_SRS_IOTHUB_BASE64_10_006: [IoTHubBase64_GetImplementation shall return the implementation used by IoTHubBase64_Encode and IoTHubBase64_DecodeGroups.]*/
+TEST_FUNCTION(IoTHubBase64_SetImplementation_with_the_scalar_implementation_succeeds)
+{
+    ///arrange
+
+    ///act
+    int result = IoTHubBase64_SetImplementation(IOTHUB_BASE64_IMPLEMENTATION_SCALAR);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_BASE64_IMPLEMENTATION_SCALAR, (int)IoTHubBase64_GetImplementation());
+}
+
+END_TEST_SUITE(iothub_base64_ut)
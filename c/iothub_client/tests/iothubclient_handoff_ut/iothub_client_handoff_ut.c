@@ -0,0 +1,299 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+
+void* my_gballoc_malloc(size_t size)
+{
+    void *result = malloc(size);
+    return result;
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "azure_c_shared_utility/macro_utils.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+
+#undef ENABLE_MOCKS
+
+#include "iothub_client_handoff.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_ITEM_COUNT 3
+
+static IOTHUB_CLIENT_HANDOFF_ITEM testItems[TEST_ITEM_COUNT];
+
+static IOTHUB_CLIENT_HANDOFF_HANDLE createTestHandoff(void)
+{
+    IOTHUB_CLIENT_HANDOFF_HANDLE result = IoTHubClient_Handoff_Create();
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(iothubclient_handoff_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    umocktypes_charptr_register_types();
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    memset(testItems, 0, sizeof(testItems));
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_HANDOFF_10_001: [IoTHubClient_Handoff_Create shall allocate an empty handoff and return a non-NULL handle to it.]*/
+TEST_FUNCTION(IoTHubClient_Handoff_Create_allocates_an_empty_handoff)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IOTHUB_CLIENT_HANDOFF_HANDLE h = IoTHubClient_Handoff_Create();
+
+    ///assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_IS_TRUE(IoTHubClient_Handoff_IsEmpty(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_Handoff_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_HANDOFF_10_002: [If any operation fails then IoTHubClient_Handoff_Create shall fail and return NULL.]*/
+TEST_FUNCTION(IoTHubClient_Handoff_Create_fails_when_malloc_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(NULL);
+
+    ///act
+    IOTHUB_CLIENT_HANDOFF_HANDLE h = IoTHubClient_Handoff_Create();
+
+    ///assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_HANDOFF_10_003: [If handle or item is NULL then IoTHubClient_Handoff_Push shall do nothing and return false.]*/
+TEST_FUNCTION(IoTHubClient_Handoff_Push_with_NULL_arguments_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_HANDOFF_HANDLE h = createTestHandoff();
+
+    ///act
+    bool result1 = IoTHubClient_Handoff_Push(NULL, &testItems[0]);
+    bool result2 = IoTHubClient_Handoff_Push(h, NULL);
+
+    ///assert
+    ASSERT_IS_FALSE(result1);
+    ASSERT_IS_FALSE(result2);
+    ASSERT_IS_TRUE(IoTHubClient_Handoff_IsEmpty(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_Handoff_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_HANDOFF_10_004: [IoTHubClient_Handoff_Push shall add item to the handoff without blocking the other producers and the consumer, and shall be safe to call from any number of threads at once.]*/
+/*Tests_SRS_IOTHUBCLIENT_HANDOFF_10_005: [IoTHubClient_Handoff_Push shall return true if the handoff was empty before item was added, false otherwise.]*/
+TEST_FUNCTION(IoTHubClient_Handoff_Push_returns_true_only_for_the_first_item)
+{
+    ///arrange
+    IOTHUB_CLIENT_HANDOFF_HANDLE h = createTestHandoff();
+
+    ///act
+    bool result1 = IoTHubClient_Handoff_Push(h, &testItems[0]);
+    bool result2 = IoTHubClient_Handoff_Push(h, &testItems[1]);
+
+    ///assert
+    ASSERT_IS_TRUE(result1);
+    ASSERT_IS_FALSE(result2);
+    ASSERT_IS_FALSE(IoTHubClient_Handoff_IsEmpty(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    (void)IoTHubClient_Handoff_TakeAll(h);
+    IoTHubClient_Handoff_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_HANDOFF_10_006: [If handle is NULL then IoTHubClient_Handoff_TakeAll shall return NULL.]*/
+TEST_FUNCTION(IoTHubClient_Handoff_TakeAll_with_NULL_handle_returns_NULL)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_HANDOFF_ITEM* result = IoTHubClient_Handoff_TakeAll(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_HANDOFF_10_007: [IoTHubClient_Handoff_TakeAll shall empty the handoff and return its items chained through next, oldest first, or NULL when it was empty.]*/
+TEST_FUNCTION(IoTHubClient_Handoff_TakeAll_on_an_empty_handoff_returns_NULL)
+{
+    ///arrange
+    IOTHUB_CLIENT_HANDOFF_HANDLE h = createTestHandoff();
+
+    ///act
+    IOTHUB_CLIENT_HANDOFF_ITEM* result = IoTHubClient_Handoff_TakeAll(h);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_Handoff_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_HANDOFF_10_007: [IoTHubClient_Handoff_TakeAll shall empty the handoff and return its items chained through next, oldest first, or NULL when it was empty.]*/
+TEST_FUNCTION(IoTHubClient_Handoff_TakeAll_returns_the_items_oldest_first_and_empties_the_handoff)
+{
+    ///arrange
+    size_t i;
+    IOTHUB_CLIENT_HANDOFF_HANDLE h = createTestHandoff();
+    for (i = 0; i < TEST_ITEM_COUNT; i++)
+    {
+        (void)IoTHubClient_Handoff_Push(h, &testItems[i]);
+    }
+
+    ///act
+    IOTHUB_CLIENT_HANDOFF_ITEM* result = IoTHubClient_Handoff_TakeAll(h);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&testItems[0], (void*)result);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&testItems[1], (void*)testItems[0].next);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&testItems[2], (void*)testItems[1].next);
+    ASSERT_IS_NULL(testItems[2].next);
+    ASSERT_IS_TRUE(IoTHubClient_Handoff_IsEmpty(h));
+    ASSERT_IS_TRUE(IoTHubClient_Handoff_Push(h, &testItems[0]));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    (void)IoTHubClient_Handoff_TakeAll(h);
+    IoTHubClient_Handoff_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_HANDOFF_10_008: [If handle is NULL then IoTHubClient_Handoff_IsEmpty shall return true.]*/
+TEST_FUNCTION(IoTHubClient_Handoff_IsEmpty_with_NULL_handle_returns_true)
+{
+    ///arrange
+
+    ///act
+    bool result = IoTHubClient_Handoff_IsEmpty(NULL);
+
+    ///assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_HANDOFF_10_009: [Otherwise IoTHubClient_Handoff_IsEmpty shall return true if the handoff has no item, false otherwise.]*/
+TEST_FUNCTION(IoTHubClient_Handoff_IsEmpty_reports_the_items_pushed)
+{
+    ///arrange
+    IOTHUB_CLIENT_HANDOFF_HANDLE h = createTestHandoff();
+
+    ///act
+    bool before = IoTHubClient_Handoff_IsEmpty(h);
+    (void)IoTHubClient_Handoff_Push(h, &testItems[0]);
+    bool after = IoTHubClient_Handoff_IsEmpty(h);
+
+    ///assert
+    ASSERT_IS_TRUE(before);
+    ASSERT_IS_FALSE(after);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    (void)IoTHubClient_Handoff_TakeAll(h);
+    IoTHubClient_Handoff_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_HANDOFF_10_010: [If handle is NULL then IoTHubClient_Handoff_Destroy shall do nothing.]*/
+TEST_FUNCTION(IoTHubClient_Handoff_Destroy_with_NULL_handle_does_nothing)
+{
+    ///arrange
+
+    ///act
+    IoTHubClient_Handoff_Destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_HANDOFF_10_011: [IoTHubClient_Handoff_Destroy shall free the handoff. Items still in the handoff are not freed.]*/
+TEST_FUNCTION(IoTHubClient_Handoff_Destroy_frees_the_handoff_but_not_the_items)
+{
+    ///arrange
+    IOTHUB_CLIENT_HANDOFF_HANDLE h = createTestHandoff();
+    (void)IoTHubClient_Handoff_Push(h, &testItems[0]);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+
+    ///act
+    IoTHubClient_Handoff_Destroy(h);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothubclient_handoff_ut)
@@ -0,0 +1,877 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+
+#ifdef DONT_USE_JOURNAL
+#error "trying to compile iothub_client_ll_journal_ut.c while DONT_USE_JOURNAL is #define'd"
+#else
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+
+void* my_gballoc_malloc(size_t size)
+{
+    void *result = malloc(size);
+    return result;
+}
+
+void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    void *result = realloc(ptr, size);
+    return result;
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "azure_c_shared_utility/macro_utils.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/map.h"
+#include "iothub_message.h"
+
+/*the journal only needs the content, the ids and the properties of a message, these fakes keep them in memory*/
+#define TEST_MAX_PROPERTIES 4
+
+typedef struct TEST_MESSAGE_TAG
+{
+    IOTHUBMESSAGE_CONTENT_TYPE contentType;
+    unsigned char* content;
+    size_t size;
+    char* messageId;
+    char* correlationId;
+    char* keys[TEST_MAX_PROPERTIES];
+    char* values[TEST_MAX_PROPERTIES];
+    size_t propertyCount;
+} TEST_MESSAGE;
+
+static char* test_strdup(const char* source)
+{
+    char* result = (char*)malloc(strlen(source) + 1);
+    (void)strcpy(result, source);
+    return result;
+}
+
+static TEST_MESSAGE* test_message_create(IOTHUBMESSAGE_CONTENT_TYPE contentType, const unsigned char* content, size_t size)
+{
+    TEST_MESSAGE* result = (TEST_MESSAGE*)calloc(1, sizeof(TEST_MESSAGE));
+    result->contentType = contentType;
+    result->content = (unsigned char*)malloc(size + 1);
+    if (size > 0)
+    {
+        (void)memcpy(result->content, content, size);
+    }
+    result->content[size] = '\0';
+    result->size = size;
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE my_IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size)
+{
+    return (IOTHUB_MESSAGE_HANDLE)test_message_create(IOTHUBMESSAGE_BYTEARRAY, byteArray, size);
+}
+
+static IOTHUB_MESSAGE_HANDLE my_IoTHubMessage_CreateFromString(const char* source)
+{
+    return (IOTHUB_MESSAGE_HANDLE)test_message_create(IOTHUBMESSAGE_STRING, (const unsigned char*)source, strlen(source));
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const unsigned char** buffer, size_t* size)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)iotHubMessageHandle;
+    *buffer = message->content;
+    *size = message->size;
+    return (message->contentType == IOTHUBMESSAGE_BYTEARRAY) ? IOTHUB_MESSAGE_OK : IOTHUB_MESSAGE_INVALID_TYPE;
+}
+
+static const char* my_IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)iotHubMessageHandle;
+    return (message->contentType == IOTHUBMESSAGE_STRING) ? (const char*)message->content : NULL;
+}
+
+static IOTHUBMESSAGE_CONTENT_TYPE my_IoTHubMessage_GetContentType(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return ((TEST_MESSAGE*)iotHubMessageHandle)->contentType;
+}
+
+static MAP_HANDLE my_IoTHubMessage_Properties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return (MAP_HANDLE)iotHubMessageHandle;
+}
+
+static const char* my_IoTHubMessage_GetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return ((TEST_MESSAGE*)iotHubMessageHandle)->messageId;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_SetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* messageId)
+{
+    ((TEST_MESSAGE*)iotHubMessageHandle)->messageId = test_strdup(messageId);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* my_IoTHubMessage_GetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return ((TEST_MESSAGE*)iotHubMessageHandle)->correlationId;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_SetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* correlationId)
+{
+    ((TEST_MESSAGE*)iotHubMessageHandle)->correlationId = test_strdup(correlationId);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static void my_IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)iotHubMessageHandle;
+    size_t i;
+    for (i = 0; i < message->propertyCount; i++)
+    {
+        free(message->keys[i]);
+        free(message->values[i]);
+    }
+    free(message->messageId);
+    free(message->correlationId);
+    free(message->content);
+    free(message);
+}
+
+static MAP_RESULT my_Map_AddOrUpdate(MAP_HANDLE handle, const char* key, const char* value)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)handle;
+    message->keys[message->propertyCount] = test_strdup(key);
+    message->values[message->propertyCount] = test_strdup(value);
+    message->propertyCount++;
+    return MAP_OK;
+}
+
+static MAP_RESULT my_Map_GetInternals(MAP_HANDLE handle, const char*const** keys, const char*const** values, size_t* count)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)handle;
+    *keys = (const char*const*)message->keys;
+    *values = (const char*const*)message->values;
+    *count = message->propertyCount;
+    return MAP_OK;
+}
+
+#include "azure_c_shared_utility/gballoc.h"
+
+#undef ENABLE_MOCKS
+
+#include "iothub_client_ll_journal.h"
+
+TEST_DEFINE_ENUM_TYPE       (IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE (IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE       (IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE (IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
+TEST_DEFINE_ENUM_TYPE       (MAP_RESULT, MAP_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE (MAP_RESULT, MAP_RESULT_VALUES);
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_JOURNAL_PATH "iothub_client_ll_journal_ut_journal"
+#define TEST_SEGMENT_SIZE 4096
+#define TEST_MAX_SEGMENTS 32
+#define TEST_MAX_REPLAYED 16
+
+/*what the replay callback saw*/
+static size_t nReplayed;
+static uint64_t replayedRecordIds[TEST_MAX_REPLAYED];
+static IOTHUB_MESSAGE_HANDLE replayedMessages[TEST_MAX_REPLAYED];
+static int replayReturn;
+
+static int replayCallback(IOTHUB_MESSAGE_HANDLE message, uint64_t recordId, void* context)
+{
+    (void)context;
+    if (replayReturn == 0)
+    {
+        replayedRecordIds[nReplayed] = recordId;
+        replayedMessages[nReplayed] = message;
+        nReplayed++;
+    }
+    return replayReturn;
+}
+
+static void destroyReplayedMessages(void)
+{
+    size_t i;
+    for (i = 0; i < nReplayed; i++)
+    {
+        my_IoTHubMessage_Destroy(replayedMessages[i]);
+    }
+    nReplayed = 0;
+}
+
+static const char* journalFileName(const char* suffix)
+{
+    static char fileName[sizeof(TEST_JOURNAL_PATH) + 16];
+    (void)sprintf(fileName, "%s.%s", TEST_JOURNAL_PATH, suffix);
+    return fileName;
+}
+
+static const char* segmentFileName(unsigned int sequence)
+{
+    char suffix[16];
+    (void)sprintf(suffix, "%u", sequence);
+    return journalFileName(suffix);
+}
+
+static bool fileExists(const char* fileName)
+{
+    FILE* file = fopen(fileName, "rb");
+    if (file != NULL)
+    {
+        (void)fclose(file);
+    }
+    return (file != NULL);
+}
+
+static long fileSize(const char* fileName)
+{
+    long result;
+    FILE* file = fopen(fileName, "rb");
+    ASSERT_IS_NOT_NULL(file);
+    (void)fseek(file, 0, SEEK_END);
+    result = ftell(file);
+    (void)fclose(file);
+    return result;
+}
+
+/*the last segment that exists on disk*/
+static unsigned int lastSegment(void)
+{
+    unsigned int result = 0;
+    unsigned int i;
+    for (i = 0; i < TEST_MAX_SEGMENTS; i++)
+    {
+        if (fileExists(segmentFileName(i)))
+        {
+            result = i;
+        }
+    }
+    return result;
+}
+
+static void removeJournalFiles(void)
+{
+    unsigned int i;
+    for (i = 0; i < TEST_MAX_SEGMENTS; i++)
+    {
+        (void)remove(segmentFileName(i));
+    }
+    (void)remove(journalFileName("head"));
+    (void)remove(journalFileName("head.tmp"));
+}
+
+static uint64_t appendString(IOTHUB_CLIENT_LL_JOURNAL_HANDLE journal, const char* content)
+{
+    uint64_t recordId = 0;
+    IOTHUB_MESSAGE_HANDLE message = my_IoTHubMessage_CreateFromString(content);
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_LL_Journal_Append(journal, message, &recordId));
+    my_IoTHubMessage_Destroy(message);
+    return recordId;
+}
+
+/*changes one byte in file at offset (from the end when offset is negative)*/
+static void flipByte(const char* fileName, long offset)
+{
+    FILE* file = fopen(fileName, "r+b");
+    int c;
+    ASSERT_IS_NOT_NULL(file);
+    (void)fseek(file, offset, (offset < 0) ? SEEK_END : SEEK_SET);
+    c = fgetc(file);
+    (void)fseek(file, offset, (offset < 0) ? SEEK_END : SEEK_SET);
+    (void)fputc(c ^ 0xFF, file);
+    (void)fclose(file);
+}
+
+/*drops the last size bytes of file, as a crash in the middle of a write would*/
+static void truncateFile(const char* fileName, long size)
+{
+    long newSize = fileSize(fileName) - size;
+    unsigned char* content = (unsigned char*)malloc(newSize + 1);
+    FILE* file = fopen(fileName, "rb");
+    ASSERT_IS_NOT_NULL(file);
+    ASSERT_ARE_EQUAL(size_t, (size_t)newSize, fread(content, 1, newSize, file));
+    (void)fclose(file);
+    file = fopen(fileName, "wb");
+    ASSERT_IS_NOT_NULL(file);
+    ASSERT_ARE_EQUAL(size_t, (size_t)newSize, fwrite(content, 1, newSize, file));
+    (void)fclose(file);
+    free(content);
+}
+
+BEGIN_TEST_SUITE(iothubclient_ll_journal_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    umocktypes_charptr_register_types();
+
+    REGISTER_TYPE(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_RESULT);
+    REGISTER_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE);
+    REGISTER_TYPE(MAP_RESULT, MAP_RESULT);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const unsigned char*, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromByteArray, my_IoTHubMessage_CreateFromByteArray);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromString, my_IoTHubMessage_CreateFromString);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArray, my_IoTHubMessage_GetByteArray);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetString, my_IoTHubMessage_GetString);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetContentType, my_IoTHubMessage_GetContentType);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Properties, my_IoTHubMessage_Properties);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetMessageId, my_IoTHubMessage_GetMessageId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetMessageId, my_IoTHubMessage_SetMessageId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetCorrelationId, my_IoTHubMessage_GetCorrelationId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetCorrelationId, my_IoTHubMessage_SetCorrelationId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Destroy, my_IoTHubMessage_Destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_AddOrUpdate, my_Map_AddOrUpdate);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_GetInternals, my_Map_GetInternals);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    removeJournalFiles();
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    removeJournalFiles();
+    nReplayed = 0;
+    replayReturn = 0;
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_001: [If path is NULL, maxSegmentSize is 0 or replayCallback is NULL then IoTHubClient_LL_Journal_Create shall fail and return NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_with_NULL_path_fails)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(NULL, TEST_SEGMENT_SIZE, replayCallback, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_001: [If path is NULL, maxSegmentSize is 0 or replayCallback is NULL then IoTHubClient_LL_Journal_Create shall fail and return NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_with_0_maxSegmentSize_fails)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, 0, replayCallback, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_001: [If path is NULL, maxSegmentSize is 0 or replayCallback is NULL then IoTHubClient_LL_Journal_Create shall fail and return NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_with_NULL_replayCallback_fails)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, NULL, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_007: [If any of the above operations fails then IoTHubClient_LL_Journal_Create shall fail and return NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_fails_when_malloc_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(NULL);
+
+    ///act
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_002: [IoTHubClient_LL_Journal_Create shall read the sequence number of the first segment from <path>.head, then from <path>.head.tmp. If neither can be read the first segment shall be <path>.0.]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_004: [IoTHubClient_LL_Journal_Create shall start a new segment, numbered after the last segment read, before replaying any record.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_on_a_new_path_starts_segment_0)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(size_t, 0, nReplayed);
+    ASSERT_IS_TRUE(fileExists(segmentFileName(0)));
+
+    ///cleanup
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_009: [IoTHubClient_LL_Journal_Append shall append to the journal a message record holding the content, message id, correlation id and properties of message, store its record id in *recordId and return 0.]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_005: [IoTHubClient_LL_Journal_Create shall call replayCallback, oldest first, with a new message for every message record that was not retired. When replayCallback does not return 0 the message shall be destroyed and the record shall stay live.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_replays_an_appended_message)
+{
+    ///arrange
+    static const unsigned char content[] = { 0x00, 0x01, 0xFF, 0x7F };
+    const unsigned char* replayedContent;
+    size_t replayedSize;
+    uint64_t recordId;
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+    IOTHUB_MESSAGE_HANDLE message = my_IoTHubMessage_CreateFromByteArray(content, sizeof(content));
+    (void)my_IoTHubMessage_SetMessageId(message, "theMessageId");
+    (void)my_IoTHubMessage_SetCorrelationId(message, "theCorrelationId");
+    (void)my_Map_AddOrUpdate(my_IoTHubMessage_Properties(message), "aKey", "aValue");
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_LL_Journal_Append(h, message, &recordId));
+    my_IoTHubMessage_Destroy(message);
+    IoTHubClient_LL_Journal_Destroy(h);
+    umock_c_reset_all_calls();
+
+    ///act
+    h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(size_t, 1, nReplayed);
+    ASSERT_ARE_EQUAL(uint64_t, recordId, replayedRecordIds[0]);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, my_IoTHubMessage_GetByteArray(replayedMessages[0], &replayedContent, &replayedSize));
+    ASSERT_ARE_EQUAL(size_t, sizeof(content), replayedSize);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(content, replayedContent, sizeof(content)));
+    ASSERT_ARE_EQUAL(char_ptr, "theMessageId", my_IoTHubMessage_GetMessageId(replayedMessages[0]));
+    ASSERT_ARE_EQUAL(char_ptr, "theCorrelationId", my_IoTHubMessage_GetCorrelationId(replayedMessages[0]));
+    ASSERT_ARE_EQUAL(size_t, 1, ((TEST_MESSAGE*)replayedMessages[0])->propertyCount);
+    ASSERT_ARE_EQUAL(char_ptr, "aKey", ((TEST_MESSAGE*)replayedMessages[0])->keys[0]);
+    ASSERT_ARE_EQUAL(char_ptr, "aValue", ((TEST_MESSAGE*)replayedMessages[0])->values[0]);
+
+    ///cleanup
+    destroyReplayedMessages();
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_005: [IoTHubClient_LL_Journal_Create shall call replayCallback, oldest first, with a new message for every message record that was not retired. When replayCallback does not return 0 the message shall be destroyed and the record shall stay live.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_replays_string_messages_oldest_first)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+    (void)appendString(h, "first");
+    (void)appendString(h, "second");
+    IoTHubClient_LL_Journal_Destroy(h);
+    umock_c_reset_all_calls();
+
+    ///act
+    h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, nReplayed);
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_STRING, my_IoTHubMessage_GetContentType(replayedMessages[0]));
+    ASSERT_ARE_EQUAL(char_ptr, "first", my_IoTHubMessage_GetString(replayedMessages[0]));
+    ASSERT_ARE_EQUAL(char_ptr, "second", my_IoTHubMessage_GetString(replayedMessages[1]));
+    ASSERT_IS_NULL(my_IoTHubMessage_GetMessageId(replayedMessages[0]));
+    ASSERT_IS_TRUE(replayedRecordIds[0] < replayedRecordIds[1]);
+
+    ///cleanup
+    destroyReplayedMessages();
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_005: [IoTHubClient_LL_Journal_Create shall call replayCallback, oldest first, with a new message for every message record that was not retired. When replayCallback does not return 0 the message shall be destroyed and the record shall stay live.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_keeps_the_records_refused_by_replayCallback)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+    (void)appendString(h, "refused");
+    IoTHubClient_LL_Journal_Destroy(h);
+    replayReturn = __LINE__;
+    h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+    IoTHubClient_LL_Journal_Destroy(h);
+    replayReturn = 0;
+    umock_c_reset_all_calls();
+
+    ///act
+    h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, nReplayed);
+    ASSERT_ARE_EQUAL(char_ptr, "refused", my_IoTHubMessage_GetString(replayedMessages[0]));
+
+    ///cleanup
+    destroyReplayedMessages();
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_013: [IoTHubClient_LL_Journal_Retire shall append a record retiring recordId. If that fails IoTHubClient_LL_Journal_Retire shall return a non-zero value and the message record shall stay live.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_does_not_replay_retired_messages)
+{
+    ///arrange
+    uint64_t retired;
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+    retired = appendString(h, "retired");
+    (void)appendString(h, "live");
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_LL_Journal_Retire(h, retired));
+    IoTHubClient_LL_Journal_Destroy(h);
+    umock_c_reset_all_calls();
+
+    ///act
+    h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, nReplayed);
+    ASSERT_ARE_EQUAL(char_ptr, "live", my_IoTHubMessage_GetString(replayedMessages[0]));
+
+    ///cleanup
+    destroyReplayedMessages();
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_014: [IoTHubClient_LL_Journal_Retire shall delete the segments at the head of the journal that have no live records, except the segment being appended to. The head file shall be updated before a segment is deleted.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Retire_deletes_the_segments_without_live_records)
+{
+    ///arrange
+    uint64_t recordIds[3];
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, 1, replayCallback, NULL); /*one record per segment*/
+    recordIds[0] = appendString(h, "in segment 0");
+    recordIds[1] = appendString(h, "in segment 1");
+    recordIds[2] = appendString(h, "in segment 2");
+    ASSERT_IS_TRUE(fileExists(segmentFileName(2)));
+    umock_c_reset_all_calls();
+
+    ///act
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_LL_Journal_Retire(h, recordIds[1]));
+    ASSERT_IS_TRUE(fileExists(segmentFileName(0)));
+    ASSERT_IS_TRUE(fileExists(segmentFileName(1)));
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_LL_Journal_Retire(h, recordIds[0]));
+
+    ///assert
+    ASSERT_IS_TRUE(!fileExists(segmentFileName(0)));
+    ASSERT_IS_TRUE(!fileExists(segmentFileName(1)));
+    ASSERT_IS_TRUE(fileExists(segmentFileName(2)));
+    ASSERT_IS_TRUE(fileExists(journalFileName("head")));
+
+    ///cleanup
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_002: [IoTHubClient_LL_Journal_Create shall read the sequence number of the first segment from <path>.head, then from <path>.head.tmp. If neither can be read the first segment shall be <path>.0.]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_006: [IoTHubClient_LL_Journal_Create shall delete the segments at the head of the journal that have no live records, except the segment being appended to.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_after_compaction_starts_from_the_head)
+{
+    ///arrange
+    uint64_t recordId;
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, 1, replayCallback, NULL);
+    recordId = appendString(h, "retired");
+    (void)appendString(h, "live");
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_LL_Journal_Retire(h, recordId));
+    IoTHubClient_LL_Journal_Destroy(h);
+    ASSERT_IS_TRUE(!fileExists(segmentFileName(0)));
+    umock_c_reset_all_calls();
+
+    ///act
+    h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, 1, replayCallback, NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(size_t, 1, nReplayed);
+    ASSERT_ARE_EQUAL(char_ptr, "live", my_IoTHubMessage_GetString(replayedMessages[0]));
+    /*the segments holding only retire records are gone, the one with the live message and the new one remain*/
+    ASSERT_IS_TRUE(fileExists(segmentFileName(1)));
+    ASSERT_IS_TRUE(fileExists(segmentFileName(lastSegment())));
+    ASSERT_IS_TRUE(lastSegment() > 1);
+
+    ///cleanup
+    destroyReplayedMessages();
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_010: [A new segment shall be started when the record would make the segment being appended to larger than maxSegmentSize (unless that segment is empty) or when a previous write to it failed.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Append_starts_a_new_segment_when_the_segment_is_full)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, 64, replayCallback, NULL);
+    (void)appendString(h, "a message that fills most of the segment");
+    ASSERT_IS_TRUE(!fileExists(segmentFileName(1)));
+    umock_c_reset_all_calls();
+
+    ///act
+    (void)appendString(h, "a message that needs a new segment");
+
+    ///assert
+    ASSERT_IS_TRUE(fileExists(segmentFileName(1)));
+
+    ///cleanup
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_003: [IoTHubClient_LL_Journal_Create shall read the segments starting with the first one until a segment does not exist. A segment shall be read up to the first record that is incomplete or that fails the CRC check.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_ignores_a_torn_record)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+    (void)appendString(h, "complete");
+    (void)appendString(h, "torn");
+    IoTHubClient_LL_Journal_Destroy(h);
+    truncateFile(segmentFileName(0), 1);
+    umock_c_reset_all_calls();
+
+    ///act
+    h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(size_t, 1, nReplayed);
+    ASSERT_ARE_EQUAL(char_ptr, "complete", my_IoTHubMessage_GetString(replayedMessages[0]));
+
+    ///cleanup
+    destroyReplayedMessages();
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_003: [IoTHubClient_LL_Journal_Create shall read the segments starting with the first one until a segment does not exist. A segment shall be read up to the first record that is incomplete or that fails the CRC check.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_stops_at_a_record_that_fails_the_crc_check)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+    (void)appendString(h, "corrupted");
+    (void)appendString(h, "after the corrupted one");
+    IoTHubClient_LL_Journal_Destroy(h);
+    flipByte(segmentFileName(0), 20); /*inside the payload of the first record*/
+    umock_c_reset_all_calls();
+
+    ///act
+    h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(size_t, 0, nReplayed);
+
+    ///cleanup
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_002: [IoTHubClient_LL_Journal_Create shall read the sequence number of the first segment from <path>.head, then from <path>.head.tmp. If neither can be read the first segment shall be <path>.0.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Create_uses_the_temporary_head_when_the_head_is_missing)
+{
+    ///arrange
+    uint64_t recordId;
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, 1, replayCallback, NULL);
+    recordId = appendString(h, "retired");
+    (void)appendString(h, "live");
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_LL_Journal_Retire(h, recordId));
+    IoTHubClient_LL_Journal_Destroy(h);
+    /*a crash between removing the head and renaming the temporary head*/
+    ASSERT_ARE_EQUAL(int, 0, rename(journalFileName("head"), journalFileName("head.tmp")));
+    umock_c_reset_all_calls();
+
+    ///act
+    h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, 1, replayCallback, NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(size_t, 1, nReplayed);
+    ASSERT_ARE_EQUAL(char_ptr, "live", my_IoTHubMessage_GetString(replayedMessages[0]));
+
+    ///cleanup
+    destroyReplayedMessages();
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_008: [If handle, message or recordId is NULL then IoTHubClient_LL_Journal_Append shall fail and return a non-zero value.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Append_with_NULL_arguments_fails)
+{
+    ///arrange
+    uint64_t recordId;
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+    IOTHUB_MESSAGE_HANDLE message = my_IoTHubMessage_CreateFromString("a message");
+    umock_c_reset_all_calls();
+
+    ///act
+    int result1 = IoTHubClient_LL_Journal_Append(NULL, message, &recordId);
+    int result2 = IoTHubClient_LL_Journal_Append(h, NULL, &recordId);
+    int result3 = IoTHubClient_LL_Journal_Append(h, message, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    my_IoTHubMessage_Destroy(message);
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_011: [If any of the above operations fails then IoTHubClient_LL_Journal_Append shall fail and return a non-zero value.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Append_fails_when_the_content_cannot_be_read)
+{
+    ///arrange
+    uint64_t recordId;
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+    IOTHUB_MESSAGE_HANDLE message = my_IoTHubMessage_CreateFromString("a message");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(message));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(message))
+        .SetReturn(NULL);
+
+    ///act
+    int result = IoTHubClient_LL_Journal_Append(h, message, &recordId);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(fileSize(segmentFileName(0)) == 0);
+
+    ///cleanup
+    my_IoTHubMessage_Destroy(message);
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_012: [If handle is NULL, or recordId was not returned by IoTHubClient_LL_Journal_Append or IoTHubClient_LL_Journal_Create, or the segment holding recordId has no live records then IoTHubClient_LL_Journal_Retire shall fail and return a non-zero value.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Retire_with_NULL_handle_fails)
+{
+    ///arrange
+
+    ///act
+    int result = IoTHubClient_LL_Journal_Retire(NULL, 1);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_012: [If handle is NULL, or recordId was not returned by IoTHubClient_LL_Journal_Append or IoTHubClient_LL_Journal_Create, or the segment holding recordId has no live records then IoTHubClient_LL_Journal_Retire shall fail and return a non-zero value.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Retire_of_an_unknown_record_fails)
+{
+    ///arrange
+    uint64_t recordId;
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+    recordId = appendString(h, "a message");
+    umock_c_reset_all_calls();
+
+    ///act
+    int result1 = IoTHubClient_LL_Journal_Retire(h, 0);
+    int result2 = IoTHubClient_LL_Journal_Retire(h, recordId + 1);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+
+    ///cleanup
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_015: [If handle is NULL then IoTHubClient_LL_Journal_Sync shall fail and return a non-zero value.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Sync_with_NULL_handle_fails)
+{
+    ///arrange
+
+    ///act
+    int result = IoTHubClient_LL_Journal_Sync(NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_016: [IoTHubClient_LL_Journal_Sync shall flush the segment being appended to to the disk when it was written since the last sync and return 0 on success.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Sync_succeeds)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+    (void)appendString(h, "a message");
+    umock_c_reset_all_calls();
+
+    ///act
+    int result1 = IoTHubClient_LL_Journal_Sync(h);
+    int result2 = IoTHubClient_LL_Journal_Sync(h);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_IS_TRUE(fileSize(segmentFileName(0)) > 0);
+
+    ///cleanup
+    IoTHubClient_LL_Journal_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_017: [If handle is NULL then IoTHubClient_LL_Journal_Destroy shall do nothing.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Destroy_with_NULL_handle_does_nothing)
+{
+    ///arrange
+
+    ///act
+    IoTHubClient_LL_Journal_Destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_JOURNAL_10_018: [IoTHubClient_LL_Journal_Destroy shall sync and close the journal and free all resources. The files shall stay on disk.]*/
+TEST_FUNCTION(IoTHubClient_LL_Journal_Destroy_keeps_the_files)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_JOURNAL_HANDLE h = IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, TEST_SEGMENT_SIZE, replayCallback, NULL);
+    (void)appendString(h, "a message");
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubClient_LL_Journal_Destroy(h);
+
+    ///assert
+    ASSERT_IS_TRUE(fileExists(segmentFileName(0)));
+    ASSERT_IS_TRUE(fileSize(segmentFileName(0)) > 0);
+}
+
+END_TEST_SUITE(iothubclient_ll_journal_ut)
+#endif /*DONT_USE_JOURNAL*/
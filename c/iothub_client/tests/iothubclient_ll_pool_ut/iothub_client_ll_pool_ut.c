@@ -0,0 +1,425 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+
+void* my_gballoc_malloc(size_t size)
+{
+    void *result = malloc(size);
+    return result;
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "azure_c_shared_utility/macro_utils.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+
+#undef ENABLE_MOCKS
+
+#include "iothub_client_ll_pool.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_OBJECT_SIZE 13
+#define TEST_OBJECT_COUNT 3
+
+static IOTHUB_CLIENT_LL_POOL_HANDLE createTestPool(void)
+{
+    IOTHUB_CLIENT_LL_POOL_HANDLE result = IoTHubClient_LL_Pool_Create(TEST_OBJECT_SIZE, TEST_OBJECT_COUNT);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(iothubclient_ll_pool_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    umocktypes_charptr_register_types();
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_001: [If objectSize is 0 or objectCount is 0 then IoTHubClient_LL_Pool_Create shall fail and return NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Create_with_0_objectSize_fails)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = IoTHubClient_LL_Pool_Create(0, TEST_OBJECT_COUNT);
+
+    ///assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_001: [If objectSize is 0 or objectCount is 0 then IoTHubClient_LL_Pool_Create shall fail and return NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Create_with_0_objectCount_fails)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = IoTHubClient_LL_Pool_Create(TEST_OBJECT_SIZE, 0);
+
+    ///assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_002: [IoTHubClient_LL_Pool_Create shall round objectSize up to a multiple of the alignment of pointers, long long and double. If the size of the block of memory cannot be represented in a size_t then IoTHubClient_LL_Pool_Create shall fail and return NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Create_with_a_too_big_pool_fails)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_LL_POOL_HANDLE h1 = IoTHubClient_LL_Pool_Create((size_t)-1, 1);
+    IOTHUB_CLIENT_LL_POOL_HANDLE h2 = IoTHubClient_LL_Pool_Create(TEST_OBJECT_SIZE, ((size_t)-1) / 2);
+
+    ///assert
+    ASSERT_IS_NULL(h1);
+    ASSERT_IS_NULL(h2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_002: [IoTHubClient_LL_Pool_Create shall round objectSize up to a multiple of the alignment of pointers, long long and double. If the size of the block of memory cannot be represented in a size_t then IoTHubClient_LL_Pool_Create shall fail and return NULL.]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_003: [IoTHubClient_LL_Pool_Create shall allocate the pool and one block of memory holding objectCount objects and shall chain all the objects in the list of free objects.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Create_allocates_the_pool_and_one_block)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(16 * TEST_OBJECT_COUNT));
+
+    ///act
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = IoTHubClient_LL_Pool_Create(TEST_OBJECT_SIZE, TEST_OBJECT_COUNT);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Pool_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_004: [If any of the above operations fails then IoTHubClient_LL_Pool_Create shall fail and return NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Create_fails_when_malloc_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(NULL);
+
+    ///act
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = IoTHubClient_LL_Pool_Create(TEST_OBJECT_SIZE, TEST_OBJECT_COUNT);
+
+    ///assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_004: [If any of the above operations fails then IoTHubClient_LL_Pool_Create shall fail and return NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Create_fails_when_the_block_cannot_be_allocated)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = IoTHubClient_LL_Pool_Create(TEST_OBJECT_SIZE, TEST_OBJECT_COUNT);
+
+    ///assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_005: [If handle is NULL then IoTHubClient_LL_Pool_Alloc shall return NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Alloc_with_NULL_handle_returns_NULL)
+{
+    ///arrange
+
+    ///act
+    void* object = IoTHubClient_LL_Pool_Alloc(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(object);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_006: [If the list of free objects is not empty then IoTHubClient_LL_Pool_Alloc shall remove its first object, count a hit and return the object.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Alloc_hands_out_the_objects_of_the_block_without_malloc)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = createTestPool();
+    IOTHUB_CLIENT_POOL_STATISTICS statistics;
+
+    ///act
+    unsigned char* object1 = (unsigned char*)IoTHubClient_LL_Pool_Alloc(h);
+    unsigned char* object2 = (unsigned char*)IoTHubClient_LL_Pool_Alloc(h);
+    unsigned char* object3 = (unsigned char*)IoTHubClient_LL_Pool_Alloc(h);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(object1);
+    ASSERT_IS_TRUE(object2 == object1 + 16);
+    ASSERT_IS_TRUE(object3 == object2 + 16);
+    (void)memset(object1, 0xFF, TEST_OBJECT_SIZE);
+    (void)memset(object2, 0xFF, TEST_OBJECT_SIZE);
+    (void)memset(object3, 0xFF, TEST_OBJECT_SIZE);
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_LL_Pool_GetStatistics(h, &statistics));
+    ASSERT_ARE_EQUAL(size_t, 3, statistics.inUse);
+    ASSERT_ARE_EQUAL(size_t, 3, statistics.peakInUse);
+    ASSERT_ARE_EQUAL(uint64_t, 3, statistics.hits);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.misses);
+
+    ///cleanup
+    IoTHubClient_LL_Pool_Free(h, object1);
+    IoTHubClient_LL_Pool_Free(h, object2);
+    IoTHubClient_LL_Pool_Free(h, object3);
+    IoTHubClient_LL_Pool_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_007: [Otherwise IoTHubClient_LL_Pool_Alloc shall count a miss and return the result of malloc for objectSize bytes.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Alloc_on_an_empty_pool_mallocs)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = createTestPool();
+    IOTHUB_CLIENT_POOL_STATISTICS statistics;
+    void* objects[TEST_OBJECT_COUNT];
+    size_t i;
+    for (i = 0; i < TEST_OBJECT_COUNT; i++)
+    {
+        objects[i] = IoTHubClient_LL_Pool_Alloc(h);
+    }
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(TEST_OBJECT_SIZE));
+
+    ///act
+    void* object = IoTHubClient_LL_Pool_Alloc(h);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(object);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_LL_Pool_GetStatistics(h, &statistics));
+    ASSERT_ARE_EQUAL(size_t, TEST_OBJECT_COUNT, statistics.inUse);
+    ASSERT_ARE_EQUAL(uint64_t, TEST_OBJECT_COUNT, statistics.hits);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.misses);
+
+    ///cleanup
+    IoTHubClient_LL_Pool_Free(h, object);
+    for (i = 0; i < TEST_OBJECT_COUNT; i++)
+    {
+        IoTHubClient_LL_Pool_Free(h, objects[i]);
+    }
+    IoTHubClient_LL_Pool_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_008: [If handle is NULL or object is NULL then IoTHubClient_LL_Pool_Free shall do nothing.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Free_with_NULL_object_does_nothing)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = createTestPool();
+
+    ///act
+    IoTHubClient_LL_Pool_Free(h, NULL);
+    IoTHubClient_LL_Pool_Free(NULL, h);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Pool_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_009: [If object belongs to the block of memory of the pool then IoTHubClient_LL_Pool_Free shall insert it at the head of the list of free objects.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Free_gives_the_object_back_to_the_pool)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = createTestPool();
+    IOTHUB_CLIENT_POOL_STATISTICS statistics;
+    void* object1 = IoTHubClient_LL_Pool_Alloc(h);
+    void* object2 = IoTHubClient_LL_Pool_Alloc(h);
+
+    ///act
+    IoTHubClient_LL_Pool_Free(h, object1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(IoTHubClient_LL_Pool_Alloc(h) == object1);
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_LL_Pool_GetStatistics(h, &statistics));
+    ASSERT_ARE_EQUAL(size_t, 2, statistics.inUse);
+    ASSERT_ARE_EQUAL(size_t, 2, statistics.peakInUse);
+
+    ///cleanup
+    IoTHubClient_LL_Pool_Free(h, object1);
+    IoTHubClient_LL_Pool_Free(h, object2);
+    IoTHubClient_LL_Pool_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_010: [Otherwise IoTHubClient_LL_Pool_Free shall free object.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Free_frees_an_object_that_was_malloced)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = createTestPool();
+    void* objects[TEST_OBJECT_COUNT];
+    void* object;
+    size_t i;
+    for (i = 0; i < TEST_OBJECT_COUNT; i++)
+    {
+        objects[i] = IoTHubClient_LL_Pool_Alloc(h);
+    }
+    object = IoTHubClient_LL_Pool_Alloc(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(object));
+
+    ///act
+    IoTHubClient_LL_Pool_Free(h, object);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    for (i = 0; i < TEST_OBJECT_COUNT; i++)
+    {
+        IoTHubClient_LL_Pool_Free(h, objects[i]);
+    }
+    IoTHubClient_LL_Pool_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_011: [If handle is NULL or statistics is NULL then IoTHubClient_LL_Pool_GetStatistics shall fail and return a non-zero value.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_GetStatistics_with_NULL_arguments_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = createTestPool();
+    IOTHUB_CLIENT_POOL_STATISTICS statistics;
+
+    ///act
+    int result1 = IoTHubClient_LL_Pool_GetStatistics(NULL, &statistics);
+    int result2 = IoTHubClient_LL_Pool_GetStatistics(h, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Pool_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_012: [IoTHubClient_LL_Pool_GetStatistics shall copy the capacity, the number of objects in use, the peak number of objects in use, the hits and the misses of the pool in *statistics and return 0.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_GetStatistics_of_a_new_pool_succeeds)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = createTestPool();
+    IOTHUB_CLIENT_POOL_STATISTICS statistics;
+
+    ///act
+    int result = IoTHubClient_LL_Pool_GetStatistics(h, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, TEST_OBJECT_COUNT, statistics.capacity);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.inUse);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.peakInUse);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.hits);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.misses);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Pool_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_013: [If handle is NULL then IoTHubClient_LL_Pool_Destroy shall do nothing.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Destroy_with_NULL_handle_does_nothing)
+{
+    ///arrange
+
+    ///act
+    IoTHubClient_LL_Pool_Destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_POOL_10_014: [IoTHubClient_LL_Pool_Destroy shall free the block of memory of the pool and the pool. Objects of the pool still in use become invalid.]*/
+TEST_FUNCTION(IoTHubClient_LL_Pool_Destroy_frees_the_block_and_the_pool)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_POOL_HANDLE h = createTestPool();
+    (void)IoTHubClient_LL_Pool_Alloc(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+
+    ///act
+    IoTHubClient_LL_Pool_Destroy(h);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothubclient_ll_pool_ut)
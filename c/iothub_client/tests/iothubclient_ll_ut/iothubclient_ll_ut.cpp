@@ -24,6 +24,12 @@
 #include "iothub_client_ll_uploadtoblob.h"
 #endif
 
+#ifndef DONT_USE_JOURNAL
+#include "iothub_client_ll_journal.h"
+#endif
+
+#include "iothub_client_ll_pool.h"
+
 #include "azure_c_shared_utility/string_tokenizer.h"
 #include "azure_c_shared_utility/strings.h"
 
@@ -83,6 +89,7 @@ static bool checkProtocolGatewayIsNull;
 
 #define TEST_DEVICEMESSAGE_HANDLE (IOTHUB_MESSAGE_HANDLE)0x52
 #define TEST_DEVICEMESSAGE_HANDLE_2 (IOTHUB_MESSAGE_HANDLE)0x53
+#define TEST_POOL_HANDLE (IOTHUB_CLIENT_LL_POOL_HANDLE)0x54
 #define TEST_IOTHUB_CLIENT_LL_HANDLE    (IOTHUB_CLIENT_LL_HANDLE)0x4242
 
 #define TEST_STRING_HANDLE (STRING_HANDLE)0x46
@@ -146,7 +153,13 @@ static const IOTHUB_CLIENT_DEVICE_CONFIG TEST_DEVICE_CONFIG_NULL_device_key_NULL
 
 static size_t currentmalloc_call;
 static size_t whenShallmalloc_fail;
+static size_t currentIoTHubMessage_Clone_call;
+static size_t currentMessageSize;
+static size_t currentrealloc_call;
+static size_t whenShallrealloc_fail;
+static PDLIST_ENTRY currentWaitingToSend;
 static IOTHUB_CLIENT_STATUS currentIotHubClientStatus;
+static size_t currentPoolInUse;
 
 TYPED_MOCK_CLASS(CIoTHubClientLLMocks, CGlobalMock)
 {
@@ -198,7 +211,17 @@ public:
     MOCK_METHOD_END(void*, result2);
 
     MOCK_STATIC_METHOD_2(, void*, gballoc_realloc, void*, ptr, size_t, size)
-        MOCK_METHOD_END(void*, BASEIMPLEMENTATION::gballoc_realloc(ptr, size));
+        void* result2;
+    currentrealloc_call++;
+    if ((whenShallrealloc_fail > 0) && (currentrealloc_call == whenShallrealloc_fail))
+    {
+        result2 = (void*)NULL;
+    }
+    else
+    {
+        result2 = BASEIMPLEMENTATION::gballoc_realloc(ptr, size);
+    }
+    MOCK_METHOD_END(void*, result2);
 
     MOCK_STATIC_METHOD_1(, void, gballoc_free, void*, ptr)
         BASEIMPLEMENTATION::gballoc_free(ptr);
@@ -244,6 +267,7 @@ public:
         MOCK_VOID_METHOD_END()
 
         MOCK_STATIC_METHOD_4(, IOTHUB_DEVICE_HANDLE, FAKE_IoTHubTransport_Register, TRANSPORT_LL_HANDLE, handle, const IOTHUB_DEVICE_CONFIG*, device, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, PDLIST_ENTRY, waitingToSend)
+        currentWaitingToSend = waitingToSend;
         MOCK_METHOD_END(IOTHUB_DEVICE_HANDLE, (IOTHUB_DEVICE_HANDLE)handle)
 
         MOCK_STATIC_METHOD_1(, void, FAKE_IoTHubTransport_Unregister, IOTHUB_DEVICE_HANDLE, handle)
@@ -268,12 +292,27 @@ public:
         MOCK_STATIC_METHOD_2(, IOTHUBMESSAGE_DISPOSITION_RESULT, messageCallback, IOTHUB_MESSAGE_HANDLE, message, void*, userContextCallback)
         MOCK_METHOD_END(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_ACCEPTED);
 
+        MOCK_STATIC_METHOD_2(, void, sendQueueCallback, IOTHUB_CLIENT_SEND_QUEUE_WATERMARK, watermark, void*, userContextCallback)
+        MOCK_VOID_METHOD_END()
+
     MOCK_STATIC_METHOD_1(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_Clone, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle)
+        currentIoTHubMessage_Clone_call++;
         MOCK_METHOD_END(IOTHUB_MESSAGE_HANDLE, (IOTHUB_MESSAGE_HANDLE)((uintptr_t)iotHubMessageHandle + 1000))
 
         MOCK_STATIC_METHOD_1(, void, IoTHubMessage_Destroy, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle)
         MOCK_VOID_METHOD_END()
 
+    MOCK_STATIC_METHOD_1(, IOTHUBMESSAGE_CONTENT_TYPE, IoTHubMessage_GetContentType, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle)
+    MOCK_METHOD_END(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY)
+
+    MOCK_STATIC_METHOD_3(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const unsigned char**, buffer, size_t*, size)
+        *buffer = (const unsigned char*)TEST_CHAR;
+        *size = currentMessageSize;
+    MOCK_METHOD_END(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK)
+
+    MOCK_STATIC_METHOD_1(, const char*, IoTHubMessage_GetString, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle)
+    MOCK_METHOD_END(const char*, TEST_CHAR)
+
         MOCK_STATIC_METHOD_1(, time_t, get_time, time_t*, t)
         MOCK_METHOD_END(time_t, time(t));
 
@@ -338,6 +377,46 @@ public:
     MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK)
 #endif
 
+#ifndef DONT_USE_JOURNAL
+    MOCK_STATIC_METHOD_4(, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, IoTHubClient_LL_Journal_Create, const char*, path, size_t, maxSegmentSize, IOTHUB_CLIENT_LL_JOURNAL_REPLAY_CALLBACK, replayCallback, void*, context)
+        IOTHUB_CLIENT_LL_JOURNAL_HANDLE result2 = (IOTHUB_CLIENT_LL_JOURNAL_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1);
+    MOCK_METHOD_END(IOTHUB_CLIENT_LL_JOURNAL_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_3(, int, IoTHubClient_LL_Journal_Append, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, handle, IOTHUB_MESSAGE_HANDLE, message, uint64_t*, recordId)
+        *recordId = 1;
+    MOCK_METHOD_END(int, 0)
+
+    MOCK_STATIC_METHOD_2(, int, IoTHubClient_LL_Journal_Retire, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, handle, uint64_t, recordId)
+    MOCK_METHOD_END(int, 0)
+
+    MOCK_STATIC_METHOD_1(, int, IoTHubClient_LL_Journal_Sync, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, handle)
+    MOCK_METHOD_END(int, 0)
+
+    MOCK_STATIC_METHOD_1(, void, IoTHubClient_LL_Journal_Destroy, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, handle)
+        BASEIMPLEMENTATION::gballoc_free(handle);
+    MOCK_VOID_METHOD_END()
+#endif
+
+    MOCK_STATIC_METHOD_2(, IOTHUB_CLIENT_LL_POOL_HANDLE, IoTHubClient_LL_Pool_Create, size_t, objectSize, size_t, objectCount)
+    MOCK_METHOD_END(IOTHUB_CLIENT_LL_POOL_HANDLE, TEST_POOL_HANDLE)
+
+    MOCK_STATIC_METHOD_1(, void*, IoTHubClient_LL_Pool_Alloc, IOTHUB_CLIENT_LL_POOL_HANDLE, handle)
+        currentPoolInUse++;
+    MOCK_METHOD_END(void*, BASEIMPLEMENTATION::gballoc_malloc(sizeof(IOTHUB_MESSAGE_LIST)))
+
+    MOCK_STATIC_METHOD_2(, void, IoTHubClient_LL_Pool_Free, IOTHUB_CLIENT_LL_POOL_HANDLE, handle, void*, object)
+        currentPoolInUse--;
+        BASEIMPLEMENTATION::gballoc_free(object);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, int, IoTHubClient_LL_Pool_GetStatistics, IOTHUB_CLIENT_LL_POOL_HANDLE, handle, IOTHUB_CLIENT_POOL_STATISTICS*, statistics)
+        memset(statistics, 0, sizeof(IOTHUB_CLIENT_POOL_STATISTICS));
+        statistics->inUse = currentPoolInUse;
+    MOCK_METHOD_END(int, 0)
+
+    MOCK_STATIC_METHOD_1(, void, IoTHubClient_LL_Pool_Destroy, IOTHUB_CLIENT_LL_POOL_HANDLE, handle)
+    MOCK_VOID_METHOD_END()
+
 };
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientLLMocks, , void, DList_InitializeListHead, PDLIST_ENTRY, listHead);
@@ -364,10 +443,14 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientLLMocks, , IOTHUB_CLIENT_RESULT, FAKE_
 
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientLLMocks, , void, eventConfirmationCallback, IOTHUB_CLIENT_CONFIRMATION_RESULT, result2, void*, userContextCallback);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientLLMocks, , IOTHUBMESSAGE_DISPOSITION_RESULT, messageCallback, IOTHUB_MESSAGE_HANDLE, message, void*, userContextCallback);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientLLMocks, , void, sendQueueCallback, IOTHUB_CLIENT_SEND_QUEUE_WATERMARK, watermark, void*, userContextCallback);
 
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientLLMocks, , IOTHUB_MESSAGE_HANDLE, IoTHubMessage_Clone, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientLLMocks, , void, IoTHubMessage_Destroy, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientLLMocks, , IOTHUBMESSAGE_CONTENT_TYPE, IoTHubMessage_GetContentType, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubClientLLMocks, , IOTHUB_MESSAGE_RESULT, IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const unsigned char**, buffer, size_t*, size);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientLLMocks, , const char*, IoTHubMessage_GetString, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientLLMocks, , time_t, get_time, time_t*, t);
 
@@ -395,6 +478,20 @@ DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubClientLLMocks, , IOTHUB_CLIENT_RESULT, IoTHu
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientLLMocks, , void, IoTHubClient_LL_UploadToBlob_Destroy, IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE, handle);
 #endif
 
+#ifndef DONT_USE_JOURNAL
+DECLARE_GLOBAL_MOCK_METHOD_4(CIoTHubClientLLMocks, , IOTHUB_CLIENT_LL_JOURNAL_HANDLE, IoTHubClient_LL_Journal_Create, const char*, path, size_t, maxSegmentSize, IOTHUB_CLIENT_LL_JOURNAL_REPLAY_CALLBACK, replayCallback, void*, context);
+DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubClientLLMocks, , int, IoTHubClient_LL_Journal_Append, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, handle, IOTHUB_MESSAGE_HANDLE, message, uint64_t*, recordId);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientLLMocks, , int, IoTHubClient_LL_Journal_Retire, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, handle, uint64_t, recordId);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientLLMocks, , int, IoTHubClient_LL_Journal_Sync, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientLLMocks, , void, IoTHubClient_LL_Journal_Destroy, IOTHUB_CLIENT_LL_JOURNAL_HANDLE, handle);
+#endif
+
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientLLMocks, , IOTHUB_CLIENT_LL_POOL_HANDLE, IoTHubClient_LL_Pool_Create, size_t, objectSize, size_t, objectCount);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientLLMocks, , void*, IoTHubClient_LL_Pool_Alloc, IOTHUB_CLIENT_LL_POOL_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientLLMocks, , void, IoTHubClient_LL_Pool_Free, IOTHUB_CLIENT_LL_POOL_HANDLE, handle, void*, object);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientLLMocks, , int, IoTHubClient_LL_Pool_GetStatistics, IOTHUB_CLIENT_LL_POOL_HANDLE, handle, IOTHUB_CLIENT_POOL_STATISTICS*, statistics);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientLLMocks, , void, IoTHubClient_LL_Pool_Destroy, IOTHUB_CLIENT_LL_POOL_HANDLE, handle);
+
 static TRANSPORT_PROVIDER FAKE_transport_provider =
 {
     FAKE_IoTHubTransport_GetHostname,   /*pfIoTHubTransport_GetHostname IoTHubTransport_GetHostname     */
@@ -438,6 +535,12 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     }
     currentmalloc_call = 0;
     whenShallmalloc_fail = 0;
+    currentIoTHubMessage_Clone_call = 0;
+    currentMessageSize = 10;
+    currentrealloc_call = 0;
+    whenShallrealloc_fail = 0;
+    currentWaitingToSend = NULL;
+    currentPoolInUse = 0;
     checkProtocolGatewayHostName = false;
     checkProtocolGatewayIsNull = false;
 }
@@ -3151,55 +3254,78 @@ TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails_when_malloc_fails)
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_016: [IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.]*/
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_NULL_iotHubClientHandle_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_001: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_TakeOwnership_with_NULL_iotHubClientHandle_fails)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
+    auto messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
 
     ///act
-    auto result = IoTHubClient_LL_SetMessageCallback(NULL, messageCallback, (void*)1);
+    auto result = IoTHubClient_LL_SendEventAsync_TakeOwnership(NULL, messageHandle, eventConfirmationCallback, (void*)3);
 
     ///assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
-    mocks.AssertActualAndExpectedCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_019: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_NULL_calls_Unsubscribe_and_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_001: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_TakeOwnership_with_NULL_messageHandle_fails)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Unsubscribe(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    ///act
+    auto result = IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, NULL, eventConfirmationCallback, (void*)3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_002: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_TakeOwnership_with_NULL_eventConfirmationCallback_and_non_NULL_context_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    auto messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    mocks.ResetAllCalls();
 
     ///act
-    auto result = IoTHubClient_LL_SetMessageCallback(handle, NULL, (void*)1);
+    auto result = IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, messageHandle, NULL, (void*)3);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_017: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Subscribe function.]*/
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_non_NULL_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_003: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall add to the DLIST waitingToSend a new record that stores eventMessageHandle itself (without calling IoTHubMessage_Clone), eventConfirmationCallback and userContextCallback. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_005: [ Otherwise IoTHubClient_LL_SendEventAsync_TakeOwnership shall succeed and return IOTHUB_CLIENT_OK. From then on the message handle is owned by IoTHubClient_LL and shall be destroyed by it once the message is completed, timed out or the handle is destroyed. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_TakeOwnership_succeeds)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    auto messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*the IOTHUB_MESSAGE_LIST is the only allocation, no IoTHubMessage_Clone*/
         .IgnoreArgument(1);
 
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
     ///act
-    auto result = IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
+    auto result = IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, messageHandle, eventConfirmationCallback, (void*)1);
 
     ///assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
@@ -3209,84 +3335,153 @@ TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_non_NULL_succeeds)
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_018: [If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR. Otherwise IoTHubClient_LL_SetMessageCallback shall succeed and return IOTHUB_CLIENT_OK.]*/
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_non_fails_when_underlying_transport_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_003: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall add to the DLIST waitingToSend a new record that stores eventMessageHandle itself (without calling IoTHubMessage_Clone), eventConfirmationCallback and userContextCallback. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_TakeOwnership_allocates_less_than_SendEventAsync)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetReturn(1);
+    size_t mallocsBefore = currentmalloc_call;
+    size_t clonesBefore = currentIoTHubMessage_Clone_call;
+    (void)IoTHubClient_LL_SendEventAsync(handle, (IOTHUB_MESSAGE_HANDLE)1, eventConfirmationCallback, (void*)1);
+    size_t sendEventAsyncMallocs = currentmalloc_call - mallocsBefore;
+    size_t sendEventAsyncClones = currentIoTHubMessage_Clone_call - clonesBefore;
 
     ///act
-    auto result = IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
+    mallocsBefore = currentmalloc_call;
+    clonesBefore = currentIoTHubMessage_Clone_call;
+    (void)IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, (IOTHUB_MESSAGE_HANDLE)2, eventConfirmationCallback, (void*)2);
+    size_t takeOwnershipMallocs = currentmalloc_call - mallocsBefore;
+    size_t takeOwnershipClones = currentIoTHubMessage_Clone_call - clonesBefore;
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
-    mocks.AssertActualAndExpectedCalls();
+    /*IoTHubMessage_Clone itself allocates the message, a copy of the payload BUFFER, messageId, correlationId and the properties map*/
+    ASSERT_ARE_EQUAL(size_t, 1, sendEventAsyncMallocs);
+    ASSERT_ARE_EQUAL(size_t, 1, sendEventAsyncClones);
+    ASSERT_ARE_EQUAL(size_t, 1, takeOwnershipMallocs);
+    ASSERT_ARE_EQUAL(size_t, 0, takeOwnershipClones);
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_020: [If parameter iotHubClientHandle is NULL then IoTHubClient_LL_DoWork shall not perform any action.] */
-TEST_FUNCTION(IoTHubClient_LL_DoWork_with_NULL_does_nothing)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_005: [ Otherwise IoTHubClient_LL_SendEventAsync_TakeOwnership shall succeed and return IOTHUB_CLIENT_OK. From then on the message handle is owned by IoTHubClient_LL and shall be destroyed by it once the message is completed, timed out or the handle is destroyed. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Destroy_after_SendEventAsync_TakeOwnership_destroys_the_original_message)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    auto messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    (void)IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, messageHandle, eventConfirmationCallback, (void*)1);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Unregister(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*IOTHUBCLIENT*/
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG)) /*because there is one item in the list*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, (void*)1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(messageHandle)); /*the very handle that was passed in, not a clone*/
+
+    STRICT_EXPECTED_CALL(mocks, tickcounter_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+#ifndef DONT_USE_UPLOADTOBLOB
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_UploadToBlob_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+#endif
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*IOTHUBMESSAGE*/
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG)) /*because this says "no more items in the list*/
+        .IgnoreArgument(1);
 
     ///act
-    IoTHubClient_LL_DoWork(NULL);
+    IoTHubClient_LL_Destroy(handle);
+
+    ///assert -uMock does it
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_004: [ If adding the record fails for any reason, IoTHubClient_LL_SendEventAsync_TakeOwnership shall fail, return IOTHUB_CLIENT_ERROR and leave the ownership of eventMessageHandle with the caller. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_TakeOwnership_fails_when_malloc_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    auto messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    mocks.ResetAllCalls();
+
+    whenShallmalloc_fail = currentmalloc_call + 1;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, messageHandle, eventConfirmationCallback, (void*)1);
 
     ///assert
-    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    mocks.AssertActualAndExpectedCalls(); /*no IoTHubMessage_Destroy: the caller still owns the message*/
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_021: [Otherwise, IoTHubClient_LL_DoWork shall invoke the underlaying layer's _DoWork function.] */
-TEST_FUNCTION(IoTHubClient_LL_DoWork_calls_underlying_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_004: [ If adding the record fails for any reason, IoTHubClient_LL_SendEventAsync_TakeOwnership shall fail, return IOTHUB_CLIENT_ERROR and leave the ownership of eventMessageHandle with the caller. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_TakeOwnership_fails_when_current_ms_cannot_be_obtained)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t thisIsNotZero = 312984751;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &thisIsNotZero);
+    auto messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*_DoWork will ask "what's the time"*/
-        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetFailReturn(__LINE__);
 
     ///act
-    IoTHubClient_LL_DoWork(handle);
+    auto result = IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, messageHandle, eventConfirmationCallback, (void*)1);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_NULL_handle_shall_return)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_044: [ IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandles is NULL, if eventMessageCount is 0 or if any of the message handles is NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_NULL_iotHubClientHandle_fails)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
     mocks.ResetAllCalls();
 
     ///act
-    IoTHubClient_LL_SendComplete(NULL, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+    auto result = IoTHubClient_LL_SendEventBatchAsync(NULL, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)3);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     mocks.AssertActualAndExpectedCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_NULL_completed_shall_return)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_044: [ IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandles is NULL, if eventMessageCount is 0 or if any of the message handles is NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_NULL_eventMessageHandles_fails)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
@@ -3294,1187 +3489,3749 @@ TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_NULL_completed_shall_return)
     mocks.ResetAllCalls();
 
     ///act
-    IoTHubClient_LL_SendComplete(handle, NULL, IOTHUB_CLIENT_CONFIRMATION_OK);
+    auto result = IoTHubClient_LL_SendEventBatchAsync(handle, NULL, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)3);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_empty_completed_shall_return)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_044: [ IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandles is NULL, if eventMessageCount is 0 or if any of the message handles is NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_0_eventMessageCount_fails)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(&temp));
-
     ///act
-    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+    auto result = IoTHubClient_LL_SendEventBatchAsync(handle, messageHandles, 0, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)3);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_1_items_with_callback_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_044: [ IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandles is NULL, if eventMessageCount is 0 or if any of the message handles is NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_a_NULL_message_handle_fails)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
-    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
-    one->callback = eventConfirmationCallback;
-    one->context = (void*)1;
-    DList_InsertTailList(&temp, &(one->entry));
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, NULL };
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(one));
-
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
     ///act
-    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+    auto result = IoTHubClient_LL_SendEventBatchAsync(handle, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)3);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_with_callback_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_045: [ IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL, or if batchConfirmation is not one of the IOTHUB_CLIENT_BATCH_CONFIRMATION values. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_NULL_eventConfirmationCallback_and_non_NULL_context_fails)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
-
-    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
-    one->callback = eventConfirmationCallback;
-    one->context = (void*)1;
-    DList_InsertTailList(&temp, &(one->entry));
-
-    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
-    two->callback = eventConfirmationCallback;
-    two->context = (void*)2;
-    DList_InsertTailList(&temp, &(two->entry));
-
-    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
-    three->callback = eventConfirmationCallback;
-    three->context = (void*)3;
-    DList_InsertTailList(&temp, &(three->entry));
-
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(one));
+    ///act
+    auto result = IoTHubClient_LL_SendEventBatchAsync(handle, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, NULL, (void*)3);
 
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)2));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(two));
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
 
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)3));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(three));
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
 
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+/*Tests_SRS_IOTHUBCLIENT_LL_10_045: [ IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL, or if batchConfirmation is not one of the IOTHUB_CLIENT_BATCH_CONFIRMATION values. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_unknown_batchConfirmation_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
+    mocks.ResetAllCalls();
 
     ///act
-    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+    auto result = IoTHubClient_LL_SendEventBatchAsync(handle, messageHandles, 2, (IOTHUB_CLIENT_BATCH_CONFIRMATION)42, eventConfirmationCallback, (void*)3);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_one_without_callback_succeeds) /*for fun*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_046: [ IoTHubClient_LL_SendEventBatchAsync shall create a record cloning every message of eventMessageHandles and, once all the records are created, append them in order to waitingToSend at once. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_052: [ Otherwise IoTHubClient_LL_SendEventBatchAsync shall succeed and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_succeeds)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
+    mocks.ResetAllCalls();
 
-    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
-    one->callback = eventConfirmationCallback;
-    one->context = (void*)1;
-    DList_InsertTailList(&temp, &(one->entry));
+    STRICT_EXPECTED_CALL(mocks, DList_InitializeListHead(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
-    two->callback = NULL;
-    two->context = NULL;
-    DList_InsertTailList(&temp, &(two->entry));
-
-    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
-    three->callback = eventConfirmationCallback;
-    three->context = (void*)3;
-    DList_InsertTailList(&temp, &(three->entry));
-
-    mocks.ResetAllCalls();
-
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(one));
-
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(two));
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
 
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)3));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(three));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone((IOTHUB_MESSAGE_HANDLE)2));
 
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, DList_AppendTailList(currentWaitingToSend, IGNORED_PTR_ARG)) /*one splice for the whole batch*/
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
     ///act
-    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+    auto result = IoTHubClient_LL_SendEventBatchAsync(handle, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)1);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1001, containingRecord(currentWaitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry)->messageHandle);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1002, containingRecord(currentWaitingToSend->Flink->Flink, IOTHUB_MESSAGE_LIST, entry)->messageHandle);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)currentWaitingToSend, (void*)currentWaitingToSend->Flink->Flink->Flink);
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_027: [If parameter result is IOTHUB_BACTCHSTATE_FAILED then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_ERROR and the context set to the context passed originally in the SendEventAsync call.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_with_callback__but_batch_failed_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_047: [ If any of the records cannot be created, IoTHubClient_LL_SendEventBatchAsync shall fail, return IOTHUB_CLIENT_ERROR and queue none of the messages. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_fails_when_IoTHubMessage_Clone_fails_and_queues_nothing)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
-
-    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
-    one->callback = eventConfirmationCallback;
-    one->context = (void*)1;
-    DList_InsertTailList(&temp, &(one->entry));
-
-    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
-    two->callback = eventConfirmationCallback;
-    two->context = (void*)2;
-    DList_InsertTailList(&temp, &(two->entry));
-
-    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
-    three->callback = eventConfirmationCallback;
-    three->context = (void*)3;
-    DList_InsertTailList(&temp, &(three->entry));
-
-
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, DList_InitializeListHead(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)1));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(one));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
 
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone((IOTHUB_MESSAGE_HANDLE)2))
+        .SetReturn((IOTHUB_MESSAGE_HANDLE)NULL);
+
+    /*the records are released, the clone of the first message too*/
     STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)2));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(two));
-
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1001));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)3));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(three));
-
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
     ///act
-    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+    auto result = IoTHubClient_LL_SendEventBatchAsync(handle, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)1);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_TRUE(BASEIMPLEMENTATION::DList_IsListEmpty(currentWaitingToSend) != 0);
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.] */
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_one_with_callback_but_batch_failed_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_047: [ If any of the records cannot be created, IoTHubClient_LL_SendEventBatchAsync shall fail, return IOTHUB_CLIENT_ERROR and queue none of the messages. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_fails_when_malloc_fails)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
-
-    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
-    one->callback = NULL;
-    one->context = NULL;
-    DList_InsertTailList(&temp, &(one->entry));
-
-    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
-    two->callback = NULL;
-    two->context = NULL;
-    DList_InsertTailList(&temp, &(two->entry));
-
-    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
-    three->callback = eventConfirmationCallback;
-    three->context = (void*)3;
-    DList_InsertTailList(&temp, &(three->entry));
-
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+    whenShallmalloc_fail = currentmalloc_call + 2;
+    STRICT_EXPECTED_CALL(mocks, DList_InitializeListHead(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(one));
-
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(two));
 
     STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)3));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(three));
-
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
     ///act
-    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+    auto result = IoTHubClient_LL_SendEventBatchAsync(handle, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)1);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_029: [If parameter handle is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_NULL_parameter_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_048: [ If the batch has more messages than "sendQueueMaxMessages" or more payload bytes than "sendQueueMaxBytes", IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_ERROR whatever the policy. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_more_messages_than_sendQueueMaxMessages_fails_and_the_queue_is_not_full)
 {
     ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
+    size_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueMaxMessages", &one);
+    mocks.ResetAllCalls();
 
     ///act
-    auto result = IoTHubClient_LL_MessageCallback(NULL, (IOTHUB_MESSAGE_HANDLE)1);
+    auto result = IoTHubClient_LL_SendEventBatchAsync(handle, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)1);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_ABANDONED, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_IS_FALSE(IoTHubClient_LL_WasSendQueueFull(handle)); /*waiting for room would not help*/
+    ASSERT_IS_TRUE(BASEIMPLEMENTATION::DList_IsListEmpty(currentWaitingToSend) != 0);
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_030: [IoTHubClient_LL_MessageCallback shall invoke the last callback function (the parameter messageCallback to IoTHubClient_LL_SetMessageCallback) passing the message and the passed userContextCallback.]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_031: [Then IoTHubClient_LL_MessageCallback shall return what the user function returns.]*/
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_calls_upper_layer_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_049: [ IoTHubClient_LL_SendEventBatchAsync shall only queue the batch if the send queue has room for all of its messages, and shall apply "sendQueueFullPolicy" to the batch as a whole. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_fails_when_the_send_queue_has_no_room_for_the_whole_batch)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)11);
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
+    size_t two = 2;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueMaxMessages", &two);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, messageCallback((IOTHUB_MESSAGE_HANDLE)1, (void*)11));
-    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
-
     ///act
-    auto result = IoTHubClient_LL_MessageCallback(handle, (IOTHUB_MESSAGE_HANDLE)1);
+    auto result = IoTHubClient_LL_SendEventBatchAsync(handle, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)2);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_ACCEPTED, result);
-    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_IS_TRUE(IoTHubClient_LL_WasSendQueueFull(handle));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)currentWaitingToSend, (void*)currentWaitingToSend->Flink->Flink); /*only the message that was there before*/
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_032: [If the last callback function was NULL, then IoTHubClient_LL_MessageCallback  shall return IOTHUBMESSAGE_ABANDONED.] */
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_without_subscribe_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_081: [ IoTHubClient_LL_SendEventBatchAsync shall apply "sendQueueFullPolicy" only once every record of the batch has been created, so that no message is dropped for a batch that is then not queued. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_DROP_OLDEST_does_not_drop_when_IoTHubMessage_Clone_fails)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
+    size_t two = 2;
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueFullPolicy", &policy);
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueMaxMessages", &two);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2);
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+    STRICT_EXPECTED_CALL(mocks, DList_InitializeListHead(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone((IOTHUB_MESSAGE_HANDLE)2))
+        .SetReturn((IOTHUB_MESSAGE_HANDLE)NULL);
+
+    /*only the records of the batch are released, the queued messages are neither dropped nor confirmed*/
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1001));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     ///act
-    auto result = IoTHubClient_LL_MessageCallback(handle, (IOTHUB_MESSAGE_HANDLE)1);
+    auto result = IoTHubClient_LL_SendEventBatchAsync(handle, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)3);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_ABANDONED, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(void_ptr, (void*)currentWaitingToSend, (void*)currentWaitingToSend->Flink->Flink->Flink); /*the 2 messages that were there before*/
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
 }
 
-
-/*** IoTHubClient_LL_GetLastMessageReceiveTime ***/
-
-/* Tests_SRS_IOTHUBCLIENT_LL_09_001: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INVALID_ARG if any of the arguments is NULL] */
-TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_InvalidClientHandleArg_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_050: [ If batchConfirmation is IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE, eventConfirmationCallback shall be called once, after every message of the batch has been confirmed, with IOTHUB_CLIENT_CONFIRMATION_OK if all of them were confirmed with IOTHUB_CLIENT_CONFIRMATION_OK and with the result of the first one that was not otherwise. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_AGGREGATE_calls_the_callback_once_with_the_first_failure)
 {
-    // arrange
-    time_t lastMessageReceiveTime;
-    CNiceCallComparer<CIoTHubClientLLMocks> niceMocks;
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
+    (void)IoTHubClient_LL_SendEventBatchAsync(handle, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE, eventConfirmationCallback, (void*)7);
+
+    DLIST_ENTRY first;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&first);
+    BASEIMPLEMENTATION::DList_InsertTailList(&first, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    DLIST_ENTRY second;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&second);
+    BASEIMPLEMENTATION::DList_InsertTailList(&second, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    IoTHubClient_LL_SendComplete(handle, &first, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+    mocks.ResetAllCalls();
 
-    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(&second));
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)7)); /*and not OK, the result of the last message*/
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*the batch*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1002));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(&second));
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(NULL, &lastMessageReceiveTime);
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &second, IOTHUB_CLIENT_CONFIRMATION_OK);
 
-    // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
 
-    // Cleanup
-    IoTHubClient_LL_Destroy(iotHubClientHandle);
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_09_001: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INVALID_ARG if any of the arguments is NULL] */
-TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_InvalidTimeRefArg_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_051: [ If batchConfirmation is IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback shall be called once for every message of the batch with userContextCallback. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Destroy_after_SendEventBatchAsync_PER_MESSAGE_calls_the_callback_for_every_message)
 {
-    // arrange
-    CNiceCallComparer<CIoTHubClientLLMocks> niceMocks;
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
+    (void)IoTHubClient_LL_SendEventBatchAsync(handle, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)7);
+    mocks.ResetAllCalls();
 
-    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Unregister(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*IOTHUBCLIENT*/
+        .IgnoreArgument(1);
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(iotHubClientHandle, NULL);
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, (void*)7));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1001));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, (void*)7));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1002));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    // Cleanup
-    IoTHubClient_LL_Destroy(iotHubClientHandle);
-}
+    STRICT_EXPECTED_CALL(mocks, tickcounter_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-/* Tests_SRS_IOTHUBCLIENT_LL_09_002: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INDEFINITE_TIME - and not set 'lastMessageReceiveTime' - if it is unable to provide the time for the last commands] */
-TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_NoMessagesReceived_fails)
-{
-    // arrange
+#ifndef DONT_USE_UPLOADTOBLOB
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_UploadToBlob_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+#endif
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG)) /*because this says "no more items in the list*/
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubClient_LL_Destroy(handle);
+
+    ///assert -uMock does it
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_054: [ IoTHubClient_LL_SendEventBatchAsync_TakeOwnership shall queue the messages like IoTHubClient_LL_SendEventBatchAsync but without cloning them. On success IoTHubClient_LL owns all the message handles, on failure the caller keeps all of them. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_TakeOwnership_succeeds)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, DList_InitializeListHead(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*no IoTHubMessage_Clone*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*the batch*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_AppendTailList(currentWaitingToSend, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = IoTHubClient_LL_SendEventBatchAsync_TakeOwnership(handle, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE, eventConfirmationCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1, containingRecord(currentWaitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry)->messageHandle);
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_053: [ IoTHubClient_LL_SendEventBatchAsync_TakeOwnership shall validate its parameters like IoTHubClient_LL_SendEventBatchAsync and return IOTHUB_CLIENT_INVALID_ARG when they are not valid. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_TakeOwnership_with_NULL_iotHubClientHandle_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_MESSAGE_HANDLE messageHandles[2] = { (IOTHUB_MESSAGE_HANDLE)1, (IOTHUB_MESSAGE_HANDLE)2 };
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = IoTHubClient_LL_SendEventBatchAsync_TakeOwnership(NULL, messageHandles, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE, eventConfirmationCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_016: [IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_NULL_iotHubClientHandle_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+
+    ///act
+    auto result = IoTHubClient_LL_SetMessageCallback(NULL, messageCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_019: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_NULL_calls_Unsubscribe_and_succeeds)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Unsubscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = IoTHubClient_LL_SetMessageCallback(handle, NULL, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_017: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Subscribe function.]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_non_NULL_succeeds)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_018: [If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR. Otherwise IoTHubClient_LL_SetMessageCallback shall succeed and return IOTHUB_CLIENT_OK.]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_non_fails_when_underlying_transport_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(1);
+
+    ///act
+    auto result = IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_020: [If parameter iotHubClientHandle is NULL then IoTHubClient_LL_DoWork shall not perform any action.] */
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_NULL_does_nothing)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+
+    ///act
+    IoTHubClient_LL_DoWork(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_021: [Otherwise, IoTHubClient_LL_DoWork shall invoke the underlaying layer's _DoWork function.] */
+TEST_FUNCTION(IoTHubClient_LL_DoWork_calls_underlying_succeeds)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*_DoWork will ask "what's the time"*/
+        .IgnoreAllArguments();
+
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_NULL_handle_shall_return)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+    mocks.ResetAllCalls();
+
+    ///act
+    IoTHubClient_LL_SendComplete(NULL, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_NULL_completed_shall_return)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    ///act
+    IoTHubClient_LL_SendComplete(handle, NULL, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_empty_completed_shall_return)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(&temp));
+
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_1_items_with_callback_succeeds)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = eventConfirmationCallback;
+    one->context = (void*)1;
+    DList_InsertTailList(&temp, &(one->entry));
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(one));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_with_callback_succeeds)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = eventConfirmationCallback;
+    one->context = (void*)1;
+    DList_InsertTailList(&temp, &(one->entry));
+
+    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
+    two->callback = eventConfirmationCallback;
+    two->context = (void*)2;
+    DList_InsertTailList(&temp, &(two->entry));
+
+    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
+    three->callback = eventConfirmationCallback;
+    three->context = (void*)3;
+    DList_InsertTailList(&temp, &(three->entry));
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(one));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)2));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(two));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)3));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(three));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_one_without_callback_succeeds) /*for fun*/
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = eventConfirmationCallback;
+    one->context = (void*)1;
+    DList_InsertTailList(&temp, &(one->entry));
+
+    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
+    two->callback = NULL;
+    two->context = NULL;
+    DList_InsertTailList(&temp, &(two->entry));
+
+    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
+    three->callback = eventConfirmationCallback;
+    three->context = (void*)3;
+    DList_InsertTailList(&temp, &(three->entry));
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(one));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(two));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)3));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(three));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_027: [If parameter result is IOTHUB_BACTCHSTATE_FAILED then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_ERROR and the context set to the context passed originally in the SendEventAsync call.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_with_callback__but_batch_failed_succeeds)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = eventConfirmationCallback;
+    one->context = (void*)1;
+    DList_InsertTailList(&temp, &(one->entry));
+
+    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
+    two->callback = eventConfirmationCallback;
+    two->context = (void*)2;
+    DList_InsertTailList(&temp, &(two->entry));
+
+    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
+    three->callback = eventConfirmationCallback;
+    three->context = (void*)3;
+    DList_InsertTailList(&temp, &(three->entry));
+
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(one));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)2));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(two));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)3));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(three));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.] */
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_one_with_callback_but_batch_failed_succeeds)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = NULL;
+    one->context = NULL;
+    DList_InsertTailList(&temp, &(one->entry));
+
+    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
+    two->callback = NULL;
+    two->context = NULL;
+    DList_InsertTailList(&temp, &(two->entry));
+
+    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
+    three->callback = eventConfirmationCallback;
+    three->context = (void*)3;
+    DList_InsertTailList(&temp, &(three->entry));
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(one));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(two));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)3));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(three));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_029: [If parameter handle is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_NULL_parameter_fails)
+{
+    ///arrange
+
+    ///act
+    auto result = IoTHubClient_LL_MessageCallback(NULL, (IOTHUB_MESSAGE_HANDLE)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_ABANDONED, result);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_030: [IoTHubClient_LL_MessageCallback shall invoke the last callback function (the parameter messageCallback to IoTHubClient_LL_SetMessageCallback) passing the message and the passed userContextCallback.]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_031: [Then IoTHubClient_LL_MessageCallback shall return what the user function returns.]*/
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_calls_upper_layer_succeeds)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)11);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, messageCallback((IOTHUB_MESSAGE_HANDLE)1, (void*)11));
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+
+    ///act
+    auto result = IoTHubClient_LL_MessageCallback(handle, (IOTHUB_MESSAGE_HANDLE)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_ACCEPTED, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_032: [If the last callback function was NULL, then IoTHubClient_LL_MessageCallback  shall return IOTHUBMESSAGE_ABANDONED.] */
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_without_subscribe_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+
+    ///act
+    auto result = IoTHubClient_LL_MessageCallback(handle, (IOTHUB_MESSAGE_HANDLE)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_ABANDONED, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+
+/*** IoTHubClient_LL_GetLastMessageReceiveTime ***/
+
+/* Tests_SRS_IOTHUBCLIENT_LL_09_001: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INVALID_ARG if any of the arguments is NULL] */
+TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_InvalidClientHandleArg_fails)
+{
+    // arrange
+    time_t lastMessageReceiveTime;
+    CNiceCallComparer<CIoTHubClientLLMocks> niceMocks;
+
+    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle = IoTHubClient_LL_Create(&TEST_CONFIG);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(NULL, &lastMessageReceiveTime);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    // Cleanup
+    IoTHubClient_LL_Destroy(iotHubClientHandle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_09_001: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INVALID_ARG if any of the arguments is NULL] */
+TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_InvalidTimeRefArg_fails)
+{
+    // arrange
+    CNiceCallComparer<CIoTHubClientLLMocks> niceMocks;
+
+    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle = IoTHubClient_LL_Create(&TEST_CONFIG);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(iotHubClientHandle, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    // Cleanup
+    IoTHubClient_LL_Destroy(iotHubClientHandle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_09_002: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INDEFINITE_TIME - and not set 'lastMessageReceiveTime' - if it is unable to provide the time for the last commands] */
+TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_NoMessagesReceived_fails)
+{
+    // arrange
     CNiceCallComparer<CIoTHubClientLLMocks> niceMocks;
     time_t lastMessageReceiveTime = (time_t)0;;
 
-    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle = IoTHubClient_LL_Create(&TEST_CONFIG);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(iotHubClientHandle, &lastMessageReceiveTime);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INDEFINITE_TIME, result);
+    ASSERT_ARE_EQUAL(int, 0, (int)(lastMessageReceiveTime));
+
+    // Cleanup
+    IoTHubClient_LL_Destroy(iotHubClientHandle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_09_003: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_OK if it wrote in the lastMessageReceiveTime the time when the last command was received] */
+/* Tests_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime] */
+TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_MessagesReceived_succeeds)
+{
+    // arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)11);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, messageCallback((IOTHUB_MESSAGE_HANDLE)1, (void*)11));
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+
+    time_t timeBeforeCall = time(NULL);
+
+    (void)IoTHubClient_LL_MessageCallback(handle, (IOTHUB_MESSAGE_HANDLE)1);
+
+    // act
+    time_t lastMessageReceiveTime = (time_t)0;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(handle, &lastMessageReceiveTime);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    time_t timeAfterCall = time(NULL);
+
+    if (difftime(lastMessageReceiveTime, timeBeforeCall) < 0)
+    {
+        ASSERT_FAIL("Last message time is earlier than expected.");
+    }
+
+    if (difftime(lastMessageReceiveTime, timeAfterCall) > 0)
+    {
+        ASSERT_FAIL("Last message time is later than expected.");
+    }
+
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+
+/*** IoTHubClient_LL_GetSendStatus ***/
+
+/* Tests_SRS_IOTHUBCLIENT_09_007: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter] */
+TEST_FUNCTION(IoTHubClient_GetSendStatus_BadHandleArgument_fails)
+{
+    // arrange
+    CIoTHubClientLLMocks mocks;
+    mocks.ResetAllCalls();
+
+    IOTHUB_CLIENT_STATUS status;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(NULL, &status);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    // cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_09_007: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter] */
+TEST_FUNCTION(IoTHubClient_GetSendStatus_BadStatusArgument_fails)
+{
+    // arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, NULL);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_09_008: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_IDLE if there is currently no items to be sent] */
+TEST_FUNCTION(IoTHubClient_GetSendStatus_NoEventToSend_Succeeds)
+{
+    // arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    IOTHUB_CLIENT_STATUS status;
+
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_GetSendStatus(IGNORED_PTR_ARG, &status))
+        .IgnoreAllArguments()
+        .SetReturn(IOTHUB_CLIENT_OK);
+
+    currentIotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_IDLE;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, &status);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_IDLE, status);
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_09_009: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently items to be sent] */
+TEST_FUNCTION(IoTHubClient_GetSendStatus_HasEventToSend_Succeeds)
+{
+    // arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    IOTHUB_CLIENT_STATUS status;
+
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_GetSendStatus(IGNORED_PTR_ARG, &status))
+        .IgnoreAllArguments()
+        .SetReturn(IOTHUB_CLIENT_OK);
+
+    currentIotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, &status);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_BUSY, status);
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+    currentIotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_IDLE;
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_034: [If iotHubClientHandle is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_handle_fails)
+{
+    ///arrange
+
+    ///act
+    auto result = IoTHubClient_LL_SetOption(NULL, "a", "b");
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    ///cleanup
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_035: [If optionName is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_optionName_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = IoTHubClient_LL_SetOption(handle, NULL, "b");
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_036: [If value is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_value_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = IoTHubClient_LL_SetOption(handle, "a", NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+
+}
+
+#ifndef DONT_USE_UPLOADTOBLOB
+/*these tests are to be run when upload to blob functionality exists*/
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_099 : [IoTHubClient_LL_SetOption shall return according to the table below]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_all_combinations)
+{
+
+    static struct SetOptionTriplet
+    {
+        IOTHUB_CLIENT_RESULT IoTHubClient_UploadToBlob_SetOption_return;
+        IOTHUB_CLIENT_RESULT Transport_SetOption_return;
+        IOTHUB_CLIENT_RESULT expected_return;
+    } allCombinations[] = 
+    {
+        { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_OK , IOTHUB_CLIENT_OK},
+        { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR },
+        { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_OK },
+        { IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_OK , IOTHUB_CLIENT_ERROR },
+        { IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR },
+        { IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_ERROR },
+        { IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_OK , IOTHUB_CLIENT_OK },
+        { IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR },
+        { IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_INVALID_ARG }
+    };
+
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    
+
+    for (size_t i = 0;i < sizeof(allCombinations) / sizeof(allCombinations[0]);i++)
+    {
+        mocks.ResetAllCalls();
+        EXPECTED_CALL(mocks, IoTHubClient_LL_UploadToBlob_SetOption(IGNORED_PTR_ARG, "a", "b"))
+            .SetReturn(allCombinations[i].IoTHubClient_UploadToBlob_SetOption_return);
+
+        EXPECTED_CALL(mocks, FAKE_IoTHubTransport_SetOption(IGNORED_PTR_ARG, "a", "b"))
+            .SetReturn(allCombinations[i].Transport_SetOption_return);
+
+        ///act
+        auto result = IoTHubClient_LL_SetOption(handle, "a", "b");
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, allCombinations[i].expected_return, result);
+    }
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_038: [Otherwise, IoTHubClient_LL shall call the function _SetOption of the underlying transport and return what that function is returning.] */
+TEST_FUNCTION(IoTHubClient_LL_SetOption_fails_when_underlying_transport_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    EXPECTED_CALL(mocks, IoTHubClient_LL_UploadToBlob_SetOption(IGNORED_PTR_ARG, "a", "b"))
+        .SetReturn(IOTHUB_CLIENT_INVALID_ARG);
+
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_SetOption(IGNORED_PTR_ARG, "a", "b"))
+        .SetReturn(IOTHUB_CLIENT_INDEFINITE_TIME);
+
+    ///act
+    auto result = IoTHubClient_LL_SetOption(handle, "a", "b");
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INDEFINITE_TIME, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+
+}
+#else
+/*these tests are to be run when uploadtoblob is not present*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_fails_when_underlying_transport_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_SetOption(IGNORED_PTR_ARG, "a", "b"))
+        .SetReturn(IOTHUB_CLIENT_INDEFINITE_TIME);
+
+    ///act
+    auto result = IoTHubClient_LL_SetOption(handle, "a", "b");
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INDEFINITE_TIME, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+
+}
+#endif
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_to_zero_after_Create_succeeds)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    ///act
+    uint64_t zero = 0;
+    auto result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &zero);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_to_one_after_Create_succeeds)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    ///act
+    uint64_t one = 1;
+    auto result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_can_be_reverted_back_to_zero_succeeds)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    mocks.ResetAllCalls();
+
+    ///act
+    uint64_t zero = 0;
+    auto result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &zero);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_calls_timeout_callback)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 1 messages that will expire*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    uint64_t ten = 10;
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    mocks.ResetAllCalls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    uint64_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout*/
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_042: [ By default, messages shall not timeout. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_defaults_to_zero)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+
+    /*send 1 messages that will expire*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    uint64_t ten = 10;
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    mocks.ResetAllCalls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    uint64_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => would result in timeout, except the fact that messageTimeout option has never been set, therefore no timeout shall be called*/
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_only_removes_the_message_if_it_has_NULL_callback)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 1 messages that will expire*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    uint64_t ten = 10;
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, NULL, NULL); /*this is a message with a NULL callback*/
+    mocks.ResetAllCalls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    uint64_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout*/
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_when_exactly_on_the_edge_does_not_call_the_callback) /*because "more"*/
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 1 messages that will expire*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    uint64_t ten = 10;
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    mocks.ResetAllCalls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    uint64_t eleven = 11; /*11 = 10 (receive time) + 1 (timeout) => NO timeout*/
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &eleven, sizeof(eleven));
+
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_calls_1_timeout) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    uint64_t ten = 10;
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    uint64_t two = 2;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &two);
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2 ));
+
+    mocks.ResetAllCalls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    uint64_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+        .IgnoreArgument(1);
+
+    /*because we're at time = 12 in this test, the second message is untouched*/
+
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_044: [ Messages already delivered to IoTHubClient_LL shall not have their timeouts modified by a new call to IoTHubClient_LL_SetOption. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_calls_2_timeouts) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    uint64_t ten = 10;
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    uint64_t two = 2;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &two);
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2));
+
+    mocks.ResetAllCalls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    {/*this scope happen in the first _DoWork call*/
+        uint64_t timeIsNow = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
+        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+
+        STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+            .IgnoreArgument(1);
+    }
+
+    {/*this scope happen in the second _DoWork call*/
+        uint64_t timeIsNow = 13; /*13 > 10 (receive time) + 2 (timeout) => timeout!!!*/
+        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+
+        STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)(TEST_DEVICEMESSAGE_HANDLE_2))); /*calling the callback*/
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+            .IgnoreArgument(1);
+    }
+
+    /*because we're at time = 13 in this test, the second message times out too*/
+
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClient_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_044: [ Messages already delivered to IoTHubClient_LL shall not have their timeouts modified by a new call to IoTHubClient_LL_SetOption. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_one_with_timeout_one_without_call_1_callback) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    uint64_t ten = 10;
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    uint64_t zero = 0;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &zero); /*essentially no timeout*/
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2));
+
+    mocks.ResetAllCalls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    {/*this scope happen in the first _DoWork call*/
+        uint64_t timeIsNow = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
+        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+
+        STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+            .IgnoreArgument(1);
+    }
+
+    {/*this scope happen in the second _DoWork call*/
+        uint64_t timeIsNow = 999999999999999ULL; /*some very big number*/
+        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+    }
+
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_when_tickcounter_fails_in_do_work_no_timeout_callbacks_are_called) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    uint64_t ten = 10;
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    mocks.ResetAllCalls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    {/*this scope happen in the _DoWork call*/
+        uint64_t timeIsNow = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!! (well - normally - but here the code doesn't call any callbacks because time cannot be obtained*/
+        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow))
+            .SetFailReturn(__LINE__);
+    }
+
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_006: [ If the message has a timeout, IoTHubClient_LL_SendEventAsync shall make room for it in the message timeout heap. If that fails, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_messageTimeout_fails_when_the_timeout_heap_cannot_grow)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    mocks.ResetAllCalls();
+
+    whenShallrealloc_fail = currentrealloc_call + 1;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, gballoc_realloc(NULL, IGNORED_NUM_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_006: [ If the message has a timeout, IoTHubClient_LL_SendEventAsync shall make room for it in the message timeout heap. If that fails, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_007: [ IoTHubClient_LL_SendEventAsync shall add a message that has a timeout to the message timeout heap, ordered by the time the message times out. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_messageTimeout_grows_the_timeout_heap_only_when_full)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    mocks.ResetAllCalls();
+
+    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .ExpectedTimesExactly(17);
+    EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(17);
+    EXPECTED_CALL(mocks, IoTHubMessage_Clone(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(17);
+    EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(17);
+    EXPECTED_CALL(mocks, gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG)) /*room for 16 messages, then room for 32*/
+        .ExpectedTimesExactly(2);
+
+    ///act
+    for (size_t i = 0; i < 17; i++)
+    {
+        auto result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    }
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_007: [ IoTHubClient_LL_SendEventAsync shall add a message that has a timeout to the message timeout heap, ordered by the time the message times out. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_008: [ IoTHubClient_LL_DoWork shall only consider the messages at the top of the message timeout heap that are due and shall not walk waitingToSend when no message is due. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_times_out_messages_in_waitingToSend_order_when_timeouts_are_not_in_order)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t ten = 10;
+    uint64_t timeouts[3] = { 3, 1, 2 }; /*messages time out at 13, 11 and 12*/
+    for (size_t i = 0; i < 3; i++)
+    {
+        (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &timeouts[i]);
+        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+        (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)(i + 1));
+    }
+    mocks.ResetAllCalls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    {/*first _DoWork: nothing is due yet*/
+        uint64_t timeIsNow = 11;
+        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+    }
+
+    {/*second _DoWork: all 3 are due, they are timed out in the order in which they were sent*/
+        uint64_t timeIsNow = 14;
+        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+        /*all the expired messages are unlinked before any callback runs, so that a callback can safely send again*/
+        for (size_t i = 0; i < 3; i++)
+        {
+            STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+        }
+        for (size_t i = 0; i < 3; i++)
+        {
+            STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)(i + 1)));
+            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+            STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+        }
+    }
+
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_078: [ Otherwise, if messageList is in the message timeout heap, IoTHubClient_LL_SuspendMessageTimeout shall take it out of the heap while keeping room for it, so IoTHubClient_LL_DoWork does not look at it until its timeout is resumed. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_080: [ Otherwise, if the timeout of messageList is suspended, IoTHubClient_LL_ResumeMessageTimeout shall put messageList back in the message timeout heap. A message that is already due times out at the next IoTHubClient_LL_DoWork. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_times_out_a_message_given_back_by_the_transport_as_soon_as_its_timeout_is_resumed)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    uint64_t ten = 10;
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    /*the transport takes the message out of waitingToSend and keeps it*/
+    PDLIST_ENTRY inTransport = BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend);
+    IoTHubClient_LL_SuspendMessageTimeout(containingRecord(inTransport, IOTHUB_MESSAGE_LIST, entry));
+    mocks.ResetAllCalls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    uint64_t muchLater = 5000; /*5000 > 10 (receive time) + 1 (timeout), but the message is with the transport*/
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &muchLater, sizeof(muchLater));
+    uint64_t afterResume = 5001; /*the message is back in waitingToSend, it times out at once*/
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &afterResume, sizeof(afterResume));
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+    BASEIMPLEMENTATION::DList_InsertTailList(currentWaitingToSend, inTransport); /*the transport gives the message back (for example on a reconnect)*/
+    IoTHubClient_LL_ResumeMessageTimeout(containingRecord(inTransport, IOTHUB_MESSAGE_LIST, entry));
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_008: [ IoTHubClient_LL_DoWork shall only consider the messages at the top of the message timeout heap that are due and shall not walk waitingToSend when no message is due. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_078: [ Otherwise, if messageList is in the message timeout heap, IoTHubClient_LL_SuspendMessageTimeout shall take it out of the heap while keeping room for it, so IoTHubClient_LL_DoWork does not look at it until its timeout is resumed. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_does_not_look_at_waitingToSend_while_the_transport_holds_an_overdue_message)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    uint64_t oneHour = 3600000;
+    uint64_t ten = 10;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &oneHour);
+    for (size_t i = 0; i < 5000; i++)
+    {
+        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+        (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2);
+    }
+
+    /*the transport takes the first message (it times out at 11) and keeps it while the other 5000 wait*/
+    IoTHubClient_LL_SuspendMessageTimeout(containingRecord(BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend), IOTHUB_MESSAGE_LIST, entry));
+    mocks.ResetAllCalls();
+
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    /*the overdue message is not in the heap anymore, so no message is due and waitingToSend is never walked: nothing is unlinked, nothing times out, no memory is touched*/
+    uint64_t nows[100];
+    for (size_t i = 0; i < 100; i++)
+    {
+        nows[i] = 500 * (i + 1); /*every 500 ms for 50 seconds*/
+        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &nows[i], sizeof(nows[i]));
+    }
+
+    ///act
+    for (size_t i = 0; i < 100; i++)
+    {
+        IoTHubClient_LL_DoWork(handle);
+    }
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    size_t nWaiting = 0;
+    for (PDLIST_ENTRY current = currentWaitingToSend->Flink; current != currentWaitingToSend; current = current->Flink)
+    {
+        nWaiting++;
+    }
+    ASSERT_ARE_EQUAL(size_t, 5000, nWaiting);
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_077: [ If parameter messageList is NULL then IoTHubClient_LL_SuspendMessageTimeout shall return. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SuspendMessageTimeout_with_NULL_messageList_shall_return)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+
+    ///act
+    IoTHubClient_LL_SuspendMessageTimeout(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_079: [ If parameter messageList is NULL then IoTHubClient_LL_ResumeMessageTimeout shall return. ]*/
+TEST_FUNCTION(IoTHubClient_LL_ResumeMessageTimeout_with_NULL_messageList_shall_return)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+
+    ///act
+    IoTHubClient_LL_ResumeMessageTimeout(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_011: [ IoTHubClient_LL_SendComplete shall remove every completed message from the message timeout heap. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_removes_the_message_from_the_timeout_heap)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    uint64_t ten = 10;
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    /*the transport takes the message out of waitingToSend and completes it*/
+    DLIST_ENTRY completed;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&completed);
+    BASEIMPLEMENTATION::DList_InsertTailList(&completed, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    mocks.ResetAllCalls();
+
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(&completed));
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(&completed));
+
+    uint64_t muchLater = 999999999999ULL; /*nothing left to time out*/
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &muchLater, sizeof(muchLater));
+
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_012: [ If parameter messageList is NULL then IoTHubClient_LL_UntrackMessage shall return. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UntrackMessage_with_NULL_messageList_shall_return)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+
+    ///act
+    IoTHubClient_LL_UntrackMessage(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_013: [ Otherwise IoTHubClient_LL_UntrackMessage shall remove messageList from the message timeout heap of the IoTHubClient_LL that queued it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UntrackMessage_removes_the_message_from_the_timeout_heap)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    uint64_t ten = 10;
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    /*the transport takes the message out of waitingToSend and disposes of it by itself*/
+    IOTHUB_MESSAGE_LIST* inTransport = containingRecord(BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend), IOTHUB_MESSAGE_LIST, entry);
+    mocks.ResetAllCalls();
+
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    uint64_t muchLater = 999999999999ULL; /*nothing left to time out*/
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &muchLater, sizeof(muchLater));
+
+    ///act
+    IoTHubClient_LL_UntrackMessage(inTransport);
+    BASEIMPLEMENTATION::gballoc_free(inTransport);
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_014: [ By default the send queue shall have no limits and its full policy shall be IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_send_queue_has_no_limits_by_default)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    ///act
+    for (size_t i = 0; i < 100; i++)
+    {
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1));
+    }
+
+    ///assert
+    ASSERT_IS_FALSE(IoTHubClient_LL_WasSendQueueFull(handle));
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_016: [ IoTHubClient_LL_SendEventAsync shall check that the send queue has room for the message before it is queued: the number of queued messages shall stay at most "sendQueueMaxMessages" and their payload bytes at most "sendQueueMaxBytes". ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_019: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT or IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR when the send queue has no room for the message. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_028: [ IoTHubClient_LL_WasSendQueueFull shall return true if the last IoTHubClient_LL_SendEventAsync or IoTHubClient_LL_SendEventAsync_TakeOwnership call failed only because the send queue had no room for the message, false otherwise (including when handle is NULL). ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails_when_sendQueueMaxMessages_are_queued)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t two = 2;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueMaxMessages", &two);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2);
+    mocks.ResetAllCalls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_IS_TRUE(IoTHubClient_LL_WasSendQueueFull(handle));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_016: [ IoTHubClient_LL_SendEventAsync shall check that the send queue has room for the message before it is queued: the number of queued messages shall stay at most "sendQueueMaxMessages" and their payload bytes at most "sendQueueMaxBytes". ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails_when_the_message_does_not_fit_in_sendQueueMaxBytes)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t fifteen = 15;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueMaxBytes", &fifteen);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1); /*10 bytes*/
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_DEVICEMESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_IS_TRUE(IoTHubClient_LL_WasSendQueueFull(handle));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_017: [ If "sendQueueMaxBytes" is not 0 and the size of the message payload cannot be obtained, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails_when_the_size_of_the_message_cannot_be_obtained)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t fifteen = 15;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueMaxBytes", &fifteen);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_DEVICEMESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetReturn(IOTHUB_MESSAGE_ERROR);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_IS_FALSE(IoTHubClient_LL_WasSendQueueFull(handle));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_018: [ A message whose payload is larger than "sendQueueMaxBytes" shall be refused with IOTHUB_CLIENT_ERROR whatever the policy. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_DROP_OLDEST_refuses_a_message_larger_than_sendQueueMaxBytes)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t five = 5;
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueFullPolicy", &policy);
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueMaxBytes", &five);
+    currentMessageSize = 4;
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    currentMessageSize = 6;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_DEVICEMESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2);
+
+    ///assert - the queued message was not dropped
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_IS_FALSE(IoTHubClient_LL_WasSendQueueFull(handle));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_020: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST, IoTHubClient_LL_SendEventAsync shall remove the oldest messages from waitingToSend until the new message fits, call their callbacks with IOTHUB_CLIENT_CONFIRMATION_DROPPED and destroy them. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_DROP_OLDEST_drops_the_oldest_message)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t two = 2;
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueFullPolicy", &policy);
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueMaxMessages", &two);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_DROPPED, (void*)1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_IS_FALSE(IoTHubClient_LL_WasSendQueueFull(handle));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_021: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST and dropping all the messages in waitingToSend would not make enough room, IoTHubClient_LL_SendEventAsync shall not drop any message, shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_DROP_OLDEST_does_not_drop_when_that_cannot_make_room)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t two = 2;
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueFullPolicy", &policy);
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueMaxMessages", &two);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2);
+
+    /*the transport is sending both messages, so they are not in waitingToSend anymore*/
+    DLIST_ENTRY inTransport;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&inTransport);
+    BASEIMPLEMENTATION::DList_InsertTailList(&inTransport, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    BASEIMPLEMENTATION::DList_InsertTailList(&inTransport, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    mocks.ResetAllCalls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_IS_TRUE(IoTHubClient_LL_WasSendQueueFull(handle));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)2));
+    IoTHubClient_LL_SendComplete(handle, &inTransport, IOTHUB_CLIENT_CONFIRMATION_OK);
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_026: [ Messages that complete, time out or are disposed of by the transport shall give back their room in the send queue. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_gives_back_the_room_in_the_send_queue)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueMaxMessages", &one);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2));
+
+    DLIST_ENTRY completed;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&completed);
+    BASEIMPLEMENTATION::DList_InsertTailList(&completed, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
+    mocks.ResetAllCalls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_027: [ IoTHubClient_LL_UntrackMessage shall give back the room messageList took in the send queue of the IoTHubClient_LL that queued it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UntrackMessage_gives_back_the_room_in_the_send_queue)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueMaxMessages", &one);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    IOTHUB_MESSAGE_LIST* inTransport = containingRecord(BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend), IOTHUB_MESSAGE_LIST, entry);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2));
+    IoTHubClient_LL_UntrackMessage(inTransport);
+    BASEIMPLEMENTATION::gballoc_free(inTransport);
+    mocks.ResetAllCalls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_028: [ IoTHubClient_LL_WasSendQueueFull shall return true if the last IoTHubClient_LL_SendEventAsync or IoTHubClient_LL_SendEventAsync_TakeOwnership call failed only because the send queue had no room for the message, false otherwise (including when handle is NULL). ]*/
+TEST_FUNCTION(IoTHubClient_LL_WasSendQueueFull_with_NULL_handle_returns_false)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+
+    ///act
+    bool result = IoTHubClient_LL_WasSendQueueFull(NULL);
+
+    ///assert
+    ASSERT_IS_FALSE(result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_029: [ If parameter iotHubClientHandle is NULL then IoTHubClient_LL_SetSendQueueCallback shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetSendQueueCallback_with_NULL_handle_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetSendQueueCallback(NULL, sendQueueCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_030: [ Otherwise IoTHubClient_LL_SetSendQueueCallback shall store sendQueueCallback and userContextCallback and return IOTHUB_CLIENT_OK. A NULL sendQueueCallback stops the watermark notifications. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_024: [ When the number of queued messages reaches "sendQueueHighWatermark", the callback set by IoTHubClient_LL_SetSendQueueCallback shall be called once with IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_025: [ After that, when the number of queued messages goes down to "sendQueueLowWatermark", the callback shall be called once with IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetSendQueueCallback_calls_the_callback_at_the_watermarks)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t high = 3;
+    size_t low = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueHighWatermark", &high);
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueLowWatermark", &low);
+    mocks.ResetAllCalls();
+
+    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreAllCalls();
+    EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+    EXPECTED_CALL(mocks, IoTHubMessage_Clone(IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+    EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+    EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+    EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+    EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, sendQueueCallback(IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK, (void*)42));
+    STRICT_EXPECTED_CALL(mocks, sendQueueCallback(IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK, (void*)42));
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetSendQueueCallback(handle, sendQueueCallback, (void*)42);
+    for (size_t i = 0; i < 4; i++) /*crosses the high watermark once*/
+    {
+        (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    }
+    for (size_t i = 0; i < 3; i++) /*goes down to the low watermark once*/
+    {
+        DLIST_ENTRY completed;
+        BASEIMPLEMENTATION::DList_InitializeListHead(&completed);
+        BASEIMPLEMENTATION::DList_InsertTailList(&completed, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+        IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
+    }
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_015: [ "sendQueueMaxMessages", "sendQueueMaxBytes", "sendQueueHighWatermark" and "sendQueueLowWatermark" shall be handled by IoTHubClient_LL. Value is a pointer to a size_t, 0 means no limit (no callbacks for "sendQueueHighWatermark"). ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_022: [ "sendQueueFullPolicy" shall be handled by IoTHubClient_LL. Value is a pointer to an IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_send_queue_options_are_not_passed_to_the_transport)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t ten = 10;
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+    mocks.ResetAllCalls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubClient_LL_SetOption(handle, "sendQueueMaxMessages", &ten);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_SetOption(handle, "sendQueueMaxBytes", &ten);
+    IOTHUB_CLIENT_RESULT result3 = IoTHubClient_LL_SetOption(handle, "sendQueueHighWatermark", &ten);
+    IOTHUB_CLIENT_RESULT result4 = IoTHubClient_LL_SetOption(handle, "sendQueueLowWatermark", &ten);
+    IOTHUB_CLIENT_RESULT result5 = IoTHubClient_LL_SetOption(handle, "sendQueueFullPolicy", &policy);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result3);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result4);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result5);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_023: [ If the value of "sendQueueFullPolicy" is not one of the IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY values then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_sendQueueFullPolicy_with_unknown_value_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = (IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY)42;
+    mocks.ResetAllCalls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "sendQueueFullPolicy", &policy);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+#ifndef DONT_USE_JOURNAL
+#define TEST_JOURNAL_PATH "journal"
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_032: [ "journalPath" shall be handled by IoTHubClient_LL. Value is a const char* path prefix for the journal files. IoTHubClient_LL_SetOption shall create the journal by calling IoTHubClient_LL_Journal_Create, which replays the messages that a previous instance did not complete. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_031: [ By default there shall be no journal, its segment size shall be 1 MB and its sync interval 1000 ms. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_journalPath_creates_the_journal)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, 1024 * 1024, IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(3);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "journalPath", TEST_JOURNAL_PATH);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_042: [ "journalSegmentSize" shall be handled by IoTHubClient_LL. Value is a pointer to a size_t, it only applies to a journal created after it is set. A value of 0 shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_journalSegmentSize_is_passed_to_IoTHubClient_LL_Journal_Create)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t segmentSize = 4096;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, 4096, IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(3);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubClient_LL_SetOption(handle, "journalSegmentSize", &segmentSize);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_SetOption(handle, "journalPath", TEST_JOURNAL_PATH);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_042: [ "journalSegmentSize" shall be handled by IoTHubClient_LL. Value is a pointer to a size_t, it only applies to a journal created after it is set. A value of 0 shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_journalSegmentSize_0_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t segmentSize = 0;
+    mocks.ResetAllCalls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "journalSegmentSize", &segmentSize);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_040: [ If the journal already exists then setting "journalPath" shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_journalPath_twice_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, "journalPath", TEST_JOURNAL_PATH);
+    mocks.ResetAllCalls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "journalPath", TEST_JOURNAL_PATH);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_041: [ If IoTHubClient_LL_Journal_Create fails then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_journalPath_fails_when_IoTHubClient_LL_Journal_Create_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Journal_Create(TEST_JOURNAL_PATH, 1024 * 1024, IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(3)
+        .SetReturn((IOTHUB_CLIENT_LL_JOURNAL_HANDLE)NULL);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "journalPath", TEST_JOURNAL_PATH);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_034: [ When there is a journal, IoTHubClient_LL_SendEventAsync shall append the message to it by calling IoTHubClient_LL_Journal_Append before adding the record to waitingToSend. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_appends_the_message_to_the_journal)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    auto messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    (void)IoTHubClient_LL_SetOption(handle, "journalPath", TEST_JOURNAL_PATH);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(iotHubClientHandle, &lastMessageReceiveTime);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INDEFINITE_TIME, result);
-    ASSERT_ARE_EQUAL(int, 0, (int)(lastMessageReceiveTime));
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Journal_Append(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
-    // Cleanup
-    IoTHubClient_LL_Destroy(iotHubClientHandle);
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    ///act
+    auto result = IoTHubClient_LL_SendEventAsync(handle, messageHandle, eventConfirmationCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_09_003: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_OK if it wrote in the lastMessageReceiveTime the time when the last command was received] */
-/* Tests_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime] */
-TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_MessagesReceived_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_035: [ If IoTHubClient_LL_Journal_Append fails, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails_when_IoTHubClient_LL_Journal_Append_fails)
 {
-    // arrange
+    ///arrange
     CIoTHubClientLLMocks mocks;
     auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)11);
+    auto messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    (void)IoTHubClient_LL_SetOption(handle, "journalPath", TEST_JOURNAL_PATH);
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, messageCallback((IOTHUB_MESSAGE_HANDLE)1, (void*)11));
-    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
 
-    time_t timeBeforeCall = time(NULL);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    (void)IoTHubClient_LL_MessageCallback(handle, (IOTHUB_MESSAGE_HANDLE)1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Journal_Append(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn(1);
 
-    // act
-    time_t lastMessageReceiveTime = (time_t)0;
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(handle, &lastMessageReceiveTime);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    // assert
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = IoTHubClient_LL_SendEventAsync(handle, messageHandle, eventConfirmationCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_038: [ When there is a journal, IoTHubClient_LL_DoWork shall call IoTHubClient_LL_Journal_Sync once at least "journalSyncInterval" ms have passed since the previous sync. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_043: [ "journalSyncInterval" shall be handled by IoTHubClient_LL. Value is a pointer to an unsigned int number of ms, 0 syncs the journal on every IoTHubClient_LL_DoWork. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_syncs_the_journal)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    unsigned int syncInterval = 0;
+    (void)IoTHubClient_LL_SetOption(handle, "journalSyncInterval", &syncInterval);
+    (void)IoTHubClient_LL_SetOption(handle, "journalPath", TEST_JOURNAL_PATH);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*timeouts*/
+        .IgnoreAllArguments();
+
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*journal*/
+        .IgnoreAllArguments();
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Journal_Sync(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_039: [ IoTHubClient_LL_Destroy shall destroy the journal before anything else, so that the messages that are still waiting to be sent stay in the journal. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Destroy_destroys_the_journal)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, "journalPath", TEST_JOURNAL_PATH);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Journal_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Unregister(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, tickcounter_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+#ifndef DONT_USE_UPLOADTOBLOB
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_UploadToBlob_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+#endif
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubClient_LL_Destroy(handle);
+
+    ///assert -uMock does it
+}
+#endif
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_056: [ "messagePoolSize" shall be handled by IoTHubClient_LL. Value is a pointer to a size_t number of records. IoTHubClient_LL_SetOption shall replace the message pool by a pool of that many records created with IoTHubClient_LL_Pool_Create, a value of 0 shall only remove the message pool. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messagePoolSize_creates_the_pool)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t poolSize = 4;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_Create(sizeof(IOTHUB_MESSAGE_LIST), 4));
+
+    ///act
+    auto result = IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
+
+    ///assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    mocks.AssertActualAndExpectedCalls();
 
-    time_t timeAfterCall = time(NULL);
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
 
-    if (difftime(lastMessageReceiveTime, timeBeforeCall) < 0)
-    {
-        ASSERT_FAIL("Last message time is earlier than expected.");
-    }
+/*Tests_SRS_IOTHUBCLIENT_LL_10_056: [ "messagePoolSize" shall be handled by IoTHubClient_LL. Value is a pointer to a size_t number of records. IoTHubClient_LL_SetOption shall replace the message pool by a pool of that many records created with IoTHubClient_LL_Pool_Create, a value of 0 shall only remove the message pool. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messagePoolSize_0_removes_the_pool)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t poolSize = 4;
+    (void)IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
+    poolSize = 0;
+    mocks.ResetAllCalls();
 
-    if (difftime(lastMessageReceiveTime, timeAfterCall) > 0)
-    {
-        ASSERT_FAIL("Last message time is later than expected.");
-    }
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_GetStatistics(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
+    ///act
+    auto result = IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
+/*Tests_SRS_IOTHUBCLIENT_LL_10_057: [ If records of the current message pool are in use then IoTHubClient_LL_SetOption shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messagePoolSize_fails_while_messages_use_the_pool)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t poolSize = 4;
+    (void)IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, NULL, NULL);
+    poolSize = 8;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_GetStatistics(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
-/*** IoTHubClient_LL_GetSendStatus ***/
+    ///act
+    auto result = IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
 
-/* Tests_SRS_IOTHUBCLIENT_09_007: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter] */
-TEST_FUNCTION(IoTHubClient_GetSendStatus_BadHandleArgument_fails)
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_058: [ If IoTHubClient_LL_Pool_Create fails then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_ERROR and keep the current message pool. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messagePoolSize_fails_when_IoTHubClient_LL_Pool_Create_fails)
 {
-    // arrange
+    ///arrange
     CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t poolSize = 4;
+    (void)IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
+    poolSize = 8;
     mocks.ResetAllCalls();
 
-    IOTHUB_CLIENT_STATUS status;
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_GetStatistics(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_Create(sizeof(IOTHUB_MESSAGE_LIST), 8))
+        .SetReturn((IOTHUB_CLIENT_LL_POOL_HANDLE)NULL);
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(NULL, &status);
+    ///act
+    auto result = IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
 
-    // assert
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     mocks.AssertActualAndExpectedCalls();
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
 
-    // cleanup
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_09_007: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter] */
-TEST_FUNCTION(IoTHubClient_GetSendStatus_BadStatusArgument_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_059: [ When there is a message pool the IOTHUB_MESSAGE_LIST records shall be taken from it and given back to it; a record the pool cannot serve shall be allocated with malloc. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_takes_the_record_from_the_message_pool)
 {
-    // arrange
+    ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t poolSize = 4;
+    (void)IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
     mocks.ResetAllCalls();
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, NULL);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_Alloc(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
-    // assert
+    ///act
+    auto result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, currentPoolInUse);
     mocks.AssertActualAndExpectedCalls();
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
 
-    // cleanup
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_09_008: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_IDLE if there is currently no items to be sent] */
-TEST_FUNCTION(IoTHubClient_GetSendStatus_NoEventToSend_Succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_059: [ When there is a message pool the IOTHUB_MESSAGE_LIST records shall be taken from it and given back to it; a record the pool cannot serve shall be allocated with malloc. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_gives_the_record_back_to_the_message_pool)
 {
-    // arrange
+    ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t poolSize = 4;
+    (void)IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    DLIST_ENTRY completed;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&completed);
+    BASEIMPLEMENTATION::DList_InsertTailList(&completed, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
     mocks.ResetAllCalls();
 
-    IOTHUB_CLIENT_STATUS status;
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(&completed));
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_Free(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(&completed));
 
-    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_GetSendStatus(IGNORED_PTR_ARG, &status))
-        .IgnoreAllArguments()
-        .SetReturn(IOTHUB_CLIENT_OK);
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
 
-    currentIotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_IDLE;
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, currentPoolInUse);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_060: [ IoTHubClient_LL_Destroy shall destroy the message pool, if any, after every record has been given back to it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Destroy_destroys_the_message_pool_last)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t poolSize = 4;
+    (void)IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, NULL, NULL);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Unregister(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_Free(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, tickcounter_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+#ifndef DONT_USE_UPLOADTOBLOB
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_UploadToBlob_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+#endif
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, &status);
+    ///act
+    IoTHubClient_LL_Destroy(handle);
 
-    // assert
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, currentPoolInUse);
     mocks.AssertActualAndExpectedCalls();
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_IDLE, status);
-
-    // cleanup
-    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_09_009: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently items to be sent] */
-TEST_FUNCTION(IoTHubClient_GetSendStatus_HasEventToSend_Succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_061: [ If iotHubClientHandle or poolStatistics is NULL then IoTHubClient_LL_GetPoolStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetPoolStatistics_with_NULL_handle_fails)
 {
-    // arrange
+    ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    mocks.ResetAllCalls();
+    IOTHUB_CLIENT_POOL_STATISTICS poolStatistics;
 
-    IOTHUB_CLIENT_STATUS status;
+    ///act
+    auto result = IoTHubClient_LL_GetPoolStatistics(NULL, &poolStatistics);
 
-    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_GetSendStatus(IGNORED_PTR_ARG, &status))
-        .IgnoreAllArguments()
-        .SetReturn(IOTHUB_CLIENT_OK);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
 
-    currentIotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+/*Tests_SRS_IOTHUBCLIENT_LL_10_061: [ If iotHubClientHandle or poolStatistics is NULL then IoTHubClient_LL_GetPoolStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetPoolStatistics_with_NULL_poolStatistics_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, &status);
+    ///act
+    auto result = IoTHubClient_LL_GetPoolStatistics(handle, NULL);
 
-    // assert
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     mocks.AssertActualAndExpectedCalls();
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_BUSY, status);
 
-    // cleanup
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
-    currentIotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_IDLE;
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_034: [If iotHubClientHandle is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_handle_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_062: [ If there is no message pool then IoTHubClient_LL_GetPoolStatistics shall set all the counters to 0 and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetPoolStatistics_without_a_pool_returns_0s)
 {
     ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_POOL_STATISTICS poolStatistics;
+    memset(&poolStatistics, 0xFF, sizeof(poolStatistics));
+    mocks.ResetAllCalls();
 
     ///act
-    auto result = IoTHubClient_LL_SetOption(NULL, "a", "b");
+    auto result = IoTHubClient_LL_GetPoolStatistics(handle, &poolStatistics);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 0, poolStatistics.capacity);
+    ASSERT_ARE_EQUAL(size_t, 0, poolStatistics.inUse);
+    ASSERT_ARE_EQUAL(size_t, 0, poolStatistics.peakInUse);
+    ASSERT_IS_TRUE(poolStatistics.hits == 0);
+    ASSERT_IS_TRUE(poolStatistics.misses == 0);
+    mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_035: [If optionName is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_optionName_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_063: [ Otherwise IoTHubClient_LL_GetPoolStatistics shall fill poolStatistics by calling IoTHubClient_LL_Pool_GetStatistics and return IOTHUB_CLIENT_OK, or IOTHUB_CLIENT_ERROR if IoTHubClient_LL_Pool_GetStatistics fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetPoolStatistics_returns_the_counters_of_the_pool)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t poolSize = 4;
+    (void)IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, NULL, NULL);
+    IOTHUB_CLIENT_POOL_STATISTICS poolStatistics;
     mocks.ResetAllCalls();
 
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_GetStatistics(IGNORED_PTR_ARG, &poolStatistics))
+        .IgnoreArgument(1);
+
     ///act
-    auto result = IoTHubClient_LL_SetOption(handle, NULL, "b");
+    auto result = IoTHubClient_LL_GetPoolStatistics(handle, &poolStatistics);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, poolStatistics.inUse);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
-
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_036: [If value is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_value_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_063: [ Otherwise IoTHubClient_LL_GetPoolStatistics shall fill poolStatistics by calling IoTHubClient_LL_Pool_GetStatistics and return IOTHUB_CLIENT_OK, or IOTHUB_CLIENT_ERROR if IoTHubClient_LL_Pool_GetStatistics fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetPoolStatistics_fails_when_IoTHubClient_LL_Pool_GetStatistics_fails)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t poolSize = 4;
+    (void)IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
+    IOTHUB_CLIENT_POOL_STATISTICS poolStatistics;
     mocks.ResetAllCalls();
 
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_GetStatistics(IGNORED_PTR_ARG, &poolStatistics))
+        .IgnoreArgument(1)
+        .SetReturn(__LINE__);
+
     ///act
-    auto result = IoTHubClient_LL_SetOption(handle, "a", NULL);
+    auto result = IoTHubClient_LL_GetPoolStatistics(handle, &poolStatistics);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
-
 }
 
-#ifndef DONT_USE_UPLOADTOBLOB
-/*these tests are to be run when upload to blob functionality exists*/
-
-/*Tests_SRS_IOTHUBCLIENT_LL_02_099 : [IoTHubClient_LL_SetOption shall return according to the table below]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_all_combinations)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_064: [ If parameter messageList is NULL then IoTHubClient_LL_ReleaseMessageList shall return. ]*/
+TEST_FUNCTION(IoTHubClient_LL_ReleaseMessageList_with_NULL_messageList_shall_return)
 {
+    ///arrange
+    CIoTHubClientLLMocks mocks;
 
-    static struct SetOptionTriplet
-    {
-        IOTHUB_CLIENT_RESULT IoTHubClient_UploadToBlob_SetOption_return;
-        IOTHUB_CLIENT_RESULT Transport_SetOption_return;
-        IOTHUB_CLIENT_RESULT expected_return;
-    } allCombinations[] = 
-    {
-        { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_OK , IOTHUB_CLIENT_OK},
-        { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR },
-        { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_OK },
-        { IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_OK , IOTHUB_CLIENT_ERROR },
-        { IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR },
-        { IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_ERROR },
-        { IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_OK , IOTHUB_CLIENT_OK },
-        { IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR },
-        { IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_INVALID_ARG }
-    };
+    ///act
+    IoTHubClient_LL_ReleaseMessageList(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
 
+/*Tests_SRS_IOTHUBCLIENT_LL_10_065: [ Otherwise IoTHubClient_LL_ReleaseMessageList shall give messageList back to the message pool of the IoTHubClient_LL that queued it, or free it when that IoTHubClient_LL has no message pool. ]*/
+TEST_FUNCTION(IoTHubClient_LL_ReleaseMessageList_gives_the_record_back_to_the_message_pool)
+{
     ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    
-
-    for (size_t i = 0;i < sizeof(allCombinations) / sizeof(allCombinations[0]);i++)
-    {
-        mocks.ResetAllCalls();
-        EXPECTED_CALL(mocks, IoTHubClient_LL_UploadToBlob_SetOption(IGNORED_PTR_ARG, "a", "b"))
-            .SetReturn(allCombinations[i].IoTHubClient_UploadToBlob_SetOption_return);
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t poolSize = 4;
+    (void)IoTHubClient_LL_SetOption(handle, "messagePoolSize", &poolSize);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, NULL, NULL);
+
+    /*the transport takes the message out of waitingToSend and disposes of it by itself*/
+    IOTHUB_MESSAGE_LIST* inTransport = containingRecord(BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend), IOTHUB_MESSAGE_LIST, entry);
+    IoTHubClient_LL_UntrackMessage(inTransport);
+    IoTHubMessage_Destroy(inTransport->messageHandle);
+    mocks.ResetAllCalls();
 
-        EXPECTED_CALL(mocks, FAKE_IoTHubTransport_SetOption(IGNORED_PTR_ARG, "a", "b"))
-            .SetReturn(allCombinations[i].Transport_SetOption_return);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Pool_Free(IGNORED_PTR_ARG, inTransport))
+        .IgnoreArgument(1);
 
-        ///act
-        auto result = IoTHubClient_LL_SetOption(handle, "a", "b");
+    ///act
+    IoTHubClient_LL_ReleaseMessageList(inTransport);
 
-        ///assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, allCombinations[i].expected_return, result);
-    }
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, currentPoolInUse);
+    mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
-    mocks.ResetAllCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_038: [Otherwise, IoTHubClient_LL shall call the function _SetOption of the underlying transport and return what that function is returning.] */
-TEST_FUNCTION(IoTHubClient_LL_SetOption_fails_when_underlying_transport_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_065: [ Otherwise IoTHubClient_LL_ReleaseMessageList shall give messageList back to the message pool of the IoTHubClient_LL that queued it, or free it when that IoTHubClient_LL has no message pool. ]*/
+TEST_FUNCTION(IoTHubClient_LL_ReleaseMessageList_without_a_pool_frees_the_record)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    mocks.ResetAllCalls();
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, NULL, NULL);
 
-    EXPECTED_CALL(mocks, IoTHubClient_LL_UploadToBlob_SetOption(IGNORED_PTR_ARG, "a", "b"))
-        .SetReturn(IOTHUB_CLIENT_INVALID_ARG);
+    IOTHUB_MESSAGE_LIST* inTransport = containingRecord(BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend), IOTHUB_MESSAGE_LIST, entry);
+    IoTHubClient_LL_UntrackMessage(inTransport);
+    IoTHubMessage_Destroy(inTransport->messageHandle);
+    mocks.ResetAllCalls();
 
-    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_SetOption(IGNORED_PTR_ARG, "a", "b"))
-        .SetReturn(IOTHUB_CLIENT_INDEFINITE_TIME);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(inTransport));
 
     ///act
-    auto result = IoTHubClient_LL_SetOption(handle, "a", "b");
+    IoTHubClient_LL_ReleaseMessageList(inTransport);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INDEFINITE_TIME, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_074: [ If iotHubClientHandle or statistics is NULL then IoTHubClient_LL_GetStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetStatistics_with_NULL_handle_fails)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_STATISTICS statistics;
 
+    ///act
+    auto result = IoTHubClient_LL_GetStatistics(NULL, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
 }
-#else
-/*these tests are to be run when uploadtoblob is not present*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_fails_when_underlying_transport_fails)
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_074: [ If iotHubClientHandle or statistics is NULL then IoTHubClient_LL_GetStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetStatistics_with_NULL_statistics_fails)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     mocks.ResetAllCalls();
 
-    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_SetOption(IGNORED_PTR_ARG, "a", "b"))
-        .SetReturn(IOTHUB_CLIENT_INDEFINITE_TIME);
-
     ///act
-    auto result = IoTHubClient_LL_SetOption(handle, "a", "b");
+    auto result = IoTHubClient_LL_GetStatistics(handle, NULL);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INDEFINITE_TIME, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
-
 }
-#endif
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_to_zero_after_Create_succeeds)
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_066: [ The statistics counters shall start at 0 and by default the payload bytes and the latency of the messages shall not be recorded. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetStatistics_after_Create_returns_0s)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_STATISTICS statistics;
+    memset(&statistics, 0xFF, sizeof(statistics));
     mocks.ResetAllCalls();
 
     ///act
-    uint64_t zero = 0;
-    auto result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &zero);
+    auto result = IoTHubClient_LL_GetStatistics(handle, &statistics);
 
     ///assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.waitingToSend);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.inTransport);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.refused);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.sent);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.retries);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.confirmed);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.latencyCount);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_to_one_after_Create_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_067: [ Every message accepted by IoTHubClient_LL_SendEventAsync, IoTHubClient_LL_SendEventAsync_TakeOwnership or a batch send shall be counted in enqueued. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_075: [ IoTHubClient_LL_GetStatistics shall copy the counters to statistics, set inTransport to the number of messages whose timeout the transport suspended and has not resumed and waitingToSend to the number of the other messages that have not completed yet, without walking waitingToSend, and return IOTHUB_CLIENT_OK. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_084: [ A message whose timeout is suspended shall be counted in sent the first time, and in retries every other time, and shall be counted in inTransport until its timeout is resumed or it completes. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetStatistics_counts_the_messages_waiting_and_in_the_transport)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2);
+
+    /*the transport is sending the first message*/
+    DLIST_ENTRY inTransport;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&inTransport);
+    PDLIST_ENTRY taken = BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend);
+    BASEIMPLEMENTATION::DList_InsertTailList(&inTransport, taken);
+    IoTHubClient_LL_SuspendMessageTimeout(containingRecord(taken, IOTHUB_MESSAGE_LIST, entry));
+    IOTHUB_CLIENT_STATISTICS statistics;
     mocks.ResetAllCalls();
 
     ///act
-    uint64_t one = 1;
-    auto result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    auto result = IoTHubClient_LL_GetStatistics(handle, &statistics);
 
     ///assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics.enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.enqueuedBytes);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.sent);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.retries);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.waitingToSend);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.inTransport);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    IoTHubClient_LL_SendComplete(handle, &inTransport, IOTHUB_CLIENT_CONFIRMATION_OK);
     IoTHubClient_LL_Destroy(handle);
-
+    mocks.ResetAllCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_can_be_reverted_back_to_zero_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_069: [ A message completed with IOTHUB_CLIENT_CONFIRMATION_OK shall be counted in confirmed and, if its queueing time was taken, the ms between then and now shall be added to the latency histogram. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_070: [ Messages that time out shall be counted in timedOut, messages dropped to make room in the send queue in dropped and messages completed with any other result in failed. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_086: [ A message completed with IOTHUB_CLIENT_CONFIRMATION_OK or IOTHUB_CLIENT_CONFIRMATION_ERROR that was not counted in sent yet, because the transport sent it within IoTHubClient_LL_DoWork, shall be counted in sent. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_counts_the_confirmed_and_the_failed_messages)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    uint64_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2);
+    DLIST_ENTRY confirmed;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&confirmed);
+    BASEIMPLEMENTATION::DList_InsertTailList(&confirmed, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    DLIST_ENTRY failed;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&failed);
+    BASEIMPLEMENTATION::DList_InsertTailList(&failed, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    IOTHUB_CLIENT_STATISTICS statistics;
     mocks.ResetAllCalls();
 
     ///act
-    uint64_t zero = 0;
-    auto result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &zero);
+    IoTHubClient_LL_SendComplete(handle, &confirmed, IOTHUB_CLIENT_CONFIRMATION_OK);
+    IoTHubClient_LL_SendComplete(handle, &failed, IOTHUB_CLIENT_CONFIRMATION_ERROR);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-    mocks.AssertActualAndExpectedCalls();
+    (void)IoTHubClient_LL_GetStatistics(handle, &statistics);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.confirmed);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.failed);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics.sent);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.latencyCount); /*"sendStatistics" is off*/
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.waitingToSend);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.inTransport);
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_calls_timeout_callback)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_070: [ Messages that time out shall be counted in timedOut, messages dropped to make room in the send queue in dropped and messages completed with any other result in failed. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_counts_the_messages_that_timed_out)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     uint64_t one = 1;
     (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
-
-    /*send 1 messages that will expire*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
     uint64_t ten = 10;
     STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
     mocks.ResetAllCalls();
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
-
-    uint64_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout*/
+    uint64_t twelve = 12;
     STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
-
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
-        .IgnoreArgument(1);
+    IOTHUB_CLIENT_STATISTICS statistics;
 
     ///act
     IoTHubClient_LL_DoWork(handle);
 
     ///assert
-    mocks.AssertActualAndExpectedCalls();
+    (void)IoTHubClient_LL_GetStatistics(handle, &statistics);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.timedOut);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.confirmed);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.waitingToSend);
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_042: [ By default, messages shall not timeout. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_defaults_to_zero)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_070: [ Messages that time out shall be counted in timedOut, messages dropped to make room in the send queue in dropped and messages completed with any other result in failed. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_071: [ Messages refused because the send queue had no room for them shall be counted in refused. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_counts_the_dropped_and_the_refused_messages)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-
-    /*send 1 messages that will expire*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    uint64_t ten = 10;
-    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    size_t one = 1;
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST;
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueFullPolicy", &policy);
+    (void)IoTHubClient_LL_SetOption(handle, "sendQueueMaxMessages", &one);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    IOTHUB_CLIENT_STATISTICS statistics;
     mocks.ResetAllCalls();
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
-
-    uint64_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => would result in timeout, except the fact that messageTimeout option has never been set, therefore no timeout shall be called*/
-    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
-
     ///act
-    IoTHubClient_LL_DoWork(handle);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2); /*drops message 1*/
+    DLIST_ENTRY inTransport;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&inTransport);
+    PDLIST_ENTRY taken = BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend);
+    BASEIMPLEMENTATION::DList_InsertTailList(&inTransport, taken);
+    IoTHubClient_LL_SuspendMessageTimeout(containingRecord(taken, IOTHUB_MESSAGE_LIST, entry));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)3); /*nothing can be dropped*/
 
     ///assert
-    mocks.AssertActualAndExpectedCalls();
+    (void)IoTHubClient_LL_GetStatistics(handle, &statistics);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics.enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.dropped);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.refused);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.inTransport);
 
     ///cleanup
+    IoTHubClient_LL_SendComplete(handle, &inTransport, IOTHUB_CLIENT_CONFIRMATION_OK);
     IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_only_removes_the_message_if_it_has_NULL_callback)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_076: [ "sendStatistics" shall be handled by IoTHubClient_LL. Value is a pointer to a bool, it only applies to the messages queued after it is set. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_sendStatistics_succeeds)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    uint64_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
-
-    /*send 1 messages that will expire*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    uint64_t ten = 10;
-    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, NULL, NULL); /*this is a message with a NULL callback*/
+    bool on = true;
     mocks.ResetAllCalls();
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
+    ///act
+    auto result = IoTHubClient_LL_SetOption(handle, "sendStatistics", &on);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    mocks.AssertActualAndExpectedCalls();
 
-    uint64_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout*/
-    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
 
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_068: [ When "sendStatistics" is on, the payload bytes of the message shall be counted in enqueuedBytes and the time it was queued shall be taken by calling tickcounter_get_current_ms. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_sendStatistics_takes_the_size_and_the_time_of_the_message)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    bool on = true;
+    (void)IoTHubClient_LL_SetOption(handle, "sendStatistics", &on);
+    IOTHUB_CLIENT_STATISTICS statistics;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
     ///act
-    IoTHubClient_LL_DoWork(handle);
+    auto result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     mocks.AssertActualAndExpectedCalls();
+    (void)IoTHubClient_LL_GetStatistics(handle, &statistics);
+    ASSERT_ARE_EQUAL(uint64_t, 10, statistics.enqueuedBytes);
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_when_exactly_on_the_edge_does_not_call_the_callback) /*because "more"*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_069: [ A message completed with IOTHUB_CLIENT_CONFIRMATION_OK shall be counted in confirmed and, if its queueing time was taken, the ms between then and now shall be added to the latency histogram. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_sendStatistics_records_the_latency)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    uint64_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
-
-    /*send 1 messages that will expire*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
+    bool on = true;
+    (void)IoTHubClient_LL_SetOption(handle, "sendStatistics", &on);
     uint64_t ten = 10;
     STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    DLIST_ENTRY completed;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&completed);
+    BASEIMPLEMENTATION::DList_InsertTailList(&completed, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    IOTHUB_CLIENT_STATISTICS statistics;
     mocks.ResetAllCalls();
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
-
-    uint64_t eleven = 11; /*11 = 10 (receive time) + 1 (timeout) => NO timeout*/
+    uint64_t twentyFive = 25;
     STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &eleven, sizeof(eleven));
+        .CopyOutArgumentBuffer(2, &twentyFive, sizeof(twentyFive));
 
     ///act
-    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
 
     ///assert
-    mocks.AssertActualAndExpectedCalls();
+    (void)IoTHubClient_LL_GetStatistics(handle, &statistics);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.confirmed);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.latencyCount);
+    ASSERT_ARE_EQUAL(uint64_t, 15, statistics.latencyMinMs);
+    ASSERT_ARE_EQUAL(uint64_t, 15, statistics.latencyMaxMs);
+    ASSERT_ARE_EQUAL(uint64_t, 15, statistics.latencyTotalMs);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.latencyHistogram[15]); /*[15, 16) ms*/
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_calls_1_timeout) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_085: [ The latency histogram shall be log-linear: one bucket per ms under IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT ms, then IOTHUB_CLIENT_LATENCY_SUB_BUCKET_COUNT buckets of equal width in every power of 2 range, the last bucket counting all the latencies of 2^IOTHUB_CLIENT_LATENCY_RANGE_BITS ms and more. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_sendStatistics_records_the_latency_in_log_linear_buckets)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    uint64_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
-
-    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    uint64_t ten = 10;
+    bool on = true;
+    (void)IoTHubClient_LL_SetOption(handle, "sendStatistics", &on);
+    uint64_t zero = 0;
     STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
-
-    uint64_t two = 2;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &two);
+        .CopyOutArgumentBuffer(2, &zero, sizeof(zero));
     STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2 ));
-
+        .CopyOutArgumentBuffer(2, &zero, sizeof(zero));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2);
+    DLIST_ENTRY first;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&first);
+    BASEIMPLEMENTATION::DList_InsertTailList(&first, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    DLIST_ENTRY second;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&second);
+    BASEIMPLEMENTATION::DList_InsertTailList(&second, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    IOTHUB_CLIENT_STATISTICS statistics;
     mocks.ResetAllCalls();
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
-
-    uint64_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
+    uint64_t oneThousand = 1000;
+    uint64_t overTheRange = (uint64_t)1 << (IOTHUB_CLIENT_LATENCY_RANGE_BITS + 1);
     STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
-
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
-        .IgnoreArgument(1);
-
-    /*because we're at time = 12 in this test, the second message is untouched*/
+        .CopyOutArgumentBuffer(2, &oneThousand, sizeof(oneThousand));
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &overTheRange, sizeof(overTheRange));
 
     ///act
-    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_SendComplete(handle, &first, IOTHUB_CLIENT_CONFIRMATION_OK);
+    IoTHubClient_LL_SendComplete(handle, &second, IOTHUB_CLIENT_CONFIRMATION_OK);
 
     ///assert
-    mocks.AssertActualAndExpectedCalls();
+    (void)IoTHubClient_LL_GetStatistics(handle, &statistics);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics.latencyCount);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.latencyHistogram[63]); /*[960, 1024) ms: the 8th bucket of 64 ms in [512, 1024)*/
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.latencyHistogram[IOTHUB_CLIENT_LATENCY_BUCKET_COUNT - 1]);
+    ASSERT_ARE_EQUAL(size_t, 176, IOTHUB_CLIENT_LATENCY_BUCKET_COUNT);
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_044: [ Messages already delivered to IoTHubClient_LL shall not have their timeouts modified by a new call to IoTHubClient_LL_SetOption. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_calls_2_timeouts) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_084: [ A message whose timeout is suspended shall be counted in sent the first time, and in retries every other time, and shall be counted in inTransport until its timeout is resumed or it completes. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SuspendMessageTimeout_again_after_a_resume_counts_a_retry)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    uint64_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    IOTHUB_MESSAGE_LIST* inTransport = containingRecord(BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend), IOTHUB_MESSAGE_LIST, entry);
+    IOTHUB_CLIENT_STATISTICS afterRollback;
+    IOTHUB_CLIENT_STATISTICS statistics;
+    IoTHubClient_LL_SuspendMessageTimeout(inTransport);
+    mocks.ResetAllCalls();
 
-    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    uint64_t ten = 10;
-    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    ///act
+    /*the transport rolls the message back, then takes it again*/
+    BASEIMPLEMENTATION::DList_InsertTailList(currentWaitingToSend, &(inTransport->entry));
+    IoTHubClient_LL_ResumeMessageTimeout(inTransport);
+    (void)IoTHubClient_LL_GetStatistics(handle, &afterRollback);
+    (void)BASEIMPLEMENTATION::DList_RemoveEntryList(&(inTransport->entry));
+    IoTHubClient_LL_SuspendMessageTimeout(inTransport);
 
-    uint64_t two = 2;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &two);
-    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2));
+    ///assert
+    (void)IoTHubClient_LL_GetStatistics(handle, &statistics);
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, 1, afterRollback.waitingToSend);
+    ASSERT_ARE_EQUAL(size_t, 0, afterRollback.inTransport);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.sent);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.retries);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.waitingToSend);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.inTransport);
 
+    ///cleanup
+    DLIST_ENTRY completed;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&completed);
+    BASEIMPLEMENTATION::DList_InsertTailList(&completed, &(inTransport->entry));
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
+    IoTHubClient_LL_Destroy(handle);
     mocks.ResetAllCalls();
+}
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
-
-    {/*this scope happen in the first _DoWork call*/
-        uint64_t timeIsNow = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
-        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
-
-        STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
-            .IgnoreArgument(1);
-    }
+/*Tests_SRS_IOTHUBCLIENT_LL_10_082: [ If parameter handle is NULL then IoTHubClient_LL_CountRetry shall return. ]*/
+TEST_FUNCTION(IoTHubClient_LL_CountRetry_with_NULL_handle_shall_return)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
 
-    {/*this scope happen in the second _DoWork call*/
-        uint64_t timeIsNow = 13; /*13 > 10 (receive time) + 2 (timeout) => timeout!!!*/
-        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+    ///act
+    IoTHubClient_LL_CountRetry(NULL);
 
-        STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)(TEST_DEVICEMESSAGE_HANDLE_2))); /*calling the callback*/
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
-            .IgnoreArgument(1);
-    }
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
 
-    /*because we're at time = 13 in this test, the second message times out too*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_083: [ Otherwise IoTHubClient_LL_CountRetry shall count one more retry in the statistics of handle. ]*/
+TEST_FUNCTION(IoTHubClient_LL_CountRetry_counts_a_retry)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_STATISTICS statistics;
+    mocks.ResetAllCalls();
 
     ///act
-    IoTHubClient_LL_DoWork(handle);
-    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_CountRetry(handle);
+    IoTHubClient_LL_CountRetry(handle);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    (void)IoTHubClient_LL_GetStatistics(handle, &statistics);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics.retries);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.sent);
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a uint64. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClient_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_044: [ Messages already delivered to IoTHubClient_LL shall not have their timeouts modified by a new call to IoTHubClient_LL_SetOption. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_one_with_timeout_one_without_call_1_callback) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+static size_t sendQueueRoomCalls;
+static void* sendQueueRoomContext;
+static void onSendQueueRoom(void* context)
+{
+    sendQueueRoomCalls++;
+    sendQueueRoomContext = context;
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_087: [ If parameter handle is NULL then IoTHubClient_LL_SetSendQueueRoomCallback shall return. Otherwise it shall remember callback and context, a NULL callback removes the previous one. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetSendQueueRoomCallback_with_NULL_handle_shall_return)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    uint64_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
 
-    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    uint64_t ten = 10;
-    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    ///act
+    IoTHubClient_LL_SetSendQueueRoomCallback(NULL, onSendQueueRoom, (void*)3);
 
-    uint64_t zero = 0;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &zero); /*essentially no timeout*/
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2));
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
 
+/*Tests_SRS_IOTHUBCLIENT_LL_10_087: [ If parameter handle is NULL then IoTHubClient_LL_SetSendQueueRoomCallback shall return. Otherwise it shall remember callback and context, a NULL callback removes the previous one. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_088: [ Every time a message gives back its room in the send queue, the callback set by IoTHubClient_LL_SetSendQueueRoomCallback shall be called with its context, if a callback is set. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_calls_the_send_queue_room_callback_for_every_message)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)2);
+    DLIST_ENTRY completed;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&completed);
+    BASEIMPLEMENTATION::DList_InsertTailList(&completed, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    BASEIMPLEMENTATION::DList_InsertTailList(&completed, BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend));
+    sendQueueRoomCalls = 0;
+    sendQueueRoomContext = NULL;
+    IoTHubClient_LL_SetSendQueueRoomCallback(handle, onSendQueueRoom, (void*)3);
     mocks.ResetAllCalls();
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
-
-    {/*this scope happen in the first _DoWork call*/
-        uint64_t timeIsNow = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
-        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
-
-        STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
-            .IgnoreArgument(1);
-    }
-
-    {/*this scope happen in the second _DoWork call*/
-        uint64_t timeIsNow = 999999999999999ULL; /*some very big number*/
-        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
-    }
-
     ///act
-    IoTHubClient_LL_DoWork(handle);
-    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
 
     ///assert
-    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, 2, sendQueueRoomCalls);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)3, sendQueueRoomContext);
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
+    mocks.ResetAllCalls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_when_tickcounter_fails_in_do_work_no_timeout_callbacks_are_called) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_072: [ If parameter messageList is NULL then IoTHubClient_LL_UntrackCompletedMessage shall return. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UntrackCompletedMessage_with_NULL_messageList_shall_return)
 {
     ///arrange
     CIoTHubClientLLMocks mocks;
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    uint64_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
-
-    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    uint64_t ten = 10;
-    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)TEST_DEVICEMESSAGE_HANDLE);
 
-    mocks.ResetAllCalls();
+    ///act
+    IoTHubClient_LL_UntrackCompletedMessage(NULL, IOTHUB_CLIENT_CONFIRMATION_OK);
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
 
-    {/*this scope happen in the _DoWork call*/
-        uint64_t timeIsNow = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!! (well - normally - but here the code doesn't call any callbacks because time cannot be obtained*/
-        STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow))
-            .SetFailReturn(__LINE__);
-    }
+/*Tests_SRS_IOTHUBCLIENT_LL_10_073: [ Otherwise IoTHubClient_LL_UntrackCompletedMessage shall do what IoTHubClient_LL_UntrackMessage does and count the message in the statistics of the IoTHubClient_LL that queued it as completed with result. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UntrackCompletedMessage_untracks_and_counts_the_message)
+{
+    ///arrange
+    CIoTHubClientLLMocks mocks;
+    auto handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, NULL, NULL);
+    IOTHUB_MESSAGE_LIST* inTransport = containingRecord(BASEIMPLEMENTATION::DList_RemoveHeadList(currentWaitingToSend), IOTHUB_MESSAGE_LIST, entry);
+    IOTHUB_CLIENT_STATISTICS statistics;
+    mocks.ResetAllCalls();
 
     ///act
-    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_UntrackCompletedMessage(inTransport, IOTHUB_CLIENT_CONFIRMATION_ERROR);
 
     ///assert
-    mocks.AssertActualAndExpectedCalls();
+    (void)IoTHubClient_LL_GetStatistics(handle, &statistics);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.failed);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.inTransport);
 
     ///cleanup
+    IoTHubMessage_Destroy(inTransport->messageHandle);
+    IoTHubClient_LL_ReleaseMessageList(inTransport);
     IoTHubClient_LL_Destroy(handle);
 }
 
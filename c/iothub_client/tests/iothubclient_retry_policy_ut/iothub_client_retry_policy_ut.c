@@ -0,0 +1,517 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+
+#include "testrunnerswitcher.h"
+#include "azure_c_shared_utility/macro_utils.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#include "iothub_client_options.h"
+#include "iothub_client_retry_policy.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+/*the delay the policy draws for cap at its next failure: the next xorshift64 number of the policy, modulo cap + 1*/
+static size_t peekJitteredDelay(const IOTHUB_CLIENT_RETRY_POLICY* policy, size_t cap)
+{
+    uint64_t x = policy->randomState;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return (size_t)(x % ((uint64_t)cap + 1));
+}
+
+static void failTimes(IOTHUB_CLIENT_RETRY_POLICY* policy, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        IoTHubClient_RetryPolicy_OnFailure(policy);
+    }
+}
+
+BEGIN_TEST_SUITE(iothubclient_retry_policy_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    umocktypes_charptr_register_types();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_001: [If policy is NULL then IoTHubClient_RetryPolicy_Init shall do nothing.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_Init_with_NULL_policy_does_nothing)
+{
+    ///arrange
+
+    ///act
+    IoTHubClient_RetryPolicy_Init(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_002: [IoTHubClient_RetryPolicy_Init shall set the initial delay to IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_INITIAL_DELAY and the maximum delay to IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_MAX_DELAY milliseconds, with no failure counted and no wait.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_Init_sets_the_default_delays)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    (void)memset(&policy, 0xFF, sizeof(policy));
+
+    ///act
+    IoTHubClient_RetryPolicy_Init(&policy);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_INITIAL_DELAY, policy.initialDelayInMs);
+    ASSERT_ARE_EQUAL(size_t, IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_MAX_DELAY, policy.maxDelayInMs);
+    ASSERT_ARE_EQUAL(size_t, 0, policy.failureCount);
+    ASSERT_IS_FALSE(IoTHubClient_RetryPolicy_IsWaiting(&policy));
+    ASSERT_IS_TRUE(IoTHubClient_RetryPolicy_CanAttempt(&policy, 0));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_018: [IoTHubClient_RetryPolicy_Init shall seed the random generator of the policy from the address of the policy.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_Init_seeds_every_policy_differently)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policies[2];
+
+    ///act
+    IoTHubClient_RetryPolicy_Init(&policies[0]);
+    IoTHubClient_RetryPolicy_Init(&policies[1]);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(uint64_t, (uint64_t)0, policies[0].randomState);
+    ASSERT_ARE_NOT_EQUAL(uint64_t, (uint64_t)0, policies[1].randomState);
+    ASSERT_ARE_NOT_EQUAL(uint64_t, policies[0].randomState, policies[1].randomState);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_019: [If policy or seed is NULL then IoTHubClient_RetryPolicy_Seed shall do nothing.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_Seed_with_NULL_arguments_does_nothing)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    uint64_t randomState;
+    IoTHubClient_RetryPolicy_Init(&policy);
+    randomState = policy.randomState;
+
+    ///act
+    IoTHubClient_RetryPolicy_Seed(NULL, "device1");
+    IoTHubClient_RetryPolicy_Seed(&policy, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(uint64_t, randomState, policy.randomState);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_020: [IoTHubClient_RetryPolicy_Seed shall mix the FNV-1a hash of seed into the random generator of the policy.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_Seed_with_different_seeds_draws_different_delays)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy1;
+    IOTHUB_CLIENT_RETRY_POLICY policy2;
+    size_t value = 1000000000;
+    IoTHubClient_RetryPolicy_Init(&policy1);
+    (void)IoTHubClient_RetryPolicy_SetOption(&policy1, OPTION_RETRY_INITIAL_DELAY, &value);
+    (void)IoTHubClient_RetryPolicy_SetOption(&policy1, OPTION_RETRY_MAX_DELAY, &value);
+    /*same state before seeding, as two devices booting the same image*/
+    policy2 = policy1;
+
+    ///act
+    IoTHubClient_RetryPolicy_Seed(&policy1, "device1");
+    IoTHubClient_RetryPolicy_Seed(&policy2, "device2");
+    IoTHubClient_RetryPolicy_OnFailure(&policy1);
+    IoTHubClient_RetryPolicy_OnFailure(&policy2);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(size_t, policy1.delayInMs, policy2.delayInMs);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_020: [IoTHubClient_RetryPolicy_Seed shall mix the FNV-1a hash of seed into the random generator of the policy.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_Seed_with_the_same_seed_draws_the_same_delays)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy1;
+    IOTHUB_CLIENT_RETRY_POLICY policy2;
+    IoTHubClient_RetryPolicy_Init(&policy1);
+    policy2 = policy1;
+
+    ///act
+    IoTHubClient_RetryPolicy_Seed(&policy1, "device1");
+    IoTHubClient_RetryPolicy_Seed(&policy2, "device1");
+    failTimes(&policy1, 3);
+    failTimes(&policy2, 3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(uint64_t, policy1.randomState, policy2.randomState);
+    ASSERT_ARE_EQUAL(size_t, policy1.delayInMs, policy2.delayInMs);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_003: [If policy, optionName or value is NULL then IoTHubClient_RetryPolicy_SetOption shall return false.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_SetOption_with_NULL_arguments_returns_false)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    size_t value = 5;
+    IoTHubClient_RetryPolicy_Init(&policy);
+
+    ///act
+    bool result1 = IoTHubClient_RetryPolicy_SetOption(NULL, OPTION_RETRY_MAX_DELAY, &value);
+    bool result2 = IoTHubClient_RetryPolicy_SetOption(&policy, NULL, &value);
+    bool result3 = IoTHubClient_RetryPolicy_SetOption(&policy, OPTION_RETRY_MAX_DELAY, NULL);
+
+    ///assert
+    ASSERT_IS_FALSE(result1);
+    ASSERT_IS_FALSE(result2);
+    ASSERT_IS_FALSE(result3);
+    ASSERT_ARE_EQUAL(size_t, IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_MAX_DELAY, policy.maxDelayInMs);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_004: [If optionName is "retryInitialDelay" then IoTHubClient_RetryPolicy_SetOption shall set the initial delay to the size_t milliseconds pointed to by value and return true.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_SetOption_retryInitialDelay_sets_the_initial_delay)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    size_t value = 250;
+    IoTHubClient_RetryPolicy_Init(&policy);
+
+    ///act
+    bool result = IoTHubClient_RetryPolicy_SetOption(&policy, OPTION_RETRY_INITIAL_DELAY, &value);
+
+    ///assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(size_t, 250, policy.initialDelayInMs);
+    ASSERT_ARE_EQUAL(size_t, IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_MAX_DELAY, policy.maxDelayInMs);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_005: [If optionName is "retryMaxDelay" then IoTHubClient_RetryPolicy_SetOption shall set the maximum delay to the size_t milliseconds pointed to by value and return true.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_SetOption_retryMaxDelay_sets_the_maximum_delay)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    size_t value = 120000;
+    IoTHubClient_RetryPolicy_Init(&policy);
+
+    ///act
+    bool result = IoTHubClient_RetryPolicy_SetOption(&policy, OPTION_RETRY_MAX_DELAY, &value);
+
+    ///assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(size_t, IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_INITIAL_DELAY, policy.initialDelayInMs);
+    ASSERT_ARE_EQUAL(size_t, 120000, policy.maxDelayInMs);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_006: [Otherwise IoTHubClient_RetryPolicy_SetOption shall return false.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_SetOption_with_another_option_returns_false)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    size_t value = 7;
+    IoTHubClient_RetryPolicy_Init(&policy);
+
+    ///act
+    bool result = IoTHubClient_RetryPolicy_SetOption(&policy, OPTION_MIN_POLLING_TIME, &value);
+
+    ///assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(size_t, IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_INITIAL_DELAY, policy.initialDelayInMs);
+    ASSERT_ARE_EQUAL(size_t, IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_MAX_DELAY, policy.maxDelayInMs);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_007: [If policy is NULL then IoTHubClient_RetryPolicy_OnFailure shall do nothing.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_OnFailure_with_NULL_policy_does_nothing)
+{
+    ///arrange
+
+    ///act
+    IoTHubClient_RetryPolicy_OnFailure(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_008: [IoTHubClient_RetryPolicy_OnFailure shall count the failure and take as cap the initial delay doubled for every failure in a row after the first one, without going above the maximum delay.]*/
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_009: [IoTHubClient_RetryPolicy_OnFailure shall draw the delay between 0 and cap, both included, from the xorshift64 generator of the policy. If the delay is not 0 then the policy shall wait, from the next call to IoTHubClient_RetryPolicy_CanAttempt, otherwise it shall not wait.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_OnFailure_the_first_time_draws_a_delay_up_to_the_initial_delay)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    size_t expectedDelay;
+    IoTHubClient_RetryPolicy_Init(&policy);
+    expectedDelay = peekJitteredDelay(&policy, IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_INITIAL_DELAY);
+
+    ///act
+    IoTHubClient_RetryPolicy_OnFailure(&policy);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, policy.failureCount);
+    ASSERT_ARE_EQUAL(size_t, expectedDelay, policy.delayInMs);
+    ASSERT_IS_TRUE(policy.delayInMs <= IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_INITIAL_DELAY);
+    ASSERT_IS_TRUE(IoTHubClient_RetryPolicy_IsWaiting(&policy) == (expectedDelay > 0));
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_008: [IoTHubClient_RetryPolicy_OnFailure shall count the failure and take as cap the initial delay doubled for every failure in a row after the first one, without going above the maximum delay.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_OnFailure_doubles_the_cap_for_every_failure_in_a_row)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    size_t expectedDelay;
+    IoTHubClient_RetryPolicy_Init(&policy);
+    failTimes(&policy, 3);
+    expectedDelay = peekJitteredDelay(&policy, 8 * IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_INITIAL_DELAY);
+
+    ///act
+    IoTHubClient_RetryPolicy_OnFailure(&policy);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 4, policy.failureCount);
+    ASSERT_ARE_EQUAL(size_t, expectedDelay, policy.delayInMs);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_008: [IoTHubClient_RetryPolicy_OnFailure shall count the failure and take as cap the initial delay doubled for every failure in a row after the first one, without going above the maximum delay.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_OnFailure_does_not_go_above_the_maximum_delay)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    size_t expectedDelay;
+    IoTHubClient_RetryPolicy_Init(&policy);
+    failTimes(&policy, 1000);
+    expectedDelay = peekJitteredDelay(&policy, IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_MAX_DELAY);
+
+    ///act
+    IoTHubClient_RetryPolicy_OnFailure(&policy);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, expectedDelay, policy.delayInMs);
+    ASSERT_IS_TRUE(policy.delayInMs <= IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_MAX_DELAY);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_009: [IoTHubClient_RetryPolicy_OnFailure shall draw the delay between 0 and cap, both included, from the xorshift64 generator of the policy. If the delay is not 0 then the policy shall wait, from the next call to IoTHubClient_RetryPolicy_CanAttempt, otherwise it shall not wait.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_OnFailure_with_a_maximum_delay_of_0_does_not_wait)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    size_t value = 0;
+    IoTHubClient_RetryPolicy_Init(&policy);
+    (void)IoTHubClient_RetryPolicy_SetOption(&policy, OPTION_RETRY_MAX_DELAY, &value);
+
+    ///act
+    failTimes(&policy, 10);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, policy.delayInMs);
+    ASSERT_IS_FALSE(IoTHubClient_RetryPolicy_IsWaiting(&policy));
+    ASSERT_IS_TRUE(IoTHubClient_RetryPolicy_CanAttempt(&policy, 0));
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_009: [IoTHubClient_RetryPolicy_OnFailure shall draw the delay between 0 and cap, both included, from the xorshift64 generator of the policy. If the delay is not 0 then the policy shall wait, from the next call to IoTHubClient_RetryPolicy_CanAttempt, otherwise it shall not wait.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_OnFailure_with_the_biggest_maximum_delay_does_not_overflow)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    size_t value = (size_t)-1;
+    IoTHubClient_RetryPolicy_Init(&policy);
+    (void)IoTHubClient_RetryPolicy_SetOption(&policy, OPTION_RETRY_INITIAL_DELAY, &value);
+    (void)IoTHubClient_RetryPolicy_SetOption(&policy, OPTION_RETRY_MAX_DELAY, &value);
+
+    ///act
+    failTimes(&policy, 100);
+
+    ///assert
+    ASSERT_IS_TRUE(policy.delayInMs <= value);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_010: [If policy is NULL then IoTHubClient_RetryPolicy_OnSuccess shall do nothing.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_OnSuccess_with_NULL_policy_does_nothing)
+{
+    ///arrange
+
+    ///act
+    IoTHubClient_RetryPolicy_OnSuccess(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_011: [IoTHubClient_RetryPolicy_OnSuccess shall forget the failures counted so far and stop waiting.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_OnSuccess_resets_the_backoff)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    size_t expectedDelay;
+    IoTHubClient_RetryPolicy_Init(&policy);
+    failTimes(&policy, 5);
+
+    ///act
+    IoTHubClient_RetryPolicy_OnSuccess(&policy);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, policy.failureCount);
+    ASSERT_IS_FALSE(IoTHubClient_RetryPolicy_IsWaiting(&policy));
+    ASSERT_IS_TRUE(IoTHubClient_RetryPolicy_CanAttempt(&policy, 0));
+
+    /*the next failure is capped by the initial delay again*/
+    expectedDelay = peekJitteredDelay(&policy, IOTHUB_CLIENT_RETRY_POLICY_DEFAULT_INITIAL_DELAY);
+    IoTHubClient_RetryPolicy_OnFailure(&policy);
+    ASSERT_ARE_EQUAL(size_t, expectedDelay, policy.delayInMs);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_012: [If policy is NULL then IoTHubClient_RetryPolicy_IsWaiting shall return false.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_IsWaiting_with_NULL_policy_returns_false)
+{
+    ///arrange
+
+    ///act
+    bool result = IoTHubClient_RetryPolicy_IsWaiting(NULL);
+
+    ///assert
+    ASSERT_IS_FALSE(result);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_014: [If policy is NULL then IoTHubClient_RetryPolicy_CanAttempt shall return false.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_CanAttempt_with_NULL_policy_returns_false)
+{
+    ///arrange
+
+    ///act
+    bool result = IoTHubClient_RetryPolicy_CanAttempt(NULL, 0);
+
+    ///assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_013: [Otherwise IoTHubClient_RetryPolicy_IsWaiting shall return true if the delay drawn for the last failure has not elapsed yet and false otherwise.]*/
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_016: [The first call to IoTHubClient_RetryPolicy_CanAttempt after a failure shall start the wait at currentTimeInMs. If currentTimeInMs is before the start of the wait then the wait shall start again at currentTimeInMs.]*/
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_017: [IoTHubClient_RetryPolicy_CanAttempt shall return true and stop waiting when the delay has elapsed since the start of the wait, and false otherwise.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_CanAttempt_returns_true_once_the_delay_has_elapsed)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    size_t value = 5000;
+    IoTHubClient_RetryPolicy_Init(&policy);
+    (void)IoTHubClient_RetryPolicy_SetOption(&policy, OPTION_RETRY_INITIAL_DELAY, &value);
+    do
+    {
+        IoTHubClient_RetryPolicy_OnFailure(&policy);
+    } while (policy.delayInMs < 2);
+
+    ///act
+    bool result1 = IoTHubClient_RetryPolicy_CanAttempt(&policy, 1000);
+    bool result2 = IoTHubClient_RetryPolicy_CanAttempt(&policy, 1000 + policy.delayInMs - 1);
+    bool waiting = IoTHubClient_RetryPolicy_IsWaiting(&policy);
+    bool result3 = IoTHubClient_RetryPolicy_CanAttempt(&policy, 1000 + policy.delayInMs);
+
+    ///assert
+    ASSERT_IS_FALSE(result1);
+    ASSERT_IS_FALSE(result2);
+    ASSERT_IS_TRUE(waiting);
+    ASSERT_IS_TRUE(result3);
+    ASSERT_IS_FALSE(IoTHubClient_RetryPolicy_IsWaiting(&policy));
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_016: [The first call to IoTHubClient_RetryPolicy_CanAttempt after a failure shall start the wait at currentTimeInMs. If currentTimeInMs is before the start of the wait then the wait shall start again at currentTimeInMs.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_CanAttempt_starts_the_wait_again_when_the_time_goes_back)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    IoTHubClient_RetryPolicy_Init(&policy);
+    do
+    {
+        IoTHubClient_RetryPolicy_OnFailure(&policy);
+    } while (policy.delayInMs < 2);
+    (void)IoTHubClient_RetryPolicy_CanAttempt(&policy, 100000);
+
+    ///act
+    bool result1 = IoTHubClient_RetryPolicy_CanAttempt(&policy, 10);
+    bool result2 = IoTHubClient_RetryPolicy_CanAttempt(&policy, 10 + policy.delayInMs);
+
+    ///assert
+    ASSERT_IS_FALSE(result1);
+    ASSERT_IS_TRUE(result2);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_021: [When it starts a wait, IoTHubClient_RetryPolicy_CanAttempt shall mix currentTimeInMs into the random generator of the policy for the next delays.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_CanAttempt_mixes_the_start_of_the_wait_into_the_next_delays)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy1;
+    IOTHUB_CLIENT_RETRY_POLICY policy2;
+    IoTHubClient_RetryPolicy_Init(&policy1);
+    do
+    {
+        IoTHubClient_RetryPolicy_OnFailure(&policy1);
+    } while (policy1.delayInMs == 0);
+    policy2 = policy1;
+
+    ///act
+    (void)IoTHubClient_RetryPolicy_CanAttempt(&policy1, 1000);
+    (void)IoTHubClient_RetryPolicy_CanAttempt(&policy1, 1001);
+    (void)IoTHubClient_RetryPolicy_CanAttempt(&policy2, 2000);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(uint64_t, policy1.randomState, policy2.randomState);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_RETRY_POLICY_10_015: [If the policy is not waiting then IoTHubClient_RetryPolicy_CanAttempt shall return true.]*/
+TEST_FUNCTION(IoTHubClient_RetryPolicy_CanAttempt_without_a_failure_returns_true)
+{
+    ///arrange
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    IoTHubClient_RetryPolicy_Init(&policy);
+
+    ///act
+    bool result = IoTHubClient_RetryPolicy_CanAttempt(&policy, 0);
+
+    ///assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothubclient_retry_policy_ut)
@@ -17,8 +17,10 @@
 #include "iothub_client_ll.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/list.h"
 #include "iothubtransport.h"
+#include "iothub_client_handoff.h"
 
 extern "C" int gballoc_init(void);
 extern "C" void gballoc_deinit(void);
@@ -52,16 +54,22 @@ static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
 #define TEST_IOTHUBNAME "theNameoftheIotHub"
 #define TEST_IOTHUBSUFFIX "theSuffixoftheIotHubHostname"
 #define TEST_DEVICEMESSAGE_HANDLE (IOTHUB_MESSAGE_HANDLE)0x52
+static const IOTHUB_MESSAGE_HANDLE TEST_BATCH[2] = { (IOTHUB_MESSAGE_HANDLE)0x52, (IOTHUB_MESSAGE_HANDLE)0x53 };
 #define TEST_THREAD_HANDLE (THREAD_HANDLE)0x4442
 #define TEST_LOCK_HANDLE (LOCK_HANDLE)0x4443
+#define TEST_COND_HANDLE (COND_HANDLE)0x4444
+#define TEST_HANDOFF_HANDLE (IOTHUB_CLIENT_HANDOFF_HANDLE)0x4445
+#define TEST_CLONED_MESSAGE_HANDLE (IOTHUB_MESSAGE_HANDLE)0x62
 static const char* TEST_CHAR = "TestChar";
 
 static size_t howManyDoWorkCalls = 0;
 static size_t doWorkCallCount = 0;
+static IOTHUB_CLIENT_STATUS currentSendStatus;
 static THREAD_START_FUNC threadFunc;
 static void* threadFuncArg;
 static const TRANSPORT_PROVIDER* provideFAKE(void);
 extern "C" const size_t IoTHubClient_ThreadTerminationOffset;
+extern "C" const size_t IoTHubClient_DispatchTerminationOffset;
 
 static const IOTHUB_CLIENT_CONFIG TEST_CONFIG =
 {
@@ -78,6 +86,7 @@ static IOTHUB_CLIENT_HANDLE current_iothub_client;
 
 #define TEST_IOTHUB_CLIENT_LL_HANDLE    (IOTHUB_CLIENT_LL_HANDLE)0x4242
 #define TEST_IOTHUBTRANSPORT_HANDLE (TRANSPORT_HANDLE)0xDEAD
+#define TEST_TRANSPORT_POOL_HANDLE (TRANSPORT_POOL_HANDLE)0xDEAE
 #define TEST_IOTHUBTRANSPORT_LOCK (TRANSPORT_HANDLE)0xDEAF
 #define TEST_IOTHUBTRANSPORT_LL (TRANSPORT_HANDLE)0xDEDE
 #define TEST_LIST_HANDLE				(LIST_HANDLE)0x4246
@@ -88,6 +97,16 @@ typedef struct TEST_LIST_ITEM_TAG
 
 static TEST_LIST_ITEM** list_items = NULL;
 static size_t list_item_count = 0;
+
+static IOTHUB_CLIENT_HANDOFF_ITEM* handoffHead; /*the items pushed to the handoff, newest first*/
+static IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK llEventConfirmationCallback; /*the last confirmation callback given to IoTHubClient_LL*/
+static void* llEventConfirmationContext;
+static IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC llMessageCallback; /*the last message callback given to IoTHubClient_LL*/
+static void* llMessageCallbackContext;
+static bool stopDispatchThreadOnWait;
+static IOTHUB_CLIENT_LL_SEND_QUEUE_ROOM_CALLBACK sendQueueRoomCallback;
+static void* sendQueueRoomContext;
+static bool makeRoomInSendQueueOnWait;
 TYPED_MOCK_CLASS(CIoTHubClientMocks, CGlobalMock)
 {
 public:
@@ -102,19 +121,76 @@ public:
     MOCK_STATIC_METHOD_1(, void, IoTHubClient_LL_Destroy, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
     MOCK_VOID_METHOD_END();
     MOCK_STATIC_METHOD_4(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventAsync, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback)
+        llEventConfirmationCallback = eventConfirmationCallback;
+        llEventConfirmationContext = userContextCallback;
+    MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK);
+    MOCK_STATIC_METHOD_4(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventAsync_TakeOwnership, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback)
+    MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK);
+    MOCK_STATIC_METHOD_6(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventBatchAsync, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE*, eventMessageHandles, size_t, eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION, batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback)
+        llEventConfirmationCallback = eventConfirmationCallback;
+        llEventConfirmationContext = userContextCallback;
+    MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK);
+    MOCK_STATIC_METHOD_6(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventBatchAsync_TakeOwnership, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE*, eventMessageHandles, size_t, eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION, batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback)
     MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK);
     MOCK_STATIC_METHOD_3(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetMessageCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC, messageCallback, void*, userContextCallback)
+        llMessageCallback = messageCallback;
+        llMessageCallbackContext = userContextCallback;
     MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK);
     MOCK_STATIC_METHOD_1(, void, IoTHubClient_LL_DoWork, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle)
         doWorkCallCount++;
     MOCK_VOID_METHOD_END();
     MOCK_STATIC_METHOD_2(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetSendStatus, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus)
+        if (iotHubClientStatus != NULL)
+        {
+            *iotHubClientStatus = currentSendStatus;
+        }
     MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK);
     MOCK_STATIC_METHOD_2(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetLastMessageReceiveTime, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, time_t*, lastMessageReceiveTime)
     MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK);
+    MOCK_STATIC_METHOD_2(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetPoolStatistics, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_POOL_STATISTICS*, poolStatistics)
+    MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK);
+    MOCK_STATIC_METHOD_2(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetStatistics, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATISTICS*, statistics)
+    MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK);
 
     MOCK_STATIC_METHOD_3(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetOption, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, optionName, const void*, value)
     MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK);
+    MOCK_STATIC_METHOD_3(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetSendQueueCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_SEND_QUEUE_CALLBACK, sendQueueCallback, void*, userContextCallback)
+    MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK);
+    MOCK_STATIC_METHOD_1(, bool, IoTHubClient_LL_WasSendQueueFull, IOTHUB_CLIENT_LL_HANDLE, handle)
+    MOCK_METHOD_END(bool, false);
+    MOCK_STATIC_METHOD_3(, void, IoTHubClient_LL_SetSendQueueRoomCallback, IOTHUB_CLIENT_LL_HANDLE, handle, IOTHUB_CLIENT_LL_SEND_QUEUE_ROOM_CALLBACK, callback, void*, context)
+        sendQueueRoomCallback = callback;
+        sendQueueRoomContext = context;
+    MOCK_VOID_METHOD_END();
+
+    /* IoTHubMessage mocks */
+    MOCK_STATIC_METHOD_1(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_Clone, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle)
+    MOCK_METHOD_END(IOTHUB_MESSAGE_HANDLE, TEST_CLONED_MESSAGE_HANDLE);
+    MOCK_STATIC_METHOD_1(, void, IoTHubMessage_Destroy, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle)
+    MOCK_VOID_METHOD_END();
+
+    /* IoTHubClient_Handoff mocks */
+    MOCK_STATIC_METHOD_0(, IOTHUB_CLIENT_HANDOFF_HANDLE, IoTHubClient_Handoff_Create)
+    MOCK_METHOD_END(IOTHUB_CLIENT_HANDOFF_HANDLE, TEST_HANDOFF_HANDLE);
+    MOCK_STATIC_METHOD_2(, bool, IoTHubClient_Handoff_Push, IOTHUB_CLIENT_HANDOFF_HANDLE, handle, IOTHUB_CLIENT_HANDOFF_ITEM*, item)
+        bool wasEmpty = (handoffHead == NULL);
+        item->next = handoffHead;
+        handoffHead = item;
+    MOCK_METHOD_END(bool, wasEmpty);
+    MOCK_STATIC_METHOD_1(, IOTHUB_CLIENT_HANDOFF_ITEM*, IoTHubClient_Handoff_TakeAll, IOTHUB_CLIENT_HANDOFF_HANDLE, handle)
+        IOTHUB_CLIENT_HANDOFF_ITEM* oldestFirst = NULL;
+        while (handoffHead != NULL)
+        {
+            IOTHUB_CLIENT_HANDOFF_ITEM* next = handoffHead->next;
+            handoffHead->next = oldestFirst;
+            oldestFirst = handoffHead;
+            handoffHead = next;
+        }
+    MOCK_METHOD_END(IOTHUB_CLIENT_HANDOFF_ITEM*, oldestFirst);
+    MOCK_STATIC_METHOD_1(, bool, IoTHubClient_Handoff_IsEmpty, IOTHUB_CLIENT_HANDOFF_HANDLE, handle)
+    MOCK_METHOD_END(bool, (handoffHead == NULL));
+    MOCK_STATIC_METHOD_1(, void, IoTHubClient_Handoff_Destroy, IOTHUB_CLIENT_HANDOFF_HANDLE, handle)
+    MOCK_VOID_METHOD_END();
 
     /* ThreadAPI mocks */
     MOCK_STATIC_METHOD_3(, THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
@@ -143,6 +219,28 @@ public:
     MOCK_STATIC_METHOD_1(, LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle);
     MOCK_METHOD_END(LOCK_RESULT, LOCK_OK);
 
+    /* Condition mocks */
+    MOCK_STATIC_METHOD_0(, COND_HANDLE, Condition_Init);
+    MOCK_METHOD_END(COND_HANDLE, TEST_COND_HANDLE);
+    MOCK_STATIC_METHOD_1(, COND_RESULT, Condition_Post, COND_HANDLE, handle);
+    MOCK_METHOD_END(COND_RESULT, COND_OK);
+    MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
+        if ((howManyDoWorkCalls > 0) && (howManyDoWorkCalls == doWorkCallCount))
+        {
+            *(sig_atomic_t*)(((char*)threadFuncArg) + IoTHubClient_ThreadTerminationOffset) = 1; /*tell the thread to stop*/
+        }
+        if (makeRoomInSendQueueOnWait)
+        {
+            sendQueueRoomCallback(sendQueueRoomContext); /*a message completes while the caller waits*/
+        }
+        if (stopDispatchThreadOnWait)
+        {
+            *(sig_atomic_t*)(((char*)threadFuncArg) + IoTHubClient_DispatchTerminationOffset) = 1; /*tell the dispatch thread to stop*/
+        }
+    MOCK_METHOD_END(COND_RESULT, COND_TIMEOUT);
+    MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle);
+    MOCK_VOID_METHOD_END();
+
     /* gballoc mocks */
     MOCK_STATIC_METHOD_1(, void*, gballoc_malloc, size_t, size)
         void* result2;
@@ -177,6 +275,9 @@ public:
     MOCK_STATIC_METHOD_2(, IOTHUBMESSAGE_DISPOSITION_RESULT, messageCallback, IOTHUB_MESSAGE_HANDLE, message, void*, userContextCallback)
     MOCK_METHOD_END(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_ACCEPTED);
 
+    MOCK_STATIC_METHOD_2(, void, sendQueueCallback, IOTHUB_CLIENT_SEND_QUEUE_WATERMARK, watermark, void*, userContextCallback)
+    MOCK_VOID_METHOD_END()
+
 	/* TRANSPORT mocks*/
 
     MOCK_STATIC_METHOD_1(, LOCK_HANDLE, IoTHubTransport_GetLock, TRANSPORT_HANDLE, transportHlHandle)
@@ -194,6 +295,15 @@ public:
     MOCK_STATIC_METHOD_2(, void, IoTHubTransport_JoinWorkerThread, TRANSPORT_HANDLE, transportHlHandle, IOTHUB_CLIENT_HANDLE, clientHandle)
     MOCK_VOID_METHOD_END()
 
+    MOCK_STATIC_METHOD_2(, IOTHUB_CLIENT_RESULT, IoTHubTransport_SetWorkerIdleWaitTime, TRANSPORT_HANDLE, transportHlHandle, unsigned int, idleWaitTime)
+    MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK)
+
+    MOCK_STATIC_METHOD_1(, void, IoTHubTransport_SignalWorkerThread, TRANSPORT_HANDLE, transportHlHandle)
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, TRANSPORT_HANDLE, IoTHubTransport_GetPoolTransport, TRANSPORT_POOL_HANDLE, poolHandle, const char*, deviceId)
+    MOCK_METHOD_END(TRANSPORT_HANDLE, TEST_IOTHUBTRANSPORT_HANDLE)
+
     MOCK_STATIC_METHOD_2(, int, mallocAndStrcpy_s, char**, destination, const char*, source)
         int result2;
         if ((destination == NULL) || (source == NULL))
@@ -307,11 +417,28 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , IOTHUB_CLIENT_LL_HANDLE, IoTH
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , void, IoTHubClient_LL_Destroy, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
 DECLARE_GLOBAL_MOCK_METHOD_4(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventAsync, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback)
+DECLARE_GLOBAL_MOCK_METHOD_4(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventAsync_TakeOwnership, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback)
+DECLARE_GLOBAL_MOCK_METHOD_6(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventBatchAsync, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE*, eventMessageHandles, size_t, eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION, batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback)
+DECLARE_GLOBAL_MOCK_METHOD_6(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventBatchAsync_TakeOwnership, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE*, eventMessageHandles, size_t, eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION, batchConfirmation, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback)
 DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetMessageCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC, messageCallback, void*, userContextCallback)
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , void, IoTHubClient_LL_DoWork, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle)
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetSendStatus, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus)
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetLastMessageReceiveTime, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, time_t*, lastMessageReceiveTime)
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetPoolStatistics, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_POOL_STATISTICS*, poolStatistics)
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetStatistics, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATISTICS*, statistics)
 DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetOption, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, optionName, const void*, value)
+DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetSendQueueCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_SEND_QUEUE_CALLBACK, sendQueueCallback, void*, userContextCallback)
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , bool, IoTHubClient_LL_WasSendQueueFull, IOTHUB_CLIENT_LL_HANDLE, handle)
+DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubClientMocks, , void, IoTHubClient_LL_SetSendQueueRoomCallback, IOTHUB_CLIENT_LL_HANDLE, handle, IOTHUB_CLIENT_LL_SEND_QUEUE_ROOM_CALLBACK, callback, void*, context)
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , IOTHUB_MESSAGE_HANDLE, IoTHubMessage_Clone, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , void, IoTHubMessage_Destroy, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+
+DECLARE_GLOBAL_MOCK_METHOD_0(CIoTHubClientMocks, , IOTHUB_CLIENT_HANDOFF_HANDLE, IoTHubClient_Handoff_Create);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , bool, IoTHubClient_Handoff_Push, IOTHUB_CLIENT_HANDOFF_HANDLE, handle, IOTHUB_CLIENT_HANDOFF_ITEM*, item);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , IOTHUB_CLIENT_HANDOFF_ITEM*, IoTHubClient_Handoff_TakeAll, IOTHUB_CLIENT_HANDOFF_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , bool, IoTHubClient_Handoff_IsEmpty, IOTHUB_CLIENT_HANDOFF_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , void, IoTHubClient_Handoff_Destroy, IOTHUB_CLIENT_HANDOFF_HANDLE, handle);
 
 DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubClientMocks, , THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res);
@@ -323,18 +450,27 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , LOCK_RESULT, Lock, LOCK_HANDL
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle);
 
+DECLARE_GLOBAL_MOCK_METHOD_0(CIoTHubClientMocks, , COND_HANDLE, Condition_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubClientMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , void, Condition_Deinit, COND_HANDLE, handle);
+
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , void*, gballoc_malloc, size_t, size);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , void*, gballoc_realloc, void*, ptr, size_t, size);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , void, gballoc_free, void*, ptr)
 
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , void, eventConfirmationCallback, IOTHUB_CLIENT_CONFIRMATION_RESULT, result2, void*, userContextCallback);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , IOTHUBMESSAGE_DISPOSITION_RESULT, messageCallback, IOTHUB_MESSAGE_HANDLE, message, void*, userContextCallback);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , void, sendQueueCallback, IOTHUB_CLIENT_SEND_QUEUE_WATERMARK, watermark, void*, userContextCallback);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , LOCK_HANDLE, IoTHubTransport_GetLock, TRANSPORT_HANDLE, transportHlHandle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , TRANSPORT_LL_HANDLE, IoTHubTransport_GetLLTransport, TRANSPORT_HANDLE, transportHlHandle);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubTransport_StartWorkerThread, TRANSPORT_HANDLE, transportHlHandle, IOTHUB_CLIENT_HANDLE, clientHandle);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , bool, IoTHubTransport_SignalEndWorkerThread, TRANSPORT_HANDLE, transportHlHandle, IOTHUB_CLIENT_HANDLE, clientHandle);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , void, IoTHubTransport_JoinWorkerThread, TRANSPORT_HANDLE, transportHlHandle, IOTHUB_CLIENT_HANDLE, clientHandle);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , IOTHUB_CLIENT_RESULT, IoTHubTransport_SetWorkerIdleWaitTime, TRANSPORT_HANDLE, transportHlHandle, unsigned int, idleWaitTime);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubClientMocks, , void, IoTHubTransport_SignalWorkerThread, TRANSPORT_HANDLE, transportHlHandle);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , TRANSPORT_HANDLE, IoTHubTransport_GetPoolTransport, TRANSPORT_POOL_HANDLE, poolHandle, const char*, deviceId);
 
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubClientMocks, , int, mallocAndStrcpy_s, char**, destination, const char*, source);
 
@@ -382,8 +518,18 @@ BEGIN_TEST_SUITE(iothubclient_ut)
         whenShallmalloc_fail = 0;
         howManyDoWorkCalls = 0;
         doWorkCallCount = 0;
+        currentSendStatus = IOTHUB_CLIENT_SEND_STATUS_IDLE;
 		threadFunc = NULL;
 		threadFuncArg = NULL;
+        handoffHead = NULL;
+        llEventConfirmationCallback = NULL;
+        llEventConfirmationContext = NULL;
+        llMessageCallback = NULL;
+        llMessageCallbackContext = NULL;
+        stopDispatchThreadOnWait = false;
+        sendQueueRoomCallback = NULL;
+        sendQueueRoomContext = NULL;
+        makeRoomInSendQueueOnWait = false;
     }
 
     TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -696,6 +842,85 @@ BEGIN_TEST_SUITE(iothubclient_ut)
 		IoTHubClient_Destroy(iotHubClient);
 	}
 
+	/*Tests_SRS_IOTHUBCLIENT_10_056: [ If poolHandle or config is NULL, IoTHubClient_CreateWithTransportPool shall return NULL. ]*/
+	TEST_FUNCTION(When_creating_with_transport_pool_null_pool_returns_null)
+	{
+		// arrange
+		CIoTHubClientMocks mocks;
+
+		// act
+		IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_CreateWithTransportPool(NULL, &TEST_CONFIG);
+
+		// assert
+		ASSERT_IS_NULL(iotHubClient);
+		mocks.AssertActualAndExpectedCalls();
+	}
+
+	/*Tests_SRS_IOTHUBCLIENT_10_056: [ If poolHandle or config is NULL, IoTHubClient_CreateWithTransportPool shall return NULL. ]*/
+	TEST_FUNCTION(When_creating_with_transport_pool_null_config_returns_null)
+	{
+		// arrange
+		CIoTHubClientMocks mocks;
+
+		// act
+		IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_CreateWithTransportPool(TEST_TRANSPORT_POOL_HANDLE, NULL);
+
+		// assert
+		ASSERT_IS_NULL(iotHubClient);
+		mocks.AssertActualAndExpectedCalls();
+	}
+
+	/*Tests_SRS_IOTHUBCLIENT_10_058: [ If IoTHubTransport_GetPoolTransport fails, IoTHubClient_CreateWithTransportPool shall return NULL. ]*/
+	TEST_FUNCTION(When_creating_with_transport_pool_GetPoolTransport_fails_returns_null)
+	{
+		// arrange
+		CIoTHubClientMocks mocks;
+
+		STRICT_EXPECTED_CALL(mocks, IoTHubTransport_GetPoolTransport(TEST_TRANSPORT_POOL_HANDLE, TEST_CONFIG.deviceId))
+			.SetReturn((TRANSPORT_HANDLE)NULL);
+
+		// act
+		IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_CreateWithTransportPool(TEST_TRANSPORT_POOL_HANDLE, &TEST_CONFIG);
+
+		// assert
+		ASSERT_IS_NULL(iotHubClient);
+		mocks.AssertActualAndExpectedCalls();
+	}
+
+	/*Tests_SRS_IOTHUBCLIENT_10_057: [ IoTHubClient_CreateWithTransportPool shall pick the transport of the device by calling IoTHubTransport_GetPoolTransport with config's deviceId. ]*/
+	/*Tests_SRS_IOTHUBCLIENT_10_059: [ IoTHubClient_CreateWithTransportPool shall return the result of IoTHubClient_CreateWithTransport called with that transport and config. ]*/
+	TEST_FUNCTION(When_creating_with_transport_pool_success_creates_with_the_device_transport)
+	{
+		// arrange
+		CIoTHubClientMocks mocks;
+
+		STRICT_EXPECTED_CALL(mocks, IoTHubTransport_GetPoolTransport(TEST_TRANSPORT_POOL_HANDLE, TEST_CONFIG.deviceId));
+
+		STRICT_EXPECTED_CALL(mocks, Lock(TEST_IOTHUBTRANSPORT_LOCK));
+		STRICT_EXPECTED_CALL(mocks, Unlock(TEST_IOTHUBTRANSPORT_LOCK));
+
+		EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+
+#ifndef DONT_USE_UPLOADTOBLOB
+		STRICT_EXPECTED_CALL(mocks, list_create()); /*this is the list of SAVED_DATA*/
+#endif
+
+		STRICT_EXPECTED_CALL(mocks, IoTHubTransport_GetLock(TEST_IOTHUBTRANSPORT_HANDLE));
+		STRICT_EXPECTED_CALL(mocks, IoTHubTransport_GetLLTransport(TEST_IOTHUBTRANSPORT_HANDLE));
+		STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_CreateWithTransport(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+
+		// act
+		IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_CreateWithTransportPool(TEST_TRANSPORT_POOL_HANDLE, &TEST_CONFIG);
+
+		// assert
+		ASSERT_IS_NOT_NULL(iotHubClient);
+		mocks.AssertActualAndExpectedCalls();
+
+		///cleanup
+		IoTHubClient_Destroy(iotHubClient);
+	}
+
 	TEST_FUNCTION(When_creating_with_transport_Unlock_fails_non_null)
 	{
 		// arrange
@@ -904,6 +1129,7 @@ BEGIN_TEST_SUITE(iothubclient_ut)
 			.IgnoreArgument(1);
 		STRICT_EXPECTED_CALL(mocks, IoTHubTransport_StartWorkerThread(TEST_IOTHUBTRANSPORT_HANDLE, iotHubClient));
 		STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42));
+		STRICT_EXPECTED_CALL(mocks, IoTHubTransport_SignalWorkerThread(TEST_IOTHUBTRANSPORT_HANDLE));
 
 		// act
 		auto result = IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
@@ -932,6 +1158,7 @@ BEGIN_TEST_SUITE(iothubclient_ut)
 			.IgnoreArgument(1);
 		STRICT_EXPECTED_CALL(mocks, IoTHubTransport_StartWorkerThread(TEST_IOTHUBTRANSPORT_HANDLE, iotHubClient));
 		STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetMessageCallback(TEST_IOTHUB_CLIENT_LL_HANDLE, messageCallback, (void*)0x42));
+		STRICT_EXPECTED_CALL(mocks, IoTHubTransport_SignalWorkerThread(TEST_IOTHUBTRANSPORT_HANDLE));
 
 		// act
 		auto result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
@@ -1400,12 +1627,25 @@ BEGIN_TEST_SUITE(iothubclient_ut)
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* IoTHubClient_SetMessageCallback */
+    /* IoTHubClient_SendEventAsync_TakeOwnership */
 
-    /* Tests_SRS_IOTHUBCLIENT_01_014: [IoTHubClient_SetMessageCallback shall start the worker thread if it was not previously started.] */
-    /* Tests_SRS_IOTHUBCLIENT_01_017: [IoTHubClient_SetMessageCallback shall call IoTHubClient_LL_SetMessageCallback, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameters messageCallback and userContextCallback.] */
-    /* Tests_SRS_IOTHUBCLIENT_01_027: [IoTHubClient_SetMessageCallback shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
-    TEST_FUNCTION(IoTHubClient_SetMessageCallback_starts_the_worker_thread_and_calls_the_underlayer)
+    /* Tests_SRS_IOTHUBCLIENT_10_001: [If iotHubClientHandle is NULL, IoTHubClient_SendEventAsync_TakeOwnership shall return IOTHUB_CLIENT_INVALID_ARG.] */
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_TakeOwnership_With_NULL_Handle_Fails)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync_TakeOwnership(NULL, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+    }
+
+    /* Tests_SRS_IOTHUBCLIENT_10_002: [IoTHubClient_SendEventAsync_TakeOwnership shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
+    /* Tests_SRS_IOTHUBCLIENT_10_004: [IoTHubClient_SendEventAsync_TakeOwnership shall start the worker thread if it was not previously started.] */
+    /* Tests_SRS_IOTHUBCLIENT_10_006: [IoTHubClient_SendEventAsync_TakeOwnership shall call IoTHubClient_LL_SendEventAsync_TakeOwnership, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameters eventMessageHandle, eventConfirmationCallback and userContextCallback, and shall return its result.] */
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_TakeOwnership_starts_the_worker_thread_and_calls_the_underlayer)
     {
         // arrange
         CIoTHubClientMocks mocks;
@@ -1414,11 +1654,11 @@ BEGIN_TEST_SUITE(iothubclient_ut)
 
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
         EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetMessageCallback(TEST_IOTHUB_CLIENT_LL_HANDLE, messageCallback, (void*)0x42));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42));
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync_TakeOwnership(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
 
         // assert
         ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
@@ -1428,8 +1668,8 @@ BEGIN_TEST_SUITE(iothubclient_ut)
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_015: [If starting the thread fails, IoTHubClient_SetMessageCallback shall return IOTHUB_CLIENT_ERROR.] */
-    TEST_FUNCTION(When_Thread_API_Create_fails_then_IoTHubClient_SetMessageCallback_fails)
+    /* Tests_SRS_IOTHUBCLIENT_10_006: [IoTHubClient_SendEventAsync_TakeOwnership shall call IoTHubClient_LL_SendEventAsync_TakeOwnership, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameters eventMessageHandle, eventConfirmationCallback and userContextCallback, and shall return its result.] */
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_TakeOwnership_Returns_The_Error_Code_From_The_Underlayer)
     {
         // arrange
         CIoTHubClientMocks mocks;
@@ -1437,12 +1677,13 @@ BEGIN_TEST_SUITE(iothubclient_ut)
         mocks.ResetAllCalls();
 
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .SetReturn(THREADAPI_ERROR);
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync_TakeOwnership(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
 
         // assert
         ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_ERROR);
@@ -1452,59 +1693,85 @@ BEGIN_TEST_SUITE(iothubclient_ut)
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_016: [If iotHubClientHandle is NULL, IoTHubClient_SetMessageCallback shall return IOTHUB_CLIENT_INVALID_ARG.] */
-    TEST_FUNCTION(IoTHubClient_SetMessageCallback_with_NULL_handle_fails)
+    /* Tests_SRS_IOTHUBCLIENT_10_005: [If starting the thread fails, IoTHubClient_SendEventAsync_TakeOwnership shall return IOTHUB_CLIENT_ERROR.] */
+    TEST_FUNCTION(When_Starting_The_Worker_Thread_Fails_Then_IoTHubClient_SendEventAsync_TakeOwnership_Fails)
     {
         // arrange
         CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .SetReturn(THREADAPI_ERROR);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(NULL, messageCallback, (void*)0x42);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync_TakeOwnership(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
 
         // assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_ERROR);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_018: [When IoTHubClient_LL_SetMessageCallback is called, IoTHubClient_SetMessageCallback shall return the result of IoTHubClient_LL_SetMessageCallback.] */
-    TEST_FUNCTION(IoTHubClient_SetMessageCallback_returns_the_result_of_calling_IoTHubClient_LL_SetMessageCallback)
+    /* Tests_SRS_IOTHUBCLIENT_10_003: [If acquiring the lock fails, IoTHubClient_SendEventAsync_TakeOwnership shall return IOTHUB_CLIENT_ERROR.] */
+    TEST_FUNCTION(When_Acquiring_The_lock_fails_then_IoTHubClient_SendEventAsync_TakeOwnership_fails)
     {
         // arrange
         CIoTHubClientMocks mocks;
         IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetMessageCallback(TEST_IOTHUB_CLIENT_LL_HANDLE, messageCallback, (void*)0x42))
-            .SetReturn(IOTHUB_CLIENT_INVALID_SIZE);
-        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+            .SetReturn(LOCK_ERROR);
 
         // act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync_TakeOwnership(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
 
         // assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_SIZE);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_ERROR);
         mocks.AssertActualAndExpectedCalls();
 
         // cleanup
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_014: [IoTHubClient_SetMessageCallback shall start the worker thread if it was not previously started.] */
-    TEST_FUNCTION(When_the_worker_thread_was_started_by_a_SendEventAsync_A_Call_To_SetMessageCallback_Does_NOt_Start_A_New_Thread)
+    /* IoTHubClient_SendEventBatchAsync */
+
+    /*Tests_SRS_IOTHUBCLIENT_10_024: [ If iotHubClientHandle is NULL, IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventBatchAsync_With_NULL_Handle_Fails)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventBatchAsync(NULL, TEST_BATCH, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE, eventConfirmationCallback, (void*)0x42);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_025: [ IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall acquire the lock created in IoTHubClient_Create once for the whole batch. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_027: [ IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall start the worker thread if it was not previously started. If that fails they shall return IOTHUB_CLIENT_ERROR. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_028: [ IoTHubClient_SendEventBatchAsync shall call IoTHubClient_LL_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall call IoTHubClient_LL_SendEventBatchAsync_TakeOwnership, passing all their parameters, and shall return its result. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventBatchAsync_locks_once_and_calls_the_underlayer)
     {
         // arrange
         CIoTHubClientMocks mocks;
         IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
-        (void)IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
         mocks.ResetAllCalls();
 
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetMessageCallback(TEST_IOTHUB_CLIENT_LL_HANDLE, messageCallback, (void*)0x42));
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventBatchAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_BATCH, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE, eventConfirmationCallback, (void*)0x42));
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventBatchAsync(iotHubClient, TEST_BATCH, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE, eventConfirmationCallback, (void*)0x42);
 
         // assert
         ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
@@ -1514,167 +1781,205 @@ BEGIN_TEST_SUITE(iothubclient_ut)
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_014: [IoTHubClient_SetMessageCallback shall start the worker thread if it was not previously started.] */
-    TEST_FUNCTION(When_the_worker_thread_was_started_by_a_previous_SetMessageCallback_A_Call_To_SetMessageCallback_Does_Not_Start_A_New_Thread)
+    /*Tests_SRS_IOTHUBCLIENT_10_028: [ IoTHubClient_SendEventBatchAsync shall call IoTHubClient_LL_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall call IoTHubClient_LL_SendEventBatchAsync_TakeOwnership, passing all their parameters, and shall return its result. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventBatchAsync_TakeOwnership_calls_the_underlayer)
     {
         // arrange
         CIoTHubClientMocks mocks;
         IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
-        (void)IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
         mocks.ResetAllCalls();
 
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetMessageCallback(TEST_IOTHUB_CLIENT_LL_HANDLE, messageCallback, (void*)0x42));
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventBatchAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_BATCH, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)0x42))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventBatchAsync_TakeOwnership(iotHubClient, TEST_BATCH, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)0x42);
 
         // assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
         mocks.AssertActualAndExpectedCalls();
 
         // cleanup
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_028: [If acquiring the lock fails, IoTHubClient_SetMessageCallback shall return IOTHUB_CLIENT_ERROR.] */
-    TEST_FUNCTION(When_Acquiring_The_Lock_Fails_Then_IoTHubClient_SetMessageCallback_Fails)
+    /*Tests_SRS_IOTHUBCLIENT_10_026: [ If acquiring the lock fails, IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(When_Acquiring_The_lock_fails_then_IoTHubClient_SendEventBatchAsync_fails)
     {
         // arrange
         CIoTHubClientMocks mocks;
         IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
-        (void)IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);;
         mocks.ResetAllCalls();
 
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
             .SetReturn(LOCK_ERROR);
 
         // act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventBatchAsync(iotHubClient, TEST_BATCH, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE, eventConfirmationCallback, (void*)0x42);
 
         // assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_ERROR);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
         mocks.AssertActualAndExpectedCalls();
 
         // cleanup
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* IoTHubClient_GetLastMessageReceiveTime */
-
-    /* Tests_SRS_IOTHUBCLIENT_01_019: [IoTHubClient_GetLastMessageReceiveTime shall call IoTHubClient_LL_GetLastMessageReceiveTime, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameter lastMessageReceiveTime.] */
-    /* Tests_SRS_IOTHUBCLIENT_01_035: [IoTHubClient_GetLastMessageReceiveTime shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
-    TEST_FUNCTION(IoTHubClient_GetLastMessageReceiveTime_Calls_the_Underlayer)
+    /*Tests_SRS_IOTHUBCLIENT_10_029: [ If "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK and the batch was refused because the send queue is full, the batch shall be submitted again once the worker thread makes room. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventBatchAsync_with_BLOCK_policy_waits_for_room_in_the_send_queue)
     {
         // arrange
         CIoTHubClientMocks mocks;
         IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+        (void)IoTHubClient_SetOption(iotHubClient, "sendQueueFullPolicy", &policy);
         mocks.ResetAllCalls();
 
-        time_t lastMessageReceiveTime;
-        time_t currentTime;
-        time(&currentTime);
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetLastMessageReceiveTime(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
-            .CopyOutArgumentBuffer(2, &currentTime, sizeof(currentTime));
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventBatchAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_BATCH, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE, eventConfirmationCallback, (void*)0x42))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_WasSendQueueFull(TEST_IOTHUB_CLIENT_LL_HANDLE))
+            .SetReturn(true);
+        STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 100));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventBatchAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_BATCH, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE, eventConfirmationCallback, (void*)0x42));
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetLastMessageReceiveTime(iotHubClient, &lastMessageReceiveTime);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventBatchAsync(iotHubClient, TEST_BATCH, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE, eventConfirmationCallback, (void*)0x42);
 
         // assert
         ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-        ASSERT_ARE_EQUAL(double, 0.0, difftime(currentTime, lastMessageReceiveTime));
         mocks.AssertActualAndExpectedCalls();
 
         // cleanup
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_020: [If iotHubClientHandle is NULL, IoTHubClient_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INVALID_ARG.] */
-    TEST_FUNCTION(IoTHubClient_GetLastMessageReceiveTime_with_NULL_handle_fails)
+    /*Tests_SRS_IOTHUBCLIENT_10_016: [ If "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK and IoTHubClient_LL_SendEventAsync fails because the send queue is full, IoTHubClient_SendEventAsync shall wait for the worker thread to make room and call IoTHubClient_LL_SendEventAsync again. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_019: [ When IoTHubClient_LL_SetOption accepts "sendQueueFullPolicy", IoTHubClient_SetOption shall remember whether the policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_067: [ Waiting for room in the send queue shall be done by calling Condition_Wait on the send queue condition with the lock for at most SEND_QUEUE_WAIT_TIME milliseconds. If Condition_Wait fails, the lock shall be released for 1 ms instead. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_BLOCK_policy_waits_for_room_in_the_send_queue)
     {
         // arrange
         CIoTHubClientMocks mocks;
-        time_t lastMessageReceiveTime;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+        (void)IoTHubClient_SetOption(iotHubClient, "sendQueueFullPolicy", &policy);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_WasSendQueueFull(TEST_IOTHUB_CLIENT_LL_HANDLE))
+            .SetReturn(true);
+        STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 100));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetLastMessageReceiveTime(NULL, &lastMessageReceiveTime);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
 
         // assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_021: [Otherwise, IoTHubClient_GetLastMessageReceiveTime shall return the result of IoTHubClient_LL_GetLastMessageReceiveTime.] */
-    TEST_FUNCTION(IoTHubClient_GetLastMessageReceiveTime_Returns_The_Result_Of_the_underlayer)
+    /*Tests_SRS_IOTHUBCLIENT_10_016: [ If "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK and IoTHubClient_LL_SendEventAsync fails because the send queue is full, IoTHubClient_SendEventAsync shall wait for the worker thread to make room and call IoTHubClient_LL_SendEventAsync again. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_BLOCK_policy_does_not_wait_when_the_send_queue_is_not_full)
     {
         // arrange
         CIoTHubClientMocks mocks;
         IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+        (void)IoTHubClient_SetOption(iotHubClient, "sendQueueFullPolicy", &policy);
         mocks.ResetAllCalls();
 
-        time_t lastMessageReceiveTime;
-        time_t currentTime;
-        time(&currentTime);
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetLastMessageReceiveTime(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .SetReturn(IOTHUB_CLIENT_INVALID_SIZE);
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_WasSendQueueFull(TEST_IOTHUB_CLIENT_LL_HANDLE));
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetLastMessageReceiveTime(iotHubClient, &lastMessageReceiveTime);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
 
         // assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_SIZE);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
         mocks.AssertActualAndExpectedCalls();
 
         // cleanup
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_036: [If acquiring the lock fails, IoTHubClient_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_ERROR.] */
-    TEST_FUNCTION(When_Accquiring_The_Lock_Fails_Then_IoTHubClient_GetLastMessageReceiveTime_fails)
+    /*Tests_SRS_IOTHUBCLIENT_10_017: [ If "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK and IoTHubClient_LL_SendEventAsync_TakeOwnership fails because the send queue is full, IoTHubClient_SendEventAsync_TakeOwnership shall wait for the worker thread to make room and call IoTHubClient_LL_SendEventAsync_TakeOwnership again. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_018: [ If acquiring the lock again fails, IoTHubClient_SendEventAsync and IoTHubClient_SendEventAsync_TakeOwnership shall return IOTHUB_CLIENT_ERROR. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_067: [ Waiting for room in the send queue shall be done by calling Condition_Wait on the send queue condition with the lock for at most SEND_QUEUE_WAIT_TIME milliseconds. If Condition_Wait fails, the lock shall be released for 1 ms instead. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_TakeOwnership_with_BLOCK_policy_fails_when_the_lock_cannot_be_acquired_again)
     {
         // arrange
         CIoTHubClientMocks mocks;
         IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+        (void)IoTHubClient_SetOption(iotHubClient, "sendQueueFullPolicy", &policy);
         mocks.ResetAllCalls();
 
-        time_t lastMessageReceiveTime;
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_WasSendQueueFull(TEST_IOTHUB_CLIENT_LL_HANDLE))
+            .SetReturn(true);
+        STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 100))
+            .SetReturn(COND_ERROR);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
             .SetReturn(LOCK_ERROR);
 
         // act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetLastMessageReceiveTime(iotHubClient, &lastMessageReceiveTime);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync_TakeOwnership(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
 
         // assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_ERROR);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
         mocks.AssertActualAndExpectedCalls();
 
         // cleanup
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    TEST_FUNCTION(When_unlock_fails_IoTHubClient_GetLastMessageReceiveTime_still_succeeds)
+    /*Tests_SRS_IOTHUBCLIENT_10_068: [ Every time IoTHubClient_LL calls the send queue room callback while a thread waits for room in the send queue, the send queue condition shall be signalled by calling Condition_Post. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_BLOCK_policy_is_woken_up_when_a_message_gives_back_its_room)
     {
         // arrange
         CIoTHubClientMocks mocks;
         IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+        (void)IoTHubClient_SetOption(iotHubClient, "sendQueueFullPolicy", &policy);
         mocks.ResetAllCalls();
 
-        time_t lastMessageReceiveTime;
-        time_t currentTime;
-        time(&currentTime);
+        makeRoomInSendQueueOnWait = true;
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetLastMessageReceiveTime(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
-            .CopyOutArgumentBuffer(2, &currentTime, sizeof(currentTime));
-        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE))
-            .SetReturn(LOCK_ERROR);
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_WasSendQueueFull(TEST_IOTHUB_CLIENT_LL_HANDLE))
+            .SetReturn(true);
+        STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 100));
+        STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetLastMessageReceiveTime(iotHubClient, &lastMessageReceiveTime);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
 
         // assert
         ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
@@ -1684,53 +1989,45 @@ BEGIN_TEST_SUITE(iothubclient_ut)
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* IoTHubClient_GetSendStatus */
-
-    /* Tests_SRS_IOTHUBCLIENT_01_022: [IoTHubClient_GetSendStatus shall call IoTHubClient_LL_GetSendStatus, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameter iotHubClientStatus.] */
-    /* Tests_SRS_IOTHUBCLIENT_01_033: [IoTHubClient_GetSendStatus shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
-    TEST_FUNCTION(IoTHubClient_GetSendStatus_Calls_The_Underslayer_With_Lock_On)
+    /*Tests_SRS_IOTHUBCLIENT_10_068: [ Every time IoTHubClient_LL calls the send queue room callback while a thread waits for room in the send queue, the send queue condition shall be signalled by calling Condition_Post. ]*/
+    TEST_FUNCTION(send_queue_room_callback_does_not_signal_when_nobody_waits)
     {
         // arrange
         CIoTHubClientMocks mocks;
         IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+        (void)IoTHubClient_SetOption(iotHubClient, "sendQueueFullPolicy", &policy);
         mocks.ResetAllCalls();
 
-        IOTHUB_CLIENT_STATUS injectedSendStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
-        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
-            .CopyOutArgumentBuffer(2, &injectedSendStatus, sizeof(injectedSendStatus));
-        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
-
         // act
-        IOTHUB_CLIENT_STATUS sendStatus;
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetSendStatus(iotHubClient, &sendStatus);
+        sendQueueRoomCallback(sendQueueRoomContext);
 
         // assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, sendStatus, IOTHUB_CLIENT_SEND_STATUS_BUSY);
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
         mocks.AssertActualAndExpectedCalls();
 
         // cleanup
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_023: [If iotHubClientHandle is NULL, IoTHubClient_ GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG.] */
-    TEST_FUNCTION(IoTHubClient_GetSendStatus_With_NULL_handle_fails)
+    /* IoTHubClient_SetSendQueueCallback */
+
+    /*Tests_SRS_IOTHUBCLIENT_10_020: [ If iotHubClientHandle is NULL, IoTHubClient_SetSendQueueCallback shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    TEST_FUNCTION(IoTHubClient_SetSendQueueCallback_with_NULL_handle_fails)
     {
         // arrange
         CIoTHubClientMocks mocks;
 
         // act
-        IOTHUB_CLIENT_STATUS sendStatus;
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetSendStatus(NULL, &sendStatus);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetSendQueueCallback(NULL, sendQueueCallback, (void*)0x42);
 
         // assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
         mocks.AssertActualAndExpectedCalls();
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_024: [Otherwise, IoTHubClient_GetSendStatus shall return the result of IoTHubClient_LL_GetSendStatus.] */
-    TEST_FUNCTION(IoTHubClient_GetSendStatus_Returns_The_Result_From_The_Underlayer)
+    /*Tests_SRS_IOTHUBCLIENT_10_021: [ IoTHubClient_SetSendQueueCallback shall be made thread-safe by using the lock created in IoTHubClient_Create. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_023: [ IoTHubClient_SetSendQueueCallback shall call IoTHubClient_LL_SetSendQueueCallback, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameters sendQueueCallback and userContextCallback, and shall return its result. ]*/
+    TEST_FUNCTION(IoTHubClient_SetSendQueueCallback_calls_the_underlayer)
     {
         // arrange
         CIoTHubClientMocks mocks;
@@ -1738,25 +2035,23 @@ BEGIN_TEST_SUITE(iothubclient_ut)
         mocks.ResetAllCalls();
 
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .SetReturn(IOTHUB_CLIENT_INVALID_SIZE);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetSendQueueCallback(TEST_IOTHUB_CLIENT_LL_HANDLE, sendQueueCallback, (void*)0x42))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        IOTHUB_CLIENT_STATUS sendStatus;
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetSendStatus(iotHubClient, &sendStatus);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetSendQueueCallback(iotHubClient, sendQueueCallback, (void*)0x42);
 
         // assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_SIZE);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
         mocks.AssertActualAndExpectedCalls();
 
         // cleanup
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_034: [If acquiring the lock fails, IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_ERROR.] */
-    TEST_FUNCTION(When_acquiring_the_lock_fails_then_IoTHubClient_GetSendStatus_fails)
+    /*Tests_SRS_IOTHUBCLIENT_10_022: [ If acquiring the lock fails, IoTHubClient_SetSendQueueCallback shall return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(When_Acquiring_The_lock_fails_then_IoTHubClient_SetSendQueueCallback_fails)
     {
         // arrange
         CIoTHubClientMocks mocks;
@@ -1767,34 +2062,35 @@ BEGIN_TEST_SUITE(iothubclient_ut)
             .SetReturn(LOCK_ERROR);
 
         // act
-        IOTHUB_CLIENT_STATUS sendStatus;
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetSendStatus(iotHubClient, &sendStatus);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetSendQueueCallback(iotHubClient, sendQueueCallback, (void*)0x42);
 
         // assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_ERROR);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
         mocks.AssertActualAndExpectedCalls();
 
         // cleanup
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    TEST_FUNCTION(When_unlock_fails_then_IoTHubClient_GetSendStatus_still_succeeds)
+    /* IoTHubClient_SetMessageCallback */
+
+    /* Tests_SRS_IOTHUBCLIENT_01_014: [IoTHubClient_SetMessageCallback shall start the worker thread if it was not previously started.] */
+    /* Tests_SRS_IOTHUBCLIENT_01_017: [IoTHubClient_SetMessageCallback shall call IoTHubClient_LL_SetMessageCallback, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameters messageCallback and userContextCallback.] */
+    /* Tests_SRS_IOTHUBCLIENT_01_027: [IoTHubClient_SetMessageCallback shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
+    TEST_FUNCTION(IoTHubClient_SetMessageCallback_starts_the_worker_thread_and_calls_the_underlayer)
     {
         // arrange
         CIoTHubClientMocks mocks;
         IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
         mocks.ResetAllCalls();
 
-        IOTHUB_CLIENT_STATUS injectedSendStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
-            .CopyOutArgumentBuffer(2, &injectedSendStatus, sizeof(injectedSendStatus));
-        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE))
-            .SetReturn(LOCK_ERROR);
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetMessageCallback(TEST_IOTHUB_CLIENT_LL_HANDLE, messageCallback, (void*)0x42));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        IOTHUB_CLIENT_STATUS sendStatus;
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetSendStatus(iotHubClient, &sendStatus);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
 
         // assert
         ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
@@ -1804,90 +2100,94 @@ BEGIN_TEST_SUITE(iothubclient_ut)
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Work scheduling */
-
-    /* Tests_SRS_IOTHUBCLIENT_01_037: [The thread created by IoTHubClient_Create shall call IoTHubClient_LL_DoWork every 1 ms.] */
-    /* Tests_SRS_IOTHUBCLIENT_01_038: [The thread shall exit when IoTHubClient_Destroy is called.] */
-    /* Tests_SRS_IOTHUBCLIENT_01_039: [All calls to IoTHubClient_LL_DoWork shall be protected by the lock created in IotHubClient_Create.] */
-    /*Tests_SRS_IOTHUBCLIENT_02_072: [ All threads marked as disposable (upon completion of a file upload) shall be joined and the data structures build for them shall be freed. ]*/
-    TEST_FUNCTION(Worker_Thread_calls_DoWork_Every_1_ms)
+    /* Tests_SRS_IOTHUBCLIENT_01_015: [If starting the thread fails, IoTHubClient_SetMessageCallback shall return IOTHUB_CLIENT_ERROR.] */
+    TEST_FUNCTION(When_Thread_API_Create_fails_then_IoTHubClient_SetMessageCallback_fails)
     {
         // arrange
         CIoTHubClientMocks mocks;
         IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
-        (void)IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
         mocks.ResetAllCalls();
 
-        howManyDoWorkCalls = 1;
-        current_iothub_client = iotHubClient;
-        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
-#ifndef DONT_USE_UPLOADTOBLOB
-        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-#endif
-        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
-        
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .SetReturn(THREADAPI_ERROR);
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        threadFunc(threadFuncArg);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
 
         // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_ERROR);
         mocks.AssertActualAndExpectedCalls();
-        
-        ///cleanup
+
+        // cleanup
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_037: [The thread created by IoTHubClient_Create shall call IoTHubClient_LL_DoWork every 1 ms.] */
-    /* Tests_SRS_IOTHUBCLIENT_01_038: [The thread shall exit when IoTHubClient_Destroy is called.] */
-    /* Tests_SRS_IOTHUBCLIENT_01_039: [All calls to IoTHubClient_LL_DoWork shall be protected by the lock created in IotHubClient_Create.] */
-    TEST_FUNCTION(Worker_Thread_calls_DoWork_Every_1_ms_2_times)
+    /* Tests_SRS_IOTHUBCLIENT_01_016: [If iotHubClientHandle is NULL, IoTHubClient_SetMessageCallback shall return IOTHUB_CLIENT_INVALID_ARG.] */
+    TEST_FUNCTION(IoTHubClient_SetMessageCallback_with_NULL_handle_fails)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(NULL, messageCallback, (void*)0x42);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+    }
+
+    /* Tests_SRS_IOTHUBCLIENT_01_018: [When IoTHubClient_LL_SetMessageCallback is called, IoTHubClient_SetMessageCallback shall return the result of IoTHubClient_LL_SetMessageCallback.] */
+    TEST_FUNCTION(IoTHubClient_SetMessageCallback_returns_the_result_of_calling_IoTHubClient_LL_SetMessageCallback)
     {
         // arrange
         CIoTHubClientMocks mocks;
         IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
-        (void)IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
         mocks.ResetAllCalls();
 
-        howManyDoWorkCalls = 2;
-        current_iothub_client = iotHubClient;
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
-#ifndef DONT_USE_UPLOADTOBLOB
-        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-#endif
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetMessageCallback(TEST_IOTHUB_CLIENT_LL_HANDLE, messageCallback, (void*)0x42))
+            .SetReturn(IOTHUB_CLIENT_INVALID_SIZE);
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
-        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
-#ifndef DONT_USE_UPLOADTOBLOB
-        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-#endif
-        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_SIZE);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /* Tests_SRS_IOTHUBCLIENT_01_014: [IoTHubClient_SetMessageCallback shall start the worker thread if it was not previously started.] */
+    TEST_FUNCTION(When_the_worker_thread_was_started_by_a_SendEventAsync_A_Call_To_SetMessageCallback_Does_NOt_Start_A_New_Thread)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+        mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetMessageCallback(TEST_IOTHUB_CLIENT_LL_HANDLE, messageCallback, (void*)0x42));
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        threadFunc(threadFuncArg);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
 
         // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
         mocks.AssertActualAndExpectedCalls();
 
-        ///cleanup
+        // cleanup
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* Tests_SRS_IOTHUBCLIENT_01_040: [If acquiring the lock fails, IoTHubClient_LL_DoWork shall not be called.] */
-    TEST_FUNCTION(When_Acquiring_The_lock_fails_then_DoWork_Is_Not_called)
+    /* Tests_SRS_IOTHUBCLIENT_01_014: [IoTHubClient_SetMessageCallback shall start the worker thread if it was not previously started.] */
+    TEST_FUNCTION(When_the_worker_thread_was_started_by_a_previous_SetMessageCallback_A_Call_To_SetMessageCallback_Does_Not_Start_A_New_Thread)
     {
         // arrange
         CIoTHubClientMocks mocks;
@@ -1895,136 +2195,1767 @@ BEGIN_TEST_SUITE(iothubclient_ut)
         (void)IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
         mocks.ResetAllCalls();
 
-        howManyDoWorkCalls = 1;
-        current_iothub_client = iotHubClient;
-
-        /* first round, when lock fails */
-        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
-            .SetReturn(LOCK_ERROR);
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
-
-        /* second round, when lock does not fail and DoWork gets called */
-        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
-#ifndef DONT_USE_UPLOADTOBLOB
-        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-#endif
-        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
-
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetMessageCallback(TEST_IOTHUB_CLIENT_LL_HANDLE, messageCallback, (void*)0x42));
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         // act
-        threadFunc(threadFuncArg);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
 
         // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
         mocks.AssertActualAndExpectedCalls();
 
-        ///cleanup
+        // cleanup
         IoTHubClient_Destroy(iotHubClient);
     }
 
-    /* IoTHubClient_SetOption */
-
-    /*Tests_SRS_IOTHUBCLIENT_02_034: [If parameter iotHubClientHandle is NULL then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
-    TEST_FUNCTION(IoTHubClient_SetOption_with_NULL_handle_fails)
+    /* Tests_SRS_IOTHUBCLIENT_01_028: [If acquiring the lock fails, IoTHubClient_SetMessageCallback shall return IOTHUB_CLIENT_ERROR.] */
+    TEST_FUNCTION(When_Acquiring_The_Lock_Fails_Then_IoTHubClient_SetMessageCallback_Fails)
     {
-        /// arrange
+        // arrange
         CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);;
+        mocks.ResetAllCalls();
 
-        ///act
-        auto result = IoTHubClient_SetOption(NULL, "a", "b");
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+            .SetReturn(LOCK_ERROR);
 
-        ///assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
 
-        ///cleanup
-        
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_ERROR);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
     }
 
-    /*Tests_SRS_IOTHUBCLIENT_02_035: [If parameter optionName is NULL then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
-    TEST_FUNCTION(IoTHubClient_SetOption_with_NULL_optionName_fails)
+    /* IoTHubClient_GetLastMessageReceiveTime */
+
+    /* Tests_SRS_IOTHUBCLIENT_01_019: [IoTHubClient_GetLastMessageReceiveTime shall call IoTHubClient_LL_GetLastMessageReceiveTime, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameter lastMessageReceiveTime.] */
+    /* Tests_SRS_IOTHUBCLIENT_01_035: [IoTHubClient_GetLastMessageReceiveTime shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
+    TEST_FUNCTION(IoTHubClient_GetLastMessageReceiveTime_Calls_the_Underlayer)
     {
-        /// arrange
+        // arrange
         CIoTHubClientMocks mocks;
-
-        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
         mocks.ResetAllCalls();
 
-        ///act
-        auto result = IoTHubClient_SetOption(handle, NULL, "b");
+        time_t lastMessageReceiveTime;
+        time_t currentTime;
+        time(&currentTime);
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetLastMessageReceiveTime(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &currentTime, sizeof(currentTime));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
-        ///assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetLastMessageReceiveTime(iotHubClient, &lastMessageReceiveTime);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        ASSERT_ARE_EQUAL(double, 0.0, difftime(currentTime, lastMessageReceiveTime));
         mocks.AssertActualAndExpectedCalls();
 
-        ///cleanup
-        IoTHubClient_Destroy(handle);
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
     }
 
-    /*Tests_SRS_IOTHUBCLIENT_02_036: [If parameter value is NULL then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
-    TEST_FUNCTION(IoTHubClient_SetOption_with_NULL_value_fails)
+    /* Tests_SRS_IOTHUBCLIENT_01_020: [If iotHubClientHandle is NULL, IoTHubClient_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INVALID_ARG.] */
+    TEST_FUNCTION(IoTHubClient_GetLastMessageReceiveTime_with_NULL_handle_fails)
     {
-        /// arrange
+        // arrange
         CIoTHubClientMocks mocks;
+        time_t lastMessageReceiveTime;
 
-        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
-        mocks.ResetAllCalls();
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetLastMessageReceiveTime(NULL, &lastMessageReceiveTime);
 
-        ///act
-        auto result = IoTHubClient_SetOption(handle, "a", NULL);
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+    }
+
+    /* Tests_SRS_IOTHUBCLIENT_01_021: [Otherwise, IoTHubClient_GetLastMessageReceiveTime shall return the result of IoTHubClient_LL_GetLastMessageReceiveTime.] */
+    TEST_FUNCTION(IoTHubClient_GetLastMessageReceiveTime_Returns_The_Result_Of_the_underlayer)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        time_t lastMessageReceiveTime;
+        time_t currentTime;
+        time(&currentTime);
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetLastMessageReceiveTime(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument(2)
+            .SetReturn(IOTHUB_CLIENT_INVALID_SIZE);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetLastMessageReceiveTime(iotHubClient, &lastMessageReceiveTime);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_SIZE);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /* Tests_SRS_IOTHUBCLIENT_01_036: [If acquiring the lock fails, IoTHubClient_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_ERROR.] */
+    TEST_FUNCTION(When_Accquiring_The_Lock_Fails_Then_IoTHubClient_GetLastMessageReceiveTime_fails)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        time_t lastMessageReceiveTime;
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+            .SetReturn(LOCK_ERROR);
+
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetLastMessageReceiveTime(iotHubClient, &lastMessageReceiveTime);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_ERROR);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    TEST_FUNCTION(When_unlock_fails_IoTHubClient_GetLastMessageReceiveTime_still_succeeds)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        time_t lastMessageReceiveTime;
+        time_t currentTime;
+        time(&currentTime);
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetLastMessageReceiveTime(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &currentTime, sizeof(currentTime));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE))
+            .SetReturn(LOCK_ERROR);
+
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetLastMessageReceiveTime(iotHubClient, &lastMessageReceiveTime);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /* IoTHubClient_GetPoolStatistics */
+
+    /*Tests_SRS_IOTHUBCLIENT_10_031: [ If iotHubClientHandle is NULL, IoTHubClient_GetPoolStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    TEST_FUNCTION(IoTHubClient_GetPoolStatistics_with_NULL_handle_fails)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_POOL_STATISTICS poolStatistics;
+
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetPoolStatistics(NULL, &poolStatistics);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_032: [ IoTHubClient_GetPoolStatistics shall be made thread-safe by using the lock created in IoTHubClient_Create. If acquiring the lock fails, IoTHubClient_GetPoolStatistics shall return IOTHUB_CLIENT_ERROR. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_033: [ IoTHubClient_GetPoolStatistics shall call IoTHubClient_LL_GetPoolStatistics, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameter poolStatistics, and return what IoTHubClient_LL_GetPoolStatistics returns. ]*/
+    TEST_FUNCTION(IoTHubClient_GetPoolStatistics_calls_the_underlayer)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        IOTHUB_CLIENT_POOL_STATISTICS poolStatistics;
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetPoolStatistics(TEST_IOTHUB_CLIENT_LL_HANDLE, &poolStatistics))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetPoolStatistics(iotHubClient, &poolStatistics);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_032: [ IoTHubClient_GetPoolStatistics shall be made thread-safe by using the lock created in IoTHubClient_Create. If acquiring the lock fails, IoTHubClient_GetPoolStatistics shall return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(When_acquiring_the_lock_fails_then_IoTHubClient_GetPoolStatistics_fails)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        IOTHUB_CLIENT_POOL_STATISTICS poolStatistics;
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+            .SetReturn(LOCK_ERROR);
+
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetPoolStatistics(iotHubClient, &poolStatistics);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /* IoTHubClient_GetStatistics */
+
+    /*Tests_SRS_IOTHUBCLIENT_10_060: [ If iotHubClientHandle is NULL, IoTHubClient_GetStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    TEST_FUNCTION(IoTHubClient_GetStatistics_with_NULL_handle_fails)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_STATISTICS statistics;
+
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetStatistics(NULL, &statistics);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_061: [ IoTHubClient_GetStatistics shall be made thread-safe by using the lock created in IoTHubClient_Create. If acquiring the lock fails, IoTHubClient_GetStatistics shall return IOTHUB_CLIENT_ERROR. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_062: [ IoTHubClient_GetStatistics shall call IoTHubClient_LL_GetStatistics, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameter statistics, and return what IoTHubClient_LL_GetStatistics returns. ]*/
+    TEST_FUNCTION(IoTHubClient_GetStatistics_calls_the_underlayer)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        IOTHUB_CLIENT_STATISTICS statistics;
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetStatistics(TEST_IOTHUB_CLIENT_LL_HANDLE, &statistics))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetStatistics(iotHubClient, &statistics);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_061: [ IoTHubClient_GetStatistics shall be made thread-safe by using the lock created in IoTHubClient_Create. If acquiring the lock fails, IoTHubClient_GetStatistics shall return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(When_acquiring_the_lock_fails_then_IoTHubClient_GetStatistics_fails)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        IOTHUB_CLIENT_STATISTICS statistics;
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+            .SetReturn(LOCK_ERROR);
+
+        // act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetStatistics(iotHubClient, &statistics);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /* IoTHubClient_GetSendStatus */
+
+    /* Tests_SRS_IOTHUBCLIENT_01_022: [IoTHubClient_GetSendStatus shall call IoTHubClient_LL_GetSendStatus, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameter iotHubClientStatus.] */
+    /* Tests_SRS_IOTHUBCLIENT_01_033: [IoTHubClient_GetSendStatus shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
+    TEST_FUNCTION(IoTHubClient_GetSendStatus_Calls_The_Underslayer_With_Lock_On)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        IOTHUB_CLIENT_STATUS injectedSendStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &injectedSendStatus, sizeof(injectedSendStatus));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        IOTHUB_CLIENT_STATUS sendStatus;
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetSendStatus(iotHubClient, &sendStatus);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, sendStatus, IOTHUB_CLIENT_SEND_STATUS_BUSY);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /* Tests_SRS_IOTHUBCLIENT_01_023: [If iotHubClientHandle is NULL, IoTHubClient_ GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG.] */
+    TEST_FUNCTION(IoTHubClient_GetSendStatus_With_NULL_handle_fails)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+
+        // act
+        IOTHUB_CLIENT_STATUS sendStatus;
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetSendStatus(NULL, &sendStatus);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /* Tests_SRS_IOTHUBCLIENT_01_024: [Otherwise, IoTHubClient_GetSendStatus shall return the result of IoTHubClient_LL_GetSendStatus.] */
+    TEST_FUNCTION(IoTHubClient_GetSendStatus_Returns_The_Result_From_The_Underlayer)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument(2)
+            .SetReturn(IOTHUB_CLIENT_INVALID_SIZE);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        IOTHUB_CLIENT_STATUS sendStatus;
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetSendStatus(iotHubClient, &sendStatus);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_SIZE);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /* Tests_SRS_IOTHUBCLIENT_01_034: [If acquiring the lock fails, IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_ERROR.] */
+    TEST_FUNCTION(When_acquiring_the_lock_fails_then_IoTHubClient_GetSendStatus_fails)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+            .SetReturn(LOCK_ERROR);
+
+        // act
+        IOTHUB_CLIENT_STATUS sendStatus;
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetSendStatus(iotHubClient, &sendStatus);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_ERROR);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    TEST_FUNCTION(When_unlock_fails_then_IoTHubClient_GetSendStatus_still_succeeds)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        IOTHUB_CLIENT_STATUS injectedSendStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &injectedSendStatus, sizeof(injectedSendStatus));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE))
+            .SetReturn(LOCK_ERROR);
+
+        // act
+        IOTHUB_CLIENT_STATUS sendStatus;
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetSendStatus(iotHubClient, &sendStatus);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        // cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /* Work scheduling */
+
+    /* Tests_SRS_IOTHUBCLIENT_01_037: [The thread created by IoTHubClient_Create shall call IoTHubClient_LL_DoWork every 1 ms.] */
+    /* Tests_SRS_IOTHUBCLIENT_01_038: [The thread shall exit when IoTHubClient_Destroy is called.] */
+    /* Tests_SRS_IOTHUBCLIENT_01_039: [All calls to IoTHubClient_LL_DoWork shall be protected by the lock created in IotHubClient_Create.] */
+    /*Tests_SRS_IOTHUBCLIENT_02_072: [ All threads marked as disposable (upon completion of a file upload) shall be joined and the data structures build for them shall be freed. ]*/
+    TEST_FUNCTION(Worker_Thread_calls_DoWork_Every_1_ms)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        howManyDoWorkCalls = 1;
+        current_iothub_client = iotHubClient;
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+#endif
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        threadFunc(threadFuncArg);
+
+        // assert
+        mocks.AssertActualAndExpectedCalls();
+        
+        ///cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /* Tests_SRS_IOTHUBCLIENT_01_037: [The thread created by IoTHubClient_Create shall call IoTHubClient_LL_DoWork every 1 ms.] */
+    /* Tests_SRS_IOTHUBCLIENT_01_038: [The thread shall exit when IoTHubClient_Destroy is called.] */
+    /* Tests_SRS_IOTHUBCLIENT_01_039: [All calls to IoTHubClient_LL_DoWork shall be protected by the lock created in IotHubClient_Create.] */
+    TEST_FUNCTION(Worker_Thread_calls_DoWork_Every_1_ms_2_times)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        howManyDoWorkCalls = 2;
+        current_iothub_client = iotHubClient;
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+#endif
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+#endif
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        threadFunc(threadFuncArg);
+
+        // assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /* Tests_SRS_IOTHUBCLIENT_01_040: [If acquiring the lock fails, IoTHubClient_LL_DoWork shall not be called.] */
+    TEST_FUNCTION(When_Acquiring_The_lock_fails_then_DoWork_Is_Not_called)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        howManyDoWorkCalls = 1;
+        current_iothub_client = iotHubClient;
+
+        /* first round, when lock fails */
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+            .SetReturn(LOCK_ERROR);
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+
+        /* second round, when lock does not fail and DoWork gets called */
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+#endif
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        threadFunc(threadFuncArg);
+
+        // assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /* IoTHubClient_SetOption */
+
+    /*Tests_SRS_IOTHUBCLIENT_02_034: [If parameter iotHubClientHandle is NULL then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
+    TEST_FUNCTION(IoTHubClient_SetOption_with_NULL_handle_fails)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+
+        ///act
+        auto result = IoTHubClient_SetOption(NULL, "a", "b");
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+        ///cleanup
+        
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_02_035: [If parameter optionName is NULL then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
+    TEST_FUNCTION(IoTHubClient_SetOption_with_NULL_optionName_fails)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, NULL, "b");
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_02_036: [If parameter value is NULL then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
+    TEST_FUNCTION(IoTHubClient_SetOption_with_NULL_value_fails)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "a", NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.]*/
+    /* Tests_SRS_IOTHUBCLIENT_01_041: [ IoTHubClient_SetOption shall be made thread-safe by using the lock created in IoTHubClient_Create. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_happy_path)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, IoTHubClient_LL_SetOption(IGNORED_PTR_ARG, "a", "b"));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "a", "b");
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_fails_when_LL_fails)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, IoTHubClient_LL_SetOption(IGNORED_PTR_ARG, "a", "b"))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "a", "b");
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_013: [ Otherwise IoTHubClient_SetOption shall create the worker condition by calling Condition_Init if it was not created before and the value is not 0. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_015: [ On success IoTHubClient_SetOption shall store the value, wake up the worker thread so that it picks up the new value and return IOTHUB_CLIENT_OK. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_workerIdleWaitTime_creates_the_worker_condition)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        unsigned int idleWaitTime = 100;
+
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Condition_Init());
+        STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "workerIdleWaitTime", &idleWaitTime);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_065: [ When "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK, IoTHubClient_SetOption shall create the send queue condition by calling Condition_Init if it was not created before and have it signalled by calling IoTHubClient_LL_SetSendQueueRoomCallback. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_019: [ When IoTHubClient_LL_SetOption accepts "sendQueueFullPolicy", IoTHubClient_SetOption shall remember whether the policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_sendQueueFullPolicy_BLOCK_creates_the_send_queue_condition)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Condition_Init());
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetSendQueueRoomCallback(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, handle))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetOption(TEST_IOTHUB_CLIENT_LL_HANDLE, "sendQueueFullPolicy", &policy));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "sendQueueFullPolicy", &policy);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        ASSERT_IS_NOT_NULL((void*)sendQueueRoomCallback);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_065: [ When "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK, IoTHubClient_SetOption shall create the send queue condition by calling Condition_Init if it was not created before and have it signalled by calling IoTHubClient_LL_SetSendQueueRoomCallback. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_sendQueueFullPolicy_BLOCK_twice_creates_the_send_queue_condition_once)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "sendQueueFullPolicy", &policy);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SetOption(TEST_IOTHUB_CLIENT_LL_HANDLE, "sendQueueFullPolicy", &policy));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "sendQueueFullPolicy", &policy);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_066: [ If Condition_Init fails, IoTHubClient_SetOption shall return IOTHUB_CLIENT_ERROR without calling IoTHubClient_LL_SetOption. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_sendQueueFullPolicy_BLOCK_fails_when_Condition_Init_fails)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Condition_Init())
+            .SetReturn((COND_HANDLE)NULL);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "sendQueueFullPolicy", &policy);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_014: [ If Condition_Init fails, IoTHubClient_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_workerIdleWaitTime_fails_when_Condition_Init_fails)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        unsigned int idleWaitTime = 100;
+
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Condition_Init())
+            .SetReturn((COND_HANDLE)NULL);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "workerIdleWaitTime", &idleWaitTime);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_012: [ If the transport connection is shared, IoTHubClient_SetOption shall call IoTHubTransport_SetWorkerIdleWaitTime and return what IoTHubTransport_SetWorkerIdleWaitTime returns. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_workerIdleWaitTime_with_shared_transport_calls_IoTHubTransport_SetWorkerIdleWaitTime)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        unsigned int idleWaitTime = 100;
+
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_CreateWithTransport(TEST_IOTHUBTRANSPORT_HANDLE, &TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_IOTHUBTRANSPORT_LOCK));
+        STRICT_EXPECTED_CALL(mocks, IoTHubTransport_SetWorkerIdleWaitTime(TEST_IOTHUBTRANSPORT_HANDLE, 100))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_IOTHUBTRANSPORT_LOCK));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "workerIdleWaitTime", &idleWaitTime);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_009: [ When IoTHubClient_LL_SendEventAsync succeeds and the "workerIdleWaitTime" option is not 0, IoTHubClient_SendEventAsync shall wake up the worker thread. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_workerIdleWaitTime_wakes_up_the_worker_thread)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        unsigned int idleWaitTime = 100;
+
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "workerIdleWaitTime", &idleWaitTime);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42));
+        STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_009: [ When IoTHubClient_LL_SendEventAsync succeeds and the "workerIdleWaitTime" option is not 0, IoTHubClient_SendEventAsync shall wake up the worker thread. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_workerIdleWaitTime_and_shared_transport_wakes_up_the_transport_worker_thread)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        unsigned int idleWaitTime = 100;
+
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_CreateWithTransport(TEST_IOTHUBTRANSPORT_HANDLE, &TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "workerIdleWaitTime", &idleWaitTime);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_IOTHUBTRANSPORT_LOCK));
+        STRICT_EXPECTED_CALL(mocks, IoTHubTransport_StartWorkerThread(TEST_IOTHUBTRANSPORT_HANDLE, handle));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42));
+        STRICT_EXPECTED_CALL(mocks, IoTHubTransport_SignalWorkerThread(TEST_IOTHUBTRANSPORT_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_IOTHUBTRANSPORT_LOCK));
+
+        ///act
+        auto result = IoTHubClient_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_063: [ If the transport connection is shared, the worker thread shall be woken up by calling IoTHubTransport_SignalWorkerThread whatever the "workerIdleWaitTime" option of this client is. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_on_a_shared_transport_wakes_up_the_transport_worker_thread_when_another_client_set_workerIdleWaitTime)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        unsigned int idleWaitTime = 100;
+
+        IOTHUB_CLIENT_HANDLE handle1 = IoTHubClient_CreateWithTransport(TEST_IOTHUBTRANSPORT_HANDLE, &TEST_CONFIG);
+        IOTHUB_CLIENT_HANDLE handle2 = IoTHubClient_CreateWithTransport(TEST_IOTHUBTRANSPORT_HANDLE, &TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle1, "workerIdleWaitTime", &idleWaitTime);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_IOTHUBTRANSPORT_LOCK));
+        STRICT_EXPECTED_CALL(mocks, IoTHubTransport_StartWorkerThread(TEST_IOTHUBTRANSPORT_HANDLE, handle2));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42));
+        STRICT_EXPECTED_CALL(mocks, IoTHubTransport_SignalWorkerThread(TEST_IOTHUBTRANSPORT_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_IOTHUBTRANSPORT_LOCK));
+
+        ///act
+        auto result = IoTHubClient_SendEventAsync(handle2, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle1);
+        IoTHubClient_Destroy(handle2);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_007: [ If the "workerIdleWaitTime" option is not 0 and IoTHubClient_LL_GetSendStatus reports IOTHUB_CLIENT_SEND_STATUS_IDLE, the thread shall wait on the worker condition for at most "workerIdleWaitTime" milliseconds instead of sleeping 1 ms. ]*/
+    TEST_FUNCTION(Worker_Thread_with_workerIdleWaitTime_waits_on_the_condition_when_idle)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        unsigned int idleWaitTime = 100;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(iotHubClient, "workerIdleWaitTime", &idleWaitTime);
+        (void)IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        howManyDoWorkCalls = 1;
+        current_iothub_client = iotHubClient;
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+#endif
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 100));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        threadFunc(threadFuncArg);
+
+        // assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_007: [ If the "workerIdleWaitTime" option is not 0 and IoTHubClient_LL_GetSendStatus reports IOTHUB_CLIENT_SEND_STATUS_IDLE, the thread shall wait on the worker condition for at most "workerIdleWaitTime" milliseconds instead of sleeping 1 ms. ]*/
+    TEST_FUNCTION(Worker_Thread_with_workerIdleWaitTime_sleeps_1_ms_when_busy)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        unsigned int idleWaitTime = 100;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(iotHubClient, "workerIdleWaitTime", &idleWaitTime);
+        (void)IoTHubClient_SetMessageCallback(iotHubClient, messageCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        howManyDoWorkCalls = 1;
+        current_iothub_client = iotHubClient;
+        currentSendStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+#endif
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        threadFunc(threadFuncArg);
+
+        // assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_008: [ If the worker thread might be waiting for work, IoTHubClient_Destroy shall wake it up by calling Condition_Post. ]*/
+    TEST_FUNCTION(IoTHubClient_Destroy_with_workerIdleWaitTime_wakes_up_and_joins_the_thread)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        unsigned int idleWaitTime = 100;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(iotHubClient, "workerIdleWaitTime", &idleWaitTime);
+        (void)IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+#endif
+        STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Destroy(TEST_IOTHUB_CLIENT_LL_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_destroy(TEST_LIST_HANDLE));
+#endif
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Condition_Deinit(TEST_COND_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+
+        // act
+        IoTHubClient_Destroy(iotHubClient);
+
+        // assert
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_034: [ When "sendEventHandoff" is set to true, IoTHubClient_SetOption shall create the handoff by calling IoTHubClient_Handoff_Create and start the worker thread if it was not previously started. If any of these fails IoTHubClient_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_sendEventHandoff_creates_the_handoff_and_starts_the_worker_thread)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_Create());
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "sendEventHandoff", &enable);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_034: [ When "sendEventHandoff" is set to true, IoTHubClient_SetOption shall create the handoff by calling IoTHubClient_Handoff_Create and start the worker thread if it was not previously started. If any of these fails IoTHubClient_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_sendEventHandoff_fails_when_IoTHubClient_Handoff_Create_fails)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_Create())
+            .SetReturn((IOTHUB_CLIENT_HANDOFF_HANDLE)NULL);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "sendEventHandoff", &enable);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_034: [ When "sendEventHandoff" is set to true, IoTHubClient_SetOption shall create the handoff by calling IoTHubClient_Handoff_Create and start the worker thread if it was not previously started. If any of these fails IoTHubClient_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_sendEventHandoff_destroys_the_handoff_when_the_worker_thread_cannot_start)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_Create());
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .SetReturn(THREADAPI_ERROR);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_Destroy(TEST_HANDOFF_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "sendEventHandoff", &enable);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_035: [ Once the handoff exists, setting "sendEventHandoff" to false shall fail and return IOTHUB_CLIENT_ERROR. Setting it to false before, or to true again, shall do nothing and return IOTHUB_CLIENT_OK. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_sendEventHandoff_cannot_be_disabled_once_enabled)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        bool disable = false;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        auto resultBefore = IoTHubClient_SetOption(handle, "sendEventHandoff", &disable);
+        (void)IoTHubClient_SetOption(handle, "sendEventHandoff", &enable);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto resultAgain = IoTHubClient_SetOption(handle, "sendEventHandoff", &enable);
+        auto resultDisable = IoTHubClient_SetOption(handle, "sendEventHandoff", &disable);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, resultBefore);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, resultAgain);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, resultDisable);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_036: [ When the "sendEventHandoff" option is enabled, IoTHubClient_SendEventAsync and IoTHubClient_SendEventAsync_TakeOwnership shall not acquire the lock. They shall return IOTHUB_CLIENT_INVALID_ARG if eventMessageHandle is NULL, or if eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_037: [ IoTHubClient_SendEventAsync shall clone eventMessageHandle by calling IoTHubMessage_Clone and push the clone, eventConfirmationCallback and userContextCallback to the handoff by calling IoTHubClient_Handoff_Push, then return IOTHUB_CLIENT_OK. If any of these fails IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_sendEventHandoff_pushes_a_clone_without_taking_the_lock)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "sendEventHandoff", &enable);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone(TEST_DEVICEMESSAGE_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_Push(TEST_HANDOFF_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+
+        ///act
+        auto result = IoTHubClient_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        ASSERT_IS_NOT_NULL(handoffHead);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_036: [ When the "sendEventHandoff" option is enabled, IoTHubClient_SendEventAsync and IoTHubClient_SendEventAsync_TakeOwnership shall not acquire the lock. They shall return IOTHUB_CLIENT_INVALID_ARG if eventMessageHandle is NULL, or if eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_sendEventHandoff_and_NULL_message_fails)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "sendEventHandoff", &enable);
+        mocks.ResetAllCalls();
+
+        ///act
+        auto result = IoTHubClient_SendEventAsync(handle, NULL, eventConfirmationCallback, (void*)0x42);
+        auto result2 = IoTHubClient_SendEventAsync_TakeOwnership(handle, TEST_DEVICEMESSAGE_HANDLE, NULL, (void*)0x42);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result2);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_037: [ IoTHubClient_SendEventAsync shall clone eventMessageHandle by calling IoTHubMessage_Clone and push the clone, eventConfirmationCallback and userContextCallback to the handoff by calling IoTHubClient_Handoff_Push, then return IOTHUB_CLIENT_OK. If any of these fails IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_sendEventHandoff_fails_when_IoTHubMessage_Clone_fails)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "sendEventHandoff", &enable);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone(TEST_DEVICEMESSAGE_HANDLE))
+            .SetReturn((IOTHUB_MESSAGE_HANDLE)NULL);
+
+        ///act
+        auto result = IoTHubClient_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_037: [ IoTHubClient_SendEventAsync shall clone eventMessageHandle by calling IoTHubMessage_Clone and push the clone, eventConfirmationCallback and userContextCallback to the handoff by calling IoTHubClient_Handoff_Push, then return IOTHUB_CLIENT_OK. If any of these fails IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_sendEventHandoff_destroys_the_clone_when_malloc_fails)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "sendEventHandoff", &enable);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone(TEST_DEVICEMESSAGE_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .SetReturn((void*)NULL);
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(TEST_CLONED_MESSAGE_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_038: [ IoTHubClient_SendEventAsync_TakeOwnership shall push eventMessageHandle, eventConfirmationCallback and userContextCallback to the handoff without cloning the message and return IOTHUB_CLIENT_OK. If that fails it shall return IOTHUB_CLIENT_ERROR and leave the ownership of eventMessageHandle with the caller. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_TakeOwnership_with_sendEventHandoff_pushes_the_message_without_taking_the_lock)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "sendEventHandoff", &enable);
+        mocks.ResetAllCalls();
+
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_Push(TEST_HANDOFF_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+
+        ///act
+        auto result = IoTHubClient_SendEventAsync_TakeOwnership(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_039: [ When IoTHubClient_Handoff_Push reports that the handoff was empty and the "workerIdleWaitTime" option is not 0, the worker thread shall be woken up with the lock held. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_sendEventHandoff_wakes_up_the_worker_thread_only_when_the_handoff_was_empty)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        unsigned int idleWaitTime = 100;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "workerIdleWaitTime", &idleWaitTime);
+        (void)IoTHubClient_SetOption(handle, "sendEventHandoff", &enable);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone(TEST_DEVICEMESSAGE_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_Push(TEST_HANDOFF_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Clone(TEST_DEVICEMESSAGE_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_Push(TEST_HANDOFF_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+
+        ///act
+        auto result1 = IoTHubClient_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+        auto result2 = IoTHubClient_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x43);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result1);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_040: [ Before calling IoTHubClient_LL_DoWork the worker thread shall take all the events from the handoff by calling IoTHubClient_Handoff_TakeAll and pass them, after the events kept from a previous iteration and in the order they were submitted, to IoTHubClient_LL_SendEventAsync_TakeOwnership. ]*/
+    TEST_FUNCTION(Worker_Thread_passes_the_handed_over_events_to_the_LL_in_order_before_DoWork)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(iotHubClient, "sendEventHandoff", &enable);
+        (void)IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+        (void)IoTHubClient_SendEventAsync_TakeOwnership(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x43);
+        mocks.ResetAllCalls();
+
+        howManyDoWorkCalls = 1;
+        current_iothub_client = iotHubClient;
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_TakeAll(TEST_HANDOFF_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CLONED_MESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x43));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+#endif
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        threadFunc(threadFuncArg);
+
+        // assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_041: [ If "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK and an event is refused because the send queue is full, the worker thread shall keep it and the events after it for its next iteration. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_043: [ While events handed over with the "sendEventHandoff" option have not been passed to IoTHubClient_LL, IoTHubClient_GetSendStatus shall report IOTHUB_CLIENT_SEND_STATUS_BUSY and the worker thread shall not wait for work. ]*/
+    TEST_FUNCTION(Worker_Thread_with_BLOCK_policy_keeps_the_handed_over_events_while_the_send_queue_is_full)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_STATUS status;
+        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(iotHubClient, "sendQueueFullPolicy", &policy);
+        (void)IoTHubClient_SetOption(iotHubClient, "sendEventHandoff", &enable);
+        (void)IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+        (void)IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x43);
+        mocks.ResetAllCalls();
+
+        howManyDoWorkCalls = 1;
+        current_iothub_client = iotHubClient;
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_TakeAll(TEST_HANDOFF_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CLONED_MESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_WasSendQueueFull(TEST_IOTHUB_CLIENT_LL_HANDLE))
+            .SetReturn(true);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+#endif
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_LL_HANDLE, &status));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        threadFunc(threadFuncArg);
+        auto result = IoTHubClient_GetSendStatus(iotHubClient, &status);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_SEND_STATUS_BUSY, (int)status);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_040: [ Before calling IoTHubClient_LL_DoWork the worker thread shall take all the events from the handoff by calling IoTHubClient_Handoff_TakeAll and pass them, after the events kept from a previous iteration and in the order they were submitted, to IoTHubClient_LL_SendEventAsync_TakeOwnership. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_041: [ If "sendQueueFullPolicy" is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK and an event is refused because the send queue is full, the worker thread shall keep it and the events after it for its next iteration. ]*/
+    TEST_FUNCTION(Worker_Thread_passes_the_newly_handed_over_events_after_the_kept_ones)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(iotHubClient, "sendQueueFullPolicy", &policy);
+        (void)IoTHubClient_SetOption(iotHubClient, "sendEventHandoff", &enable);
+        (void)IoTHubClient_SendEventAsync_TakeOwnership(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+        (void)IoTHubClient_SendEventAsync_TakeOwnership(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x43);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_WasSendQueueFull(TEST_IOTHUB_CLIENT_LL_HANDLE))
+            .SetReturn(true);
+        IoTHubClient_DrainSendHandoff_NoLock(iotHubClient);
+        (void)IoTHubClient_SendEventAsync_TakeOwnership(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x44);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_TakeAll(TEST_HANDOFF_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x43));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x44));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+
+        // act
+        IoTHubClient_DrainSendHandoff_NoLock(iotHubClient);
+
+        // assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_042: [ Otherwise, if IoTHubClient_LL_SendEventAsync_TakeOwnership fails, the worker thread shall call the callback of the event with IOTHUB_CLIENT_CONFIRMATION_ERROR and destroy its message. ]*/
+    TEST_FUNCTION(Worker_Thread_completes_a_refused_handed_over_event_with_CONFIRMATION_ERROR)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(iotHubClient, "sendEventHandoff", &enable);
+        (void)IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        howManyDoWorkCalls = 1;
+        current_iothub_client = iotHubClient;
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_TakeAll(TEST_HANDOFF_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CLONED_MESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42))
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)0x42));
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(TEST_CLONED_MESSAGE_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_LL_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+#endif
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        threadFunc(threadFuncArg);
+
+        // assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_043: [ While events handed over with the "sendEventHandoff" option have not been passed to IoTHubClient_LL, IoTHubClient_GetSendStatus shall report IOTHUB_CLIENT_SEND_STATUS_BUSY and the worker thread shall not wait for work. ]*/
+    TEST_FUNCTION(IoTHubClient_GetSendStatus_reports_BUSY_while_events_are_handed_over)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_STATUS status;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(iotHubClient, "sendEventHandoff", &enable);
+        (void)IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_LL_HANDLE, &status));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_IsEmpty(TEST_HANDOFF_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        // act
+        auto result = IoTHubClient_GetSendStatus(iotHubClient, &status);
+
+        // assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_SEND_STATUS_BUSY, (int)status);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_044: [ IoTHubClient_Destroy shall call the callbacks of the events that were handed over and not passed to IoTHubClient_LL with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, destroy their messages and destroy the handoff by calling IoTHubClient_Handoff_Destroy. ]*/
+    TEST_FUNCTION(IoTHubClient_Destroy_completes_the_handed_over_events_with_BECAUSE_DESTROY)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(iotHubClient, "sendEventHandoff", &enable);
+        (void)IoTHubClient_SendEventAsync(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+#endif
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Destroy(TEST_IOTHUB_CLIENT_LL_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_TakeAll(TEST_HANDOFF_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, (void*)0x42));
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(TEST_CLONED_MESSAGE_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_Destroy(TEST_HANDOFF_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_destroy(TEST_LIST_HANDLE));
+#endif
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+
+        // act
+        IoTHubClient_Destroy(iotHubClient);
+
+        // assert
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_045: [ If iotHubClientHandle is NULL, IoTHubClient_DrainSendHandoff_NoLock shall do nothing. Otherwise it shall pass the handed over events to IoTHubClient_LL like the worker thread of IoTHubClient does. ]*/
+    TEST_FUNCTION(IoTHubClient_DrainSendHandoff_NoLock_passes_the_handed_over_events_to_the_LL)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_CreateWithTransport(TEST_IOTHUBTRANSPORT_HANDLE, &TEST_CONFIG);
+        (void)IoTHubClient_SetOption(iotHubClient, "sendEventHandoff", &enable);
+        (void)IoTHubClient_SendEventAsync_TakeOwnership(iotHubClient, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_TakeAll(TEST_HANDOFF_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+
+        // act
+        IoTHubClient_DrainSendHandoff_NoLock(NULL);
+        IoTHubClient_DrainSendHandoff_NoLock(iotHubClient);
+
+        // assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(iotHubClient);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_046: [ When "callbackDispatchThread" is set to true, IoTHubClient_SetOption shall create the dispatch lock by calling Lock_Init, the dispatch condition by calling Condition_Init and start the dispatch thread by calling ThreadAPI_Create. If any of these fails IoTHubClient_SetOption shall free what it created and return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_callbackDispatchThread_creates_the_dispatch_lock_condition_and_thread)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Lock_Init());
+        STRICT_EXPECTED_CALL(mocks, Condition_Init());
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)handle, threadFuncArg);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_046: [ When "callbackDispatchThread" is set to true, IoTHubClient_SetOption shall create the dispatch lock by calling Lock_Init, the dispatch condition by calling Condition_Init and start the dispatch thread by calling ThreadAPI_Create. If any of these fails IoTHubClient_SetOption shall free what it created and return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_callbackDispatchThread_fails_when_Condition_Init_fails)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Lock_Init());
+        STRICT_EXPECTED_CALL(mocks, Condition_Init())
+            .SetReturn((COND_HANDLE)NULL);
+        STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_046: [ When "callbackDispatchThread" is set to true, IoTHubClient_SetOption shall create the dispatch lock by calling Lock_Init, the dispatch condition by calling Condition_Init and start the dispatch thread by calling ThreadAPI_Create. If any of these fails IoTHubClient_SetOption shall free what it created and return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_callbackDispatchThread_frees_the_lock_and_the_condition_when_the_thread_cannot_start)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Lock_Init());
+        STRICT_EXPECTED_CALL(mocks, Condition_Init());
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .SetReturn(THREADAPI_ERROR);
+        STRICT_EXPECTED_CALL(mocks, Condition_Deinit(TEST_COND_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
 
         ///assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
         mocks.AssertActualAndExpectedCalls();
 
         ///cleanup
         IoTHubClient_Destroy(handle);
     }
 
-    /*Tests_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.]*/
-    /* Tests_SRS_IOTHUBCLIENT_01_041: [ IoTHubClient_SetOption shall be made thread-safe by using the lock created in IoTHubClient_Create. ]*/
-    TEST_FUNCTION(IoTHubClient_SetOption_happy_path)
+    /*Tests_SRS_IOTHUBCLIENT_10_047: [ Once the dispatch thread runs, setting "callbackDispatchThread" to false shall fail and return IOTHUB_CLIENT_ERROR. Setting it to false before, or to true again, shall do nothing and return IOTHUB_CLIENT_OK. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_callbackDispatchThread_cannot_be_disabled_once_enabled)
     {
         /// arrange
         CIoTHubClientMocks mocks;
+        bool enable = true;
+        bool disable = false;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        auto resultBefore = IoTHubClient_SetOption(handle, "callbackDispatchThread", &disable);
+        (void)IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto resultAgain = IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
+        auto resultDisable = IoTHubClient_SetOption(handle, "callbackDispatchThread", &disable);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, resultBefore);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, resultAgain);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, resultDisable);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
 
+    /*Tests_SRS_IOTHUBCLIENT_10_064: [ The message callback shall not be dispatched: whether the "callbackDispatchThread" option is enabled or not, IoTHubClient_SetMessageCallback shall pass messageCallback and userContextCallback to IoTHubClient_LL_SetMessageCallback, so that the disposition messageCallback returns is the one the transport gives to IoT Hub. ]*/
+    TEST_FUNCTION(IoTHubClient_SetOption_callbackDispatchThread_leaves_the_message_callback_set_before_to_the_LL)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
         IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetMessageCallback(handle, messageCallback, (void*)0x42);
         mocks.ResetAllCalls();
 
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        EXPECTED_CALL(mocks, IoTHubClient_LL_SetOption(IGNORED_PTR_ARG, "a", "b"));
+        STRICT_EXPECTED_CALL(mocks, Lock_Init());
+        STRICT_EXPECTED_CALL(mocks, Condition_Init());
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         ///act
-        auto result = IoTHubClient_SetOption(handle, "a", "b");
+        auto result = IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
 
         ///assert
         ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        ASSERT_IS_TRUE(llMessageCallback == messageCallback);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, llMessageCallbackContext);
         mocks.AssertActualAndExpectedCalls();
 
         ///cleanup
         IoTHubClient_Destroy(handle);
     }
 
-    /*Tests_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.]*/
-    TEST_FUNCTION(IoTHubClient_SetOption_fails_when_LL_fails)
+    /*Tests_SRS_IOTHUBCLIENT_10_049: [ When the "callbackDispatchThread" option is enabled and eventConfirmationCallback is not NULL, IoTHubClient_SendEventAsync, IoTHubClient_SendEventAsync_TakeOwnership, IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall pass a confirmation callback and context of their own instead of eventConfirmationCallback and userContextCallback. If allocating that context fails they shall return IOTHUB_CLIENT_ERROR. The context shall be freed when the events are refused. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_callbackDispatchThread_passes_a_dispatching_callback_to_the_LL)
     {
         /// arrange
         CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42))
+            .IgnoreArgument(3)
+            .IgnoreArgument(4);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        ASSERT_IS_NOT_NULL((void*)llEventConfirmationCallback);
+        ASSERT_IS_TRUE(llEventConfirmationCallback != eventConfirmationCallback);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        llEventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, llEventConfirmationContext);
+        IoTHubClient_Destroy(handle);
+    }
 
+    /*Tests_SRS_IOTHUBCLIENT_10_049: [ When the "callbackDispatchThread" option is enabled and eventConfirmationCallback is not NULL, IoTHubClient_SendEventAsync, IoTHubClient_SendEventAsync_TakeOwnership, IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall pass a confirmation callback and context of their own instead of eventConfirmationCallback and userContextCallback. If allocating that context fails they shall return IOTHUB_CLIENT_ERROR. The context shall be freed when the events are refused. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_callbackDispatchThread_frees_the_context_when_the_LL_refuses_the_event)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
         IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
         mocks.ResetAllCalls();
 
         STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-        EXPECTED_CALL(mocks, IoTHubClient_LL_SetOption(IGNORED_PTR_ARG, "a", "b"))
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42))
+            .IgnoreArgument(3)
+            .IgnoreArgument(4)
             .SetReturn(IOTHUB_CLIENT_ERROR);
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
         ///act
-        auto result = IoTHubClient_SetOption(handle, "a", "b");
+        auto result = IoTHubClient_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_049: [ When the "callbackDispatchThread" option is enabled and eventConfirmationCallback is not NULL, IoTHubClient_SendEventAsync, IoTHubClient_SendEventAsync_TakeOwnership, IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall pass a confirmation callback and context of their own instead of eventConfirmationCallback and userContextCallback. If allocating that context fails they shall return IOTHUB_CLIENT_ERROR. The context shall be freed when the events are refused. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_callbackDispatchThread_fails_when_malloc_fails)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .SetReturn((void*)NULL);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        auto result = IoTHubClient_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
 
         ///assert
         ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
@@ -2034,6 +3965,255 @@ BEGIN_TEST_SUITE(iothubclient_ut)
         IoTHubClient_Destroy(handle);
     }
 
+    /*Tests_SRS_IOTHUBCLIENT_10_050: [ When IoTHubClient_LL calls that callback, it shall queue the result, eventConfirmationCallback and userContextCallback for the dispatch thread and signal the dispatch condition instead of calling eventConfirmationCallback. If that fails, eventConfirmationCallback shall be called right away. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_053: [ The dispatch thread shall call the queued event confirmations in the order they were queued without holding the lock created in IoTHubClient_Create. ]*/
+    TEST_FUNCTION(Dispatch_Thread_calls_the_event_confirmations_in_order_without_the_client_lock)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
+        THREAD_START_FUNC dispatchThread = threadFunc;
+        (void)IoTHubClient_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+        IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK firstCallback = llEventConfirmationCallback;
+        void* firstContext = llEventConfirmationContext;
+        (void)IoTHubClient_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x43);
+        mocks.ResetAllCalls();
+
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+
+        /*the dispatch thread*/
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)0x42));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)0x43));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        firstCallback(IOTHUB_CLIENT_CONFIRMATION_OK, firstContext);
+        llEventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, llEventConfirmationContext);
+        *(sig_atomic_t*)(((char*)handle) + IoTHubClient_DispatchTerminationOffset) = 1; /*tell the dispatch thread to stop once it has called everything*/
+        (void)dispatchThread(handle);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_054: [ When no callback is queued, the dispatch thread shall wait on the dispatch condition. ]*/
+    TEST_FUNCTION(Dispatch_Thread_waits_on_the_dispatch_condition_when_nothing_is_queued)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
+        THREAD_START_FUNC dispatchThread = threadFunc;
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+            .SetReturn(LOCK_ERROR);
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, IGNORED_NUM_ARG))
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        stopDispatchThreadOnWait = true;
+
+        ///act
+        (void)dispatchThread(handle);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_064: [ The message callback shall not be dispatched: whether the "callbackDispatchThread" option is enabled or not, IoTHubClient_SetMessageCallback shall pass messageCallback and userContextCallback to IoTHubClient_LL_SetMessageCallback, so that the disposition messageCallback returns is the one the transport gives to IoT Hub. ]*/
+    TEST_FUNCTION(IoTHubClient_SetMessageCallback_with_callbackDispatchThread_gives_IoTHubClient_LL_the_rejected_disposition_of_the_message_callback)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
+        (void)IoTHubClient_SetMessageCallback(handle, messageCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        /*the message callback is called right away, nothing is cloned or queued for the dispatch thread*/
+        STRICT_EXPECTED_CALL(mocks, messageCallback(TEST_DEVICEMESSAGE_HANDLE, (void*)0x42))
+            .SetReturn(IOTHUBMESSAGE_REJECTED);
+
+        ///act
+        auto disposition = llMessageCallback(TEST_DEVICEMESSAGE_HANDLE, llMessageCallbackContext);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, (int)IOTHUBMESSAGE_REJECTED, (int)disposition);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_064: [ The message callback shall not be dispatched: whether the "callbackDispatchThread" option is enabled or not, IoTHubClient_SetMessageCallback shall pass messageCallback and userContextCallback to IoTHubClient_LL_SetMessageCallback, so that the disposition messageCallback returns is the one the transport gives to IoT Hub. ]*/
+    TEST_FUNCTION(IoTHubClient_SetMessageCallback_with_callbackDispatchThread_gives_IoTHubClient_LL_the_abandoned_disposition_of_the_message_callback)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
+        (void)IoTHubClient_SetMessageCallback(handle, messageCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        /*the message callback is called right away, nothing is cloned or queued for the dispatch thread*/
+        STRICT_EXPECTED_CALL(mocks, messageCallback(TEST_DEVICEMESSAGE_HANDLE, (void*)0x42))
+            .SetReturn(IOTHUBMESSAGE_ABANDONED);
+
+        ///act
+        auto disposition = llMessageCallback(TEST_DEVICEMESSAGE_HANDLE, llMessageCallbackContext);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, (int)IOTHUBMESSAGE_ABANDONED, (int)disposition);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_049: [ When the "callbackDispatchThread" option is enabled and eventConfirmationCallback is not NULL, IoTHubClient_SendEventAsync, IoTHubClient_SendEventAsync_TakeOwnership, IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall pass a confirmation callback and context of their own instead of eventConfirmationCallback and userContextCallback. If allocating that context fails they shall return IOTHUB_CLIENT_ERROR. The context shall be freed when the events are refused. ]*/
+    /*Tests_SRS_IOTHUBCLIENT_10_050: [ When IoTHubClient_LL calls that callback, it shall queue the result, eventConfirmationCallback and userContextCallback for the dispatch thread and signal the dispatch condition instead of calling eventConfirmationCallback. If that fails, eventConfirmationCallback shall be called right away. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventBatchAsync_with_callbackDispatchThread_keeps_the_context_until_the_last_confirmation)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
+        THREAD_START_FUNC dispatchThread = threadFunc;
+        (void)IoTHubClient_SendEventBatchAsync(handle, TEST_BATCH, 2, IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE, eventConfirmationCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)); /*the context, once*/
+
+        /*the dispatch thread*/
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)0x42))
+            .ExpectedTimesExactly(2);
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .ExpectedTimesExactly(2);
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        llEventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, llEventConfirmationContext);
+        llEventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, llEventConfirmationContext);
+        *(sig_atomic_t*)(((char*)handle) + IoTHubClient_DispatchTerminationOffset) = 1;
+        (void)dispatchThread(handle);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_049: [ When the "callbackDispatchThread" option is enabled and eventConfirmationCallback is not NULL, IoTHubClient_SendEventAsync, IoTHubClient_SendEventAsync_TakeOwnership, IoTHubClient_SendEventBatchAsync and IoTHubClient_SendEventBatchAsync_TakeOwnership shall pass a confirmation callback and context of their own instead of eventConfirmationCallback and userContextCallback. If allocating that context fails they shall return IOTHUB_CLIENT_ERROR. The context shall be freed when the events are refused. ]*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_with_sendEventHandoff_and_callbackDispatchThread_hands_over_a_dispatching_callback)
+    {
+        /// arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE handle = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(handle, "callbackDispatchThread", &enable);
+        (void)IoTHubClient_SetOption(handle, "sendEventHandoff", &enable);
+        (void)IoTHubClient_SendEventAsync_TakeOwnership(handle, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Handoff_TakeAll(TEST_HANDOFF_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_DEVICEMESSAGE_HANDLE, eventConfirmationCallback, (void*)0x42))
+            .IgnoreArgument(3)
+            .IgnoreArgument(4)
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        /*the refused event is completed through the dispatch thread*/
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(TEST_DEVICEMESSAGE_HANDLE));
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+
+        ///act
+        IoTHubClient_DrainSendHandoff_NoLock(handle);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubClient_Destroy(handle);
+    }
+
+    /*Tests_SRS_IOTHUBCLIENT_10_055: [ IoTHubClient_Destroy shall signal the dispatch thread to end and join it after releasing the lock. The dispatch thread shall call every queued callback before ending, including the ones IoTHubClient_LL_Destroy completes with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY. Then IoTHubClient_Destroy shall free the dispatch condition and the dispatch lock. ]*/
+    TEST_FUNCTION(IoTHubClient_Destroy_ends_and_joins_the_dispatch_thread_after_releasing_the_lock)
+    {
+        // arrange
+        CIoTHubClientMocks mocks;
+        bool enable = true;
+        IOTHUB_CLIENT_HANDLE iotHubClient = IoTHubClient_Create(&TEST_CONFIG);
+        (void)IoTHubClient_SetOption(iotHubClient, "callbackDispatchThread", &enable);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+#endif
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_Destroy(TEST_IOTHUB_CLIENT_LL_HANDLE));
+#ifndef DONT_USE_UPLOADTOBLOB
+        STRICT_EXPECTED_CALL(mocks, list_destroy(TEST_LIST_HANDLE));
+#endif
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Condition_Deinit(TEST_COND_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_LOCK_HANDLE))
+            .ExpectedTimesExactly(2);
+        EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+
+        // act
+        IoTHubClient_Destroy(iotHubClient);
+
+        // assert
+        mocks.AssertActualAndExpectedCalls();
+    }
+
     /* Tests_SRS_IOTHUBCLIENT_01_042: [ If acquiring the lock fails, IoTHubClient_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_ERROR. ]*/
     TEST_FUNCTION(when_Lock_fails_IoTHubClient_SetOption_fails)
     {
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <cstdlib>
+#include <cstdio>
 #ifdef _CRTDBG_MAP_ALLOC
 #include <crtdbg.h>
 #endif
@@ -14,6 +15,7 @@
 #include "iothubtransport.h"
 
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 
@@ -59,6 +61,7 @@ static bool checkProtocolGatewayHostName;
 static bool checkProtocolGatewayIsNull;
 static size_t howManyDoWorkCalls = 0;
 static size_t doWorkCallCount = 0;
+static IOTHUB_CLIENT_STATUS currentSendStatus;
 extern "C" const size_t IoTHubTransport_ThreadTerminationOffset;
 static THREAD_START_FUNC threadFunc;
 static void* threadFuncArg;
@@ -72,6 +75,7 @@ static void* threadFuncArg;
 #define TEST_IOTHUB_CLIENT_HANDLE2 (IOTHUB_CLIENT_HANDLE)0xDEAF
 #define TEST_LOCK_HANDLE (LOCK_HANDLE)0x4443
 #define TEST_THREAD_HANDLE (THREAD_HANDLE)0x4442
+#define TEST_COND_HANDLE (COND_HANDLE)0x4444
 
 
 
@@ -353,6 +357,27 @@ public:
 	MOCK_STATIC_METHOD_1(, LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle);
 	MOCK_METHOD_END(LOCK_RESULT, LOCK_OK);
 
+	/* Condition mocks */
+	MOCK_STATIC_METHOD_0(, COND_HANDLE, Condition_Init);
+	MOCK_METHOD_END(COND_HANDLE, TEST_COND_HANDLE);
+	MOCK_STATIC_METHOD_1(, COND_RESULT, Condition_Post, COND_HANDLE, handle);
+	MOCK_METHOD_END(COND_RESULT, COND_OK);
+	MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
+		if ((howManyDoWorkCalls > 0) && (howManyDoWorkCalls == doWorkCallCount))
+		{
+			*(sig_atomic_t*)(((char*)threadFuncArg) + IoTHubTransport_ThreadTerminationOffset) = 1; /*tell the thread to stop*/
+		}
+	MOCK_METHOD_END(COND_RESULT, COND_TIMEOUT);
+	MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle);
+	MOCK_VOID_METHOD_END();
+
+	/* IoTHubClient mocks */
+	MOCK_STATIC_METHOD_2(, IOTHUB_CLIENT_RESULT, IoTHubClient_GetSendStatus_NoLock, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus)
+		*iotHubClientStatus = currentSendStatus;
+	MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK);
+	MOCK_STATIC_METHOD_1(, void, IoTHubClient_DrainSendHandoff_NoLock, IOTHUB_CLIENT_HANDLE, iotHubClientHandle)
+	MOCK_VOID_METHOD_END();
+
 };
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void, DList_InitializeListHead, PDLIST_ENTRY, listHead);
@@ -417,6 +442,14 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , LOCK_RESULT, Lock, LOCK_HA
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle);
 
+DECLARE_GLOBAL_MOCK_METHOD_0(CIotHubTransportMocks, , COND_HANDLE, Condition_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CIotHubTransportMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void, Condition_Deinit, COND_HANDLE, handle);
+
+DECLARE_GLOBAL_MOCK_METHOD_2(CIotHubTransportMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_GetSendStatus_NoLock, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void, IoTHubClient_DrainSendHandoff_NoLock, IOTHUB_CLIENT_HANDLE, iotHubClientHandle);
+
 static TRANSPORT_PROVIDER FAKE_transport_provider =
 {
     FAKE_IoTHubTransport_GetHostname,   /*pfIoTHubTransport_GetHostname IoTHubTransport_GetHostname;   */
@@ -464,6 +497,7 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 	checkProtocolGatewayIsNull = false;
 	howManyDoWorkCalls = 0;
 	doWorkCallCount = 0;
+	currentSendStatus = IOTHUB_CLIENT_SEND_STATUS_IDLE;
 
 }
 
@@ -1253,11 +1287,21 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
 	STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
 	STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_DrainSendHandoff_NoLock(TEST_IOTHUB_CLIENT_HANDLE1));
 	STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
 	STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
 
 	STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
 	STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_DrainSendHandoff_NoLock(TEST_IOTHUB_CLIENT_HANDLE1));
 	STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
 	STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
 
@@ -1293,6 +1337,14 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_two_devices_once)
 	STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
 	STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_DrainSendHandoff_NoLock(TEST_IOTHUB_CLIENT_HANDLE1));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_DrainSendHandoff_NoLock(TEST_IOTHUB_CLIENT_HANDLE2));
 	STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
 
 	STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
@@ -1330,6 +1382,14 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_lock_fails)
 	/* DoWork needs to run at least once, so, the number of calls to DoWork increments. */
 	STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
 	STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_DrainSendHandoff_NoLock(TEST_IOTHUB_CLIENT_HANDLE1));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_DrainSendHandoff_NoLock(TEST_IOTHUB_CLIENT_HANDLE2));
 	STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
 	STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
 
@@ -1349,5 +1409,567 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_lock_fails)
 	IoTHubTransport_Destroy(transportHandle);
 }
 
+//Tests_SRS_IOTHUBTRANSPORT_10_001: [ If transportHandle is NULL, IoTHubTransport_SetWorkerIdleWaitTime shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransport_SetWorkerIdleWaitTime_null_transport_returns_bad_arg)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+
+	///act
+	auto result = IoTHubTransport_SetWorkerIdleWaitTime(NULL, 100);
+
+	///assert
+	ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result);
+	mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_002: [ IoTHubTransport_SetWorkerIdleWaitTime shall create the worker condition by calling Condition_Init if it was not created before and idleWaitTime is not 0. ]
+//Tests_SRS_IOTHUBTRANSPORT_10_004: [ IoTHubTransport_SetWorkerIdleWaitTime shall store idleWaitTime, wake up the worker thread so that it picks up the new value and return IOTHUB_CLIENT_OK. ]
+TEST_FUNCTION(IoTHubTransport_SetWorkerIdleWaitTime_creates_the_worker_condition)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+	mocks.ResetAllCalls();
+
+	STRICT_EXPECTED_CALL(mocks, Condition_Init());
+	STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+
+	///act
+	auto result = IoTHubTransport_SetWorkerIdleWaitTime(transportHandle, 100);
+
+	///assert
+	ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_002: [ IoTHubTransport_SetWorkerIdleWaitTime shall create the worker condition by calling Condition_Init if it was not created before and idleWaitTime is not 0. ]
+TEST_FUNCTION(IoTHubTransport_SetWorkerIdleWaitTime_twice_creates_the_worker_condition_once)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+	(void)IoTHubTransport_SetWorkerIdleWaitTime(transportHandle, 100);
+	mocks.ResetAllCalls();
+
+	STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+
+	///act
+	auto result = IoTHubTransport_SetWorkerIdleWaitTime(transportHandle, 0);
+
+	///assert
+	ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_003: [ If Condition_Init fails, IoTHubTransport_SetWorkerIdleWaitTime shall return IOTHUB_CLIENT_ERROR and leave the worker idle wait time unchanged. ]
+TEST_FUNCTION(IoTHubTransport_SetWorkerIdleWaitTime_Condition_Init_fails_returns_error)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+	mocks.ResetAllCalls();
+
+	STRICT_EXPECTED_CALL(mocks, Condition_Init())
+		.SetReturn((COND_HANDLE)NULL);
+
+	///act
+	auto result = IoTHubTransport_SetWorkerIdleWaitTime(transportHandle, 100);
+
+	///assert
+	ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ERROR, result);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_005: [ If transportHandle is NULL, IoTHubTransport_SignalWorkerThread shall do nothing. ]
+TEST_FUNCTION(IoTHubTransport_SignalWorkerThread_null_transport_does_nothing)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+
+	///act
+	IoTHubTransport_SignalWorkerThread(NULL);
+
+	///assert
+	mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_006: [ IoTHubTransport_SignalWorkerThread shall call Condition_Post on the worker condition, if it exists. ]
+TEST_FUNCTION(IoTHubTransport_SignalWorkerThread_without_condition_does_nothing)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+	mocks.ResetAllCalls();
+
+	///act
+	IoTHubTransport_SignalWorkerThread(transportHandle);
+
+	///assert
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_006: [ IoTHubTransport_SignalWorkerThread shall call Condition_Post on the worker condition, if it exists. ]
+TEST_FUNCTION(IoTHubTransport_SignalWorkerThread_posts_the_condition)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+	(void)IoTHubTransport_SetWorkerIdleWaitTime(transportHandle, 100);
+	mocks.ResetAllCalls();
+
+	STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+
+	///act
+	IoTHubTransport_SignalWorkerThread(transportHandle);
+
+	///assert
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_007: [ If the worker idle wait time is not 0 and every IoTHubClient using the thread reports IOTHUB_CLIENT_SEND_STATUS_IDLE, the thread shall wait on the worker condition for at most the worker idle wait time instead of sleeping 1 ms. ]
+TEST_FUNCTION(IoTHubTransport_worker_thread_waits_on_the_condition_when_all_clients_are_idle)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+	(void)IoTHubTransport_SetWorkerIdleWaitTime(transportHandle, 100);
+	(void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+	(void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+	mocks.ResetAllCalls();
+
+	howManyDoWorkCalls = 1;
+	STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_DrainSendHandoff_NoLock(TEST_IOTHUB_CLIENT_HANDLE1));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_DrainSendHandoff_NoLock(TEST_IOTHUB_CLIENT_HANDLE2));
+	STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_GetSendStatus_NoLock(TEST_IOTHUB_CLIENT_HANDLE1, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_GetSendStatus_NoLock(TEST_IOTHUB_CLIENT_HANDLE2, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 100));
+	STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+	STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+	///act
+	threadFunc(threadFuncArg);
+
+	///assert
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+	IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+	IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_007: [ If the worker idle wait time is not 0 and every IoTHubClient using the thread reports IOTHUB_CLIENT_SEND_STATUS_IDLE, the thread shall wait on the worker condition for at most the worker idle wait time instead of sleeping 1 ms. ]
+TEST_FUNCTION(IoTHubTransport_worker_thread_sleeps_1_ms_when_a_client_is_busy)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+	(void)IoTHubTransport_SetWorkerIdleWaitTime(transportHandle, 100);
+	(void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+	(void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+	mocks.ResetAllCalls();
+
+	howManyDoWorkCalls = 1;
+	currentSendStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+	STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_DrainSendHandoff_NoLock(TEST_IOTHUB_CLIENT_HANDLE1));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_DrainSendHandoff_NoLock(TEST_IOTHUB_CLIENT_HANDLE2));
+	STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_GetSendStatus_NoLock(TEST_IOTHUB_CLIENT_HANDLE1, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+
+	STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+	///act
+	threadFunc(threadFuncArg);
+
+	///assert
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+	IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+	IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_008: [ If the worker thread might be waiting on the worker condition, it shall be woken up by calling Condition_Post. ]
+TEST_FUNCTION(IoTHubTransport_SignalEndWorkerThread_wakes_up_the_worker_thread)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+	(void)IoTHubTransport_SetWorkerIdleWaitTime(transportHandle, 100);
+	(void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+	mocks.ResetAllCalls();
+
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+
+	///act
+	auto result = IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+
+	///assert
+	ASSERT_IS_TRUE(result);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_009: [ Before calling lower layer transport DoWork the thread shall call IoTHubClient_DrainSendHandoff_NoLock for every IoTHubClient using the thread. ]
+TEST_FUNCTION(IoTHubTransport_worker_thread_drains_the_send_handoff_of_every_client_before_DoWork)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+	(void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+	(void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+	mocks.ResetAllCalls();
+
+	howManyDoWorkCalls = 1;
+	STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_DrainSendHandoff_NoLock(TEST_IOTHUB_CLIENT_HANDLE1));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_DrainSendHandoff_NoLock(TEST_IOTHUB_CLIENT_HANDLE2));
+	STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
+	STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+
+	STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+	///act
+	threadFunc(threadFuncArg);
+
+	///assert
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+	IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+	IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_10_011: [ IoTHubTransport_CreatePool shall allocate memory for the pool and for transportCount transport handles. ]*/
+/*Tests_SRS_IOTHUBTRANSPORT_10_013: [ IoTHubTransport_CreatePool shall create transportCount transports by calling IoTHubTransport_Create, so that every transport has its own lower layer transport, lock and worker thread. ]*/
+/*Tests_SRS_IOTHUBTRANSPORT_10_015: [ IoTHubTransport_CreatePool shall return a non-NULL handle on success. ]*/
+TEST_FUNCTION(IoTHubTransport_CreatePool_creates_one_transport_per_worker)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(2 * sizeof(TRANSPORT_HANDLE)));
+	for (size_t i = 0; i < 2; i++)
+	{
+		STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Create(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Lock_Init());
+		STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)));
+	}
+
+	///act
+	auto result = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+
+	///assert
+	ASSERT_IS_NOT_NULL(result);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_DestroyPool(result);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_10_010: [ If protocol, iotHubName or iotHubSuffix is NULL, or transportCount is 0, IoTHubTransport_CreatePool shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransport_CreatePool_invalid_args_returns_null)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+
+	///act
+	auto result1 = IoTHubTransport_CreatePool(NULL, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+	auto result2 = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, NULL, TEST_CONFIG.iotHubSuffix, 2);
+	auto result3 = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, NULL, 2);
+	auto result4 = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 0);
+
+	///assert
+	ASSERT_IS_NULL(result1);
+	ASSERT_IS_NULL(result2);
+	ASSERT_IS_NULL(result3);
+	ASSERT_IS_NULL(result4);
+	mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_10_012: [ If memory allocation fails, IoTHubTransport_CreatePool shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransport_CreatePool_alloc_fails_returns_null)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	whenShallmalloc_fail = 1;
+
+	///act
+	auto result = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+
+	///assert
+	ASSERT_IS_NULL(result);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_10_012: [ If memory allocation fails, IoTHubTransport_CreatePool shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransport_CreatePool_handles_alloc_fails_returns_null)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	whenShallmalloc_fail = 2;
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(2 * sizeof(TRANSPORT_HANDLE)));
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	auto result = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+
+	///assert
+	ASSERT_IS_NULL(result);
+	mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_10_014: [ If any IoTHubTransport_Create fails, IoTHubTransport_CreatePool shall destroy the transports it created, free the pool and return NULL. ]*/
+TEST_FUNCTION(IoTHubTransport_CreatePool_second_transport_fails_destroys_the_first_one)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	whenShallmalloc_fail = 4;
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(2 * sizeof(TRANSPORT_HANDLE)));
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Create(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Lock_Init());
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)));
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+
+	STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	auto result = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+
+	///assert
+	ASSERT_IS_NULL(result);
+	mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_10_016: [ If poolHandle is NULL, IoTHubTransport_DestroyPool shall do nothing. ]*/
+TEST_FUNCTION(IoTHubTransport_DestroyPool_null_handle_does_nothing)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+
+	///act
+	IoTHubTransport_DestroyPool(NULL);
+
+	///assert
+	mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_10_017: [ IoTHubTransport_DestroyPool shall call IoTHubTransport_Destroy for every transport of the pool and free the pool. ]*/
+TEST_FUNCTION(IoTHubTransport_DestroyPool_destroys_every_transport)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	auto poolHandle = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+	mocks.ResetAllCalls();
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+	}
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	IoTHubTransport_DestroyPool(poolHandle);
+
+	///assert
+	mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_10_018: [ If poolHandle or deviceId is NULL, IoTHubTransport_GetPoolTransport shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransport_GetPoolTransport_invalid_args_returns_null)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	auto poolHandle = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+	mocks.ResetAllCalls();
+
+	///act
+	auto result1 = IoTHubTransport_GetPoolTransport(NULL, TEST_DEVICE_ID);
+	auto result2 = IoTHubTransport_GetPoolTransport(poolHandle, NULL);
+
+	///assert
+	ASSERT_IS_NULL(result1);
+	ASSERT_IS_NULL(result2);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_DestroyPool(poolHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_10_019: [ IoTHubTransport_GetPoolTransport shall return the transport of the pool with the highest weight computed from deviceId and the transport index (rendezvous hashing), so that a device id always maps to the same transport of a pool and devices spread evenly over the transports. ]*/
+TEST_FUNCTION(IoTHubTransport_GetPoolTransport_same_device_gets_the_same_transport)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	auto poolHandle = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 4);
+	mocks.ResetAllCalls();
+
+	///act
+	auto result1 = IoTHubTransport_GetPoolTransport(poolHandle, TEST_DEVICE_ID);
+	auto result2 = IoTHubTransport_GetPoolTransport(poolHandle, TEST_DEVICE_ID);
+
+	///assert
+	ASSERT_IS_NOT_NULL(result1);
+	ASSERT_ARE_EQUAL(void_ptr, result1, result2);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_DestroyPool(poolHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_10_019: [ IoTHubTransport_GetPoolTransport shall return the transport of the pool with the highest weight computed from deviceId and the transport index (rendezvous hashing), so that a device id always maps to the same transport of a pool and devices spread evenly over the transports. ]*/
+TEST_FUNCTION(IoTHubTransport_GetPoolTransport_spreads_devices_over_the_transports)
+{
+	CIotHubTransportMocks mocks;
+	///arrange
+	TRANSPORT_HANDLE transports[4] = { NULL, NULL, NULL, NULL };
+	size_t deviceCount[4] = { 0, 0, 0, 0 };
+	auto poolHandle = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 4);
+	mocks.ResetAllCalls();
+
+	///act
+	for (int device = 0; device < 100; device++)
+	{
+		char deviceId[32];
+		(void)sprintf(deviceId, "device%d", device);
+		TRANSPORT_HANDLE transport = IoTHubTransport_GetPoolTransport(poolHandle, deviceId);
+		size_t i;
+		for (i = 0; i < 4; i++)
+		{
+			if (transports[i] == NULL)
+			{
+				transports[i] = transport;
+			}
+			if (transports[i] == transport)
+			{
+				deviceCount[i]++;
+				break;
+			}
+		}
+		ASSERT_IS_TRUE(i < 4);
+	}
+
+	///assert
+	for (size_t i = 0; i < 4; i++)
+	{
+		ASSERT_IS_NOT_NULL(transports[i]);
+		ASSERT_IS_TRUE(deviceCount[i] >= 10);
+	}
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	IoTHubTransport_DestroyPool(poolHandle);
+}
+
 END_TEST_SUITE(iothubtransport_ut)
 
@@ -30,6 +30,7 @@ static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
 #include "azure_c_shared_utility/macro_utils.h"
 #include "azure_c_shared_utility/map.h"
 #include "azure_c_shared_utility/wsio.h"
+#include "azure_c_shared_utility/tickcounter.h"
 
 #include "uamqp_messaging.h"
 #include "iothubtransportamqp.h"
@@ -147,6 +148,9 @@ std::ostream& operator<<(std::ostream& left, const BINARY_DATA bindata)
 #define TEST_MESSAGE_SENDER_LINK_NAME "sender-link"
 #define TEST_MESSAGE_SENDER_SOURCE_ADDRESS "ingress"
 #define TEST_MESSAGE_SENDER_MAX_LINK_SIZE UINT64_MAX
+#define TEST_PEER_MAX_MESSAGE_SIZE 262144
+#define TEST_BATCHING_FORMAT_CODE 0x80013700
+#define TEST_ENCODED_EVENT_SIZE 10
 #define TEST_SAS_TOKEN_LIFETIME_MS 3600000
 #define TEST_CBS_REQUEST_TIMEOUT_MS 30000
 
@@ -203,6 +207,7 @@ std::ostream& operator<<(std::ostream& left, const BINARY_DATA bindata)
 #define TEST_AMQP_DISPOSITION_ACCEPTED (AMQP_VALUE)0x450
 #define TEST_AMQP_DISPOSITION_ABANDONED (AMQP_VALUE)0x451
 #define TEST_AMQP_DISPOSITION_REJECTED (AMQP_VALUE)0x452
+#define TEST_TICK_COUNTER_HANDLE (TICK_COUNTER_HANDLE)0x460
 
 
 static const char* const no_property_keys[] = { "test_property_key" };
@@ -225,6 +230,9 @@ static int test_number_of_event_confirmation_callbacks_invoked;
 static int test_sum_of_event_confirmation_callback_contexts;
 static BINARY_DATA test_binary_data;
 static MESSAGE_BODY_TYPE test_message_get_body_type = MESSAGE_BODY_TYPE_DATA;
+static ON_MESSAGE_SEND_COMPLETE test_latest_messagesender_send_callback;
+static void* test_latest_messagesender_send_context;
+static uint64_t test_current_ms;
 
 static bool fail_malloc = false;
 static bool fail_STRING_new = false;
@@ -374,6 +382,10 @@ public:
         BASEIMPLEMENTATION::DList_InsertTailList(listHead, listEntry);
     MOCK_VOID_METHOD_END()
 
+    MOCK_STATIC_METHOD_2(, void, DList_InsertHeadList, PDLIST_ENTRY, listHead, PDLIST_ENTRY, listEntry)
+        BASEIMPLEMENTATION::DList_InsertHeadList(listHead, listEntry);
+    MOCK_VOID_METHOD_END()
+
     MOCK_STATIC_METHOD_2(, void, DList_AppendTailList, PDLIST_ENTRY, listHead, PDLIST_ENTRY, ListToAppend)
         BASEIMPLEMENTATION::DList_AppendTailList(listHead, ListToAppend);
     MOCK_VOID_METHOD_END()
@@ -483,6 +495,22 @@ public:
         }
     MOCK_VOID_METHOD_END();
 
+    MOCK_STATIC_METHOD_2(, void, IoTHubClient_LL_UntrackCompletedMessage, IOTHUB_MESSAGE_LIST*, messageList, IOTHUB_CLIENT_CONFIRMATION_RESULT, result)
+    MOCK_VOID_METHOD_END();
+
+    MOCK_STATIC_METHOD_1(, void, IoTHubClient_LL_ReleaseMessageList, IOTHUB_MESSAGE_LIST*, messageList)
+        BASEIMPLEMENTATION::gballoc_free(messageList);
+    MOCK_VOID_METHOD_END();
+
+    MOCK_STATIC_METHOD_1(, void, IoTHubClient_LL_SuspendMessageTimeout, IOTHUB_MESSAGE_LIST*, messageList)
+    MOCK_VOID_METHOD_END();
+
+    MOCK_STATIC_METHOD_1(, void, IoTHubClient_LL_CountRetry, IOTHUB_CLIENT_LL_HANDLE, handle)
+    MOCK_VOID_METHOD_END();
+
+    MOCK_STATIC_METHOD_1(, void, IoTHubClient_LL_ResumeMessageTimeout, IOTHUB_MESSAGE_LIST*, messageList)
+    MOCK_VOID_METHOD_END();
+
     MOCK_STATIC_METHOD_1(, time_t, get_time, time_t*, t)
     MOCK_METHOD_END(time_t, 0);
 
@@ -656,6 +684,13 @@ public:
     MOCK_STATIC_METHOD_2(, int, link_set_max_message_size, LINK_HANDLE, link, uint64_t, max_message_size)
     MOCK_METHOD_END(int, 0)
         
+    MOCK_STATIC_METHOD_2(, int, link_get_peer_max_message_size, LINK_HANDLE, link, uint64_t*, peer_max_message_size)
+        *peer_max_message_size = TEST_PEER_MAX_MESSAGE_SIZE;
+    MOCK_METHOD_END(int, 0)
+
+    MOCK_STATIC_METHOD_2(, int, link_set_max_link_credit, LINK_HANDLE, link, uint32_t, max_link_credit)
+    MOCK_METHOD_END(int, 0)
+
     MOCK_STATIC_METHOD_2(, int, link_set_rcv_settle_mode, LINK_HANDLE, link, receiver_settle_mode, rcv_settle_mode)
     MOCK_METHOD_END(int, 0)
 
@@ -682,6 +717,9 @@ public:
     MOCK_STATIC_METHOD_1(, void, message_destroy, MESSAGE_HANDLE, message)
     MOCK_VOID_METHOD_END()
 
+    MOCK_STATIC_METHOD_2(, int, message_set_message_format, MESSAGE_HANDLE, message, uint32_t, message_format)
+    MOCK_METHOD_END(int, 0)
+
     MOCK_STATIC_METHOD_3(, int, message_get_body_amqp_data, MESSAGE_HANDLE, message, size_t, index, BINARY_DATA*, binary_data)
         saved_message_get_body_amqp_data_binary_data = binary_data;
     MOCK_METHOD_END(int, 0)
@@ -724,6 +762,8 @@ public:
     MOCK_METHOD_END(int, 0)
 
     MOCK_STATIC_METHOD_4(, int, messagesender_send, MESSAGE_SENDER_HANDLE, message_sender, MESSAGE_HANDLE, message, ON_MESSAGE_SEND_COMPLETE, on_message_send_complete, void*, callback_context)
+        test_latest_messagesender_send_callback = on_message_send_complete;
+        test_latest_messagesender_send_context = callback_context;
     MOCK_METHOD_END(int, 0)
 
     // messaging.h
@@ -842,6 +882,17 @@ public:
     MOCK_METHOD_END(OPTIONHANDLER_HANDLE, result2)
 
 
+    // tickcounter.h
+    MOCK_STATIC_METHOD_0(, TICK_COUNTER_HANDLE, tickcounter_create)
+    MOCK_METHOD_END(TICK_COUNTER_HANDLE, TEST_TICK_COUNTER_HANDLE)
+
+    MOCK_STATIC_METHOD_1(, void, tickcounter_destroy, TICK_COUNTER_HANDLE, tick_counter)
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, int, tickcounter_get_current_ms, TICK_COUNTER_HANDLE, tick_counter, uint64_t*, current_ms)
+        *current_ms = test_current_ms;
+    MOCK_METHOD_END(int, 0)
+
 	// uamqp_messaging.h
 	MOCK_STATIC_METHOD_2(, int, message_create_from_iothub_message, IOTHUB_MESSAGE_HANDLE, iothub_message, MESSAGE_HANDLE*, uamqp_message)
 		*uamqp_message = TEST_MESSAGE_HANDLE;
@@ -850,6 +901,11 @@ public:
 	MOCK_STATIC_METHOD_2(, int, IoTHubMessage_CreateFromUamqpMessage, MESSAGE_HANDLE, uamqp_message, IOTHUB_MESSAGE_HANDLE*, iothub_message)
 		*iothub_message = TEST_IOTHUB_MESSAGE_HANDLE;
 	MOCK_METHOD_END(int, 0)
+
+	MOCK_STATIC_METHOD_2(, int, message_create_uamqp_encoding_from_iothub_message, IOTHUB_MESSAGE_HANDLE, iothub_message, BINARY_DATA*, body_binary_data)
+		body_binary_data->bytes = (const unsigned char*)BASEIMPLEMENTATION::gballoc_malloc(TEST_ENCODED_EVENT_SIZE);
+		body_binary_data->length = TEST_ENCODED_EVENT_SIZE;
+	MOCK_METHOD_END(int, 0)
 };
 
 // ** End Mocks **
@@ -870,6 +926,7 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , const char*, IoTHubMes
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , void, DList_InitializeListHead, PDLIST_ENTRY, listHead);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , int, DList_IsListEmpty, PDLIST_ENTRY, listHead);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , void, DList_InsertTailList, PDLIST_ENTRY, listHead, PDLIST_ENTRY, listEntry);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , void, DList_InsertHeadList, PDLIST_ENTRY, listHead, PDLIST_ENTRY, listEntry);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , void, DList_AppendTailList, PDLIST_ENTRY, listHead, PDLIST_ENTRY, ListToAppend);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , int, DList_RemoveEntryList, PDLIST_ENTRY, listEntry);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , PDLIST_ENTRY, DList_RemoveHeadList, PDLIST_ENTRY, listHead);
@@ -901,6 +958,11 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , void, gballoc_free, vo
 
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , IOTHUBMESSAGE_DISPOSITION_RESULT, IoTHubClient_LL_MessageCallback, IOTHUB_CLIENT_LL_HANDLE, handle, IOTHUB_MESSAGE_HANDLE, messageHandle);
 DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubTransportAMQPMocks, , void, IoTHubClient_LL_SendComplete, IOTHUB_CLIENT_LL_HANDLE, handle, PDLIST_ENTRY, completedMessages, IOTHUB_CLIENT_CONFIRMATION_RESULT, batchResult);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , void, IoTHubClient_LL_UntrackCompletedMessage, IOTHUB_MESSAGE_LIST*, messageList, IOTHUB_CLIENT_CONFIRMATION_RESULT, result);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , void, IoTHubClient_LL_ReleaseMessageList, IOTHUB_MESSAGE_LIST*, messageList);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , void, IoTHubClient_LL_SuspendMessageTimeout, IOTHUB_MESSAGE_LIST*, messageList);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , void, IoTHubClient_LL_CountRetry, IOTHUB_CLIENT_LL_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , void, IoTHubClient_LL_ResumeMessageTimeout, IOTHUB_MESSAGE_LIST*, messageList);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , time_t, get_time, time_t*, t);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , struct tm*, get_gmtime, time_t*, t);
@@ -989,6 +1051,8 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , void, connection_set_t
 // link.h
 DECLARE_GLOBAL_MOCK_METHOD_5(CIoTHubTransportAMQPMocks, , LINK_HANDLE, link_create, SESSION_HANDLE, session, const char*, name, role, _role, AMQP_VALUE, source, AMQP_VALUE, target);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, link_set_max_message_size, LINK_HANDLE, link, uint64_t, max_message_size);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, link_get_peer_max_message_size, LINK_HANDLE, link, uint64_t*, peer_max_message_size);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, link_set_max_link_credit, LINK_HANDLE, link, uint32_t, max_link_credit);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, link_set_rcv_settle_mode, LINK_HANDLE, link, receiver_settle_mode, rcv_settle_mode);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , void, link_destroy, LINK_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, link_set_attach_properties, LINK_HANDLE, link, fields, attach_properties);
@@ -998,6 +1062,7 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, link_set_attach_p
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, message_add_body_amqp_data, MESSAGE_HANDLE, message, BINARY_DATA, binary_data);
 DECLARE_GLOBAL_MOCK_METHOD_0(CIoTHubTransportAMQPMocks, , MESSAGE_HANDLE, message_create);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , void, message_destroy, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, message_set_message_format, MESSAGE_HANDLE, message, uint32_t, message_format);
 DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubTransportAMQPMocks, , int, message_get_body_amqp_data, MESSAGE_HANDLE, message, size_t, index, BINARY_DATA*, binary_data);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, message_get_body_type, MESSAGE_HANDLE, message, MESSAGE_BODY_TYPE*, body_type);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, message_get_properties, MESSAGE_HANDLE, message, PROPERTIES_HANDLE*, properties);
@@ -1066,8 +1131,14 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , OPTIONHANDLER_RESULT,
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , void, OptionHandler_Destroy, OPTIONHANDLER_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , OPTIONHANDLER_HANDLE, xio_retrieveoptions, XIO_HANDLE, xio);
 
+// tickcounter.h
+DECLARE_GLOBAL_MOCK_METHOD_0(CIoTHubTransportAMQPMocks, , TICK_COUNTER_HANDLE, tickcounter_create);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportAMQPMocks, , void, tickcounter_destroy, TICK_COUNTER_HANDLE, tick_counter);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, tickcounter_get_current_ms, TICK_COUNTER_HANDLE, tick_counter, uint64_t*, current_ms);
+
 // uamqp_messaging.h
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, message_create_from_iothub_message, IOTHUB_MESSAGE_HANDLE, iothub_message, MESSAGE_HANDLE*, uamqp_message);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, message_create_uamqp_encoding_from_iothub_message, IOTHUB_MESSAGE_HANDLE, iothub_message, BINARY_DATA*, body_binary_data);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportAMQPMocks, , int, IoTHubMessage_CreateFromUamqpMessage, MESSAGE_HANDLE, uamqp_message, IOTHUB_MESSAGE_HANDLE*, iothub_message);
 
 // Auxiliary Functions
@@ -1332,6 +1403,7 @@ static void setExpectedCallsForSendPendingEvents_SingleEvent(CIoTHubTransportAMQ
 
     EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, IoTHubClient_LL_SuspendMessageTimeout(IGNORED_PTR_ARG));
 
 	STRICT_EXPECTED_CALL(mocks, message_create_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2).SetReturn(0);
 
@@ -1350,6 +1422,39 @@ static void setExpectedCallsForSendPendingEvents(CIoTHubTransportAMQPMocks& mock
     EXPECTED_CALL(mocks, DList_IsListEmpty(IGNORED_PTR_ARG)).SetReturn(1);
 }
 
+#ifndef DONT_USE_AMQP_BATCHING
+static void setExpectedCallsForSendPendingEventsInOneBatch(CIoTHubTransportAMQPMocks& mocks, int numberOfEvents)
+{
+    (void)mocks;
+    EXPECTED_CALL(mocks, DList_IsListEmpty(IGNORED_PTR_ARG)).SetReturn(0);
+    EXPECTED_CALL(mocks, gballoc_malloc(0));
+    STRICT_EXPECTED_CALL(mocks, message_create()).SetReturn(TEST_MESSAGE_HANDLE);
+    STRICT_EXPECTED_CALL(mocks, message_set_message_format(TEST_MESSAGE_HANDLE, TEST_BATCHING_FORMAT_CODE));
+    STRICT_EXPECTED_CALL(mocks, link_get_peer_max_message_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).IgnoreAllArguments();
+
+    for (int i = 0; i < numberOfEvents; i++)
+    {
+        EXPECTED_CALL(mocks, DList_IsListEmpty(IGNORED_PTR_ARG)).SetReturn(0);
+        STRICT_EXPECTED_CALL(mocks, message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
+        EXPECTED_CALL(mocks, message_add_body_amqp_data(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+        if (i == 0)
+        {
+            EXPECTED_CALL(mocks, gballoc_realloc(0, 0));
+        }
+        EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG));
+        EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        EXPECTED_CALL(mocks, IoTHubClient_LL_SuspendMessageTimeout(IGNORED_PTR_ARG));
+        EXPECTED_CALL(mocks, gballoc_free(0));
+    }
+
+    EXPECTED_CALL(mocks, DList_IsListEmpty(IGNORED_PTR_ARG)).SetReturn(1);
+    STRICT_EXPECTED_CALL(mocks, messagesender_send(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1).IgnoreArgument(3).IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(mocks, message_destroy(TEST_MESSAGE_HANDLE));
+    EXPECTED_CALL(mocks, DList_IsListEmpty(IGNORED_PTR_ARG)).SetReturn(1);
+}
+#endif /*DONT_USE_AMQP_BATCHING*/
+
 static void setExpectedCallsForConnectionDoWork(CIoTHubTransportAMQPMocks& mocks)
 {
     (void)mocks;
@@ -1391,6 +1496,7 @@ static void setExpectedCallsForTransportDestroy(CIoTHubTransportAMQPMocks& mocks
         EXPECTED_CALL(mocks, DList_RemoveEntryList(0));
         EXPECTED_CALL(mocks, DList_InitializeListHead(0));
         EXPECTED_CALL(mocks, DList_InsertTailList(0, 0));
+        EXPECTED_CALL(mocks, IoTHubClient_LL_ResumeMessageTimeout(0));
     }
 
     EXPECTED_CALL(mocks, gballoc_free(NULL));
@@ -2142,6 +2248,7 @@ TEST_FUNCTION(AMQP_Create_deviceKey_copy_fails)
 // Tests_SRS_IOTHUBTRANSPORTAMQP_09_034: [IoTHubTransportAMQP_Destroy shall destroy the AMQP TLS I/O transport.] 
 // Tests_SRS_IOTHUBTRANSPORTAMQP_09_035: [IoTHubTransportAMQP_Destroy shall delete its internally - set parameters(deviceKey, targetAddress, devicesPath, sasTokenKeyName).]
 // Tests_SRS_IOTHUBTRANSPORTAMQP_09_036: [IoTHubTransportAMQP_Destroy shall return the remaining items in inProgress to waitingToSend list.] 
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_020: [IoTHubTransportAMQP_DoWork shall suspend the timeout of an event it moves to the in-progress list using IoTHubClient_LL_SuspendMessageTimeout(), and resume it using IoTHubClient_LL_ResumeMessageTimeout() when the event is rolled back to waitToSend.]
 TEST_FUNCTION(AMQP_Destroy_succeeds_no_DoWork)
 {
     // arrange
@@ -3085,7 +3192,348 @@ TEST_FUNCTION(AMQP_DoWork_expired_SASToken_fails)
     transport_interface->IoTHubTransport_Destroy(transport);
 }
 
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_003: [If the transport has a NULL connection and IoTHubClient_RetryPolicy_IsWaiting returns true, IoTHubTransportAMQP_DoWork shall establish the connection only if IoTHubClient_RetryPolicy_CanAttempt returns true for the current time in milliseconds from tickcounter_get_current_ms(), and otherwise return without doing anything else. The tick counter shall be created with tickcounter_create() if the transport has none yet. If the tick counter cannot be created or read the connection shall be established.]
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_004: [Every time the connection is flagged to be re-established, IoTHubTransportAMQP_DoWork shall report the failure to the retry policy with IoTHubClient_RetryPolicy_OnFailure.]
+TEST_FUNCTION(AMQP_DoWork_after_a_connection_failure_waits_for_the_retry_delay)
+{
+    // arrange
+    CIoTHubTransportAMQPMocks mocks;
+
+    DLIST_ENTRY wts;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&wts);
+    TRANSPORT_PROVIDER* transport_interface = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_CLIENT_CONFIG client_config = { (IOTHUB_CLIENT_TRANSPORT_PROVIDER)transport_interface,
+        TEST_DEVICE_ID, TEST_DEVICE_KEY, NULL, TEST_IOT_HUB_NAME, TEST_IOT_HUB_SUFFIX, TEST_PROT_GW_HOSTNAME };
+    IOTHUBTRANSPORT_CONFIG config = { &client_config, &wts };
+    time_t current_time = time(NULL);
+    time_t expiration_time = addSecondsToTime(current_time, (TEST_SAS_TOKEN_LIFETIME_MS / 2) / 1000 + 1);
+    size_t retryDelay = 3600000;
+
+    TRANSPORT_LL_HANDLE transport = transport_interface->IoTHubTransport_Create(&config);
+    (void)transport_interface->IoTHubTransport_SetOption(transport, OPTION_RETRY_INITIAL_DELAY, &retryDelay);
+    (void)transport_interface->IoTHubTransport_SetOption(transport, OPTION_RETRY_MAX_DELAY, &retryDelay);
+    srand(1);
+
+    mocks.ResetAllCalls();
+    setExpectedCallsForTransportDoWorkUpTo(mocks, STEP_DOWORK_OPEN_CBS, DOWORK_MESSAGERECEIVER_NONE, current_time);
+    setExpectedCallsForCbsAuthentication(mocks, current_time);
+    setExpectedCallsForCbsAuthTimeoutCheck(mocks, current_time);
+    setExpectedCallsForConnectionDoWork(mocks);
+    setExpectedCallsForSASTokenExpiryCheck(mocks, expiration_time);
+    setExpectedCallsForGetSecondsSinceEpoch(mocks, current_time);
+    EXPECTED_CALL(mocks, SASToken_Create(NULL, NULL, NULL, 0)).SetReturn((STRING_HANDLE)NULL);
+    setExpectedCallsForConnectionDestroyUpTo(mocks, STEP_DOWORK_CREATE_CBS);
+    STRICT_EXPECTED_CALL(mocks, tickcounter_create());
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+
+    // act
+    transport_interface->IoTHubTransport_DoWork(transport, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    test_latest_cbs_put_token_callback(test_latest_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, NULL);
+    transport_interface->IoTHubTransport_DoWork(transport, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    transport_interface->IoTHubTransport_DoWork(transport, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+
+    // cleanup
+    transport_interface->IoTHubTransport_Destroy(transport);
+}
+
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_006: [IotHubTransportAMQP_SetOption shall pass the value to IoTHubClient_RetryPolicy_SetOption if the option name is "retryInitialDelay" or "retryMaxDelay" (size_t, milliseconds), returning IOTHUB_CLIENT_OK]
+TEST_FUNCTION(AMQP_SetOption_retryMaxDelay_succeeds)
+{
+    // arrange
+    CIoTHubTransportAMQPMocks mocks;
+
+    DLIST_ENTRY wts;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&wts);
+    TRANSPORT_PROVIDER* transport_interface = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_CLIENT_CONFIG client_config = { (IOTHUB_CLIENT_TRANSPORT_PROVIDER)transport_interface,
+        TEST_DEVICE_ID, TEST_DEVICE_KEY, NULL, TEST_IOT_HUB_NAME, TEST_IOT_HUB_SUFFIX, TEST_PROT_GW_HOSTNAME };
+    IOTHUBTRANSPORT_CONFIG config = { &client_config, &wts };
+    size_t retryMaxDelay = 0;
+
+    TRANSPORT_LL_HANDLE transport = transport_interface->IoTHubTransport_Create(&config);
+
+    mocks.ResetAllCalls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = transport_interface->IoTHubTransport_SetOption(transport, OPTION_RETRY_MAX_DELAY, &retryMaxDelay);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    // cleanup
+    transport_interface->IoTHubTransport_Destroy(transport);
+}
+
+#ifndef DONT_USE_AMQP_LINK_CREDIT
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_015: [IotHubTransportAMQP_SetOption shall save the value if the option name is "amqp_receiver_link_credit" (size_t, up to UINT32_MAX), returning IOTHUB_CLIENT_OK, and set it with link_set_max_link_credit() on the current message receiver link, if any, and on the ones created afterwards; 0, the default, keeps the uAMQP link credit.]
+TEST_FUNCTION(AMQP_SetOption_amqp_receiver_link_credit_succeeds)
+#else
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_022: [If the transport is built against a uAMQP that does not provide link_set_max_link_credit() (DONT_USE_AMQP_LINK_CREDIT), IotHubTransportAMQP_SetOption shall return IOTHUB_CLIENT_ERROR if the option name is "amqp_receiver_link_credit" and the value is not 0, and IOTHUB_CLIENT_OK if it is 0; the message receiver link always keeps the uAMQP link credit.]
+TEST_FUNCTION(AMQP_SetOption_amqp_receiver_link_credit_fails_without_link_credit_support)
+#endif
+{
+    // arrange
+    CIoTHubTransportAMQPMocks mocks;
+
+    DLIST_ENTRY wts;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&wts);
+    TRANSPORT_PROVIDER* transport_interface = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_CLIENT_CONFIG client_config = { (IOTHUB_CLIENT_TRANSPORT_PROVIDER)transport_interface,
+        TEST_DEVICE_ID, TEST_DEVICE_KEY, NULL, TEST_IOT_HUB_NAME, TEST_IOT_HUB_SUFFIX, TEST_PROT_GW_HOSTNAME };
+    IOTHUBTRANSPORT_CONFIG config = { &client_config, &wts };
+    size_t link_credit = 100;
+
+    TRANSPORT_LL_HANDLE transport = transport_interface->IoTHubTransport_Create(&config);
+
+    mocks.ResetAllCalls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = transport_interface->IoTHubTransport_SetOption(transport, OPTION_AMQP_RECEIVER_LINK_CREDIT, &link_credit);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+#ifndef DONT_USE_AMQP_LINK_CREDIT
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+#else
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+#endif
+
+    // cleanup
+    transport_interface->IoTHubTransport_Destroy(transport);
+}
+
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_013: [IotHubTransportAMQP_SetOption shall save the value if the option name is "amqp_incoming_window" or "amqp_outgoing_window" (size_t, 1 to UINT32_MAX, in transfer frames), returning IOTHUB_CLIENT_OK, and set it on the current AMQP session, if any, with session_set_incoming_window() or session_set_outgoing_window(); a value out of range shall make it return IOTHUB_CLIENT_INVALID_ARG.]
+TEST_FUNCTION(AMQP_SetOption_amqp_outgoing_window_applies_it_to_the_current_session)
+{
+    // arrange
+    CIoTHubTransportAMQPMocks mocks;
+
+    DLIST_ENTRY wts;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&wts);
+    TRANSPORT_PROVIDER* transport_interface = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_CLIENT_CONFIG client_config = { (IOTHUB_CLIENT_TRANSPORT_PROVIDER)transport_interface,
+        TEST_DEVICE_ID, TEST_DEVICE_KEY, NULL, TEST_IOT_HUB_NAME, TEST_IOT_HUB_SUFFIX, TEST_PROT_GW_HOSTNAME };
+    IOTHUBTRANSPORT_CONFIG config = { &client_config, &wts };
+    time_t current_time = time(NULL);
+    size_t outgoing_window = 500;
+
+    TRANSPORT_LL_HANDLE transport = transport_interface->IoTHubTransport_Create(&config);
+
+    setExpectedCallsForTransportDoWorkUpTo(mocks, STEP_DOWORK_OPEN_CBS, DOWORK_MESSAGERECEIVER_NONE, current_time);
+    setExpectedCallsForCbsAuthentication(mocks, current_time);
+    setExpectedCallsForCbsAuthTimeoutCheck(mocks, current_time);
+    setExpectedCallsForConnectionDoWork(mocks);
+    setExpectedCallsForSASTokenExpiryCheck(mocks, current_time);
+    setExpectedCallsForCreateEventSender(mocks);
+    setExpectedCallsForSendPendingEvents(mocks, IOTHUBMESSAGE_STRING, 0);
+    setExpectedCallsForConnectionDoWork(mocks);
+    transport_interface->IoTHubTransport_DoWork(transport, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    test_latest_cbs_put_token_callback(test_latest_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, NULL);
+    transport_interface->IoTHubTransport_DoWork(transport, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    mocks.ResetAllCalls();
+    STRICT_EXPECTED_CALL(mocks, session_set_incoming_window(TEST_SESSION, TEST_INCOMING_WINDOW_SIZE));
+    STRICT_EXPECTED_CALL(mocks, session_set_outgoing_window(TEST_SESSION, 500));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = transport_interface->IoTHubTransport_SetOption(transport, OPTION_AMQP_OUTGOING_WINDOW, &outgoing_window);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    // cleanup
+    transport_interface->IoTHubTransport_Destroy(transport);
+}
+
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_013: [IotHubTransportAMQP_SetOption shall save the value if the option name is "amqp_incoming_window" or "amqp_outgoing_window" (size_t, 1 to UINT32_MAX, in transfer frames), returning IOTHUB_CLIENT_OK, and set it on the current AMQP session, if any, with session_set_incoming_window() or session_set_outgoing_window(); a value out of range shall make it return IOTHUB_CLIENT_INVALID_ARG.]
+TEST_FUNCTION(AMQP_SetOption_amqp_incoming_window_0_fails)
+{
+    // arrange
+    CIoTHubTransportAMQPMocks mocks;
+
+    DLIST_ENTRY wts;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&wts);
+    TRANSPORT_PROVIDER* transport_interface = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_CLIENT_CONFIG client_config = { (IOTHUB_CLIENT_TRANSPORT_PROVIDER)transport_interface,
+        TEST_DEVICE_ID, TEST_DEVICE_KEY, NULL, TEST_IOT_HUB_NAME, TEST_IOT_HUB_SUFFIX, TEST_PROT_GW_HOSTNAME };
+    IOTHUBTRANSPORT_CONFIG config = { &client_config, &wts };
+    size_t incoming_window = 0;
+
+    TRANSPORT_LL_HANDLE transport = transport_interface->IoTHubTransport_Create(&config);
+
+    mocks.ResetAllCalls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = transport_interface->IoTHubTransport_SetOption(transport, OPTION_AMQP_INCOMING_WINDOW, &incoming_window);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    // cleanup
+    transport_interface->IoTHubTransport_Destroy(transport);
+}
+
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_016: [IotHubTransportAMQP_SetOption shall turn the adaptive mode on or off if the option name is "amqp_adaptive_windows" (bool), returning IOTHUB_CLIENT_OK, and apply the resulting windows and credit to the current session and receiver link; the first time it is turned on, a tick counter shall be created with tickcounter_create() if the transport has none yet, and if that fails IotHubTransportAMQP_SetOption shall return IOTHUB_CLIENT_ERROR.]
+TEST_FUNCTION(AMQP_SetOption_amqp_adaptive_windows_creates_the_tick_counter)
+{
+    // arrange
+    CIoTHubTransportAMQPMocks mocks;
+
+    DLIST_ENTRY wts;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&wts);
+    TRANSPORT_PROVIDER* transport_interface = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_CLIENT_CONFIG client_config = { (IOTHUB_CLIENT_TRANSPORT_PROVIDER)transport_interface,
+        TEST_DEVICE_ID, TEST_DEVICE_KEY, NULL, TEST_IOT_HUB_NAME, TEST_IOT_HUB_SUFFIX, TEST_PROT_GW_HOSTNAME };
+    IOTHUBTRANSPORT_CONFIG config = { &client_config, &wts };
+    bool adaptive_windows = true;
+
+    TRANSPORT_LL_HANDLE transport = transport_interface->IoTHubTransport_Create(&config);
+
+    mocks.ResetAllCalls();
+    STRICT_EXPECTED_CALL(mocks, tickcounter_create());
+
+    // act
+    IOTHUB_CLIENT_RESULT result = transport_interface->IoTHubTransport_SetOption(transport, OPTION_AMQP_ADAPTIVE_WINDOWS, &adaptive_windows);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    // cleanup
+    transport_interface->IoTHubTransport_Destroy(transport);
+}
+
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_016: [IotHubTransportAMQP_SetOption shall turn the adaptive mode on or off if the option name is "amqp_adaptive_windows" (bool), returning IOTHUB_CLIENT_OK, and apply the resulting windows and credit to the current session and receiver link; the first time it is turned on, a tick counter shall be created with tickcounter_create() if the transport has none yet, and if that fails IotHubTransportAMQP_SetOption shall return IOTHUB_CLIENT_ERROR.]
+TEST_FUNCTION(AMQP_SetOption_amqp_adaptive_windows_fails_when_tickcounter_create_fails)
+{
+    // arrange
+    CIoTHubTransportAMQPMocks mocks;
+
+    DLIST_ENTRY wts;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&wts);
+    TRANSPORT_PROVIDER* transport_interface = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_CLIENT_CONFIG client_config = { (IOTHUB_CLIENT_TRANSPORT_PROVIDER)transport_interface,
+        TEST_DEVICE_ID, TEST_DEVICE_KEY, NULL, TEST_IOT_HUB_NAME, TEST_IOT_HUB_SUFFIX, TEST_PROT_GW_HOSTNAME };
+    IOTHUBTRANSPORT_CONFIG config = { &client_config, &wts };
+    bool adaptive_windows = true;
+
+    TRANSPORT_LL_HANDLE transport = transport_interface->IoTHubTransport_Create(&config);
+
+    mocks.ResetAllCalls();
+    STRICT_EXPECTED_CALL(mocks, tickcounter_create()).SetReturn((TICK_COUNTER_HANDLE)NULL);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = transport_interface->IoTHubTransport_SetOption(transport, OPTION_AMQP_ADAPTIVE_WINDOWS, &adaptive_windows);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+
+    // cleanup
+    transport_interface->IoTHubTransport_Destroy(transport);
+}
+
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_019: [IoTHubTransportAMQP_Destroy shall destroy the tick counter of the adaptive mode, if any, with tickcounter_destroy().]
+TEST_FUNCTION(AMQP_Destroy_destroys_the_tick_counter_of_the_adaptive_mode)
+{
+    // arrange
+    CIoTHubTransportAMQPMocks mocks;
+
+    DLIST_ENTRY wts;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&wts);
+    TRANSPORT_PROVIDER* transport_interface = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_CLIENT_CONFIG client_config = { (IOTHUB_CLIENT_TRANSPORT_PROVIDER)transport_interface,
+        TEST_DEVICE_ID, TEST_DEVICE_KEY, NULL, TEST_IOT_HUB_NAME, TEST_IOT_HUB_SUFFIX, TEST_PROT_GW_HOSTNAME };
+    IOTHUBTRANSPORT_CONFIG config = { &client_config, &wts };
+    bool adaptive_windows = true;
+
+    TRANSPORT_LL_HANDLE transport = transport_interface->IoTHubTransport_Create(&config);
+    (void)transport_interface->IoTHubTransport_SetOption(transport, OPTION_AMQP_ADAPTIVE_WINDOWS, &adaptive_windows);
+
+    mocks.ResetAllCalls();
+    EXPECTED_CALL(mocks, STRING_delete(0));
+    EXPECTED_CALL(mocks, STRING_delete(0));
+    EXPECTED_CALL(mocks, STRING_delete(0));
+    EXPECTED_CALL(mocks, STRING_delete(0));
+    EXPECTED_CALL(mocks, STRING_delete(0));
+    EXPECTED_CALL(mocks, STRING_delete(0));
+    STRICT_EXPECTED_CALL(mocks, tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    EXPECTED_CALL(mocks, gballoc_free(NULL));
+
+    // act
+    transport_interface->IoTHubTransport_Destroy(transport);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_017: [In adaptive mode, IoTHubTransportAMQP_DoWork shall time one event (or batch) at a time, from its messagesender_send() to its successful disposition, with tickcounter_get_current_ms(), and keep a smoothed round-trip time of 7/8 of the previous value plus 1/8 of the sample, starting at the first sample.]
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_018: [In adaptive mode, the session windows and the receiver link credit shall be the configured values scaled by the smoothed round-trip time over 100 milliseconds, rounded up, never scaled down and scaled up 64 times at most, and saturated at UINT32_MAX.]
+TEST_FUNCTION(AMQP_DoWork_adaptive_windows_grow_the_session_windows_with_the_round_trip_time)
+{
+    // arrange
+    CIoTHubTransportAMQPMocks mocks;
+
+    DLIST_ENTRY wts;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&wts);
+    TRANSPORT_PROVIDER* transport_interface = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_CLIENT_CONFIG client_config = { (IOTHUB_CLIENT_TRANSPORT_PROVIDER)transport_interface,
+        TEST_DEVICE_ID, TEST_DEVICE_KEY, NULL, TEST_IOT_HUB_NAME, TEST_IOT_HUB_SUFFIX, TEST_PROT_GW_HOSTNAME };
+    IOTHUBTRANSPORT_CONFIG config = { &client_config, &wts };
+    time_t current_time = time(NULL);
+    bool adaptive_windows = true;
+
+    TRANSPORT_LL_HANDLE transport = transport_interface->IoTHubTransport_Create(&config);
+    (void)transport_interface->IoTHubTransport_SetOption(transport, OPTION_AMQP_ADAPTIVE_WINDOWS, &adaptive_windows);
+
+    addTestEvents(config.waitingToSend, 1, true);
+
+    test_current_ms = 0;
+    setExpectedCallsForTransportDoWorkUpTo(mocks, STEP_DOWORK_OPEN_CBS, DOWORK_MESSAGERECEIVER_NONE, current_time);
+    setExpectedCallsForCbsAuthentication(mocks, current_time);
+    setExpectedCallsForCbsAuthTimeoutCheck(mocks, current_time);
+    setExpectedCallsForConnectionDoWork(mocks);
+    setExpectedCallsForSASTokenExpiryCheck(mocks, current_time);
+    setExpectedCallsForCreateEventSender(mocks);
+    setExpectedCallsForSendPendingEvents(mocks, IOTHUBMESSAGE_STRING, 1);
+    setExpectedCallsForConnectionDoWork(mocks);
+    transport_interface->IoTHubTransport_DoWork(transport, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    test_latest_cbs_put_token_callback(test_latest_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, NULL);
+    transport_interface->IoTHubTransport_DoWork(transport, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    test_current_ms = 550;
+
+    mocks.ResetAllCalls();
+    STRICT_EXPECTED_CALL(mocks, tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, session_set_incoming_window(TEST_SESSION, UINT32_MAX));
+    STRICT_EXPECTED_CALL(mocks, session_set_outgoing_window(TEST_SESSION, 6 * TEST_OUTGOING_WINDOW_SIZE));
+    STRICT_EXPECTED_CALL(mocks, test_iothubclient_send_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, 0));
+    EXPECTED_CALL(mocks, DList_IsListEmpty(IGNORED_PTR_ARG)).SetReturn(0);
+    EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(TEST_IOTHUB_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_UntrackCompletedMessage(IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK)).IgnoreArgument(1);
+    EXPECTED_CALL(mocks, IoTHubClient_LL_ReleaseMessageList(IGNORED_PTR_ARG));
+
+    // act
+    test_latest_messagesender_send_callback(test_latest_messagesender_send_context, MESSAGE_SEND_OK);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+
+    // cleanup
+    transport_interface->IoTHubTransport_Destroy(transport);
+    cleanupList(config.waitingToSend);
+}
+
 // Tests_SRS_IOTHUBTRANSPORTAMQP_09_086: [IoTHubTransportAMQP_DoWork shall move queued events to an "in-progress" list right before processing them for sending]
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_020: [IoTHubTransportAMQP_DoWork shall suspend the timeout of an event it moves to the in-progress list using IoTHubClient_LL_SuspendMessageTimeout(), and resume it using IoTHubClient_LL_ResumeMessageTimeout() when the event is rolled back to waitToSend.]
 // Tests_SRS_IOTHUBTRANSPORTAMQP_09_193: [IoTHubTransportAMQP_DoWork shall get a MESSAGE_HANDLE instance out of the event's IOTHUB_MESSAGE_HANDLE instance by using message_create_from_iothub_message().]
 // Tests_SRS_IOTHUBTRANSPORTAMQP_09_194: [IoTHubTransportAMQP_DoWork shall destroy the MESSAGE_HANDLE instance after messagesender_send() is invoked.]
 TEST_FUNCTION(AMQP_DoWork_succeeds_when_2_waiting_to_send_messages_are_in_the_list)
@@ -3128,6 +3576,115 @@ TEST_FUNCTION(AMQP_DoWork_succeeds_when_2_waiting_to_send_messages_are_in_the_li
     cleanupList(config.waitingToSend);
 }
 
+#ifndef DONT_USE_AMQP_BATCHING
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_007: [IotHubTransportAMQP_SetOption shall save the value if the option name is "Batching" (bool), returning IOTHUB_CLIENT_OK; the events are sent one AMQP message each while it is false, which is the default.]
+TEST_FUNCTION(AMQP_SetOption_Batching_succeeds)
+{
+    // arrange
+    CIoTHubTransportAMQPMocks mocks;
+
+    DLIST_ENTRY wts;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&wts);
+    TRANSPORT_PROVIDER* transport_interface = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_CLIENT_CONFIG client_config = { (IOTHUB_CLIENT_TRANSPORT_PROVIDER)transport_interface,
+        TEST_DEVICE_ID, TEST_DEVICE_KEY, NULL, TEST_IOT_HUB_NAME, TEST_IOT_HUB_SUFFIX, TEST_PROT_GW_HOSTNAME };
+    IOTHUBTRANSPORT_CONFIG config = { &client_config, &wts };
+    bool batching = true;
+
+    TRANSPORT_LL_HANDLE transport = transport_interface->IoTHubTransport_Create(&config);
+
+    mocks.ResetAllCalls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = transport_interface->IoTHubTransport_SetOption(transport, OPTION_BATCHING, &batching);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    // cleanup
+    transport_interface->IoTHubTransport_Destroy(transport);
+}
+
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_008: [When "Batching" is on, IoTHubTransportAMQP_DoWork shall pack the pending events into uAMQP messages created with message_create() and set to the batch message format 0x80013700 with message_set_message_format(), adding every event as a data section (message_add_body_amqp_data()) holding its encoding from message_create_uamqp_encoding_from_iothub_message(), and send each batch message with messagesender_send().]
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_009: [The encoded events of a batch, each in a data section, shall not add up to more than the max message size of the peer of the event sender link, obtained with link_get_peer_max_message_size(), or 256 KB if it cannot be obtained or is unlimited; a batch shall hold at least one event.]
+TEST_FUNCTION(AMQP_DoWork_with_Batching_sends_2_waiting_to_send_messages_in_one_batch)
+{
+    // arrange
+    CIoTHubTransportAMQPMocks mocks;
+
+    DLIST_ENTRY wts;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&wts);
+    TRANSPORT_PROVIDER* transport_interface = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_CLIENT_CONFIG client_config = { (IOTHUB_CLIENT_TRANSPORT_PROVIDER)transport_interface,
+        TEST_DEVICE_ID, TEST_DEVICE_KEY, NULL, TEST_IOT_HUB_NAME, TEST_IOT_HUB_SUFFIX, TEST_PROT_GW_HOSTNAME };
+    IOTHUBTRANSPORT_CONFIG config = { &client_config, &wts };
+    time_t current_time = time(NULL);
+    bool batching = true;
+
+    TRANSPORT_LL_HANDLE transport = transport_interface->IoTHubTransport_Create(&config);
+    (void)transport_interface->IoTHubTransport_SetOption(transport, OPTION_BATCHING, &batching);
+
+    addTestEvents(config.waitingToSend, 2, true);
+
+    mocks.ResetAllCalls();
+    setExpectedCallsForTransportDoWorkUpTo(mocks, STEP_DOWORK_OPEN_CBS, DOWORK_MESSAGERECEIVER_NONE, current_time);
+    setExpectedCallsForCbsAuthentication(mocks, current_time);
+    setExpectedCallsForCbsAuthTimeoutCheck(mocks, current_time);
+    setExpectedCallsForConnectionDoWork(mocks);
+    setExpectedCallsForSASTokenExpiryCheck(mocks, current_time);
+    setExpectedCallsForCreateEventSender(mocks);
+    setExpectedCallsForSendPendingEventsInOneBatch(mocks, 2);
+    setExpectedCallsForConnectionDoWork(mocks);
+
+    // act
+    transport_interface->IoTHubTransport_DoWork(transport, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    test_latest_cbs_put_token_callback(test_latest_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, NULL);
+    transport_interface->IoTHubTransport_DoWork(transport, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+
+    // cleanup
+    transport_interface->IoTHubTransport_Destroy(transport);
+    cleanupList(config.waitingToSend);
+}
+#else
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_021: [If the transport is built against a uAMQP that does not provide link_get_peer_max_message_size() (DONT_USE_AMQP_BATCHING), IotHubTransportAMQP_SetOption shall return IOTHUB_CLIENT_ERROR if the option name is "Batching" and the value is true, and IOTHUB_CLIENT_OK if it is false; the events are always sent one AMQP message each.]
+TEST_FUNCTION(AMQP_SetOption_Batching_true_fails_without_batching_support)
+{
+    // arrange
+    CIoTHubTransportAMQPMocks mocks;
+
+    DLIST_ENTRY wts;
+    BASEIMPLEMENTATION::DList_InitializeListHead(&wts);
+    TRANSPORT_PROVIDER* transport_interface = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_CLIENT_CONFIG client_config = { (IOTHUB_CLIENT_TRANSPORT_PROVIDER)transport_interface,
+        TEST_DEVICE_ID, TEST_DEVICE_KEY, NULL, TEST_IOT_HUB_NAME, TEST_IOT_HUB_SUFFIX, TEST_PROT_GW_HOSTNAME };
+    IOTHUBTRANSPORT_CONFIG config = { &client_config, &wts };
+    bool batching = true;
+    bool no_batching = false;
+
+    TRANSPORT_LL_HANDLE transport = transport_interface->IoTHubTransport_Create(&config);
+
+    mocks.ResetAllCalls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = transport_interface->IoTHubTransport_SetOption(transport, OPTION_BATCHING, &batching);
+    IOTHUB_CLIENT_RESULT result_off = transport_interface->IoTHubTransport_SetOption(transport, OPTION_BATCHING, &no_batching);
+
+    // assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result_off);
+
+    // cleanup
+    transport_interface->IoTHubTransport_Destroy(transport);
+}
+#endif /*DONT_USE_AMQP_BATCHING*/
+
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_001: [The callback 'on_message_send_complete' shall stop the message timeout and send queue tracking of the IOTHUB_MESSAGE_LIST instance and count its result in the statistics using IoTHubClient_LL_UntrackCompletedMessage()]
+// Tests_SRS_IOTHUBTRANSPORTAMQP_09_152: [The callback 'on_message_send_complete' shall destroy the IOTHUB_MESSAGE_LIST instance using IoTHubClient_LL_ReleaseMessageList()]
 TEST_FUNCTION(AMQP_send_pending_events_parse_iothub_message_handle_fails)
 {
 	// arrange
@@ -3156,6 +3713,7 @@ TEST_FUNCTION(AMQP_send_pending_events_parse_iothub_message_handle_fails)
 	EXPECTED_CALL(mocks, DList_IsListEmpty(IGNORED_PTR_ARG)).SetReturn(0);
 	EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG));
 	EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	EXPECTED_CALL(mocks, IoTHubClient_LL_SuspendMessageTimeout(IGNORED_PTR_ARG));
 	STRICT_EXPECTED_CALL(mocks, message_create_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2).SetReturn(1);
 	STRICT_EXPECTED_CALL(mocks, message_destroy(TEST_MESSAGE_HANDLE)); // mocked function still assigns the MESSAGE_HANDLE, so need to expect a destroy.
 	STRICT_EXPECTED_CALL(mocks, test_iothubclient_send_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, 0));
@@ -3163,7 +3721,8 @@ TEST_FUNCTION(AMQP_send_pending_events_parse_iothub_message_handle_fails)
 	EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG));
 	EXPECTED_CALL(mocks, DList_InitializeListHead(IGNORED_PTR_ARG));
 	STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(TEST_IOTHUB_MESSAGE_HANDLE));
-	EXPECTED_CALL(mocks, gballoc_free(NULL));
+	STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_UntrackCompletedMessage(IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_ERROR)).IgnoreArgument(1);
+	EXPECTED_CALL(mocks, IoTHubClient_LL_ReleaseMessageList(IGNORED_PTR_ARG));
 	EXPECTED_CALL(mocks, DList_IsListEmpty(IGNORED_PTR_ARG)).SetReturn(1);
 
 	setExpectedCallsForConnectionDoWork(mocks);
@@ -3717,7 +4276,7 @@ TEST_FUNCTION(AMQP_Register_transport_success_returns_transport)
 
     EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, gballoc_malloc(0));
     EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG));
@@ -3759,7 +4318,7 @@ TEST_FUNCTION(AMQP_Register_twice_returns_null_second_time)
 
     EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, gballoc_malloc(0));
     EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG));
@@ -3800,7 +4359,7 @@ TEST_FUNCTION(AMQP_Register_transport_deviceKey_mismatch_returns_null)
 
     EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, gballoc_malloc(0));
     EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG));
@@ -3841,7 +4400,7 @@ TEST_FUNCTION(AMQP_Register_transport_deviceId_mismatch_returns_null)
 
     EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, gballoc_malloc(0));
     EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG));
@@ -3973,7 +4532,7 @@ TEST_FUNCTION(AMQP_Register_transport_deviceKey_null_and_deviceSasToken_null_ass
 
     EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, gballoc_malloc(0));
     EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG));
@@ -4140,7 +4699,7 @@ TEST_FUNCTION(AMQP_Register_transport_Register_Unregister_Register_success_retur
 
     EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, gballoc_malloc(0));
     EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG));
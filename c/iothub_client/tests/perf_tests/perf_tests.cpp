@@ -0,0 +1,1154 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "micromock.h"
+
+#include "iothub_client.h"
+#include "iothub_client_ll.h"
+#include "iothub_client_private.h"
+#include "iothub_message.h"
+#include "iothub_transport_ll.h"
+
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/base64.h"
+#include "iothub_base64.h"
+
+#ifdef USE_HTTP
+#include "iothubtransporthttp.h"
+#include "iothubtransport.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#include "azure_c_shared_utility/httpapiexsas.h"
+#endif
+
+#ifdef USE_MQTT
+#include "iothubtransportmqtt.h"
+#include "azure_umqtt_c/mqtt_client.h"
+#include "azure_c_shared_utility/platform.h"
+#endif
+
+static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
+
+static const size_t TEST_QUEUE_DEPTHS[] = { 100, 1000, 10000, 50000 };
+#define TEST_QUEUE_DEPTHS_COUNT (sizeof(TEST_QUEUE_DEPTHS) / sizeof(TEST_QUEUE_DEPTHS[0]))
+#define TEST_DOWORK_ITERATIONS 1000
+#define TEST_PRODUCER_COUNT 8
+#define TEST_EVENTS_PER_PRODUCER 200
+#define TEST_SLOW_DOWORK_MS 5
+#define TEST_CONFIRMATION_TIMEOUT_MS 60000
+#define TEST_HTTP_BATCHES 100
+#define TEST_HTTP_MESSAGE_SIZE 64
+static const size_t TEST_HTTP_BATCH_SIZES[] = { 1, 100, 1000 };
+#define TEST_HTTP_BATCH_SIZES_COUNT (sizeof(TEST_HTTP_BATCH_SIZES) / sizeof(TEST_HTTP_BATCH_SIZES[0]))
+#define TEST_HTTP_DEVICES 16
+#define TEST_HTTP_EVENTS_PER_DEVICE 10
+#define TEST_HTTP_LATENCY_MS 5
+static const unsigned int TEST_HTTP_CONCURRENT_CONNECTIONS[] = { 1, 4, 8 };
+#define TEST_HTTP_CONCURRENT_CONNECTIONS_COUNT (sizeof(TEST_HTTP_CONCURRENT_CONNECTIONS) / sizeof(TEST_HTTP_CONCURRENT_CONNECTIONS[0]))
+#define TEST_MQTT_CLIENTS 16
+#define TEST_MQTT_EVENTS_PER_CLIENT 200
+#define TEST_MQTT_EXTRA_EVENTS_PER_INDEX 20
+#define TEST_BASE64_SIZE (64 * 1024)
+#define TEST_BASE64_ITERATIONS 1000
+static const IOTHUB_BASE64_IMPLEMENTATION TEST_BASE64_IMPLEMENTATIONS[] =
+{
+    IOTHUB_BASE64_IMPLEMENTATION_SCALAR,
+    IOTHUB_BASE64_IMPLEMENTATION_SSSE3,
+    IOTHUB_BASE64_IMPLEMENTATION_AVX2,
+    IOTHUB_BASE64_IMPLEMENTATION_NEON
+};
+#define TEST_BASE64_IMPLEMENTATIONS_COUNT (sizeof(TEST_BASE64_IMPLEMENTATIONS) / sizeof(TEST_BASE64_IMPLEMENTATIONS[0]))
+
+/*a transport that never sends anything: every message stays in waitingToSend, which is the worst case for IoTHubClient_LL_DoWork*/
+static int g_perfTransport;
+
+static STRING_HANDLE PERF_IoTHubTransport_GetHostname(TRANSPORT_LL_HANDLE handle)
+{
+    (void)handle;
+    return NULL;
+}
+
+static IOTHUB_CLIENT_RESULT PERF_IoTHubTransport_SetOption(TRANSPORT_LL_HANDLE handle, const char* optionName, const void* value)
+{
+    (void)handle;
+    (void)optionName;
+    (void)value;
+    return IOTHUB_CLIENT_INVALID_ARG;
+}
+
+static TRANSPORT_LL_HANDLE PERF_IoTHubTransport_Create(const IOTHUBTRANSPORT_CONFIG* config)
+{
+    (void)config;
+    return (TRANSPORT_LL_HANDLE)&g_perfTransport;
+}
+
+static void PERF_IoTHubTransport_Destroy(TRANSPORT_LL_HANDLE handle)
+{
+    (void)handle;
+}
+
+static IOTHUB_DEVICE_HANDLE PERF_IoTHubTransport_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
+{
+    (void)device;
+    (void)iotHubClientHandle;
+    (void)waitingToSend;
+    return (IOTHUB_DEVICE_HANDLE)handle;
+}
+
+static void PERF_IoTHubTransport_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
+{
+    (void)deviceHandle;
+}
+
+static int PERF_IoTHubTransport_Subscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    (void)handle;
+    return 0;
+}
+
+static void PERF_IoTHubTransport_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    (void)handle;
+}
+
+static void PERF_IoTHubTransport_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    (void)handle;
+    (void)iotHubClientHandle;
+}
+
+static IOTHUB_CLIENT_RESULT PERF_IoTHubTransport_GetSendStatus(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_STATUS* iotHubClientStatus)
+{
+    (void)handle;
+    *iotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+    return IOTHUB_CLIENT_OK;
+}
+
+static TRANSPORT_PROVIDER PERF_transport_provider =
+{
+    PERF_IoTHubTransport_GetHostname,   /*pfIoTHubTransport_GetHostname IoTHubTransport_GetHostname     */
+    PERF_IoTHubTransport_SetOption,     /*pfIoTHubTransport_SetOption IoTHubTransport_SetOption;        */
+    PERF_IoTHubTransport_Create,        /*pfIoTHubTransport_Create IoTHubTransport_Create;              */
+    PERF_IoTHubTransport_Destroy,       /*pfIoTHubTransport_Destroy IoTHubTransport_Destroy;            */
+    PERF_IoTHubTransport_Register,      /*pfIotHubTransport_Register IoTHubTransport_Register;          */
+    PERF_IoTHubTransport_Unregister,    /*pfIotHubTransport_Unregister IoTHubTransport_Unegister;       */
+    PERF_IoTHubTransport_Subscribe,     /*pfIoTHubTransport_Subscribe IoTHubTransport_Subscribe;        */
+    PERF_IoTHubTransport_Unsubscribe,   /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;    */
+    PERF_IoTHubTransport_DoWork,        /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;              */
+    PERF_IoTHubTransport_GetSendStatus  /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+};
+
+static const TRANSPORT_PROVIDER* providePERF(void)
+{
+    return &PERF_transport_provider;
+}
+
+static const IOTHUB_CLIENT_CONFIG PERF_CONFIG =
+{
+    providePERF,            /* IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;   */
+    "perfDevice",           /* const char* deviceId;                        */
+    "perfKey",              /* const char* deviceKey;                       */
+    NULL,                   /* const char* deviceSasToken;                  */
+    "perfHub",              /* const char* iotHubName;                      */
+    "perfSuffix",           /* const char* iotHubSuffix;                    */
+    NULL                    /* const char* protocolGatewayHostName;         */
+};
+
+/*a transport whose DoWork takes TEST_SLOW_DOWORK_MS, like a TLS write would, and then completes every message waiting to be sent*/
+static PDLIST_ENTRY g_slowWaitingToSend;
+
+static IOTHUB_DEVICE_HANDLE SLOW_IoTHubTransport_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
+{
+    (void)device;
+    (void)iotHubClientHandle;
+    g_slowWaitingToSend = waitingToSend;
+    return (IOTHUB_DEVICE_HANDLE)handle;
+}
+
+static void SLOW_IoTHubTransport_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    (void)handle;
+    ThreadAPI_Sleep(TEST_SLOW_DOWORK_MS);
+    if (!DList_IsListEmpty(g_slowWaitingToSend))
+    {
+        DLIST_ENTRY completed;
+        DList_InitializeListHead(&completed);
+        while (!DList_IsListEmpty(g_slowWaitingToSend))
+        {
+            DList_InsertTailList(&completed, DList_RemoveHeadList(g_slowWaitingToSend));
+        }
+        IoTHubClient_LL_SendComplete(iotHubClientHandle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
+    }
+}
+
+static IOTHUB_CLIENT_RESULT SLOW_IoTHubTransport_GetSendStatus(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_STATUS* iotHubClientStatus)
+{
+    (void)handle;
+    *iotHubClientStatus = DList_IsListEmpty(g_slowWaitingToSend) ? IOTHUB_CLIENT_SEND_STATUS_IDLE : IOTHUB_CLIENT_SEND_STATUS_BUSY;
+    return IOTHUB_CLIENT_OK;
+}
+
+static TRANSPORT_PROVIDER SLOW_transport_provider =
+{
+    PERF_IoTHubTransport_GetHostname,   /*pfIoTHubTransport_GetHostname IoTHubTransport_GetHostname     */
+    PERF_IoTHubTransport_SetOption,     /*pfIoTHubTransport_SetOption IoTHubTransport_SetOption;        */
+    PERF_IoTHubTransport_Create,        /*pfIoTHubTransport_Create IoTHubTransport_Create;              */
+    PERF_IoTHubTransport_Destroy,       /*pfIoTHubTransport_Destroy IoTHubTransport_Destroy;            */
+    SLOW_IoTHubTransport_Register,      /*pfIotHubTransport_Register IoTHubTransport_Register;          */
+    PERF_IoTHubTransport_Unregister,    /*pfIotHubTransport_Unregister IoTHubTransport_Unegister;       */
+    PERF_IoTHubTransport_Subscribe,     /*pfIoTHubTransport_Subscribe IoTHubTransport_Subscribe;        */
+    PERF_IoTHubTransport_Unsubscribe,   /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;    */
+    SLOW_IoTHubTransport_DoWork,        /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;              */
+    SLOW_IoTHubTransport_GetSendStatus  /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+};
+
+static const TRANSPORT_PROVIDER* provideSLOW(void)
+{
+    return &SLOW_transport_provider;
+}
+
+static const IOTHUB_CLIENT_CONFIG SLOW_CONFIG =
+{
+    provideSLOW,            /* IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;   */
+    "perfDevice",           /* const char* deviceId;                        */
+    "perfKey",              /* const char* deviceKey;                       */
+    NULL,                   /* const char* deviceSasToken;                  */
+    "perfHub",              /* const char* iotHubName;                      */
+    "perfSuffix",           /* const char* iotHubSuffix;                    */
+    NULL                    /* const char* protocolGatewayHostName;         */
+};
+
+#ifdef USE_HTTP
+/*the HTTP transport is compiled in this test with an HTTPAPIEX that answers every request with 204 without any network, so only the building of the batches is measured.
+g_httpLatencyMs turns it into a stand-in for a server that takes that long to answer, the requests can come from the threads of the connection pool*/
+static int g_perfHttpApiEx;
+static int g_perfHttpApiExSas;
+static LOCK_HANDLE g_httpLock;
+static size_t g_httpRequests;
+static size_t g_httpBytes;
+static unsigned int g_httpLatencyMs;
+
+extern "C" HTTPAPIEX_HANDLE HTTPAPIEX_Create(const char* hostName)
+{
+    (void)hostName;
+    return (HTTPAPIEX_HANDLE)&g_perfHttpApiEx;
+}
+
+extern "C" HTTPAPIEX_RESULT HTTPAPIEX_ExecuteRequest(HTTPAPIEX_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath,
+    HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode,
+    HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    (void)handle;
+    (void)requestType;
+    (void)relativePath;
+    (void)requestHttpHeadersHandle;
+    (void)requestContent;
+    (void)responseHttpHeadersHandle;
+    (void)responseContent;
+    *statusCode = 204;
+    return HTTPAPIEX_OK;
+}
+
+extern "C" void HTTPAPIEX_Destroy(HTTPAPIEX_HANDLE handle)
+{
+    (void)handle;
+}
+
+extern "C" HTTPAPIEX_RESULT HTTPAPIEX_SetOption(HTTPAPIEX_HANDLE handle, const char* optionName, const void* value)
+{
+    (void)handle;
+    (void)optionName;
+    (void)value;
+    return HTTPAPIEX_OK;
+}
+
+extern "C" HTTPAPIEX_SAS_HANDLE HTTPAPIEX_SAS_Create(STRING_HANDLE key, STRING_HANDLE uriResource, STRING_HANDLE keyName)
+{
+    (void)key;
+    (void)uriResource;
+    (void)keyName;
+    return (HTTPAPIEX_SAS_HANDLE)&g_perfHttpApiExSas;
+}
+
+extern "C" void HTTPAPIEX_SAS_Destroy(HTTPAPIEX_SAS_HANDLE handle)
+{
+    (void)handle;
+}
+
+extern "C" HTTPAPIEX_RESULT HTTPAPIEX_SAS_ExecuteRequest(HTTPAPIEX_SAS_HANDLE sasHandle, HTTPAPIEX_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath,
+    HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode,
+    HTTP_HEADERS_HANDLE responseHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    (void)sasHandle;
+    (void)handle;
+    (void)requestType;
+    (void)relativePath;
+    (void)requestHttpHeadersHandle;
+    (void)responseHeadersHandle;
+    (void)responseContent;
+    if (g_httpLatencyMs > 0)
+    {
+        ThreadAPI_Sleep(g_httpLatencyMs);
+    }
+    (void)Lock(g_httpLock);
+    g_httpRequests++;
+    if (requestContent != NULL)
+    {
+        g_httpBytes += BUFFER_length(requestContent);
+    }
+    (void)Unlock(g_httpLock);
+    *statusCode = 204;
+    return HTTPAPIEX_OK;
+}
+
+static const IOTHUB_CLIENT_CONFIG HTTP_PERF_CONFIG =
+{
+    HTTP_Protocol,          /* IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;   */
+    "perfDevice",           /* const char* deviceId;                        */
+    "perfKey",              /* const char* deviceKey;                       */
+    NULL,                   /* const char* deviceSasToken;                  */
+    "perfHub",              /* const char* iotHubName;                      */
+    "perfSuffix",           /* const char* iotHubSuffix;                    */
+    NULL                    /* const char* protocolGatewayHostName;         */
+};
+#endif
+
+#ifdef USE_MQTT
+/*the MQTT transport is compiled in this test with an MQTT client that stands in for a local broker without any network: it accepts every connection
+and acknowledges every QoS 1 publish at its next mqtt_client_dowork. Like the transports, every client only has state of its own.
+The MQTT messages are stand-ins as well, so nothing of umqtt is linked*/
+typedef struct PERF_MQTT_MESSAGE_TAG
+{
+    uint16_t packetId;
+    QOS_VALUE qosValue;
+} PERF_MQTT_MESSAGE;
+
+extern "C" MQTT_MESSAGE_HANDLE mqttmessage_create(uint16_t packetId, const char* topicName, QOS_VALUE qosValue, const uint8_t* appMsg, size_t appMsgLength)
+{
+    (void)topicName;
+    (void)appMsg;
+    (void)appMsgLength;
+    PERF_MQTT_MESSAGE* result = (PERF_MQTT_MESSAGE*)malloc(sizeof(PERF_MQTT_MESSAGE));
+    if (result != NULL)
+    {
+        result->packetId = packetId;
+        result->qosValue = qosValue;
+    }
+    return (MQTT_MESSAGE_HANDLE)result;
+}
+
+extern "C" void mqttmessage_destroy(MQTT_MESSAGE_HANDLE handle)
+{
+    free(handle);
+}
+
+extern "C" uint16_t mqttmessage_getPacketId(MQTT_MESSAGE_HANDLE handle)
+{
+    return ((PERF_MQTT_MESSAGE*)handle)->packetId;
+}
+
+extern "C" QOS_VALUE mqttmessage_getQosType(MQTT_MESSAGE_HANDLE handle)
+{
+    return ((PERF_MQTT_MESSAGE*)handle)->qosValue;
+}
+
+extern "C" int mqttmessage_setIsDuplicateMsg(MQTT_MESSAGE_HANDLE handle, bool duplicateMsg)
+{
+    (void)handle;
+    (void)duplicateMsg;
+    return 0;
+}
+
+/*the stand-in broker never sends a message to the devices*/
+extern "C" const char* mqttmessage_getTopicName(MQTT_MESSAGE_HANDLE handle)
+{
+    (void)handle;
+    return NULL;
+}
+
+extern "C" const APP_PAYLOAD* mqttmessage_getApplicationMsg(MQTT_MESSAGE_HANDLE handle)
+{
+    (void)handle;
+    return NULL;
+}
+
+typedef struct PERF_MQTT_CLIENT_TAG
+{
+    ON_MQTT_OPERATION_CALLBACK opCallback;
+    void* callbackCtx;
+    bool isConnackPending;
+    uint16_t* pendingAcks;
+    size_t pendingAckCount;
+    size_t pendingAckCapacity;
+} PERF_MQTT_CLIENT;
+
+extern "C" MQTT_CLIENT_HANDLE mqtt_client_init(ON_MQTT_MESSAGE_RECV_CALLBACK msgRecv, ON_MQTT_OPERATION_CALLBACK opCallback, void* callbackCtx)
+{
+    (void)msgRecv;
+    PERF_MQTT_CLIENT* result = (PERF_MQTT_CLIENT*)malloc(sizeof(PERF_MQTT_CLIENT));
+    if (result != NULL)
+    {
+        result->opCallback = opCallback;
+        result->callbackCtx = callbackCtx;
+        result->isConnackPending = false;
+        result->pendingAcks = NULL;
+        result->pendingAckCount = 0;
+        result->pendingAckCapacity = 0;
+    }
+    return (MQTT_CLIENT_HANDLE)result;
+}
+
+extern "C" void mqtt_client_deinit(MQTT_CLIENT_HANDLE handle)
+{
+    PERF_MQTT_CLIENT* client = (PERF_MQTT_CLIENT*)handle;
+    if (client != NULL)
+    {
+        free(client->pendingAcks);
+        free(client);
+    }
+}
+
+extern "C" int mqtt_client_connect(MQTT_CLIENT_HANDLE handle, XIO_HANDLE xioHandle, MQTT_CLIENT_OPTIONS* mqttOptions)
+{
+    (void)xioHandle;
+    (void)mqttOptions;
+    ((PERF_MQTT_CLIENT*)handle)->isConnackPending = true;
+    return 0;
+}
+
+extern "C" int mqtt_client_disconnect(MQTT_CLIENT_HANDLE handle)
+{
+    (void)handle;
+    return 0;
+}
+
+extern "C" int mqtt_client_subscribe(MQTT_CLIENT_HANDLE handle, uint16_t packetId, SUBSCRIBE_PAYLOAD* subscribeList, size_t count)
+{
+    (void)handle;
+    (void)packetId;
+    (void)subscribeList;
+    (void)count;
+    return 0;
+}
+
+extern "C" int mqtt_client_unsubscribe(MQTT_CLIENT_HANDLE handle, uint16_t packetId, const char** unsubscribeList, size_t count)
+{
+    (void)handle;
+    (void)packetId;
+    (void)unsubscribeList;
+    (void)count;
+    return 0;
+}
+
+extern "C" int mqtt_client_publish(MQTT_CLIENT_HANDLE handle, MQTT_MESSAGE_HANDLE msgHandle)
+{
+    int result;
+    PERF_MQTT_CLIENT* client = (PERF_MQTT_CLIENT*)handle;
+    if (mqttmessage_getQosType(msgHandle) != DELIVER_AT_LEAST_ONCE)
+    {
+        result = 0;
+    }
+    else
+    {
+        if (client->pendingAckCount == client->pendingAckCapacity)
+        {
+            size_t newCapacity = (client->pendingAckCapacity == 0) ? 16 : client->pendingAckCapacity * 2;
+            uint16_t* newAcks = (uint16_t*)realloc(client->pendingAcks, newCapacity * sizeof(uint16_t));
+            if (newAcks != NULL)
+            {
+                client->pendingAcks = newAcks;
+                client->pendingAckCapacity = newCapacity;
+            }
+        }
+
+        if (client->pendingAckCount == client->pendingAckCapacity)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            client->pendingAcks[client->pendingAckCount++] = mqttmessage_getPacketId(msgHandle);
+            result = 0;
+        }
+    }
+    return result;
+}
+
+extern "C" void mqtt_client_dowork(MQTT_CLIENT_HANDLE handle)
+{
+    PERF_MQTT_CLIENT* client = (PERF_MQTT_CLIENT*)handle;
+    if (client->isConnackPending)
+    {
+        CONNECT_ACK connack;
+        connack.isSessionPresent = false;
+        connack.returnCode = CONNECTION_ACCEPTED;
+        client->isConnackPending = false;
+        client->opCallback(handle, MQTT_CLIENT_ON_CONNACK, &connack, client->callbackCtx);
+    }
+
+    /*the acknowledgements are taken out first, a callback can publish again*/
+    size_t ackCount = client->pendingAckCount;
+    uint16_t* acks = client->pendingAcks;
+    client->pendingAcks = NULL;
+    client->pendingAckCount = 0;
+    client->pendingAckCapacity = 0;
+    for (size_t i = 0; i < ackCount; i++)
+    {
+        PUBLISH_ACK puback;
+        puback.packetId = acks[i];
+        client->opCallback(handle, MQTT_CLIENT_ON_PUBLISH_ACK, &puback, client->callbackCtx);
+    }
+    free(acks);
+}
+
+extern "C" void mqtt_client_set_trace(MQTT_CLIENT_HANDLE handle, bool traceOn, bool rawBytesOn)
+{
+    (void)handle;
+    (void)traceOn;
+    (void)rawBytesOn;
+}
+
+static const IOTHUB_CLIENT_CONFIG MQTT_PERF_CONFIG =
+{
+    MQTT_Protocol,          /* IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;   */
+    "perfDevice",           /* const char* deviceId;                        */
+    "cGVyZktleQ==",         /* const char* deviceKey;                       */
+    NULL,                   /* const char* deviceSasToken;                  */
+    "perfHub",              /* const char* iotHubName;                      */
+    "perfSuffix",           /* const char* iotHubSuffix;                    */
+    NULL                    /* const char* protocolGatewayHostName;         */
+};
+#endif
+
+static size_t g_confirmations;
+
+static void perfConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    (void)result;
+    (void)userContextCallback;
+    g_confirmations++;
+}
+
+static IOTHUB_CLIENT_LL_HANDLE createClientWithQueuedMessages(size_t queueDepth, uint64_t messageTimeout)
+{
+    IOTHUB_CLIENT_LL_HANDLE result = IoTHubClient_LL_Create(&PERF_CONFIG);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubClient_LL_SetOption(result, "messageTimeout", &messageTimeout));
+
+    IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromString("perf");
+    ASSERT_IS_NOT_NULL(message);
+    for (size_t i = 0; i < queueDepth; i++)
+    {
+        ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubClient_LL_SendEventAsync(result, message, perfConfirmationCallback, NULL));
+    }
+    IoTHubMessage_Destroy(message);
+    return result;
+}
+
+static uint64_t nowMs(TICK_COUNTER_HANDLE tickCounter)
+{
+    uint64_t result;
+    ASSERT_ARE_EQUAL(int, 0, tickcounter_get_current_ms(tickCounter, &result));
+    return result;
+}
+
+/*the confirmations of IoTHubClient arrive on its worker thread*/
+static LOCK_HANDLE g_confirmationsLock;
+static size_t g_lockedConfirmations;
+
+static void lockedConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    (void)result;
+    (void)userContextCallback;
+    (void)Lock(g_confirmationsLock);
+    g_lockedConfirmations++;
+    (void)Unlock(g_confirmationsLock);
+}
+
+#ifdef USE_HTTP
+/*every event carries its device and its place in the queue of the device, the confirmations of a device have to arrive in that order*/
+typedef struct ORDERED_EVENT_TAG
+{
+    size_t device;
+    size_t sequence;
+} ORDERED_EVENT;
+
+static size_t g_nextSequence[TEST_HTTP_DEVICES];
+static size_t g_outOfOrderConfirmations;
+
+static void orderedConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    ORDERED_EVENT* event = (ORDERED_EVENT*)userContextCallback;
+    (void)result;
+    (void)Lock(g_confirmationsLock);
+    if (g_nextSequence[event->device] != event->sequence)
+    {
+        g_outOfOrderConfirmations++;
+    }
+    g_nextSequence[event->device] = event->sequence + 1;
+    g_lockedConfirmations++;
+    (void)Unlock(g_confirmationsLock);
+}
+
+/*TEST_HTTP_DEVICES devices share one HTTP transport, each one sends TEST_HTTP_EVENTS_PER_DEVICE events, one per DoWork since batching is off*/
+static uint64_t runSharedHttpTransport(TICK_COUNTER_HANDLE tickCounter, unsigned int concurrentConnections)
+{
+    static ORDERED_EVENT events[TEST_HTTP_DEVICES][TEST_HTTP_EVENTS_PER_DEVICE];
+    IOTHUB_CLIENT_LL_HANDLE clients[TEST_HTTP_DEVICES];
+    char deviceIds[TEST_HTTP_DEVICES][32];
+
+    TRANSPORT_HANDLE transport = IoTHubTransport_Create(HTTP_Protocol, "perfHub", "perfSuffix");
+    ASSERT_IS_NOT_NULL(transport);
+
+    IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromString("perf");
+    ASSERT_IS_NOT_NULL(message);
+
+    for (size_t i = 0; i < TEST_HTTP_DEVICES; i++)
+    {
+        IOTHUB_CLIENT_DEVICE_CONFIG config;
+        (void)sprintf(deviceIds[i], "perfDevice%lu", (unsigned long)i);
+        config.protocol = HTTP_Protocol;
+        config.transportHandle = IoTHubTransport_GetLLTransport(transport);
+        config.deviceId = deviceIds[i];
+        config.deviceKey = "perfKey";
+        config.deviceSasToken = NULL;
+        clients[i] = IoTHubClient_LL_CreateWithTransport(&config);
+        ASSERT_IS_NOT_NULL(clients[i]);
+        g_nextSequence[i] = 0;
+
+        for (size_t j = 0; j < TEST_HTTP_EVENTS_PER_DEVICE; j++)
+        {
+            events[i][j].device = i;
+            events[i][j].sequence = j;
+            ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubClient_LL_SendEventAsync(clients[i], message, orderedConfirmationCallback, &events[i][j]));
+        }
+    }
+    IoTHubMessage_Destroy(message);
+
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubClient_LL_SetOption(clients[0], "ConcurrentConnections", &concurrentConnections));
+
+    /*the DoWork of any client of the transport serves all its devices*/
+    uint64_t start = nowMs(tickCounter);
+    for (size_t j = 0; j < TEST_HTTP_EVENTS_PER_DEVICE; j++)
+    {
+        IoTHubClient_LL_DoWork(clients[0]);
+    }
+    uint64_t elapsed = nowMs(tickCounter) - start;
+
+    ASSERT_ARE_EQUAL(size_t, TEST_HTTP_DEVICES * TEST_HTTP_EVENTS_PER_DEVICE, g_lockedConfirmations);
+    ASSERT_ARE_EQUAL(size_t, 0, g_outOfOrderConfirmations);
+
+    for (size_t i = 0; i < TEST_HTTP_DEVICES; i++)
+    {
+        IoTHubClient_LL_Destroy(clients[i]);
+    }
+    IoTHubTransport_Destroy(transport);
+    return elapsed;
+}
+#endif
+
+static size_t getLockedConfirmations(void)
+{
+    size_t result;
+    (void)Lock(g_confirmationsLock);
+    result = g_lockedConfirmations;
+    (void)Unlock(g_confirmationsLock);
+    return result;
+}
+
+typedef struct PRODUCER_TAG
+{
+    IOTHUB_CLIENT_HANDLE client;
+    uint64_t maxCallMs; /*the longest IoTHubClient_SendEventAsync call*/
+    size_t failedCalls;
+} PRODUCER;
+
+static int producerThread(void* threadArgument)
+{
+    PRODUCER* producer = (PRODUCER*)threadArgument;
+    TICK_COUNTER_HANDLE tickCounter = tickcounter_create();
+    IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromString("perf");
+    if ((tickCounter == NULL) || (message == NULL))
+    {
+        producer->failedCalls = TEST_EVENTS_PER_PRODUCER;
+    }
+    else
+    {
+        for (size_t i = 0; i < TEST_EVENTS_PER_PRODUCER; i++)
+        {
+            uint64_t start;
+            uint64_t end;
+            (void)tickcounter_get_current_ms(tickCounter, &start);
+            if (IoTHubClient_SendEventAsync(producer->client, message, lockedConfirmationCallback, NULL) != IOTHUB_CLIENT_OK)
+            {
+                producer->failedCalls++;
+            }
+            (void)tickcounter_get_current_ms(tickCounter, &end);
+            if (end - start > producer->maxCallMs)
+            {
+                producer->maxCallMs = end - start;
+            }
+        }
+    }
+    if (message != NULL)
+    {
+        IoTHubMessage_Destroy(message);
+    }
+    if (tickCounter != NULL)
+    {
+        tickcounter_destroy(tickCounter);
+    }
+    return 0;
+}
+
+/*TEST_PRODUCER_COUNT threads send TEST_EVENTS_PER_PRODUCER events each while the worker thread spends most of its time in a slow DoWork*/
+static void runProducers(bool sendEventHandoff)
+{
+    TICK_COUNTER_HANDLE tickCounter = tickcounter_create();
+    ASSERT_IS_NOT_NULL(tickCounter);
+    IOTHUB_CLIENT_HANDLE client = IoTHubClient_Create(&SLOW_CONFIG);
+    ASSERT_IS_NOT_NULL(client);
+    if (sendEventHandoff)
+    {
+        ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubClient_SetOption(client, "sendEventHandoff", &sendEventHandoff));
+    }
+
+    PRODUCER producers[TEST_PRODUCER_COUNT];
+    THREAD_HANDLE threads[TEST_PRODUCER_COUNT];
+    uint64_t start = nowMs(tickCounter);
+    for (size_t i = 0; i < TEST_PRODUCER_COUNT; i++)
+    {
+        producers[i].client = client;
+        producers[i].maxCallMs = 0;
+        producers[i].failedCalls = 0;
+        ASSERT_ARE_EQUAL(int, THREADAPI_OK, ThreadAPI_Create(&threads[i], producerThread, &producers[i]));
+    }
+
+    uint64_t maxCallMs = 0;
+    for (size_t i = 0; i < TEST_PRODUCER_COUNT; i++)
+    {
+        int res;
+        ASSERT_ARE_EQUAL(int, THREADAPI_OK, ThreadAPI_Join(threads[i], &res));
+        ASSERT_ARE_EQUAL(size_t, 0, producers[i].failedCalls);
+        if (producers[i].maxCallMs > maxCallMs)
+        {
+            maxCallMs = producers[i].maxCallMs;
+        }
+    }
+    uint64_t submitted = nowMs(tickCounter);
+
+    const size_t expected = TEST_PRODUCER_COUNT * TEST_EVENTS_PER_PRODUCER;
+    while ((getLockedConfirmations() < expected) && (nowMs(tickCounter) - start < TEST_CONFIRMATION_TIMEOUT_MS))
+    {
+        ThreadAPI_Sleep(1);
+    }
+    uint64_t confirmed = nowMs(tickCounter);
+
+    LogInfo("sendEventHandoff=%s: %lu events from %d threads submitted in %lu ms, confirmed in %lu ms, slowest IoTHubClient_SendEventAsync took %lu ms",
+        sendEventHandoff ? "true" : "false", (unsigned long)expected, TEST_PRODUCER_COUNT,
+        (unsigned long)(submitted - start), (unsigned long)(confirmed - start), (unsigned long)maxCallMs);
+    ASSERT_ARE_EQUAL(size_t, expected, getLockedConfirmations());
+
+    IoTHubClient_Destroy(client);
+    tickcounter_destroy(tickCounter);
+}
+
+#ifdef USE_MQTT
+/*every thread runs a client of its own on its own MQTT transport, the confirmations arrive on that thread.
+Nothing is asserted on these threads, the results are checked once they are joined*/
+typedef struct MQTT_CLIENT_THREAD_TAG
+{
+    size_t index;
+    size_t events;
+    size_t confirmations;
+    size_t failedConfirmations;
+    size_t failedCalls;
+    uint64_t elapsedMs;
+} MQTT_CLIENT_THREAD;
+
+static void mqttConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    MQTT_CLIENT_THREAD* clientThread = (MQTT_CLIENT_THREAD*)userContextCallback;
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
+    {
+        clientThread->confirmations++;
+    }
+    else
+    {
+        clientThread->failedConfirmations++;
+    }
+}
+
+static int mqttClientThread(void* threadArgument)
+{
+    MQTT_CLIENT_THREAD* clientThread = (MQTT_CLIENT_THREAD*)threadArgument;
+    char deviceId[32];
+    IOTHUB_CLIENT_CONFIG config = MQTT_PERF_CONFIG;
+    (void)sprintf(deviceId, "perfDevice%lu", (unsigned long)clientThread->index);
+    config.deviceId = deviceId;
+
+    TICK_COUNTER_HANDLE tickCounter = tickcounter_create();
+    IOTHUB_CLIENT_LL_HANDLE client = IoTHubClient_LL_Create(&config);
+    IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromString("perf");
+    uint64_t start;
+    if ((tickCounter == NULL) || (client == NULL) || (message == NULL) || (tickcounter_get_current_ms(tickCounter, &start) != 0))
+    {
+        clientThread->failedCalls = clientThread->events;
+    }
+    else
+    {
+        for (size_t i = 0; i < clientThread->events; i++)
+        {
+            if (IoTHubClient_LL_SendEventAsync(client, message, mqttConfirmationCallback, clientThread) != IOTHUB_CLIENT_OK)
+            {
+                clientThread->failedCalls++;
+            }
+        }
+
+        uint64_t now = start;
+        while ((clientThread->confirmations + clientThread->failedConfirmations + clientThread->failedCalls < clientThread->events) &&
+            (now - start < TEST_CONFIRMATION_TIMEOUT_MS))
+        {
+            IoTHubClient_LL_DoWork(client);
+            (void)tickcounter_get_current_ms(tickCounter, &now);
+        }
+        clientThread->elapsedMs = now - start;
+    }
+
+    /*the threads have different numbers of events, so their transports are destroyed while the other transports still run*/
+    if (client != NULL)
+    {
+        IoTHubClient_LL_Destroy(client);
+    }
+    if (message != NULL)
+    {
+        IoTHubMessage_Destroy(message);
+    }
+    if (tickCounter != NULL)
+    {
+        tickcounter_destroy(tickCounter);
+    }
+    return 0;
+}
+#endif
+
+BEGIN_TEST_SUITE(perf_tests)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+        g_confirmationsLock = Lock_Init();
+        ASSERT_IS_NOT_NULL(g_confirmationsLock);
+#ifdef USE_HTTP
+        g_httpLock = Lock_Init();
+        ASSERT_IS_NOT_NULL(g_httpLock);
+#endif
+#ifdef USE_MQTT
+        ASSERT_ARE_EQUAL(int, 0, platform_init());
+#endif
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+#ifdef USE_MQTT
+        platform_deinit();
+#endif
+#ifdef USE_HTTP
+        (void)Lock_Deinit(g_httpLock);
+#endif
+        (void)Lock_Deinit(g_confirmationsLock);
+        TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        g_confirmations = 0;
+        g_lockedConfirmations = 0;
+#ifdef USE_HTTP
+        g_httpRequests = 0;
+        g_httpBytes = 0;
+        g_httpLatencyMs = 0;
+        g_outOfOrderConfirmations = 0;
+#endif
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+    }
+
+    /*messages that are far from timing out should not make IoTHubClient_LL_DoWork slower*/
+    TEST_FUNCTION(IoTHubClient_LL_DoWork_cost_versus_queue_depth)
+    {
+        TICK_COUNTER_HANDLE tickCounter = tickcounter_create();
+        ASSERT_IS_NOT_NULL(tickCounter);
+
+        for (size_t i = 0; i < TEST_QUEUE_DEPTHS_COUNT; i++)
+        {
+            IOTHUB_CLIENT_LL_HANDLE handle = createClientWithQueuedMessages(TEST_QUEUE_DEPTHS[i], 60 * 60 * 1000);
+
+            uint64_t start = nowMs(tickCounter);
+            for (size_t j = 0; j < TEST_DOWORK_ITERATIONS; j++)
+            {
+                IoTHubClient_LL_DoWork(handle);
+            }
+            uint64_t elapsed = nowMs(tickCounter) - start;
+
+            LogInfo("queue depth=%lu: %d DoWork calls took %lu ms (%.3f us per DoWork)",
+                (unsigned long)TEST_QUEUE_DEPTHS[i], TEST_DOWORK_ITERATIONS, (unsigned long)elapsed, (double)elapsed * 1000.0 / TEST_DOWORK_ITERATIONS);
+            ASSERT_ARE_EQUAL(size_t, 0, g_confirmations);
+
+            IoTHubClient_LL_Destroy(handle);
+            ASSERT_ARE_EQUAL(size_t, TEST_QUEUE_DEPTHS[i], g_confirmations);
+            g_confirmations = 0;
+        }
+
+        tickcounter_destroy(tickCounter);
+    }
+
+    /*expiring messages should cost in proportion to the number of messages that expire*/
+    TEST_FUNCTION(IoTHubClient_LL_DoWork_cost_of_timing_out_the_whole_queue)
+    {
+        TICK_COUNTER_HANDLE tickCounter = tickcounter_create();
+        ASSERT_IS_NOT_NULL(tickCounter);
+
+        for (size_t i = 0; i < TEST_QUEUE_DEPTHS_COUNT; i++)
+        {
+            IOTHUB_CLIENT_LL_HANDLE handle = createClientWithQueuedMessages(TEST_QUEUE_DEPTHS[i], 1);
+            ThreadAPI_Sleep(10);
+
+            uint64_t start = nowMs(tickCounter);
+            IoTHubClient_LL_DoWork(handle);
+            uint64_t elapsed = nowMs(tickCounter) - start;
+
+            LogInfo("queue depth=%lu: timing out all the messages took %lu ms",
+                (unsigned long)TEST_QUEUE_DEPTHS[i], (unsigned long)elapsed);
+            ASSERT_ARE_EQUAL(size_t, TEST_QUEUE_DEPTHS[i], g_confirmations);
+
+            IoTHubClient_LL_Destroy(handle);
+            g_confirmations = 0;
+        }
+
+        tickcounter_destroy(tickCounter);
+    }
+
+    /*with the handoff the application threads should not wait for the worker thread to finish its DoWork*/
+    TEST_FUNCTION(IoTHubClient_SendEventAsync_latency_with_a_slow_DoWork_and_concurrent_producers)
+    {
+        runProducers(false);
+        g_lockedConfirmations = 0;
+        runProducers(true);
+    }
+
+#ifdef USE_HTTP
+    /*building a batch should cost in proportion to its bytes, not to the square of its number of messages*/
+    TEST_FUNCTION(IoTHubTransportHttp_DoWork_cost_of_building_batches)
+    {
+        TICK_COUNTER_HANDLE tickCounter = tickcounter_create();
+        ASSERT_IS_NOT_NULL(tickCounter);
+
+        unsigned char body[TEST_HTTP_MESSAGE_SIZE];
+        for (size_t i = 0; i < TEST_HTTP_MESSAGE_SIZE; i++)
+        {
+            body[i] = (unsigned char)i;
+        }
+        IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromByteArray(body, TEST_HTTP_MESSAGE_SIZE);
+        ASSERT_IS_NOT_NULL(message);
+        ASSERT_ARE_EQUAL(int, MAP_OK, Map_AddOrUpdate(IoTHubMessage_Properties(message), "sensor", "perf"));
+
+        for (size_t i = 0; i < TEST_HTTP_BATCH_SIZES_COUNT; i++)
+        {
+            IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&HTTP_PERF_CONFIG);
+            ASSERT_IS_NOT_NULL(handle);
+            bool batching = true;
+            ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubClient_LL_SetOption(handle, "Batching", &batching));
+            g_httpRequests = 0;
+            g_httpBytes = 0;
+
+            uint64_t elapsed = 0;
+            for (size_t j = 0; j < TEST_HTTP_BATCHES; j++)
+            {
+                for (size_t k = 0; k < TEST_HTTP_BATCH_SIZES[i]; k++)
+                {
+                    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubClient_LL_SendEventAsync(handle, message, perfConfirmationCallback, NULL));
+                }
+
+                uint64_t start = nowMs(tickCounter);
+                IoTHubClient_LL_DoWork(handle);
+                elapsed += nowMs(tickCounter) - start;
+            }
+
+            ASSERT_ARE_EQUAL(size_t, TEST_HTTP_BATCHES * TEST_HTTP_BATCH_SIZES[i], g_confirmations);
+            LogInfo("batch size=%lu: %d batches in %lu requests of %lu bytes on average took %lu ms (%.3f us per batch, %.3f us per message)",
+                (unsigned long)TEST_HTTP_BATCH_SIZES[i], TEST_HTTP_BATCHES, (unsigned long)g_httpRequests, (unsigned long)(g_httpBytes / g_httpRequests), (unsigned long)elapsed,
+                (double)elapsed * 1000.0 / TEST_HTTP_BATCHES, (double)elapsed * 1000.0 / (TEST_HTTP_BATCHES * TEST_HTTP_BATCH_SIZES[i]));
+
+            IoTHubClient_LL_Destroy(handle);
+            g_confirmations = 0;
+        }
+
+        IoTHubMessage_Destroy(message);
+        tickcounter_destroy(tickCounter);
+    }
+
+    /*against a server that takes TEST_HTTP_LATENCY_MS to answer, the connection pool should divide the duration of a DoWork by the number of connections, and keep the events of a device in order*/
+    TEST_FUNCTION(IoTHubTransportHttp_DoWork_duration_versus_concurrent_connections)
+    {
+        TICK_COUNTER_HANDLE tickCounter = tickcounter_create();
+        ASSERT_IS_NOT_NULL(tickCounter);
+        g_httpLatencyMs = TEST_HTTP_LATENCY_MS;
+
+        uint64_t sequentialElapsed = 0;
+        for (size_t i = 0; i < TEST_HTTP_CONCURRENT_CONNECTIONS_COUNT; i++)
+        {
+            g_httpRequests = 0;
+            g_lockedConfirmations = 0;
+            uint64_t elapsed = runSharedHttpTransport(tickCounter, TEST_HTTP_CONCURRENT_CONNECTIONS[i]);
+
+            LogInfo("ConcurrentConnections=%u: %d devices sent %d events each in %lu requests in %lu ms",
+                TEST_HTTP_CONCURRENT_CONNECTIONS[i], TEST_HTTP_DEVICES, TEST_HTTP_EVENTS_PER_DEVICE, (unsigned long)g_httpRequests, (unsigned long)elapsed);
+            ASSERT_ARE_EQUAL(size_t, TEST_HTTP_DEVICES * TEST_HTTP_EVENTS_PER_DEVICE, g_httpRequests);
+            if (TEST_HTTP_CONCURRENT_CONNECTIONS[i] == 1)
+            {
+                sequentialElapsed = elapsed;
+            }
+            else
+            {
+                ASSERT_IS_TRUE(elapsed < sequentialElapsed);
+            }
+        }
+
+        tickcounter_destroy(tickCounter);
+    }
+#endif
+
+#ifdef USE_MQTT
+    /*TEST_MQTT_CLIENTS transports running at the same time on their own threads should not share any timing state: every event is acknowledged and confirmed once*/
+    TEST_FUNCTION(IoTHubTransportMqtt_concurrent_transports_on_separate_threads)
+    {
+        TICK_COUNTER_HANDLE tickCounter = tickcounter_create();
+        ASSERT_IS_NOT_NULL(tickCounter);
+
+        MQTT_CLIENT_THREAD clientThreads[TEST_MQTT_CLIENTS];
+        THREAD_HANDLE threads[TEST_MQTT_CLIENTS];
+        size_t expected = 0;
+        uint64_t start = nowMs(tickCounter);
+        for (size_t i = 0; i < TEST_MQTT_CLIENTS; i++)
+        {
+            clientThreads[i].index = i;
+            clientThreads[i].events = TEST_MQTT_EVENTS_PER_CLIENT + i * TEST_MQTT_EXTRA_EVENTS_PER_INDEX;
+            clientThreads[i].confirmations = 0;
+            clientThreads[i].failedConfirmations = 0;
+            clientThreads[i].failedCalls = 0;
+            clientThreads[i].elapsedMs = 0;
+            expected += clientThreads[i].events;
+            ASSERT_ARE_EQUAL(int, THREADAPI_OK, ThreadAPI_Create(&threads[i], mqttClientThread, &clientThreads[i]));
+        }
+
+        size_t confirmations = 0;
+        uint64_t maxElapsedMs = 0;
+        for (size_t i = 0; i < TEST_MQTT_CLIENTS; i++)
+        {
+            int res;
+            ASSERT_ARE_EQUAL(int, THREADAPI_OK, ThreadAPI_Join(threads[i], &res));
+            ASSERT_ARE_EQUAL(size_t, 0, clientThreads[i].failedCalls);
+            ASSERT_ARE_EQUAL(size_t, 0, clientThreads[i].failedConfirmations);
+            ASSERT_ARE_EQUAL(size_t, clientThreads[i].events, clientThreads[i].confirmations);
+            confirmations += clientThreads[i].confirmations;
+            if (clientThreads[i].elapsedMs > maxElapsedMs)
+            {
+                maxElapsedMs = clientThreads[i].elapsedMs;
+            }
+        }
+        uint64_t elapsed = nowMs(tickCounter) - start;
+
+        LogInfo("%d MQTT transports on their own threads confirmed %lu events in %lu ms (slowest transport %lu ms)",
+            TEST_MQTT_CLIENTS, (unsigned long)confirmations, (unsigned long)elapsed, (unsigned long)maxElapsedMs);
+        ASSERT_ARE_EQUAL(size_t, expected, confirmations);
+
+        tickcounter_destroy(tickCounter);
+    }
+#endif
+
+    /*the codec should be faster than the shared utility base64 it replaces, and its vector implementations faster than its scalar one*/
+    TEST_FUNCTION(IoTHubBase64_throughput_versus_Base64_Encode_Bytes)
+    {
+        TICK_COUNTER_HANDLE tickCounter = tickcounter_create();
+        ASSERT_IS_NOT_NULL(tickCounter);
+
+        unsigned char* bytes = (unsigned char*)malloc(TEST_BASE64_SIZE);
+        ASSERT_IS_NOT_NULL(bytes);
+        unsigned char* decoded = (unsigned char*)malloc(TEST_BASE64_SIZE);
+        ASSERT_IS_NOT_NULL(decoded);
+        size_t encodedLength = IoTHubBase64_EncodedLength(TEST_BASE64_SIZE);
+        char* encoded = (char*)malloc(encodedLength + 1);
+        ASSERT_IS_NOT_NULL(encoded);
+        for (size_t i = 0; i < TEST_BASE64_SIZE; i++)
+        {
+            bytes[i] = (unsigned char)(i * 167 + 13);
+        }
+
+        uint64_t start = nowMs(tickCounter);
+        for (size_t i = 0; i < TEST_BASE64_ITERATIONS; i++)
+        {
+            STRING_HANDLE s = Base64_Encode_Bytes(bytes, TEST_BASE64_SIZE);
+            ASSERT_IS_NOT_NULL(s);
+            STRING_delete(s);
+        }
+        uint64_t elapsed = nowMs(tickCounter) - start;
+        LogInfo("Base64_Encode_Bytes: %d x %d bytes took %lu ms", TEST_BASE64_ITERATIONS, TEST_BASE64_SIZE, (unsigned long)elapsed);
+
+        (void)IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET_STANDARD, bytes, TEST_BASE64_SIZE, encoded);
+        encoded[encodedLength] = '\0';
+        start = nowMs(tickCounter);
+        for (size_t i = 0; i < TEST_BASE64_ITERATIONS; i++)
+        {
+            BUFFER_HANDLE b = Base64_Decoder(encoded);
+            ASSERT_IS_NOT_NULL(b);
+            BUFFER_delete(b);
+        }
+        elapsed = nowMs(tickCounter) - start;
+        LogInfo("Base64_Decoder: %d x %lu characters took %lu ms", TEST_BASE64_ITERATIONS, (unsigned long)encodedLength, (unsigned long)elapsed);
+
+        IOTHUB_BASE64_IMPLEMENTATION defaultImplementation = IoTHubBase64_GetImplementation();
+        for (size_t j = 0; j < TEST_BASE64_IMPLEMENTATIONS_COUNT; j++)
+        {
+            if (IoTHubBase64_SetImplementation(TEST_BASE64_IMPLEMENTATIONS[j]) == 0)
+            {
+                start = nowMs(tickCounter);
+                for (size_t i = 0; i < TEST_BASE64_ITERATIONS; i++)
+                {
+                    ASSERT_ARE_EQUAL(void_ptr, encoded + encodedLength, IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET_STANDARD, bytes, TEST_BASE64_SIZE, encoded));
+                }
+                elapsed = nowMs(tickCounter) - start;
+                LogInfo("IoTHubBase64_Encode with implementation %d: %d x %d bytes took %lu ms", (int)TEST_BASE64_IMPLEMENTATIONS[j], TEST_BASE64_ITERATIONS, TEST_BASE64_SIZE, (unsigned long)elapsed);
+
+                start = nowMs(tickCounter);
+                for (size_t i = 0; i < TEST_BASE64_ITERATIONS; i++)
+                {
+                    ASSERT_ARE_EQUAL(size_t, encodedLength - 4, IoTHubBase64_DecodeGroups(IOTHUB_BASE64_ALPHABET_STANDARD, encoded, encodedLength, decoded));
+                }
+                elapsed = nowMs(tickCounter) - start;
+                LogInfo("IoTHubBase64_DecodeGroups with implementation %d: %d x %lu characters took %lu ms", (int)TEST_BASE64_IMPLEMENTATIONS[j], TEST_BASE64_ITERATIONS, (unsigned long)encodedLength, (unsigned long)elapsed);
+                ASSERT_ARE_EQUAL(int, 0, memcmp(decoded, bytes, (encodedLength - 4) / 4 * 3));
+            }
+        }
+        (void)IoTHubBase64_SetImplementation(defaultImplementation);
+
+        free(encoded);
+        free(decoded);
+        free(bytes);
+        tickcounter_destroy(tickCounter);
+    }
+
+END_TEST_SUITE(perf_tests)
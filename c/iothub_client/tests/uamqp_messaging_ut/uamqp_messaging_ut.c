@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
 
 void* real_malloc(size_t size)
 {
@@ -95,6 +96,21 @@ int test_amqpvalue_get_string(AMQP_VALUE value, const char** string_value)
 	return saved_amqpvalue_get_string_return;
 }
 
+#define TEST_SECTION_ENCODED_SIZE 3
+
+int test_amqpvalue_get_encoded_size(AMQP_VALUE value, size_t* encoded_size)
+{
+	(void)value;
+	*encoded_size = TEST_SECTION_ENCODED_SIZE;
+	return 0;
+}
+
+int test_amqpvalue_encode(AMQP_VALUE value, AMQPVALUE_ENCODER_OUTPUT encoder_output, void* context)
+{
+	(void)value;
+	return encoder_output(context, (const unsigned char*)TEST_STRING, TEST_SECTION_ENCODED_SIZE);
+}
+
 
 // Helpers to set EXPECTED_CALLS
 void set_exp_calls_for_addPropertiesTouAMQPMessage(bool has_message_id, bool has_correlation_id, bool message_handle_has_properties)
@@ -194,6 +210,33 @@ static void set_exp_calls_for_message_create_from_iothub_message(size_t number_o
 	set_exp_calls_for_addApplicationPropertiesTouAMQPMessage(number_of_app_properties);
 }
 
+static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message()
+{
+	static BINARY_DATA test_binary_data;
+	test_binary_data.bytes = (const unsigned char*)TEST_STRING;
+	test_binary_data.length = strlen(TEST_STRING);
+
+	set_exp_calls_for_message_create_from_iothub_message(0, IOTHUBMESSAGE_BYTEARRAY, true, true, true);
+
+	STRICT_EXPECTED_CALL(message_get_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+		.IgnoreArgument_properties()
+		.CopyOutArgumentBuffer_properties(&TEST_PROPERTIES_HANDLE_PTR, sizeof(PROPERTIES_HANDLE));
+	STRICT_EXPECTED_CALL(amqpvalue_create_properties(TEST_PROPERTIES_HANDLE)).SetReturn(TEST_AMQP_VALUE);
+	STRICT_EXPECTED_CALL(message_get_application_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(message_get_body_amqp_data(TEST_MESSAGE_HANDLE, 0, IGNORED_PTR_ARG))
+		.IgnoreArgument(3)
+		.CopyOutArgumentBuffer_binary_data(&test_binary_data, sizeof(BINARY_DATA));
+	STRICT_EXPECTED_CALL(amqpvalue_create_data(IGNORED_NUM_ARG)).IgnoreArgument(1).SetReturn(TEST_AMQP_VALUE);
+	STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_AMQP_VALUE, IGNORED_PTR_ARG)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_AMQP_VALUE, IGNORED_PTR_ARG)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).IgnoreArgument(2).IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).IgnoreArgument(2).IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+	STRICT_EXPECTED_CALL(properties_destroy(TEST_PROPERTIES_HANDLE));
+	STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_HANDLE));
+}
+
 static void set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(size_t number_of_properties, bool has_message_id, bool has_correlation_id, bool has_properties)
 {
 	static BINARY_DATA test_binary_data;
@@ -306,10 +349,14 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
 	REGISTER_UMOCK_ALIAS_TYPE(AMQP_TYPE, int);
+	REGISTER_UMOCK_ALIAS_TYPE(AMQPVALUE_ENCODER_OUTPUT, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(data, void*);
 
 	REGISTER_GLOBAL_MOCK_HOOK(properties_get_message_id, test_properties_get_message_id);
 	REGISTER_GLOBAL_MOCK_HOOK(properties_get_correlation_id, test_properties_get_correlation_id);
 	REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_string, test_amqpvalue_get_string);
+	REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_encoded_size, test_amqpvalue_get_encoded_size);
+	REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_encode, test_amqpvalue_encode);
 
 	REGISTER_GLOBAL_MOCK_RETURN(message_get_properties, 0);
 	REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_get_properties, 1);
@@ -677,6 +724,70 @@ TEST_FUNCTION(message_create_from_iothub_message_STRING_return_errors_fails)
 // Tests_SRS_UAMQP_MESSAGING_09_003: [If the uAMQP message body type is MESSAGE_BODY_TYPE_DATA, the body data shall be treated as binary data.]
 // Tests_SRS_UAMQP_MESSAGING_09_004: [The uAMQP message body data shall be retrieved using message_get_body_amqp_data().]
 // Tests_SRS_UAMQP_MESSAGING_09_006: [The IOTHUB_MESSAGE instance shall be created using IoTHubMessage_CreateFromByteArray(), passing the uAMQP body bytes as parameter.]
+// Tests_SRS_UAMQP_MESSAGING_10_001: [message_create_uamqp_encoding_from_iothub_message() shall build the uAMQP message of the event with message_create_from_iothub_message().]
+// Tests_SRS_UAMQP_MESSAGING_10_003: [The properties, the application properties (when there are any) and the data of the uAMQP message shall be wrapped, in that order, in their AMQP sections with amqpvalue_create_properties(), amqpvalue_create_application_properties() and amqpvalue_create_data().]
+// Tests_SRS_UAMQP_MESSAGING_10_004: [The sections shall be encoded one after the other with amqpvalue_encode() into a single buffer of the size computed with amqpvalue_get_encoded_size(), returned in body_binary_data; the caller frees it with free().]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_success)
+{
+	// arrange
+	umock_c_reset_all_calls();
+	set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message();
+
+	// act
+	BINARY_DATA encoded;
+	encoded.bytes = NULL;
+	encoded.length = 0;
+	int result = message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, &encoded);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, result, 0);
+	ASSERT_IS_NOT_NULL(encoded.bytes);
+	ASSERT_ARE_EQUAL(size_t, 2 * TEST_SECTION_ENCODED_SIZE, encoded.length);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(encoded.bytes, TEST_STRING, TEST_SECTION_ENCODED_SIZE));
+	ASSERT_ARE_EQUAL(int, 0, memcmp(encoded.bytes + TEST_SECTION_ENCODED_SIZE, TEST_STRING, TEST_SECTION_ENCODED_SIZE));
+
+	// cleanup
+	free((void*)encoded.bytes);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_10_002: [If any call fails, message_create_uamqp_encoding_from_iothub_message() shall free what it allocated and return a non-zero value.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_create_data_fails)
+{
+	// arrange
+	static BINARY_DATA test_binary_data;
+	test_binary_data.bytes = (const unsigned char*)TEST_STRING;
+	test_binary_data.length = strlen(TEST_STRING);
+
+	umock_c_reset_all_calls();
+	set_exp_calls_for_message_create_from_iothub_message(0, IOTHUBMESSAGE_BYTEARRAY, true, true, true);
+	STRICT_EXPECTED_CALL(message_get_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+		.IgnoreArgument_properties()
+		.CopyOutArgumentBuffer_properties(&TEST_PROPERTIES_HANDLE_PTR, sizeof(PROPERTIES_HANDLE));
+	STRICT_EXPECTED_CALL(amqpvalue_create_properties(TEST_PROPERTIES_HANDLE)).SetReturn(TEST_AMQP_VALUE);
+	STRICT_EXPECTED_CALL(message_get_application_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(message_get_body_amqp_data(TEST_MESSAGE_HANDLE, 0, IGNORED_PTR_ARG))
+		.IgnoreArgument(3)
+		.CopyOutArgumentBuffer_binary_data(&test_binary_data, sizeof(BINARY_DATA));
+	STRICT_EXPECTED_CALL(amqpvalue_create_data(IGNORED_NUM_ARG)).IgnoreArgument(1).SetReturn(NULL);
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+	STRICT_EXPECTED_CALL(properties_destroy(TEST_PROPERTIES_HANDLE));
+	STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_HANDLE));
+
+	// act
+	BINARY_DATA encoded;
+	encoded.bytes = NULL;
+	encoded.length = 0;
+	int result = message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, &encoded);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_NOT_EQUAL(int, result, 0);
+	ASSERT_IS_NULL(encoded.bytes);
+
+	// cleanup
+}
+
 // Tests_SRS_UAMQP_MESSAGING_09_008: [The uAMQP message properties shall be retrieved using message_get_properties().]
 // Tests_SRS_UAMQP_MESSAGING_09_010: [The message-id property shall be read from the uAMQP message by calling properties_get_message_id.]
 // Tests_SRS_UAMQP_MESSAGING_09_012: [The type of the message-id property value shall be obtained using amqpvalue_get_type().]
@@ -27,6 +27,7 @@
 #endif
 
 #include "azure_c_shared_utility/crt_abstractions.h"
+#include "iothub_base64.h"
 
 #include "jsonencoder.h"
 #include "multitree.h"
@@ -85,16 +86,6 @@ static void NoFreeFunction(void* value)
 }
 
 
-static const char base64char[64] = { 
-    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 
-    'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 
-    'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd', 
-    'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 
-    'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 
-    'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7', 
-    '8', '9', '-', '_'
-};
-
 static const char base64b16[16] = { 
     'A', 'E', 'I', 'M', 'Q', 'U', 'Y', 'c', 'g', 'k', 
     'o', 's', 'w', '0', '4', '8'
@@ -521,38 +512,6 @@ static int base64toValue(char base64charSource, unsigned char* value)
     return result;
 }
 
-/*returns 0 if everything went ok*/
-/*scans 4 base64 characters and returns 3 usual bytes*/
-static int scan4base64char(const char* source, size_t sourceSize, unsigned char *destination0, unsigned char* destination1, unsigned char* destination2)
-{
-    int result;
-    if (sourceSize < 4)
-    {
-        result = 1;
-    }
-    else
-    {
-        unsigned char b0, b1, b2, b3;
-        if (
-            (base64toValue(source[0], &b0) == 0) &&
-            (base64toValue(source[1], &b1) == 0) &&
-            (base64toValue(source[2], &b2) == 0) &&
-            (base64toValue(source[3], &b3) == 0)
-            )
-        {
-            *destination0 = (b0 << 2) | ((b1 & 0x30) >> 4);
-            *destination1 = ((b1 & 0x0F)<<4) | ((b2 & 0x3C) >>2 );
-            *destination2 = ((b2 & 0x03) << 6) | (b3);
-            result = 0;
-        }
-        else
-        {
-            result = 2;
-        }
-    }
-    return result;
-}
-
 /*return 0 if the character is one of ( 'A' / 'E' / 'I' / 'M' / 'Q' / 'U' / 'Y' / 'c' / 'g' / 'k' / 'o' / 's' / 'w' / '0' / '4' / '8' )*/
 static int base64b16toValue(unsigned char source, unsigned char* destination)
 {
@@ -2192,7 +2151,6 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
             }
             case EDM_BINARY_TYPE:
             {
-                size_t currentPosition = 0;
                 char* temp;
                 /*binary types */
                 /*Codes_SRS_AGENT_TYPE_SYSTEM_99_099:[EDM_BINARY:= *(4base64char)[base64b16 / base64b8]]*/
@@ -2201,9 +2159,8 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                 /*2. the remaining characters (1 or 2) shall be encoded.*/
                 /*there's a level of assumption that 'a' corresponds to 0b000000 and that '_' corresponds to 0b111111*/
                 /*the encoding will use the optional [=] or [==] at the end of the encoded string, so that other less standard aware libraries can do their work*/
-                /*these are the bits of the 3 normal bytes to be encoded*/
                 size_t neededSize = 2; /*2 because starting and ending quotes */
-                neededSize += (value->value.edmBinary.size == 0) ? (0) : ((((value->value.edmBinary.size-1) / 3) + 1) * 4);
+                neededSize += IoTHubBase64_EncodedLength(value->value.edmBinary.size);
                 neededSize += 1; /*+1 because \0 at the end of the string*/
                 if ((temp = (char*)malloc(neededSize))==NULL)
                 {
@@ -2211,61 +2168,15 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                 }
                 else
                 {
-                    /*b0            b1(+1)          b2(+2)
-                      7 6 5 4 3 2 1 0 7 6 5 4 3 2 1 0 7 6 5 4 3 2 1 0
-                      |----c1---| |----c2---| |----c3---| |----c4---|
-                    */
-
-                    size_t destinationPointer = 0;
-                    temp[destinationPointer++] = '"';
-                    while (value->value.edmBinary.size - currentPosition >= 3)
-                    {
-                        char c1 = base64char[value->value.edmBinary.data[currentPosition] >> 2];
-                        char c2 = base64char[
-                            ((value->value.edmBinary.data[currentPosition] & 3) << 4) |
-                                (value->value.edmBinary.data[currentPosition + 1] >> 4)
-                        ];
-                        char c3 = base64char[
-                            ((value->value.edmBinary.data[currentPosition + 1] & 0x0F) << 2) |
-                                ((value->value.edmBinary.data[currentPosition + 2] >> 6) & 3)
-                        ];
-                        char c4 = base64char[
-                            value->value.edmBinary.data[currentPosition + 2] & 0x3F
-                        ];
-                        currentPosition += 3;
-                        temp[destinationPointer++] = c1;
-                        temp[destinationPointer++] = c2;
-                        temp[destinationPointer++] = c3;
-                        temp[destinationPointer++] = c4;
-
-                    }
-                    if (value->value.edmBinary.size - currentPosition == 2)
-                    {
-                        char c1 = base64char[value->value.edmBinary.data[currentPosition] >> 2];
-                        char c2 = base64char[
-                            ((value->value.edmBinary.data[currentPosition] & 0x03) << 4) |
-                                (value->value.edmBinary.data[currentPosition + 1] >> 4)
-                        ];
-                        char c3 = base64b16[value->value.edmBinary.data[currentPosition + 1] & 0x0F];
-                        temp[destinationPointer++] = c1;
-                        temp[destinationPointer++] = c2;
-                        temp[destinationPointer++] = c3;
-                        temp[destinationPointer++] = '=';
-                    }
-                    else if (value->value.edmBinary.size - currentPosition == 1)
-                    {
-                        char c1 = base64char[value->value.edmBinary.data[currentPosition] >> 2];
-                        char c2 = base64b8[value->value.edmBinary.data[currentPosition] & 0x03];
-                        temp[destinationPointer++] = c1;
-                        temp[destinationPointer++] = c2;
-                        temp[destinationPointer++] = '=';
-                        temp[destinationPointer++] = '=';
-                    }
-                    
+                    /*the alphabet is the URL one: '-' is 62 and '_' is 63*/
+                    char* destinationPointer = temp;
+                    *destinationPointer++ = '"';
+                    destinationPointer = IoTHubBase64_Encode(IOTHUB_BASE64_ALPHABET_URL, value->value.edmBinary.data, value->value.edmBinary.size, destinationPointer);
+
                     /*closing quote*/
-                    temp[destinationPointer++] = '"';
+                    *destinationPointer++ = '"';
                     /*null terminating the string*/
-                    temp[destinationPointer] = '\0';
+                    *destinationPointer = '\0';
 
                     if (STRING_concat(destination, temp) != 0)
                     {
@@ -3868,11 +3779,9 @@ result = AGENT_DATA_TYPES_OK;
                             size_t destinationPosition = 0;
                             size_t consumed;
                             /*read and store "solid" groups of 4 base64 chars*/
-                            while (scan4base64char(source + sourcePosition, sourceLength - sourcePosition, agentData->value.edmBinary.data + destinationPosition, agentData->value.edmBinary.data + destinationPosition + 1, agentData->value.edmBinary.data + destinationPosition + 2) == 0)
-                            {
-                                sourcePosition += 4;
-                                destinationPosition += 3;
-                            }
+                            consumed = IoTHubBase64_DecodeGroups(IOTHUB_BASE64_ALPHABET_URL, source + sourcePosition, sourceLength - sourcePosition, agentData->value.edmBinary.data);
+                            sourcePosition += consumed;
+                            destinationPosition += consumed / 4 * 3;
 
                             if (scanbase64b16(source + sourcePosition, sourceLength - sourcePosition, &consumed, agentData->value.edmBinary.data + destinationPosition, agentData->value.edmBinary.data + destinationPosition + 1) == 0)
                             {
@@ -1261,6 +1261,7 @@ BOOST_PYTHON_MODULE(IMPORT_NAME)
         .value("BECAUSE_DESTROY", IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY)
         .value("MESSAGE_TIMEOUT", IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT)
         .value("ERROR", IOTHUB_CLIENT_CONFIRMATION_ERROR)
+        .value("DROPPED", IOTHUB_CLIENT_CONFIRMATION_DROPPED)
         ;
 
     enum_<IOTHUBMESSAGE_DISPOSITION_RESULT>("IoTHubMessageDispositionResult")
@@ -190,7 +190,8 @@ class TestEnumDefinitions(unittest.TestCase):
         self.assertEqual(IoTHubClientConfirmationResult.BECAUSE_DESTROY, 1)
         self.assertEqual(IoTHubClientConfirmationResult.MESSAGE_TIMEOUT, 2)
         self.assertEqual(IoTHubClientConfirmationResult.ERROR, 3)
-        lastEnum = IoTHubClientConfirmationResult.ERROR + 1
+        self.assertEqual(IoTHubClientConfirmationResult.DROPPED, 4)
+        lastEnum = IoTHubClientConfirmationResult.DROPPED + 1
         with self.assertRaises(AttributeError):
             self.assertEqual(IoTHubClientConfirmationResult.ANY, 0)
         confirmationResult = IoTHubClientConfirmationResult()